@@ -7,6 +7,7 @@
 
 #include <chrono>
 #include <cxxopts.hpp>
+#include <limits>
 #include <macrocirculation/communication/mpi.hpp>
 #include <memory>
 #include <utility>
@@ -18,8 +19,13 @@
 #include "macrocirculation/graph_partitioner.hpp"
 #include "macrocirculation/graph_pvd_writer.hpp"
 #include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/impedance_solver.hpp"
 #include "macrocirculation/interpolate_to_vertices.hpp"
+#include "macrocirculation/parareal_solver.hpp"
+#include "macrocirculation/periodic_state_monitor.hpp"
+#include "macrocirculation/periodic_state_solver.hpp"
 #include "macrocirculation/rcr_estimator.hpp"
+#include "macrocirculation/steady_flow_solver.hpp"
 #include "macrocirculation/vessel_formulas.hpp"
 
 namespace mc = macrocirculation;
@@ -27,7 +33,8 @@ namespace mc = macrocirculation;
 constexpr std::size_t degree = 2;
 
 int main(int argc, char *argv[]) {
-  MPI_Init(&argc, &argv);
+  // only the main thread communicates, the threads of the solver do the edge loops
+  mc::mpi::initialize(&argc, &argv, MPI_THREAD_FUNNELED);
 
   cxxopts::Options options(argv[0], "Calibration for the nonlinear solver");
   options.add_options()                                                                                                                     //
@@ -39,7 +46,17 @@ int main(int argc, char *argv[]) {
     ("heart-systole-period", "the period of one heartbeat", cxxopts::value<double>()->default_value("0.3"))                                 //
     ("tau", "time step size", cxxopts::value<double>()->default_value(std::to_string(2.5e-4 / 16.)))                                        //
     ("tau-out", "time step size for the output", cxxopts::value<double>()->default_value("1e-2"))                                           //
+    ("cfl", "if positive, the time step is adapted to the given cfl number and tau is only an upper bound", cxxopts::value<double>()->default_value("0")) //
     ("t-end", "Time when our simulation ends", cxxopts::value<double>()->default_value("1."))                                               //
+    ("periodic-tol", "if positive, the flows are integrated over a single heart beat once two successive heart beats differ less than this tolerance", cxxopts::value<double>()->default_value("0")) //
+    ("shooting-cycles", "if positive, the periodic state is found with anderson accelerated cycles up to this many times instead of simulating the heart beats until t-end, where periodic-tol is the tolerance", cxxopts::value<std::size_t>()->default_value("0")) //
+    ("num-threads", "number of threads per rank for the edge loops", cxxopts::value<std::size_t>()->default_value("1"))                      //
+    ("iterations", "if positive, the outlets get windkessel models, whose parameters are recalibrated in place up to this many times from the flows of the last heart beat", cxxopts::value<std::size_t>()->default_value("0")) //
+    ("cycles-per-iteration", "the number of heart beats simulated per iteration, continuing from the previous state", cxxopts::value<std::size_t>()->default_value("2")) //
+    ("calibration-tol", "the iterations stop once the resistances change relatively less than this tolerance", cxxopts::value<double>()->default_value("1e-3")) //
+    ("boundary-file", "path to the windkessel parameters of a previous calibration, which are the initial values of the iterations", cxxopts::value<std::string>()->default_value("")) //
+    ("steady-estimate", "the flows of a steady solve of the network are the initial estimate of the parameters and the initial state, where a non-positive t-end skips the simulation of the first heart beats", cxxopts::value<bool>()->default_value("false")) //
+    ("impedance-harmonics", "if positive, prints the input impedance and the pressure pulse at the inflow of the linearized network with this many harmonics of the heart beat", cxxopts::value<std::size_t>()->default_value("0")) //
     ("verbose", "verbose output", cxxopts::value<bool>()->default_value("false"))                                                           //
     ("h,help", "print usage");
   // options.allow_unrecognised_options(); // for petsc, but we do not use petsc here :P
@@ -63,11 +80,47 @@ int main(int argc, char *argv[]) {
   auto heart = mc::heart_beat_inflow(heart_amplitude, heart_period, heart_systole_period);
   graph->find_vertex_by_name(args["inflow-vertex-name"].as<std::string>())->set_to_inflow_with_fixed_flow(heart);
 
-  // set all vertices to free-outflow
-  for (auto v_id : graph->get_vertex_ids()) {
-    auto v = graph->get_vertex(v_id);
-    if (v->is_windkessel_outflow())
-      v->set_to_free_outflow();
+  struct OutletParition {
+    std::string name;
+    double quota_flow;
+    std::set< size_t > vessel_ids;
+  };
+
+  std::set<size_t> flow_body_vessels = {8};
+
+  std::vector< OutletParition > outlet_partitions = {
+    { "head", 0.15, {10, 13, 22, 23, 26, 27, 28, 29, 31, 33}},
+    // { "left_arm", 0.05, {15, 34, 36, 37, 38, 39}},
+    { "left_arm", 0.05, {15 }},
+    { "right_arm", 0.05, {16}},
+    { "body", 0.75, {8}},
+  };
+
+  const auto num_iterations = args["iterations"].as<std::size_t>();
+
+  // the outlets of the partitions without initial parameters, which are estimated once the solver is set up
+  std::set<size_t> uncalibrated_outlets;
+
+  if (num_iterations == 0) {
+    // set all vertices to free-outflow
+    for (auto v_id : graph->get_vertex_ids()) {
+      auto v = graph->get_vertex(v_id);
+      if (v->is_windkessel_outflow())
+        v->set_to_free_outflow();
+    }
+  } else {
+    // the windkessel models are set up once, such that the calibration only changes their parameters without changing the dofs
+    if (!args["boundary-file"].as<std::string>().empty())
+      graph_reader.set_boundary_data(args["boundary-file"].as<std::string>(), *graph);
+    for (auto &o : outlet_partitions) {
+      for (auto id : o.vessel_ids) {
+        auto v = graph->get_vertex(id);
+        if (!v->is_windkessel_outflow()) {
+          v->set_to_windkessel_outflow(1., 1.);
+          uncalibrated_outlets.insert(id);
+        }
+      }
+    }
   }
 
   graph->finalize_bcs();
@@ -77,7 +130,7 @@ int main(int argc, char *argv[]) {
   auto dof_map_flow = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
   dof_map_flow->create(MPI_COMM_WORLD, *graph, 2, degree, false);
 
-  const double t_end = args["t-end"].as<double>();
+  double t_end = args["t-end"].as<double>();
   const std::size_t max_iter = 160000000;
 
   const auto tau = args["tau"].as<double>();
@@ -89,6 +142,7 @@ int main(int argc, char *argv[]) {
   // configure solver
   mc::ExplicitNonlinearFlowSolver flow_solver(MPI_COMM_WORLD, graph, dof_map_flow, degree);
   flow_solver.use_ssp_method();
+  flow_solver.set_num_threads(args["num-threads"].as<std::size_t>());
 
   std::vector<mc::Point> points;
   std::vector<double> Q_vertex_values;
@@ -98,55 +152,19 @@ int main(int argc, char *argv[]) {
 
   mc::FlowIntegrator flow_integrator(graph);
 
-  const auto begin_t = std::chrono::steady_clock::now();
-  double t = 0;
-  for (std::size_t it = 0; it < max_iter; it += 1) {
-    flow_solver.solve(tau, t);
-
-    t += tau;
-
-    // add total flows
-    flow_integrator.update_flow(flow_solver, tau);
-
-    if (it % output_interval == 0) {
-      if (mc::mpi::rank(MPI_COMM_WORLD) == 0)
-        std::cout << "iter = " << it << ", t = " << t << std::endl;
-    }
-
-    // break
-    if (t > t_end + 1e-12)
-      break;
-  }
-
-  auto flows = flow_integrator.get_free_outflow_data();
-
   mc::RCREstimator rcr_estimator({graph});
 
-  struct OutletParition {
-    std::string name;
-    double quota_flow;
-    std::set< size_t > vessel_ids;
-  };
-
-  std::set<size_t> flow_body_vessels = {8};
-
-  std::vector< OutletParition > outlet_partitions = {
-    { "head", 0.15, {10, 13, 22, 23, 26, 27, 28, 29, 31, 33}},
-    // { "left_arm", 0.05, {15, 34, 36, 37, 38, 39}},
-    { "left_arm", 0.05, {15 }},
-    { "right_arm", 0.05, {16}},
-    { "body", 0.75, {8}},
-  };
-
-  if (mc::mpi::rank(MPI_COMM_WORLD) == 0) {
+  // estimates the parameters of the outlets in the partitions from their flows
+  const auto estimate_parameters = [&](const mc::FlowData &flows, bool verbose) {
     std::map< size_t, mc::RCRData > rcr_parameters;
 
     const double R_total = rcr_estimator.resistance_to_distribute();
     const double C_total = rcr_estimator.capacitance_to_distribute();
 
-
-    std::cout << "R_total = " << R_total << std::endl;
-    std::cout << "C_total = " << C_total << std::endl;
+    if (verbose) {
+      std::cout << "R_total = " << R_total << std::endl;
+      std::cout << "C_total = " << C_total << std::endl;
+    }
 
     std::vector <double> C_partition;
     std::vector <double> R_partition;
@@ -156,20 +174,21 @@ int main(int argc, char *argv[]) {
       R_partition.push_back(mc::RCREstimator::resistance_from_flow(R_total, o.quota_flow));
     }
 
-    std::cout << "R: ";
-    for (size_t k = 0; k < outlet_partitions.size(); k+=1)
-      std::cout << outlet_partitions[k].name << " = " << R_partition[k] << ", ";
-    std::cout << std::endl;
+    if (verbose) {
+      std::cout << "R: ";
+      for (size_t k = 0; k < outlet_partitions.size(); k+=1)
+        std::cout << outlet_partitions[k].name << " = " << R_partition[k] << ", ";
+      std::cout << std::endl;
 
-    std::cout << "C: ";
-    for (size_t k = 0; k < outlet_partitions.size(); k+=1)
-      std::cout << outlet_partitions[k].name << " = " << C_partition[k] << ", ";
-    std::cout << std::endl;
+      std::cout << "C: ";
+      for (size_t k = 0; k < outlet_partitions.size(); k+=1)
+        std::cout << outlet_partitions[k].name << " = " << C_partition[k] << ", ";
+      std::cout << std::endl;
+    }
 
     std::vector< double > total_flow(outlet_partitions.size(), 0);
     for (auto t : flows.flows) {
       auto id = t.first;
-      auto vertex = graph->get_vertex(id);
 
       for (size_t k = 0; k < outlet_partitions.size(); k+=1)
       {
@@ -179,40 +198,191 @@ int main(int argc, char *argv[]) {
       }
     }
 
-    std::cout << "total flows: ";
-    for (size_t k = 0; k < outlet_partitions.size(); k+=1)
-      std::cout << outlet_partitions[k].name << " = " << total_flow[k] << ", ";
-    std::cout << std::endl;
+    if (verbose) {
+      std::cout << "total flows: ";
+      for (size_t k = 0; k < outlet_partitions.size(); k+=1)
+        std::cout << outlet_partitions[k].name << " = " << total_flow[k] << ", ";
+      std::cout << std::endl;
+    }
 
     for (auto t : flows.flows) {
       auto vertex = graph->get_vertex(t.first);
       auto id = t.first;
       auto flow = t.second;
 
-      double ratio, R, C;
-
       for (size_t k = 0; k < outlet_partitions.size(); k+=1)
       {
         if (outlet_partitions[k].vessel_ids.find(id) != outlet_partitions[k].vessel_ids.end()) {
-          ratio = flow / total_flow[k];
-          R = mc::RCREstimator::resistance_from_flow(R_partition[k], ratio);
-          C = mc::RCREstimator::capacitance_from_flow(C_partition[k], ratio);
+          const double ratio = flow / total_flow[k];
+          const double R = mc::RCREstimator::resistance_from_flow(R_partition[k], ratio);
+          const double C = mc::RCREstimator::capacitance_from_flow(C_partition[k], ratio);
           rcr_parameters[id] = { R, C };
+
+          if (verbose)
+            std::cout << "vertex name = " << vertex->get_name()
+                      << ", id = " << vertex->get_id()
+                      << ", flow = " << flow
+                      << ", ratio = " << ratio
+                      << ", R = " << R
+                      << ", C = " << C
+                      << std::endl;
         }
       }
+    }
 
-      std::cout << "vertex name = " << vertex->get_name()
-                << ", id = " << vertex->get_id()
-                << ", flow = " << flow
-                << ", ratio = " << ratio
-                << ", R = " << R
-                << ", C = " << C
-                << std::endl;
+    return rcr_parameters;
+  };
+
+  // the calibrated outlets are free outflows in a single run, but windkessel outflows during the iterations
+  const auto get_outlet_flows = [&]() {
+    auto flows = flow_integrator.get_free_outflow_data();
+    const auto windkessel_flows = flow_integrator.get_windkessel_outflow_data();
+    flows.flows.insert(windkessel_flows.flows.begin(), windkessel_flows.flows.end());
+    flows.total_flow += windkessel_flows.total_flow;
+    return flows;
+  };
+
+  // changes the parameters of the windkessel models in place, such that the simulation continues from the current state
+  const auto apply_parameters = [&](const std::map< size_t, mc::RCRData > &parameters) {
+    for (const auto &it : parameters)
+      graph->get_vertex(it.first)->update_windkessel_parameters(it.second.resistance, it.second.capacitance);
+    flow_solver.update_0d_parameters();
+  };
+
+  const bool steady_estimate = args["steady-estimate"].as<bool>();
+  mc::SteadyFlowSolver steady_flow_solver(MPI_COMM_WORLD, graph, heart.get_period());
+
+  if (steady_estimate) {
+    // the mean flows of the network with the resistances of the vessels replace the simulation of many heart beats
+    steady_flow_solver.solve();
+    if (!uncalibrated_outlets.empty()) {
+      apply_parameters(estimate_parameters(steady_flow_solver.get_outflow_data(), false));
+      steady_flow_solver.solve();
     }
+    flow_solver.set_to_steady_flow(steady_flow_solver);
+  } else if (!uncalibrated_outlets.empty()) {
+    // without previous parameters, the flow is split uniformly within the partitions
+    mc::FlowData uniform_flows{{}, 0};
+    for (auto id : uncalibrated_outlets)
+      uniform_flows.flows[id] = 1.;
+    apply_parameters(estimate_parameters(uniform_flows, false));
+  }
 
-    mc::parameters_to_json(args["output-file"].as<std::string>(), rcr_parameters, graph);
+  const auto num_harmonics = args["impedance-harmonics"].as<std::size_t>();
+  if (num_harmonics > 0 && mc::mpi::rank(MPI_COMM_WORLD) == 0) {
+    // a quick estimate of the pulse wave of the current parameters without any time steps
+    mc::ImpedanceSolver impedance_solver(graph, heart.get_period(), num_harmonics);
+    impedance_solver.solve();
+    const auto inflow_id = graph->find_vertex_by_name(args["inflow-vertex-name"].as<std::string>())->get_id();
+    for (std::size_t k = 0; k <= num_harmonics; k += 1) {
+      const auto Z = impedance_solver.calculate_input_impedance(inflow_id, impedance_solver.get_angular_frequency(k));
+      std::cout << "harmonic " << k << ", |Z_in| = " << std::abs(Z) << ", arg(Z_in) = " << std::arg(Z) << std::endl;
+    }
+    double p_min = std::numeric_limits<double>::max();
+    double p_max = std::numeric_limits<double>::lowest();
+    for (std::size_t j = 0; j < 100; j += 1) {
+      const double p = impedance_solver.get_pressure(inflow_id, j * heart.get_period() / 100.);
+      p_min = std::min(p_min, p);
+      p_max = std::max(p_max, p);
+    }
+    std::cout << "linearized inflow pressure: min = " << p_min << ", max = " << p_max << ", mean = " << impedance_solver.get_pressure_harmonic(inflow_id, 0).real() << std::endl;
   }
 
+  const auto begin_t = std::chrono::steady_clock::now();
+  double t = 0;
+  const double cfl = args["cfl"].as<double>();
+
+  const double periodic_tol = args["periodic-tol"].as<double>();
+  mc::PeriodicStateMonitor periodic_state_monitor(MPI_COMM_WORLD, graph, heart.get_period());
+  periodic_state_monitor.set_tolerance(periodic_tol);
+
+  // advances the solution until t_stop and integrates the flows, where the first run stops early once the heart beats are periodic
+  std::size_t it = 0;
+  const auto run_until = [&](double t_stop, bool detect_periodicity) {
+    for (; it < max_iter; it += 1) {
+      double tau_used = tau;
+      if (cfl > 0) {
+        tau_used = flow_solver.solve_adaptive(tau, t, t_stop, cfl);
+      } else {
+        flow_solver.solve(tau, t);
+        t += tau;
+      }
+
+      // once the heart beats are periodic, only the flows of the next one are integrated
+      if (detect_periodicity && periodic_tol > 0 && !periodic_state_monitor.is_converged() && periodic_state_monitor.update(flow_solver, t)) {
+        if (mc::mpi::rank(MPI_COMM_WORLD) == 0)
+          std::cout << "heart beat " << periodic_state_monitor.get_num_periods() << ", difference to the previous one = " << periodic_state_monitor.get_difference() << std::endl;
+        if (periodic_state_monitor.is_converged()) {
+          t_stop = periodic_state_monitor.get_end_of_last_period() + heart.get_period();
+          flow_integrator.reset();
+        }
+      }
+
+      // add total flows
+      flow_integrator.update_flow(flow_solver, tau_used);
+
+      if (it % output_interval == 0) {
+        if (mc::mpi::rank(MPI_COMM_WORLD) == 0)
+          std::cout << "iter = " << it << ", t = " << t << std::endl;
+      }
+
+      // break
+      if (t > t_stop + 1e-12 || (cfl > 0 && t >= t_stop)) {
+        it += 1;
+        break;
+      }
+    }
+  };
+
+  // the flows are reduced on all ranks, hence every rank calculates the same parameters
+  std::map< size_t, mc::RCRData > rcr_parameters;
+  if (steady_estimate && t_end <= 0) {
+    rcr_parameters = estimate_parameters(steady_flow_solver.get_outflow_data(), mc::mpi::rank(MPI_COMM_WORLD) == 0);
+  } else if (args["shooting-cycles"].as<std::size_t>() > 0) {
+    // the 0D models are extrapolated to their periodic state, afterwards the flows of a single heart beat are integrated
+    mc::PeriodicStateSolver periodic_state_solver(MPI_COMM_WORLD, graph, dof_map_flow, heart.get_period());
+    periodic_state_solver.set_propagator(mc::PararealSolver::create_propagator(flow_solver, tau));
+    std::vector<double> u = flow_solver.get_solution();
+    t = periodic_state_solver.solve(t, u, periodic_tol, args["shooting-cycles"].as<std::size_t>());
+    flow_solver.get_solution() = u;
+    if (mc::mpi::rank(MPI_COMM_WORLD) == 0)
+      std::cout << "periodic state after " << periodic_state_solver.get_residuals().size() << " heart beats, residual = " << periodic_state_solver.get_residuals().back() << std::endl;
+    flow_integrator.reset();
+    run_until(t + heart.get_period(), false);
+    rcr_parameters = estimate_parameters(get_outlet_flows(), mc::mpi::rank(MPI_COMM_WORLD) == 0);
+  } else {
+    run_until(t_end, true);
+    rcr_parameters = estimate_parameters(get_outlet_flows(), mc::mpi::rank(MPI_COMM_WORLD) == 0);
+  }
+
+  for (std::size_t iteration = 0; iteration < num_iterations; iteration += 1) {
+    apply_parameters(rcr_parameters);
+
+    // warm restart from the current state, where only the flows of the last heart beat are integrated
+    const std::size_t num_cycles = std::max<std::size_t>(1, args["cycles-per-iteration"].as<std::size_t>());
+    if (num_cycles > 1)
+      run_until(t + static_cast<double>(num_cycles - 1) * heart.get_period(), false);
+    flow_integrator.reset();
+    run_until(t + heart.get_period(), false);
+
+    const auto new_parameters = estimate_parameters(get_outlet_flows(), false);
+
+    double max_change = 0;
+    for (const auto &it : new_parameters)
+      max_change = std::max(max_change, std::abs(it.second.resistance / rcr_parameters.at(it.first).resistance - 1.));
+    rcr_parameters = new_parameters;
+
+    if (mc::mpi::rank(MPI_COMM_WORLD) == 0)
+      std::cout << "calibration iteration " << iteration << ", t = " << t << ", max relative change of the resistances = " << max_change << std::endl;
+
+    if (max_change < args["calibration-tol"].as<double>())
+      break;
+  }
+
+  if (num_iterations > 0 && mc::mpi::rank(MPI_COMM_WORLD) == 0)
+    estimate_parameters(get_outlet_flows(), true);
+  mc::parameters_to_json(args["output-file"].as<std::string>(), rcr_parameters, graph);
+
   const auto end_t = std::chrono::steady_clock::now();
   const auto elapsed_ms = std::chrono::duration_cast<std::chrono::microseconds>(end_t - begin_t).count();
   if (mc::mpi::rank(MPI_COMM_WORLD) == 0)
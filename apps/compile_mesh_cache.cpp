@@ -0,0 +1,55 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cxxopts.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/embedded_graph_reader.hpp"
+#include "macrocirculation/graph_cache.hpp"
+#include "macrocirculation/graph_storage.hpp"
+
+namespace mc = macrocirculation;
+
+int main(int argc, char *argv[]) {
+  mc::mpi::initialize(&argc, &argv);
+
+  {
+    cxxopts::Options options(argv[0], "Compiles the json mesh and boundary files into a binary cache for a fast startup");
+    options.add_options()                                                                                                                     //
+      ("mesh-file", "path to the input file", cxxopts::value<std::string>()->default_value("./data/1d-meshes/33-vessels.json"))            //
+      ("boundary-file", "path to the file for the boundary conditions", cxxopts::value<std::string>()->default_value(""))                  //
+      ("output", "path of the cache, which can be passed to the mesh-cache option of the solvers", cxxopts::value<std::string>()->default_value("./data/1d-meshes/33-vessels.bin")) //
+      ("h,help", "print usage");
+    auto args = options.parse(argc, argv);
+    if (args.count("help")) {
+      std::cout << options.help() << std::endl;
+      exit(0);
+    }
+
+    const auto mesh_file_path = args["mesh-file"].as<std::string>();
+    const auto boundary_file_path = args["boundary-file"].as<std::string>();
+
+    mc::GraphStorage graph;
+    mc::EmbeddedGraphReader graph_reader;
+    graph_reader.append(mesh_file_path, graph);
+    std::vector<std::string> source_file_paths{mesh_file_path};
+    if (!boundary_file_path.empty()) {
+      graph_reader.set_boundary_data(boundary_file_path, graph);
+      source_file_paths.push_back(boundary_file_path);
+    }
+
+    if (mc::mpi::rank(MPI_COMM_WORLD) == 0) {
+      mc::write_graph_cache(args["output"].as<std::string>(), graph, mc::source_files_hash(source_file_paths));
+      std::cout << "wrote " << graph.num_vertices() << " vertices and " << graph.num_edges() << " edges to " << args["output"].as<std::string>() << std::endl;
+    }
+  }
+
+  MPI_Finalize();
+}
@@ -131,24 +131,18 @@ double run_scenario(std::size_t num_micro_edges_per_segment, double tau, bool us
       break;
   }
 
-  const double error_A = mc::errornorm(MPI_COMM_WORLD,
-                                       *graph,
-                                       solver.get_dof_map(),
-                                       1,
-                                       solver.get_solution(),
-                                       [&solver, &t](const std::vector<double> &p, std::vector<double> &out) {
-                                         for (std::size_t qp = 0; qp < p.size(); qp += 1)
-                                           out[qp] = get_analytic_solution_A(t, p[qp], length);
-                                       });
-  const double error_Q = mc::errornorm(MPI_COMM_WORLD,
-                                       *graph,
-                                       solver.get_dof_map(),
-                                       0,
-                                       solver.get_solution(),
-                                       [](const std::vector<double> &p, std::vector<double> &out) {
-                                         for (std::size_t qp = 0; qp < p.size(); qp += 1)
-                                           out[qp] = 0;
-                                       });
+  const mc::ErrornormEvaluator errornorm(MPI_COMM_WORLD, *graph, solver.get_dof_map());
+  const auto errors = errornorm.evaluate(solver.get_solution(),
+                                         {{solver.Q_component, [](const std::vector<double> &p, std::vector<double> &out) {
+                                             for (std::size_t qp = 0; qp < p.size(); qp += 1)
+                                               out[qp] = 0;
+                                           }},
+                                          {solver.A_component, [&t](const std::vector<double> &p, std::vector<double> &out) {
+                                             for (std::size_t qp = 0; qp < p.size(); qp += 1)
+                                               out[qp] = get_analytic_solution_A(t, p[qp], length);
+                                           }}});
+  const double error_Q = errors[0].l2;
+  const double error_A = errors[1].l2;
 
   return std::sqrt(std::pow(error_Q, 2) + std::pow(error_A, 2));
 }
@@ -208,6 +202,9 @@ void run_temporal_convergence_study(std::size_t num_micro_edges_per_segment, std
 
   std::ofstream f("temporal_convergence_error_dg" + std::to_string(degree) + ".csv");
 
+  // all the solvers share the dof map, hence the quadrature tables are only created once
+  const mc::ErrornormEvaluator errornorm(MPI_COMM_WORLD, *graph, *dof_map);
+
   for (std::size_t m = 0; m < m_max; m += 1) {
     const auto begin_t = std::chrono::steady_clock::now();
 
@@ -228,8 +225,9 @@ void run_temporal_convergence_study(std::size_t num_micro_edges_per_segment, std
 
     gmm::add(reference_solution, gmm::scaled(solver.get_solution(), -1), diff);
 
-    const double error_Q = mc::errornorm(MPI_COMM_WORLD, *graph, solver.get_dof_map(), 0, diff, zero_fct);
-    const double error_A = mc::errornorm(MPI_COMM_WORLD, *graph, solver.get_dof_map(), 1, diff, zero_fct);
+    const auto errors = errornorm.evaluate(diff, {{solver.Q_component, zero_fct}, {solver.A_component, zero_fct}});
+    const double error_Q = errors[0].l2;
+    const double error_A = errors[1].l2;
     const double error = std::sqrt(std::pow(error_Q, 2) + std::pow(error_A, 2));
 
     if (mc::mpi::rank(MPI_COMM_WORLD) == 0) {
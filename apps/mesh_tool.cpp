@@ -0,0 +1,144 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <cxxopts.hpp>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/embedded_graph_reader.hpp"
+#include "macrocirculation/graph_cache.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/mesh_tools.hpp"
+
+namespace mc = macrocirculation;
+
+namespace {
+
+/*! @brief Splits a specification like "a:b:5" at the colons, since cxxopts already splits the lists at the commas. */
+std::vector<std::string> split(const std::string &spec, std::size_t expected_size) {
+  std::vector<std::string> parts;
+  std::stringstream ss(spec);
+  std::string part;
+  while (std::getline(ss, part, ':'))
+    parts.push_back(part);
+  if (parts.size() != expected_size)
+    throw std::runtime_error("malformed specification " + spec);
+  return parts;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  mc::mpi::initialize(&argc, &argv);
+
+  {
+    cxxopts::Options options(argv[0], "Merges, refines and re-parametrizes json meshes, and writes them as json or as binary cache");
+    options.add_options()                                                                                                                                                 //
+      ("mesh-file", "paths to the input meshes, which are merged in the given order", cxxopts::value<std::vector<std::string>>()->default_value("./data/1d-meshes/33-vessels.json")) //
+      ("boundary-file", "path to the file for the boundary conditions, which is applied after merging", cxxopts::value<std::string>()->default_value(""))                     //
+      ("connect", "new vessels left:right:length:number_edges:radius between the named vertices", cxxopts::value<std::vector<std::string>>()->default_value(""))            //
+      ("elastic-modulus", "elastic modulus of the new vessels in Pa", cxxopts::value<double>()->default_value("1300000"))                                                   //
+      ("wall-thickness", "wall thickness of the new vessels in cm", cxxopts::value<double>()->default_value("0.005"))                                                       //
+      ("gamma", "shape of the flow profile in the new vessels", cxxopts::value<double>()->default_value("2"))                                                               //
+      ("mesh-width", "the largest micro edge length of the uniform refinement, where 0 keeps the micro edges", cxxopts::value<double>()->default_value("0"))                //
+      ("scale-windkessel", "scales the windkessels prefix:resistance_factor:compliance_factor, whose vertex names start with prefix", cxxopts::value<std::vector<std::string>>()->default_value("")) //
+      ("lump-radius", "lumps the terminal subtrees of vessels with a smaller radius into 0D outflows, where 0 keeps them", cxxopts::value<double>()->default_value("0"))          //
+      ("lump-wave-speed", "lumps the terminal subtrees of vessels with a faster wave speed into 0D outflows, where 0 keeps them", cxxopts::value<double>()->default_value("0")) //
+      ("lump-model", "the 0D model of the lumped subtrees, windkessel, tree or rcl", cxxopts::value<std::string>()->default_value("windkessel"))                            //
+      ("format", "the output format, json or cache", cxxopts::value<std::string>()->default_value("json"))                                                                 //
+      ("output", "path of the output mesh", cxxopts::value<std::string>()->default_value("./data/1d-meshes/mesh.json"))                                                    //
+      ("h,help", "print usage");
+    auto args = options.parse(argc, argv);
+    if (args.count("help")) {
+      std::cout << options.help() << std::endl;
+      exit(0);
+    }
+
+    const auto mesh_file_paths = args["mesh-file"].as<std::vector<std::string>>();
+    const auto boundary_file_path = args["boundary-file"].as<std::string>();
+    const auto format = args["format"].as<std::string>();
+    const auto output = args["output"].as<std::string>();
+    if (format != "json" && format != "cache")
+      throw std::runtime_error("unknown output format " + format);
+
+    mc::LumpingSettings lumping_settings;
+    lumping_settings.min_radius = args["lump-radius"].as<double>();
+    if (args["lump-wave-speed"].as<double>() > 0)
+      lumping_settings.max_wave_speed = args["lump-wave-speed"].as<double>();
+    const auto lump_model = args["lump-model"].as<std::string>();
+    if (lump_model == "tree")
+      lumping_settings.model = mc::LumpedOutflowModel::vessel_tree;
+    else if (lump_model == "rcl")
+      lumping_settings.model = mc::LumpedOutflowModel::rcl;
+    else if (lump_model != "windkessel")
+      throw std::runtime_error("unknown 0D model " + lump_model);
+
+    mc::GraphStorage graph;
+    mc::EmbeddedGraphReader graph_reader;
+    std::vector<std::string> source_file_paths;
+    for (const auto &mesh_file_path : mesh_file_paths) {
+      graph_reader.append(mesh_file_path, graph);
+      source_file_paths.push_back(mesh_file_path);
+    }
+    if (!boundary_file_path.empty()) {
+      graph_reader.set_boundary_data(boundary_file_path, graph);
+      source_file_paths.push_back(boundary_file_path);
+    }
+
+    for (const auto &spec : args["connect"].as<std::vector<std::string>>()) {
+      if (spec.empty())
+        continue;
+      const auto parts = split(spec, 5);
+      const auto data = mc::PhysicalData::set_from_data(args["elastic-modulus"].as<double>(), args["wall-thickness"].as<double>(), 1.028e-3, args["gamma"].as<double>(), std::stod(parts[4]), std::stod(parts[2]));
+      mc::connect_by_name(graph, parts[0], parts[1], std::stoul(parts[3]), data);
+    }
+
+    for (const auto &spec : args["scale-windkessel"].as<std::vector<std::string>>()) {
+      if (spec.empty())
+        continue;
+      const auto parts = split(spec, 3);
+      const auto num_scaled = mc::scale_windkessel_parameters(graph, parts[0], std::stod(parts[1]), std::stod(parts[2]));
+      std::cout << "scaled " << num_scaled << " windkessels with the prefix " << parts[0] << std::endl;
+    }
+
+    const auto mesh_width = args["mesh-width"].as<double>();
+    if (mesh_width > 0)
+      std::cout << "refined " << mc::refine_uniformly(graph, mesh_width) << " of " << graph.num_edges() << " edges" << std::endl;
+
+    // the lumped network is a compact copy, since the caches do not support removed edges
+    mc::GraphStorage lumped_graph;
+    if (lumping_settings.min_radius > 0 || std::isfinite(lumping_settings.max_wave_speed)) {
+      const auto report = mc::lump_peripheral_subtrees(graph, lumping_settings, lumped_graph);
+      if (mc::mpi::rank(MPI_COMM_WORLD) == 0) {
+        for (const auto &subtree : report.subtrees)
+          std::cout << "lumped " << subtree.num_lumped_vessels << " vessels at " << subtree.vertex_name
+                    << " (R = " << subtree.resistance << ", C = " << subtree.compliance
+                    << ", resistance error = " << subtree.resistance_error << ", impedance error = " << subtree.impedance_error << ")" << std::endl;
+        std::cout << "lumped " << report.num_lumped_vessels << " vessels into " << report.subtrees.size() << " outflows, "
+                  << "the largest c0/h changed from " << report.max_cfl_rate_before << " to " << report.max_cfl_rate_after << std::endl;
+        if (format == "json" && lumping_settings.model != mc::LumpedOutflowModel::windkessel)
+          std::cout << "warning: json meshes only store windkessel outflows, use the cache format for the lumped 0D models" << std::endl;
+      }
+    }
+    const auto &output_graph = lumped_graph.num_edges() > 0 ? lumped_graph : graph;
+
+    if (mc::mpi::rank(MPI_COMM_WORLD) == 0) {
+      if (format == "json")
+        mc::write_mesh_json(output, output_graph);
+      else
+        mc::write_graph_cache(output, output_graph, mc::source_files_hash(source_file_paths));
+      std::cout << "wrote " << output_graph.num_vertices() << " vertices and " << output_graph.num_edges() << " edges to " << output << std::endl;
+    }
+  }
+
+  MPI_Finalize();
+}
@@ -5,29 +5,55 @@
 //  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
 #include <chrono>
+#include <csignal>
 #include <cxxopts.hpp>
+#include <fstream>
 #include <memory>
+#include <optional>
 
+#include "macrocirculation/async_output.hpp"
+#include "macrocirculation/checkpoint.hpp"
 #include "macrocirculation/communication/mpi.hpp"
 #include "macrocirculation/csv_vessel_tip_writer.hpp"
+#include "macrocirculation/cycle_statistics.hpp"
+#include "macrocirculation/derived_quantities.hpp"
 #include "macrocirculation/dof_map.hpp"
 #include "macrocirculation/embedded_graph_reader.hpp"
 #include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_binary_writer.hpp"
+#include "macrocirculation/graph_cache.hpp"
 #include "macrocirculation/graph_csv_writer.hpp"
 #include "macrocirculation/graph_partitioner.hpp"
 #include "macrocirculation/graph_pvd_writer.hpp"
 #include "macrocirculation/graph_storage.hpp"
 #include "macrocirculation/interpolate_to_vertices.hpp"
+#include "macrocirculation/interpolation_plan.hpp"
+#include "macrocirculation/metrics_exporter.hpp"
+#include "macrocirculation/numa.hpp"
+#include "macrocirculation/periodic_state_monitor.hpp"
+#include "macrocirculation/phase_timers.hpp"
+#include "macrocirculation/phase_trace.hpp"
+#include "macrocirculation/probe_writer.hpp"
 #include "macrocirculation/quantities_of_interest.hpp"
 #include "macrocirculation/vessel_formulas.hpp"
 #include "macrocirculation/rcr_estimator.hpp"
+#include "macrocirculation/right_hand_side_evaluator.hpp"
+#include "macrocirculation/snapshot_history.hpp"
+#include "macrocirculation/steady_flow_solver.hpp"
+#include "macrocirculation/synthetic_network.hpp"
 #include <nlohmann/json.hpp>
 
 namespace mc = macrocirculation;
 
 constexpr std::size_t degree = 2;
 
+/*! @brief Set by SIGUSR1, which requests writing the snapshot history. */
+volatile std::sig_atomic_t snapshot_requested = 0;
+
+void request_snapshots(int) { snapshot_requested = 1; }
+
 void output_flows(const std::string &filepath, const mc::GraphStorage &graph, const mc::FlowData &flows, double t_end, double t_start_averaging) {
   using json = nlohmann::json;
 
@@ -60,20 +86,61 @@ void output_flows(const std::string &filepath, const mc::GraphStorage &graph, co
 }
 
 int main(int argc, char *argv[]) {
-  MPI_Init(&argc, &argv);
+  // only the main thread communicates, the threads of the solver do the edge loops,
+  // but the thread of an asynchronous output queries the ranks concurrently
+  const int provided_thread_level = mc::mpi::initialize(&argc, &argv, MPI_THREAD_FUNNELED, MPI_THREAD_MULTIPLE);
 
   {
     cxxopts::Options options(argv[0], "Nonlinear 1D solver");
     options.add_options()                                                                                                                                           //
       ("mesh-file", "path to the input file", cxxopts::value<std::string>()->default_value("./data/1d-meshes/33-vessels.json"))                               //
       ("boundary-file", "path to the file for the boundary conditions", cxxopts::value<std::string>()->default_value(""))                                           //
+      ("mesh-cache", "path to a binary cache of the mesh and boundary files, which is created if it is missing or outdated", cxxopts::value<std::string>()->default_value("")) //
+      ("partition-file", "path to the edge to rank assignment, which is reused if the mesh, the partitioner settings and the number of ranks agree and is created otherwise", cxxopts::value<std::string>()->default_value("")) //
       ("output-directory", "directory for the output", cxxopts::value<std::string>()->default_value("./output/"))                                                   //
       ("inlet-name", "the name of the inlet", cxxopts::value<std::string>()->default_value("cw_in"))                                                                //
       ("heart-amplitude", "the amplitude of a heartbeat", cxxopts::value<double>()->default_value("485.0"))                                                         //
       ("tau", "time step size", cxxopts::value<double>()->default_value(std::to_string(2.5e-4 / 16.)))                                                              //
       ("tau-out", "time step size for the output", cxxopts::value<double>()->default_value("1e-2"))                                                                 //
+      ("cfl", "if positive, the time step is adapted to the given cfl number and tau is only an upper bound", cxxopts::value<double>()->default_value("0"))    //
       ("t-start-averaging", "Time when to start averaging flows", cxxopts::value<double>()->default_value("0"))                                                                             //
+      ("periodic-tol", "if positive, the flows are averaged over a single heart beat once two successive heart beats differ less than this tolerance, and the simulation stops afterwards", cxxopts::value<double>()->default_value("0")) //
       ("t-end", "Endtime for simulation", cxxopts::value<double>()->default_value("0.01"))                                                                             //
+      ("num-threads", "number of threads per rank for the edge loops", cxxopts::value<std::size_t>()->default_value("1"))                                           //
+      ("pin-threads", "binds the threads to the given cores of a node, e.g. 0-15, where the ranks of a node use consecutive blocks of num-threads cores", cxxopts::value<std::string>()->default_value("")) //
+      ("implicit-0d", "treats the windkessel and vessel tree models implicitly, such that their capacitances do not restrict tau", cxxopts::value<bool>()->default_value("false")) //
+      ("exponential-0d", "integrates the linearized windkessel and vessel tree models exactly within each stage, overrides implicit-0d", cxxopts::value<bool>()->default_value("false")) //
+      ("quadrature", "quadrature of the cells, either gauss with the fewest points sufficient for the degree, over-integration against aliasing, or lobatto, which collocates the fluxes at the nodes with a lumped mass", cxxopts::value<std::string>()->default_value("gauss")) //
+      ("steady-initial-condition", "starts from the mean pressures and flows of a steady solve of the network instead of the vessels at rest", cxxopts::value<bool>()->default_value("false")) //
+      ("heart-samples", "interpolates the heart beat linearly between this many equidistant samples of a period, 0 evaluates it exactly", cxxopts::value<std::size_t>()->default_value("0")) //
+      ("binary-output", "writes the vessel data into one binary file per rank instead of one csv file per vessel and component", cxxopts::value<bool>()->default_value("false")) //
+      ("shared-output", "writes the binary vessel data of all ranks into a single file with MPI-IO, implies binary-output", cxxopts::value<bool>()->default_value("false")) //
+      ("area-tolerance", "absolute error of the binary area output, which is quantized and delta encoded if positive, 0 keeps it lossless", cxxopts::value<double>()->default_value("0")) //
+      ("flow-tolerance", "absolute error of the binary flow output, which is quantized and delta encoded if positive, 0 keeps it lossless", cxxopts::value<double>()->default_value("0")) //
+      ("output-points-per-cm", "samples the vessels of the vtp, csv and binary output at this many equidistant points per cm instead of the endpoints of every micro edge, 0 disables it", cxxopts::value<double>()->default_value("0")) //
+      ("output-points-per-vessel", "samples every vessel of the vtp, csv and binary output at least at this many equidistant points, 0 disables it", cxxopts::value<std::size_t>()->default_value("0")) //
+      ("gathered-tip-output", "gathers the values at the vessel tips of all ranks on rank 0, which writes a single file per quantity instead of a file per vessel tip", cxxopts::value<bool>()->default_value("false")) //
+      ("vtk-format", "encoding of the vtp files, either ascii, base64 or raw", cxxopts::value<std::string>()->default_value("ascii")) //
+      ("vtk-fields", "comma separated fields of the vtp files out of Q, A, p_static, p_total, velocity and c", cxxopts::value<std::string>()->default_value("Q,A,p_static,p_total,c")) //
+      ("cycle-statistics", "writes the minimum, maximum and mean pressures and flows of every heart beat on every micro edge", cxxopts::value<bool>()->default_value("false")) //
+      ("field-output", "writes the full fields at the output times, can be disabled in favor of the cycle statistics", cxxopts::value<bool>()->default_value("true")) //
+      ("probes", "json file with a list of probes, given either by {\"edge\": <vessel name>, \"s\": <coordinate in [0,1]>} or by {\"point\": [x, y, z]}, which are recorded after every time step", cxxopts::value<std::string>()->default_value("")) //
+      ("snapshot-history", "number of recent solutions, which are kept in memory and written as checkpoints snapshot_<k> to the output directory, when a rank receives SIGUSR1, 0 disables it", cxxopts::value<std::size_t>()->default_value("0")) //
+      ("snapshot-interval", "number of time steps between two solutions of the snapshot history", cxxopts::value<std::size_t>()->default_value("1")) //
+      ("output-buffers", "number of solution snapshots, which are buffered for writing them on a separate thread, 0 writes synchronously", cxxopts::value<std::size_t>()->default_value("0")) //
+      ("max-time-step-level", "largest level of the local time stepping, where tau is the step of the finest level, 0 disables it", cxxopts::value<std::size_t>()->default_value("0")) //
+      ("max-micro-edges", "splits the vessels into parts with at most this many micro edges, such that long vessels can be distributed over several ranks, 0 disables it", cxxopts::value<std::size_t>()->default_value("0")) //
+      ("synthetic-tree-depth", "if positive, replaces the mesh by a synthetic arterial tree with this many generations and the inlet \"in\"", cxxopts::value<std::size_t>()->default_value("0")) //
+      ("synthetic-tree-branching", "the branching factor of the synthetic arterial tree", cxxopts::value<std::size_t>()->default_value("2")) //
+      ("synthetic-tree-outlet", "the outflow model of the synthetic arterial tree, either windkessel or vessel-tree", cxxopts::value<std::string>()->default_value("windkessel")) //
+      ("phase-timers", "json file for the times of the solver phases over the ranks, which are only recorded if the library was built with LibMacrocirculation_Enable_Phase_Timers", cxxopts::value<std::string>()->default_value("")) //
+      ("trace", "chrome tracing json file for the timeline of the solver phases on all ranks and threads, which needs a library built with LibMacrocirculation_Enable_Phase_Timers", cxxopts::value<std::string>()->default_value("")) //
+      ("trace-t-start", "the time at which the trace starts", cxxopts::value<double>()->default_value("0")) //
+      ("trace-t-end", "the time at which the trace stops", cxxopts::value<double>()->default_value("1e300")) //
+      ("trace-capacity", "the number of phases kept per thread, where the oldest ones are dropped first", cxxopts::value<std::size_t>()->default_value("1000000")) //
+      ("metrics-file", "file for the progress, throughput, newton statistics, memory and cfl number of the run, which are written periodically, empty disables it", cxxopts::value<std::string>()->default_value("")) //
+      ("metrics-format", "format of the metrics file, either json-lines, which appends every export as a line, or prometheus, which replaces the file with the latest export", cxxopts::value<std::string>()->default_value("json-lines")) //
+      ("metrics-interval", "wall clock seconds between two exports of the metrics", cxxopts::value<double>()->default_value("60")) //
       ("h,help", "print usage");
     options.allow_unrecognised_options(); // for petsc
     auto args = options.parse(argc, argv);
@@ -88,63 +155,204 @@ int main(int argc, char *argv[]) {
       std::cout << "\nAre they part of petsc or a different auxillary library?" << std::endl;
     }
 
+    // the setup phases are timed, and reported before the time loop starts
+    std::optional<mc::ScopedPhaseTimer> setup_timer;
+    setup_timer.emplace("setup");
+    std::optional<mc::ScopedPhaseTimer> setup_phase_timer;
+
     // create_for_node the ascending aorta
     auto graph = std::make_shared<mc::GraphStorage>();
 
-    mc::EmbeddedGraphReader graph_reader;
-    graph_reader.append(args["mesh-file"].as<std::string>(), *graph);
+    const auto synthetic_tree_depth = args["synthetic-tree-depth"].as<std::size_t>();
 
-    // read in other data
     auto boundary_file_path = args["boundary-file"].as<std::string>();
-    if (!boundary_file_path.empty()) {
-      std::cout << "Using separate file at " << boundary_file_path << " for boundary conditions." << std::endl;
-      graph_reader.set_boundary_data(boundary_file_path, *graph);
+
+    // the cache is rebuilt whenever one of the json files changes
+    const auto mesh_cache_path = args["mesh-cache"].as<std::string>();
+    std::vector<std::string> source_file_paths{args["mesh-file"].as<std::string>()};
+    if (!boundary_file_path.empty())
+      source_file_paths.push_back(boundary_file_path);
+    const auto source_hash = mesh_cache_path.empty() ? 0 : mc::source_files_hash(source_file_paths);
+
+    if (synthetic_tree_depth > 0) {
+      mc::SyntheticTreeParameters parameters;
+      parameters.depth = synthetic_tree_depth;
+      parameters.branching_factor = args["synthetic-tree-branching"].as<std::size_t>();
+      const auto outlet = args["synthetic-tree-outlet"].as<std::string>();
+      if (outlet == "vessel-tree")
+        parameters.outlet = mc::SyntheticTreeOutlet::vessel_tree;
+      else if (outlet != "windkessel")
+        throw std::runtime_error("unknown synthetic tree outlet " + outlet);
+      graph = mc::create_synthetic_arterial_tree(parameters);
+      std::cout << "Using a synthetic arterial tree with " << graph->num_edges() << " vessels." << std::endl;
+    } else if (!mesh_cache_path.empty() && mc::read_graph_cache(mesh_cache_path, source_hash, *graph)) {
+      std::cout << "Using the cached mesh at " << mesh_cache_path << "." << std::endl;
+    } else {
+      mc::EmbeddedGraphReader graph_reader;
+      graph_reader.append(args["mesh-file"].as<std::string>(), *graph);
+
+      // read in other data
+      if (!boundary_file_path.empty()) {
+        std::cout << "Using separate file at " << boundary_file_path << " for boundary conditions." << std::endl;
+        graph_reader.set_boundary_data(boundary_file_path, *graph);
+      }
+
+      if (!mesh_cache_path.empty() && mc::mpi::rank(MPI_COMM_WORLD) == 0)
+        mc::write_graph_cache(mesh_cache_path, *graph, source_hash);
     }
 
-    graph->find_vertex_by_name(args["inlet-name"].as<std::string>())->set_to_inflow_with_fixed_flow(mc::heart_beat_inflow(args["heart-amplitude"].as<double>()));
+    const auto heart = mc::heart_beat_inflow(args["heart-amplitude"].as<double>());
+    const auto heart_samples = args["heart-samples"].as<std::size_t>();
+    const auto inlet_name = synthetic_tree_depth > 0 ? std::string("in") : args["inlet-name"].as<std::string>();
+    if (heart_samples > 0)
+      graph->find_vertex_by_name(inlet_name)->set_to_inflow_with_fixed_flow(heart.tabulate(heart_samples));
+    else
+      graph->find_vertex_by_name(inlet_name)->set_to_inflow_with_fixed_flow(heart);
+
+    if (args["max-micro-edges"].as<std::size_t>() > 0)
+      mc::split_long_edges(*graph, args["max-micro-edges"].as<std::size_t>());
 
     // set_0d_tree_boundary_conditions(graph, "bg_");
     graph->finalize_bcs();
 
     // mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
-    mc::flow_mesh_partitioner(MPI_COMM_WORLD, *graph, degree);
+    const auto max_time_step_level = args["max-time-step-level"].as<std::size_t>();
+
+    // the partition of a previous run is reused, such that repeated runs have the same decomposition
+    const auto partition_path = args["partition-file"].as<std::string>();
+    const auto partition_hash = partition_path.empty() ? 0 : mc::mesh_hash(*graph, {degree, max_time_step_level});
+    if (!partition_path.empty() && mc::read_partition(MPI_COMM_WORLD, partition_path, partition_hash, *graph)) {
+      if (mc::mpi::rank(MPI_COMM_WORLD) == 0)
+        std::cout << "Using the partition at " << partition_path << "." << std::endl;
+    } else {
+      mc::flow_mesh_partitioner(MPI_COMM_WORLD, *graph, degree, max_time_step_level);
+      if (!partition_path.empty())
+        mc::write_partition(MPI_COMM_WORLD, partition_path, *graph, partition_hash);
+    }
+
+    // neighboring vessels should be close in the dof vector
+    graph->set_edge_order(mc::locality_edge_order(*graph));
 
     auto dof_map_flow = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
     dof_map_flow->create(MPI_COMM_WORLD, *graph, 2, degree, false);
 
-    const double t_start_averaging = args["t-start-averaging"].as<double>();
+    double t_start_averaging = args["t-start-averaging"].as<double>();
 
-    const double t_end = args["t-end"].as<double>();
+    double t_end = args["t-end"].as<double>();
     const std::size_t max_iter = 160000000;
 
     const auto tau = args["tau"].as<double>();
     const auto tau_out = args["tau-out"].as<double>();
 
-    const auto output_interval = static_cast<std::size_t>(tau_out / tau);
+    // with local time stepping a single iteration advances by 2^max_level tau
+    const double tau_iteration = tau * static_cast<double>(std::size_t(1) << max_time_step_level);
+    const auto output_interval = std::max<std::size_t>(1, static_cast<std::size_t>(tau_out / tau_iteration));
     std::cout << "tau = " << tau << ", tau_out = " << tau_out << ", output_interval = " << output_interval << std::endl;
 
     // configure solver
+    setup_phase_timer.emplace("flow solver");
     auto flow_solver = std::make_shared<mc::ExplicitNonlinearFlowSolver>(MPI_COMM_WORLD, graph, dof_map_flow, degree);
     flow_solver->use_ssp_method();
+    const auto num_threads = args["num-threads"].as<std::size_t>();
+    flow_solver->set_num_threads(num_threads, mc::select_cores_of_rank(MPI_COMM_WORLD, mc::parse_core_list(args["pin-threads"].as<std::string>()), num_threads));
+    flow_solver->set_implicit_0d_models(args["implicit-0d"].as<bool>());
+    if (args["exponential-0d"].as<bool>())
+      flow_solver->set_exponential_0d_models(true);
+    flow_solver->set_max_time_step_level(max_time_step_level);
+    const auto quadrature = args["quadrature"].as<std::string>();
+    if (quadrature == "lobatto")
+      flow_solver->set_quadrature_type(mc::QuadratureType::gauss_lobatto);
+    else if (quadrature == "over-integration")
+      flow_solver->set_quadrature_type(mc::QuadratureType::gauss_over_integration);
+    else if (quadrature != "gauss")
+      throw std::runtime_error("unknown quadrature " + quadrature);
+    if (args["steady-initial-condition"].as<bool>()) {
+      mc::SteadyFlowSolver steady_flow_solver(MPI_COMM_WORLD, graph, heart.get_period());
+      steady_flow_solver.solve();
+      flow_solver->set_to_steady_flow(steady_flow_solver);
+    }
+
+    setup_phase_timer.emplace("output setup");
+
+    // the output points are independent of the micro edges of the solver, if a resolution is given
+    mc::OutputResolution output_resolution;
+    output_resolution.points_per_cm = args["output-points-per-cm"].as<double>();
+    output_resolution.points_per_vessel = args["output-points-per-vessel"].as<std::size_t>();
+
+    // the points and basis functions of the vtk output are evaluated once
+    const auto interpolation_plan = std::make_shared<const mc::InterpolationPlan>(MPI_COMM_WORLD, *graph, *dof_map_flow, output_resolution);
+
+    // only the fields of the vtk output are evaluated
+    mc::DerivedQuantities vertex_values(interpolation_plan);
+    vertex_values.subscribe_list(args["vtk-fields"].as<std::string>());
 
-    std::vector<mc::Point> points;
-    std::vector<double> Q_vertex_values;
-    std::vector<double> A_vertex_values;
-    std::vector<double> p_total_vertex_values;
-    std::vector<double> p_static_vertex_values;
-    std::vector<double> c_vertex_values;
     std::vector<double> vessel_ids;
 
     // vessels ids do not change, thus we can precalculate them
-    mc::fill_with_vessel_id(MPI_COMM_WORLD, *graph, points, vessel_ids);
+    interpolation_plan->fill_with_vessel_id(vessel_ids);
 
+    // both writers have the same index file, hence only one of them is set up
+    const bool shared_output = args["shared-output"].as<bool>();
+    const bool binary_output = args["binary-output"].as<bool>() || shared_output;
     mc::GraphCSVWriter csv_writer(MPI_COMM_WORLD, args["output-directory"].as<std::string>(), "abstract_33_vessels", graph);
-    csv_writer.add_setup_data(dof_map_flow, flow_solver->A_component, "a");
-    csv_writer.add_setup_data(dof_map_flow, flow_solver->Q_component, "q");
-    csv_writer.setup();
+    mc::GraphBinaryWriter binary_writer(MPI_COMM_WORLD, args["output-directory"].as<std::string>(), "abstract_33_vessels", graph);
+    if (binary_output) {
+      binary_writer.add_setup_data(dof_map_flow, flow_solver->A_component, "a", args["area-tolerance"].as<double>());
+      binary_writer.add_setup_data(dof_map_flow, flow_solver->Q_component, "q", args["flow-tolerance"].as<double>());
+      binary_writer.set_shared_file(shared_output);
+      binary_writer.set_output_resolution(output_resolution);
+      binary_writer.setup();
+    } else {
+      csv_writer.add_setup_data(dof_map_flow, flow_solver->A_component, "a");
+      csv_writer.add_setup_data(dof_map_flow, flow_solver->Q_component, "q");
+      csv_writer.set_output_resolution(output_resolution);
+      csv_writer.setup();
+    }
 
     mc::GraphPVDWriter pvd_writer(MPI_COMM_WORLD, args["output-directory"].as<std::string>(), "abstract_33_vessels");
+    const auto vtk_format = args["vtk-format"].as<std::string>();
+    if (vtk_format == "base64")
+      pvd_writer.set_format(mc::GraphPVDWriter::Format::base64);
+    else if (vtk_format == "raw")
+      pvd_writer.set_format(mc::GraphPVDWriter::Format::raw_appended);
+    else if (vtk_format != "ascii")
+      throw std::runtime_error("unknown vtk format " + vtk_format);
+    std::unique_ptr<mc::ProbeWriter> probe_writer;
+    if (!args["probes"].as<std::string>().empty()) {
+      probe_writer = std::make_unique<mc::ProbeWriter>(MPI_COMM_WORLD, args["output-directory"].as<std::string>(), "abstract_33_vessels_probes", graph, dof_map_flow);
+      std::ifstream probe_file(args["probes"].as<std::string>());
+      if (!probe_file)
+        throw std::runtime_error("could not open " + args["probes"].as<std::string>());
+      for (const auto &probe : nlohmann::json::parse(probe_file)) {
+        const auto name = probe.value("name", std::string());
+        if (probe.contains("point"))
+          probe_writer->add_probe(mc::Point(probe["point"][0], probe["point"][1], probe["point"][2]), name);
+        else
+          probe_writer->add_probe(probe["edge"].get<std::string>(), probe["s"].get<double>(), name);
+      }
+      probe_writer->setup();
+    }
+    // the checkpoints of the snapshots can be read on any partitioning, hence the states before an event can be rerun with dense output
+    if (args["snapshot-history"].as<std::size_t>() > 0) {
+      auto &history = flow_solver->get_snapshot_history();
+      history.configure(args["snapshot-history"].as<std::size_t>(), args["snapshot-interval"].as<std::size_t>());
+      std::size_t num_snapshots = 0;
+      history.set_write_function([&, num_snapshots](double t_snapshot, const std::vector<double> &u) mutable {
+        const auto path = args["output-directory"].as<std::string>() + "/snapshot_" + std::to_string(num_snapshots++);
+        mc::write_checkpoint(MPI_COMM_WORLD, path, *graph, *dof_map_flow, u, t_snapshot);
+        if (mc::mpi::rank(MPI_COMM_WORLD) == 0)
+          std::cout << "wrote the snapshot at t = " << t_snapshot << " to " << path << std::endl;
+      });
+      history.set_predicate([](double, const std::vector<double> &) {
+        const bool requested = snapshot_requested != 0;
+        snapshot_requested = 0;
+        return requested;
+      });
+      std::signal(SIGUSR1, request_snapshots);
+    }
+
     mc::CSVVesselTipWriter vessel_tip_writer(MPI_COMM_WORLD, "output", "abstract_33_vessels_tips", graph, dof_map_flow);
+    vessel_tip_writer.set_gathered(args["gathered-tip-output"].as<bool>());
 
     // output for 0D-Model:
     std::vector<double> list_t;
@@ -168,29 +376,53 @@ int main(int argc, char *argv[]) {
 
     double t = 0;
 
-    const auto write_output = [&](){
-      csv_writer.add_data("a", flow_solver->get_solution());
-      csv_writer.add_data("q", flow_solver->get_solution());
-      csv_writer.write(t);
-
-      mc::interpolate_to_vertices(MPI_COMM_WORLD, *graph, *dof_map_flow, 0, flow_solver->get_solution(), points, Q_vertex_values);
-      mc::interpolate_to_vertices(MPI_COMM_WORLD, *graph, *dof_map_flow, 1, flow_solver->get_solution(), points, A_vertex_values);
-      mc::calculate_total_pressure(MPI_COMM_WORLD, *graph, *dof_map_flow, flow_solver->get_solution(), points, p_total_vertex_values);
-      mc::calculate_static_pressure(MPI_COMM_WORLD, *graph, *dof_map_flow, flow_solver->get_solution(), points, p_static_vertex_values);
-
-      pvd_writer.set_points(points);
-      pvd_writer.add_vertex_data("Q", Q_vertex_values);
-      pvd_writer.add_vertex_data("A", A_vertex_values);
-      pvd_writer.add_vertex_data("p_static", p_static_vertex_values);
-      pvd_writer.add_vertex_data("p_total", p_total_vertex_values);
-      pvd_writer.add_vertex_data("c", c_vertex_values);
+    // writes the given snapshot u of the solution, possibly on the output thread, and hence must not communicate
+    // on the communicators of the solver, the shared binary file has its own one
+    const auto write_output = [&](double t_out, const std::vector<double> &u) {
+      if (binary_output) {
+        binary_writer.add_data("a", u);
+        binary_writer.add_data("q", u);
+        binary_writer.write(t_out);
+      } else {
+        csv_writer.add_data("a", u);
+        csv_writer.add_data("q", u);
+        csv_writer.write(t_out);
+      }
+
+      vertex_values.update(u);
+
+      pvd_writer.set_points(interpolation_plan->get_points());
+      for (const auto &name : vertex_values.get_subscriptions())
+        pvd_writer.add_vertex_data(name, vertex_values.get(name));
       pvd_writer.add_vertex_data("vessel_id", vessel_ids);
-      pvd_writer.write(t);
+      pvd_writer.write(t_out);
 
-      vessel_tip_writer.write(t, flow_solver->get_solution());
+      vessel_tip_writer.write(t_out, u);
     };
 
-    write_output();
+    std::size_t num_output_buffers = args["output-buffers"].as<std::size_t>();
+    if (num_output_buffers > 0 && provided_thread_level < MPI_THREAD_MULTIPLE) {
+      if (mc::mpi::rank(MPI_COMM_WORLD) == 0)
+        std::cout << "warning: MPI does not support MPI_THREAD_MULTIPLE, hence the output is written synchronously" << std::endl;
+      num_output_buffers = 0;
+    }
+    mc::AsyncOutput output(write_output, num_output_buffers);
+
+    const bool field_output = args["field-output"].as<bool>();
+    if (field_output)
+      output.push(t, flow_solver->get_solution());
+
+    std::unique_ptr<mc::CycleStatistics> cycle_statistics;
+    if (args["cycle-statistics"].as<bool>())
+      cycle_statistics = std::make_unique<mc::CycleStatistics>(MPI_COMM_WORLD, args["output-directory"].as<std::string>(), "abstract_33_vessels_cycles", graph, dof_map_flow, heart.get_period());
+    if (cycle_statistics)
+      cycle_statistics->update(t, flow_solver->get_solution());
+    if (probe_writer)
+      probe_writer->write(t, flow_solver->get_solution());
+
+    setup_phase_timer.reset();
+    setup_timer.reset();
+    mc::PhaseTimers::print(MPI_COMM_WORLD, std::cout);
 
     double flow_solution_time = 0;
     size_t num_iteration = 0;
@@ -199,39 +431,119 @@ int main(int argc, char *argv[]) {
 
     mc::FlowIntegrator flow_integrator(graph);
 
+    const double cfl = args["cfl"].as<double>();
+    std::size_t num_outputs = 0;
+
+    const double periodic_tol = args["periodic-tol"].as<double>();
+    mc::PeriodicStateMonitor periodic_state_monitor(MPI_COMM_WORLD, graph, heart.get_period());
+    periodic_state_monitor.set_tolerance(periodic_tol);
+
+    std::unique_ptr<mc::MetricsExporter> metrics_exporter;
+    if (!args["metrics-file"].as<std::string>().empty()) {
+      const auto metrics_format = args["metrics-format"].as<std::string>();
+      if (metrics_format != "json-lines" && metrics_format != "prometheus")
+        throw std::runtime_error("unknown metrics format " + metrics_format);
+      metrics_exporter = std::make_unique<mc::MetricsExporter>(MPI_COMM_WORLD, args["metrics-file"].as<std::string>(), metrics_format == "prometheus" ? mc::MetricsFormat::prometheus : mc::MetricsFormat::json_lines);
+      metrics_exporter->set_interval(args["metrics-interval"].as<double>());
+    }
+    // with local time stepping the cfl number refers to the step of the finest level
+    double tau_cfl = tau;
+
+    // the time is the same on all ranks, hence they start and stop the trace in the same step
+    const auto trace_path = args["trace"].as<std::string>();
+    bool trace_started = false;
+
     for (std::size_t it = 0; it < max_iter; it += 1) {
+      if (!trace_path.empty() && !trace_started && t >= args["trace-t-start"].as<double>()) {
+        mc::PhaseTrace::start(MPI_COMM_WORLD, args["trace-capacity"].as<std::size_t>());
+        trace_started = true;
+      }
+      if (mc::PhaseTrace::is_recording() && t > args["trace-t-end"].as<double>())
+        mc::PhaseTrace::stop();
+
       auto start = std::chrono::high_resolution_clock::now();
-      flow_solver->solve(tau, t);
+      double tau_used = tau;
+      bool is_output_step = it % output_interval == 0;
+      if (cfl > 0) {
+        // adaptive time steps, which hit the output times exactly
+        const double t_out = std::min((num_outputs + 1) * tau_out, t_end);
+        tau_used = flow_solver->solve_adaptive(tau, t, t_out, cfl);
+        is_output_step = (t == t_out);
+      } else {
+        tau_used = flow_solver->solve_multirate(tau, t);
+        t += tau_used;
+      }
       auto end = std::chrono::high_resolution_clock::now();
       std::chrono::duration<double> elapsed = (end - start);
       flow_solution_time += elapsed.count();
       num_iteration += 1;
 
-      t += tau;
+      if (cycle_statistics)
+        cycle_statistics->update(t, flow_solver->get_solution());
+
+      if (probe_writer)
+        probe_writer->write(t, flow_solver->get_solution());
+
+      tau_cfl = cfl > 0 ? tau_used : tau;
+      if (metrics_exporter)
+        metrics_exporter->step(*flow_solver, t, tau_cfl);
 
-      if (it % output_interval == 0) {
-        std::cout << "iter = " << it << ", t = " << t << std::endl;
+      if (is_output_step) {
+        std::cout << "iter = " << it << ", t = " << t << ", tau = " << tau_used << std::endl;
 
-        write_output();
+        if (field_output)
+          output.push(t, flow_solver->get_solution());
+        num_outputs += 1;
       }
 
       // break
-      if (t > t_end + 1e-12)
+      if (t > t_end + 1e-12 || (cfl > 0 && t >= t_end))
         break;
 
+      // once the heart beats are periodic, we average over the next one and stop
+      if (periodic_tol > 0 && !periodic_state_monitor.is_converged() && periodic_state_monitor.update(*flow_solver, t)) {
+        if (mc::mpi::rank(MPI_COMM_WORLD) == 0)
+          std::cout << "heart beat " << periodic_state_monitor.get_num_periods() << ", difference to the previous one = " << periodic_state_monitor.get_difference() << std::endl;
+        if (periodic_state_monitor.is_converged()) {
+          t_start_averaging = periodic_state_monitor.get_end_of_last_period();
+          t_end = t_start_averaging + heart.get_period();
+          flow_integrator.reset();
+        }
+      }
+
       // add total flows
       if (t >= t_start_averaging)
-        flow_integrator.update_flow(*flow_solver, tau);
+        flow_integrator.update_flow(*flow_solver, tau_used);
     }
 
+    output.finish();
+    if (metrics_exporter)
+      metrics_exporter->write(*flow_solver, t, tau_cfl);
+    if (trace_started) {
+      mc::PhaseTrace::stop();
+      if (mc::PhaseTrace::num_dropped_events() > 0)
+        std::cout << "rank " << mc::mpi::rank(MPI_COMM_WORLD) << " dropped the " << mc::PhaseTrace::num_dropped_events() << " oldest phases of the trace" << std::endl;
+      mc::PhaseTrace::write_chrome_json(MPI_COMM_WORLD, trace_path);
+    }
+    if (num_output_buffers > 0 && mc::mpi::rank(MPI_COMM_WORLD) == 0)
+      std::cout << "output stalls = " << output.num_stalls() << std::endl;
+
     const auto end_t = std::chrono::steady_clock::now();
     const auto elapsed_ms = std::chrono::duration_cast<std::chrono::microseconds>(end_t - begin_t).count();
+    const auto newton_statistics = flow_solver->get_rhs_evaluator().get_flow_upwind_evaluator().get_newton_statistics(true);
     if (mc::mpi::rank(MPI_COMM_WORLD) == 0)
     {
       std::cout << "time = " << elapsed_ms * 1e-6 << " s" << std::endl;
       std::cout << "total time flow solver = " << flow_solution_time << ", average = " << flow_solution_time / num_iteration << ", iteration = " << num_iteration << std::endl;
+      std::cout << "newton solves upwinding: " << newton_statistics << std::endl;
     }
 
+#ifdef MACROCIRCULATION_PHASE_TIMERS
+    mc::PhaseTimers::print(MPI_COMM_WORLD, std::cout);
+    if (!args["phase-timers"].as<std::string>().empty())
+      mc::PhaseTimers::write_json(MPI_COMM_WORLD, args["phase-timers"].as<std::string>());
+#endif
+
     auto flows = flow_integrator.get_windkessel_outflow_data();
 
     output_flows("flows.json", *graph, flows, t_end, t_start_averaging);
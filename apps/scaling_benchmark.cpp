@@ -0,0 +1,255 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <chrono>
+#include <cxxopts.hpp>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <nlohmann/json.hpp>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/communicator.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/edge_boundary_evaluator.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/load_balancing.hpp"
+#include "macrocirculation/memory_report.hpp"
+#include "macrocirculation/nonlinear_flow_upwind_evaluator.hpp"
+#include "macrocirculation/numa.hpp"
+#include "macrocirculation/phase_timers.hpp"
+#include "macrocirculation/roofline.hpp"
+#include "macrocirculation/right_hand_side_evaluator.hpp"
+#include "macrocirculation/synthetic_network.hpp"
+
+namespace mc = macrocirculation;
+
+using json = nlohmann::json;
+
+/*! @brief Returns the minimum, mean and maximum of a value over the ranks of comm. The call is collective. */
+json reduce_over_ranks(MPI_Comm comm, double value) {
+  double min, max, sum;
+  MPI_Allreduce(&value, &min, 1, MPI_DOUBLE, MPI_MIN, comm);
+  MPI_Allreduce(&value, &max, 1, MPI_DOUBLE, MPI_MAX, comm);
+  MPI_Allreduce(&value, &sum, 1, MPI_DOUBLE, MPI_SUM, comm);
+  return {{"min", min}, {"avg", sum / mc::mpi::size(comm)}, {"max", max}, {"sum", sum}};
+}
+
+int main(int argc, char *argv[]) {
+  MPI_Init(&argc, &argv);
+
+  {
+    cxxopts::Options options(argv[0], "Measures the time steps of the flow solver on synthetic arterial trees for strong and weak scaling studies");
+    options.add_options()                                                                                                                                        //
+      ("depth", "the number of generations of the synthetic tree", cxxopts::value<std::size_t>()->default_value("10"))                                           //
+      ("branching", "the branching factor of the synthetic tree", cxxopts::value<std::size_t>()->default_value("2"))                                             //
+      ("outlet", "the outflow model of the synthetic tree, either windkessel or vessel-tree", cxxopts::value<std::string>()->default_value("windkessel"))         //
+      ("micro-edges-per-cm", "the density of the micro edges in the vessels", cxxopts::value<double>()->default_value("4"))                                      //
+      ("degree", "the degree of the finite elements", cxxopts::value<std::size_t>()->default_value("2"))                                                         //
+      ("partitioner", "the partitioner of the vessels, either naive, greedy or topology", cxxopts::value<std::string>()->default_value("topology"))                //
+      ("num-threads", "number of threads per rank for the edge loops", cxxopts::value<std::size_t>()->default_value("1"))                                        //
+      ("share-graph", "stores the physical data and the adjacency of the graph once per node", cxxopts::value<bool>()->default_value("false"))                     //
+      ("pin-threads", "binds the threads to the given cores of a node, e.g. 0-15, where the ranks of a node use consecutive blocks of num-threads cores", cxxopts::value<std::string>()->default_value("")) //
+      ("restrict-graph", "keeps only the own and the ghost vessels of the graph on every rank", cxxopts::value<bool>()->default_value("false"))                   //
+      ("steps", "the number of measured ssp steps", cxxopts::value<std::size_t>()->default_value("100"))                                                         //
+      ("warmup-steps", "the number of ssp steps before the measurement", cxxopts::value<std::size_t>()->default_value("10"))                                     //
+      ("tau", "time step size, if zero the stable time step of the initial solution for the given cfl number is used", cxxopts::value<double>()->default_value("0")) //
+      ("cfl", "the cfl number for the time step", cxxopts::value<double>()->default_value("0.5"))                                                                //
+      ("output-file", "json file for the results", cxxopts::value<std::string>()->default_value("scaling.json"))                                                 //
+      ("communication-matrix", "json file for the messages, bytes and waiting times between all pairs of ranks", cxxopts::value<std::string>()->default_value("")) //
+      ("peak-gflops", "the peak GFlop/s of a rank for the roofline of the hardware counters", cxxopts::value<double>()->default_value("50"))                     //
+      ("peak-bandwidth", "the memory bandwidth of a rank in GB/s for the roofline of the hardware counters", cxxopts::value<double>()->default_value("10"))        //
+      ("h,help", "print usage");
+    auto args = options.parse(argc, argv);
+    if (args.count("help")) {
+      std::cout << options.help() << std::endl;
+      exit(0);
+    }
+
+    const MPI_Comm comm = MPI_COMM_WORLD;
+    const bool is_root = mc::mpi::rank(comm) == 0;
+    const auto degree = args["degree"].as<std::size_t>();
+
+    mc::SyntheticTreeParameters parameters;
+    parameters.depth = args["depth"].as<std::size_t>();
+    parameters.branching_factor = args["branching"].as<std::size_t>();
+    parameters.micro_edges_per_cm = args["micro-edges-per-cm"].as<double>();
+    parameters.embed = false;
+    const auto outlet = args["outlet"].as<std::string>();
+    if (outlet == "vessel-tree")
+      parameters.outlet = mc::SyntheticTreeOutlet::vessel_tree;
+    else if (outlet != "windkessel")
+      throw std::runtime_error("unknown synthetic tree outlet " + outlet);
+
+    auto graph = mc::create_synthetic_arterial_tree(parameters);
+    graph->finalize_bcs();
+
+    // new partitioners only have to be registered here
+    const std::map<std::string, std::function<void(mc::GraphStorage &)>> partitioners{
+      {"naive", [&](mc::GraphStorage &g) { mc::naive_mesh_partitioner(g, comm); }},
+      {"greedy", [&](mc::GraphStorage &g) { mc::flow_mesh_partitioner(comm, g, degree, 0, false); }},
+      {"topology", [&](mc::GraphStorage &g) { mc::flow_mesh_partitioner(comm, g, degree, 0, true); }}};
+    const auto partitioner_name = args["partitioner"].as<std::string>();
+    if (partitioners.count(partitioner_name) == 0)
+      throw std::runtime_error("unknown partitioner " + partitioner_name);
+    partitioners.at(partitioner_name)(*graph);
+    graph->set_edge_order(mc::locality_edge_order(*graph));
+    if (args["share-graph"].as<bool>() && args["restrict-graph"].as<bool>())
+      throw std::runtime_error("a graph restricted to the ranks cannot be shared on the node");
+    if (args["share-graph"].as<bool>())
+      graph->share_on_node(comm);
+    if (args["restrict-graph"].as<bool>())
+      graph->restrict_to_rank(mc::mpi::rank(comm));
+
+    auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+    dof_map->create(comm, *graph, 2, degree, false);
+
+    mc::ExplicitNonlinearFlowSolver solver(comm, graph, dof_map, degree);
+    solver.use_ssp_method();
+    const auto num_threads = args["num-threads"].as<std::size_t>();
+    solver.set_num_threads(num_threads, mc::select_cores_of_rank(comm, mc::parse_core_list(args["pin-threads"].as<std::string>()), num_threads));
+    // the chains of compartments are too stiff for the time step of the vessels
+    solver.set_implicit_0d_models(parameters.outlet == mc::SyntheticTreeOutlet::vessel_tree);
+
+    double tau = args["tau"].as<double>();
+    if (!(tau > 0))
+      tau = solver.calculate_stable_time_step(args["cfl"].as<double>());
+
+    // every rank counts its own edges, since a restricted graph only knows its part of the network
+    unsigned long long num_micro_edges = 0;
+    std::vector<double> micro_edge_costs(graph->num_edges(), 0);
+    for (auto e_id : graph->get_active_edge_ids(mc::mpi::rank(comm))) {
+      num_micro_edges += graph->get_edge(e_id)->num_micro_edges();
+      micro_edge_costs[e_id] = static_cast<double>(graph->get_edge(e_id)->num_micro_edges());
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &num_micro_edges, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm);
+
+    double local_num_dofs = static_cast<double>(dof_map->num_dof());
+    double num_dofs = 0;
+    MPI_Allreduce(&local_num_dofs, &num_dofs, 1, MPI_DOUBLE, MPI_SUM, comm);
+
+    if (is_root)
+      std::cout << "synthetic tree with " << graph->num_edges() << " vessels, " << num_micro_edges << " micro edges and " << num_dofs << " dofs on "
+                << mc::mpi::size(comm) << " ranks, tau = " << tau << std::endl;
+
+    double t = 0;
+    for (std::size_t step = 0; step < args["warmup-steps"].as<std::size_t>(); step += 1, t += tau)
+      solver.solve(tau, t);
+
+    // the measurement starts after the warm up
+#ifdef MACROCIRCULATION_PHASE_TIMERS
+    mc::PhaseTimers::reset();
+#endif
+    solver.start_cost_measurement();
+    auto &communicator = solver.get_rhs_evaluator().get_flow_upwind_evaluator().get_boundary_evaluator().get_communicator();
+    const std::size_t num_updates_start = communicator.num_updates();
+    communicator.reset_statistics();
+
+    const auto num_steps = args["steps"].as<std::size_t>();
+    MPI_Barrier(comm);
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t step = 0; step < num_steps; step += 1, t += tau)
+      solver.solve(tau, t);
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const double time_per_step = elapsed / static_cast<double>(num_steps);
+    const double num_updates_per_step = static_cast<double>(communicator.num_updates() - num_updates_start) / static_cast<double>(num_steps);
+    const double values_per_step = static_cast<double>(communicator.num_send_values()) * num_updates_per_step;
+
+    json results;
+    results["network"] = {
+      {"depth", parameters.depth},
+      {"branching_factor", parameters.branching_factor},
+      {"outlet", outlet},
+      {"num_vessels", graph->num_edges()},
+      {"num_micro_edges", num_micro_edges},
+      {"num_dofs", num_dofs}};
+    results["run"] = {
+      {"num_ranks", mc::mpi::size(comm)},
+      {"num_threads", args["num-threads"].as<std::size_t>()},
+      {"share_graph", args["share-graph"].as<bool>()},
+      {"restrict_graph", args["restrict-graph"].as<bool>()},
+      {"pin_threads", args["pin-threads"].as<std::string>()},
+      {"partitioner", partitioner_name},
+      {"degree", degree},
+      {"steps", num_steps},
+      {"tau", tau}};
+    results["time_per_step"] = reduce_over_ranks(comm, time_per_step);
+    results["time_per_dof"] = results["time_per_step"]["max"].get<double>() / num_dofs;
+    results["local_dofs"] = reduce_over_ranks(comm, local_num_dofs);
+    const auto communication = communicator.get_statistics().total();
+    results["communication"] = {
+      {"values_per_step", reduce_over_ranks(comm, values_per_step)},
+      {"bytes_per_step", reduce_over_ranks(comm, sizeof(double) * values_per_step)},
+      {"messages_per_step", reduce_over_ranks(comm, static_cast<double>(communication.messages_sent) / static_cast<double>(num_steps))},
+      {"wait_time_per_step", reduce_over_ranks(comm, communication.wait_seconds / static_cast<double>(num_steps))},
+      {"send_neighbors", reduce_over_ranks(comm, static_cast<double>(communicator.num_send_neighbors()))}};
+    if (!args["communication-matrix"].as<std::string>().empty())
+      communicator.get_statistics().write_json(comm, args["communication-matrix"].as<std::string>());
+
+    // the imbalance of the measured costs, and the one expected from the number of micro edges
+    const auto measured_costs = solver.get_cost_measurement()->get_total_edge_costs(comm, *graph);
+    results["load_imbalance"] = {
+      {"measured", mc::calculate_load_imbalance(comm, *graph, measured_costs)},
+      {"micro_edges", mc::calculate_load_imbalance(comm, *graph, micro_edge_costs)}};
+
+    // the bytes per rank, where the replicated graph sets a floor, which does not shrink with the number of ranks unless it is restricted
+    mc::MemoryReport memory;
+    memory.add("graph", graph->memory_report());
+    memory.add("dof map", dof_map->memory_report());
+    memory.add("solver", solver.memory_report());
+    json memory_components = json::array();
+    for (const auto &component : memory.reduce(comm))
+      memory_components.push_back({{"component", component.component}, {"min", component.min}, {"avg", component.avg}, {"max", component.max}, {"sum", component.sum}});
+    results["memory"] = memory_components;
+
+#ifdef MACROCIRCULATION_PHASE_TIMERS
+    json phases = json::array();
+    for (const auto &phase : mc::PhaseTimers::reduce(comm))
+      phases.push_back({{"phase", phase.path}, {"calls", phase.calls}, {"min", phase.min}, {"avg", phase.avg}, {"max", phase.max}});
+    results["phases"] = phases;
+    mc::PhaseTimers::print(comm, std::cout);
+#endif
+
+#ifdef MACROCIRCULATION_HARDWARE_COUNTERS
+    // places the kernels on the roofline of the given peaks, where the flops need raw events, see HardwareCounters
+    const mc::MachinePeaks peaks{1e9 * args["peak-gflops"].as<double>(), 1e9 * args["peak-bandwidth"].as<double>()};
+    const auto roofline = mc::place_on_roofline(mc::PhaseTimers::reduce(comm), peaks, mc::mpi::size(comm));
+    json roofline_points = json::array();
+    for (const auto &point : roofline)
+      roofline_points.push_back({{"phase", point.path},
+                                 {"flops", point.flops},
+                                 {"bytes", point.bytes},
+                                 {"arithmetic_intensity", point.arithmetic_intensity},
+                                 {"flops_per_second", point.flops_per_second},
+                                 {"attainable_flops_per_second", point.attainable_flops_per_second},
+                                 {"vector_ratio", point.vector_ratio},
+                                 {"instructions_per_cycle", point.instructions_per_cycle},
+                                 {"cache_miss_ratio", point.cache_miss_ratio},
+                                 {"bound", point.bound}});
+    results["roofline"] = roofline_points;
+    if (is_root)
+      mc::print_roofline(roofline, peaks, std::cout);
+#endif
+
+    if (is_root) {
+      std::cout << "time per step = " << results["time_per_step"]["max"] << " s, time per dof = " << results["time_per_dof"] << " s"
+                << ", load imbalance = " << results["load_imbalance"]["measured"]
+                << ", max memory per rank = " << memory_components.back()["max"].get<double>() / (1024. * 1024.) << " MiB" << std::endl;
+      std::ofstream o(args["output-file"].as<std::string>());
+      o << std::setw(4);
+      o << results;
+    }
+  }
+
+  MPI_Finalize();
+}
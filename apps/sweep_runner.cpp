@@ -0,0 +1,196 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include <chrono>
+#include <cmath>
+#include <cxxopts.hpp>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <nlohmann/json.hpp>
+
+#include "macrocirculation/case_scheduler.hpp"
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/errornorm.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/right_hand_side_evaluator.hpp"
+
+namespace mc = macrocirculation;
+
+using json = nlohmann::json;
+
+// the manufactured solution of the convergence study on a single vessel
+const double G0 = 15.41e+1;
+const double A0 = 1.;
+const double rho = 1.028;
+const double c0 = std::sqrt(G0 / (2 * rho));
+const double length = 20.;
+
+class test_S {
+public:
+  void operator()(double t,
+                  const mc::Edge &,
+                  const std::vector<double> &ps,
+                  const std::vector<double> &,
+                  const std::vector<double> &,
+                  std::vector<double> &S_Q_out,
+                  std::vector<double> &S_A_out) const {
+    for (std::size_t qp = 0; qp < ps.size(); qp += 1) {
+      const double x = ps[qp];
+      S_Q_out[qp] = 2 * M_PI * std::pow(c0, 2) * t * std::cos(M_PI * x / length) * std::exp(-10. * t) *
+                    std::pow(t * std::sin(M_PI * x / length) * std::exp(-10. * t) + 1, 2) /
+                    (std::sqrt(A0) * length);
+      S_A_out[qp] = -2 * std::sin(M_PI * x / length) * std::exp(-10. * t) * (10. * t - 1) *
+                    (t * std::sin(M_PI * x / length) * std::exp(-10. * t) + 1);
+    }
+  }
+};
+
+double get_analytic_solution_A(double t, double x) {
+  return std::pow(1 + t * std::exp(-10 * t) * std::sin(M_PI * x / length), 2);
+}
+
+/*! @brief Expands the sweep specification into the list of its cases.
+ *
+ *  Every case is the union of the defaults, the entries of an explicit list of cases and
+ *  a point of the cartesian product of the lists in the grid, where the later ones take precedence.
+ */
+std::vector<json> expand_cases(const json &spec) {
+  std::vector<json> cases{json::object()};
+  if (spec.contains("grid")) {
+    for (auto &[key, values] : spec["grid"].items()) {
+      std::vector<json> expanded;
+      for (const auto &c : cases) {
+        for (const auto &value : values) {
+          expanded.push_back(c);
+          expanded.back()[key] = value;
+        }
+      }
+      cases = std::move(expanded);
+    }
+  }
+  if (spec.contains("cases")) {
+    std::vector<json> expanded;
+    for (const auto &c : cases) {
+      for (const auto &entry : spec["cases"]) {
+        expanded.push_back(c);
+        expanded.back().update(entry);
+      }
+    }
+    cases = std::move(expanded);
+  }
+  for (auto &c : cases) {
+    json merged = spec.value("defaults", json::object());
+    merged.update(c);
+    c = std::move(merged);
+  }
+  return cases;
+}
+
+/*! @brief Runs a single case on the given communicator and returns its errors and run time. */
+std::vector<double> run_case(const json &c, MPI_Comm comm) {
+  const auto begin = std::chrono::steady_clock::now();
+
+  const std::size_t degree = c.value("degree", 2);
+  const std::size_t num_micro_edges = c.value("num_micro_edges", 32);
+  const double t_end = c.value("t_end", 0.1);
+  const double h = length / static_cast<double>(num_micro_edges);
+  const double tau = c.value("tau", h * c.value("cfl", 0.25) / c0 * 0.5);
+
+  auto graph = std::make_shared<mc::GraphStorage>();
+  auto start = graph->create_vertex();
+  auto end = graph->create_vertex();
+  auto vessel = graph->connect(*start, *end, num_micro_edges);
+  vessel->add_embedding_data(mc::EmbeddingData{{mc::Point(0, 0, 0), mc::Point(length, 0, 0)}});
+  vessel->add_physical_data(mc::PhysicalData{0., G0, A0, rho, length, 4.5e-2, 9, std::sqrt(A0 / M_PI)});
+  start->set_to_inflow_with_fixed_flow([](auto) { return 0.; });
+  end->set_to_inflow_with_fixed_flow([](auto) { return 0.; });
+  graph->finalize_bcs();
+
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(comm, *graph, 2, degree, false);
+
+  mc::ExplicitNonlinearFlowSolver solver(comm, graph, dof_map, degree);
+  if (c.value("method", "ssp") == "ssp")
+    solver.use_ssp_method();
+  else
+    solver.use_explicit_euler_method();
+  solver.get_rhs_evaluator().set_rhs_S(test_S());
+
+  double t = 0;
+  while (t < t_end - 1e-12) {
+    solver.solve(tau, t);
+    t += tau;
+  }
+
+  const mc::ErrornormEvaluator errornorm(comm, *graph, *dof_map);
+  const auto errors = errornorm.evaluate(solver.get_solution(),
+                                         {{solver.Q_component, [](const std::vector<double> &p, std::vector<double> &out) {
+                                             for (std::size_t qp = 0; qp < p.size(); qp += 1)
+                                               out[qp] = 0;
+                                           }},
+                                          {solver.A_component, [t](const std::vector<double> &p, std::vector<double> &out) {
+                                             for (std::size_t qp = 0; qp < p.size(); qp += 1)
+                                               out[qp] = get_analytic_solution_A(t, p[qp]);
+                                           }}});
+
+  const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - begin).count();
+  return {tau, errors[0].l2, errors[1].l2, errors[0].linf, errors[1].linf, elapsed * 1e-6};
+}
+
+int main(int argc, char *argv[]) {
+  mc::mpi::initialize(&argc, &argv, MPI_THREAD_FUNNELED);
+
+  cxxopts::Options options(argv[0], "Runs the cases of a convergence study or parameter sweep concurrently on groups of ranks");
+  options.add_options()                                                                                                                   //
+    ("sweep-file", "path to the sweep specification", cxxopts::value<std::string>()->default_value("./data/sweeps/convergence.json"))   //
+    ("output-file", "path to the csv file with the results of all cases", cxxopts::value<std::string>()->default_value("./output/sweep.csv")) //
+    ("ranks-per-case", "the number of ranks of every case, overrides the value of the specification", cxxopts::value<std::size_t>())     //
+    ("h,help", "print usage");
+  auto args = options.parse(argc, argv);
+  if (args.count("help")) {
+    std::cout << options.help() << std::endl;
+    exit(0);
+  }
+
+  {
+    std::ifstream f(args["sweep-file"].as<std::string>());
+    if (!f.good())
+      throw std::runtime_error("could not open sweep file " + args["sweep-file"].as<std::string>());
+    const auto spec = json::parse(f);
+    const auto cases = expand_cases(spec);
+
+    const std::size_t ranks_per_case = args.count("ranks-per-case") ? args["ranks-per-case"].as<std::size_t>() : spec.value("ranks_per_case", 1);
+    mc::CaseScheduler scheduler(MPI_COMM_WORLD, ranks_per_case);
+
+    if (mc::mpi::rank(MPI_COMM_WORLD) == 0)
+      std::cout << "running " << cases.size() << " cases on " << scheduler.num_groups() << " groups" << std::endl;
+
+    const auto results = scheduler.run(cases.size(), [&](std::size_t case_index, MPI_Comm case_comm) {
+      auto values = run_case(cases[case_index], case_comm);
+      if (mc::mpi::rank(case_comm) == 0)
+        std::cout << "group " << scheduler.get_group() << " finished case " << case_index << " (time = " << values.back() << " s)" << std::endl;
+      return values;
+    });
+
+    if (mc::mpi::rank(MPI_COMM_WORLD) == 0) {
+      std::ofstream out(args["output-file"].as<std::string>());
+      out << "case, name, degree, num_micro_edges, tau, error_Q, error_A, error, linf_Q, linf_A, time" << std::endl;
+      for (std::size_t k = 0; k < cases.size(); k += 1) {
+        const auto &c = cases[k];
+        const auto &r = results[k];
+        out << k << ", " << c.value("name", "case_" + std::to_string(k)) << ", " << c.value("degree", 2) << ", " << c.value("num_micro_edges", 32) << ", "
+            << r[0] << ", " << r[1] << ", " << r[2] << ", " << std::sqrt(std::pow(r[1], 2) + std::pow(r[2], 2)) << ", "
+            << r[3] << ", " << r[4] << ", " << r[5] << std::endl;
+      }
+    }
+  }
+
+  MPI_Finalize();
+}
@@ -0,0 +1,52 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "create_3_vessel_network.hpp"
+#include "macrocirculation/communication/buffer.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("BufferSystemExchange", "[BufferSystem]") {
+  // on MPI_COMM_SELF the message is copied, hence we measure the packing and unpacking of the buffers
+  mc::BufferSystem buffer_system(MPI_COMM_SELF, 42);
+
+  for (std::size_t num_values : {16, 1024, 65536}) {
+    const std::vector<double> send(num_values, 1.);
+    std::vector<double> receive(num_values, 0.);
+
+    BENCHMARK(std::to_string(num_values) + " doubles") {
+      buffer_system.clear();
+      buffer_system.get_send_buffer(0).write(send.data(), num_values);
+      buffer_system.start_communication();
+      buffer_system.end_communication();
+      buffer_system.get_receive_buffer(0).read(receive.data(), num_values);
+      return receive[0];
+    };
+  }
+}
+
+TEST_CASE("DofMapCreate", "[DofMap]") {
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_SELF);
+
+  for (std::size_t degree : {0, 2}) {
+    BENCHMARK("3 vessels degree " + std::to_string(degree)) {
+      auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+      dof_map->create(MPI_COMM_SELF, *graph, 2, degree, false);
+      return dof_map;
+    };
+  }
+}
@@ -0,0 +1,162 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "create_3_vessel_network.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/nonlinear_flow_upwind_evaluator.hpp"
+#include "macrocirculation/right_hand_side_evaluator.hpp"
+#include "macrocirculation/synthetic_network.hpp"
+#include "macrocirculation/time_integrators.hpp"
+#include "macrocirculation/vessel_formulas.hpp"
+
+namespace mc = macrocirculation;
+
+namespace {
+
+/*! @brief A single vessel between a heart beat and a windkessel, such that the edge loop dominates the right-hand side. */
+std::shared_ptr<mc::GraphStorage> create_single_vessel(std::size_t num_micro_edges) {
+  auto graph = std::make_shared<mc::GraphStorage>();
+  auto &v0 = *graph->create_vertex();
+  auto &v1 = *graph->create_vertex();
+  auto &e = *graph->connect(v0, v1, num_micro_edges);
+  e.add_physical_data(mc::PhysicalData::set_from_data(400000.0, 0.163, 1.028e-3, 9, 1.2, 4.0));
+  e.add_embedding_data(mc::EmbeddingData({{mc::Point(0, 0, 0), mc::Point(0, 1, 0)}}));
+  v0.set_to_inflow_with_fixed_flow(mc::heart_beat_inflow(485.));
+  v1.set_to_windkessel_outflow(1.718414143839568, 0.7369003586207183);
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_SELF);
+  return graph;
+}
+
+/*! @brief A cheap right-hand side, such that only the stage updates of the time integrator are measured. */
+class DecayRightHandSide : public mc::ExplicitRightHandSide {
+public:
+  void evaluate(double /*t*/, const std::vector<double> &u_prev, std::vector<double> &rhs, double /*tau_euler*/) override {
+    for (std::size_t k = 0; k < u_prev.size(); k += 1)
+      rhs[k] = -u_prev[k];
+  }
+};
+
+} // namespace
+
+TEST_CASE("RightHandSideOnASingleEdge", "[RightHandSide]") {
+  const std::size_t num_micro_edges = 256;
+
+  for (std::size_t degree = 0; degree <= 3; degree += 1) {
+    auto graph = create_single_vessel(num_micro_edges);
+    auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+    dof_map->create(MPI_COMM_SELF, *graph, 2, degree, false);
+    mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_SELF, graph, dof_map, degree);
+
+    const auto &u = solver.get_solution();
+    std::vector<double> rhs(u.size(), 0.);
+    auto &evaluator = solver.get_rhs_evaluator();
+
+    BENCHMARK("degree " + std::to_string(degree)) {
+      evaluator.evaluate(0., u, rhs);
+      return rhs[0];
+    };
+  }
+}
+
+TEST_CASE("RightHandSideOnSyntheticTrees", "[RightHandSide][SyntheticNetwork]") {
+  const std::size_t degree = 2;
+
+  // many short vessels, such that the n-furcations and boundary conditions are a large part of the right-hand side
+  for (std::size_t depth : {6, 9, 12}) {
+    mc::SyntheticTreeParameters parameters;
+    parameters.depth = depth;
+    parameters.embed = false;
+    auto graph = mc::create_synthetic_arterial_tree(parameters);
+    graph->finalize_bcs();
+    mc::naive_mesh_partitioner(*graph, MPI_COMM_SELF);
+    auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+    dof_map->create(MPI_COMM_SELF, *graph, 2, degree, false);
+    mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_SELF, graph, dof_map, degree);
+
+    const auto &u = solver.get_solution();
+    std::vector<double> rhs(u.size(), 0.);
+    auto &evaluator = solver.get_rhs_evaluator();
+
+    BENCHMARK(std::to_string(graph->num_edges()) + " vessels") {
+      evaluator.evaluate(0., u, rhs);
+      return rhs[0];
+    };
+  }
+}
+
+TEST_CASE("FluxesOnMacroEdge", "[RightHandSide][Upwinding]") {
+  const std::size_t num_micro_edges = 256;
+  const std::size_t degree = 2;
+
+  auto graph = create_single_vessel(num_micro_edges);
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_SELF, *graph, 2, degree, false);
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_SELF, graph, dof_map, degree);
+
+  const auto &u = solver.get_solution();
+  auto &upwind_evaluator = solver.get_rhs_evaluator().get_flow_upwind_evaluator();
+  const auto &edge = *graph->get_edge(0);
+  std::vector<double> Q_up(num_micro_edges + 1), A_up(num_micro_edges + 1);
+
+  BENCHMARK("init") {
+    upwind_evaluator.init(0., u);
+  };
+
+  upwind_evaluator.init(0., u);
+  BENCHMARK("get_fluxes_on_macro_edge") {
+    upwind_evaluator.get_fluxes_on_macro_edge(0., edge, u, Q_up, A_up);
+    return A_up[0];
+  };
+}
+
+TEST_CASE("TimeIntegrator", "[TimeIntegrator]") {
+  const std::size_t num_dofs = 1 << 16;
+  const std::vector<double> u_prev(num_dofs, 1.);
+  std::vector<double> u_now(num_dofs, 0.);
+  DecayRightHandSide rhs;
+
+  const std::vector<std::pair<std::string, mc::TimeIntegrator>> integrators{
+    {"explicit euler", mc::TimeIntegrator(mc::create_explicit_euler(), num_dofs)},
+    {"ssp", mc::TimeIntegrator(mc::create_ssp_method(), num_dofs)},
+    {"ssp shu-osher", mc::TimeIntegrator(mc::create_ssp_method_shu_osher(), num_dofs)},
+    {"ssp 5-3 shu-osher", mc::TimeIntegrator(mc::create_ssp_5_3_method_shu_osher(), num_dofs)},
+    {"ssp 10-4 shu-osher", mc::TimeIntegrator(mc::create_ssp_10_4_method_shu_osher(), num_dofs)}};
+
+  for (const auto &integrator : integrators) {
+    BENCHMARK(std::string(integrator.first)) {
+      integrator.second.apply(u_prev, 0., 1e-3, rhs, u_now);
+      return u_now[0];
+    };
+  }
+}
+
+TEST_CASE("SolverStep", "[ExplicitNonlinearFlowSolver]") {
+  const std::size_t degree = 2;
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_SELF);
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_SELF, *graph, 2, degree, false);
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_SELF, graph, dof_map, degree);
+  solver.use_ssp_method();
+
+  double t = 0;
+  BENCHMARK("3 vessels ssp") {
+    solver.solve(1e-5, t);
+    t += 1e-5;
+  };
+}
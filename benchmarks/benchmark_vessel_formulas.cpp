@@ -0,0 +1,105 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/newton_statistics.hpp"
+#include "macrocirculation/nonlinear_flow_upwind_evaluator.hpp"
+#include "macrocirculation/vessel_formulas.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("NFurcation", "[VesselFormulas][NFurcation]") {
+  const double E = 400000.0;
+  const double h0 = 0.163;
+  const double rho = 1.028e-3;
+  const std::vector<double> radii{1.2, 0.9, 0.8, 0.6};
+
+  for (std::size_t num_vessels = 2; num_vessels <= 4; num_vessels += 1) {
+    std::vector<mc::VesselParameters> p;
+    std::vector<double> Q, A;
+    std::vector<bool> in;
+    for (std::size_t k = 0; k < num_vessels; k += 1) {
+      const double A0 = M_PI * radii[k] * radii[k];
+      p.emplace_back(mc::calculate_G0(h0, E, A0), A0, rho);
+      // the first vessel flows into the n-furcation and the others out of it, with a slight jump in the traces
+      Q.push_back(k == 0 ? 10. : 10. / static_cast<double>(num_vessels - 1) * 1.05);
+      A.push_back(A0 * (k == 0 ? 1.02 : 0.99));
+      in.push_back(k == 0);
+    }
+    std::vector<double> Q_up(num_vessels, 0.), A_up(num_vessels, 0.);
+
+    BENCHMARK(std::to_string(num_vessels) + " vessels") {
+      return mc::solve_at_nfurcation(Q, A, p, in, Q_up, A_up);
+    };
+
+    // the solver warm starts from the previous upwinded values
+    mc::solve_at_nfurcation(Q, A, p, in, Q_up, A_up);
+    BENCHMARK(std::to_string(num_vessels) + " vessels warm start") {
+      return mc::solve_at_nfurcation(Q, A, p, in, Q_up, A_up, true);
+    };
+  }
+}
+
+TEST_CASE("WindkesselNewton", "[VesselFormulas][Windkessel]") {
+  const auto param = mc::PhysicalData::set_from_data(400000.0, 0.126, 1.028e-3, 9, 1.12, 2.0);
+  const double R1 = mc::calculate_R1(param);
+  const double Q_DG = 5.;
+  const double A_DG = 1.01 * param.A0;
+  const double p_c = 10.;
+
+  mc::NewtonStatistics stats;
+  double Q_out = 0, A_out = 0;
+
+  BENCHMARK("cold start") {
+    mc::calculate_windkessel_upwind_values(param, true, R1, Q_DG, A_DG, p_c, param.A0, Q_out, A_out, stats);
+    return A_out;
+  };
+
+  mc::calculate_windkessel_upwind_values(param, true, R1, Q_DG, A_DG, p_c, param.A0, Q_out, A_out, stats);
+  const double A_previous = A_out;
+  BENCHMARK("warm start") {
+    mc::calculate_windkessel_upwind_values(param, true, R1, Q_DG, A_DG, p_c, A_previous, Q_out, A_out, stats);
+    return A_out;
+  };
+}
+
+TEST_CASE("InnerUpwinding", "[VesselFormulas][InnerUpwinding]") {
+  const std::size_t num_inner = 63;
+  const mc::VesselParameters param(mc::calculate_G0(0.163, 400000.0, M_PI * 1.44), M_PI * 1.44, 1.028e-3);
+
+  std::vector<double> Q_l(num_inner), A_l(num_inner), Q_r(num_inner), A_r(num_inner);
+  for (std::size_t k = 0; k < num_inner; k += 1) {
+    Q_l[k] = 10. + 0.1 * std::sin(0.1 * k);
+    Q_r[k] = 10. + 0.1 * std::cos(0.1 * k);
+    A_l[k] = param.A0 * (1. + 0.01 * std::sin(0.2 * k));
+    A_r[k] = param.A0 * (1. + 0.01 * std::cos(0.2 * k));
+  }
+  std::vector<double> W1(num_inner), W2(num_inner), Q_up(num_inner), A_up(num_inner);
+
+  BENCHMARK("63 micro vertices with pow") {
+    for (std::size_t k = 0; k < num_inner; k += 1) {
+      const double W2_l = mc::nonlinear::get_w2_from_QA(Q_r[k], A_r[k], param);
+      const double W1_r = mc::nonlinear::get_w1_from_QA(Q_l[k], A_l[k], param);
+      mc::solve_W12(Q_up[k], A_up[k], W1_r, W2_l, param.G0, param.rho, param.A0);
+    }
+    return A_up.back();
+  };
+
+  for (double tolerance : {0., mc::nonlinear::batch::fast_tolerance}) {
+    BENCHMARK(std::string(tolerance > 0 ? "63 micro vertices in a fast batch" : "63 micro vertices in a batch")) {
+      mc::nonlinear::batch::get_w2_from_QA(num_inner, Q_r.data(), A_r.data(), param, W2.data(), tolerance);
+      mc::nonlinear::batch::get_w1_from_QA(num_inner, Q_l.data(), A_l.data(), param, W1.data(), tolerance);
+      mc::nonlinear::batch::solve_W12(num_inner, W1.data(), W2.data(), param, Q_up.data(), A_up.data());
+      return A_up.back();
+    };
+  }
+}
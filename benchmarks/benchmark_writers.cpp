@@ -0,0 +1,125 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "create_3_vessel_network.hpp"
+#include "macrocirculation/csv_vessel_tip_writer.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_binary_writer.hpp"
+#include "macrocirculation/graph_csv_writer.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_pvd_writer.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/probe_writer.hpp"
+
+namespace mc = macrocirculation;
+
+namespace {
+
+/*! @brief The 3 vessel network with a solution, whose output is written into a scratch directory. */
+struct WriterFixture {
+  WriterFixture()
+      : graph(test_macrocirculation::util::create_3_vessel_network()) {
+    graph->finalize_bcs();
+    mc::naive_mesh_partitioner(*graph, MPI_COMM_SELF);
+    dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+    dof_map->create(MPI_COMM_SELF, *graph, 2, degree, false);
+    solver = std::make_unique<mc::ExplicitNonlinearFlowSolver>(MPI_COMM_SELF, graph, dof_map, degree);
+    std::filesystem::create_directories(directory);
+  }
+
+  ~WriterFixture() { std::filesystem::remove_all(directory); }
+
+  static constexpr std::size_t degree = 2;
+  const std::string directory = "./benchmark_writers_output";
+
+  std::shared_ptr<mc::GraphStorage> graph;
+  std::shared_ptr<mc::DofMap> dof_map;
+  std::unique_ptr<mc::ExplicitNonlinearFlowSolver> solver;
+};
+
+} // namespace
+
+TEST_CASE_METHOD(WriterFixture, "GraphCSVWriter", "[Writers]") {
+  mc::GraphCSVWriter writer(MPI_COMM_SELF, directory, "csv", graph);
+  writer.add_setup_data(dof_map, solver->A_component, "a");
+  writer.add_setup_data(dof_map, solver->Q_component, "q");
+  writer.setup();
+
+  double t = 0;
+  BENCHMARK("write") {
+    writer.add_data("a", solver->get_solution());
+    writer.add_data("q", solver->get_solution());
+    writer.write(t += 1e-3);
+  };
+}
+
+TEST_CASE_METHOD(WriterFixture, "GraphBinaryWriter", "[Writers]") {
+  mc::GraphBinaryWriter writer(MPI_COMM_SELF, directory, "binary", graph);
+  writer.add_setup_data(dof_map, solver->A_component, "a");
+  writer.add_setup_data(dof_map, solver->Q_component, "q");
+  writer.setup();
+
+  double t = 0;
+  BENCHMARK("write") {
+    writer.add_data("a", solver->get_solution());
+    writer.add_data("q", solver->get_solution());
+    writer.write(t += 1e-3);
+  };
+}
+
+TEST_CASE_METHOD(WriterFixture, "GraphPVDWriter", "[Writers]") {
+  // two points per micro edge, as written by the interpolation to the vertices
+  const std::size_t num_points = 2 * 26;
+  std::vector<mc::Point> points;
+  for (std::size_t k = 0; k < num_points; k += 1)
+    points.emplace_back(0, static_cast<double>(k / 2 + k % 2), 0);
+  const std::vector<double> values(num_points, 1.);
+
+  using Format = mc::GraphPVDWriter::Format;
+  for (const auto &format : std::vector<std::pair<std::string, Format>>{{"ascii", Format::ascii}, {"base64", Format::base64}, {"raw", Format::raw_appended}}) {
+    mc::GraphPVDWriter writer(MPI_COMM_SELF, directory, "pvd_" + format.first);
+    writer.set_format(format.second);
+
+    double t = 0;
+    BENCHMARK("write " + format.first) {
+      writer.set_points(points);
+      writer.add_vertex_data("p", values);
+      writer.add_vertex_data("q", values);
+      writer.write(t += 1e-3);
+    };
+  }
+}
+
+TEST_CASE_METHOD(WriterFixture, "ProbeWriter", "[Writers]") {
+  mc::ProbeWriter writer(MPI_COMM_SELF, directory, "probes", graph, dof_map);
+  writer.add_probe(mc::Point(0, 0.5, 0));
+  writer.add_probe(mc::Point(0.5, 1, 0));
+  writer.add_probe(mc::Point(-0.5, 1, 0));
+  writer.setup();
+
+  double t = 0;
+  BENCHMARK("write") {
+    writer.write(t += 1e-3, solver->get_solution());
+  };
+}
+
+TEST_CASE_METHOD(WriterFixture, "CSVVesselTipWriter", "[Writers]") {
+  mc::CSVVesselTipWriter writer(MPI_COMM_SELF, directory, "tips", graph, dof_map);
+
+  double t = 0;
+  BENCHMARK("write") {
+    writer.write(t += 1e-3, solver->get_solution());
+  };
+}
@@ -0,0 +1,216 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/embedded_graph_reader.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/right_hand_side_evaluator.hpp"
+#include "macrocirculation/time_integrators.hpp"
+#include "macrocirculation/vessel_formulas.hpp"
+
+namespace mc = macrocirculation;
+
+// The regression tests measure the time per dof of a few kernels and of a short 37 vessel simulation.
+// Every time is divided by the time of an iteration of a fixed calibration loop, such that the baselines can be compared across machines of similar architecture.
+// A test fails, if its relative time exceeds the stored baseline by more than the tolerance.
+//
+// MACROCIRCULATION_PERF_TOLERANCE overrides the tolerance of the baseline file, e.g. 0.5 for noisy machines,
+// and MACROCIRCULATION_PERF_UPDATE=1 writes the measured times as the new baselines.
+
+#ifndef MACROCIRCULATION_PERF_BASELINES
+#define MACROCIRCULATION_PERF_BASELINES "perf_baselines.json"
+#endif
+
+#ifndef MACROCIRCULATION_PERF_DATA_DIR
+#define MACROCIRCULATION_PERF_DATA_DIR "data"
+#endif
+
+namespace {
+
+using json = nlohmann::json;
+
+/*! @brief Returns the minimum time of a single call over the given number of repetitions, each of which calls f the given number of times. */
+template<typename Function>
+double min_time(std::size_t repetitions, std::size_t calls, Function f) {
+  double best = std::numeric_limits<double>::max();
+  for (std::size_t r = 0; r < repetitions; r += 1) {
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t k = 0; k < calls; k += 1)
+      f();
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    best = std::min(best, elapsed / static_cast<double>(calls));
+  }
+  return best;
+}
+
+/*! @brief The time of a single iteration of a fixed loop of dependent floating point operations and loads, which is measured once per run. */
+double calibration_time() {
+  static const double time = [] {
+    std::vector<double> values(1 << 14);
+    for (std::size_t k = 0; k < values.size(); k += 1)
+      values[k] = 1. + 1e-3 * static_cast<double>(k % 17);
+    volatile double sink = 0;
+    const std::size_t num_sweeps = 200;
+    const double t = min_time(5, 1, [&]() {
+      double sum = 0;
+      for (std::size_t sweep = 0; sweep < num_sweeps; sweep += 1)
+        for (std::size_t k = 0; k < values.size(); k += 1)
+          sum = sum * 0.999 + std::sqrt(values[k]);
+      sink = sum;
+    });
+    (void) sink;
+    return t / static_cast<double>(num_sweeps * values.size());
+  }();
+  return time;
+}
+
+double tolerance(const json &baselines) {
+  const char *value = std::getenv("MACROCIRCULATION_PERF_TOLERANCE");
+  if (value != nullptr)
+    return std::stod(value);
+  return baselines.value("tolerance", 0.3);
+}
+
+bool update_baselines() {
+  const char *value = std::getenv("MACROCIRCULATION_PERF_UPDATE");
+  return value != nullptr && std::string(value) == "1";
+}
+
+json read_baselines() {
+  std::ifstream f(MACROCIRCULATION_PERF_BASELINES);
+  if (!f.good())
+    return json{{"tolerance", 0.3}, {"measurements", json::object()}};
+  json j;
+  f >> j;
+  return j;
+}
+
+/*! @brief Compares the time per dof relative to the calibration loop with its baseline, or stores it in the update mode. */
+void check_time_per_dof(const std::string &name, double time_per_dof) {
+  const double relative_time = time_per_dof / calibration_time();
+  INFO(name << ": " << time_per_dof * 1e9 << " ns per dof, " << 1e-6 / time_per_dof << " Mdof/s, " << relative_time << " iterations of the calibration loop");
+
+  auto baselines = read_baselines();
+  if (update_baselines()) {
+    baselines["measurements"][name] = relative_time;
+    std::ofstream o(MACROCIRCULATION_PERF_BASELINES);
+    o << std::setw(4);
+    o << baselines << std::endl;
+    return;
+  }
+
+  const auto &measurements = baselines["measurements"];
+  if (!measurements.contains(name)) {
+    WARN("no baseline for " << name);
+    return;
+  }
+  const double baseline = measurements[name].get<double>();
+  INFO("baseline " << baseline << " with tolerance " << tolerance(baselines));
+  REQUIRE(relative_time <= baseline * (1 + tolerance(baselines)));
+}
+
+/*! @brief A single vessel between a heart beat and a windkessel, such that the edge loop dominates the right-hand side. */
+std::shared_ptr<mc::GraphStorage> create_single_vessel(std::size_t num_micro_edges) {
+  auto graph = std::make_shared<mc::GraphStorage>();
+  auto &v0 = *graph->create_vertex();
+  auto &v1 = *graph->create_vertex();
+  auto &e = *graph->connect(v0, v1, num_micro_edges);
+  e.add_physical_data(mc::PhysicalData::set_from_data(400000.0, 0.163, 1.028e-3, 9, 1.2, 4.0));
+  e.add_embedding_data(mc::EmbeddingData({{mc::Point(0, 0, 0), mc::Point(0, 1, 0)}}));
+  v0.set_to_inflow_with_fixed_flow(mc::heart_beat_inflow(485.));
+  v1.set_to_windkessel_outflow(1.718414143839568, 0.7369003586207183);
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_SELF);
+  return graph;
+}
+
+/*! @brief A cheap right-hand side, such that only the stage updates of the time integrator are measured. */
+class DecayRightHandSide : public mc::ExplicitRightHandSide {
+public:
+  void evaluate(double /*t*/, const std::vector<double> &u_prev, std::vector<double> &rhs, double /*tau_euler*/) override {
+    for (std::size_t k = 0; k < u_prev.size(); k += 1)
+      rhs[k] = -u_prev[k];
+  }
+};
+
+} // namespace
+
+TEST_CASE("RightHandSidePerformance", "[perf]") {
+  const std::size_t degree = 2;
+
+  auto graph = create_single_vessel(256);
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_SELF, *graph, 2, degree, false);
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_SELF, graph, dof_map, degree);
+
+  const auto &u = solver.get_solution();
+  std::vector<double> rhs(u.size(), 0.);
+  auto &evaluator = solver.get_rhs_evaluator();
+
+  const double time = min_time(10, 200, [&]() { evaluator.evaluate(0., u, rhs); });
+  check_time_per_dof("right hand side single vessel degree 2", time / static_cast<double>(u.size()));
+}
+
+TEST_CASE("TimeIntegratorPerformance", "[perf]") {
+  const std::size_t num_dofs = 1 << 16;
+  const std::vector<double> u_prev(num_dofs, 1.);
+  std::vector<double> u_now(num_dofs, 0.);
+  DecayRightHandSide rhs;
+  mc::TimeIntegrator integrator(mc::create_ssp_method(), num_dofs);
+
+  const double time = min_time(10, 50, [&]() { integrator.apply(u_prev, 0., 1e-3, rhs, u_now); });
+  check_time_per_dof("ssp stages", time / static_cast<double>(num_dofs));
+}
+
+TEST_CASE("37VesselSimulationPerformance", "[perf]") {
+  const std::size_t degree = 2;
+  const std::string data_dir = MACROCIRCULATION_PERF_DATA_DIR;
+
+  auto graph = std::make_shared<mc::GraphStorage>();
+  mc::EmbeddedGraphReader graph_reader;
+  graph_reader.append(data_dir + "/1d-meshes/37-vessels.json", *graph);
+  graph_reader.set_boundary_data(data_dir + "/1d-boundary/37-vessels.json", *graph);
+  graph->find_vertex_by_name("cw_in")->set_to_inflow_with_fixed_flow(mc::heart_beat_inflow(485.));
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_SELF);
+
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_SELF, *graph, 2, degree, false);
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_SELF, graph, dof_map, degree);
+  solver.use_ssp_method();
+
+  // the settings of the nonlinear_1d_solver app
+  const double tau = 2.5e-4 / 16.;
+  double t = 0;
+  auto step = [&]() {
+    solver.solve(tau, t);
+    t += tau;
+  };
+
+  // the first steps fill the caches and leave the initial state
+  for (std::size_t k = 0; k < 20; k += 1)
+    step();
+
+  const double time = min_time(5, 200, step);
+  REQUIRE(std::isfinite(solver.get_solution()[0]));
+  check_time_per_dof("37 vessel step degree 2", time / static_cast<double>(dof_map->num_dof()));
+}
@@ -5,6 +5,7 @@
 //  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 
@@ -23,7 +24,8 @@ EdgeTreeParameters calculate_edge_tree_parameters(const Edge &edge) {
   const double h_0 = 0.003;
   const double gamma = 2.5;
   // floor ?
-  const int N = static_cast<int>(std::ceil(gamma * std::log(r_0 / r_cap) / std::log(2)));
+  // vessels thinner than the capillaries get no tree
+  const int N = std::max(0, static_cast<int>(std::ceil(gamma * std::log(r_0 / r_cap) / std::log(2))));
   const auto alpha = 1. / std::pow(2, 1 / gamma);
   std::vector<double> list_C;
   std::vector<double> list_R;
@@ -44,39 +46,39 @@ EdgeTreeParameters calculate_edge_tree_parameters(const Edge &edge) {
   return {list_lengths, list_radii, list_R, list_C};
 }
 
-void set_0d_tree_boundary_conditions(const std::shared_ptr<GraphStorage> &graph) {
-  set_0d_tree_boundary_conditions(graph, [](auto) { return true; });
+void set_0d_tree_boundary_conditions(const std::shared_ptr<GraphStorage> &graph, MPI_Comm comm) {
+  set_0d_tree_boundary_conditions(graph, [](const Vertex &) { return true; }, comm);
 }
 
-void set_0d_tree_boundary_conditions(const std::shared_ptr<GraphStorage> &graph, const std::string &prefix) {
-  set_0d_tree_boundary_conditions(graph, [&](const Vertex &v) { return v.get_name().rfind(prefix) == 0; });
+void set_0d_tree_boundary_conditions(const std::shared_ptr<GraphStorage> &graph, const std::string &prefix, MPI_Comm comm) {
+  set_0d_tree_boundary_conditions(graph, [&](const Vertex &v) { return v.get_name().rfind(prefix) == 0; }, comm);
 }
 
-void set_0d_tree_boundary_conditions(const std::shared_ptr<GraphStorage> &graph, const std::function<bool(const Vertex &)> &conditional) {
+void set_0d_tree_boundary_conditions(const std::shared_ptr<GraphStorage> &graph, const std::function<bool(const Vertex &)> &conditional, MPI_Comm comm) {
   for (auto &v_id : graph->get_vertex_ids()) {
-    auto &vertex = *graph->get_vertex(v_id);
+    auto &vertex = graph->vertex(v_id);
     if (!vertex.is_leaf())
       continue;
 
     if (vertex.is_inflow_with_fixed_flow() || vertex.is_inflow_with_fixed_pressure()) {
-      std::cout << "rank = " << mpi::rank(MPI_COMM_WORLD) << " found inflow " << vertex.get_name() << std::endl;
+      std::cout << "rank = " << mpi::rank(comm) << " found inflow " << vertex.get_name() << std::endl;
       continue;
     }
 
     if (vertex.is_nonlinear_characteristic_inflow() || vertex.is_linear_characteristic_inflow()) {
-      std::cout << "rank = " << mpi::rank(MPI_COMM_WORLD) << " found characteristic inflow " << vertex.get_name() << std::endl;
+      std::cout << "rank = " << mpi::rank(comm) << " found characteristic inflow " << vertex.get_name() << std::endl;
       continue;
     }
 
     // we do not touch the circle of willis
     if (!conditional(vertex)) {
-      std::cout << "rank = " << mpi::rank(MPI_COMM_WORLD) << " ignoring node " << vertex.get_name() << " and keeps windkessel bc." << std::endl;
+      std::cout << "rank = " << mpi::rank(comm) << " ignoring node " << vertex.get_name() << " and keeps windkessel bc." << std::endl;
       continue;
     }
 
 
-    std::cout << "rank = " << mpi::rank(MPI_COMM_WORLD) << " sets " << vertex.get_name() << " to tree bc" << std::endl;
-    auto &edge = *graph->get_edge(vertex.get_edge_neighbors()[0]);
+    std::cout << "rank = " << mpi::rank(comm) << " sets " << vertex.get_name() << " to tree bc" << std::endl;
+    auto &edge = graph->edge(vertex.get_edge_neighbors()[0]);
     auto &param = edge.get_physical_data();
     // const double E = param.elastic_modulus;
     const double E = param.elastic_modulus * 4;
@@ -115,15 +117,15 @@ void set_0d_tree_boundary_conditions(const std::shared_ptr<GraphStorage> &graph,
   }
 }
 
-void convert_rcr_to_partitioned_tree_bcs(const std::shared_ptr<GraphStorage> &graph) {
+void convert_rcr_to_partitioned_tree_bcs(const std::shared_ptr<GraphStorage> &graph, MPI_Comm comm) {
   for (auto &v_id : graph->get_vertex_ids()) {
-    auto &vertex = *graph->get_vertex(v_id);
+    auto &vertex = graph->vertex(v_id);
 
     if (vertex.is_windkessel_outflow()) {
-      auto &edge = *graph->get_edge(vertex.get_edge_neighbors()[0]);
+      auto &edge = graph->edge(vertex.get_edge_neighbors()[0]);
       auto &data = vertex.get_peripheral_vessel_data();
 
-      std::cout << "rank " << mpi::rank(MPI_COMM_WORLD) << " sets vertex " << vertex.get_name()
+      std::cout << "rank " << mpi::rank(comm) << " sets vertex " << vertex.get_name()
                 << " (id = " << vertex.get_id() << ", neighbor-edge-id = " << edge.get_id() << ")" << std::endl;
 
       const double R1 = calculate_R1(edge.get_physical_data());
@@ -171,20 +173,25 @@ void convert_rcr_to_partitioned_tree_bcs(const std::shared_ptr<GraphStorage> &gr
       for (int i = 0; i < static_cast< int > ( list_R.size() ); i += 1)
         radii.push_back(NAN);
 
+      const bool was_finalized = vertex.bc_finalized();
+      if (was_finalized)
+        vertex.unfinalize_bcs();
       vertex.set_to_vessel_tree_outflow(p_cap, list_R, list_C, radii, 1);
+      if (was_finalized)
+        vertex.finalize_bcs();
     }
   }
 }
 
-void convert_rcr_to_rcl_chain_bcs(const std::shared_ptr<GraphStorage> &graph) {
+void convert_rcr_to_rcl_chain_bcs(const std::shared_ptr<GraphStorage> &graph, MPI_Comm comm) {
   for (auto &v_id : graph->get_vertex_ids()) {
-    auto &vertex = *graph->get_vertex(v_id);
+    auto &vertex = graph->vertex(v_id);
 
     if (vertex.is_windkessel_outflow()) {
-      auto &edge = *graph->get_edge(vertex.get_edge_neighbors()[0]);
+      auto &edge = graph->edge(vertex.get_edge_neighbors()[0]);
       auto &data = vertex.get_peripheral_vessel_data();
 
-      std::cout << "rank " << mpi::rank(MPI_COMM_WORLD) << " sets vertex " << vertex.get_name()
+      std::cout << "rank " << mpi::rank(comm) << " sets vertex " << vertex.get_name()
                 << " (id = " << vertex.get_id() << ", neighbor-edge-id = " << edge.get_id() << ")" << std::endl;
 
       const double R1 = calculate_R1(edge.get_physical_data());
@@ -12,6 +12,7 @@
 #include <string>
 #include <vector>
 #include <functional>
+#include <mpi.h>
 
 namespace macrocirculation {
 
@@ -28,12 +29,14 @@ struct EdgeTreeParameters
   std::vector< double > C;
 };
 
-/*! @brief Sets the boundary conditions using a tree estimate. */
-void set_0d_tree_boundary_conditions(const std::shared_ptr<GraphStorage> &graph, const std::function< bool(const Vertex&) >& conditional);
+/*! @brief Sets the boundary conditions using a tree estimate.
+ *         The communicator is only used to print the rank in the log messages.
+ */
+void set_0d_tree_boundary_conditions(const std::shared_ptr<GraphStorage> &graph, const std::function< bool(const Vertex&) >& conditional, MPI_Comm comm = MPI_COMM_WORLD);
 
-void set_0d_tree_boundary_conditions(const std::shared_ptr<GraphStorage> &graph, const std::string & prefix);
+void set_0d_tree_boundary_conditions(const std::shared_ptr<GraphStorage> &graph, const std::string & prefix, MPI_Comm comm = MPI_COMM_WORLD);
 
-void set_0d_tree_boundary_conditions(const std::shared_ptr<GraphStorage> &graph);
+void set_0d_tree_boundary_conditions(const std::shared_ptr<GraphStorage> &graph, MPI_Comm comm = MPI_COMM_WORLD);
 
 /*! @brief Takes the RCR boundary conditions and partitions the conductances and resistances into an RCR system.
  *         Every pressure corresponds to the mean pressure of a part of the vascular tree.
@@ -42,12 +45,14 @@ void set_0d_tree_boundary_conditions(const std::shared_ptr<GraphStorage> &graph)
  *         - 1 RCR-system for the capillaries,
  *         - 1 RCR-system for the venlues and
  *         - 1 RCR-system for the small veins
+ *         Finalized boundary conditions are reopened and finalized again, such that a running
+ *         flow solver can continue after ExplicitNonlinearFlowSolver::update_boundary_conditions.
  *
  * @param graph The vessel network whose boundary conditions are changed.
  */
-void convert_rcr_to_partitioned_tree_bcs(const std::shared_ptr<GraphStorage> &graph);
+void convert_rcr_to_partitioned_tree_bcs(const std::shared_ptr<GraphStorage> &graph, MPI_Comm comm = MPI_COMM_WORLD);
 
-void convert_rcr_to_rcl_chain_bcs(const std::shared_ptr<GraphStorage> &graph);
+void convert_rcr_to_rcl_chain_bcs(const std::shared_ptr<GraphStorage> &graph, MPI_Comm comm = MPI_COMM_WORLD);
 
 EdgeTreeParameters calculate_edge_tree_parameters(const Edge& edge);
 
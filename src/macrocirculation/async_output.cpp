@@ -0,0 +1,123 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "async_output.hpp"
+
+#include <iostream>
+#include <utility>
+
+namespace macrocirculation {
+
+AsyncOutput::AsyncOutput(WriteFunction write, std::size_t num_buffers)
+    : d_write(std::move(write)),
+      d_ring(num_buffers),
+      d_first(0),
+      d_num_pending(0),
+      d_num_stalls(0),
+      d_stop(false) {
+  if (num_buffers > 0)
+    d_thread = std::thread([this]() { work(); });
+}
+
+AsyncOutput::~AsyncOutput() {
+  if (!d_thread.joinable())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(d_mutex);
+    d_stop = true;
+  }
+  d_pending_cv.notify_one();
+  d_thread.join();
+
+  if (d_exception) {
+    try {
+      std::rethrow_exception(d_exception);
+    } catch (const std::exception &e) {
+      std::cerr << "AsyncOutput: the output failed with: " << e.what() << std::endl;
+    } catch (...) {
+      std::cerr << "AsyncOutput: the output failed" << std::endl;
+    }
+  }
+}
+
+void AsyncOutput::push(double t, const std::vector<double> &u) {
+  if (d_ring.empty()) {
+    d_write(t, u);
+    return;
+  }
+
+  std::size_t idx;
+  {
+    std::unique_lock<std::mutex> lock(d_mutex);
+    rethrow_exception();
+    if (d_num_pending == d_ring.size()) {
+      d_num_stalls += 1;
+      d_written_cv.wait(lock, [this]() { return d_num_pending < d_ring.size() || d_exception; });
+      rethrow_exception();
+    }
+    idx = (d_first + d_num_pending) % d_ring.size();
+  }
+
+  // the writer thread does not touch the free buffers, hence we copy without holding the lock
+  d_ring[idx].t = t;
+  d_ring[idx].u = u;
+
+  {
+    std::lock_guard<std::mutex> lock(d_mutex);
+    d_num_pending += 1;
+  }
+  d_pending_cv.notify_one();
+}
+
+void AsyncOutput::finish() {
+  std::unique_lock<std::mutex> lock(d_mutex);
+  d_written_cv.wait(lock, [this]() { return d_num_pending == 0; });
+  rethrow_exception();
+}
+
+std::size_t AsyncOutput::num_stalls() const {
+  std::lock_guard<std::mutex> lock(d_mutex);
+  return d_num_stalls;
+}
+
+void AsyncOutput::rethrow_exception() {
+  if (d_exception)
+    std::rethrow_exception(std::exchange(d_exception, nullptr));
+}
+
+void AsyncOutput::work() {
+  while (true) {
+    std::size_t idx;
+    {
+      std::unique_lock<std::mutex> lock(d_mutex);
+      d_pending_cv.wait(lock, [this]() { return d_num_pending > 0 || d_stop; });
+      // the remaining snapshots are written before we stop
+      if (d_num_pending == 0)
+        return;
+      idx = d_first;
+    }
+
+    std::exception_ptr exception;
+    try {
+      d_write(d_ring[idx].t, d_ring[idx].u);
+    } catch (...) {
+      exception = std::current_exception();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(d_mutex);
+      if (exception && !d_exception)
+        d_exception = exception;
+      d_first = (d_first + 1) % d_ring.size();
+      d_num_pending -= 1;
+    }
+    d_written_cv.notify_all();
+  }
+}
+
+} // namespace macrocirculation
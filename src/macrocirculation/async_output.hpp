@@ -0,0 +1,92 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_ASYNC_OUTPUT_HPP
+#define TUMORMODELS_ASYNC_OUTPUT_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace macrocirculation {
+
+/*! @brief Writes snapshots of the solution on a dedicated thread, while the time loop continues.
+ *
+ *         Snapshots are copied into a ring of buffers, which a background thread hands to the write function
+ *         in the order of their times. If all the buffers are in use, push waits until one is free again.
+ *         The write function must only use data of its rank; it runs concurrently with the solver,
+ *         and its mpi calls, e.g. for querying the rank, require MPI_THREAD_MULTIPLE.
+ *         Exceptions of the write function are rethrown by the next push or finish.
+ */
+class AsyncOutput {
+public:
+  /*! @brief Function type writing the given solution at the given time. */
+  using WriteFunction = std::function<void(double, const std::vector<double> &)>;
+
+  /*! @brief Creates a ring with num_buffers snapshots. With zero buffers every push writes synchronously. */
+  AsyncOutput(WriteFunction write, std::size_t num_buffers);
+
+  AsyncOutput(const AsyncOutput &) = delete;
+  AsyncOutput &operator=(const AsyncOutput &) = delete;
+
+  /*! @brief Writes the remaining snapshots and stops the thread. */
+  ~AsyncOutput();
+
+  /*! @brief Copies u into the ring for being written at time t. */
+  void push(double t, const std::vector<double> &u);
+
+  /*! @brief Waits until all the snapshots are written. */
+  void finish();
+
+  /*! @returns How often push had to wait for a free buffer, which hints at too few buffers or a slow disk. */
+  std::size_t num_stalls() const;
+
+private:
+  struct Snapshot {
+    double t;
+    std::vector<double> u;
+  };
+
+  WriteFunction d_write;
+
+  std::vector<Snapshot> d_ring;
+
+  /*! @brief The index of the oldest snapshot, which is written next. */
+  std::size_t d_first;
+
+  /*! @brief The number of snapshots in the ring, which are not written yet. */
+  std::size_t d_num_pending;
+
+  std::size_t d_num_stalls;
+
+  bool d_stop;
+
+  std::exception_ptr d_exception;
+
+  mutable std::mutex d_mutex;
+
+  /*! @brief Wakes up the writer thread if a snapshot is available. */
+  std::condition_variable d_pending_cv;
+
+  /*! @brief Notifies the time loop that a snapshot was written. */
+  std::condition_variable d_written_cv;
+
+  std::thread d_thread;
+
+  void work();
+
+  /*! @brief Rethrows and clears the exception of the writer thread, the lock has to be held. */
+  void rethrow_exception();
+};
+
+} // namespace macrocirculation
+
+#endif
@@ -0,0 +1,61 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "boundary_function_cache.hpp"
+
+#include <cmath>
+#include <utility>
+
+namespace macrocirculation {
+
+BoundaryFunctionCache::BoundaryFunctionCache()
+    : d_t(NAN),
+      d_num_evaluations(0) {}
+
+void BoundaryFunctionCache::clear() {
+  d_entries.clear();
+  d_values.clear();
+  d_t = NAN;
+}
+
+std::size_t BoundaryFunctionCache::add(Function f) {
+  d_entries.push_back({std::move(f), {}});
+  d_values.push_back(NAN);
+  d_t = NAN;
+  return d_entries.size() - 1;
+}
+
+std::size_t BoundaryFunctionCache::add(tabulated_periodic_function tabulation) {
+  d_entries.push_back({{}, std::move(tabulation)});
+  d_values.push_back(NAN);
+  d_t = NAN;
+  return d_entries.size() - 1;
+}
+
+void BoundaryFunctionCache::set_function(std::size_t idx, Function f) {
+  d_entries.at(idx) = {std::move(f), std::nullopt};
+  d_t = NAN;
+}
+
+void BoundaryFunctionCache::set_tabulation(std::size_t idx, tabulated_periodic_function tabulation) {
+  d_entries.at(idx).tabulation = std::move(tabulation);
+  d_t = NAN;
+}
+
+void BoundaryFunctionCache::update(double t) {
+  if (t == d_t)
+    return;
+
+  for (std::size_t k = 0; k < d_entries.size(); k += 1) {
+    const auto &entry = d_entries[k];
+    d_values[k] = entry.tabulation ? (*entry.tabulation)(t) : entry.function(t);
+  }
+  d_t = t;
+  d_num_evaluations += 1;
+}
+
+} // namespace macrocirculation
@@ -0,0 +1,80 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_BOUNDARY_FUNCTION_CACHE_HPP
+#define TUMORMODELS_BOUNDARY_FUNCTION_CACHE_HPP
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "vessel_formulas.hpp"
+
+namespace macrocirculation {
+
+/*! @brief Evaluates the time dependent boundary functions, e.g. the inflows of a network, once for every stage time.
+ *
+ *  The functions are numbered in the order they were added and their values at the time of the last update are kept in a dense array,
+ *  such that the upwinding of all the vertices, which might run on several threads, only reads them.
+ *  Expensive functions, e.g. a fitted spline, can be replaced by a precomputed tabulation, which is evaluated without the indirection of a std::function.
+ */
+class BoundaryFunctionCache {
+public:
+  using Function = std::function<double(double)>;
+
+  BoundaryFunctionCache();
+
+  /*! @brief Removes all the functions. */
+  void clear();
+
+  /*! @brief Adds a function and returns its index. */
+  std::size_t add(Function f);
+
+  /*! @brief Adds a tabulation and returns its index. */
+  std::size_t add(tabulated_periodic_function tabulation);
+
+  /*! @brief Replaces the function or tabulation with the given index by a function. */
+  void set_function(std::size_t idx, Function f);
+
+  /*! @brief Replaces the function with the given index by a tabulation. */
+  void set_tabulation(std::size_t idx, tabulated_periodic_function tabulation);
+
+  /*! @brief Evaluates all the functions at time t, unless they were already evaluated at this time. */
+  void update(double t);
+
+  /*! @brief Returns the value of the function with the given index at the time of the last update. */
+  double get(std::size_t idx) const { return d_values[idx]; }
+
+  /*! @brief The time of the last update or NaN. */
+  double get_time() const { return d_t; }
+
+  std::size_t size() const { return d_entries.size(); }
+
+  /*! @brief The number of updates, which evaluated the functions, since the construction. */
+  std::size_t num_evaluations() const { return d_num_evaluations; }
+
+private:
+  struct Entry {
+    Function function;
+
+    /*! @brief Replaces the function, if it is set. */
+    std::optional<tabulated_periodic_function> tabulation;
+  };
+
+  std::vector<Entry> d_entries;
+
+  std::vector<double> d_values;
+
+  double d_t;
+
+  std::size_t d_num_evaluations;
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_BOUNDARY_FUNCTION_CACHE_HPP
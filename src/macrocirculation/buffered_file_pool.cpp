@@ -0,0 +1,72 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "buffered_file_pool.hpp"
+
+#include <stdexcept>
+
+namespace macrocirculation {
+
+BufferedFilePool::BufferedFilePool(std::size_t buffer_size)
+    : d_buffer_size(buffer_size) {}
+
+BufferedFilePool::~BufferedFilePool() {
+  close();
+}
+
+void BufferedFilePool::set_buffer_size(std::size_t buffer_size) {
+  d_buffer_size = buffer_size;
+}
+
+std::ostream &BufferedFilePool::get(const std::string &path) {
+  auto it = d_files.find(path);
+  if (it != d_files.end())
+    return it->second->stream;
+
+  auto file = open(path);
+  if (file == nullptr) {
+    // we might have run out of file descriptors, hence we give ours back and try again
+    close();
+    file = open(path);
+  }
+  if (file == nullptr)
+    throw std::runtime_error("could not open " + path + " for writing");
+
+  d_opened_paths.insert(path);
+  return d_files.emplace(path, std::move(file)).first->second->stream;
+}
+
+void BufferedFilePool::flush() {
+  for (auto &it : d_files)
+    it.second->stream.flush();
+}
+
+void BufferedFilePool::close() {
+  // the streams flush their buffers when they are destroyed
+  d_files.clear();
+}
+
+void BufferedFilePool::reset() {
+  close();
+  d_opened_paths.clear();
+}
+
+std::unique_ptr<BufferedFilePool::File> BufferedFilePool::open(const std::string &path) const {
+  auto file = std::make_unique<File>();
+  // the buffer has to be set before the file is opened
+  if (d_buffer_size > 0) {
+    file->buffer.resize(d_buffer_size);
+    file->stream.rdbuf()->pubsetbuf(file->buffer.data(), static_cast<std::streamsize>(file->buffer.size()));
+  }
+  // files closed for lack of descriptors keep their data, when they are reopened
+  file->stream.open(path, d_opened_paths.count(path) > 0 ? std::ios::app : std::ios::trunc);
+  if (!file->stream)
+    return nullptr;
+  return file;
+}
+
+} // namespace macrocirculation
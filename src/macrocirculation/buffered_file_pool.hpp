@@ -0,0 +1,76 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_BUFFERED_FILE_POOL_HPP
+#define TUMORMODELS_BUFFERED_FILE_POOL_HPP
+
+#include <cstddef>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace macrocirculation {
+
+/*! @brief Keeps the files of a writer open in append mode, each one with a large user-space buffer,
+ *         such that the writer does not reopen its files on every output step.
+ *         The buffered data reaches the disk when a buffer is full, on flush and when the pool is destroyed.
+ *
+ *  A file is truncated when the pool opens it for the first time, hence the writers create their files lazily on their first write,
+ *  and files without any data, e.g. of the vertices of a writer gathering its output, are never created.
+ */
+class BufferedFilePool {
+public:
+  static constexpr std::size_t default_buffer_size = 1 << 16;
+
+  explicit BufferedFilePool(std::size_t buffer_size = default_buffer_size);
+
+  BufferedFilePool(const BufferedFilePool &) = delete;
+  BufferedFilePool &operator=(const BufferedFilePool &) = delete;
+
+  /*! @brief Flushes and closes all the files. */
+  ~BufferedFilePool();
+
+  /*! @brief Sets the buffer size in bytes for the files, which are opened afterwards. */
+  void set_buffer_size(std::size_t buffer_size);
+
+  /*! @brief Returns the stream appending to the file at path, which is opened, and truncated, on its first use. */
+  std::ostream &get(const std::string &path);
+
+  /*! @brief Writes the buffers of all the open files to the disk. */
+  void flush();
+
+  /*! @brief Flushes and closes all the files, which are reopened on their next use. */
+  void close();
+
+  /*! @brief Flushes and closes all the files, which are truncated again on their next use. */
+  void reset();
+
+private:
+  /*! @brief The stream is declared last, such that it is destroyed and flushed while its buffer is still alive. */
+  struct File {
+    std::vector<char> buffer;
+    std::ofstream stream;
+  };
+
+  std::size_t d_buffer_size;
+
+  std::map<std::string, std::unique_ptr<File>> d_files;
+
+  /*! @brief The paths of all the files, which were opened since the construction or the last reset. */
+  std::set<std::string> d_opened_paths;
+
+  /*! @brief Opens the file at path with our buffer size, or returns a nullptr if this fails. */
+  std::unique_ptr<File> open(const std::string &path) const;
+};
+
+} // namespace macrocirculation
+
+#endif
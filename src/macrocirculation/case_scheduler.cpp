@@ -0,0 +1,113 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "case_scheduler.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "communication/mpi.hpp"
+
+namespace macrocirculation {
+
+CaseScheduler::CaseScheduler(MPI_Comm comm, std::size_t ranks_per_case)
+    : d_comm(comm),
+      d_case_comm(MPI_COMM_NULL),
+      d_num_groups(0),
+      d_group(0),
+      d_counter_window(MPI_WIN_NULL),
+      d_counter(nullptr) {
+  if (ranks_per_case == 0)
+    throw std::runtime_error("CaseScheduler: a case needs at least one rank");
+
+  const auto size = static_cast<std::size_t>(mpi::size(comm));
+  const auto rank = static_cast<std::size_t>(mpi::rank(comm));
+
+  d_num_groups = std::max<std::size_t>(1, size / ranks_per_case);
+  d_group = std::min(rank / ranks_per_case, d_num_groups - 1);
+  CHECK_MPI_SUCCESS(MPI_Comm_split(comm, static_cast<int>(d_group), static_cast<int>(rank), &d_case_comm));
+
+  const MPI_Aint window_size = rank == 0 ? sizeof(long) : 0;
+  CHECK_MPI_SUCCESS(MPI_Win_allocate(window_size, sizeof(long), MPI_INFO_NULL, comm, &d_counter, &d_counter_window));
+}
+
+CaseScheduler::~CaseScheduler() {
+  MPI_Win_free(&d_counter_window);
+  MPI_Comm_free(&d_case_comm);
+}
+
+MPI_Comm CaseScheduler::get_case_comm() const { return d_case_comm; }
+
+std::size_t CaseScheduler::num_groups() const { return d_num_groups; }
+
+std::size_t CaseScheduler::get_group() const { return d_group; }
+
+std::size_t CaseScheduler::fetch_next_case() {
+  const long increment = 1;
+  long next_case;
+  CHECK_MPI_SUCCESS(MPI_Win_lock(MPI_LOCK_SHARED, 0, 0, d_counter_window));
+  CHECK_MPI_SUCCESS(MPI_Fetch_and_op(&increment, &next_case, MPI_LONG, 0, 0, MPI_SUM, d_counter_window));
+  CHECK_MPI_SUCCESS(MPI_Win_unlock(0, d_counter_window));
+  return static_cast<std::size_t>(next_case);
+}
+
+std::vector<std::vector<double>> CaseScheduler::run(std::size_t num_cases, const CaseFunction &fct) {
+  // reset the counter, before any group fetches its first case
+  if (mpi::rank(d_comm) == 0) {
+    CHECK_MPI_SUCCESS(MPI_Win_lock(MPI_LOCK_EXCLUSIVE, 0, 0, d_counter_window));
+    *d_counter = 0;
+    CHECK_MPI_SUCCESS(MPI_Win_unlock(0, d_counter_window));
+  }
+  CHECK_MPI_SUCCESS(MPI_Barrier(d_comm));
+
+  const bool is_leader = mpi::rank(d_case_comm) == 0;
+
+  // the results of our group, serialized as [case index, number of values, values... ]
+  std::vector<double> local_results;
+
+  while (true) {
+    unsigned long case_index = is_leader ? fetch_next_case() : 0;
+    CHECK_MPI_SUCCESS(MPI_Bcast(&case_index, 1, MPI_UNSIGNED_LONG, 0, d_case_comm));
+    if (case_index >= num_cases)
+      break;
+
+    const auto values = fct(case_index, d_case_comm);
+
+    if (is_leader) {
+      local_results.push_back(static_cast<double>(case_index));
+      local_results.push_back(static_cast<double>(values.size()));
+      local_results.insert(local_results.end(), values.begin(), values.end());
+    }
+  }
+
+  // collect the results centrally
+  const int local_size = static_cast<int>(local_results.size());
+  std::vector<int> sizes(mpi::size(d_comm), 0);
+  CHECK_MPI_SUCCESS(MPI_Gather(&local_size, 1, MPI_INT, sizes.data(), 1, MPI_INT, 0, d_comm));
+
+  std::vector<int> displacements(sizes.size(), 0);
+  for (std::size_t k = 1; k < sizes.size(); k += 1)
+    displacements[k] = displacements[k - 1] + sizes[k - 1];
+
+  std::vector<double> all_results(static_cast<std::size_t>(displacements.back() + sizes.back()));
+  CHECK_MPI_SUCCESS(MPI_Gatherv(local_results.data(), local_size, MPI_DOUBLE, all_results.data(), sizes.data(), displacements.data(), MPI_DOUBLE, 0, d_comm));
+
+  std::vector<std::vector<double>> results;
+  if (mpi::rank(d_comm) != 0)
+    return results;
+
+  results.resize(num_cases);
+  for (std::size_t k = 0; k < all_results.size();) {
+    const auto case_index = static_cast<std::size_t>(all_results[k]);
+    const auto num_values = static_cast<std::size_t>(all_results[k + 1]);
+    results[case_index].assign(all_results.begin() + static_cast<long>(k + 2), all_results.begin() + static_cast<long>(k + 2 + num_values));
+    k += 2 + num_values;
+  }
+  return results;
+}
+
+} // namespace macrocirculation
@@ -0,0 +1,72 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_CASE_SCHEDULER_HPP
+#define TUMORMODELS_CASE_SCHEDULER_HPP
+
+#include <cstddef>
+#include <functional>
+#include <mpi.h>
+#include <vector>
+
+namespace macrocirculation {
+
+/*! @brief Runs independent simulations, e.g. the cases of a convergence study or a parameter sweep, concurrently
+ *         on groups of ranks, such that a batch job uses all of its ranks instead of running the cases one after another.
+ *
+ *  The communicator is split into groups of ranks_per_case consecutive ranks, where the remaining ranks join the last group.
+ *  The cases are scheduled dynamically: Whenever a group has finished a case, its leader fetches the index of the next case
+ *  from a shared counter on rank 0 of the communicator, such that long and short cases are balanced automatically.
+ *  The results of all the cases are gathered on rank 0 of the communicator.
+ */
+class CaseScheduler {
+public:
+  /*! @brief Runs a single case on the communicator of its group and returns its results on rank 0 of the group. */
+  using CaseFunction = std::function<std::vector<double>(std::size_t case_index, MPI_Comm case_comm)>;
+
+  CaseScheduler(MPI_Comm comm, std::size_t ranks_per_case);
+
+  CaseScheduler(const CaseScheduler &) = delete;
+  CaseScheduler &operator=(const CaseScheduler &) = delete;
+
+  ~CaseScheduler();
+
+  /*! @brief The communicator of the group of our rank, on which the cases are run. */
+  MPI_Comm get_case_comm() const;
+
+  std::size_t num_groups() const;
+
+  /*! @brief The index of the group of our rank. */
+  std::size_t get_group() const;
+
+  /*! @brief Runs all the cases. This is collective on the communicator.
+   *
+   * @return The results of all the cases ordered by their index on rank 0 of the communicator, and nothing on the other ranks.
+   */
+  std::vector<std::vector<double>> run(std::size_t num_cases, const CaseFunction &fct);
+
+private:
+  MPI_Comm d_comm;
+
+  MPI_Comm d_case_comm;
+
+  std::size_t d_num_groups;
+
+  std::size_t d_group;
+
+  /*! @brief The window holding the index of the next case, which is only backed by memory on rank 0. */
+  MPI_Win d_counter_window;
+
+  long *d_counter;
+
+  /*! @brief Atomically fetches and increments the index of the next case. */
+  std::size_t fetch_next_case();
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_CASE_SCHEDULER_HPP
@@ -0,0 +1,227 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "checkpoint.hpp"
+
+#include <array>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+
+#include "communication/mpi.hpp"
+#include "dof_map.hpp"
+#include "graph_storage.hpp"
+
+namespace macrocirculation {
+
+namespace {
+
+/*! @brief Identifies our checkpoint files and their version. */
+constexpr std::array<char, 8> checkpoint_magic = {'M', 'C', '1', 'D', 'C', 'K', 'P', '1'};
+
+/*! @brief The kinds of primitives, whose values are stored in a checkpoint. */
+enum class PrimitiveType : std::uint64_t { edge = 0,
+                                           vertex = 1 };
+
+/*! @brief The values of a single primitive in a checkpoint. */
+using PrimitiveKey = std::pair<PrimitiveType, std::size_t>;
+
+std::uint64_t hash_combine(std::uint64_t hash, std::uint64_t value) {
+  // FNV-1a on the 8 bytes of the value
+  for (std::size_t k = 0; k < 8; k += 1) {
+    hash ^= (value >> (8 * k)) & 0xff;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+template<typename T>
+void write_value(std::ofstream &f, const T &value) {
+  f.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+template<typename T>
+T read_value(std::ifstream &f) {
+  T value;
+  f.read(reinterpret_cast<char *>(&value), sizeof(T));
+  if (!f)
+    throw std::runtime_error("checkpoint file is truncated");
+  return value;
+}
+
+/*! @brief Calls f(key, dof_indices) for all the primitives with dofs, which are owned by the calling rank. */
+template<typename Function>
+void for_owned_primitives(MPI_Comm comm, const GraphStorage &graph, const DofMap &dof_map, Function f) {
+  const auto rank = mpi::rank(comm);
+
+  std::vector<std::size_t> dof_indices;
+  for (auto e_id : graph.get_active_edge_ids(rank)) {
+    const auto &local_dof_map = dof_map.get_local_dof_map(graph.edge(e_id));
+    dof_indices.resize(local_dof_map.num_local_dof());
+    // the dofs of an edge are contiguous
+    for (std::size_t k = 0; k < dof_indices.size(); k += 1)
+      dof_indices[k] = local_dof_map.first_dof(0, 0) + k;
+    f(PrimitiveKey{PrimitiveType::edge, e_id}, dof_indices);
+  }
+
+  for (auto v_id : graph.get_active_vertex_ids(rank)) {
+    const auto &vertex = graph.vertex(v_id);
+    if (!vertex.is_leaf() || !graph.owns_primitive(vertex, static_cast<std::size_t>(rank)))
+      continue;
+    const auto &local_dof_map = dof_map.get_local_dof_map(vertex);
+    if (local_dof_map.num_local_dof() > 0)
+      f(PrimitiveKey{PrimitiveType::vertex, v_id}, local_dof_map.dof_indices());
+  }
+}
+
+/*! @brief Reads the header of a checkpoint file and checks it against our fingerprint. */
+void read_header(std::ifstream &f, const std::string &file_path, std::uint64_t fingerprint, std::uint64_t &num_ranks, double &t) {
+  std::array<char, 8> magic{};
+  f.read(magic.data(), magic.size());
+  if (!f || magic != checkpoint_magic)
+    throw std::runtime_error("file " + file_path + " is not a checkpoint");
+  num_ranks = read_value<std::uint64_t>(f);
+  read_value<std::uint64_t>(f); // the rank which wrote the file
+  if (read_value<std::uint64_t>(f) != fingerprint)
+    throw std::runtime_error("the dof map of checkpoint " + file_path + " does not match our dof map");
+  t = read_value<double>(f);
+}
+
+/*! @brief Copies all the values of the checkpoint file, which belong to the given primitives, into u and removes them from the list. */
+void read_values(const std::string &file_path, std::uint64_t fingerprint, std::map<PrimitiveKey, std::vector<std::size_t>> &missing, std::vector<double> &u) {
+  std::ifstream f(file_path, std::ios::binary);
+  if (!f)
+    throw std::runtime_error("could not open checkpoint file " + file_path);
+
+  std::uint64_t num_ranks;
+  double t;
+  read_header(f, file_path, fingerprint, num_ranks, t);
+
+  const auto num_primitives = read_value<std::uint64_t>(f);
+  std::vector<double> values;
+  for (std::size_t k = 0; k < num_primitives; k += 1) {
+    const auto type = static_cast<PrimitiveType>(read_value<std::uint64_t>(f));
+    const auto id = static_cast<std::size_t>(read_value<std::uint64_t>(f));
+    const auto num_values = static_cast<std::size_t>(read_value<std::uint64_t>(f));
+    values.resize(num_values);
+    f.read(reinterpret_cast<char *>(values.data()), static_cast<std::streamsize>(num_values * sizeof(double)));
+    if (!f)
+      throw std::runtime_error("checkpoint file " + file_path + " is truncated");
+
+    auto it = missing.find({type, id});
+    if (it == missing.end())
+      continue;
+    if (it->second.size() != num_values)
+      throw std::runtime_error("checkpoint file " + file_path + " has the wrong number of values for primitive " + std::to_string(id));
+    for (std::size_t i = 0; i < num_values; i += 1)
+      u[it->second[i]] = values[i];
+    missing.erase(it);
+  }
+}
+
+} // namespace
+
+std::uint64_t dof_map_fingerprint(MPI_Comm comm, const GraphStorage &graph, const DofMap &dof_map) {
+  const auto rank = mpi::rank(comm);
+
+  // the sum of the hashes of the primitives does not depend on their distribution among the ranks
+  std::uint64_t fingerprint = 0;
+  for (auto e_id : graph.get_active_edge_ids(rank)) {
+    const auto &local_dof_map = dof_map.get_local_dof_map(graph.edge(e_id));
+    std::uint64_t hash = 14695981039346656037ull;
+    hash = hash_combine(hash, static_cast<std::uint64_t>(PrimitiveType::edge));
+    hash = hash_combine(hash, e_id);
+    hash = hash_combine(hash, local_dof_map.num_components());
+    hash = hash_combine(hash, local_dof_map.num_basis_functions());
+    hash = hash_combine(hash, local_dof_map.num_micro_edges());
+    fingerprint += hash;
+  }
+  for_owned_primitives(comm, graph, dof_map, [&](const PrimitiveKey &key, const std::vector<std::size_t> &dof_indices) {
+    if (key.first != PrimitiveType::vertex)
+      return;
+    std::uint64_t hash = 14695981039346656037ull;
+    hash = hash_combine(hash, static_cast<std::uint64_t>(PrimitiveType::vertex));
+    hash = hash_combine(hash, key.second);
+    hash = hash_combine(hash, dof_indices.size());
+    fingerprint += hash;
+  });
+
+  MPI_Allreduce(MPI_IN_PLACE, &fingerprint, 1, MPI_UINT64_T, MPI_SUM, comm);
+
+  return fingerprint;
+}
+
+std::string checkpoint_file_path(const std::string &path, int rank) {
+  return path + "." + std::to_string(rank) + ".bin";
+}
+
+void write_checkpoint(MPI_Comm comm, const std::string &path, const GraphStorage &graph, const DofMap &dof_map, const std::vector<double> &u, double t) {
+  const auto fingerprint = dof_map_fingerprint(comm, graph, dof_map);
+
+  const auto file_path = checkpoint_file_path(path, mpi::rank(comm));
+  std::ofstream f(file_path, std::ios::binary | std::ios::out);
+  if (!f)
+    throw std::runtime_error("could not open checkpoint file " + file_path);
+
+  f.write(checkpoint_magic.data(), checkpoint_magic.size());
+  write_value<std::uint64_t>(f, static_cast<std::uint64_t>(mpi::size(comm)));
+  write_value<std::uint64_t>(f, static_cast<std::uint64_t>(mpi::rank(comm)));
+  write_value<std::uint64_t>(f, fingerprint);
+  write_value<double>(f, t);
+
+  std::uint64_t num_primitives = 0;
+  for_owned_primitives(comm, graph, dof_map, [&](const PrimitiveKey &, const std::vector<std::size_t> &) { num_primitives += 1; });
+  write_value<std::uint64_t>(f, num_primitives);
+
+  for_owned_primitives(comm, graph, dof_map, [&](const PrimitiveKey &key, const std::vector<std::size_t> &dof_indices) {
+    write_value<std::uint64_t>(f, static_cast<std::uint64_t>(key.first));
+    write_value<std::uint64_t>(f, key.second);
+    write_value<std::uint64_t>(f, dof_indices.size());
+    for (auto i : dof_indices)
+      write_value<double>(f, u[i]);
+  });
+
+  if (!f)
+    throw std::runtime_error("could not write checkpoint file " + file_path);
+
+  // the checkpoint is only complete, if all the ranks have written their files
+  MPI_Barrier(comm);
+}
+
+double read_checkpoint(MPI_Comm comm, const std::string &path, const GraphStorage &graph, const DofMap &dof_map, std::vector<double> &u) {
+  const auto fingerprint = dof_map_fingerprint(comm, graph, dof_map);
+  const auto rank = mpi::rank(comm);
+
+  std::map<PrimitiveKey, std::vector<std::size_t>> missing;
+  for_owned_primitives(comm, graph, dof_map, [&](const PrimitiveKey &key, const std::vector<std::size_t> &dof_indices) { missing[key] = dof_indices; });
+
+  // the header of the first file tells us how many ranks wrote the checkpoint
+  std::uint64_t num_ranks;
+  double t;
+  {
+    const auto file_path = checkpoint_file_path(path, 0);
+    std::ifstream f(file_path, std::ios::binary);
+    if (!f)
+      throw std::runtime_error("could not open checkpoint file " + file_path);
+    read_header(f, file_path, fingerprint, num_ranks, t);
+  }
+
+  // on the same partitioning our own file contains everything, otherwise we redistribute by searching the other files
+  if (static_cast<std::uint64_t>(rank) < num_ranks)
+    read_values(checkpoint_file_path(path, rank), fingerprint, missing, u);
+  for (std::uint64_t r = 0; r < num_ranks && !missing.empty(); r += 1) {
+    if (r != static_cast<std::uint64_t>(rank))
+      read_values(checkpoint_file_path(path, static_cast<int>(r)), fingerprint, missing, u);
+  }
+
+  if (!missing.empty())
+    throw std::runtime_error("checkpoint " + path + " has no values for primitive " + std::to_string(missing.begin()->first.second));
+
+  return t;
+}
+
+} // namespace macrocirculation
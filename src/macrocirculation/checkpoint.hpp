@@ -0,0 +1,49 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_CHECKPOINT_HPP
+#define TUMORMODELS_CHECKPOINT_HPP
+
+#include <cstdint>
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+namespace macrocirculation {
+
+// forward declarations
+class GraphStorage;
+class DofMap;
+
+/*! @brief Calculates a fingerprint of the dof layout, i.e. the number of components, basis functions and micro edges of every edge
+ *         and the number of dofs of every vertex. It does not depend on the partitioning of the graph, but is collective on comm.
+ */
+std::uint64_t dof_map_fingerprint(MPI_Comm comm, const GraphStorage &graph, const DofMap &dof_map);
+
+/*! @returns The path of the file, into which the given rank writes its part of the checkpoint. */
+std::string checkpoint_file_path(const std::string &path, int rank);
+
+/*! @brief Writes the values of u on all the edges and vertices owned by this rank into a binary checkpoint.
+ *
+ *  Every rank writes its own file, containing the number of ranks, the dof map fingerprint, the time t
+ *  and the values of u for each of its edges and vertices together with their ids, which records the partitioning.
+ *  Since the values are stored per primitive instead of per dof index, the checkpoint can be read on any partitioning.
+ */
+void write_checkpoint(MPI_Comm comm, const std::string &path, const GraphStorage &graph, const DofMap &dof_map, const std::vector<double> &u, double t);
+
+/*! @brief Reads the values of u on all the edges and vertices owned by this rank from a checkpoint written by write_checkpoint.
+ *
+ *  On the same partitioning every rank only reads its own file, otherwise the rank searches all the files of the checkpoint.
+ *  Throws if the dof map fingerprint does not match or if values are missing.
+ *
+ * @return The time at which the checkpoint was written.
+ */
+double read_checkpoint(MPI_Comm comm, const std::string &path, const GraphStorage &graph, const DofMap &dof_map, std::vector<double> &u);
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_CHECKPOINT_HPP
@@ -18,7 +18,7 @@ std::vector<char> &SendBuffer::get_buffer() { return d_buffer; }
 
 void SendBuffer::clear() { d_buffer.clear(); }
 
-char *SendBuffer::ptr() { return &d_buffer[0]; }
+char *SendBuffer::ptr() { return d_buffer.data(); }
 
 std::size_t SendBuffer::size() { return d_buffer.size(); }
 
@@ -32,20 +32,22 @@ void ReceiveBuffer::clear() {
   d_current_position = 0;
 }
 
-char *ReceiveBuffer::ptr() { return &d_buffer[0]; }
+char *ReceiveBuffer::ptr() { return d_buffer.data(); }
 
 std::size_t ReceiveBuffer::size() { return d_buffer.size(); }
 
 bool ReceiveBuffer::empty() { return d_buffer.size() == d_current_position; }
 
 BufferSystem::BufferSystem(MPI_Comm comm, std::size_t tag)
-    : d_num_processes(mpi::size(comm)),
+    : d_comm(comm),
+      d_num_processes(mpi::size(comm)),
       d_rank(mpi::rank(comm)),
       d_tag(tag),
       d_receive_buffers(d_num_processes),
       d_send_buffers(d_num_processes),
       d_send_requests(d_num_processes),
-      d_receive_requests(d_num_processes) {}
+      d_receive_requests(d_num_processes),
+      d_statistics(d_num_processes) {}
 
 ReceiveBuffer &BufferSystem::get_receive_buffer(std::size_t from) {
   return d_receive_buffers.at(from);
@@ -65,26 +67,45 @@ void BufferSystem::clear() {
 }
 
 void BufferSystem::start_communication() {
-  int rank;
-  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  const auto rank = d_rank;
 
   // send the data in the send buffers:
   for (std::size_t recipient = 0; recipient < d_send_buffers.size(); recipient += 1) {
-    if (static_cast<size_t>(rank) == recipient)
+    if (rank == recipient)
       continue;
 
     auto &buffer = get_send_buffer(recipient);
     CHECK_MPI_SUCCESS(
-      MPI_Isend(buffer.ptr(), buffer.size(), MPI_BYTE, recipient, d_tag, MPI_COMM_WORLD, &d_send_requests[recipient]));
+      MPI_Isend(buffer.ptr(), buffer.size(), MPI_BYTE, recipient, d_tag, d_comm, &d_send_requests[recipient]));
+    d_statistics.add_message(recipient, buffer.size());
   }
 
+  // the data we send to ourselves is just copied:
+  {
+    auto &sbuf = get_send_buffer(rank);
+    auto &rbuf = get_receive_buffer(rank);
+    rbuf.get_buffer().assign(sbuf.get_buffer().begin(), sbuf.get_buffer().end());
+  }
+}
+
+void BufferSystem::end_communication() {
+  assert(d_send_requests.size() == d_receive_requests.size());
+
+  const auto rank = d_rank;
+
+  // The receives are only posted here, since probing for the message sizes blocks until the data arrives.
+  // Hence the caller can do other work between start and end, while the sends are in flight.
   // resize the receive buffers, depending on how much data arrives:
   for (std::size_t sender = 0; sender < d_receive_buffers.size(); sender += 1) {
-    if (static_cast<size_t>(rank) == sender)
+    if (rank == sender)
       continue;
 
+    // the probe blocks until the message of the sender arrives
+    const auto probe_start = CommunicationStatistics::Clock::now();
     MPI_Status status;
-    CHECK_MPI_SUCCESS(MPI_Probe(sender, d_tag, MPI_COMM_WORLD, &status));
+    CHECK_MPI_SUCCESS(MPI_Probe(sender, d_tag, d_comm, &status));
+    d_statistics.add_probe(sender);
+    d_statistics.add_wait(sender, CommunicationStatistics::seconds_since(probe_start));
 
     int size;
     CHECK_MPI_SUCCESS(MPI_Get_count(&status, MPI_BYTE, &size));
@@ -95,44 +116,32 @@ void BufferSystem::start_communication() {
 
   // initiate receiving:
   for (std::size_t sender = 0; sender < d_receive_buffers.size(); sender += 1) {
-    if (static_cast<size_t>(rank) == sender)
+    if (rank == sender)
       continue;
 
     auto &buffer = get_receive_buffer(sender);
     CHECK_MPI_SUCCESS(
-      MPI_Irecv(buffer.ptr(), buffer.size(), MPI_BYTE, sender, d_tag, MPI_COMM_WORLD, &d_receive_requests[sender]));
+      MPI_Irecv(buffer.ptr(), buffer.size(), MPI_BYTE, sender, d_tag, d_comm, &d_receive_requests[sender]));
   }
 
-  // the data we send to ourselves is just copied:
-  {
-    auto &sbuf = get_send_buffer(rank);
-    auto &rbuf = get_receive_buffer(rank);
-    rbuf.get_buffer().resize(sbuf.get_buffer().size());
-    for (size_t k = 0; k < sbuf.size(); k += 1)
-      rbuf.get_buffer()[k] = sbuf.get_buffer()[k];
-  }
-}
-
-void BufferSystem::end_communication() {
-  assert(d_send_requests.size() == d_receive_requests.size());
-
-  int rank;
-  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-
   for (std::size_t recipient = 0; recipient < d_send_buffers.size(); recipient += 1) {
-    if (static_cast<size_t>(rank) == recipient)
+    if (rank == recipient)
       continue;
 
+    const auto wait_start = CommunicationStatistics::Clock::now();
     MPI_Status status;
     CHECK_MPI_SUCCESS(MPI_Wait(&d_send_requests[recipient], &status));
+    d_statistics.add_wait(recipient, CommunicationStatistics::seconds_since(wait_start));
   }
 
   for (std::size_t sender = 0; sender < d_send_requests.size(); sender += 1) {
-    if (static_cast<size_t>(rank) == sender)
+    if (rank == sender)
       continue;
 
+    const auto wait_start = CommunicationStatistics::Clock::now();
     MPI_Status status;
     CHECK_MPI_SUCCESS(MPI_Wait(&d_receive_requests[sender], &status));
+    d_statistics.add_wait(sender, CommunicationStatistics::seconds_since(wait_start));
   }
 }
 } // namespace macrocirculation
@@ -9,9 +9,13 @@
 #define TUMORMODELS_BUFFER_HPP
 
 #include <cassert>
+#include <cstring>
 #include <mpi.h>
+#include <type_traits>
 #include <vector>
 
+#include "communication_statistics.hpp"
+
 namespace macrocirculation {
 
 class SendBuffer {
@@ -21,6 +25,10 @@ public:
   template<typename AtomicType>
   SendBuffer &operator<<(const AtomicType &value);
 
+  /*! @brief Appends the given number of values in one go. */
+  template<typename AtomicType>
+  SendBuffer &write(const AtomicType *values, std::size_t num_values);
+
   std::vector<char> &get_buffer();
 
   void clear();
@@ -42,6 +50,10 @@ public:
   template<typename AtomicType>
   ReceiveBuffer &operator>>(AtomicType &value);
 
+  /*! @brief Extracts the given number of values in one go. */
+  template<typename AtomicType>
+  ReceiveBuffer &read(AtomicType *values, std::size_t num_values);
+
   std::vector<char> &get_buffer();
 
   void clear();
@@ -67,11 +79,19 @@ public:
 
   void clear();
 
+  /*! @brief Posts the sends of all the send buffers and returns without waiting for their completion. */
   void start_communication();
 
+  /*! @brief Receives the data from all the other ranks and waits until all the sends are finished. */
   void end_communication();
 
+  /*! @brief Returns the messages, probes and waiting times of all the exchanges since the construction or the last reset. */
+  const CommunicationStatistics &get_statistics() const { return d_statistics; }
+
+  void reset_statistics() { d_statistics.reset(); }
+
 private:
+  MPI_Comm d_comm;
   std::size_t d_num_processes;
   std::size_t d_rank;
   std::size_t d_tag;
@@ -81,22 +101,40 @@ private:
 
   std::vector<MPI_Request> d_send_requests;
   std::vector<MPI_Request> d_receive_requests;
+
+  CommunicationStatistics d_statistics;
 };
 
 // implementations of template functions:
 template<typename AtomicType>
 SendBuffer &SendBuffer::operator<<(const AtomicType &value) {
-  const char *serialized = reinterpret_cast<const char *>(&value);
-  for (std::size_t k = 0; k < sizeof(AtomicType); k += 1)
-    d_buffer.push_back(serialized[k]);
+  return write(&value, 1);
+}
+
+template<typename AtomicType>
+SendBuffer &SendBuffer::write(const AtomicType *values, std::size_t num_values) {
+  static_assert(std::is_trivially_copyable<AtomicType>::value, "only trivially copyable types can be serialized");
+  // resize keeps the capacity of previous exchanges, hence no allocation happens once the buffer has grown
+  const std::size_t position = d_buffer.size();
+  d_buffer.resize(position + num_values * sizeof(AtomicType));
+  if (num_values > 0)
+    std::memcpy(&d_buffer[position], values, num_values * sizeof(AtomicType));
   return *this;
 }
 
 template<typename AtomicType>
 inline ReceiveBuffer &ReceiveBuffer::operator>>(AtomicType &value) {
-  assert(d_current_position + sizeof(AtomicType) <= d_buffer.size());
-  value = *(reinterpret_cast<AtomicType *>(&d_buffer[d_current_position]));
-  d_current_position += sizeof(AtomicType);
+  return read(&value, 1);
+}
+
+template<typename AtomicType>
+inline ReceiveBuffer &ReceiveBuffer::read(AtomicType *values, std::size_t num_values) {
+  static_assert(std::is_trivially_copyable<AtomicType>::value, "only trivially copyable types can be serialized");
+  assert(d_current_position + num_values * sizeof(AtomicType) <= d_buffer.size());
+  // memcpy, since the position inside the buffer is not necessarily aligned for the given type
+  if (num_values > 0)
+    std::memcpy(values, &d_buffer[d_current_position], num_values * sizeof(AtomicType));
+  d_current_position += num_values * sizeof(AtomicType);
   return *this;
 }
 
@@ -0,0 +1,118 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "communication_statistics.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <nlohmann/json.hpp>
+#include <stdexcept>
+
+#include "mpi.hpp"
+
+namespace macrocirculation {
+
+CommunicationStatistics::CommunicationStatistics(std::size_t num_ranks)
+    : d_neighbors(num_ranks) {}
+
+CommunicationStatistics::Neighbor CommunicationStatistics::total() const {
+  Neighbor sum;
+  for (const auto &n : d_neighbors) {
+    sum.messages_sent += n.messages_sent;
+    sum.bytes_sent += n.bytes_sent;
+    sum.empty_messages += n.empty_messages;
+    sum.probes += n.probes;
+    sum.wait_seconds += n.wait_seconds;
+  }
+  return sum;
+}
+
+CommunicationStatistics &CommunicationStatistics::operator+=(const CommunicationStatistics &other) {
+  if (other.num_ranks() != num_ranks())
+    throw std::runtime_error("CommunicationStatistics: only statistics on the same communicator can be added");
+  for (std::size_t k = 0; k < d_neighbors.size(); k += 1) {
+    d_neighbors[k].messages_sent += other.d_neighbors[k].messages_sent;
+    d_neighbors[k].bytes_sent += other.d_neighbors[k].bytes_sent;
+    d_neighbors[k].empty_messages += other.d_neighbors[k].empty_messages;
+    d_neighbors[k].probes += other.d_neighbors[k].probes;
+    d_neighbors[k].wait_seconds += other.d_neighbors[k].wait_seconds;
+  }
+  return *this;
+}
+
+void CommunicationStatistics::reset() {
+  for (auto &n : d_neighbors)
+    n = Neighbor();
+}
+
+namespace {
+
+double get_quantity(const CommunicationStatistics::Neighbor &n, CommunicationStatistics::Quantity quantity) {
+  using Quantity = CommunicationStatistics::Quantity;
+  switch (quantity) {
+    case Quantity::messages_sent:
+      return static_cast<double>(n.messages_sent);
+    case Quantity::bytes_sent:
+      return static_cast<double>(n.bytes_sent);
+    case Quantity::empty_messages:
+      return static_cast<double>(n.empty_messages);
+    case Quantity::probes:
+      return static_cast<double>(n.probes);
+    case Quantity::wait_seconds:
+      return n.wait_seconds;
+  }
+  throw std::runtime_error("unknown quantity");
+}
+
+} // namespace
+
+std::vector<double> CommunicationStatistics::gather_neighbor_matrix(MPI_Comm comm, Quantity quantity) const {
+  const auto num_ranks = static_cast<std::size_t>(mpi::size(comm));
+  if (d_neighbors.size() != num_ranks)
+    throw std::runtime_error("CommunicationStatistics: the statistics do not belong to the given communicator");
+
+  std::vector<double> row(num_ranks);
+  for (std::size_t k = 0; k < num_ranks; k += 1)
+    row[k] = get_quantity(d_neighbors[k], quantity);
+
+  const bool is_root = mpi::rank(comm) == 0;
+  std::vector<double> matrix(is_root ? num_ranks * num_ranks : 0);
+  CHECK_MPI_SUCCESS(MPI_Gather(row.data(), static_cast<int>(num_ranks), MPI_DOUBLE, matrix.data(), static_cast<int>(num_ranks), MPI_DOUBLE, 0, comm));
+  return matrix;
+}
+
+void CommunicationStatistics::write_json(MPI_Comm comm, const std::string &filepath) const {
+  using json = nlohmann::json;
+
+  const std::vector<std::pair<std::string, Quantity>> quantities{
+    {"messages_sent", Quantity::messages_sent},
+    {"bytes_sent", Quantity::bytes_sent},
+    {"empty_messages", Quantity::empty_messages},
+    {"probes", Quantity::probes},
+    {"wait_seconds", Quantity::wait_seconds}};
+
+  const auto num_ranks = d_neighbors.size();
+  json j;
+  j["num_ranks"] = num_ranks;
+  for (const auto &quantity : quantities) {
+    const auto matrix = gather_neighbor_matrix(comm, quantity.second);
+    json rows = json::array();
+    for (std::size_t r = 0; r < matrix.size() / std::max<std::size_t>(num_ranks, 1); r += 1)
+      rows.push_back(std::vector<double>(matrix.begin() + static_cast<std::ptrdiff_t>(r * num_ranks), matrix.begin() + static_cast<std::ptrdiff_t>((r + 1) * num_ranks)));
+    j[quantity.first] = rows;
+  }
+
+  if (mpi::rank(comm) != 0)
+    return;
+
+  std::ofstream o(filepath);
+  o << std::setw(4);
+  o << j;
+}
+
+} // namespace macrocirculation
@@ -0,0 +1,90 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_COMMUNICATION_STATISTICS_HPP
+#define TUMORMODELS_COMMUNICATION_STATISTICS_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+namespace macrocirculation {
+
+/*! @brief Counts the messages of the exchanges of a rank with every other rank of a communicator,
+ *         e.g. to judge the quality of a partitioning.
+ *
+ *  The time spent in a blocking wait or probe is attributed to the rank, whose message completed it.
+ *  Hence, the wait times of the neighbors sum up to the total waiting time of this rank.
+ */
+class CommunicationStatistics {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /*! @brief The counters for the exchange with a single rank. */
+  struct Neighbor {
+    std::size_t messages_sent = 0;
+    std::size_t bytes_sent = 0;
+    /*! @brief The sent messages without any data, which are part of messages_sent. */
+    std::size_t empty_messages = 0;
+    std::size_t probes = 0;
+    double wait_seconds = 0;
+  };
+
+  /*! @brief The quantities, which can be gathered into a matrix. */
+  enum class Quantity { messages_sent,
+                        bytes_sent,
+                        empty_messages,
+                        probes,
+                        wait_seconds };
+
+  explicit CommunicationStatistics(std::size_t num_ranks = 0);
+
+  /*! @brief Returns the seconds since the given time point. */
+  static double seconds_since(Clock::time_point start) { return std::chrono::duration<double>(Clock::now() - start).count(); }
+
+  void add_message(std::size_t to, std::size_t bytes) {
+    auto &n = d_neighbors[to];
+    n.messages_sent += 1;
+    n.bytes_sent += bytes;
+    n.empty_messages += bytes == 0 ? 1 : 0;
+  }
+
+  void add_probe(std::size_t from) { d_neighbors[from].probes += 1; }
+
+  void add_wait(std::size_t rank, double seconds) { d_neighbors[rank].wait_seconds += seconds; }
+
+  /*! @brief Returns the counters for the exchange with the given rank. */
+  const Neighbor &get(std::size_t rank) const { return d_neighbors.at(rank); }
+
+  /*! @brief Returns the counters summed over all the ranks. */
+  Neighbor total() const;
+
+  std::size_t num_ranks() const { return d_neighbors.size(); }
+
+  /*! @brief Adds the counters of other statistics on the same communicator, e.g. of several exchanges in a solver. */
+  CommunicationStatistics &operator+=(const CommunicationStatistics &other);
+
+  void reset();
+
+  /*! @brief Gathers the given quantity of all the ranks of comm into a row major matrix on the root,
+   *         where the row is the sending (or waiting) rank and the column is its neighbor.
+   *         The other ranks get an empty vector. The call is collective.
+   */
+  std::vector<double> gather_neighbor_matrix(MPI_Comm comm, Quantity quantity) const;
+
+  /*! @brief Writes the neighbor matrices of all the quantities as json on the root of comm. The call is collective. */
+  void write_json(MPI_Comm comm, const std::string &filepath) const;
+
+private:
+  std::vector<Neighbor> d_neighbors;
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_COMMUNICATION_STATISTICS_HPP
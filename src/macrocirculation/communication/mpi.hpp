@@ -8,17 +8,21 @@
 #ifndef TUMORMODELS_COMMUNICATION_MPI_HPP
 #define TUMORMODELS_COMMUNICATION_MPI_HPP
 
+#include <algorithm>
+#include <cmath>
 #include <mpi.h>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 namespace macrocirculation {
 
 #define CHECK_MPI_SUCCESS(code) (check_mpi_success(code, __FILE__, __LINE__))
 
-inline void check_mpi_success(int mpi_code, const std::string &file, int line) {
+// the file is not a std::string, such that successful calls in the time stepping do not allocate memory
+inline void check_mpi_success(int mpi_code, const char *file, int line) {
   if (mpi_code != MPI_SUCCESS)
-    throw std::runtime_error("wrong mpi error code at " + file + " on line " + std::to_string(line));
+    throw std::runtime_error("wrong mpi error code at " + std::string(file) + " on line " + std::to_string(line));
 }
 
 namespace mpi {
@@ -34,6 +38,78 @@ inline int rank(MPI_Comm comm) {
   return rank;
 }
 
+/*! @brief Initializes MPI with the given thread support.
+ *         The default suits the hybrid mode, where only the main thread of every rank communicates,
+ *         while the thread pools of the solvers do the edge loops.
+ *         A higher desired thread level is requested, but only the required one has to be provided,
+ *         e.g. for optional features like the asynchronous output.
+ *
+ * @return The thread support provided by MPI.
+ */
+inline int initialize(int *argc, char ***argv, int required_thread_level = MPI_THREAD_FUNNELED, int desired_thread_level = MPI_THREAD_SINGLE) {
+  int provided;
+  CHECK_MPI_SUCCESS(MPI_Init_thread(argc, argv, std::max(required_thread_level, desired_thread_level), &provided));
+  if (provided < required_thread_level)
+    throw std::runtime_error("MPI does not provide the required thread support");
+  return provided;
+}
+
+/*! @brief Returns the union of the given strings of all the ranks of comm, sorted and without duplicates.
+ *         The strings must not contain line breaks. The call is collective.
+ */
+inline std::vector<std::string> allgather_union(MPI_Comm comm, const std::vector<std::string> &strings) {
+  std::string local;
+  for (const auto &s : strings)
+    local += s + '\n';
+
+  const int num_ranks = size(comm);
+  const int local_size = static_cast<int>(local.size());
+  std::vector<int> sizes(num_ranks);
+  CHECK_MPI_SUCCESS(MPI_Allgather(&local_size, 1, MPI_INT, sizes.data(), 1, MPI_INT, comm));
+  std::vector<int> displacements(num_ranks, 0);
+  for (int r = 1; r < num_ranks; r += 1)
+    displacements[r] = displacements[r - 1] + sizes[r - 1];
+  std::string all(static_cast<std::size_t>(displacements.back() + sizes.back()), '\0');
+  CHECK_MPI_SUCCESS(MPI_Allgatherv(local.data(), local_size, MPI_CHAR, &all[0], sizes.data(), displacements.data(), MPI_CHAR, comm));
+
+  std::vector<std::string> result;
+  for (std::size_t begin = 0, end; begin < all.size(); begin = end + 1) {
+    end = all.find('\n', begin);
+    result.push_back(all.substr(begin, end - begin));
+  }
+  std::sort(result.begin(), result.end());
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+  return result;
+}
+
+/*! @brief Sums the contributions of primitives, e.g. edges, over all the ranks, such that the result does not depend on the number of ranks.
+ *
+ *  Every primitive has num_sums consecutive contributions, which only its owner sets, while all the other ranks leave them zero.
+ *  Hence the elementwise reduction of the contributions is exact, and the contributions are then summed on every rank
+ *  in the order of the primitives with compensated (Neumaier) summation. The call is collective and overwrites the contributions.
+ */
+inline std::vector<double> ordered_sum(MPI_Comm comm, std::vector<double> &contributions, std::size_t num_sums) {
+  CHECK_MPI_SUCCESS(MPI_Allreduce(MPI_IN_PLACE, contributions.data(), static_cast<int>(contributions.size()), MPI_DOUBLE, MPI_SUM, comm));
+
+  std::vector<double> sums(num_sums, 0.);
+  std::vector<double> corrections(num_sums, 0.);
+  for (std::size_t offset = 0; offset + num_sums <= contributions.size(); offset += num_sums) {
+    for (std::size_t k = 0; k < num_sums; k += 1) {
+      const double value = contributions[offset + k];
+      const double sum = sums[k] + value;
+      // the low order bits, which got lost in the addition
+      if (std::abs(sums[k]) >= std::abs(value))
+        corrections[k] += (sums[k] - sum) + value;
+      else
+        corrections[k] += (value - sum) + sums[k];
+      sums[k] = sum;
+    }
+  }
+  for (std::size_t k = 0; k < num_sums; k += 1)
+    sums[k] += corrections[k];
+  return sums;
+}
+
 inline MPI_Comm create_local() {
   MPI_Comm new_comm;
   MPI_Comm_split(MPI_COMM_WORLD, rank(MPI_COMM_WORLD), 0, &new_comm);
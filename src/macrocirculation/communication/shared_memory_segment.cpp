@@ -0,0 +1,53 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "shared_memory_segment.hpp"
+
+#include <algorithm>
+
+#include "mpi.hpp"
+
+namespace macrocirculation {
+
+SharedMemorySegment::SharedMemorySegment(MPI_Comm comm, std::size_t bytes)
+    : d_node_comm(MPI_COMM_NULL),
+      d_window(MPI_WIN_NULL),
+      d_data(nullptr),
+      d_size(bytes),
+      d_node_rank(0),
+      d_num_node_ranks(1) {
+  CHECK_MPI_SUCCESS(MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, mpi::rank(comm), MPI_INFO_NULL, &d_node_comm));
+  d_node_rank = mpi::rank(d_node_comm);
+  d_num_node_ranks = mpi::size(d_node_comm);
+
+  // the other ranks map the memory of the first rank, where a segment needs at least one byte to have an address
+  const auto window_size = static_cast<MPI_Aint>(d_node_rank == 0 ? std::max<std::size_t>(bytes, 1) : 0);
+  void *own_data = nullptr;
+  CHECK_MPI_SUCCESS(MPI_Win_allocate_shared(window_size, 1, MPI_INFO_NULL, d_node_comm, &own_data, &d_window));
+
+  MPI_Aint size;
+  int displacement_unit;
+  CHECK_MPI_SUCCESS(MPI_Win_shared_query(d_window, 0, &size, &displacement_unit, &d_data));
+}
+
+SharedMemorySegment::~SharedMemorySegment() {
+  MPI_Win_free(&d_window);
+  MPI_Comm_free(&d_node_comm);
+}
+
+void SharedMemorySegment::fence() const {
+  CHECK_MPI_SUCCESS(MPI_Win_fence(0, d_window));
+  CHECK_MPI_SUCCESS(MPI_Barrier(d_node_comm));
+}
+
+bool SharedMemorySegment::contains(const void *address) const {
+  const auto *begin = static_cast<const char *>(d_data);
+  const auto *p = static_cast<const char *>(address);
+  return begin <= p && p < begin + d_size;
+}
+
+} // namespace macrocirculation
@@ -0,0 +1,65 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_SHARED_MEMORY_SEGMENT_HPP
+#define TUMORMODELS_SHARED_MEMORY_SEGMENT_HPP
+
+#include <cstddef>
+#include <mpi.h>
+
+namespace macrocirculation {
+
+/*! @brief A block of memory, which exists once per node and is mapped into all the ranks of a communicator on this node.
+ *
+ *  The segment is allocated by MPI_Win_allocate_shared on the ranks of the node, where only the first rank of the node provides the memory.
+ *  It is meant for large read-only data: the first rank of the node writes the data, and after a call of fence all the ranks of the node can read it.
+ *  Since freeing the window is collective on the node, all the ranks have to destroy their segments in the same order.
+ */
+class SharedMemorySegment {
+public:
+  /*! @brief Allocates a segment of the given number of bytes for every node of comm. The call is collective. */
+  SharedMemorySegment(MPI_Comm comm, std::size_t bytes);
+
+  SharedMemorySegment(const SharedMemorySegment &) = delete;
+  SharedMemorySegment &operator=(const SharedMemorySegment &) = delete;
+
+  ~SharedMemorySegment();
+
+  /*! @brief The start of the segment, which is the same memory on all the ranks of the node. */
+  void *data() const { return d_data; }
+
+  std::size_t size() const { return d_size; }
+
+  /*! @brief Is our rank the first rank of its node, which writes the data? */
+  bool is_writer() const { return d_node_rank == 0; }
+
+  /*! @brief The number of ranks of comm on our node, which share the segment. */
+  int num_node_ranks() const { return d_num_node_ranks; }
+
+  /*! @brief Makes the data written by the first rank of the node visible to the other ranks of the node. The call is collective on the node. */
+  void fence() const;
+
+  /*! @brief Is the given address part of the segment? */
+  bool contains(const void *address) const;
+
+private:
+  MPI_Comm d_node_comm;
+
+  MPI_Win d_window;
+
+  void *d_data;
+
+  std::size_t d_size;
+
+  int d_node_rank;
+
+  int d_num_node_ranks;
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_SHARED_MEMORY_SEGMENT_HPP
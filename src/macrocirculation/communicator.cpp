@@ -9,91 +9,233 @@
 
 #include "communication/mpi.hpp"
 #include "graph_storage.hpp"
+#include "local_edge_index.hpp"
+#include "phase_timers.hpp"
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
 #include <utility>
 
 namespace macrocirculation {
 
+struct Communicator::PersistentExchange {
+  /*! @brief A rank we exchange data with, together with the dofs to pack or unpack in the order of the message. */
+  struct Neighbor {
+    int rank;
+    std::vector<std::size_t> dof_indices;
+    std::vector<double> buffer;
+  };
+
+  std::vector<Neighbor> send_neighbors;
+  std::vector<Neighbor> receive_neighbors;
+
+  /*! @brief The persistent requests, first for all the receive neighbors and then for all the send neighbors. */
+  std::vector<MPI_Request> requests;
+
+  /*! @brief Marks the receive neighbors, whose data was already written into the ghost layer in the current update. */
+  std::vector<bool> received;
+
+  /*! @brief The indices of the requests, which MPI_Testsome has completed. */
+  std::vector<int> completed;
+
+  ~PersistentExchange() {
+    // the communicator might outlive MPI in the applications, then all the requests are already gone
+    int finalized = 0;
+    MPI_Finalized(&finalized);
+    if (finalized)
+      return;
+    for (auto &request : requests)
+      MPI_Request_free(&request);
+  }
+};
+
+namespace {
+
+/*! @brief Collects the dof indices of the given edges in the order in which they appear inside a message. */
+std::vector<std::size_t> collect_dof_indices(const GraphStorage &graph, const std::vector<std::size_t> &edge_ids, const DoFFunctional &dofs) {
+  std::vector<std::size_t> dof_indices;
+  for (const auto &edge_id : edge_ids) {
+    const auto edge_dofs = dofs(graph.edge(edge_id));
+    dof_indices.insert(dof_indices.end(), edge_dofs.begin(), edge_dofs.end());
+  }
+  return dof_indices;
+}
+
+} // namespace
+
 Communicator::Communicator(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, DoFFunctional dof_to_send, DoFFunctional dof_to_receive)
     : d_comm(comm),
       d_graph(std::move(graph)),
       d_dof_to_send(std::move(dof_to_send)),
       d_dof_to_receive(std::move(dof_to_receive)),
-      d_buffer_system(comm, 0),
       d_rank(mpi::rank(comm)),
-      d_ghost_dofs_to_send(mpi::size(comm), std::vector<std::size_t>()) {
-  for (int other_rank = 0; other_rank < mpi::size(comm); other_rank += 1) {
-    // we dont send to ourselves.
-    if (other_rank == d_rank)
-      continue;
+      d_exchange(std::make_unique<PersistentExchange>()),
+      d_update_in_progress(false),
+      d_num_updates(0),
+      d_statistics(static_cast<std::size_t>(mpi::size(comm))) {
+  SCOPED_SETUP_TIMER("communicator");
+
+  // Every rank knows the whole graph, hence the sender and the receiver calculate the same (ordered) list of ghost edges.
+  // Thus the messages contain only the dof values, and their sizes are known in advance on both sides.
+  // Only the neighbor ranks can share a ghost layer with us, hence we do not iterate over all the ranks.
+  for (int other_rank : d_graph->get_neighbor_ranks(d_rank)) {
+    auto send_dofs = collect_dof_indices(*d_graph, d_graph->get_ghost_edge_ids(other_rank, d_rank), d_dof_to_send);
+    if (!send_dofs.empty())
+      d_exchange->send_neighbors.push_back({other_rank, send_dofs, std::vector<double>(send_dofs.size(), 0)});
+
+    auto receive_dofs = collect_dof_indices(*d_graph, d_graph->get_ghost_edge_ids(d_rank, other_rank), d_dof_to_receive);
+    if (!receive_dofs.empty())
+      d_exchange->receive_neighbors.push_back({other_rank, receive_dofs, std::vector<double>(receive_dofs.size(), 0)});
+  }
 
-    d_ghost_dofs_to_send[other_rank] = d_graph->get_ghost_edge_ids(other_rank, d_rank);
+  // Several communicators on the same MPI communicator share the tag.
+  // This is fine, since MPI matches messages between two ranks in the order in which they were posted,
+  // and all the ranks start their exchanges in the same order.
+  const int tag = 0;
+  auto &requests = d_exchange->requests;
+  requests.resize(d_exchange->receive_neighbors.size() + d_exchange->send_neighbors.size(), MPI_REQUEST_NULL);
+  std::size_t k = 0;
+  for (auto &neighbor : d_exchange->receive_neighbors) {
+    CHECK_MPI_SUCCESS(MPI_Recv_init(neighbor.buffer.data(), static_cast<int>(neighbor.buffer.size()), MPI_DOUBLE, neighbor.rank, tag, d_comm, &requests[k]));
+    k += 1;
   }
+  for (auto &neighbor : d_exchange->send_neighbors) {
+    CHECK_MPI_SUCCESS(MPI_Send_init(neighbor.buffer.data(), static_cast<int>(neighbor.buffer.size()), MPI_DOUBLE, neighbor.rank, tag, d_comm, &requests[k]));
+    k += 1;
+  }
+
+  d_exchange->received.assign(d_exchange->receive_neighbors.size(), false);
+  d_exchange->completed.resize(d_exchange->receive_neighbors.size());
 }
 
+Communicator::Communicator(Communicator &&) noexcept = default;
+
+Communicator &Communicator::operator=(Communicator &&) noexcept = default;
+
+Communicator::~Communicator() = default;
+
 void Communicator::update_ghost_layer(std::vector<double> &u) {
-  d_buffer_system.clear();
+  start_ghost_layer_update(u);
+  finish_ghost_layer_update(u);
+}
 
-  // send the ghost layer to our neighbors
-  for (int other_rank = 0; other_rank < static_cast< int >( d_ghost_dofs_to_send.size() ); other_rank += 1) {
-    // we dont send to ourselves.
-    if (other_rank == d_rank)
-      continue;
+void Communicator::start_ghost_layer_update(const std::vector<double> &u) {
+  SCOPED_PHASE_TIMER("ghost exchange");
+  if (d_update_in_progress)
+    throw std::runtime_error("the previous ghost layer update was not finished");
 
-    pack_dof_into_send_buffer(other_rank, d_ghost_dofs_to_send[other_rank], u);
+  // pack the ghost layer of our neighbors
+  for (auto &neighbor : d_exchange->send_neighbors) {
+    for (std::size_t k = 0; k < neighbor.dof_indices.size(); k += 1)
+      neighbor.buffer[k] = u[neighbor.dof_indices[k]];
   }
-  d_buffer_system.start_communication();
-  d_buffer_system.end_communication();
 
-  // receive the ghost layer from our neighbors
-  unpack_dof_from_receive_buffer(u);
+  if (!d_exchange->requests.empty())
+    CHECK_MPI_SUCCESS(MPI_Startall(static_cast<int>(d_exchange->requests.size()), d_exchange->requests.data()));
+
+  for (const auto &neighbor : d_exchange->send_neighbors)
+    d_statistics.add_message(static_cast<std::size_t>(neighbor.rank), neighbor.buffer.size() * sizeof(double));
+
+  std::fill(d_exchange->received.begin(), d_exchange->received.end(), false);
 
-  // clear the buffer system to check if any information was lost
-  d_buffer_system.clear();
+  d_update_in_progress = true;
+  d_num_updates += 1;
 }
 
-void Communicator::unpack_dof_from_receive_buffer(std::vector<double> &u) {
-  // receive the ghost layer from our neighbors
-  for (int other_rank = 0; other_rank < static_cast< int >( d_ghost_dofs_to_send.size() ); other_rank += 1) {
-    // we dont receive from ourselves.
-    if (other_rank == d_rank)
-      continue;
-
-    auto &receive_buffer = d_buffer_system.get_receive_buffer(other_rank);
-
-    while (!receive_buffer.empty()) {
-      std::size_t edge_id;
-      receive_buffer >> edge_id;
-      assert(edge_id < d_graph->num_edges());
-      const auto edge = d_graph->get_edge(edge_id);
-      assert(edge->rank() == other_rank);
-      const auto dof_indices = d_dof_to_receive(*edge);
-      for (std::size_t idx : dof_indices)
-        receive_buffer >> u[idx];
+void Communicator::finish_ghost_layer_update(std::vector<double> &u) {
+  SCOPED_PHASE_TIMER("ghost exchange");
+  if (!d_update_in_progress)
+    throw std::runtime_error("no ghost layer update was started");
+
+  // the waits are a phase of their own, such that the stalls show up in a trace
+  {
+    SCOPED_PHASE_TIMER("mpi wait");
+    // the time until a request completes is attributed to its neighbor, hence the slowest neighbor gets the largest share
+    const auto num_receive_requests = d_exchange->receive_neighbors.size();
+    auto wait_start = CommunicationStatistics::Clock::now();
+    for (std::size_t k = 0; k < d_exchange->requests.size(); k += 1) {
+      int index = MPI_UNDEFINED;
+      CHECK_MPI_SUCCESS(MPI_Waitany(static_cast<int>(d_exchange->requests.size()), d_exchange->requests.data(), &index, MPI_STATUS_IGNORE));
+      if (index == MPI_UNDEFINED)
+        break;
+      const auto i = static_cast<std::size_t>(index);
+      const int neighbor_rank = i < num_receive_requests ? d_exchange->receive_neighbors[i].rank : d_exchange->send_neighbors[i - num_receive_requests].rank;
+      const auto now = CommunicationStatistics::Clock::now();
+      d_statistics.add_wait(static_cast<std::size_t>(neighbor_rank), std::chrono::duration<double>(now - wait_start).count());
+      wait_start = now;
     }
   }
+
+  // receive the ghost layer from our neighbors, which were not received by progress_ghost_layer_update
+  for (std::size_t i = 0; i < d_exchange->receive_neighbors.size(); i += 1) {
+    if (!d_exchange->received[i])
+      unpack(i, u);
+  }
+
+  d_update_in_progress = false;
 }
 
-void Communicator::pack_dof_into_send_buffer(int receiver_rank, const std::vector<std::size_t> &edge_ids, const std::vector<double> &u) {
-  assert(receiver_rank != d_rank);
+void Communicator::progress_ghost_layer_update(std::vector<double> &u, std::vector<std::size_t> &arrived) {
+  if (!d_update_in_progress)
+    throw std::runtime_error("no ghost layer update was started");
 
-  auto &send_buffer = d_buffer_system.get_send_buffer(receiver_rank);
+  const auto num_receive_requests = static_cast<int>(d_exchange->receive_neighbors.size());
+  if (num_receive_requests == 0)
+    return;
 
-  for (const auto &edge_id : edge_ids) {
-    const auto edge = d_graph->get_edge(edge_id);
-    const auto dof_indices = d_dof_to_send(*edge);
+  // completed persistent requests become inactive, hence every message is reported only once and finish_ghost_layer_update skips it
+  int num_completed = 0;
+  CHECK_MPI_SUCCESS(MPI_Testsome(num_receive_requests, d_exchange->requests.data(), &num_completed, d_exchange->completed.data(), MPI_STATUSES_IGNORE));
+  if (num_completed == MPI_UNDEFINED)
+    return;
+
+  for (int k = 0; k < num_completed; k += 1) {
+    const auto i = static_cast<std::size_t>(d_exchange->completed[static_cast<std::size_t>(k)]);
+    unpack(i, u);
+    arrived.push_back(i);
+  }
+}
 
-    send_buffer << edge_id;
-    for (std::size_t idx : dof_indices)
-      send_buffer << u[idx];
+void Communicator::unpack(std::size_t i, std::vector<double> &u) {
+  const auto &neighbor = d_exchange->receive_neighbors[i];
+  for (std::size_t k = 0; k < neighbor.dof_indices.size(); k += 1) {
+    assert(neighbor.dof_indices[k] < u.size());
+    u[neighbor.dof_indices[k]] = neighbor.buffer[k];
   }
+  d_exchange->received[i] = true;
+}
+
+int Communicator::get_receive_neighbor_rank(std::size_t k) const { return d_exchange->receive_neighbors.at(k).rank; }
+
+std::size_t Communicator::num_receive_neighbors() const { return d_exchange->receive_neighbors.size(); }
+
+std::size_t Communicator::num_send_neighbors() const { return d_exchange->send_neighbors.size(); }
+
+std::size_t Communicator::num_send_values() const {
+  std::size_t num_values = 0;
+  for (const auto &neighbor : d_exchange->send_neighbors)
+    num_values += neighbor.buffer.size();
+  return num_values;
+}
+
+Communicator Communicator::create_edge_boundary_value_communicator(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, std::size_t num_values_per_boundary) {
+  // the left boundary values of the given macro-edge are followed by the right boundary values
+  DoFFunctional boundary_edge_dofs = [num_values_per_boundary](const Edge &edge) -> std::vector<std::size_t> {
+    std::vector<std::size_t> dofs(2 * num_values_per_boundary);
+    for (std::size_t k = 0; k < dofs.size(); k += 1)
+      dofs[k] = 2 * num_values_per_boundary * edge.get_id() + k;
+    return dofs;
+  };
+
+  return Communicator{comm, std::move(graph), boundary_edge_dofs, boundary_edge_dofs};
 }
 
-Communicator Communicator::create_edge_boundary_value_communicator(MPI_Comm comm, std::shared_ptr<GraphStorage> graph) {
-  DoFFunctional boundary_edge_dofs = [](const Edge &edge) -> std::vector<std::size_t> {
-    return {
-      2 * edge.get_id(),    // index to the left boundary value of the given macro-edge
-      2 * edge.get_id() + 1 // index to the right boundary value of the given boundary edge
-    };
+Communicator Communicator::create_edge_boundary_value_communicator(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, std::shared_ptr<const LocalEdgeIndex> local_edges, std::size_t num_values_per_boundary) {
+  DoFFunctional boundary_edge_dofs = [num_values_per_boundary, local_edges](const Edge &edge) -> std::vector<std::size_t> {
+    std::vector<std::size_t> dofs(2 * num_values_per_boundary);
+    for (std::size_t k = 0; k < dofs.size(); k += 1)
+      dofs[k] = 2 * num_values_per_boundary * (*local_edges)(edge.get_id()) + k;
+    return dofs;
   };
 
   return Communicator{comm, std::move(graph), boundary_edge_dofs, boundary_edge_dofs};
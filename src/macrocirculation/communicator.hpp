@@ -13,40 +13,100 @@
 #include <mpi.h>
 #include <vector>
 
-#include "communication/buffer.hpp"
+#include "communication/communication_statistics.hpp"
 
 namespace macrocirculation {
 
 // forward declarations
 class GraphStorage;
 class Edge;
+class LocalEdgeIndex;
 
 /*! @brief Functional returns the dof indices to send and receive on a given macro edge. */
 using DoFFunctional = std::function<std::vector<std::size_t>(const Edge &)>;
 
+/*! @brief Exchanges the ghost layer of a vector with the neighboring ranks.
+ *
+ * Since the partition of the graph is fixed, the neighbors and the exact message sizes are determined once
+ * in the constructor, and the exchange uses persistent requests to the neighboring ranks only.
+ * The constructor is collective on the given communicator.
+ */
 class Communicator {
 public:
   Communicator(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, DoFFunctional dof_to_send, DoFFunctional dof_to_receive);
 
+  Communicator(Communicator &&) noexcept;
+
+  Communicator &operator=(Communicator &&) noexcept;
+
+  ~Communicator();
+
   /*! @brief Updates the ghost layer on all ranks for the given vector. */
   void update_ghost_layer(std::vector<double> &u);
 
-  static Communicator create_edge_boundary_value_communicator(MPI_Comm comm, std::shared_ptr<GraphStorage> graph);
+  /*! @brief Sends the values of our edges in the ghost layer of the other ranks, without waiting for the data of our own ghost layer.
+   *         Only ghost dofs of u may be modified until the matching call of finish_ghost_layer_update.
+   */
+  void start_ghost_layer_update(const std::vector<double> &u);
 
-private:
-  /*! @brief Unpacks the dof already in the receive buffer into the given vector. */
-  void unpack_dof_from_receive_buffer(std::vector<double> &u);
+  /*! @brief Waits for the data started by start_ghost_layer_update and writes it into the ghost layer of the given vector. */
+  void finish_ghost_layer_update(std::vector<double> &u);
+
+  /*! @brief Writes the data of the neighbors, which has arrived since the last call, into the ghost layer of the given vector without waiting.
+   *         The indices of these neighbors are appended to arrived, see get_receive_neighbor_rank.
+   *         The update still has to be finished by finish_ghost_layer_update, which then only waits for the remaining messages.
+   */
+  void progress_ghost_layer_update(std::vector<double> &u, std::vector<std::size_t> &arrived);
+
+  /*! @brief Returns the number of ranks from which we receive ghost values. */
+  std::size_t num_receive_neighbors() const;
+
+  /*! @brief Returns the rank of the k-th neighbor, from which we receive ghost values. */
+  int get_receive_neighbor_rank(std::size_t k) const;
+
+  /*! @brief Returns the number of ranks to which we send ghost values. */
+  std::size_t num_send_neighbors() const;
+
+  /*! @brief Returns the number of values, which we send to all our neighbors in a single ghost layer update. */
+  std::size_t num_send_values() const;
+
+  /*! @brief Returns the number of ghost layer updates, which were started since the construction. */
+  std::size_t num_updates() const { return d_num_updates; }
 
-  /*! @brief Packs the dof on the edges with the given ids into the send buffer of the receiving rank. */
-  void pack_dof_into_send_buffer(int receiver_rank, const std::vector<std::size_t> &edge_ids, const std::vector<double> &u);
+  /*! @brief Returns the messages and waiting times of the ghost layer updates since the construction or the last reset. */
+  const CommunicationStatistics &get_statistics() const { return d_statistics; }
+
+  void reset_statistics() { d_statistics.reset(); }
+
+  /*! @brief Creates a communicator for vectors with num_values_per_boundary values at the left and then at the right boundary of every macro edge. */
+  static Communicator create_edge_boundary_value_communicator(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, std::size_t num_values_per_boundary = 1);
+
+  /*! @brief Same as above, but the values of an edge are stored at the slot of the edge in the given index instead of its id. */
+  static Communicator create_edge_boundary_value_communicator(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, std::shared_ptr<const LocalEdgeIndex> local_edges, std::size_t num_values_per_boundary = 1);
+
+private:
+  /*! @brief The neighbors, buffers and persistent requests of the exchange.
+   *         They are kept on the heap, such that the buffers registered at MPI stay in place when the communicator is moved.
+   */
+  struct PersistentExchange;
 
   MPI_Comm d_comm;
   std::shared_ptr<GraphStorage> d_graph;
   DoFFunctional d_dof_to_send;
   DoFFunctional d_dof_to_receive;
-  BufferSystem d_buffer_system;
   int d_rank;
-  std::vector<std::vector<std::size_t>> d_ghost_dofs_to_send;
+  std::unique_ptr<PersistentExchange> d_exchange;
+
+  /*! @brief True between the start and the finish of a ghost layer update. */
+  bool d_update_in_progress;
+
+  /*! @brief The number of started ghost layer updates, from which the communication volume is derived. */
+  std::size_t d_num_updates;
+
+  CommunicationStatistics d_statistics;
+
+  /*! @brief Writes the data of the i-th receive neighbor into the ghost layer of the given vector. */
+  void unpack(std::size_t i, std::vector<double> &u);
 };
 
 } // namespace macrocirculation
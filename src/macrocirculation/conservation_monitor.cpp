@@ -0,0 +1,167 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "conservation_monitor.hpp"
+
+#include <array>
+#include <cmath>
+#include <utility>
+
+#include "communication/mpi.hpp"
+#include "dof_map.hpp"
+#include "fe_type.hpp"
+#include "graph_storage.hpp"
+
+namespace macrocirculation {
+
+namespace {
+
+constexpr std::size_t Q_component = 0;
+constexpr std::size_t A_component = 1;
+
+/*! @brief Evaluates the legendre expansion with the given dofs at the left (s = -1) or right (s = +1) boundary. */
+double evaluate_at_boundary(const double *dofs, std::size_t num_basis_functions, bool right) {
+  double value = 0;
+  for (std::size_t i = 0; i < num_basis_functions; i += 1)
+    value += (right || i % 2 == 0 ? +1 : -1) * dofs[i];
+  return value;
+}
+
+} // namespace
+
+ConservationMonitor::ConservationMonitor(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, std::shared_ptr<DofMap> dof_map)
+    : d_comm(comm),
+      d_graph(std::move(graph)),
+      d_dof_map(std::move(dof_map)),
+      d_active(false),
+      d_initial_volume_1d(0),
+      d_last_inflow(0),
+      d_accumulated_inflow(0) {}
+
+void ConservationMonitor::reset(const std::vector<double> &u) {
+  double volume = 0, kinetic_energy = 0, elastic_energy = 0;
+  for (const auto &e_id : d_graph->get_active_edge_ids(mpi::rank(d_comm)))
+    integrate_edge(u, d_graph->edge(e_id), volume, kinetic_energy, elastic_energy);
+  CHECK_MPI_SUCCESS(MPI_Allreduce(&volume, &d_initial_volume_1d, 1, MPI_DOUBLE, MPI_SUM, d_comm));
+
+  d_last_inflow = calculate_local_inflow(u);
+  d_accumulated_inflow = 0;
+  d_active = true;
+}
+
+void ConservationMonitor::step(double tau, const std::vector<double> &u) {
+  if (!d_active)
+    return;
+
+  const double inflow = calculate_local_inflow(u);
+  d_accumulated_inflow += 0.5 * tau * (d_last_inflow + inflow);
+  d_last_inflow = inflow;
+}
+
+ConservationDiagnostics ConservationMonitor::calculate(const std::vector<double> &u) const {
+  std::array<double, 5> sums{0, 0, 0, 0, d_accumulated_inflow};
+  for (const auto &e_id : d_graph->get_active_edge_ids(mpi::rank(d_comm)))
+    integrate_edge(u, d_graph->edge(e_id), sums[0], sums[2], sums[3]);
+  sums[1] = calculate_local_volume_0d(u);
+  CHECK_MPI_SUCCESS(MPI_Allreduce(MPI_IN_PLACE, sums.data(), static_cast<int>(sums.size()), MPI_DOUBLE, MPI_SUM, d_comm));
+
+  ConservationDiagnostics diagnostics{};
+  diagnostics.volume_1d = sums[0];
+  diagnostics.volume_0d = sums[1];
+  diagnostics.kinetic_energy = sums[2];
+  diagnostics.elastic_energy = sums[3];
+  diagnostics.boundary_inflow = sums[4];
+  diagnostics.volume_error = d_active ? sums[0] - d_initial_volume_1d - sums[4] : NAN;
+  return diagnostics;
+}
+
+double ConservationMonitor::calculate_local_inflow(const std::vector<double> &u) const {
+  double inflow = 0;
+  for (const auto &e_id : d_graph->get_active_edge_ids(mpi::rank(d_comm))) {
+    const auto &edge = d_graph->edge(e_id);
+    const auto &local_dof_map = d_dof_map->get_local_dof_map(edge);
+    const std::size_t num_basis_functions = local_dof_map.num_basis_functions();
+    for (auto v_id : edge.get_vertex_neighbors()) {
+      if (!d_graph->vertex(v_id).is_leaf())
+        continue;
+      // the flow leaves the edge at its right and enters it at its left boundary
+      if (edge.is_pointing_to(v_id))
+        inflow -= evaluate_at_boundary(local_dof_map.dof_values(u, local_dof_map.num_micro_edges() - 1, Q_component), num_basis_functions, true);
+      else
+        inflow += evaluate_at_boundary(local_dof_map.dof_values(u, 0, Q_component), num_basis_functions, false);
+    }
+  }
+  return inflow;
+}
+
+void ConservationMonitor::integrate_edge(const std::vector<double> &u, const Edge &edge, double &volume, double &kinetic_energy, double &elastic_energy) const {
+  const auto &local_dof_map = d_dof_map->get_local_dof_map(edge);
+  const auto &param = edge.get_physical_data();
+  const auto &lengths = edge.get_micro_edge_lengths();
+  const std::size_t num_basis_functions = local_dof_map.num_basis_functions();
+
+  // the energies are not polynomial, hence we integrate them with some additional points
+  const auto qf = create_gauss_for_degree(num_basis_functions + 1);
+  const double sqrt_A0 = std::sqrt(param.A0);
+
+  for (std::size_t micro_edge_id = 0; micro_edge_id < local_dof_map.num_micro_edges(); micro_edge_id += 1) {
+    const double *Q = local_dof_map.dof_values(u, micro_edge_id, Q_component);
+    const double *A = local_dof_map.dof_values(u, micro_edge_id, A_component);
+    const double jacobian = 0.5 * lengths[micro_edge_id];
+
+    // only the constant legendre polynomial has a nonzero integral
+    volume += 2 * jacobian * A[0];
+
+    for (std::size_t qp = 0; qp < qf.size(); qp += 1) {
+      const auto phi = evaluate_legendre(qf.ref_points[qp]);
+      double Q_qp = 0, A_qp = 0;
+      for (std::size_t i = 0; i < num_basis_functions; i += 1) {
+        Q_qp += phi[i] * Q[i];
+        A_qp += phi[i] * A[i];
+      }
+      const double weight = jacobian * qf.ref_weights[qp];
+      kinetic_energy += weight * 0.5 * param.rho * Q_qp * Q_qp / A_qp;
+      // the antiderivative of p(a) = G0 (sqrt(a/A0) - 1), which vanishes at A0, in a factorized form without cancellation
+      const double x = std::sqrt(A_qp) / sqrt_A0;
+      elastic_energy += weight * param.G0 * param.A0 / 3. * (x - 1) * (x - 1) * (2 * x + 1);
+    }
+  }
+}
+
+double ConservationMonitor::calculate_local_volume_0d(const std::vector<double> &u) const {
+  double volume = 0;
+  for (const auto &e_id : d_graph->get_active_edge_ids(mpi::rank(d_comm))) {
+    const auto &edge = d_graph->edge(e_id);
+    for (auto v_id : edge.get_vertex_neighbors()) {
+      const auto &vertex = d_graph->vertex(v_id);
+      if (!vertex.is_leaf())
+        continue;
+
+      if (vertex.is_windkessel_outflow()) {
+        volume += vertex.get_peripheral_vessel_data().compliance * u[d_dof_map->get_local_dof_map(vertex).first_dof()];
+      } else if (vertex.is_vessel_tree_outflow()) {
+        // the k-th compartment represents furcation_number^k equal vessels
+        const auto &data = vertex.get_vessel_tree_data();
+        const auto &local_dof_map = d_dof_map->get_local_dof_map(vertex);
+        double num_vessels = 1;
+        for (std::size_t k = 0; k < data.capacitances.size(); k += 1) {
+          volume += num_vessels * data.capacitances[k] * u[local_dof_map.dof_index(k)];
+          num_vessels *= static_cast<double>(data.furcation_number);
+        }
+      } else if (vertex.is_rcl_outflow()) {
+        // the pressures come before the flows
+        const auto &data = vertex.get_rcl_data();
+        const auto &local_dof_map = d_dof_map->get_local_dof_map(vertex);
+        for (std::size_t k = 0; k < data.capacitances.size(); k += 1)
+          volume += data.capacitances[k] * u[local_dof_map.dof_index(k)];
+      }
+    }
+  }
+  return volume;
+}
+
+} // namespace macrocirculation
@@ -0,0 +1,100 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_CONSERVATION_MONITOR_HPP
+#define TUMORMODELS_CONSERVATION_MONITOR_HPP
+
+#include <memory>
+#include <mpi.h>
+#include <vector>
+
+namespace macrocirculation {
+
+// forward declarations
+class GraphStorage;
+class DofMap;
+class Edge;
+
+/*! @brief The global volume and energy balance of the (Q, A) flow solution. */
+struct ConservationDiagnostics {
+  /*! @brief The total volume \f$\int A\,dz\f$ of all the vessels [cm^3]. */
+  double volume_1d;
+
+  /*! @brief The volume \f$\sum C p\f$, which the compliances of all the 0D outflow models store [cm^3]. */
+  double volume_0d;
+
+  /*! @brief The time integral of the net flow into the vessels at all the leaves since the last reset [cm^3]. */
+  double boundary_inflow;
+
+  /*! @brief The violation of the volume balance of the vessels since the last reset, i.e. the change of volume_1d minus boundary_inflow [cm^3].
+   *         It is of the size of the time discretization error of the boundary flows, and grows fast if the solver loses mass.
+   */
+  double volume_error;
+
+  /*! @brief The kinetic energy \f$\int \rho Q^2 / (2 A)\,dz\f$ of all the vessels. */
+  double kinetic_energy;
+
+  /*! @brief The elastic energy \f$\int \int_{A_0}^{A} p(a)\,da\,dz\f$, which the vessel walls store. */
+  double elastic_energy;
+};
+
+/*! @brief Monitors the conservation of volume in the vessels and their energy, without writing the fields.
+ *
+ *  Every step only accumulates the flows at the leaves of this rank with the trapezoidal rule,
+ *  which touches a single micro edge per leaf and does not communicate.
+ *  The volumes and energies are only integrated and reduced when calculate is called, e.g. once per output interval.
+ *  The monitor is inactive until it is reset with a solution.
+ */
+class ConservationMonitor {
+public:
+  ConservationMonitor(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, std::shared_ptr<DofMap> dof_map);
+
+  /*! @brief Starts the balance from the given solution. The call is collective. */
+  void reset(const std::vector<double> &u);
+
+  /*! @returns True, if the monitor was reset and accumulates the boundary flows. */
+  bool is_active() const { return d_active; }
+
+  /*! @brief Accumulates the boundary flows of a time step of size tau, which ended with the solution u. */
+  void step(double tau, const std::vector<double> &u);
+
+  /*! @brief Integrates the volumes and energies of the given solution and balances them against the accumulated boundary flows.
+   *         The call is collective and needs a single reduction.
+   */
+  ConservationDiagnostics calculate(const std::vector<double> &u) const;
+
+private:
+  MPI_Comm d_comm;
+
+  std::shared_ptr<GraphStorage> d_graph;
+
+  std::shared_ptr<DofMap> d_dof_map;
+
+  bool d_active;
+
+  /*! @brief The total volume of the vessels at the last reset. */
+  double d_initial_volume_1d;
+
+  /*! @brief The flow into the vessels at the leaves of this rank at the end of the last step. */
+  double d_last_inflow;
+
+  /*! @brief The time integral of the flow into the vessels at the leaves of this rank since the last reset. */
+  double d_accumulated_inflow;
+
+  /*! @brief The net flow into the vessels at the leaves of this rank. */
+  double calculate_local_inflow(const std::vector<double> &u) const;
+
+  /*! @brief Adds the volume and energies of the given edge to the local sums. */
+  void integrate_edge(const std::vector<double> &u, const Edge &edge, double &volume, double &kinetic_energy, double &elastic_energy) const;
+
+  /*! @brief The volume, which the 0D models on this rank store. */
+  double calculate_local_volume_0d(const std::vector<double> &u) const;
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_CONSERVATION_MONITOR_HPP
@@ -0,0 +1,115 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "coupled_explicit_implicit_1d_solver.hpp"
+
+#include <stdexcept>
+
+#include "communication/mpi.hpp"
+#include "dof_map.hpp"
+#include "explicit_nonlinear_flow_solver.hpp"
+#include "graph_storage.hpp"
+#include "implicit_linear_flow_solver.hpp"
+#include "vessel_formulas.hpp"
+
+namespace macrocirculation {
+
+namespace {
+
+/*! @brief Returns the id of the vertex in graph_li, which is connected to the given vertex, or -1 if there is none. */
+std::size_t find_connected_vertex(const Vertex &vertex, const GraphStorage &graph_li) {
+  for (const auto &connection : vertex.get_inter_graph_connections())
+    if (&connection.get_graph() == &graph_li)
+      return connection.get_vertex().get_id();
+  return static_cast<std::size_t>(-1);
+}
+
+} // namespace
+
+CoupledExplicitImplicit1DSolver::CoupledExplicitImplicit1DSolver(MPI_Comm comm,
+                                                                 std::shared_ptr<GraphStorage> graph_nl,
+                                                                 std::shared_ptr<GraphStorage> graph_li,
+                                                                 size_t degree_nl,
+                                                                 size_t degree_li)
+    : d_comm(comm),
+      d_graph_nl(std::move(graph_nl)),
+      d_graph_li(std::move(graph_li)) {
+  auto dof_map_nl = std::make_shared<DofMap>(d_graph_nl->num_vertices(), d_graph_nl->num_edges());
+  dof_map_nl->create(d_comm, *d_graph_nl, 2, degree_nl, false);
+  d_explicit_solver = std::make_unique<ExplicitNonlinearFlowSolver>(d_comm, d_graph_nl, dof_map_nl, degree_nl);
+
+  auto dof_map_li = ImplicitLinearFlowSolver::create_dof_map(d_comm, *d_graph_li, degree_li);
+  d_implicit_solver = std::make_unique<ImplicitLinearFlowSolver>(d_comm, d_graph_li, dof_map_li, degree_li);
+
+  for (auto v_id : d_graph_nl->get_vertex_ids()) {
+    const auto v_id_li = find_connected_vertex(d_graph_nl->vertex(v_id), *d_graph_li);
+    if (v_id_li != static_cast<std::size_t>(-1))
+      d_couplings.push_back({v_id, v_id_li});
+  }
+}
+
+CoupledExplicitImplicit1DSolver::~CoupledExplicitImplicit1DSolver() = default;
+
+void CoupledExplicitImplicit1DSolver::setup_coupling_bcs(const std::shared_ptr<GraphStorage> &graph_nl, const std::shared_ptr<GraphStorage> &graph_li) {
+  for (auto v_id : graph_nl->get_vertex_ids()) {
+    auto &v_nl = graph_nl->vertex(v_id);
+    const auto v_id_li = find_connected_vertex(v_nl, *graph_li);
+    if (v_id_li == static_cast<std::size_t>(-1))
+      continue;
+    auto &v_li = graph_li->vertex(v_id_li);
+
+    if (!v_nl.is_leaf() || !v_li.is_leaf())
+      throw std::runtime_error("only leaves can be coupled (vertex name = " + v_nl.get_name() + ")");
+
+    const auto &edge_nl = graph_nl->edge(v_nl.get_edge_neighbors()[0]);
+    const auto &edge_li = graph_li->edge(v_li.get_edge_neighbors()[0]);
+    const auto &param_nl = edge_nl.get_physical_data();
+    const auto &param_li = edge_li.get_physical_data();
+
+    // both models start at rest
+    v_nl.set_to_linear_characteristic_inflow(linear::get_C(param_li), linear::get_L(param_li), edge_li.is_pointing_to(v_id_li), 0, 0);
+    v_li.set_to_nonlinear_characteristic_inflow(param_nl.G0, param_nl.A0, param_nl.rho, edge_nl.is_pointing_to(v_id), 0, 0);
+  }
+}
+
+void CoupledExplicitImplicit1DSolver::exchange_coupling_values() {
+  const auto rank = mpi::rank(d_comm);
+
+  // the rank of the edge evaluates the values, which are then summed over all the ranks with a single reduction
+  std::vector<double> values(4 * d_couplings.size(), 0);
+  for (std::size_t k = 0; k < d_couplings.size(); k += 1) {
+    const auto &v_nl = d_graph_nl->vertex(d_couplings[k].vertex_id_nl);
+    const auto &v_li = d_graph_li->vertex(d_couplings[k].vertex_id_li);
+    if (d_graph_nl->edge(v_nl.get_edge_neighbors()[0]).rank() == rank)
+      d_explicit_solver->get_1d_pq_values_at_vertex(v_nl, values[4 * k + 0], values[4 * k + 1]);
+    if (d_graph_li->edge(v_li.get_edge_neighbors()[0]).rank() == rank)
+      d_implicit_solver->get_1d_pq_values_at_vertex(v_li, values[4 * k + 2], values[4 * k + 3]);
+  }
+
+  CHECK_MPI_SUCCESS(MPI_Allreduce(MPI_IN_PLACE, values.data(), static_cast<int>(values.size()), MPI_DOUBLE, MPI_SUM, d_comm));
+
+  for (std::size_t k = 0; k < d_couplings.size(); k += 1) {
+    d_graph_nl->vertex(d_couplings[k].vertex_id_nl).update_linear_characteristic_inflow(values[4 * k + 2], values[4 * k + 3]);
+    d_graph_li->vertex(d_couplings[k].vertex_id_li).update_nonlinear_characteristic_inflow(values[4 * k + 0], values[4 * k + 1]);
+  }
+}
+
+void CoupledExplicitImplicit1DSolver::solve(double tau, std::size_t num_explicit_steps, double t) {
+  exchange_coupling_values();
+  d_implicit_solver->solve(static_cast<double>(num_explicit_steps) * tau, t);
+
+  // the explicit steps see the linearized model at the end of the implicit step
+  exchange_coupling_values();
+  for (std::size_t k = 0; k < num_explicit_steps; k += 1)
+    d_explicit_solver->solve(tau, t + static_cast<double>(k) * tau);
+}
+
+ExplicitNonlinearFlowSolver &CoupledExplicitImplicit1DSolver::get_explicit_solver() { return *d_explicit_solver; }
+
+ImplicitLinearFlowSolver &CoupledExplicitImplicit1DSolver::get_implicit_solver() { return *d_implicit_solver; }
+
+} // namespace macrocirculation
@@ -0,0 +1,78 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_COUPLED_EXPLICIT_IMPLICIT_1D_SOLVER_HPP
+#define TUMORMODELS_COUPLED_EXPLICIT_IMPLICIT_1D_SOLVER_HPP
+
+#include <cstddef>
+#include <memory>
+#include <mpi.h>
+#include <vector>
+
+namespace macrocirculation {
+
+// forward declarations
+class GraphStorage;
+class ExplicitNonlinearFlowSolver;
+class ImplicitLinearFlowSolver;
+
+/*! @brief Couples the explicit nonlinear model on one graph to the implicit linearized model on a second graph.
+ *
+ *  The graphs are connected at leaves with Vertex::connect, where both sides see the other model as a characteristic inflow.
+ *  The implicit model takes a single step for several explicit steps, such that the small vessels of the linearized model
+ *  do not restrict the time step of the nonlinear model. The values at the connected vertices are exchanged before and
+ *  after every implicit step.
+ */
+class CoupledExplicitImplicit1DSolver {
+public:
+  /*! @brief Constructs the solvers of both graphs, which have to be partitioned and have finalized boundary conditions.
+   *         The boundary conditions at the connected vertices are set with setup_coupling_bcs before.
+   */
+  CoupledExplicitImplicit1DSolver(MPI_Comm comm,
+                                  std::shared_ptr<GraphStorage> graph_nl,
+                                  std::shared_ptr<GraphStorage> graph_li,
+                                  size_t degree_nl,
+                                  size_t degree_li);
+
+  ~CoupledExplicitImplicit1DSolver();
+
+  /*! @brief Sets the characteristic inflows at all the vertices of graph_nl, which are connected to graph_li, and at their partners.
+   *         Has to be called before the boundary conditions of the graphs are finalized.
+   */
+  static void setup_coupling_bcs(const std::shared_ptr<GraphStorage> &graph_nl, const std::shared_ptr<GraphStorage> &graph_li);
+
+  /*! @brief Advances both models from t to t + num_explicit_steps * tau, where tau is the explicit time step. */
+  void solve(double tau, std::size_t num_explicit_steps, double t);
+
+  ExplicitNonlinearFlowSolver &get_explicit_solver();
+
+  ImplicitLinearFlowSolver &get_implicit_solver();
+
+private:
+  /*! @brief A vertex of the nonlinear graph and the vertex of the linear graph it is connected to. */
+  struct Coupling {
+    std::size_t vertex_id_nl;
+    std::size_t vertex_id_li;
+  };
+
+  MPI_Comm d_comm;
+
+  std::shared_ptr<GraphStorage> d_graph_nl;
+  std::shared_ptr<GraphStorage> d_graph_li;
+
+  std::unique_ptr<ExplicitNonlinearFlowSolver> d_explicit_solver;
+  std::unique_ptr<ImplicitLinearFlowSolver> d_implicit_solver;
+
+  std::vector<Coupling> d_couplings;
+
+  /*! @brief Sends p and q at the connected vertices to the characteristic inflows of the other graph on all the ranks. */
+  void exchange_coupling_values();
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_COUPLED_EXPLICIT_IMPLICIT_1D_SOLVER_HPP
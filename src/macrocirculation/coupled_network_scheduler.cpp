@@ -0,0 +1,202 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "coupled_network_scheduler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#include "communication/mpi.hpp"
+#include "explicit_nonlinear_flow_solver.hpp"
+#include "graph_storage.hpp"
+#include "implicit_linear_flow_solver.hpp"
+
+namespace macrocirculation {
+
+CoupledNetworkScheduler::CoupledNetworkScheduler(MPI_Comm comm)
+    : d_comm(comm),
+      d_synchronization_interval(0) {}
+
+std::size_t CoupledNetworkScheduler::add_network(std::shared_ptr<GraphStorage> graph, ExplicitNonlinearFlowSolver &solver, double tau) {
+  d_networks.push_back({std::move(graph),
+                        tau,
+                        0,
+                        [&solver](double tau, double t) { solver.solve(tau, t); },
+                        [&solver](const Vertex &v, double &p, double &q) { solver.get_1d_pq_values_at_vertex(v, p, q); }});
+  return d_networks.size() - 1;
+}
+
+std::size_t CoupledNetworkScheduler::add_network(std::shared_ptr<GraphStorage> graph, ImplicitLinearFlowSolver &solver, double tau) {
+  d_networks.push_back({std::move(graph),
+                        tau,
+                        0,
+                        [&solver](double tau, double t) { solver.solve(tau, t); },
+                        [&solver](const Vertex &v, double &p, double &q) { solver.get_1d_pq_values_at_vertex(v, p, q); }});
+  return d_networks.size() - 1;
+}
+
+void CoupledNetworkScheduler::setup(double t) {
+  if (d_networks.empty())
+    throw std::runtime_error("the scheduler has no networks.");
+
+  // the networks with the largest steps go first, such that the others can interpolate their values
+  d_order.resize(d_networks.size());
+  for (std::size_t k = 0; k < d_networks.size(); k += 1)
+    d_order[k] = k;
+  std::stable_sort(d_order.begin(), d_order.end(), [this](std::size_t a, std::size_t b) { return d_networks[a].tau > d_networks[b].tau; });
+
+  d_synchronization_interval = d_networks[d_order.front()].tau;
+  for (auto &network : d_networks) {
+    network.num_steps = static_cast<std::size_t>(std::round(d_synchronization_interval / network.tau));
+    if (std::abs(static_cast<double>(network.num_steps) * network.tau - d_synchronization_interval) > 1e-12 * d_synchronization_interval)
+      throw std::runtime_error("the time step " + std::to_string(network.tau) + " does not divide the synchronization interval " + std::to_string(d_synchronization_interval) + ".");
+  }
+
+  // every vertex receives the values of the vertices it is connected to
+  d_connections.clear();
+  for (std::size_t dst = 0; dst < d_networks.size(); dst += 1) {
+    const auto &graph = *d_networks[dst].graph;
+    for (auto v_id : graph.get_vertex_ids()) {
+      const auto &vertex = graph.vertex(v_id);
+      for (const auto &connection : vertex.get_inter_graph_connections()) {
+        const auto src_it = std::find_if(d_networks.begin(), d_networks.end(), [&connection](const Network &n) { return n.graph.get() == &connection.get_graph(); });
+        if (src_it == d_networks.end())
+          continue;
+
+        if (!vertex.is_linear_characteristic_inflow() && !vertex.is_nonlinear_characteristic_inflow())
+          throw std::runtime_error("the connected vertex " + vertex.get_name() + " is no characteristic inflow.");
+
+        const auto &src_graph = *src_it->graph;
+        const auto &src_vertex = connection.get_vertex();
+        Connection c{};
+        c.src_network = static_cast<std::size_t>(src_it - d_networks.begin());
+        c.src_vertex_id = src_vertex.get_id();
+        c.dst_network = dst;
+        c.dst_vertex_id = v_id;
+        c.src_rank = src_graph.edge(src_vertex.get_edge_neighbors()[0]).rank();
+        c.dst_rank = graph.edge(vertex.get_edge_neighbors()[0]).rank();
+        d_connections.push_back(c);
+      }
+    }
+  }
+
+  const int rank = mpi::rank(d_comm);
+  d_plans.assign(d_networks.size(), ExchangePlan());
+  for (std::size_t idx = 0; idx < d_connections.size(); idx += 1) {
+    const auto &c = d_connections[idx];
+    auto &plan = d_plans[c.src_network];
+    if (c.src_rank == rank && c.dst_rank == rank)
+      plan.local.push_back(idx);
+    else if (c.src_rank == rank)
+      plan.send[c.dst_rank].push_back(idx);
+    else if (c.dst_rank == rank)
+      plan.receive[c.src_rank].push_back(idx);
+  }
+
+  // the values at the start are both the old and the new ones
+  for (std::size_t k = 0; k < d_networks.size(); k += 1)
+    publish(k, t);
+  for (auto &c : d_connections) {
+    c.values_old = c.values_new;
+    c.t_old = c.t_new;
+  }
+}
+
+void CoupledNetworkScheduler::publish(std::size_t network, double t) {
+  const auto &plan = d_plans[network];
+  const auto &src = d_networks[network];
+
+  const auto shift = [](Connection &c, double t_new) {
+    c.values_old = c.values_new;
+    c.t_old = c.t_new;
+    c.t_new = t_new;
+  };
+
+  // connections on a single rank are written directly
+  for (auto idx : plan.local) {
+    auto &c = d_connections[idx];
+    shift(c, t);
+    src.get_pq(src.graph->vertex(c.src_vertex_id), c.values_new[0], c.values_new[1]);
+  }
+
+  std::vector<MPI_Request> requests;
+  std::vector<std::vector<double>> send_buffers;
+  send_buffers.reserve(plan.send.size());
+  for (const auto &[other_rank, indices] : plan.send) {
+    std::vector<double> buffer(2 * indices.size());
+    for (std::size_t k = 0; k < indices.size(); k += 1)
+      src.get_pq(src.graph->vertex(d_connections[indices[k]].src_vertex_id), buffer[2 * k], buffer[2 * k + 1]);
+    send_buffers.push_back(std::move(buffer));
+    requests.emplace_back();
+    CHECK_MPI_SUCCESS(MPI_Isend(send_buffers.back().data(), static_cast<int>(send_buffers.back().size()), MPI_DOUBLE, other_rank, static_cast<int>(network), d_comm, &requests.back()));
+  }
+
+  std::vector<std::vector<double>> receive_buffers;
+  receive_buffers.reserve(plan.receive.size());
+  for (const auto &[other_rank, indices] : plan.receive) {
+    receive_buffers.emplace_back(2 * indices.size());
+    requests.emplace_back();
+    CHECK_MPI_SUCCESS(MPI_Irecv(receive_buffers.back().data(), static_cast<int>(receive_buffers.back().size()), MPI_DOUBLE, other_rank, static_cast<int>(network), d_comm, &requests.back()));
+  }
+
+  CHECK_MPI_SUCCESS(MPI_Waitall(static_cast<int>(requests.size()), requests.data(), MPI_STATUSES_IGNORE));
+
+  std::size_t buffer_idx = 0;
+  for (const auto &[other_rank, indices] : plan.receive) {
+    const auto &buffer = receive_buffers[buffer_idx++];
+    for (std::size_t k = 0; k < indices.size(); k += 1) {
+      auto &c = d_connections[indices[k]];
+      shift(c, t);
+      c.values_new = {buffer[2 * k], buffer[2 * k + 1]};
+    }
+  }
+}
+
+void CoupledNetworkScheduler::update_inflows(std::size_t network, double t, double tau) {
+  const int rank = mpi::rank(d_comm);
+
+  // the values are taken at the midpoint of the step
+  const double t_eval = t + 0.5 * tau;
+
+  for (const auto &c : d_connections) {
+    if (c.dst_network != network || c.dst_rank != rank)
+      continue;
+
+    // values of a partner, which was not advanced yet, are held constant
+    double w = 1;
+    if (t_eval < c.t_new && c.t_new > c.t_old)
+      w = std::max(0., (t_eval - c.t_old) / (c.t_new - c.t_old));
+    const double p = (1 - w) * c.values_old[0] + w * c.values_new[0];
+    const double q = (1 - w) * c.values_old[1] + w * c.values_new[1];
+
+    auto &vertex = d_networks[network].graph->vertex(c.dst_vertex_id);
+    if (vertex.is_linear_characteristic_inflow())
+      vertex.update_linear_characteristic_inflow(p, q);
+    else
+      vertex.update_nonlinear_characteristic_inflow(p, q);
+  }
+}
+
+void CoupledNetworkScheduler::solve(double t) {
+  for (auto k : d_order) {
+    auto &network = d_networks[k];
+    for (std::size_t step = 0; step < network.num_steps; step += 1) {
+      const double t_step = t + static_cast<double>(step) * network.tau;
+      update_inflows(k, t_step, network.tau);
+      network.solve(network.tau, t_step);
+    }
+    publish(k, t + d_synchronization_interval);
+  }
+}
+
+double CoupledNetworkScheduler::get_synchronization_interval() const { return d_synchronization_interval; }
+
+std::size_t CoupledNetworkScheduler::num_steps(std::size_t network) const { return d_networks.at(network).num_steps; }
+
+} // namespace macrocirculation
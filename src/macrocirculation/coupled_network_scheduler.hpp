@@ -0,0 +1,120 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_COUPLED_NETWORK_SCHEDULER_HPP
+#define TUMORMODELS_COUPLED_NETWORK_SCHEDULER_HPP
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mpi.h>
+#include <vector>
+
+namespace macrocirculation {
+
+// forward declarations
+class GraphStorage;
+class Vertex;
+class ExplicitNonlinearFlowSolver;
+class ImplicitLinearFlowSolver;
+
+/*! @brief Advances several graphs, which are connected with Vertex::connect, with their own solvers and time steps.
+ *
+ *  All the networks meet at synchronization points, which are separated by the largest time step.
+ *  Inside a synchronization interval the networks are advanced from the largest to the smallest time step.
+ *  A network sees the values of an already advanced partner interpolated linearly in time between the synchronization points,
+ *  and the values of the last synchronization point otherwise. The values are sent from the rank of the edge at the one side of
+ *  a connection to the rank of the edge at the other side, and written directly into the vertex if both ranks coincide.
+ *  The connected vertices have to be linear or nonlinear characteristic inflows.
+ */
+class CoupledNetworkScheduler {
+public:
+  explicit CoupledNetworkScheduler(MPI_Comm comm);
+
+  /*! @brief Adds a network, whose solver has to stay alive as long as the scheduler. Returns the index of the network. */
+  std::size_t add_network(std::shared_ptr<GraphStorage> graph, ExplicitNonlinearFlowSolver &solver, double tau);
+
+  std::size_t add_network(std::shared_ptr<GraphStorage> graph, ImplicitLinearFlowSolver &solver, double tau);
+
+  /*! @brief Finds the connections between the networks and exchanges the values at the time t.
+   *         The time steps have to divide the largest time step.
+   */
+  void setup(double t);
+
+  /*! @brief Advances all the networks from t to the next synchronization point t + get_synchronization_interval(). */
+  void solve(double t);
+
+  double get_synchronization_interval() const;
+
+  /*! @brief Returns the number of steps of the network in every synchronization interval. */
+  std::size_t num_steps(std::size_t network) const;
+
+private:
+  struct Network {
+    std::shared_ptr<GraphStorage> graph;
+
+    double tau;
+
+    std::size_t num_steps;
+
+    std::function<void(double, double)> solve;
+
+    /*! @brief Evaluates p and q at a leaf of the network, where q is oriented along the edge. */
+    std::function<void(const Vertex &, double &, double &)> get_pq;
+  };
+
+  /*! @brief Sends the values at a vertex of one network to the connected vertex of another network. */
+  struct Connection {
+    std::size_t src_network;
+    std::size_t src_vertex_id;
+    std::size_t dst_network;
+    std::size_t dst_vertex_id;
+
+    /*! @brief The ranks of the edges at both vertices. */
+    int src_rank;
+    int dst_rank;
+
+    /*! @brief The values p and q at the last two synchronization points, which are only known on the destination rank. */
+    std::array<double, 2> values_old;
+    std::array<double, 2> values_new;
+    double t_old;
+    double t_new;
+  };
+
+  /*! @brief The connections of a network, whose values are sent or received by this rank, grouped by the other rank. */
+  struct ExchangePlan {
+    std::vector<std::size_t> local;
+    std::map<int, std::vector<std::size_t>> send;
+    std::map<int, std::vector<std::size_t>> receive;
+  };
+
+  MPI_Comm d_comm;
+
+  std::vector<Network> d_networks;
+
+  /*! @brief The network indices sorted by decreasing time steps. */
+  std::vector<std::size_t> d_order;
+
+  double d_synchronization_interval;
+
+  std::vector<Connection> d_connections;
+
+  /*! @brief The exchange plan of every network as the source of the connections. */
+  std::vector<ExchangePlan> d_plans;
+
+  /*! @brief Sends the values of the network at the time t to all its connected vertices. */
+  void publish(std::size_t network, double t);
+
+  /*! @brief Sets the characteristic inflows of the network from its partners for a step starting at t. */
+  void update_inflows(std::size_t network, double t, double tau);
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_COUPLED_NETWORK_SCHEDULER_HPP
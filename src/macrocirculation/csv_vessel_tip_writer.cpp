@@ -4,17 +4,35 @@
 
 #include "csv_vessel_tip_writer.hpp"
 
+#include <algorithm>
 #include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
 #include <nlohmann/json.hpp>
 #include <utility>
 
 #include "communication/mpi.hpp"
 #include "dof_map.hpp"
 #include "graph_storage.hpp"
+#include "phase_timers.hpp"
 #include "vessel_formulas.hpp"
 
 namespace macrocirculation {
 
+namespace {
+
+bool has_p_out(const Vertex &v) {
+  return v.is_windkessel_outflow() || v.is_vessel_tree_outflow();
+}
+
+double get_p_out(const Vertex &v) {
+  return v.is_windkessel_outflow() ? v.get_peripheral_vessel_data().p_out : v.get_vessel_tree_data().p_out;
+}
+
+} // namespace
+
 CSVVesselTipWriter::CSVVesselTipWriter(
   MPI_Comm comm,
   std::string output_directory,
@@ -27,11 +45,16 @@ CSVVesselTipWriter::CSVVesselTipWriter(
       d_filename(std::move(filename)),
       d_graph(std::move(graph)),
       d_dofmaps(std::move(dofmaps)),
-      d_types(std::move(types)) {
+      d_types(std::move(types)),
+      d_written(false),
+      d_gathered(false),
+      d_gather_comm(MPI_COMM_NULL),
+      d_num_value_columns(0) {
   if (d_dofmaps.size() != d_types.size())
     throw std::runtime_error("number of types and dofmaps must coincide");
 
-  reset_all_files();
+  // the csv files are created by our pool on the first write, since the files of the vertices are not needed with set_gathered
+  write_meta_file();
 }
 
 CSVVesselTipWriter::CSVVesselTipWriter(MPI_Comm comm,
@@ -47,66 +70,185 @@ CSVVesselTipWriter::CSVVesselTipWriter(MPI_Comm comm,
                          std::vector<std::string>({"p"})) {}
 
 void CSVVesselTipWriter::write(double t, const std::vector<double> &u) {
+  SCOPED_PHASE_TIMER("output");
   if (d_dofmaps.size() > 1)
     throw std::runtime_error("CSVVesselTipWriter::write: method supported only for one substance");
 
-  update_time(t);
+  d_times.push_back(t);
+  // the csv file is always complete, the meta file only after a flush, hence both need the full precision
+  if (mpi::rank(d_comm) == 0)
+    d_files.get(d_output_directory + "/" + get_times_file_name()) << std::setprecision(std::numeric_limits<double>::max_digits10) << t << '\n';
+  d_written = true;
+  if (d_gathered) {
+    write_gathered(*d_dofmaps.front(), u, d_types.front());
+    return;
+  }
   write_p_out();
   write_generic(*d_dofmaps.front(), u, d_types.front());
 }
 
+void CSVVesselTipWriter::set_gathered(bool gathered) {
+  if (d_written)
+    throw std::runtime_error("CSVVesselTipWriter::set_gathered: has to be called before the first write");
+  if (gathered == d_gathered)
+    return;
+  if (gathered && d_dofmaps.size() > 1)
+    throw std::runtime_error("CSVVesselTipWriter::set_gathered: gathering is supported only for one substance");
+
+  d_gathered = gathered;
+  if (d_gathered) {
+    CHECK_MPI_SUCCESS(MPI_Comm_dup(d_comm, &d_gather_comm));
+    setup_gathered_layout();
+  } else {
+    CHECK_MPI_SUCCESS(MPI_Comm_free(&d_gather_comm));
+    d_gathered_vertices.clear();
+  }
+  write_meta_file();
+}
+
+void CSVVesselTipWriter::set_buffer_size(std::size_t buffer_size) {
+  d_files.set_buffer_size(buffer_size);
+}
+
+void CSVVesselTipWriter::flush() {
+  d_files.flush();
+  write_times();
+}
+
+CSVVesselTipWriter::~CSVVesselTipWriter() {
+  // a destructor must not throw, e.g. if the output directory vanished
+  try {
+    flush();
+  } catch (const std::exception &e) {
+    std::cerr << "CSVVesselTipWriter could not write its meta file: " << e.what() << std::endl;
+  }
+  if (d_gather_comm != MPI_COMM_NULL)
+    MPI_Comm_free(&d_gather_comm);
+}
+
 template<typename VectorType>
 void CSVVesselTipWriter::write_generic(const DofMap &dof_map, const VectorType &u, const std::string &type) {
   for (auto v_id : d_graph->get_active_vertex_ids(mpi::rank(d_comm))) {
-    auto v = *d_graph->get_vertex(v_id);
-
-    if (v.is_vessel_tree_outflow() || v.is_windkessel_outflow() || v.is_rcl_outflow()) {
-      std::ofstream f(get_file_path(v_id, type), std::ios::app);
-      auto local_dof_map = dof_map.get_local_dof_map(v);
-      const auto &dofs = local_dof_map.dof_indices();
-      std::vector<double> values(dofs.size());
-      extract_dof(dofs, u, values);
-      for (auto value : values)
-        f << value << " ";
-      f << std::endl;
+    const auto &v = d_graph->vertex(v_id);
+
+    if (is_vessel_tip(v)) {
+      auto &f = d_files.get(get_file_path(v_id, type));
+      const auto &local_dof_map = dof_map.get_local_dof_map(v);
+      for (std::size_t k = 0; k < local_dof_map.num_local_dof(); k += 1)
+        f << u[local_dof_map.dof_index(k)] << " ";
+      f << '\n';
     }
   }
 }
 
 void CSVVesselTipWriter::write_p_out() {
   for (auto v_id : d_graph->get_active_vertex_ids(mpi::rank(d_comm))) {
-    auto v = *d_graph->get_vertex(v_id);
-
-    double p_out = 0;
-    if (v.is_windkessel_outflow())
-      p_out = v.get_peripheral_vessel_data().p_out;
-    else if (v.is_vessel_tree_outflow())
-      p_out = v.get_vessel_tree_data().p_out;
-    else
+    const auto &v = d_graph->vertex(v_id);
+
+    if (has_p_out(v))
+      d_files.get(get_file_path(v_id, "p_out")) << get_p_out(v) << " " << '\n';
+  }
+}
+
+void CSVVesselTipWriter::setup_gathered_layout() {
+  const auto &dof_map = *d_dofmaps.front();
+  const int rank = mpi::rank(d_comm);
+  const int num_ranks = mpi::size(d_comm);
+
+  // the vertex id, number of dofs and p_out flag of our vessel tips in the order of their values in the gathered rows
+  std::vector<unsigned long long> local_vertices;
+  for (auto v_id : d_graph->get_active_vertex_ids(rank)) {
+    const auto &v = d_graph->vertex(v_id);
+    if (!is_vessel_tip(v))
       continue;
+    local_vertices.insert(local_vertices.end(), {v_id, dof_map.get_local_dof_map(v).num_local_dof(), has_p_out(v)});
+  }
 
-    if (v.is_vessel_tree_outflow() || v.is_windkessel_outflow() || v.is_rcl_outflow()) {
-      std::ofstream f(get_file_path(v_id, "p_out"), std::ios::app);
-      f << p_out << " " << std::endl;
+  const int num_local_values = static_cast<int>(local_vertices.size());
+  std::vector<int> num_values(rank == 0 ? num_ranks : 0);
+  CHECK_MPI_SUCCESS(MPI_Gather(&num_local_values, 1, MPI_INT, num_values.data(), 1, MPI_INT, 0, d_gather_comm));
+  std::vector<int> displacements(num_values.size(), 0);
+  for (std::size_t r = 1; r < num_values.size(); r += 1)
+    displacements[r] = displacements[r - 1] + num_values[r - 1];
+  std::vector<unsigned long long> vertices(rank == 0 ? static_cast<std::size_t>(displacements.back() + num_values.back()) : 0);
+  CHECK_MPI_SUCCESS(MPI_Gatherv(local_vertices.data(), num_local_values, MPI_UNSIGNED_LONG_LONG, vertices.data(), num_values.data(), displacements.data(), MPI_UNSIGNED_LONG_LONG, 0, d_gather_comm));
+
+  std::size_t num_send_values = 0;
+  for (std::size_t k = 0; k < local_vertices.size(); k += 3)
+    num_send_values += local_vertices[k + 1] + local_vertices[k + 2];
+  d_send_buffer.reserve(num_send_values);
+
+  if (rank != 0)
+    return;
+
+  // the columns follow the vertex ids, such that the files do not depend on the partitioning
+  d_gathered_vertices.clear();
+  for (std::size_t k = 0; k < vertices.size(); k += 3)
+    d_gathered_vertices.push_back({vertices[k], vertices[k + 1], vertices[k + 2] != 0, 0, 0});
+  std::sort(d_gathered_vertices.begin(), d_gathered_vertices.end(), [](const auto &a, const auto &b) { return a.vertex_id < b.vertex_id; });
+  std::size_t num_p_out_columns = 0;
+  d_num_value_columns = 0;
+  std::map<std::size_t, const GatheredVertex *> vertex_by_id;
+  for (auto &v : d_gathered_vertices) {
+    v.column = d_num_value_columns;
+    v.column_p_out = num_p_out_columns;
+    d_num_value_columns += v.num_dofs;
+    num_p_out_columns += v.has_p_out;
+    vertex_by_id[v.vertex_id] = &v;
+  }
+
+  // the received values of each rank are in the order of its vessel tips
+  d_gathered_columns.clear();
+  d_gather_counts.assign(static_cast<std::size_t>(num_ranks), 0);
+  d_gather_displacements.assign(static_cast<std::size_t>(num_ranks), 0);
+  for (int r = 0; r < num_ranks; r += 1) {
+    d_gather_displacements[r] = static_cast<int>(d_gathered_columns.size());
+    for (int k = displacements[r]; k < displacements[r] + num_values[r]; k += 3) {
+      const auto &v = *vertex_by_id.at(vertices[k]);
+      for (std::size_t i = 0; i < v.num_dofs; i += 1)
+        d_gathered_columns.push_back(v.column + i);
+      if (v.has_p_out)
+        d_gathered_columns.push_back(d_num_value_columns + v.column_p_out);
     }
+    d_gather_counts[r] = static_cast<int>(d_gathered_columns.size()) - d_gather_displacements[r];
   }
+  d_receive_buffer.resize(d_gathered_columns.size());
+  d_row.resize(d_num_value_columns + num_p_out_columns);
 }
 
-void CSVVesselTipWriter::reset_all_files() {
-  // reset all the files
-  write_meta_file();
+void CSVVesselTipWriter::write_gathered(const DofMap &dof_map, const std::vector<double> &u, const std::string &type) {
+  d_send_buffer.clear();
   for (auto v_id : d_graph->get_active_vertex_ids(mpi::rank(d_comm))) {
-    auto &vertex = *d_graph->get_vertex(v_id);
-    for (auto &type : d_types) {
-      std::ofstream f(get_file_path(v_id, type), std::ios::out);
-      f << "";
-    }
-    // write special file for p_out
-    if (vertex.is_vessel_tree_outflow() || vertex.is_windkessel_outflow()) {
-      std::ofstream f(get_file_path(v_id, "p_out"), std::ios::out);
-      f << "";
-    }
+    const auto &v = d_graph->vertex(v_id);
+    if (!is_vessel_tip(v))
+      continue;
+    const auto &local_dof_map = dof_map.get_local_dof_map(v);
+    for (std::size_t k = 0; k < local_dof_map.num_local_dof(); k += 1)
+      d_send_buffer.push_back(u[local_dof_map.dof_index(k)]);
+    if (has_p_out(v))
+      d_send_buffer.push_back(get_p_out(v));
   }
+
+  CHECK_MPI_SUCCESS(MPI_Gatherv(d_send_buffer.data(), static_cast<int>(d_send_buffer.size()), MPI_DOUBLE, d_receive_buffer.data(), d_gather_counts.data(), d_gather_displacements.data(), MPI_DOUBLE, 0, d_gather_comm));
+  if (mpi::rank(d_comm) != 0)
+    return;
+
+  for (std::size_t k = 0; k < d_receive_buffer.size(); k += 1)
+    d_row[d_gathered_columns[k]] = d_receive_buffer[k];
+
+  // the rows have the format of the files of the vertices
+  auto &f = d_files.get(d_output_directory + "/" + get_gathered_file_name(type));
+  for (std::size_t k = 0; k < d_num_value_columns; k += 1)
+    f << d_row[k] << " ";
+  f << '\n';
+  auto &f_p_out = d_files.get(d_output_directory + "/" + get_gathered_file_name("p_out"));
+  for (std::size_t k = d_num_value_columns; k < d_row.size(); k += 1)
+    f_p_out << d_row[k] << " ";
+  f_p_out << '\n';
+}
+
+bool CSVVesselTipWriter::is_vessel_tip(const Vertex &v) {
+  return v.is_vessel_tree_outflow() || v.is_windkessel_outflow() || v.is_rcl_outflow();
 }
 
 void CSVVesselTipWriter::write_meta_file() {
@@ -116,28 +258,28 @@ void CSVVesselTipWriter::write_meta_file() {
 
   auto vertices_list = json::array();
   for (auto v_id : d_graph->get_vertex_ids()) {
-    auto v = d_graph->get_vertex(v_id);
-    auto e = d_graph->get_edge(v->get_edge_neighbors()[0]);
+    auto &v = d_graph->vertex(v_id);
+    auto &e = d_graph->edge(v.get_edge_neighbors()[0]);
 
-    if (v->is_vessel_tree_outflow() || v->is_windkessel_outflow() || v->is_rcl_outflow()) {
+    if (v.is_vessel_tree_outflow() || v.is_windkessel_outflow() || v.is_rcl_outflow()) {
       std::string outflow_type;
-      if (v->is_vessel_tree_outflow())
+      if (v.is_vessel_tree_outflow())
         outflow_type += "vessel_tree";
-      else if (v->is_windkessel_outflow())
+      else if (v.is_windkessel_outflow())
         outflow_type += "windkessel";
-      else if (v->is_rcl_outflow())
+      else if (v.is_rcl_outflow())
         outflow_type += "rcl";
       else
         outflow_type += "unknown";
 
       // get number of dofs:
-      int num_dofs = mpi::rank(d_comm) == e->rank() ? static_cast<int>(d_dofmaps.front()->get_local_dof_map(*v).num_local_dof()) : 0;
+      int num_dofs = mpi::rank(d_comm) == e.rank() ? static_cast<int>(d_dofmaps.front()->get_local_dof_map(v).num_local_dof()) : 0;
       // only the master process has to know the number of dof.
-      if (e->rank() != 0) {
-        if (mpi::rank(d_comm) == e->rank())
+      if (e.rank() != 0) {
+        if (mpi::rank(d_comm) == e.rank())
           MPI_Send(&num_dofs, 1, MPI_INT, 0, 101, d_comm);
         if (mpi::rank(d_comm) == 0)
-          MPI_Recv(&num_dofs, 1, MPI_INT, static_cast<int>(e->rank()), 101, d_comm, nullptr);
+          MPI_Recv(&num_dofs, 1, MPI_INT, static_cast<int>(e.rank()), 101, d_comm, nullptr);
       }
 
       std::map<std::string, std::string> filepaths;
@@ -147,38 +289,51 @@ void CSVVesselTipWriter::write_meta_file() {
 
       json vessel_obj = {
         {"vertex_id", v_id},
-        {"name", v->get_name()},
-        {"neighbor_edge_id", v->get_edge_neighbors()[0]},
+        {"name", v.get_name()},
+        {"neighbor_edge_id", v.get_edge_neighbors()[0]},
         {"filepaths", filepaths},
         {"outflow_type", outflow_type},
         {"num_dofs", num_dofs},
       };
 
-      if (e->has_embedding_data()) {
-        auto& points = e->get_embedding_data().points;
-        auto p = e->is_pointing_to(v_id) ? points.back() : points.front();
+      // only rank 0 knows the columns of the gathered files
+      if (d_gathered) {
+        vessel_obj.erase("filepaths");
+        const auto it = std::lower_bound(d_gathered_vertices.begin(), d_gathered_vertices.end(), v_id, [](const auto &gv, std::size_t id) { return gv.vertex_id < id; });
+        if (it != d_gathered_vertices.end() && it->vertex_id == v_id) {
+          vessel_obj["column"] = it->column;
+          if (it->has_p_out)
+            vessel_obj["column_p_out"] = it->column_p_out;
+        }
+      }
+
+      if (e.has_embedding_data()) {
+        auto& points = e.get_embedding_data().points;
+        auto p = e.is_pointing_to(v_id) ? points.back() : points.front();
         vessel_obj["coordinates"] = {p.x, p.y, p.z};
       }
 
-      if (v->is_vessel_tree_outflow()) {
-        vessel_obj["resistance"] = v->get_vessel_tree_data().resistances;
-        vessel_obj["capacitances"] = v->get_vessel_tree_data().capacitances;
-        vessel_obj["radii"] = v->get_vessel_tree_data().radii;
-        vessel_obj["R1"] = calculate_R1(e->get_physical_data());
-        vessel_obj["furcation_number"] = v->get_vessel_tree_data().furcation_number;
-        vessel_obj["filepath_p_out"] = get_file_name(v_id, "p_out");
+      if (v.is_vessel_tree_outflow()) {
+        vessel_obj["resistance"] = v.get_vessel_tree_data().resistances;
+        vessel_obj["capacitances"] = v.get_vessel_tree_data().capacitances;
+        vessel_obj["radii"] = v.get_vessel_tree_data().radii;
+        vessel_obj["R1"] = calculate_R1(e.get_physical_data());
+        vessel_obj["furcation_number"] = v.get_vessel_tree_data().furcation_number;
+        if (!d_gathered)
+          vessel_obj["filepath_p_out"] = get_file_name(v_id, "p_out");
       }
 
-      if (v->is_windkessel_outflow()) {
-        vessel_obj["R2"] = v->get_peripheral_vessel_data().resistance - calculate_R1(e->get_physical_data());
-        vessel_obj["C"] = v->get_peripheral_vessel_data().compliance;
-        vessel_obj["filepath_p_out"] = get_file_name(v_id, "p_out");
+      if (v.is_windkessel_outflow()) {
+        vessel_obj["R2"] = v.get_peripheral_vessel_data().resistance - calculate_R1(e.get_physical_data());
+        vessel_obj["C"] = v.get_peripheral_vessel_data().compliance;
+        if (!d_gathered)
+          vessel_obj["filepath_p_out"] = get_file_name(v_id, "p_out");
       }
 
-      if (v->is_rcl_outflow()) {
-        vessel_obj["R"] = v->get_rcl_data().resistances;
-        vessel_obj["C"] = v->get_rcl_data().capacitances;
-        vessel_obj["L"] = v->get_rcl_data().inductances;
+      if (v.is_rcl_outflow()) {
+        vessel_obj["R"] = v.get_rcl_data().resistances;
+        vessel_obj["C"] = v.get_rcl_data().capacitances;
+        vessel_obj["L"] = v.get_rcl_data().inductances;
       }
 
       vertices_list.push_back(vessel_obj);
@@ -186,6 +341,14 @@ void CSVVesselTipWriter::write_meta_file() {
   }
   j["vertices"] = vertices_list;
   j["times"] = json::array();
+  j["filepath_times"] = get_times_file_name();
+  if (d_gathered) {
+    std::map<std::string, std::string> filepaths;
+    for (const auto &type : d_types)
+      filepaths["filepath_" + type] = get_gathered_file_name(type);
+    filepaths["filepath_p_out"] = get_gathered_file_name("p_out");
+    j["filepaths_gathered"] = filepaths;
+  }
 
   if (mpi::rank(d_comm) == 0) {
     std::ofstream f(get_meta_file_path(), std::ios::out);
@@ -193,7 +356,7 @@ void CSVVesselTipWriter::write_meta_file() {
   }
 }
 
-void CSVVesselTipWriter::update_time(double t) {
+void CSVVesselTipWriter::write_times() const {
   if (mpi::rank(d_comm) != 0)
     return;
 
@@ -203,7 +366,7 @@ void CSVVesselTipWriter::update_time(double t) {
     f >> j;
   }
 
-  j["times"].push_back(t);
+  j["times"] = d_times;
 
   {
     std::ofstream f(get_meta_file_path(), std::ios::out);
@@ -219,6 +382,14 @@ std::string CSVVesselTipWriter::get_file_name(size_t vertex_id, const std::strin
   return d_filename + "_" + std::to_string(vertex_id) + "_" + type + ".csv";
 }
 
+std::string CSVVesselTipWriter::get_gathered_file_name(const std::string &type) const {
+  return d_filename + "_" + type + ".csv";
+}
+
+std::string CSVVesselTipWriter::get_times_file_name() const {
+  return d_filename + "_times.csv";
+}
+
 std::string CSVVesselTipWriter::get_meta_file_path() const {
   return d_output_directory + "/" + d_filename + ".json";
 }
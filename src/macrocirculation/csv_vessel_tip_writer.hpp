@@ -14,17 +14,21 @@
 #include <string>
 #include <vector>
 
+#include "buffered_file_pool.hpp"
+
 namespace macrocirculation {
 
 // forward declarations:
 class GraphStorage;
 class DofMap;
+class Vertex;
 
 /*! @brief Serializes the pressures at the vessel tips to csv files which are structured with a meta json-file containing the time steps and vessel information.
  *
  * The meta json file <filename>.json has the structure:
  * {
  *     "times": [ ... list of time steps ... ],
+ *     "filepath_times": "<filename>_times.csv",
  *     "vertices": [ ...
  *        {
  *          "filepath": "<full filepath to the csv file >",
@@ -38,10 +42,18 @@ class DofMap;
  * }
  *
  * The csv files form a number-of-time-steps x number-of-capacitors matrix.
+ * They stay open with large buffers during the run, hence the last values only reach the disk on flush or when the writer is destroyed.
+ * The times csv file gets a line for each time step, while the list of time steps in the meta file is only completed on flush.
+ *
+ * With set_gathered, the rows of all the vessel tips are instead gathered to rank 0 with a single MPI_Gatherv per write,
+ * which writes them into the two files <filename>_<type>.csv and <filename>_p_out.csv. Their rows are the time steps,
+ * and the columns of a vertex start at its "column" and "column_p_out" entry in the meta file, where the vertices follow
+ * each other in the order of their ids, independent of the partitioning. These two files replace the "filepaths" and "filepath_p_out" entries
+ * by the "filepaths_gathered" entry of the meta file.
  */
 class CSVVesselTipWriter {
 public:
-  /*! @brief Constructs a vessel tip writer. Writes the json meta file and overwrites previous csv files.
+  /*! @brief Constructs a vessel tip writer. Writes the json meta file, while previous csv files are overwritten by the first write.
    *
    * @param comm The communicator used for the parallel communication.
    * @param output_directory The directory to which we output both the csv files as well as the json meta file.
@@ -76,6 +88,22 @@ public:
    */
   void write(double t, const std::vector<double> &u);
 
+  /*! @brief Gathers the rows of all the vessel tips on rank 0, which writes them into a single file per type instead of a file per vertex.
+   *         Has to be called on all the ranks before the first write, and rewrites the meta file. The call is collective.
+   *         The gathering uses its own communicator, hence the writes may run on an output thread with MPI_THREAD_MULTIPLE.
+   */
+  void set_gathered(bool gathered);
+
+  /*! @brief Sets the buffer size in bytes of the csv files, which applies to the files opened by the next write. */
+  void set_buffer_size(std::size_t buffer_size);
+
+  /*! @brief Writes the buffered values to the csv files and the time steps to the meta file.
+   *         This happens automatically when the writer is destroyed.
+   */
+  void flush();
+
+  ~CSVVesselTipWriter();
+
 private:
   MPI_Comm d_comm;
   std::string d_output_directory;
@@ -84,14 +112,52 @@ private:
   std::vector<std::shared_ptr<DofMap>> d_dofmaps;
   std::vector<std::string> d_types;
 
-  /*! @brief Writes the empty string to all csv files and thereby deleting previously recorded data. * */
-  void reset_all_files();
+  /*! @brief The time steps, which are written to the meta file on flush. */
+  std::vector<double> d_times;
+
+  /*! @brief The csv files, which stay open between the writes. */
+  BufferedFilePool d_files;
+
+  /*! @brief True, once the first write has created the csv files, which truncates those of previous runs. */
+  bool d_written;
+
+  bool d_gathered;
+
+  /*! @brief A duplicate of d_comm for gathering the rows, or MPI_COMM_NULL. */
+  MPI_Comm d_gather_comm;
+
+  /*! @brief The layout of the gathered rows, where every vessel tip contributes its dofs followed by its outflow pressure, if it has one. */
+  struct GatheredVertex {
+    std::size_t vertex_id;
+    std::size_t num_dofs;
+    bool has_p_out;
+    /*! @brief The first column of the dofs in the file of the type, and the column in the p_out file. */
+    std::size_t column;
+    std::size_t column_p_out;
+  };
+
+  /*! @brief The vessel tips of all the ranks in the order of their ids, which is only known on rank 0. */
+  std::vector<GatheredVertex> d_gathered_vertices;
+
+  /*! @brief The number of gathered values of every rank and their displacements, which are only known on rank 0. */
+  std::vector<int> d_gather_counts;
+  std::vector<int> d_gather_displacements;
+
+  /*! @brief The column of each gathered value in the concatenation of the rows of the type and the p_out file. */
+  std::vector<std::size_t> d_gathered_columns;
+
+  /*! @brief The number of columns of the file of the type, which are followed by the columns of the p_out file in d_row. */
+  std::size_t d_num_value_columns;
+
+  std::vector<double> d_send_buffer;
+  std::vector<double> d_receive_buffer;
+  std::vector<double> d_row;
 
   /*! @brief Writes the meta json file. */
   void write_meta_file();
 
-  /*! @brief Adds the given time to the meta json file. */
-  void update_time(double t);
+  /*! @brief Replaces the time steps in the meta json file by d_times. */
+  void write_times() const;
 
   /*! @brief Returns the csv filepath for a vertex with the given vertex_id for the given data type. */
   std::string get_file_path(size_t vertex_id, const std::string &type) const;
@@ -99,6 +165,9 @@ private:
   /*! @brief Returns the csv filename for a vertex with the given vertex_id. */
   std::string get_file_name(size_t vertex_id, const std::string &type) const;
 
+  /*! @brief Returns the csv filename for the time steps. */
+  std::string get_times_file_name() const;
+
   /*! @brief Returns the json filepath for the meta file. */
   std::string get_meta_file_path() const;
 
@@ -112,6 +181,18 @@ private:
   void write_generic(const DofMap &dof_map, const VectorType &u, const std::string &type);
 
   void write_p_out();
+
+  /*! @brief Collects the vessel tips of all the ranks and their columns on rank 0. */
+  void setup_gathered_layout();
+
+  /*! @brief Gathers the dofs and outflow pressures of all the vessel tips and appends them as rows on rank 0. */
+  void write_gathered(const DofMap &dof_map, const std::vector<double> &u, const std::string &type);
+
+  /*! @brief Returns true, if the vertex is a vessel tip with a 0D model. */
+  static bool is_vessel_tip(const Vertex &v);
+
+  /*! @brief Returns the filename of the gathered file of the given type. */
+  std::string get_gathered_file_name(const std::string &type) const;
 };
 
 } // namespace macrocirculation
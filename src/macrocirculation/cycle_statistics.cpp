@@ -0,0 +1,193 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "cycle_statistics.hpp"
+
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <nlohmann/json.hpp>
+#include <stdexcept>
+#include <utility>
+
+#include "communication/mpi.hpp"
+#include "dof_map.hpp"
+#include "explicit_nonlinear_flow_solver.hpp"
+#include "graph_storage.hpp"
+#include "vessel_formulas.hpp"
+
+namespace macrocirculation {
+
+CycleStatistics::CycleStatistics(MPI_Comm comm,
+                                 std::string foldername,
+                                 std::string datasetname,
+                                 std::shared_ptr<GraphStorage> graph,
+                                 std::shared_ptr<DofMap> dof_map,
+                                 double period)
+    : d_comm(comm),
+      d_foldername(std::move(foldername)),
+      d_datasetname(std::move(datasetname)),
+      d_graph(std::move(graph)),
+      d_dof_map(std::move(dof_map)),
+      d_period(period),
+      d_t_start(std::numeric_limits<double>::quiet_NaN()),
+      d_t_last(0),
+      d_in_period(false),
+      d_num_periods(0) {
+  if (d_period <= 0)
+    throw std::runtime_error("the period of the cycle statistics has to be positive");
+
+  const auto path = d_foldername + "/" + get_file_name(mpi::rank(d_comm));
+  d_file.open(path, std::ios::out | std::ios::trunc);
+  if (!d_file)
+    throw std::runtime_error("could not open " + path + " for writing");
+  d_file << "period,t_start,edge_id,micro_edge,p_min,p_max,p_mean,p_pulse,t_p_max,q_min,q_max,q_mean,t_q_max\n";
+  d_file << std::setprecision(std::numeric_limits<double>::max_digits10);
+
+  write_meta_file();
+}
+
+std::size_t CycleStatistics::get_num_periods() const { return d_num_periods; }
+
+const std::vector<CycleStatistics::Statistics> &CycleStatistics::get_statistics() const { return d_completed; }
+
+void CycleStatistics::evaluate(const std::vector<double> &u, std::vector<double> &p, std::vector<double> &q) const {
+  p.clear();
+  q.clear();
+  for (auto e_id : d_graph->get_active_edge_ids(mpi::rank(d_comm))) {
+    const auto &edge = d_graph->edge(e_id);
+    const auto &param = edge.get_physical_data();
+    const auto &local_dof_map = d_dof_map->get_local_dof_map(edge);
+    for (std::size_t micro_edge = 0; micro_edge < local_dof_map.num_micro_edges(); micro_edge += 1) {
+      // the constant legendre polynomial is the only one with a nonzero mean
+      const double A = *local_dof_map.dof_values(u, micro_edge, ExplicitNonlinearFlowSolver::A_component);
+      p.push_back(nonlinear::get_p_from_A(A, param.G0, param.A0));
+      q.push_back(*local_dof_map.dof_values(u, micro_edge, ExplicitNonlinearFlowSolver::Q_component));
+    }
+  }
+}
+
+void CycleStatistics::reset(double t, const std::vector<double> &p, const std::vector<double> &q) {
+  d_in_period = true;
+  d_current.resize(p.size());
+  for (std::size_t k = 0; k < p.size(); k += 1)
+    d_current[k] = {p[k], p[k], 0, t, q[k], q[k], 0, t};
+}
+
+void CycleStatistics::accumulate(double t, const std::vector<double> &p, const std::vector<double> &q) {
+  const double dt = t - d_t_last;
+  for (std::size_t k = 0; k < p.size(); k += 1) {
+    auto &s = d_current[k];
+    s.p_integral += 0.5 * dt * (d_p_last[k] + p[k]);
+    s.q_integral += 0.5 * dt * (d_q_last[k] + q[k]);
+    if (p[k] > s.p_max) {
+      s.p_max = p[k];
+      s.t_p_max = t;
+    }
+    if (q[k] > s.q_max) {
+      s.q_max = q[k];
+      s.t_q_max = t;
+    }
+    s.p_min = std::min(s.p_min, p[k]);
+    s.q_min = std::min(s.q_min, q[k]);
+  }
+}
+
+bool CycleStatistics::update(double t, const std::vector<double> &u) {
+  std::vector<double> p, q;
+  evaluate(u, p, q);
+
+  // the first period starts at the next multiple of the period length
+  if (std::isnan(d_t_start)) {
+    d_t_start = d_period * std::ceil(t / d_period - 1e-12);
+    d_t_last = t;
+    d_p_last = std::move(p);
+    d_q_last = std::move(q);
+    if (std::abs(t - d_t_start) < 1e-12)
+      reset(t, d_p_last, d_q_last);
+    return false;
+  }
+
+  bool period_completed = false;
+
+  // the step can cross the start and the end of a period, where we split it by interpolating linearly
+  while (t > d_t_last) {
+    const bool started = d_in_period;
+    const double t_next = started ? d_t_start + d_period : d_t_start;
+    const double t_stop = std::min(t, t_next);
+
+    const double theta = (t_stop - d_t_last) / (t - d_t_last);
+    std::vector<double> p_stop(p.size()), q_stop(q.size());
+    for (std::size_t k = 0; k < p.size(); k += 1) {
+      p_stop[k] = (1 - theta) * d_p_last[k] + theta * p[k];
+      q_stop[k] = (1 - theta) * d_q_last[k] + theta * q[k];
+    }
+
+    if (started)
+      accumulate(t_stop, p_stop, q_stop);
+
+    d_t_last = t_stop;
+    d_p_last = std::move(p_stop);
+    d_q_last = std::move(q_stop);
+
+    if (t_stop + 1e-12 < t_next)
+      break;
+
+    if (started) {
+      write_period();
+      d_t_start += d_period;
+      period_completed = true;
+    }
+    reset(t_next, d_p_last, d_q_last);
+  }
+
+  return period_completed;
+}
+
+void CycleStatistics::write_period() {
+  d_completed = d_current;
+
+  std::size_t k = 0;
+  for (auto e_id : d_graph->get_active_edge_ids(mpi::rank(d_comm))) {
+    const auto &local_dof_map = d_dof_map->get_local_dof_map(d_graph->edge(e_id));
+    for (std::size_t micro_edge = 0; micro_edge < local_dof_map.num_micro_edges(); micro_edge += 1, k += 1) {
+      const auto &s = d_completed[k];
+      d_file << d_num_periods << "," << d_t_start << "," << e_id << "," << micro_edge << ","
+             << s.p_min << "," << s.p_max << "," << s.p_integral / d_period << "," << s.p_max - s.p_min << "," << s.t_p_max << ","
+             << s.q_min << "," << s.q_max << "," << s.q_integral / d_period << "," << s.t_q_max << "\n";
+    }
+  }
+  // a period is only written once, hence flushing costs nothing compared to the time steps
+  d_file.flush();
+
+  d_num_periods += 1;
+}
+
+std::string CycleStatistics::get_file_name(int rank) const {
+  return d_datasetname + "_" + std::to_string(rank) + ".csv";
+}
+
+void CycleStatistics::write_meta_file() const {
+  // only one rank writes the file
+  if (mpi::rank(d_comm) != 0)
+    return;
+
+  using json = nlohmann::json;
+
+  std::vector<std::string> filepaths;
+  for (int rank = 0; rank < mpi::size(d_comm); rank += 1)
+    filepaths.push_back(get_file_name(rank));
+
+  json j;
+  j["period"] = d_period;
+  j["filepaths"] = filepaths;
+
+  std::ofstream f(d_foldername + "/" + d_datasetname + ".json", std::ios::out);
+  f << j.dump(1);
+}
+
+} // namespace macrocirculation
@@ -0,0 +1,115 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_CYCLE_STATISTICS_HPP
+#define TUMORMODELS_CYCLE_STATISTICS_HPP
+
+#include <cstddef>
+#include <fstream>
+#include <memory>
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+namespace macrocirculation {
+
+// forward declarations
+class GraphStorage;
+class DofMap;
+
+/*! @brief Accumulates the minimum, maximum, mean and time of the peak of the pressure and the flow on every micro edge
+ *         over each period of the inflow, such that the full fields do not have to be written for the usual post-processing.
+ *
+ *  The values of a micro edge are the averages of its static pressure and flow, i.e. the constant Legendre coefficients.
+ *  The periods start at multiples of the period length. Once a period is completed, every rank appends a single line
+ *  per micro edge and period to its csv file, containing the statistics of the period.
+ *  The means are integrated with the trapezoidal rule between the calls to update.
+ */
+class CycleStatistics {
+public:
+  CycleStatistics(MPI_Comm comm,
+                  std::string foldername,
+                  std::string datasetname,
+                  std::shared_ptr<GraphStorage> graph,
+                  std::shared_ptr<DofMap> dof_map,
+                  double period);
+
+  /*! @brief Accumulates the solution u of the nonlinear flow solver at time t, which has to be called after every time step.
+   *
+   * @return True if a period was completed and written during this call.
+   */
+  bool update(double t, const std::vector<double> &u);
+
+  /*! @brief The number of completed and written periods. */
+  std::size_t get_num_periods() const;
+
+  /*! @brief The statistics of a single micro edge in a period. */
+  struct Statistics {
+    double p_min;
+    double p_max;
+    double p_integral;
+    double t_p_max;
+
+    double q_min;
+    double q_max;
+    double q_integral;
+    double t_q_max;
+  };
+
+  /*! @brief The statistics of the last completed period, ordered by the active edges of our rank and their micro edges. */
+  const std::vector<Statistics> &get_statistics() const;
+
+private:
+  MPI_Comm d_comm;
+
+  std::string d_foldername;
+  std::string d_datasetname;
+
+  std::shared_ptr<GraphStorage> d_graph;
+
+  std::shared_ptr<DofMap> d_dof_map;
+
+  double d_period;
+
+  /*! @brief The start of the current period, NaN before the first call to update. */
+  double d_t_start;
+
+  /*! @brief The time and the pressures and flows of the micro edges at the last call to update. */
+  double d_t_last;
+  std::vector<double> d_p_last;
+  std::vector<double> d_q_last;
+
+  /*! @brief Did the first period start? Before that the values are not accumulated. */
+  bool d_in_period;
+
+  std::vector<Statistics> d_current;
+
+  std::vector<Statistics> d_completed;
+
+  std::size_t d_num_periods;
+
+  std::ofstream d_file;
+
+  /*! @brief Evaluates the averaged pressures and flows of all the micro edges of our rank. */
+  void evaluate(const std::vector<double> &u, std::vector<double> &p, std::vector<double> &q) const;
+
+  /*! @brief Starts the statistics of a new period with the given values. */
+  void reset(double t, const std::vector<double> &p, const std::vector<double> &q);
+
+  /*! @brief Adds the linear interpolation between the last values and the given ones at time t to the current period. */
+  void accumulate(double t, const std::vector<double> &p, const std::vector<double> &q);
+
+  void write_period();
+
+  void write_meta_file() const;
+
+  std::string get_file_name(int rank) const;
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_CYCLE_STATISTICS_HPP
@@ -0,0 +1,116 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "degree_adaptivity.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "communication/mpi.hpp"
+#include "dof_map.hpp"
+#include "graph_storage.hpp"
+
+namespace macrocirculation {
+
+double smoothness_indicator(const LocalEdgeDofMap &local_dof_map, const std::vector<double> &u, std::size_t component) {
+  const std::size_t degree = local_dof_map.num_basis_functions() - 1;
+  if (degree == 0)
+    return -std::numeric_limits<double>::infinity();
+
+  double max_share = 0;
+  for (std::size_t micro_edge_id = 0; micro_edge_id < local_dof_map.num_micro_edges(); micro_edge_id += 1) {
+    const double *dofs = local_dof_map.dof_values(u, micro_edge_id, component);
+
+    // the squared L2 norm of a legendre expansion is the weighted sum of its squared coefficients
+    double norm = 0;
+    for (std::size_t i = 0; i <= degree; i += 1)
+      norm += legendre_weight(i) * dofs[i] * dofs[i];
+
+    if (norm > 0)
+      max_share = std::max(max_share, legendre_weight(degree) * dofs[degree] * dofs[degree] / norm);
+  }
+
+  return std::log10(max_share);
+}
+
+std::vector<std::size_t> get_edge_degrees(MPI_Comm comm, const GraphStorage &graph, const DofMap &dof_map) {
+  // every edge is active on exactly one rank, which contributes its degree
+  std::vector<unsigned long long> degrees(graph.num_edges(), 0);
+  for (auto e_id : graph.get_active_edge_ids(mpi::rank(comm)))
+    degrees[e_id] = dof_map.get_local_dof_map(graph.edge(e_id)).num_basis_functions() - 1;
+  CHECK_MPI_SUCCESS(MPI_Allreduce(MPI_IN_PLACE, degrees.data(), static_cast<int>(degrees.size()), MPI_UNSIGNED_LONG_LONG, MPI_MAX, comm));
+  return {degrees.begin(), degrees.end()};
+}
+
+std::vector<std::size_t> select_edge_degrees(MPI_Comm comm,
+                                             const GraphStorage &graph,
+                                             const DofMap &dof_map,
+                                             const std::vector<double> &u,
+                                             const DegreeAdaptivitySettings &settings) {
+  if (settings.min_degree > settings.max_degree || settings.max_degree > max_fe_degree)
+    throw std::runtime_error("the degrees have to be in the range 0 to " + std::to_string(max_fe_degree));
+
+  std::vector<unsigned long long> degrees(graph.num_edges(), 0);
+  for (auto e_id : graph.get_active_edge_ids(mpi::rank(comm))) {
+    const auto &local_dof_map = dof_map.get_local_dof_map(graph.edge(e_id));
+    std::size_t degree = local_dof_map.num_basis_functions() - 1;
+
+    double indicator = -std::numeric_limits<double>::infinity();
+    for (std::size_t component = 0; component < local_dof_map.num_components(); component += 1)
+      indicator = std::max(indicator, smoothness_indicator(local_dof_map, u, component));
+
+    if (indicator > settings.lower_threshold && degree > 0)
+      degree -= 1;
+    else if (indicator < settings.raise_threshold)
+      degree += 1;
+
+    degrees[e_id] = std::max(settings.min_degree, std::min(settings.max_degree, degree));
+  }
+  CHECK_MPI_SUCCESS(MPI_Allreduce(MPI_IN_PLACE, degrees.data(), static_cast<int>(degrees.size()), MPI_UNSIGNED_LONG_LONG, MPI_MAX, comm));
+  return {degrees.begin(), degrees.end()};
+}
+
+void transfer_to_degrees(MPI_Comm comm,
+                         const GraphStorage &graph,
+                         const DofMap &old_dof_map,
+                         const std::vector<double> &u_old,
+                         const DofMap &new_dof_map,
+                         std::vector<double> &u_new) {
+  u_new.assign(new_dof_map.num_dof(), 0.);
+
+  const int rank = mpi::rank(comm);
+  for (auto e_id : graph.get_active_edge_ids(rank)) {
+    const auto &edge = graph.edge(e_id);
+    const auto &old_local_dof_map = old_dof_map.get_local_dof_map(edge);
+    const auto &new_local_dof_map = new_dof_map.get_local_dof_map(edge);
+    const std::size_t num_shared = std::min(old_local_dof_map.num_basis_functions(), new_local_dof_map.num_basis_functions());
+
+    for (std::size_t micro_edge_id = 0; micro_edge_id < old_local_dof_map.num_micro_edges(); micro_edge_id += 1) {
+      for (std::size_t component = 0; component < old_local_dof_map.num_components(); component += 1) {
+        const double *old_dofs = old_local_dof_map.dof_values(u_old, micro_edge_id, component);
+        double *new_dofs = new_local_dof_map.dof_values(u_new, micro_edge_id, component);
+        std::copy(old_dofs, old_dofs + num_shared, new_dofs);
+      }
+    }
+  }
+
+  for (auto v_id : graph.get_active_vertex_ids(rank)) {
+    const auto &vertex = graph.vertex(v_id);
+    if (!graph.owns_primitive(vertex, rank) || !vertex.is_leaf())
+      continue;
+
+    const auto &old_local_dof_map = old_dof_map.get_local_dof_map(vertex);
+    const auto &new_local_dof_map = new_dof_map.get_local_dof_map(vertex);
+    for (std::size_t component = 0; component < new_local_dof_map.num_local_dof(); component += 1)
+      u_new[new_local_dof_map.dof_index(component)] = u_old[old_local_dof_map.dof_index(component)];
+  }
+}
+
+} // namespace macrocirculation
@@ -0,0 +1,74 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_DEGREE_ADAPTIVITY_HPP
+#define TUMORMODELS_DEGREE_ADAPTIVITY_HPP
+
+#include <cstddef>
+#include <mpi.h>
+#include <vector>
+
+#include "fe_type.hpp"
+
+namespace macrocirculation {
+
+// forward declarations
+class GraphStorage;
+class DofMap;
+class LocalEdgeDofMap;
+
+/*! @brief Settings for choosing the degree of every edge from the smoothness of the solution. */
+struct DegreeAdaptivitySettings {
+  std::size_t min_degree{1};
+
+  std::size_t max_degree{max_fe_degree};
+
+  /*! @brief An edge gets one degree more, if its smoothness indicator is below this value. */
+  double raise_threshold{-10};
+
+  /*! @brief An edge gets one degree less, if its smoothness indicator is above this value. */
+  double lower_threshold{-6};
+};
+
+/*! @brief Returns the smoothness indicator of Persson and Peraire for the given component on an edge.
+ *
+ *  On every micro edge the share of the highest legendre mode in the squared L2 norm is calculated,
+ *  which decays quickly for smooth solutions, but stays large near steep fronts.
+ *  The indicator is the log10 of the largest share of all the micro edges, or -infinity for degree 0.
+ */
+double smoothness_indicator(const LocalEdgeDofMap &local_dof_map, const std::vector<double> &u, std::size_t component);
+
+/*! @brief Returns the degree of every edge in the given dof map indexed by the edge id.
+ *         The call is collective and every rank returns the degrees of all the edges.
+ */
+std::vector<std::size_t> get_edge_degrees(MPI_Comm comm, const GraphStorage &graph, const DofMap &dof_map);
+
+/*! @brief Returns the new degree of every edge indexed by the edge id, which is raised or lowered by one depending on the
+ *         smoothness indicator of all the components of u, and clamped to the range of the settings.
+ *         The call is collective and every rank returns the degrees of all the edges.
+ */
+std::vector<std::size_t> select_edge_degrees(MPI_Comm comm,
+                                             const GraphStorage &graph,
+                                             const DofMap &dof_map,
+                                             const std::vector<double> &u,
+                                             const DegreeAdaptivitySettings &settings);
+
+/*! @brief Projects u_old onto the shape functions of new_dof_map, which only differs in the degrees of the edges.
+ *
+ *  Since the legendre basis is hierarchical and orthogonal, the L2 projection truncates the coefficients of a lower degree,
+ *  and pads the coefficients of a higher degree with zeros. The values of the vertices are copied.
+ */
+void transfer_to_degrees(MPI_Comm comm,
+                         const GraphStorage &graph,
+                         const DofMap &old_dof_map,
+                         const std::vector<double> &u_old,
+                         const DofMap &new_dof_map,
+                         std::vector<double> &u_new);
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_DEGREE_ADAPTIVITY_HPP
@@ -0,0 +1,109 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "derived_quantities.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include "explicit_nonlinear_flow_solver.hpp"
+#include "interpolation_plan.hpp"
+
+namespace macrocirculation {
+
+DerivedQuantities::DerivedQuantities(std::shared_ptr<const InterpolationPlan> plan)
+    : d_plan(std::move(plan)),
+      d_u(nullptr),
+      d_num_evaluations(0) {
+  declare("Q", [](DerivedQuantities &q, const std::vector<double> &u, std::vector<double> &values) {
+    q.get_plan().interpolate(ExplicitNonlinearFlowSolver::Q_component, u, values);
+  });
+  declare("A", [](DerivedQuantities &q, const std::vector<double> &u, std::vector<double> &values) {
+    q.get_plan().interpolate(ExplicitNonlinearFlowSolver::A_component, u, values);
+  });
+  declare("p_static", [](DerivedQuantities &q, const std::vector<double> &, std::vector<double> &values) {
+    q.get_plan().calculate_static_pressure(q.get("A"), values);
+  });
+  declare("p_total", [](DerivedQuantities &q, const std::vector<double> &, std::vector<double> &values) {
+    q.get_plan().calculate_total_pressure(q.get("Q"), q.get("A"), values);
+  });
+  declare("velocity", [](DerivedQuantities &q, const std::vector<double> &, std::vector<double> &values) {
+    const auto &Q = q.get("Q");
+    const auto &A = q.get("A");
+    values.resize(Q.size());
+    for (std::size_t k = 0; k < Q.size(); k += 1)
+      values[k] = Q[k] / A[k];
+  });
+  declare("c", [](DerivedQuantities &q, const std::vector<double> &, std::vector<double> &values) {
+    q.get_plan().calculate_wave_speed(q.get("A"), values);
+  });
+}
+
+void DerivedQuantities::declare(const std::string &name, Evaluator evaluator) {
+  auto &field = d_fields[name];
+  field.evaluator = std::move(evaluator);
+  field.is_valid = false;
+  field.is_evaluating = false;
+}
+
+bool DerivedQuantities::is_declared(const std::string &name) const { return d_fields.find(name) != d_fields.end(); }
+
+void DerivedQuantities::subscribe(const std::string &name) {
+  if (!is_declared(name))
+    throw std::runtime_error("the derived quantity " + name + " was not declared");
+  if (!is_subscribed(name))
+    d_subscriptions.push_back(name);
+}
+
+void DerivedQuantities::subscribe_list(const std::string &names) {
+  std::stringstream ss(names);
+  std::string name;
+  while (std::getline(ss, name, ','))
+    if (!name.empty())
+      subscribe(name);
+}
+
+bool DerivedQuantities::is_subscribed(const std::string &name) const {
+  return std::find(d_subscriptions.begin(), d_subscriptions.end(), name) != d_subscriptions.end();
+}
+
+void DerivedQuantities::update(const std::vector<double> &u) {
+  d_u = &u;
+  for (auto &field : d_fields)
+    field.second.is_valid = false;
+}
+
+const std::vector<double> &DerivedQuantities::get(const std::string &name) {
+  auto it = d_fields.find(name);
+  if (it == d_fields.end())
+    throw std::runtime_error("the derived quantity " + name + " was not declared");
+  if (d_u == nullptr)
+    throw std::runtime_error("the derived quantity " + name + " was requested before the first update");
+
+  auto &field = it->second;
+  if (field.is_valid)
+    return field.values;
+  if (field.is_evaluating)
+    throw std::runtime_error("the derived quantity " + name + " depends on itself");
+
+  // the map does not move its elements, hence the reference survives the evaluation of the dependencies
+  field.is_evaluating = true;
+  try {
+    field.evaluator(*this, *d_u, field.values);
+  } catch (...) {
+    field.is_evaluating = false;
+    throw;
+  }
+  field.is_evaluating = false;
+  field.is_valid = true;
+  d_num_evaluations += 1;
+  return field.values;
+}
+
+} // namespace macrocirculation
@@ -0,0 +1,91 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_DERIVED_QUANTITIES_HPP
+#define TUMORMODELS_DERIVED_QUANTITIES_HPP
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace macrocirculation {
+
+// forward declarations
+class InterpolationPlan;
+
+/*! @brief Registry of the fields, which are derived from the solution at the points of an InterpolationPlan.
+ *
+ *  The fields are declared by name and only evaluated, when they are requested with get after an update of the solution.
+ *  Their values are kept until the next update, hence several writers of the same time step share a single evaluation.
+ *  An evaluator can request the fields it depends on, e.g. the total pressure reuses the interpolated flow and area.
+ *  Writers iterate over the subscribed fields, such that only the consumed fields are ever evaluated.
+ */
+class DerivedQuantities {
+public:
+  using Evaluator = std::function<void(DerivedQuantities &quantities, const std::vector<double> &u, std::vector<double> &values)>;
+
+  /*! @brief Declares the fields Q, A, p_static, p_total, velocity and c of the nonlinear flow solver on the given plan. */
+  explicit DerivedQuantities(std::shared_ptr<const InterpolationPlan> plan);
+
+  /*! @brief Declares a new field or replaces the evaluator of an existing one. */
+  void declare(const std::string &name, Evaluator evaluator);
+
+  bool is_declared(const std::string &name) const;
+
+  /*! @brief Subscribes to a declared field, such that writers evaluate it. */
+  void subscribe(const std::string &name);
+
+  /*! @brief Subscribes to the comma separated list of fields, e.g. "Q,p_total". */
+  void subscribe_list(const std::string &names);
+
+  bool is_subscribed(const std::string &name) const;
+
+  /*! @brief The subscribed fields in the order of their subscription. */
+  const std::vector<std::string> &get_subscriptions() const { return d_subscriptions; }
+
+  /*! @brief Sets the solution, from which the fields are derived, and forgets all the values of the previous one.
+   *         Nothing is evaluated, and the solution has to outlive all the calls to get until the next update.
+   */
+  void update(const std::vector<double> &u);
+
+  /*! @brief Returns the values of the given field at the points of the plan, which are evaluated at the first request after an update. */
+  const std::vector<double> &get(const std::string &name);
+
+  /*! @brief The number of field evaluations since the construction. */
+  std::size_t num_evaluations() const { return d_num_evaluations; }
+
+  const InterpolationPlan &get_plan() const { return *d_plan; }
+
+private:
+  struct Field {
+    Evaluator evaluator;
+
+    std::vector<double> values;
+
+    /*! @brief True, if the values belong to the current solution. */
+    bool is_valid;
+
+    /*! @brief True, while the field is evaluated, to detect cyclic dependencies. */
+    bool is_evaluating;
+  };
+
+  std::shared_ptr<const InterpolationPlan> d_plan;
+
+  std::map<std::string, Field> d_fields;
+
+  std::vector<std::string> d_subscriptions;
+
+  const std::vector<double> *d_u;
+
+  std::size_t d_num_evaluations;
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_DERIVED_QUANTITIES_HPP
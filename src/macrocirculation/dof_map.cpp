@@ -9,12 +9,21 @@
 
 #include <cassert>
 #include <numeric>
+#include <set>
 
 #include "communication/mpi.hpp"
 #include "graph_storage.hpp"
+#include "phase_timers.hpp"
 
 namespace macrocirculation {
 
+LocalEdgeDofMap::LocalEdgeDofMap()
+    : d_dof_interval_start(std::numeric_limits<std::size_t>::max()),
+      d_dof_interval_end(std::numeric_limits<std::size_t>::max()),
+      d_num_components(0),
+      d_num_basis_functions(0),
+      d_num_micro_edges(0) {}
+
 LocalEdgeDofMap::LocalEdgeDofMap(std::size_t dof_interval_start,
                                  std::size_t num_components,
                                  std::size_t num_basis_functions,
@@ -83,23 +92,22 @@ void DofMap::add_local_dof_map(const Edge &e,
                                std::size_t num_basis_functions,
                                std::size_t num_local_micro_edges,
                                std::size_t start_dof) {
-  assert(d_local_dof_maps[e.get_id()] == nullptr);
-  auto local_dof_map = std::make_unique<LocalEdgeDofMap>(start_dof, num_components, num_basis_functions, num_local_micro_edges);
-  d_num_dof += local_dof_map->num_local_dof();
-  d_local_dof_maps[e.get_id()] = std::move(local_dof_map);
+  assert(!d_local_dof_maps[e.get_id()].is_initialized());
+  d_local_dof_maps[e.get_id()] = LocalEdgeDofMap(start_dof, num_components, num_basis_functions, num_local_micro_edges);
+  d_num_dof += d_local_dof_maps[e.get_id()].num_local_dof();
 }
 
 void DofMap::add_local_dof_map(const Vertex &v, std::size_t start_dof, std::size_t num_components) {
-  assert(d_local_vertex_dof_maps[v.get_id()] == nullptr);
-  auto local_dof_map = std::make_unique<LocalVertexDofMap>(start_dof, num_components);
-  d_num_dof += local_dof_map->num_local_dof();
-  d_local_vertex_dof_maps[v.get_id()] = std::move(local_dof_map);
+  assert(!d_local_vertex_dof_maps[v.get_id()].is_initialized());
+  d_local_vertex_dof_maps[v.get_id()] = LocalVertexDofMap(start_dof, num_components);
+  d_num_dof += num_components;
 }
 
 const LocalEdgeDofMap &DofMap::get_local_dof_map(const Edge &e) const {
-  if (d_local_dof_maps.at(e.get_id()) == nullptr)
+  const auto &local_dof_map = d_local_dof_maps.at(e.get_id());
+  if (!local_dof_map.is_initialized())
     throw std::runtime_error("dof map for edge with id " + std::to_string(e.get_id()) + " was not initialized.");
-  return *d_local_dof_maps.at(e.get_id());
+  return local_dof_map;
 }
 
 std::size_t DofMap::num_dof() const {
@@ -116,6 +124,35 @@ void extract_dof(const std::vector<std::size_t> &dof_indices,
     local[i] = global[dof_indices[i]];
 }
 
+namespace {
+
+/*! @brief The number of dofs of the 0D models of the flow at a vertex. */
+size_t num_flow_vertex_dofs(const Vertex &vertex) {
+  if (vertex.is_windkessel_outflow()) {
+    return 1;
+  } else if (vertex.is_vessel_tree_outflow()) {
+    return vertex.get_vessel_tree_data().resistances.size();
+  } else if (vertex.is_rcl_outflow()) {
+    return 2 * vertex.get_rcl_data().resistances.size();
+  }
+  return 0;
+}
+
+/*! @brief The leaves carrying 0D dofs are owned by the rank of their only edge. */
+bool has_vertex_dofs(const GraphStorage &graph, const Vertex &vertex, int rank) {
+  if (!graph.owns_primitive(vertex, rank))
+    return false;
+
+  if (!vertex.bc_finalized())
+    throw std::runtime_error(
+      "Boundary conditions have to be finalized before distributing the dof on primitives.\n"
+      "Please call GraphStorage::finalize_bcs() before.");
+
+  return vertex.is_leaf();
+}
+
+} // namespace
+
 void DofMap::create(MPI_Comm comm, const GraphStorage &graph, std::size_t num_components, std::size_t degree, bool global) {
   create(comm, graph, num_components, degree, 0, global);
 }
@@ -126,18 +163,7 @@ void DofMap::create(MPI_Comm comm,
                     std::size_t degree,
                     std::size_t start_dof_offset,
                     bool global) {
-  auto num_vertex_components = [](const Vertex &vertex) -> size_t {
-    if (vertex.is_windkessel_outflow()) {
-      return 1;
-    } else if (vertex.is_vessel_tree_outflow()) {
-      return vertex.get_vessel_tree_data().resistances.size();
-    } else if (vertex.is_rcl_outflow()) {
-      return 2 * vertex.get_rcl_data().resistances.size();
-    }
-    return 0;
-  };
-
-  create(comm, graph, num_components, degree, start_dof_offset, global, num_vertex_components);
+  create(comm, graph, num_components, degree, start_dof_offset, global, num_flow_vertex_dofs);
 }
 
 void DofMap::create(MPI_Comm comm,
@@ -147,41 +173,22 @@ void DofMap::create(MPI_Comm comm,
                     std::size_t start_dof_offset,
                     bool global,
                     const std::function<size_t(const Vertex &)> &num_vertex_dofs) {
-  d_first_global_dof = start_dof_offset;
-
-  for (int rank = 0; rank < mpi::size(comm); rank += 1) {
-    const bool callingRank = (rank == mpi::rank(comm));
-
-    // if we do not assign all the ranks AND this is not the calling rank we add nothing
-    if (!global && !callingRank)
-      continue;
-
-    // if we are the rank
-    if (callingRank)
-      d_first_owned_global_dof = d_num_dof + d_first_global_dof;
-
-    for (const auto &e_id : graph.get_active_edge_ids(rank)) {
-      const auto edge = graph.get_edge(e_id);
-      add_local_dof_map(*edge, num_components, degree + 1, edge->num_micro_edges(), d_first_global_dof + d_num_dof);
-      if (callingRank)
-        d_num_owned_dofs += get_local_dof_map(*edge).num_local_dof();
-    }
-
-    for (const auto &v_id : graph.get_active_vertex_ids(rank)) {
-      const auto vertex = graph.get_vertex(v_id);
+  auto num_dofs = [&num_vertex_dofs](const GraphStorage &, const Vertex &v) { return num_vertex_dofs(v); };
+  auto edge_degree = [degree](const GraphStorage &, const Edge &) { return degree; };
+  distribute(comm, {&graph}, {this}, num_components, edge_degree, true, start_dof_offset, global, num_dofs);
+}
 
-      if (!vertex->bc_finalized())
-        throw std::runtime_error(
-          "Boundary conditions have to be finalized before distributing the dof on primitives.\n"
-          "Please call GraphStorage::finalize_bcs() before.");
+void DofMap::create(MPI_Comm comm,
+                    const GraphStorage &graph,
+                    std::size_t num_components,
+                    const std::vector<std::size_t> &edge_degrees,
+                    bool global) {
+  if (edge_degrees.size() != graph.num_edges())
+    throw std::runtime_error("expected a degree for each of the " + std::to_string(graph.num_edges()) + " edges");
 
-      if (vertex->is_leaf()) {
-        add_local_dof_map(*vertex, d_first_global_dof + d_num_dof, num_vertex_dofs(*vertex));
-        if (callingRank)
-          d_num_owned_dofs += get_local_dof_map(*vertex).num_local_dof();
-      }
-    }
-  }
+  auto num_dofs = [](const GraphStorage &, const Vertex &v) { return num_flow_vertex_dofs(v); };
+  auto edge_degree = [&edge_degrees](const GraphStorage &, const Edge &e) { return edge_degrees[e.get_id()]; };
+  distribute(comm, {&graph}, {this}, num_components, edge_degree, true, 0, global, num_dofs);
 }
 
 void DofMap::create(MPI_Comm comm,
@@ -193,145 +200,229 @@ void DofMap::create(MPI_Comm comm,
   if (graphs.size() != dof_maps.size())
     throw std::runtime_error("dof map and graph list must have the same size");
 
-  for (auto &d : dof_maps)
-    d->d_first_global_dof = 0;
-
-  size_t total_number_of_dof = 0;
-
-  for (int rank = 0; rank < mpi::size(comm); rank += 1) {
-    const bool callingRank = (rank == mpi::rank(comm));
-
-    for (int k = 0; k < static_cast< int > ( graphs.size() ); k += 1) {
-      auto graph = graphs[k];
-      auto dof_map = dof_maps[k];
-
-      if (k == 0) {
-        dof_map->d_first_global_dof = total_number_of_dof;
-      }
-
-      // if we are the rank
-      if (callingRank && k == 0) {
-        dof_map->d_first_owned_global_dof = total_number_of_dof;
-      }
-
-      for (const auto &e_id : graph->get_active_edge_ids(rank)) {
-        const auto edge = graph->get_edge(e_id);
-        dof_map->add_local_dof_map(*edge, num_components, degree + 1, edge->num_micro_edges(), total_number_of_dof);
-        total_number_of_dof += dof_map->get_local_dof_map(*edge).num_local_dof();
-        if (callingRank) {
-          dof_map->d_num_owned_dofs += dof_map->get_local_dof_map(*edge).num_local_dof();
-        }
-      }
-
-      for (const auto &v_id : graph->get_active_vertex_ids(rank)) {
-        const auto vertex = graph->get_vertex(v_id);
-
-        // only initialize this primitive if it is owned!
-        if (!graph->owns_primitive(*vertex, rank))
-          continue;
-
-        if (!vertex->bc_finalized())
-          throw std::runtime_error(
-            "Boundary conditions have to be finalized before distributing the dof on primitives.\n"
-            "Please call GraphStorage::finalize_bcs() before.");
-
-        if (vertex->is_leaf()) {
-          dof_map->add_local_dof_map(*vertex, total_number_of_dof, num_vertex_dofs(*graph, *vertex));
-          total_number_of_dof += dof_map->get_local_dof_map(*vertex).num_local_dof();
-          if (callingRank) {
-            dof_map->d_num_owned_dofs += dof_map->get_local_dof_map(*vertex).num_local_dof();
-          }
-        }
-      }
-    }
+  std::vector<const GraphStorage *> graph_ptrs;
+  std::vector<DofMap *> dof_map_ptrs;
+  for (std::size_t k = 0; k < graphs.size(); k += 1) {
+    graph_ptrs.push_back(graphs[k].get());
+    dof_map_ptrs.push_back(dof_maps[k].get());
   }
+  auto edge_degree = [degree](const GraphStorage &, const Edge &) { return degree; };
+  distribute(comm, graph_ptrs, dof_map_ptrs, num_components, edge_degree, true, 0, true, num_vertex_dofs);
 }
 
 void DofMap::create_for_transport(MPI_Comm comm,
                                   const std::vector<std::shared_ptr<GraphStorage>> &graphs,
                                   const std::vector<std::shared_ptr<DofMap>> &dof_maps,
-                                  std::size_t degree) {
-  auto num_vertex_dof = [](auto, const Vertex &v) -> size_t {
+                                  std::size_t degree,
+                                  std::size_t num_species) {
+  auto num_vertex_dof = [num_species](const auto &, const Vertex &v) -> size_t {
     if (v.is_windkessel_outflow())
-      return 1;
+      return num_species;
     else if (v.is_vessel_tree_outflow())
-      return v.get_vessel_tree_data().resistances.size();
+      return num_species * v.get_vessel_tree_data().resistances.size();
     return 0;
   };
-  create(comm, graphs, dof_maps, 1, degree, num_vertex_dof);
+  create(comm, graphs, dof_maps, num_species, degree, num_vertex_dof);
 }
 
 void DofMap::create_on_vertices(MPI_Comm comm,
-                               const std::vector<std::shared_ptr<GraphStorage>> &graphs,
-                               const std::vector<std::shared_ptr<DofMap>> &dof_maps,
-                               const std::function<size_t(const GraphStorage &, const Vertex &)> &num_vertex_dofs) {
+                                const std::vector<std::shared_ptr<GraphStorage>> &graphs,
+                                const std::vector<std::shared_ptr<DofMap>> &dof_maps,
+                                const std::function<size_t(const GraphStorage &, const Vertex &)> &num_vertex_dofs) {
   if (graphs.size() != dof_maps.size())
     throw std::runtime_error("dof map and graph list must have the same size");
 
-  for (auto &d : dof_maps)
-    d->d_first_global_dof = 0;
+  std::vector<const GraphStorage *> graph_ptrs;
+  std::vector<DofMap *> dof_map_ptrs;
+  for (std::size_t k = 0; k < graphs.size(); k += 1) {
+    graph_ptrs.push_back(graphs[k].get());
+    dof_map_ptrs.push_back(dof_maps[k].get());
+  }
+  auto edge_degree = [](const GraphStorage &, const Edge &) -> size_t { return 0; };
+  distribute(comm, graph_ptrs, dof_map_ptrs, 0, edge_degree, false, 0, true, num_vertex_dofs);
+}
 
-  size_t total_number_of_dof = 0;
+void DofMap::distribute(MPI_Comm comm,
+                        const std::vector<const GraphStorage *> &graphs,
+                        const std::vector<DofMap *> &dof_maps,
+                        std::size_t num_components,
+                        const std::function<size_t(const GraphStorage &, const Edge &)> &edge_degree,
+                        bool with_edges,
+                        std::size_t start_dof_offset,
+                        bool global,
+                        const std::function<size_t(const GraphStorage &, const Vertex &)> &num_vertex_dofs) {
+  SCOPED_SETUP_TIMER("dof map");
+  const int rank = mpi::rank(comm);
+
+  // count the dofs of the primitives owned by this rank
+  std::vector<unsigned long long> num_owned_dofs(graphs.size(), 0);
+  for (std::size_t k = 0; k < graphs.size(); k += 1) {
+    const auto &graph = *graphs[k];
+    if (with_edges) {
+      for (const auto &e_id : graph.get_active_edge_ids(rank))
+        num_owned_dofs[k] += num_components * (edge_degree(graph, graph.edge(e_id)) + 1) * graph.edge(e_id).num_micro_edges();
+    }
+    for (const auto &v_id : graph.get_active_vertex_ids(rank)) {
+      const auto &vertex = graph.vertex(v_id);
+      if (has_vertex_dofs(graph, vertex, rank))
+        num_owned_dofs[k] += num_vertex_dofs(graph, vertex);
+    }
+  }
 
-  for (int rank = 0; rank < mpi::size(comm); rank += 1) {
-    const bool callingRank = (rank == mpi::rank(comm));
+  // the owned dofs of rank r start after the dofs of the ranks 0, ..., r-1
+  unsigned long long rank_offset = 0;
+  std::vector<unsigned long long> num_total_dofs = num_owned_dofs;
+  if (global) {
+    unsigned long long num_rank_dofs = std::accumulate(num_owned_dofs.begin(), num_owned_dofs.end(), 0ull);
+    CHECK_MPI_SUCCESS(MPI_Exscan(&num_rank_dofs, &rank_offset, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm));
+    // the receive buffer of rank 0 is undefined after an exclusive scan
+    if (rank == 0)
+      rank_offset = 0;
+    CHECK_MPI_SUCCESS(MPI_Allreduce(MPI_IN_PLACE, num_total_dofs.data(), static_cast<int>(num_total_dofs.size()), MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm));
+  }
+
+  // number the owned primitives
+  std::size_t next_dof = start_dof_offset + rank_offset;
+  for (std::size_t k = 0; k < graphs.size(); k += 1) {
+    const auto &graph = *graphs[k];
+    auto &dof_map = *dof_maps[k];
 
-    for (int k = 0; k < static_cast< int > ( graphs.size() ); k += 1) {
-      auto graph = graphs[k];
-      auto dof_map = dof_maps[k];
+    dof_map.d_first_owned_global_dof = next_dof;
 
-      if (k == 0) {
-        dof_map->d_first_global_dof = total_number_of_dof;
+    if (with_edges) {
+      for (const auto &e_id : graph.get_active_edge_ids(rank)) {
+        const auto &edge = graph.edge(e_id);
+        dof_map.add_local_dof_map(edge, num_components, edge_degree(graph, edge) + 1, edge.num_micro_edges(), next_dof);
+        next_dof += dof_map.get_local_dof_map(edge).num_local_dof();
       }
+    }
 
-      // if we are the rank
-      if (callingRank && k == 0) {
-        dof_map->d_first_owned_global_dof = total_number_of_dof;
+    for (const auto &v_id : graph.get_active_vertex_ids(rank)) {
+      const auto &vertex = graph.vertex(v_id);
+      if (has_vertex_dofs(graph, vertex, rank)) {
+        dof_map.add_local_dof_map(vertex, next_dof, num_vertex_dofs(graph, vertex));
+        next_dof += dof_map.get_local_dof_map(vertex).num_local_dof();
       }
+    }
 
-      for (const auto &v_id : graph->get_active_vertex_ids(rank)) {
-        const auto vertex = graph->get_vertex(v_id);
+    dof_map.d_num_owned_dofs = num_owned_dofs[k];
+  }
 
-        // only initialize this primitive if it is owned!
-        if (!graph->owns_primitive(*vertex, rank))
-          continue;
+  // the ghost edges get their numbering from the ranks owning them
+  if (global && with_edges) {
+    std::vector<int> neighbors;
+    std::vector<std::vector<unsigned long long>> send_buffers;
+    std::vector<std::vector<unsigned long long>> receive_buffers;
+    // only the neighbor ranks on any of the graphs share ghost edges with us
+    std::set<int> neighbor_ranks;
+    for (const auto &graph : graphs) {
+      const auto graph_neighbor_ranks = graph->get_neighbor_ranks(rank);
+      neighbor_ranks.insert(graph_neighbor_ranks.begin(), graph_neighbor_ranks.end());
+    }
+    for (int other_rank : neighbor_ranks) {
+      std::vector<unsigned long long> send_buffer;
+      std::size_t num_receive = 0;
+      for (std::size_t k = 0; k < graphs.size(); k += 1) {
+        for (const auto &e_id : graphs[k]->get_ghost_edge_ids(other_rank, rank))
+          send_buffer.push_back(dof_maps[k]->get_local_dof_map(graphs[k]->edge(e_id)).first_dof(0, 0));
+        num_receive += graphs[k]->get_ghost_edge_ids(rank, other_rank).size();
+      }
 
-        if (!vertex->bc_finalized())
-          throw std::runtime_error(
-            "Boundary conditions have to be finalized before distributing the dof on primitives.\n"
-            "Please call GraphStorage::finalize_bcs() before.");
+      if (send_buffer.empty() && num_receive == 0)
+        continue;
+
+      neighbors.push_back(other_rank);
+      send_buffers.push_back(std::move(send_buffer));
+      receive_buffers.emplace_back(num_receive);
+    }
 
-        if (vertex->is_leaf()) {
-          dof_map->add_local_dof_map(*vertex, total_number_of_dof, num_vertex_dofs(*graph, *vertex));
-          total_number_of_dof += dof_map->get_local_dof_map(*vertex).num_local_dof();
-          if (callingRank) {
-            dof_map->d_num_owned_dofs += dof_map->get_local_dof_map(*vertex).num_local_dof();
-          }
+    const int tag = 0;
+    std::vector<MPI_Request> requests(2 * neighbors.size(), MPI_REQUEST_NULL);
+    for (std::size_t n = 0; n < neighbors.size(); n += 1) {
+      CHECK_MPI_SUCCESS(MPI_Irecv(receive_buffers[n].data(), static_cast<int>(receive_buffers[n].size()), MPI_UNSIGNED_LONG_LONG, neighbors[n], tag, comm, &requests[2 * n]));
+      CHECK_MPI_SUCCESS(MPI_Isend(send_buffers[n].data(), static_cast<int>(send_buffers[n].size()), MPI_UNSIGNED_LONG_LONG, neighbors[n], tag, comm, &requests[2 * n + 1]));
+    }
+    CHECK_MPI_SUCCESS(MPI_Waitall(static_cast<int>(requests.size()), requests.data(), MPI_STATUSES_IGNORE));
+
+    for (std::size_t n = 0; n < neighbors.size(); n += 1) {
+      std::size_t idx = 0;
+      for (std::size_t k = 0; k < graphs.size(); k += 1) {
+        for (const auto &e_id : graphs[k]->get_ghost_edge_ids(rank, neighbors[n])) {
+          const auto &edge = graphs[k]->edge(e_id);
+          dof_maps[k]->add_local_dof_map(edge, num_components, edge_degree(*graphs[k], edge) + 1, edge.num_micro_edges(), receive_buffers[n][idx]);
+          idx += 1;
         }
       }
     }
   }
+
+  for (std::size_t k = 0; k < graphs.size(); k += 1) {
+    dof_maps[k]->d_first_global_dof = start_dof_offset;
+    dof_maps[k]->d_num_dof = num_total_dofs[k];
+  }
+}
+
+std::vector<LocalVertexDofMap> DofMap::renumber_vertex_dofs(MPI_Comm comm, const GraphStorage &graph) {
+  if (d_first_owned_global_dof != d_first_global_dof || d_num_owned_dofs != d_num_dof)
+    throw std::runtime_error("only the vertex dofs of a dof map with local dofs can be renumbered");
+
+  const int rank = mpi::rank(comm);
+
+  // the owned edges are numbered first and keep their dofs
+  std::size_t next_dof = d_first_global_dof;
+  for (const auto &e_id : graph.get_active_edge_ids(rank))
+    next_dof += get_local_dof_map(graph.edge(e_id)).num_local_dof();
+
+  std::vector<LocalVertexDofMap> old_vertex_dof_maps(d_local_vertex_dof_maps.size());
+  std::swap(old_vertex_dof_maps, d_local_vertex_dof_maps);
+
+  d_num_dof = next_dof - d_first_global_dof;
+  for (const auto &v_id : graph.get_active_vertex_ids(rank)) {
+    const auto &vertex = graph.vertex(v_id);
+    if (has_vertex_dofs(graph, vertex, rank)) {
+      add_local_dof_map(vertex, next_dof, num_flow_vertex_dofs(vertex));
+      next_dof += get_local_dof_map(vertex).num_local_dof();
+    }
+  }
+  d_num_owned_dofs = d_num_dof;
+
+  return old_vertex_dof_maps;
+}
+
+bool DofMap::has_local_dof_map(const Vertex &v) const {
+  return d_local_vertex_dof_maps.at(v.get_id()).is_initialized();
 }
 
 const LocalVertexDofMap &DofMap::get_local_dof_map(const Vertex &v) const {
-  if (d_local_vertex_dof_maps.at(v.get_id()) == nullptr)
+  const auto &local_dof_map = d_local_vertex_dof_maps.at(v.get_id());
+  if (!local_dof_map.is_initialized())
     throw std::runtime_error("dof map for vertex with id " + std::to_string(v.get_id()) + " was not initialized.");
-  return *d_local_vertex_dof_maps.at(v.get_id());
+  return local_dof_map;
 }
 
-LocalVertexDofMap::LocalVertexDofMap(std::size_t dof_interval_start, std::size_t num_components) {
-  for (size_t c = 0; c < num_components; c += 1)
-    d_dof_indices.push_back(dof_interval_start + c);
-}
+LocalVertexDofMap::LocalVertexDofMap()
+    : d_dof_interval_start(std::numeric_limits<std::size_t>::max()),
+      d_num_components(0) {}
+
+LocalVertexDofMap::LocalVertexDofMap(std::size_t dof_interval_start, std::size_t num_components)
+    : d_dof_interval_start(dof_interval_start),
+      d_num_components(num_components) {}
 
 size_t DofMap::first_owned_global_dof() const { return d_first_owned_global_dof; }
 
 size_t DofMap::num_owned_dofs() const { return d_num_owned_dofs; }
-void DofMap::create(MPI_Comm /*comm*/, const std::vector<GraphStorage> &/*graphs*/, const std::vector<DofMap> &/*dof_maps*/, size_t /*num_components*/, size_t /*degree*/, bool /*global*/, const std::function<size_t(const Vertex &)> &/*num_vertex_dofs*/) {
-}
 
-std::size_t LocalVertexDofMap::num_local_dof() const { return d_dof_indices.size(); }
+MemoryReport DofMap::memory_report() const {
+  MemoryReport report;
+  report.add("edge dof maps", d_local_dof_maps);
+  report.add("vertex dof maps", d_local_vertex_dof_maps);
+  return report;
+}
 
-const std::vector<std::size_t> &LocalVertexDofMap::dof_indices() const { return d_dof_indices; }
+std::vector<std::size_t> LocalVertexDofMap::dof_indices() const {
+  std::vector<std::size_t> dof_indices(d_num_components);
+  std::iota(dof_indices.begin(), dof_indices.end(), d_dof_interval_start);
+  return dof_indices;
+}
 
 } // namespace macrocirculation
@@ -9,10 +9,13 @@
 #define TUMORMODELS_DOF_MAP_HPP
 
 #include <functional>
+#include <limits>
 #include <memory>
 #include <mpi.h>
 #include <vector>
 
+#include "memory_report.hpp"
+
 namespace macrocirculation {
 
 // forward declarations
@@ -22,10 +25,18 @@ class GraphStorage;
 class MicroEdge;
 
 /*! @brief Simple dof map, which orders the dofs on the macro edge by the formula
- *         dof_interval_start + edge_id * num_components * num_basis_functions + num_basis_functions * component_id + basis_function_id
+ *         dof_interval_start + micro_edge_id * num_components * num_basis_functions + num_basis_functions * component_id + basis_function_id
+ *
+ *         Hence all the coefficients of a micro edge are adjacent in memory, and the coefficients of a single component are contiguous.
+ *         Instead of filling index vectors, they can be accessed by strided arithmetic with first_dof and micro_edge_stride,
+ *         or directly as a pointer into the solution vector with dof_values.
+ *         The map only consists of a few integers and is cheap to copy.
  */
 class LocalEdgeDofMap {
 public:
+  /*! @brief Creates an uninitialized dof map, which is used as a placeholder for edges without dofs. */
+  LocalEdgeDofMap();
+
   LocalEdgeDofMap(std::size_t dof_interval_start,
                   std::size_t num_components,
                   std::size_t num_basis_functions,
@@ -35,12 +46,35 @@ public:
 
   void dof_indices(const MicroEdge &micro_edge, std::size_t component, std::vector<std::size_t> &dof_indices) const;
 
+  /*! @returns The global index of the first basis function of the given component on the given micro edge.
+   *           The remaining basis functions of this component follow contiguously.
+   */
+  std::size_t first_dof(std::size_t local_micro_edge_id, std::size_t component) const {
+    return d_dof_interval_start + local_micro_edge_id * d_num_basis_functions * d_num_components + d_num_basis_functions * component;
+  }
+
+  /*! @returns The distance between the dofs of two consecutive micro edges. */
+  std::size_t micro_edge_stride() const { return d_num_basis_functions * d_num_components; }
+
+  /*! @returns A pointer to the num_basis_functions contiguous coefficients of the given component on the given micro edge. */
+  const double *dof_values(const std::vector<double> &u, std::size_t local_micro_edge_id, std::size_t component) const {
+    return u.data() + first_dof(local_micro_edge_id, component);
+  }
+
+  /*! @returns A mutable pointer to the num_basis_functions contiguous coefficients of the given component on the given micro edge. */
+  double *dof_values(std::vector<double> &u, std::size_t local_micro_edge_id, std::size_t component) const {
+    return u.data() + first_dof(local_micro_edge_id, component);
+  }
+
   std::size_t num_local_dof() const;
   std::size_t num_micro_edges() const;
   std::size_t num_micro_vertices() const;
   std::size_t num_components() const;
   std::size_t num_basis_functions() const;
 
+  /*! @returns True if dofs were assigned to this map. */
+  bool is_initialized() const { return d_dof_interval_start != std::numeric_limits<std::size_t>::max(); }
+
 private:
   std::size_t d_dof_interval_start;
   std::size_t d_dof_interval_end;
@@ -50,17 +84,33 @@ private:
   std::size_t d_num_micro_edges;
 };
 
-/** @brief Simple dof map, which saves the dofs on the macro vertex. These could for instance belong to 0D model. */
+/** @brief Simple dof map, which saves the dofs on the macro vertex. These could for instance belong to 0D model.
+ *         The dofs of a vertex are contiguous, hence only the range [first_dof, first_dof + num_local_dof) is stored.
+ */
 class LocalVertexDofMap {
 public:
+  /*! @brief Creates an uninitialized dof map, which is used as a placeholder for vertices without dofs. */
+  LocalVertexDofMap();
+
   LocalVertexDofMap(std::size_t dof_interval_start, std::size_t num_components);
 
-  std::size_t num_local_dof() const;
+  std::size_t num_local_dof() const { return d_num_components; }
+
+  /*! @returns The global index of the first dof on the vertex. */
+  std::size_t first_dof() const { return d_dof_interval_start; }
+
+  /*! @returns The global index of the given component on the vertex. */
+  std::size_t dof_index(std::size_t component) const { return d_dof_interval_start + component; }
 
-  const std::vector<std::size_t> &dof_indices() const;
+  /*! @brief Materializes the dof indices of the vertex. Prefer first_dof and num_local_dof in hot loops. */
+  std::vector<std::size_t> dof_indices() const;
+
+  /*! @returns True if dofs were assigned to this map. */
+  bool is_initialized() const { return d_dof_interval_start != std::numeric_limits<std::size_t>::max(); }
 
 private:
-  std::vector<std::size_t> d_dof_indices;
+  std::size_t d_dof_interval_start;
+  std::size_t d_num_components;
 };
 
 /** @brief Stores and returns the local dof-maps for all macro primitives. */
@@ -74,14 +124,18 @@ public:
 
   const LocalVertexDofMap &get_local_dof_map(const Vertex &e) const;
 
+  /*! @returns True if dofs were assigned to the vertex on this rank. */
+  bool has_local_dof_map(const Vertex &v) const;
+
   /*! @brief Creates the dof-map.
    *
    * @param comm    The communicator.
    * @param graph   The graph storage
    * @param num_components  The number of components which we want to calculate.
    * @param degree          The degree of the FE-shape functions.
-   * @param global          If global is true, the dofs are distributed to all macro-edges,
+   * @param global          If global is true, the dofs are numbered globally,
    *                        starting with the edges assigned to rank 0, then rank 1 and so on.
+   *                        Every rank only stores the dof maps of its own and of its ghost edges.
    *                        If global is false, then the dofs are only distributed to the macro-edges
    *                        which belong to the calling rank.
    *                        The first approach is useful if you want to assemble a global matrix with e.g. petsc.
@@ -100,8 +154,9 @@ public:
    * @param num_components   The number of components which we want to calculate.
    * @param degree           The degree of the FE-shape functions.
    * @param start_dof_offset The start offset in the dof mapping.
-   * @param global           If global is true, the dofs are distributed to all macro-edges,
+   * @param global           If global is true, the dofs are numbered globally,
    *                         starting with the edges assigned to rank 0, then rank 1 and so on.
+   *                         Every rank only stores the dof maps of its own and of its ghost edges.
    *                         If global is false, then the dofs are only distributed to the macro-edges
    *                         which belong to the calling rank.
    *                         The first approach is useful if you want to assemble a global matrix with e.g. petsc.
@@ -122,6 +177,20 @@ public:
               bool global,
               const std::function<size_t(const Vertex &)> &num_vertex_dofs);
 
+  /*! @brief Creates the dof-map with an own degree for every edge.
+   *
+   * @param comm            The communicator.
+   * @param graph           The graph storage
+   * @param num_components  The number of components which we want to calculate.
+   * @param edge_degrees    The degrees of the FE-shape functions indexed by the edge id, which have to be the same on all ranks.
+   * @param global          See the create overload with a single degree.
+   */
+  void create(MPI_Comm comm,
+              const GraphStorage &graph,
+              std::size_t num_components,
+              const std::vector<std::size_t> &edge_degrees,
+              bool global);
+
   static void create(MPI_Comm comm,
                      const std::vector<std::shared_ptr<GraphStorage>> &graphs,
                      const std::vector<std::shared_ptr<DofMap>> &dof_maps,
@@ -129,16 +198,30 @@ public:
                      std::size_t degree,
                      const std::function<size_t(const GraphStorage &, const Vertex &)> &num_vertex_dofs);
 
+  /*! @brief Creates the dof-maps for the transport of num_species independent species,
+   *         which are stored as the components of the edges and get their own dofs on the 0D-vertices.
+   */
   static void create_for_transport(MPI_Comm comm,
                                    const std::vector<std::shared_ptr<GraphStorage>> &graphs,
                                    const std::vector<std::shared_ptr<DofMap>> &dof_maps,
-                                   std::size_t degree);
+                                   std::size_t degree,
+                                   std::size_t num_species = 1);
 
   static void create_on_vertices(MPI_Comm comm,
                                  const std::vector<std::shared_ptr<GraphStorage>> &graphs,
                                  const std::vector<std::shared_ptr<DofMap>> &dof_maps,
                                  const std::function<size_t(const GraphStorage &, const Vertex &)> &num_vertex_dofs);
 
+  /*! @brief Renumbers only the dofs of the 0D models of the flow after the boundary conditions of the vertices were changed,
+   *         e.g. after a windkessel was replaced by a vessel tree. The dofs of the edges keep their indices.
+   *
+   *  This is only possible for the local dofs, i.e. for dof maps created with global set to false,
+   *  since the vertex dofs of a rank are numbered after its edge dofs.
+   *
+   * @returns The previous dof maps of the vertices indexed by the vertex id, which are uninitialized for vertices without dofs.
+   */
+  std::vector<LocalVertexDofMap> renumber_vertex_dofs(MPI_Comm comm, const GraphStorage &graph);
+
   /*! @brief Returns the first global dof index in this dof map.
    *         If no global distribution is used the first local index (0) is returned. */
   size_t first_global_dof() const;
@@ -159,10 +242,15 @@ public:
 
   size_t num_owned_dofs() const;
 
+  /*! @brief Returns the memory of the local dof maps, which have an entry for every edge and vertex of the graph. */
+  MemoryReport memory_report() const;
+
 private:
-  std::vector<std::unique_ptr<LocalEdgeDofMap>> d_local_dof_maps;
+  /*! @brief The local dof maps indexed by the edge id. */
+  std::vector<LocalEdgeDofMap> d_local_dof_maps;
 
-  std::vector<std::unique_ptr<LocalVertexDofMap>> d_local_vertex_dof_maps;
+  /*! @brief The local dof maps indexed by the vertex id. */
+  std::vector<LocalVertexDofMap> d_local_vertex_dof_maps;
 
   std::size_t d_first_global_dof;
   std::size_t d_num_dof;
@@ -171,7 +259,23 @@ private:
   size_t d_num_owned_dofs;
 
 private:
-  void create(MPI_Comm comm, const std::vector<GraphStorage> &graphs, const std::vector<DofMap> &dof_maps, size_t num_components, size_t degree, bool global, const std::function<size_t(const Vertex &)> &num_vertex_dofs);
+  /*! @brief Numbers the dofs of all the given graphs in a single distributed pass.
+   *
+   * Every rank numbers only the primitives it owns, first the edges and then the leaves of each graph.
+   * The degree of an edge has to be known on all the ranks, since the ghost edges only receive their first dof from their owners.
+   * If global is true, the offset of a rank is the number of dofs on all the lower ranks, which is given by an exclusive scan,
+   * and afterwards the dof maps of the ghost edges are received from their owners.
+   * Hence no rank has to walk over the primitives of the whole graph.
+   */
+  static void distribute(MPI_Comm comm,
+                         const std::vector<const GraphStorage *> &graphs,
+                         const std::vector<DofMap *> &dof_maps,
+                         std::size_t num_components,
+                         const std::function<size_t(const GraphStorage &, const Edge &)> &edge_degree,
+                         bool with_edges,
+                         std::size_t start_dof_offset,
+                         bool global,
+                         const std::function<size_t(const GraphStorage &, const Vertex &)> &num_vertex_dofs);
 
   void add_local_dof_map(const Edge &e,
                          std::size_t num_components,
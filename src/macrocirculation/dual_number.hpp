@@ -0,0 +1,124 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_DUAL_NUMBER_HPP
+#define TUMORMODELS_DUAL_NUMBER_HPP
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+namespace macrocirculation {
+
+/*! @brief A dual number for forward mode sensitivities, which carries a value and its derivatives in N tangent directions.
+ *         The vessel formulas are templated on the scalar type of their parameters,
+ *         hence seeding e.g. the elastic modulus and the radius of some vessels yields all their sensitivities in a single evaluation.
+ *         The comparisons only use the value, such that the branches and stopping criteria are the same as for double.
+ */
+template<std::size_t N>
+struct Dual {
+  Dual() = default;
+
+  // NOLINTNEXTLINE(google-explicit-constructor): constants are promoted implicitly, as for double
+  Dual(double value)
+      : value(value), tangent{} {}
+
+  /*! @brief Seeds the given tangent direction, i.e. the derivative of the variable with respect to itself is one. */
+  Dual(double value, std::size_t direction)
+      : value(value), tangent{} { tangent[direction] = 1.; }
+
+  double value{};
+  std::array<double, N> tangent{};
+
+  Dual &operator+=(const Dual &b) {
+    value += b.value;
+    for (std::size_t k = 0; k < N; k += 1)
+      tangent[k] += b.tangent[k];
+    return *this;
+  }
+
+  Dual &operator-=(const Dual &b) {
+    value -= b.value;
+    for (std::size_t k = 0; k < N; k += 1)
+      tangent[k] -= b.tangent[k];
+    return *this;
+  }
+
+  Dual &operator*=(const Dual &b) { return *this = *this * b; }
+
+  Dual &operator/=(const Dual &b) { return *this = *this / b; }
+
+  friend Dual operator+(const Dual &a) { return a; }
+  friend Dual operator-(const Dual &a) { return scale(a, -a.value, -1.); }
+
+  friend Dual operator+(Dual a, const Dual &b) { return a += b; }
+  friend Dual operator+(Dual a, double b) { return a.value += b, a; }
+  friend Dual operator+(double a, Dual b) { return b.value += a, b; }
+
+  friend Dual operator-(Dual a, const Dual &b) { return a -= b; }
+  friend Dual operator-(Dual a, double b) { return a.value -= b, a; }
+  friend Dual operator-(double a, const Dual &b) { return scale(b, a - b.value, -1.); }
+
+  friend Dual operator*(const Dual &a, const Dual &b) {
+    Dual r(a.value * b.value);
+    for (std::size_t k = 0; k < N; k += 1)
+      r.tangent[k] = a.tangent[k] * b.value + a.value * b.tangent[k];
+    return r;
+  }
+  friend Dual operator*(const Dual &a, double b) { return scale(a, a.value * b, b); }
+  friend Dual operator*(double a, const Dual &b) { return scale(b, a * b.value, a); }
+
+  friend Dual operator/(const Dual &a, const Dual &b) {
+    Dual r(a.value / b.value);
+    for (std::size_t k = 0; k < N; k += 1)
+      r.tangent[k] = (a.tangent[k] - r.value * b.tangent[k]) / b.value;
+    return r;
+  }
+  friend Dual operator/(const Dual &a, double b) { return scale(a, a.value / b, 1. / b); }
+  friend Dual operator/(double a, const Dual &b) { return scale(b, a / b.value, -a / (b.value * b.value)); }
+
+  friend bool operator<(const Dual &a, const Dual &b) { return a.value < b.value; }
+  friend bool operator>(const Dual &a, const Dual &b) { return a.value > b.value; }
+  friend bool operator<=(const Dual &a, const Dual &b) { return a.value <= b.value; }
+  friend bool operator>=(const Dual &a, const Dual &b) { return a.value >= b.value; }
+  friend bool operator==(const Dual &a, const Dual &b) { return a.value == b.value; }
+  friend bool operator!=(const Dual &a, const Dual &b) { return a.value != b.value; }
+
+  friend Dual sqrt(const Dual &a) {
+    const double s = std::sqrt(a.value);
+    return scale(a, s, 0.5 / s);
+  }
+
+  friend Dual pow(const Dual &a, double b) { return scale(a, std::pow(a.value, b), b * std::pow(a.value, b - 1)); }
+
+  friend Dual exp(const Dual &a) {
+    const double e = std::exp(a.value);
+    return scale(a, e, e);
+  }
+
+  friend Dual log(const Dual &a) { return scale(a, std::log(a.value), 1. / a.value); }
+
+  friend Dual abs(const Dual &a) { return a.value < 0 ? -a : a; }
+
+  /*! @brief The chain rule for a function with value f and derivative df at a. */
+  static Dual scale(const Dual &a, double f, double df) {
+    Dual r(f);
+    for (std::size_t k = 0; k < N; k += 1)
+      r.tangent[k] = df * a.tangent[k];
+    return r;
+  }
+};
+
+/*! @brief The value without the sensitivities, e.g. for stopping criteria. */
+inline double value_of(double a) { return a; }
+
+template<std::size_t N>
+inline double value_of(const Dual<N> &a) { return a.value; }
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_DUAL_NUMBER_HPP
@@ -7,75 +7,142 @@
 
 #include "edge_boundary_evaluator.hpp"
 
+#include <algorithm>
 #include <cmath>
+#include <stdexcept>
 
 #include "communication/mpi.hpp"
 #include "dof_map.hpp"
 #include "fe_type.hpp"
 #include "graph_storage.hpp"
+#include "phase_timers.hpp"
+#include "thread_pool.hpp"
 
 namespace macrocirculation {
 
 EdgeBoundaryEvaluator::EdgeBoundaryEvaluator(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, std::shared_ptr<DofMap> dof_map, size_t component)
+    : EdgeBoundaryEvaluator(comm, std::move(graph), std::vector<EdgeBoundaryField>{{std::move(dof_map), component}}) {}
+
+EdgeBoundaryEvaluator::EdgeBoundaryEvaluator(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, std::vector<EdgeBoundaryField> fields)
     : d_comm(comm),
       d_graph(std::move(graph)),
-      d_dof_map(std::move(dof_map)),
-      d_component(component),
-      d_edge_boundary_communicator(Communicator::create_edge_boundary_value_communicator(comm, d_graph)),
-      d_macro_edge_boundary_value(2 * d_graph->num_edges(), NAN) {}
+      d_fields(std::move(fields)),
+      d_local_edges(std::make_shared<LocalEdgeIndex>(*d_graph, mpi::rank(comm))),
+      d_active_edge_ids(d_graph->get_active_edge_ids(mpi::rank(comm))),
+      d_edge_boundary_communicator(Communicator::create_edge_boundary_value_communicator(comm, d_graph, d_local_edges, d_fields.size())),
+      d_macro_edge_boundary_value(2 * d_fields.size() * d_local_edges->num_slots(), NAN) {
+  if (d_fields.empty())
+    throw std::runtime_error("EdgeBoundaryEvaluator needs at least one field");
+}
 
 void EdgeBoundaryEvaluator::init(const std::vector<double> &u_prev) {
-  evaluate_macro_edge_boundary_values(u_prev);
-  d_edge_boundary_communicator.update_ghost_layer(d_macro_edge_boundary_value);
+  start_init(u_prev);
+  finish_init();
+}
+
+void EdgeBoundaryEvaluator::start_init(const std::vector<double> &u_prev) {
+  start_init(std::vector<const std::vector<double> *>(d_fields.size(), &u_prev));
+}
+
+void EdgeBoundaryEvaluator::start_init(const std::vector<const std::vector<double> *> &u_prev_per_field) {
+  if (u_prev_per_field.size() != d_fields.size())
+    throw std::runtime_error("EdgeBoundaryEvaluator needs one vector for every field");
+  evaluate_macro_edge_boundary_values(u_prev_per_field);
+  d_edge_boundary_communicator.start_ghost_layer_update(d_macro_edge_boundary_value);
+}
+
+void EdgeBoundaryEvaluator::finish_init() {
+  d_edge_boundary_communicator.finish_ghost_layer_update(d_macro_edge_boundary_value);
 }
 
-template<typename VectorType>
-void EdgeBoundaryEvaluator::evaluate_macro_edge_boundary_values(const VectorType &u_prev) {
-  std::vector<std::size_t> dof_indices(4, 0);
-  std::vector<double> local_dofs(4, 0);
+void EdgeBoundaryEvaluator::progress_init(std::vector<std::size_t> &arrived) {
+  d_edge_boundary_communicator.progress_ghost_layer_update(d_macro_edge_boundary_value, arrived);
+}
 
+void EdgeBoundaryEvaluator::evaluate_macro_edge_boundary_values(const std::vector<const std::vector<double> *> &u_prev_per_field) {
+  SCOPED_PHASE_TIMER("boundary evaluation");
   // as a precaution we fill the boundary value vector with NANs.
   std::fill(d_macro_edge_boundary_value.begin(), d_macro_edge_boundary_value.end(), NAN);
 
-  for (const auto &e_id : d_graph->get_active_edge_ids(mpi::rank(d_comm))) {
-    const auto edge = d_graph->get_edge(e_id);
-    const auto &param = edge->get_physical_data();
-    const auto &local_dof_map = d_dof_map->get_local_dof_map(*edge);
-    const double h = param.length / static_cast<double>(local_dof_map.num_micro_edges());
+  // the legendre polynomials at the left and right boundary, as in FETypeNetwork::evaluate_dof_at_boundary_points
+  constexpr auto phi_left = evaluate_legendre(-1.);
+  constexpr auto phi_right = evaluate_legendre(+1.);
+
+  // every edge writes only its own entries, hence the edges can be split among the threads
+  parallel_for(d_thread_pool.get(), d_active_edge_ids.size(), [&](std::size_t, std::size_t begin, std::size_t end) {
+    for (std::size_t k = begin; k < end; k += 1) {
+      const auto edge_id = d_active_edge_ids[k];
+      const auto &edge = d_graph->edge(edge_id);
+
+      for (std::size_t field = 0; field < d_fields.size(); field += 1) {
+        const auto &u_prev = *u_prev_per_field[field];
+        const std::size_t component = d_fields[field].component;
+        const auto &local_dof_map = d_fields[field].dof_map->get_local_dof_map(edge);
+        const std::size_t num_basis_functions = local_dof_map.num_basis_functions();
+
+        const double *left_dofs = local_dof_map.dof_values(u_prev, 0, component);
+        double left = 0;
+        for (std::size_t i = 0; i < num_basis_functions; i += 1)
+          left += phi_left[i] * left_dofs[i];
+        d_macro_edge_boundary_value[value_index(edge_id, 0, field)] = left;
+
+        const double *right_dofs = local_dof_map.dof_values(u_prev, local_dof_map.num_micro_edges() - 1, component);
+        double right = 0;
+        for (std::size_t i = 0; i < num_basis_functions; i += 1)
+          right += phi_right[i] * right_dofs[i];
+        d_macro_edge_boundary_value[value_index(edge_id, 1, field)] = right;
+      }
+    }
+  });
+}
 
-    FETypeNetwork fe(create_midpoint_rule(), local_dof_map.num_basis_functions() - 1);
-    fe.reinit(h);
+void EdgeBoundaryEvaluator::set_thread_pool(std::shared_ptr<ThreadPool> pool) {
+  d_thread_pool = std::move(pool);
+}
 
-    dof_indices.resize(local_dof_map.num_basis_functions());
-    local_dofs.resize(local_dof_map.num_basis_functions());
+void EdgeBoundaryEvaluator::reinit() {
+  d_local_edges = std::make_shared<LocalEdgeIndex>(*d_graph, mpi::rank(d_comm));
+  d_active_edge_ids = d_graph->get_active_edge_ids(mpi::rank(d_comm));
+  d_edge_boundary_communicator = Communicator::create_edge_boundary_value_communicator(d_comm, d_graph, d_local_edges, d_fields.size());
+  // the ghost layer might have grown or shrunk
+  d_macro_edge_boundary_value.assign(2 * d_fields.size() * d_local_edges->num_slots(), NAN);
+  d_macro_edge_boundary_value.shrink_to_fit();
+}
 
-    local_dof_map.dof_indices(0, d_component, dof_indices);
-    extract_dof(dof_indices, u_prev, local_dofs);
-    d_macro_edge_boundary_value[2 * edge->get_id()] = fe.evaluate_dof_at_boundary_points(local_dofs).left;
+void EdgeBoundaryEvaluator::set_fields(std::vector<EdgeBoundaryField> fields) {
+  if (fields.empty())
+    throw std::runtime_error("EdgeBoundaryEvaluator needs at least one field");
+  d_fields = std::move(fields);
+  d_edge_boundary_communicator = Communicator::create_edge_boundary_value_communicator(d_comm, d_graph, d_local_edges, d_fields.size());
+  d_macro_edge_boundary_value.assign(2 * d_fields.size() * d_local_edges->num_slots(), NAN);
+  d_macro_edge_boundary_value.shrink_to_fit();
+}
 
-    local_dof_map.dof_indices(local_dof_map.num_micro_edges() - 1, d_component, dof_indices);
-    extract_dof(dof_indices, u_prev, local_dofs);
-    d_macro_edge_boundary_value[2 * edge->get_id() + 1] = fe.evaluate_dof_at_boundary_points(local_dofs).right;
-  }
+MemoryReport EdgeBoundaryEvaluator::memory_report() const {
+  MemoryReport report;
+  report.add("boundary values", d_macro_edge_boundary_value);
+  report.add("local edge index", d_local_edges->memory_bytes());
+  report.add("active edges", d_active_edge_ids);
+  return report;
 }
 
-void EdgeBoundaryEvaluator::operator()(const Edge &edge, std::vector<double> &values) const {
-  values[0] = d_macro_edge_boundary_value[2 * edge.get_id() + 0];
-  values[1] = d_macro_edge_boundary_value[2 * edge.get_id() + 1];
+void EdgeBoundaryEvaluator::operator()(const Edge &edge, std::vector<double> &values, std::size_t field) const {
+  values[0] = d_macro_edge_boundary_value[value_index(edge.get_id(), 0, field)];
+  values[1] = d_macro_edge_boundary_value[value_index(edge.get_id(), 1, field)];
 }
 
-double EdgeBoundaryEvaluator::operator()(const Vertex &vertex, const Edge &edge) const {
+double EdgeBoundaryEvaluator::operator()(const Vertex &vertex, const Edge &edge, std::size_t field) const {
   if (edge.is_pointing_to(vertex.get_id()))
-    return d_macro_edge_boundary_value[2 * edge.get_id() + 1];
+    return d_macro_edge_boundary_value[value_index(edge.get_id(), 1, field)];
   else
-    return d_macro_edge_boundary_value[2 * edge.get_id() + 0];
+    return d_macro_edge_boundary_value[value_index(edge.get_id(), 0, field)];
 }
 
-void EdgeBoundaryEvaluator::operator()(const Vertex &vertex, std::vector<double> &values) const {
+void EdgeBoundaryEvaluator::operator()(const Vertex &vertex, std::vector<double> &values, std::size_t field) const {
   values.resize(vertex.get_edge_neighbors().size());
   for (size_t k = 0; k < vertex.get_edge_neighbors().size(); k += 1) {
-    auto &edge = *d_graph->get_edge(vertex.get_edge_neighbors()[k]);
-    values[k] = (*this)(vertex, edge);
+    auto &edge = d_graph->edge(vertex.get_edge_neighbors()[k]);
+    values[k] = (*this)(vertex, edge, field);
   }
 }
 
@@ -13,6 +13,8 @@
 #include <vector>
 
 #include "communicator.hpp"
+#include "local_edge_index.hpp"
+#include "memory_report.hpp"
 
 namespace macrocirculation {
 
@@ -21,29 +23,84 @@ class GraphStorage;
 class DofMap;
 class Vertex;
 class Edge;
+class ThreadPool;
 
-/*!@brief Evaluates a finite element function at the macro edge boundaries
+/*! @brief A component of a finite element function, whose values at the macro edge boundaries are needed. */
+struct EdgeBoundaryField {
+  std::shared_ptr<DofMap> dof_map;
+  std::size_t component;
+};
+
+/*!@brief Evaluates finite element functions at the macro edge boundaries
  *        and communicates the values to all ranks with an adjacent primitive.
+ *
+ *        The values of all the fields are packed into a single message per neighboring rank.
  */
 class EdgeBoundaryEvaluator {
 public:
   EdgeBoundaryEvaluator(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, std::shared_ptr<DofMap> dof_map, size_t component);
 
+  EdgeBoundaryEvaluator(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, std::vector<EdgeBoundaryField> fields);
+
   /*! @brief Evaluates and communicates the values of at the macro edge boundaries. */
   void init(const std::vector<double> &u_prev);
 
-  /*! @brief Returns the boundary value at the given vertex on the given macro edge. */
-  double operator()(const Vertex &vertex, const Edge &edge) const;
+  /*! @brief Evaluates the values at the macro edge boundaries and starts their communication.
+   *         The values of the ghost layer are only available after finish_init was called.
+   */
+  void start_init(const std::vector<double> &u_prev);
+
+  /*! @brief Same as start_init, but the k-th field is evaluated for the k-th vector of the list. */
+  void start_init(const std::vector<const std::vector<double> *> &u_prev_per_field);
+
+  /*! @brief Waits until the values of the ghost layer, which were sent in start_init, have arrived. */
+  void finish_init();
+
+  /*! @brief Writes the values of the ghost layer, which have arrived since the last call, without waiting.
+   *         The indices of the sending neighbors are appended to arrived, see Communicator::progress_ghost_layer_update.
+   */
+  void progress_init(std::vector<std::size_t> &arrived);
+
+  /*! @brief Returns the number of fields, which are evaluated at the boundaries. */
+  std::size_t num_fields() const { return d_fields.size(); }
+
+  /*! @brief Returns the boundary value of the given field at the given vertex on the given macro edge. */
+  double operator()(const Vertex &vertex, const Edge &edge, std::size_t field = 0) const;
+
+  /*! @brief Returns all the boundary values of the given field at the given vertex for all macro edge neighbors. */
+  void operator()(const Vertex &vertex, std::vector<double> &values, std::size_t field = 0) const;
+
+  /*! @brief Returns the two boundary values of the given field at the given macro edge. */
+  void operator()(const Edge &edge, std::vector<double> &values, std::size_t field = 0) const;
 
-  /*! @brief Returns all the boundary values at the given vertex for all macro edge neighbors. */
-  void operator()(const Vertex &vertex, std::vector<double> &values) const;
+  /*! @brief Returns the value of the given field at the left (right = false) or right (right = true) boundary of the given edge. */
+  double get_value(std::size_t edge_id, bool right, std::size_t field) const { return d_macro_edge_boundary_value[value_index(edge_id, right ? 1 : 0, field)]; }
 
-  /*! @brief Returns the two boundary values at the given macro edge. */
-  void operator()(const Edge &edge, std::vector<double> &values) const;
+  /*! @brief Splits the evaluation at the active edges among the threads of the given pool. */
+  void set_thread_pool(std::shared_ptr<ThreadPool> pool);
+
+  /*! @brief Rebuilds the communication of the boundary values, e.g. after the graph was repartitioned. */
+  void reinit();
+
+  /*! @brief Replaces the evaluated fields and rebuilds the communication for their number, while the edge numbering is kept. */
+  void set_fields(std::vector<EdgeBoundaryField> fields);
+
+  /*! @brief Returns the numbering of the edges of our rank and its ghost layer, which the boundary values are stored in. */
+  const LocalEdgeIndex &get_local_edge_index() const { return *d_local_edges; }
+
+  /*! @brief Returns the memory of the boundary values and of the edge numbering. */
+  MemoryReport memory_report() const;
+
+  /*! @brief Returns the communicator of the boundary values, e.g. to measure the communication volume. */
+  const Communicator &get_communicator() const { return d_edge_boundary_communicator; }
+
+  Communicator &get_communicator() { return d_edge_boundary_communicator; }
 
 private:
-  template<typename VectorType>
-  void evaluate_macro_edge_boundary_values(const VectorType &u_prev);
+  void evaluate_macro_edge_boundary_values(const std::vector<const std::vector<double> *> &u_prev_per_field);
+
+  /*! @brief The index of the value of the given field at the left (side = 0) or right (side = 1) boundary of the given edge. */
+  std::size_t value_index(std::size_t edge_id, std::size_t side, std::size_t field) const { return (2 * (*d_local_edges)(edge_id) + side) * d_fields.size() + field; }
 
 private:
   MPI_Comm d_comm;
@@ -51,19 +108,28 @@ private:
   /*! @brief The current domain on which we evaluate the given function. */
   std::shared_ptr<GraphStorage> d_graph;
 
-  /*! @brief The dof map for our domain. */
-  std::shared_ptr<DofMap> d_dof_map;
+  /*! @brief The dof maps and components we want to evaluate at the boundaries. */
+  std::vector<EdgeBoundaryField> d_fields;
 
-  /*! @brief The dof component we want to evaluate at the boundaries. */
-  size_t d_component;
+  /*! @brief The slots of the edges of our rank and its ghost layer inside the boundary values.
+   *         It is shared with the communicator, which packs the values by their slots.
+   */
+  std::shared_ptr<const LocalEdgeIndex> d_local_edges;
+
+  /*! @brief The edges of our rank, whose boundary values we evaluate. */
+  std::vector<std::size_t> d_active_edge_ids;
 
   /*! @brief Communicates the evaluated values to other ranks. */
   Communicator d_edge_boundary_communicator;
 
-  /*! @brief Contains the values of the given component at the left and right boundary point of the given macro-edge.
-    *         For the 2i-th edge the left boundary value is at 2*i, while the right entry is at 2*i+1.
+  /*! @brief Contains the values of all the fields at the left and right boundary point of the local macro-edges.
+    *         The values of all the fields at one boundary point are contiguous, see value_index.
+    *         The edges outside of our ghost layer share the last slot, which holds NANs.
     */
   std::vector<double> d_macro_edge_boundary_value;
+
+  /*! @brief Optional thread pool for the edge loops. */
+  std::shared_ptr<ThreadPool> d_thread_pool;
 };
 
 } // namespace macrocirculation
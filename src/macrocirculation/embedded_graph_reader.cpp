@@ -7,40 +7,90 @@
 
 #include "embedded_graph_reader.hpp"
 #include "graph_storage.hpp"
+#include "phase_timers.hpp"
 #include "vessel_formulas.hpp"
+#include <algorithm>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <nlohmann/json.hpp>
+#include <sstream>
+#include <utility>
 
 namespace macrocirculation {
 
-void EmbeddedGraphReader::append(const std::string &filepath, GraphStorage &graph) const {
-  std::cout << "WARNING: appending graph with avg(r) and artificial E and nu" << std::endl;
+namespace {
 
-  using json = nlohmann::json;
+using json = nlohmann::json;
 
+/*! @brief Parses the json file, but hands every element of the top level arrays to the given function and discards it afterwards.
+ *         Thus, the memory footprint is bounded by the largest element and not by the size of the whole network.
+ */
+void parse_elements(const std::string &filepath, const std::function<void(const std::string &, json &)> &handle_element) {
   std::fstream file(filepath, std::ios::in);
   if (!file.good())
     throw std::runtime_error("file " + filepath + " could not be opened");
 
-  json j;
-  file >> j;
+  // the key of the top level array, whose elements we are currently parsing
+  std::string array_name;
 
-  const std::size_t num_vertices = j["vertices"].size();
+  json::parser_callback_t callback = [&](int depth, json::parse_event_t event, json &parsed) {
+    if (depth == 1 && event == json::parse_event_t::key) {
+      array_name = parsed.get<std::string>();
+    } else if (depth == 2 && event == json::parse_event_t::object_end) {
+      handle_element(array_name, parsed);
+      return false;
+    }
+    return true;
+  };
+
+  // only the scalar entries of the top level object remain
+  const auto remainder = json::parse(file, callback);
+  static_cast<void>(remainder);
+}
+
+void set_outflow_data(const json &vertex, Vertex &v) {
+  if (v.is_leaf()) {
+    if (vertex.contains("peripheral_resistance") || vertex.contains("peripheral_compliance")) {
+      // if (false) {
+      const double r = vertex["peripheral_resistance"];
+      const double c = vertex["peripheral_compliance"];
+      v.set_to_windkessel_outflow(r, c);
+    } else {
+      v.set_to_free_outflow();
+    }
+  }
+}
+
+} // namespace
+
+void EmbeddedGraphReader::append(const std::string &filepath, GraphStorage &graph) const {
+  SCOPED_SETUP_TIMER("read mesh");
+  std::cout << "WARNING: appending graph with avg(r) and artificial E and nu" << std::endl;
 
   const size_t vertex_offset = graph.num_vertices();
 
-  // create the vertices for the given mesh
-  for (std::size_t idx = 0; idx < num_vertices; idx += 1)
-    graph.create_vertex();
+  // the vertices are small, but can only be set up once all their edges are known
+  std::vector<json> vertices;
+
+  // the vessels are collected and then created together with the vertices in a single pass
+  std::vector<EdgeDescription> edges;
+  std::vector<std::pair<std::size_t, std::string>> edge_names;
+  std::size_t num_referenced_vertices = 0;
 
-  // create the edges between the vertices
-  for (auto vessel : j["vessels"]) {
-    size_t left_vertex_id = vertex_offset + vessel["left_vertex_id"].get<size_t>();
-    size_t right_vertex_id = vertex_offset + vessel["right_vertex_id"].get<size_t>();
+  parse_elements(filepath, [&](const std::string &array_name, json &element) {
+    if (array_name == "vertices") {
+      vertices.push_back(std::move(element));
+      return;
+    }
+
+    if (array_name != "vessels")
+      return;
 
-    assert(left_vertex_id < num_vertices + vertex_offset);
-    assert(right_vertex_id < num_vertices + vertex_offset);
+    const auto &vessel = element;
+    const size_t left_vertex_id = vessel["left_vertex_id"];
+    const size_t right_vertex_id = vessel["right_vertex_id"];
+    num_referenced_vertices = std::max(num_referenced_vertices, std::max(left_vertex_id, right_vertex_id) + 1);
 
     size_t num_micro_edges = 0;
     if (vessel.contains("number_edges"))
@@ -50,13 +100,11 @@ void EmbeddedGraphReader::append(const std::string &filepath, GraphStorage &grap
     else
       throw std::runtime_error("cannot infer number of micro edges");
 
-    auto edge = graph.connect(*graph.get_vertex(left_vertex_id), *graph.get_vertex(right_vertex_id), num_micro_edges);
-
+    std::vector<Point> points;
     if (vessel.contains("embedded_coordinates")) {
-      std::vector<Point> points;
-      for (auto p : vessel["embedded_coordinates"])
+      points.reserve(vessel["embedded_coordinates"].size());
+      for (const auto &p : vessel["embedded_coordinates"])
         points.emplace_back(p[0], p[1], p[2]);
-      edge->add_embedding_data({points});
     }
 
     double r_avg = 0;
@@ -71,15 +119,26 @@ void EmbeddedGraphReader::append(const std::string &filepath, GraphStorage &grap
     }
 
     if (vessel.contains("name"))
-      edge->set_name(vessel["name"]);
-
-    edge->add_physical_data(PhysicalData::set_from_data(vessel["elastic_modulus"], vessel["wall_thickness"], d_rho, vessel["gamma"], r_avg, vessel["vessel_length"]));
-  }
-
-  for (auto vertex : j["vertices"]) {
+      edge_names.emplace_back(edges.size(), vessel["name"]);
+
+    edges.push_back({left_vertex_id,
+                     right_vertex_id,
+                     num_micro_edges,
+                     PhysicalData::set_from_data(vessel["elastic_modulus"], vessel["wall_thickness"], d_rho, vessel["gamma"], r_avg, vessel["vessel_length"]),
+                     {std::move(points)}});
+  });
+
+  // the vertices, which are not connected to any vessel, are created as well
+  if (num_referenced_vertices > vertices.size())
+    throw std::runtime_error("vessels are connected to vertices, which do not exist");
+  const auto first_edge_id = graph.create_in_bulk(vertices.size(), std::move(edges));
+  for (const auto &[k, name] : edge_names)
+    graph.edge(first_edge_id + k).set_name(name);
+
+  for (const auto &vertex : vertices) {
     size_t id = vertex["id"];
 
-    auto &v = *graph.get_vertex(id + vertex_offset);
+    auto &v = graph.vertex(id + vertex_offset);
 
     if (!v.is_leaf() && (vertex.contains("peripheral_resistance") || vertex.contains("peripheral_compliance")))
       throw std::runtime_error("malformed network");
@@ -95,51 +154,25 @@ void EmbeddedGraphReader::append(const std::string &filepath, GraphStorage &grap
       v.set_name(name.str());
     }
 
-    if (v.is_leaf()) {
-      if (vertex.contains("peripheral_resistance") || vertex.contains("peripheral_compliance")) {
-        // if (false) {
-        const double r = vertex["peripheral_resistance"];
-        const double c = vertex["peripheral_compliance"];
-        v.set_to_windkessel_outflow(r, c);
-      } else {
-        v.set_to_free_outflow();
-      }
-    }
+    set_outflow_data(vertex, v);
   }
 }
 
 void EmbeddedGraphReader::set_boundary_data(const std::string &filepath, GraphStorage &graph) const {
-  using json = nlohmann::json;
+  parse_elements(filepath, [&](const std::string &array_name, json &vertex) {
+    if (array_name != "vertices")
+      return;
 
-  std::fstream file(filepath, std::ios::in);
-  if (!file.good())
-    throw std::runtime_error("file " + filepath + " could not be opened");
-
-  json j;
-  file >> j;
-
-  for (const auto &vertex : j["vertices"]) {
     if (!vertex.contains("name"))
       throw std::runtime_error("boundary data can only be set for named vertices");
 
     auto &v = *graph.find_vertex_by_name(vertex["name"]);
 
-    if (v.is_leaf()) {
-      if (vertex.contains("peripheral_resistance") || vertex.contains("peripheral_compliance")) {
-        // if (false) {
-        const double r = vertex["peripheral_resistance"];
-        const double c = vertex["peripheral_compliance"];
-        v.set_to_windkessel_outflow(r, c);
-      } else {
-        v.set_to_free_outflow();
-      }
-    }
-  }
+    set_outflow_data(vertex, v);
+  });
 }
 
 std::vector<InputPressuresResults> read_input_pressures(const std::string &filepath) {
-  using json = nlohmann::json;
-
   std::fstream file(filepath, std::ios::in);
   json j;
   file >> j;
@@ -0,0 +1,81 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "ensemble_flow_solver.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "checkpoint.hpp"
+#include "communication/mpi.hpp"
+#include "dof_map.hpp"
+#include "explicit_nonlinear_flow_solver.hpp"
+#include "graph_storage.hpp"
+#include "thread_pool.hpp"
+
+namespace macrocirculation {
+
+EnsembleFlowSolver::EnsembleFlowSolver(MPI_Comm comm, std::vector<std::shared_ptr<GraphStorage>> graphs, std::size_t degree)
+    : d_comm(comm),
+      d_graphs(std::move(graphs)) {
+  if (d_graphs.empty())
+    throw std::runtime_error("an ensemble needs at least one member");
+
+  const auto &graph = *d_graphs.front();
+  d_dof_map = std::make_shared<DofMap>(graph.num_vertices(), graph.num_edges());
+  d_dof_map->create(d_comm, graph, 2, degree, false);
+
+  const auto fingerprint = dof_map_fingerprint(d_comm, graph, *d_dof_map);
+  for (std::size_t k = 0; k < d_graphs.size(); k += 1) {
+    const auto &member_graph = *d_graphs[k];
+    if (member_graph.num_edges() != graph.num_edges() || member_graph.num_vertices() != graph.num_vertices())
+      throw std::runtime_error("ensemble member " + std::to_string(k) + " has a different topology");
+    for (auto e_id : graph.get_edge_ids()) {
+      if (member_graph.edge(e_id).rank() != graph.edge(e_id).rank())
+        throw std::runtime_error("ensemble member " + std::to_string(k) + " has a different partitioning");
+    }
+    if (dof_map_fingerprint(d_comm, member_graph, *d_dof_map) != fingerprint)
+      throw std::runtime_error("ensemble member " + std::to_string(k) + " needs a different dof map");
+
+    d_members.push_back(std::make_unique<ExplicitNonlinearFlowSolver>(d_comm, d_graphs[k], d_dof_map, degree));
+  }
+}
+
+EnsembleFlowSolver::~EnsembleFlowSolver() = default;
+
+std::size_t EnsembleFlowSolver::num_members() const { return d_members.size(); }
+
+ExplicitNonlinearFlowSolver &EnsembleFlowSolver::get_member(std::size_t k) { return *d_members.at(k); }
+
+const ExplicitNonlinearFlowSolver &EnsembleFlowSolver::get_member(std::size_t k) const { return *d_members.at(k); }
+
+const std::shared_ptr<DofMap> &EnsembleFlowSolver::get_dof_map() const { return d_dof_map; }
+
+void EnsembleFlowSolver::for_each_member(const std::function<void(ExplicitNonlinearFlowSolver &)> &fun) {
+  for (auto &member : d_members)
+    fun(*member);
+}
+
+void EnsembleFlowSolver::set_num_threads(std::size_t num_threads) {
+  // the messages of concurrent members could be mixed up, hence we only work concurrently on a single rank
+  if (mpi::size(d_comm) == 1) {
+    d_thread_pool = num_threads > 1 ? std::make_unique<ThreadPool>(num_threads) : nullptr;
+  } else {
+    for (auto &member : d_members)
+      member->set_num_threads(num_threads);
+  }
+}
+
+void EnsembleFlowSolver::solve(double tau, double t) {
+  parallel_for(d_thread_pool.get(), d_members.size(), [&](std::size_t, std::size_t begin, std::size_t end) {
+    for (std::size_t k = begin; k < end; k += 1)
+      d_members[k]->solve(tau, t);
+  });
+}
+
+} // namespace macrocirculation
@@ -0,0 +1,73 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_ENSEMBLE_FLOW_SOLVER_HPP
+#define TUMORMODELS_ENSEMBLE_FLOW_SOLVER_HPP
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mpi.h>
+#include <vector>
+
+namespace macrocirculation {
+
+// forward declarations
+class GraphStorage;
+class DofMap;
+class ExplicitNonlinearFlowSolver;
+class ThreadPool;
+
+/*! @brief Solves the flow for an ensemble of networks, which only differ in their physical and boundary parameters.
+ *
+ *  All the members share a single dof map, hence they need the same topology, discretization, boundary types and partitioning.
+ *  The members are advanced in lockstep. On a single rank they are distributed among the threads, so the throughput
+ *  grows with the number of threads. With several ranks every member exchanges its own messages, and the members are
+ *  advanced one after another, each with the configured number of threads for its edge loops.
+ */
+class EnsembleFlowSolver {
+public:
+  /*! @brief Creates the ensemble from the already partitioned graphs with finalized boundary conditions. */
+  EnsembleFlowSolver(MPI_Comm comm, std::vector<std::shared_ptr<GraphStorage>> graphs, std::size_t degree);
+
+  // we need the destructor in the cpp file, to use unique_ptrs with forward declared classes.
+  ~EnsembleFlowSolver();
+
+  std::size_t num_members() const;
+
+  ExplicitNonlinearFlowSolver &get_member(std::size_t k);
+
+  const ExplicitNonlinearFlowSolver &get_member(std::size_t k) const;
+
+  /*! @brief Returns the dof map shared by all the members. */
+  const std::shared_ptr<DofMap> &get_dof_map() const;
+
+  /*! @brief Configures every member, e.g. to select the time integrator. */
+  void for_each_member(const std::function<void(ExplicitNonlinearFlowSolver &)> &fun);
+
+  /*! @brief Sets the number of threads, which work on the members concurrently on a single rank, or on the edges of every member otherwise. */
+  void set_num_threads(std::size_t num_threads);
+
+  /*! @brief Advances all the members from t by the time step tau. */
+  void solve(double tau, double t);
+
+private:
+  MPI_Comm d_comm;
+
+  std::vector<std::shared_ptr<GraphStorage>> d_graphs;
+
+  std::shared_ptr<DofMap> d_dof_map;
+
+  std::vector<std::unique_ptr<ExplicitNonlinearFlowSolver>> d_members;
+
+  /*! @brief Optional thread pool for working on the members concurrently. */
+  std::unique_ptr<ThreadPool> d_thread_pool;
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_ENSEMBLE_FLOW_SOLVER_HPP
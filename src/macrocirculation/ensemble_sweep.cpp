@@ -0,0 +1,124 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "ensemble_sweep.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#include "ensemble_flow_solver.hpp"
+#include "explicit_nonlinear_flow_solver.hpp"
+#include "graph_partitioner.hpp"
+#include "graph_storage.hpp"
+
+namespace macrocirculation {
+
+namespace {
+
+/*! @brief Applies the factors of the sample to the parameters of the graph, whose boundary conditions are not finalized yet. */
+void scale_parameters(GraphStorage &graph, const std::vector<std::size_t> &outlets, const EnsembleSample &sample) {
+  if (!sample.resistance_factors.empty() && sample.resistance_factors.size() != outlets.size())
+    throw std::runtime_error("the sample has " + std::to_string(sample.resistance_factors.size()) + " resistance factors for " + std::to_string(outlets.size()) + " outlets");
+  if (!sample.compliance_factors.empty() && sample.compliance_factors.size() != outlets.size())
+    throw std::runtime_error("the sample has " + std::to_string(sample.compliance_factors.size()) + " compliance factors for " + std::to_string(outlets.size()) + " outlets");
+
+  for (std::size_t k = 0; k < outlets.size(); k += 1) {
+    auto &v = graph.vertex(outlets[k]);
+    const auto data = v.get_peripheral_vessel_data();
+    const double r = sample.resistance_factors.empty() ? 1 : sample.resistance_factors[k];
+    const double c = sample.compliance_factors.empty() ? 1 : sample.compliance_factors[k];
+    v.set_to_windkessel_outflow(r * data.resistance, c * data.compliance);
+    v.update_vessel_tip_pressures(data.p_out);
+  }
+
+  // the static pressure G0 is proportional to the elastic modulus
+  if (sample.elasticity_factor != 1) {
+    for (auto e_id : graph.get_edge_ids()) {
+      auto &edge = graph.edge(e_id);
+      auto data = edge.get_physical_data();
+      data.elastic_modulus *= sample.elasticity_factor;
+      data.G0 *= sample.elasticity_factor;
+      edge.add_physical_data(data);
+    }
+  }
+}
+
+} // namespace
+
+std::vector<std::size_t> get_windkessel_outlets(const GraphStorage &graph) {
+  std::vector<std::size_t> outlets;
+  for (auto v_id : graph.get_vertex_ids()) {
+    if (graph.vertex(v_id).is_windkessel_outflow())
+      outlets.push_back(v_id);
+  }
+  std::sort(outlets.begin(), outlets.end());
+  return outlets;
+}
+
+EnsembleSweepResult run_ensemble_sweep(MPI_Comm comm,
+                                       const std::function<std::shared_ptr<GraphStorage>()> &create_graph,
+                                       const std::vector<EnsembleSample> &samples,
+                                       const EnsembleSweepSettings &settings) {
+  if (settings.batch_size == 0 || settings.output_interval == 0)
+    throw std::runtime_error("the batch size and the output interval of a sweep have to be positive");
+
+  EnsembleSweepResult result;
+  result.outlet_vertex_ids = get_windkessel_outlets(*create_graph());
+
+  const auto num_steps = static_cast<std::size_t>(std::llround(settings.t_end / settings.tau));
+  for (std::size_t step = settings.output_interval; step <= num_steps; step += settings.output_interval)
+    result.times.push_back(static_cast<double>(step) * settings.tau);
+
+  const std::size_t num_values = samples.size() * result.times.size() * result.outlet_vertex_ids.size();
+  result.flows.resize(num_values);
+  result.pressures.resize(num_values);
+
+  for (std::size_t first = 0; first < samples.size(); first += settings.batch_size) {
+    const std::size_t last = std::min(first + settings.batch_size, samples.size());
+
+    std::vector<std::shared_ptr<GraphStorage>> graphs;
+    for (std::size_t s = first; s < last; s += 1) {
+      auto graph = create_graph();
+      if (get_windkessel_outlets(*graph) != result.outlet_vertex_ids)
+        throw std::runtime_error("create_graph returned networks with different outlets");
+      scale_parameters(*graph, result.outlet_vertex_ids, samples[s]);
+      graph->finalize_bcs();
+      naive_mesh_partitioner(*graph, comm);
+      graphs.push_back(graph);
+    }
+
+    EnsembleFlowSolver ensemble(comm, graphs, settings.degree);
+    ensemble.for_each_member([](auto &member) { member.use_ssp_method(); });
+    ensemble.set_num_threads(settings.num_threads);
+
+    double t = 0;
+    std::size_t time_index = 0;
+    for (std::size_t step = 1; step <= num_steps; step += 1) {
+      ensemble.solve(settings.tau, t);
+      t += settings.tau;
+
+      if (step % settings.output_interval != 0)
+        continue;
+
+      for (std::size_t s = first; s < last; s += 1) {
+        const auto &member = ensemble.get_member(s - first);
+        for (std::size_t o = 0; o < result.outlet_vertex_ids.size(); o += 1) {
+          const auto values = member.get_0D_values(graphs[s - first]->vertex(result.outlet_vertex_ids[o]));
+          result.flows[result.index(s, time_index, o)] = values.q;
+          result.pressures[result.index(s, time_index, o)] = values.p_c;
+        }
+      }
+      time_index += 1;
+    }
+  }
+
+  return result;
+}
+
+} // namespace macrocirculation
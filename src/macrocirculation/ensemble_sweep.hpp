@@ -0,0 +1,90 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_ENSEMBLE_SWEEP_HPP
+#define TUMORMODELS_ENSEMBLE_SWEEP_HPP
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mpi.h>
+#include <vector>
+
+namespace macrocirculation {
+
+// forward declarations
+class GraphStorage;
+
+/*! @brief The parameters of a single sample of a sweep, given as factors of the parameters of the network. */
+struct EnsembleSample {
+  /*! @brief The factors of the resistances of the windkessel outlets in the order of get_windkessel_outlets, or empty to keep them. */
+  std::vector<double> resistance_factors;
+
+  /*! @brief The factors of the compliances of the windkessel outlets in the order of get_windkessel_outlets, or empty to keep them. */
+  std::vector<double> compliance_factors;
+
+  /*! @brief The factor of the elastic moduli of all the vessels. */
+  double elasticity_factor{1};
+};
+
+struct EnsembleSweepSettings {
+  std::size_t degree{2};
+
+  double tau{1e-4};
+
+  double t_end{1};
+
+  /*! @brief The number of time steps between the recorded outlet values. */
+  std::size_t output_interval{10};
+
+  /*! @brief The number of samples, which are solved together in an ensemble, such that the memory stays bounded. */
+  std::size_t batch_size{16};
+
+  /*! @brief The number of threads of the ensemble, see EnsembleFlowSolver::set_num_threads. */
+  std::size_t num_threads{1};
+};
+
+/*! @brief The flows and pressures at the windkessel outlets of all the samples.
+ *
+ *  The values are stored row major with the shape (samples, times, outlets), such that e.g. numpy arrays can be wrapped around them without a copy.
+ */
+struct EnsembleSweepResult {
+  std::vector<double> times;
+
+  std::vector<std::size_t> outlet_vertex_ids;
+
+  /*! @brief The flows q out of the vessels into the windkessel models. */
+  std::vector<double> flows;
+
+  /*! @brief The pressures p_c of the windkessel models. */
+  std::vector<double> pressures;
+
+  std::size_t index(std::size_t sample, std::size_t time, std::size_t outlet) const {
+    return (sample * times.size() + time) * outlet_vertex_ids.size() + outlet;
+  }
+};
+
+/*! @brief Returns the ids of the vertices with a windkessel outflow in ascending order. */
+std::vector<std::size_t> get_windkessel_outlets(const GraphStorage &graph);
+
+/*! @brief Solves the network for all the samples in a single process and records the values at its windkessel outlets.
+ *
+ *  The samples are solved in batches of EnsembleFlowSolver with the ssp method, such that the process startup and the partitioning
+ *  are not paid per sample, and the caller does not need a loop over the samples.
+ *  Every member gets its own graph from create_graph, which has to return the network without finalized boundary conditions,
+ *  e.g. by copying it from a graph cache instead of parsing the mesh again.
+ *  The sweep scales the parameters, finalizes the boundary conditions and partitions the graph with the naive partitioner.
+ *  The call is collective, and every rank returns the same result.
+ */
+EnsembleSweepResult run_ensemble_sweep(MPI_Comm comm,
+                                       const std::function<std::shared_ptr<GraphStorage>()> &create_graph,
+                                       const std::vector<EnsembleSample> &samples,
+                                       const EnsembleSweepSettings &settings);
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_ENSEMBLE_SWEEP_HPP
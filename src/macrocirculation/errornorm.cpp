@@ -7,10 +7,12 @@
 
 #include "errornorm.hpp"
 
+#include <algorithm>
+#include <cmath>
+
 #include "communication/mpi.hpp"
-#include "dof_map.hpp"
 #include "fe_type.hpp"
-#include "gmm_legacy_facade.hpp"
+#include "graph_storage.hpp"
 
 namespace macrocirculation {
 
@@ -20,50 +22,91 @@ double errornorm(const MPI_Comm comm,
                  std::size_t component,
                  const std::vector<double> &u_h,
                  const EvaluationFunction &u) {
-  double local_sum = 0;
+  const ErrornormEvaluator evaluator(comm, graph, map);
+  return evaluator.evaluate(u_h, {{component, u}})[0].l2;
+}
 
+ErrornormEvaluator::ErrornormEvaluator(MPI_Comm comm, const GraphStorage &graph, const DofMap &map)
+    : d_comm(comm),
+      d_num_edges(graph.num_edges()) {
   const auto qf = create_gauss4();
 
   for (auto e_id : graph.get_active_edge_ids(mpi::rank(comm))) {
-    auto edge = graph.get_edge(e_id);
+    auto &edge = graph.edge(e_id);
 
-    auto &local_dof_map = map.get_local_dof_map(*edge);
+    auto &local_dof_map = map.get_local_dof_map(edge);
 
     const auto degree = local_dof_map.num_basis_functions() - 1;
 
     FETypeNetwork fe(qf, degree);
     QuadraturePointMapper qpm(qf);
 
-    std::vector<std::size_t> dof_indices(local_dof_map.num_basis_functions());
-    std::vector<double> u_h_local(local_dof_map.num_basis_functions());
-    std::vector<double> u_h_qp(qf.size());
-    std::vector<double> u_qp(qf.size());
-    std::vector<double> diff_qp(qf.size());
+    // the basis functions at the quadrature points only depend on the degree
+    if (d_phi.size() <= degree)
+      d_phi.resize(degree + 1);
+    d_phi[degree] = fe.get_phi();
 
-    const auto &param = edge->get_physical_data();
+    const auto &param = edge.get_physical_data();
     const double h = param.length / local_dof_map.num_micro_edges();
 
     fe.reinit(h);
 
+    EdgeEntry entry{e_id, local_dof_map, degree, {}, {fe.get_JxW().begin(), fe.get_JxW().begin() + static_cast<std::ptrdiff_t>(qf.size())}};
+    entry.quadrature_points.reserve(local_dof_map.num_micro_edges() * qf.size());
     for (std::size_t micro_edge_id = 0; micro_edge_id < local_dof_map.num_micro_edges(); micro_edge_id += 1) {
       qpm.reinit(micro_edge_id * h, static_cast<double>(micro_edge_id + 1) * h);
-
-      local_dof_map.dof_indices(micro_edge_id, component, dof_indices);
-      extract_dof(dof_indices, u_h, u_h_local);
-      fe.evaluate_dof_at_quadrature_points(u_h_local, u_h_qp);
-      u(qpm.get_quadrature_points(), u_qp);
-      gmm::add(u_h_qp, gmm::scaled(u_qp, -1), diff_qp);
-
-      for (std::size_t qp = 0; qp < qf.size(); qp += 1)
-        local_sum += std::pow(diff_qp[qp], 2) * fe.get_JxW()[qp];
+      const auto &points = qpm.get_quadrature_points();
+      entry.quadrature_points.insert(entry.quadrature_points.end(), points.begin(), points.end());
     }
+    d_edges.push_back(std::move(entry));
   }
+}
 
-  double global_sum = 0;
+std::vector<Errornorms> ErrornormEvaluator::evaluate(const std::vector<double> &u_h, const std::vector<ErrornormField> &fields) const {
+  // the l1 and l2 integrals of all the fields over every edge are reduced together, as are their maxima
+  const std::size_t num_sums = 2 * fields.size();
+  std::vector<double> edge_sums(num_sums * d_num_edges, 0.);
+  std::vector<double> local_max(fields.size(), 0.);
+
+  std::vector<double> u_qp;
+
+  for (const auto &entry : d_edges) {
+    const auto &phi = d_phi[entry.fe_index];
+    const auto num_basis_functions = entry.local_dof_map.num_basis_functions();
+    const auto num_qp = entry.JxW.size();
+    u_qp.resize(entry.quadrature_points.size());
+    double *local_sums = &edge_sums[num_sums * entry.edge_id];
+
+    for (std::size_t field_idx = 0; field_idx < fields.size(); field_idx += 1) {
+      const auto &field = fields[field_idx];
+
+      // the exact solution is evaluated for the whole edge at once
+      field.u(entry.quadrature_points, u_qp);
+
+      for (std::size_t micro_edge_id = 0; micro_edge_id < entry.local_dof_map.num_micro_edges(); micro_edge_id += 1) {
+        const double *u_h_local = entry.local_dof_map.dof_values(u_h, micro_edge_id, field.component);
+
+        for (std::size_t qp = 0; qp < num_qp; qp += 1) {
+          double u_h_qp = 0;
+          for (std::size_t i = 0; i < num_basis_functions; i += 1)
+            u_h_qp += phi[i][qp] * u_h_local[i];
+
+          const double diff = u_h_qp - u_qp[micro_edge_id * num_qp + qp];
+          local_sums[2 * field_idx] += std::abs(diff) * entry.JxW[qp];
+          local_sums[2 * field_idx + 1] += std::pow(diff, 2) * entry.JxW[qp];
+          local_max[field_idx] = std::max(local_max[field_idx], std::abs(diff));
+        }
+      }
+    }
+  }
 
-  CHECK_MPI_SUCCESS(MPI_Allreduce(&local_sum, &global_sum, 1, MPI_DOUBLE, MPI_SUM, comm));
+  const auto sums = mpi::ordered_sum(d_comm, edge_sums, num_sums);
+  CHECK_MPI_SUCCESS(MPI_Allreduce(MPI_IN_PLACE, local_max.data(), static_cast<int>(local_max.size()), MPI_DOUBLE, MPI_MAX, d_comm));
 
-  return std::sqrt(global_sum);
+  std::vector<Errornorms> errors;
+  for (std::size_t field_idx = 0; field_idx < fields.size(); field_idx += 1)
+    errors.push_back({sums[2 * field_idx], std::sqrt(sums[2 * field_idx + 1]), local_max[field_idx]});
+  return errors;
 }
 
 } // namespace macrocirculation
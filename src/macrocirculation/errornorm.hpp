@@ -12,14 +12,16 @@
 #include <mpi.h>
 #include <vector>
 
+#include "dof_map.hpp"
+#include "fe_type.hpp"
+
 namespace macrocirculation {
 
-// forward declarations
 class GraphStorage;
-class DofMap;
 class FETypeNetwork;
 class Point;
 
+/*! @brief Evaluates a function at the given edge coordinates, which are in [0, length]. */
 using EvaluationFunction = std::function<void(const std::vector<double> &, std::vector<double> &)>;
 
 double errornorm(const MPI_Comm comm,
@@ -29,6 +31,62 @@ double errornorm(const MPI_Comm comm,
                  const std::vector<double> &u_h,
                  const EvaluationFunction &u);
 
+/*! @brief A component of the discrete solution together with its exact solution. */
+struct ErrornormField {
+  std::size_t component;
+  EvaluationFunction u;
+};
+
+/*! @brief The errors of a single field, where the L1 and L2 norm are integrated with the quadrature,
+ *         while the Linf norm is the maximum over the quadrature points.
+ */
+struct Errornorms {
+  double l1;
+  double l2;
+  double linf;
+};
+
+/*! @brief Evaluates the errors of several fields in all the norms with a single sweep over the edges.
+ *
+ *  The quadrature points, the basis functions and the weights of every active edge are tabulated on construction,
+ *  such that repeated evaluations, e.g. in a convergence study, only evaluate the exact solutions and the sums.
+ *  The exact solution is evaluated once per edge for all the quadrature points of its micro edges,
+ *  and the local errors of all the fields are gathered with one reduction per kind of norm.
+ *  The integrals are summed edge by edge in the order of the edge ids, such that the norms do not depend on the number of ranks.
+ */
+class ErrornormEvaluator {
+public:
+  ErrornormEvaluator(MPI_Comm comm, const GraphStorage &graph, const DofMap &map);
+
+  /*! @brief Returns the errors of the discrete solution u_h for every field, in the order of the fields. */
+  std::vector<Errornorms> evaluate(const std::vector<double> &u_h, const std::vector<ErrornormField> &fields) const;
+
+private:
+  struct EdgeEntry {
+    std::size_t edge_id;
+
+    LocalEdgeDofMap local_dof_map;
+
+    /*! @brief The index of the basis function table of the degree of the edge. */
+    std::size_t fe_index;
+
+    /*! @brief The edge coordinates of the quadrature points of all the micro edges, ordered by micro edge. */
+    std::vector<double> quadrature_points;
+
+    /*! @brief The quadrature weights on a micro edge. */
+    std::vector<double> JxW;
+  };
+
+  MPI_Comm d_comm;
+
+  std::size_t d_num_edges;
+
+  /*! @brief The basis functions at the quadrature points, phi[ <shape-function-index> ][ <quadrature-point-index> ], for every degree in use. */
+  std::vector<FETypeNetwork::ShapeTable> d_phi;
+
+  std::vector<EdgeEntry> d_edges;
+};
+
 } // namespace macrocirculation
 
 #endif //TUMORMODELS_ERRORNORM_H
@@ -7,14 +7,30 @@
 
 #include "explicit_nonlinear_flow_solver.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <utility>
 
+#include "checkpoint.hpp"
 #include "communication/mpi.hpp"
+#include "conservation_monitor.hpp"
 #include "dof_map.hpp"
 #include "fe_type.hpp"
+#include "graph_partitioner.hpp"
 #include "graph_storage.hpp"
+#include "health_monitor.hpp"
+#include "load_balancing.hpp"
+#include "numa.hpp"
+#include "phase_timers.hpp"
 #include "right_hand_side_evaluator.hpp"
+#include "snapshot_history.hpp"
+#include "steady_flow_solver.hpp"
+#include "thread_pool.hpp"
 #include "time_integrators.hpp"
+#include "time_step_levels.hpp"
 #include "vessel_formulas.hpp"
 
 namespace macrocirculation {
@@ -27,7 +43,7 @@ void interpolate_constant(MPI_Comm comm,
                           std::vector<double> &result) {
   std::vector<std::size_t> dof_indices;
   for (const auto &e_id : graph.get_active_edge_ids(mpi::rank(comm))) {
-    const auto edge = graph.get_edge(e_id);
+    const auto *edge = &graph.edge(e_id);
     const auto local_dof_map = dof_map.get_local_dof_map(*edge);
     dof_indices.resize(local_dof_map.num_basis_functions());
     for (std::size_t micro_edge_id = 0; micro_edge_id < local_dof_map.num_micro_edges(); micro_edge_id += 1) {
@@ -40,7 +56,7 @@ void interpolate_constant(MPI_Comm comm,
 void set_to_A0(MPI_Comm comm, const GraphStorage &graph, const DofMap &dof_map, std::vector<double> &result) {
   std::vector<std::size_t> dof_indices;
   for (const auto &e_id : graph.get_active_edge_ids(mpi::rank(comm))) {
-    const auto edge = graph.get_edge(e_id);
+    const auto *edge = &graph.edge(e_id);
     assert(edge->has_physical_data());
     const auto &data = edge->get_physical_data();
     const auto &local_dof_map = dof_map.get_local_dof_map(*edge);
@@ -56,24 +72,22 @@ void set_to_A0(MPI_Comm comm, const GraphStorage &graph, const DofMap &dof_map,
   }
 
   for (const auto &v_id : graph.get_active_vertex_ids(mpi::rank(comm))) {
-    const auto vertex = graph.get_vertex(v_id);
+    const auto *vertex = &graph.vertex(v_id);
 
     if (!vertex->is_windkessel_outflow())
       continue;
 
     assert(vertex->is_leaf());
 
-    const auto edge = graph.get_edge(vertex->get_edge_neighbors()[0]);
+    const auto *edge = &graph.edge(vertex->get_edge_neighbors()[0]);
 
     const auto &vertex_dof_map = dof_map.get_local_dof_map(*vertex);
 
     assert(vertex_dof_map.num_local_dof() == 1);
 
     const auto &data = edge->get_physical_data();
-    const auto &vertex_dof_indices = vertex_dof_map.dof_indices();
-
     // set p
-    result[vertex_dof_indices[0]] = nonlinear::get_p_from_QA(0, data.A0, data);
+    result[vertex_dof_map.first_dof()] = nonlinear::get_p_from_QA(0, data.A0, data);
   }
 }
 
@@ -85,120 +99,594 @@ ExplicitNonlinearFlowSolver::ExplicitNonlinearFlowSolver(MPI_Comm comm,
       d_graph(std::move(graph)),
       d_dof_map(std::move(dof_map)),
       d_degree(degree),
-      d_right_hand_side_evaluator(std::make_shared<RightHandSideEvaluator>(d_comm, d_graph, d_dof_map, d_degree)),
-      d_time_integrator(std::make_unique<TimeIntegrator>(create_explicit_euler(), d_dof_map->num_dof())),
+      d_right_hand_side_evaluator(std::make_shared<RightHandSideEvaluator>(d_comm, d_graph, d_dof_map)),
+      d_time_integrator(std::make_unique<TimeIntegrator>(create_explicit_euler_shu_osher(), d_dof_map->num_dof())),
+      d_health_monitor(std::make_unique<HealthMonitor>(d_comm, d_graph, d_dof_map)),
+      d_conservation_monitor(std::make_unique<ConservationMonitor>(d_comm, d_graph, d_dof_map)),
+      d_snapshot_history(std::make_unique<SnapshotHistory>(d_comm)),
+      d_wave_speed_interval(0),
+      d_wave_speed_step(0),
+      d_warning_cfl(0.9),
+      d_wave_speed_diagnostics{NAN, NAN, NAN, NAN},
+      d_share_upwind_fluxes(false),
       d_u_now(d_dof_map->num_dof()),
       d_u_prev(d_dof_map->num_dof()) {
   // set A constant to A0
   set_to_A0(d_comm, *d_graph, *d_dof_map, d_u_prev);
   set_to_A0(d_comm, *d_graph, *d_dof_map, d_u_now);
+  create_tip_evaluations();
 }
 
 // we need the destructor here, to use unique_ptrs with forward declared classes.
 ExplicitNonlinearFlowSolver::~ExplicitNonlinearFlowSolver() = default;
 
 void ExplicitNonlinearFlowSolver::solve(double tau, double t_prev) {
-  d_u_prev = d_u_now;
+  SCOPED_PHASE_TIMER("solve");
+  // the integrator overwrites the whole target buffer, so swapping is enough
+  std::swap(d_u_prev, d_u_now);
+  // the first stage is always evaluated at the previous solution
+  if (d_share_upwind_fluxes)
+    d_right_hand_side_evaluator->get_flow_upwind_evaluator().retain_fluxes_for(d_u_prev);
+  // a coupled equation, e.g. a transport, is assembled in the edge pass of the first stage
+  if (d_right_hand_side_evaluator->has_coupled_assembly())
+    d_right_hand_side_evaluator->assemble_coupled_for(d_u_prev);
   d_time_integrator->apply(d_u_prev, t_prev, tau, *d_right_hand_side_evaluator, d_u_now);
+  d_health_monitor->step(d_u_now);
+  d_conservation_monitor->step(tau, d_u_now);
+  d_snapshot_history->step(t_prev + tau, d_u_now);
+  monitor_wave_speeds(tau);
+}
+
+double ExplicitNonlinearFlowSolver::calculate_stable_time_step(double cfl) const {
+  if (cfl <= 0)
+    throw std::runtime_error("the cfl number has to be positive");
+
+  double max_speed = 0;
+  double max_speed_per_length = 0;
+  calculate_local_wave_speeds(false, max_speed, max_speed_per_length);
+
+  double global_max_speed_per_length = 0;
+  CHECK_MPI_SUCCESS(MPI_Allreduce(&max_speed_per_length, &global_max_speed_per_length, 1, MPI_DOUBLE, MPI_MAX, d_comm));
+
+  if (!(global_max_speed_per_length > 0))
+    throw std::runtime_error("cannot calculate a stable time step without any characteristic speed");
+
+  return d_time_integrator->get_stable_time_step_factor() * cfl / global_max_speed_per_length;
+}
+
+void ExplicitNonlinearFlowSolver::calculate_local_wave_speeds(bool weight_levels, double &max_speed, double &max_speed_per_length) const {
+  max_speed = 0;
+  max_speed_per_length = 0;
+
+  for (const auto &e_id : d_graph->get_active_edge_ids(mpi::rank(d_comm))) {
+    const auto *edge = &d_graph->edge(e_id);
+    const auto &param = edge->get_physical_data();
+    const auto &local_dof_map = d_dof_map->get_local_dof_map(*edge);
+
+    const std::size_t num_micro_edges = local_dof_map.num_micro_edges();
+    const std::size_t num_basis_functions = local_dof_map.num_basis_functions();
+    const auto lengths = edge->get_micro_edge_lengths();
+    const double c0 = param.get_c0();
+
+    const auto speed = [&](double Q, double A) {
+      return std::abs(Q / A) + c0 * std::pow(A / param.A0, 0.25);
+    };
+
+    double max_edge_speed = 0;
+    double max_speed_per_h = 0;
+    for (std::size_t micro_edge_id = 0; micro_edge_id < num_micro_edges; micro_edge_id += 1) {
+      const double *Q_dofs = local_dof_map.dof_values(d_u_now, micro_edge_id, Q_component);
+      const double *A_dofs = local_dof_map.dof_values(d_u_now, micro_edge_id, A_component);
+
+      // the legendre polynomials are +1 at the right and (-1)^i at the left boundary
+      double Q_left = 0, Q_right = 0, A_left = 0, A_right = 0;
+      for (std::size_t i = 0; i < num_basis_functions; i += 1) {
+        const double sgn = (i % 2 == 0) ? +1. : -1.;
+        Q_left += sgn * Q_dofs[i];
+        A_left += sgn * A_dofs[i];
+        Q_right += Q_dofs[i];
+        A_right += A_dofs[i];
+      }
+
+      const double max_micro_edge_speed = std::max({speed(Q_dofs[0], A_dofs[0]), speed(Q_left, A_left), speed(Q_right, A_right)});
+      max_edge_speed = std::max(max_edge_speed, max_micro_edge_speed);
+      max_speed_per_h = std::max(max_speed_per_h, max_micro_edge_speed / lengths[micro_edge_id]);
+    }
+
+    // higher degrees need smaller time steps
+    const double degree_factor = 2. * static_cast<double>(num_basis_functions - 1) + 1.;
+    // the edges of level l take steps of size 2^l tau
+    const double level_factor = (weight_levels && !d_time_step_levels.empty()) ? static_cast<double>(std::size_t(1) << d_time_step_levels[e_id]) : 1.;
+    max_speed = std::max(max_speed, max_edge_speed);
+    max_speed_per_length = std::max(max_speed_per_length, level_factor * degree_factor * max_speed_per_h);
+  }
+}
+
+double ExplicitNonlinearFlowSolver::solve_adaptive(double tau_max, double &t, double t_stop, double cfl) {
+  if (!(t_stop > t))
+    throw std::runtime_error("the stop time has to lie after the current time");
+
+  double tau = std::min(tau_max, calculate_stable_time_step(cfl));
+
+  const double remaining = t_stop - t;
+  const bool is_last_step = remaining <= tau * (1 + 1e-12);
+  if (is_last_step)
+    tau = remaining;
+  else if (remaining < 2 * tau)
+    // split the remainder into two equal steps, instead of a full and a tiny step
+    tau = 0.5 * remaining;
+
+  solve(tau, t);
+
+  // hit the stop time exactly, without any rounding errors
+  t = is_last_step ? t_stop : t + tau;
+
+  return tau;
+}
+
+void ExplicitNonlinearFlowSolver::set_max_time_step_level(std::size_t max_level) {
+  d_time_step_levels = max_level > 0 ? calculate_time_step_levels(*d_graph, max_level, get_edge_degrees(d_comm, *d_graph, *d_dof_map)) : std::vector<std::size_t>();
+}
+
+void ExplicitNonlinearFlowSolver::set_time_step_levels(std::vector<std::size_t> levels) {
+  if (!levels.empty() && levels.size() != d_graph->num_edges())
+    throw std::runtime_error("every edge needs a time step level");
+  d_time_step_levels = std::move(levels);
+}
+
+const std::vector<std::size_t> &ExplicitNonlinearFlowSolver::get_time_step_levels() const { return d_time_step_levels; }
+
+double ExplicitNonlinearFlowSolver::solve_multirate(double tau, double t) {
+  if (d_time_step_levels.empty()) {
+    solve(tau, t);
+    return tau;
+  }
+
+  SCOPED_PHASE_TIMER("solve");
+
+  const std::size_t max_level = *std::max_element(d_time_step_levels.begin(), d_time_step_levels.end());
+  const std::size_t num_sub_steps = std::size_t(1) << max_level;
+
+  std::vector<bool> is_edge_active(d_graph->num_edges());
+
+  for (std::size_t sub_step = 0; sub_step < num_sub_steps; sub_step += 1) {
+    // the coarse levels start their step first, such that the finer levels see their new values
+    for (std::size_t level = max_level + 1; level-- > 0;) {
+      const std::size_t level_sub_steps = std::size_t(1) << level;
+      if (sub_step % level_sub_steps != 0)
+        continue;
+
+      bool has_edges = false;
+      for (std::size_t e_id = 0; e_id < d_graph->num_edges(); e_id += 1) {
+        is_edge_active[e_id] = (d_time_step_levels[e_id] == level);
+        has_edges = has_edges || is_edge_active[e_id];
+      }
+
+      // the levels are the same on all ranks, hence all the ranks skip together
+      if (!has_edges)
+        continue;
+
+      d_right_hand_side_evaluator->set_active_edges(is_edge_active);
+      std::swap(d_u_prev, d_u_now);
+      d_time_integrator->apply(d_u_prev, t + sub_step * tau, level_sub_steps * tau, *d_right_hand_side_evaluator, d_u_now);
+    }
+  }
+
+  d_right_hand_side_evaluator->set_active_edges({});
+  d_health_monitor->step(d_u_now);
+  d_conservation_monitor->step(num_sub_steps * tau, d_u_now);
+  d_snapshot_history->step(t + num_sub_steps * tau, d_u_now);
+  monitor_wave_speeds(tau);
+
+  return num_sub_steps * tau;
+}
+
+double ExplicitNonlinearFlowSolver::solve_n(std::size_t num_steps, double tau, double t) {
+  for (std::size_t step = 0; step < num_steps; step += 1)
+    t += solve_multirate(tau, t);
+  return t;
+}
+
+HealthMonitor &ExplicitNonlinearFlowSolver::get_health_monitor() { return *d_health_monitor; }
+
+ConservationMonitor &ExplicitNonlinearFlowSolver::get_conservation_monitor() { return *d_conservation_monitor; }
+
+SnapshotHistory &ExplicitNonlinearFlowSolver::get_snapshot_history() { return *d_snapshot_history; }
+
+void ExplicitNonlinearFlowSolver::write_checkpoint(const std::string &path, double t) const {
+  macrocirculation::write_checkpoint(d_comm, path, *d_graph, *d_dof_map, d_u_now, t);
+}
+
+double ExplicitNonlinearFlowSolver::read_checkpoint(const std::string &path) {
+  const double t = macrocirculation::read_checkpoint(d_comm, path, *d_graph, *d_dof_map, d_u_now);
+  d_u_prev = d_u_now;
+  return t;
+}
+
+void ExplicitNonlinearFlowSolver::set_to_steady_flow(const SteadyFlowSolver &steady_flow_solver) {
+  steady_flow_solver.interpolate(*d_dof_map, d_u_now);
+  d_u_prev = d_u_now;
 }
 
 void ExplicitNonlinearFlowSolver::use_explicit_euler_method() {
-  d_time_integrator = std::make_unique<TimeIntegrator>(create_explicit_euler(), d_dof_map->num_dof());
+  d_time_integrator = std::make_unique<TimeIntegrator>(create_explicit_euler_shu_osher(), d_dof_map->num_dof(), d_time_integrator->get_storage_precision());
+  distribute_memory_among_threads();
 }
 
 void ExplicitNonlinearFlowSolver::use_ssp_method() {
-  d_time_integrator = std::make_unique<TimeIntegrator>(create_ssp_method(), d_dof_map->num_dof());
+  d_time_integrator = std::make_unique<TimeIntegrator>(create_ssp_method_shu_osher(), d_dof_map->num_dof(), d_time_integrator->get_storage_precision());
+  distribute_memory_among_threads();
 }
 
-RightHandSideEvaluator &ExplicitNonlinearFlowSolver::get_rhs_evaluator() {
-  return *d_right_hand_side_evaluator;
+void ExplicitNonlinearFlowSolver::use_ssp_5_3_method() {
+  d_time_integrator = std::make_unique<TimeIntegrator>(create_ssp_5_3_method_shu_osher(), d_dof_map->num_dof(), d_time_integrator->get_storage_precision());
+  distribute_memory_among_threads();
 }
 
-DofMap &ExplicitNonlinearFlowSolver::get_dof_map() {
-  return *d_dof_map;
+void ExplicitNonlinearFlowSolver::use_ssp_10_4_method() {
+  d_time_integrator = std::make_unique<TimeIntegrator>(create_ssp_10_4_method_shu_osher(), d_dof_map->num_dof(), d_time_integrator->get_storage_precision());
+  distribute_memory_among_threads();
 }
 
-std::vector<double> &ExplicitNonlinearFlowSolver::get_solution() {
-  return d_u_now;
+void ExplicitNonlinearFlowSolver::set_storage_precision(StoragePrecision precision) {
+  d_time_integrator->set_storage_precision(precision);
+  distribute_memory_among_threads();
 }
 
-size_t ExplicitNonlinearFlowSolver::get_degree() const { return d_degree; }
+void ExplicitNonlinearFlowSolver::set_implicit_0d_models(bool implicit) {
+  d_right_hand_side_evaluator->set_implicit_0d_models(implicit);
+}
 
-double ExplicitNonlinearFlowSolver::get_flow_at_vessel_tip(const Vertex &v) const {
-  if (!v.is_leaf())
-    throw std::runtime_error("flow can only be calculated at leafs");
+void ExplicitNonlinearFlowSolver::set_exponential_0d_models(bool exponential) {
+  d_right_hand_side_evaluator->set_exponential_0d_models(exponential);
+}
 
-  const auto e_id = v.get_edge_neighbors()[0];
+void ExplicitNonlinearFlowSolver::set_num_threads(std::size_t num_threads, const std::vector<int> &cores) {
+  d_thread_pool = num_threads > 1 ? std::make_shared<ThreadPool>(num_threads) : nullptr;
+  // the threads are bound before they touch their memory, such that the pages are placed on the nodes of the cores
+  if (!cores.empty() && d_thread_pool != nullptr)
+    d_thread_pool->pin_threads(cores);
+  else if (!cores.empty())
+    pin_thread_to_core(cores.front());
+  d_right_hand_side_evaluator->set_thread_pool(d_thread_pool);
+  distribute_memory_among_threads();
+}
 
-  const auto &edge = *d_graph->get_edge(e_id);
+void ExplicitNonlinearFlowSolver::distribute_memory_among_threads() {
+  if (d_thread_pool == nullptr) {
+    d_time_integrator->set_thread_pool(nullptr, {});
+    return;
+  }
+  const auto dof_chunk_offsets = d_right_hand_side_evaluator->get_dof_chunk_offsets();
+  d_time_integrator->set_thread_pool(d_thread_pool, dof_chunk_offsets);
+  first_touch(d_thread_pool.get(), dof_chunk_offsets, d_u_now);
+  first_touch(d_thread_pool.get(), dof_chunk_offsets, d_u_prev);
+}
+
+void ExplicitNonlinearFlowSolver::set_task_scheduling(bool enable) {
+  d_right_hand_side_evaluator->set_task_scheduling(enable);
+}
 
-  const auto ldofmap = d_dof_map->get_local_dof_map(edge);
+void ExplicitNonlinearFlowSolver::set_quadrature_type(QuadratureType type) {
+  d_right_hand_side_evaluator->set_quadrature_type(type);
+}
 
-  QuadratureFormula qf = create_gauss4();
-  FETypeNetwork fe(qf, ldofmap.num_basis_functions() - 1);
+void ExplicitNonlinearFlowSolver::start_cost_measurement() {
+  d_cost_measurement = std::make_shared<CostMeasurement>(d_graph->num_edges(), d_graph->num_vertices());
+  d_right_hand_side_evaluator->set_cost_measurement(d_cost_measurement);
+}
 
-  std::vector<size_t> dof_indices(ldofmap.num_basis_functions(), 0);
+bool ExplicitNonlinearFlowSolver::rebalance(double tolerance) {
+  if (d_cost_measurement == nullptr)
+    throw std::runtime_error("ExplicitNonlinearFlowSolver::rebalance: the cost measurement was not started");
 
-  if (edge.is_pointing_to(v.get_id())) {
-    ldofmap.dof_indices(edge.num_micro_edges() - 1, 0, dof_indices);
-  } else {
-    ldofmap.dof_indices(0, 0, dof_indices);
+  const auto costs = d_cost_measurement->get_total_edge_costs(d_comm, *d_graph);
+  d_cost_measurement->reset();
+
+  const double max_cost = *std::max_element(costs.begin(), costs.end());
+  if (!(max_cost > 0) || calculate_load_imbalance(d_comm, *d_graph, costs) <= tolerance)
+    return false;
+
+  // the partitioner needs integer costs, hence we scale them to a fine enough range
+  const auto estimator = [&](const Edge &e) { return 1 + static_cast<int>(1e6 * costs[e.get_id()] / max_cost); };
+  const auto parts = topology_aware_partition(*d_graph, estimator, mpi::size(d_comm));
+
+  std::vector<int> old_edge_ranks(d_graph->num_edges(), -1);
+  bool has_changed = false;
+  for (auto e_id : d_graph->get_edge_ids()) {
+    old_edge_ranks[e_id] = d_graph->edge(e_id).rank();
+    has_changed = has_changed || parts[e_id] != old_edge_ranks[e_id];
   }
+  if (!has_changed)
+    return false;
 
-  std::vector<double> dof_values(ldofmap.num_basis_functions(), 0);
-  extract_dof(dof_indices, d_u_now, dof_values);
-  auto boundary_values = fe.evaluate_dof_at_boundary_points(dof_values);
+  // the degrees are taken from the old partition
+  const auto edge_degrees = get_edge_degrees(d_comm, *d_graph, *d_dof_map);
 
-  if (edge.is_pointing_to(v.get_id())) {
-    return boundary_values.right;
-  } else {
-    return -boundary_values.left;
+  for (auto e_id : d_graph->get_edge_ids())
+    d_graph->assign_edge_to_rank(d_graph->edge(e_id), parts[e_id]);
+
+  DofMap new_dof_map(d_graph->num_vertices(), d_graph->num_edges());
+  new_dof_map.create(d_comm, *d_graph, 2, edge_degrees, false);
+
+  std::vector<double> u_new;
+  migrate_primitive_values(d_comm, *d_graph, old_edge_ranks, *d_dof_map, d_u_now, new_dof_map, u_new);
+
+  // the dof map is shared with the caller, hence we replace its content
+  *d_dof_map = std::move(new_dof_map);
+  d_u_now = std::move(u_new);
+  d_u_prev = d_u_now;
+
+  d_time_integrator->resize(d_dof_map->num_dof());
+  d_right_hand_side_evaluator->reinit();
+  distribute_memory_among_threads();
+  create_tip_evaluations();
+
+  return true;
+}
+
+void ExplicitNonlinearFlowSolver::set_edge_degrees(const std::vector<std::size_t> &edge_degrees) {
+  DofMap new_dof_map(d_graph->num_vertices(), d_graph->num_edges());
+  new_dof_map.create(d_comm, *d_graph, 2, edge_degrees, false);
+
+  std::vector<double> u_new;
+  transfer_to_degrees(d_comm, *d_graph, *d_dof_map, d_u_now, new_dof_map, u_new);
+
+  // the dof map is shared with the caller, hence we replace its content
+  *d_dof_map = std::move(new_dof_map);
+  d_u_now = std::move(u_new);
+  d_u_prev = d_u_now;
+
+  d_time_integrator->resize(d_dof_map->num_dof());
+  d_right_hand_side_evaluator->reinit();
+  distribute_memory_among_threads();
+  create_tip_evaluations();
+}
+
+bool ExplicitNonlinearFlowSolver::adapt_edge_degrees(const DegreeAdaptivitySettings &settings) {
+  const auto old_degrees = get_edge_degrees(d_comm, *d_graph, *d_dof_map);
+  const auto new_degrees = select_edge_degrees(d_comm, *d_graph, *d_dof_map, d_u_now, settings);
+  if (new_degrees == old_degrees)
+    return false;
+
+  set_edge_degrees(new_degrees);
+  return true;
+}
+
+bool ExplicitNonlinearFlowSolver::adapt_micro_edges(const MeshAdaptivitySettings &settings) {
+  // the owner of an edge decides about its new lengths, which every rank then needs for its copy of the graph
+  std::vector<unsigned long long> num_new_micro_edges(d_graph->num_edges(), 0);
+  std::vector<std::vector<double>> new_lengths(d_graph->num_edges());
+  for (auto e_id : d_graph->get_active_edge_ids(mpi::rank(d_comm))) {
+    const auto &edge = d_graph->edge(e_id);
+    const auto indicators = jump_indicators(d_dof_map->get_local_dof_map(edge), d_u_now);
+    new_lengths[e_id] = adapt_micro_edge_lengths(edge.get_micro_edge_lengths(), indicators, settings);
+    num_new_micro_edges[e_id] = new_lengths[e_id].size();
   }
+  CHECK_MPI_SUCCESS(MPI_Allreduce(MPI_IN_PLACE, num_new_micro_edges.data(), static_cast<int>(num_new_micro_edges.size()), MPI_UNSIGNED_LONG_LONG, MPI_MAX, d_comm));
+
+  std::vector<std::size_t> offsets(d_graph->num_edges() + 1, 0);
+  for (std::size_t e_id = 0; e_id < d_graph->num_edges(); e_id += 1)
+    offsets[e_id + 1] = offsets[e_id] + num_new_micro_edges[e_id];
+  std::vector<double> all_lengths(offsets.back(), 0);
+  for (auto e_id : d_graph->get_active_edge_ids(mpi::rank(d_comm)))
+    std::copy(new_lengths[e_id].begin(), new_lengths[e_id].end(), all_lengths.begin() + static_cast<std::ptrdiff_t>(offsets[e_id]));
+  CHECK_MPI_SUCCESS(MPI_Allreduce(MPI_IN_PLACE, all_lengths.data(), static_cast<int>(all_lengths.size()), MPI_DOUBLE, MPI_SUM, d_comm));
+
+  // the degrees and lengths are taken from the old mesh
+  const auto edge_degrees = get_edge_degrees(d_comm, *d_graph, *d_dof_map);
+  std::vector<std::vector<double>> old_lengths(d_graph->num_edges());
+  bool has_changed = false;
+  for (auto e_id : d_graph->get_edge_ids()) {
+    old_lengths[e_id] = d_graph->edge(e_id).get_micro_edge_lengths();
+    new_lengths[e_id].assign(all_lengths.begin() + static_cast<std::ptrdiff_t>(offsets[e_id]), all_lengths.begin() + static_cast<std::ptrdiff_t>(offsets[e_id + 1]));
+    has_changed = has_changed || new_lengths[e_id] != old_lengths[e_id];
+  }
+  if (!has_changed)
+    return false;
+
+  for (auto e_id : d_graph->get_edge_ids()) {
+    if (new_lengths[e_id] != old_lengths[e_id])
+      d_graph->set_micro_edge_lengths(d_graph->edge(e_id), new_lengths[e_id]);
+  }
+
+  DofMap new_dof_map(d_graph->num_vertices(), d_graph->num_edges());
+  new_dof_map.create(d_comm, *d_graph, 2, edge_degrees, false);
+
+  std::vector<double> u_new;
+  transfer_to_micro_edges(d_comm, *d_graph, *d_dof_map, old_lengths, d_u_now, new_dof_map, u_new);
+
+  // the dof map is shared with the caller, hence we replace its content
+  *d_dof_map = std::move(new_dof_map);
+  d_u_now = std::move(u_new);
+  d_u_prev = d_u_now;
+
+  d_time_integrator->resize(d_dof_map->num_dof());
+  d_right_hand_side_evaluator->reinit();
+  distribute_memory_among_threads();
+  create_tip_evaluations();
+
+  return true;
 }
 
-void ExplicitNonlinearFlowSolver::get_1d_AQ_values_at_vertex(const Vertex &v, double &A, double &Q) const {
-  if (!v.is_leaf())
-    throw std::runtime_error("flow can only be calculated at leafs");
+WaveSpeedDiagnostics ExplicitNonlinearFlowSolver::calculate_wave_speed_diagnostics(double tau) const {
+  WaveSpeedDiagnostics diagnostics{};
+  double max_speed_per_length = 0;
+  calculate_local_wave_speeds(true, diagnostics.rank_max_speed, max_speed_per_length);
+  diagnostics.rank_cfl = tau * max_speed_per_length / d_time_integrator->get_stable_time_step_factor();
+
+  std::array<double, 2> global{diagnostics.rank_max_speed, diagnostics.rank_cfl};
+  CHECK_MPI_SUCCESS(MPI_Allreduce(MPI_IN_PLACE, global.data(), 2, MPI_DOUBLE, MPI_MAX, d_comm));
+  diagnostics.max_speed = global[0];
+  diagnostics.cfl = global[1];
+  return diagnostics;
+}
+
+void ExplicitNonlinearFlowSolver::set_wave_speed_monitor(std::size_t num_steps, double warning_cfl) {
+  d_wave_speed_interval = num_steps;
+  d_wave_speed_step = 0;
+  d_warning_cfl = warning_cfl;
+}
+
+void ExplicitNonlinearFlowSolver::monitor_wave_speeds(double tau) {
+  if (d_wave_speed_interval == 0)
+    return;
 
-  const auto e_id = v.get_edge_neighbors()[0];
+  d_wave_speed_step += 1;
+  if (d_wave_speed_step < d_wave_speed_interval)
+    return;
+  d_wave_speed_step = 0;
 
-  const auto &edge = *d_graph->get_edge(e_id);
+  d_wave_speed_diagnostics = calculate_wave_speed_diagnostics(tau);
+  if (d_wave_speed_diagnostics.cfl > d_warning_cfl && mpi::rank(d_comm) == 0)
+    std::cerr << "warning: the cfl number " << d_wave_speed_diagnostics.cfl << " exceeds " << d_warning_cfl
+              << " at the wave speed " << d_wave_speed_diagnostics.max_speed << std::endl;
+}
+
+void ExplicitNonlinearFlowSolver::update_0d_parameters() {
+  d_right_hand_side_evaluator->update_0d_parameters();
+}
 
-  const auto ldofmap = d_dof_map->get_local_dof_map(edge);
+void ExplicitNonlinearFlowSolver::update_boundary_conditions() {
+  const auto rank = mpi::rank(d_comm);
+  const auto old_vertex_dof_maps = d_dof_map->renumber_vertex_dofs(d_comm, *d_graph);
 
-  QuadratureFormula qf = create_gauss4();
-  FETypeNetwork fe(qf, ldofmap.num_basis_functions() - 1);
+  // the edge dofs come first and stay in place
+  d_u_prev = d_u_now;
+  d_u_now.resize(d_dof_map->num_dof());
 
-  std::vector<size_t> dof_indices_q(ldofmap.num_basis_functions(), 0);
-  std::vector<size_t> dof_indices_a(ldofmap.num_basis_functions(), 0);
+  for (const auto &v_id : d_graph->get_active_vertex_ids(rank)) {
+    const auto &vertex = d_graph->vertex(v_id);
+    if (!d_dof_map->has_local_dof_map(vertex))
+      continue;
 
-  if (edge.is_pointing_to(v.get_id())) {
-    ldofmap.dof_indices(edge.num_micro_edges() - 1, 0, dof_indices_q);
-    ldofmap.dof_indices(edge.num_micro_edges() - 1, 1, dof_indices_a);
-  } else {
-    ldofmap.dof_indices(0, 0, dof_indices_q);
-    ldofmap.dof_indices(0, 1, dof_indices_a);
+    const auto &new_dof_map = d_dof_map->get_local_dof_map(vertex);
+    const auto &old_dof_map = old_vertex_dof_maps[v_id];
+    const auto first = d_u_now.begin() + static_cast<std::ptrdiff_t>(new_dof_map.first_dof());
+    if (old_dof_map.is_initialized() && old_dof_map.num_local_dof() == new_dof_map.num_local_dof()) {
+      const auto old_first = d_u_prev.begin() + static_cast<std::ptrdiff_t>(old_dof_map.first_dof());
+      std::copy_n(old_first, old_dof_map.num_local_dof(), first);
+      continue;
+    }
+
+    // a new model starts from the pressure of the replaced model, or from the pressure of the vessel at rest
+    const auto &param = d_graph->edge(vertex.get_edge_neighbors()[0]).get_physical_data();
+    double p_c = nonlinear::get_p_from_QA(0, param.A0, param);
+    if (old_dof_map.is_initialized() && old_dof_map.num_local_dof() > 0)
+      p_c = d_u_prev[old_dof_map.first_dof()];
+    for (std::size_t k = 0; k < new_dof_map.num_local_dof(); k += 1)
+      first[static_cast<std::ptrdiff_t>(k)] = (vertex.is_rcl_outflow() && k % 2 == 1) ? 0. : p_c;
   }
+  d_u_prev = d_u_now;
+
+  d_time_integrator->resize(d_dof_map->num_dof());
+  d_right_hand_side_evaluator->update_vertex_dofs();
+  distribute_memory_among_threads();
+}
 
-  std::vector<double> dof_values_q(ldofmap.num_basis_functions(), 0);
-  extract_dof(dof_indices_q, d_u_now, dof_values_q);
-  auto boundary_values_q = fe.evaluate_dof_at_boundary_points(dof_values_q);
+void ExplicitNonlinearFlowSolver::update_outflow_pressures() {
+  d_right_hand_side_evaluator->update_outflow_pressures();
+}
 
-  std::vector<double> dof_values_a(ldofmap.num_basis_functions(), 0);
-  extract_dof(dof_indices_a, d_u_now, dof_values_a);
-  auto boundary_values_a = fe.evaluate_dof_at_boundary_points(dof_values_a);
+RightHandSideEvaluator &ExplicitNonlinearFlowSolver::get_rhs_evaluator() {
+  return *d_right_hand_side_evaluator;
+}
 
-  if (edge.is_pointing_to(v.get_id())) {
-    Q = boundary_values_q.right;
-    A = boundary_values_a.right;
+MemoryReport ExplicitNonlinearFlowSolver::memory_report() const {
+  MemoryReport report;
+  report.add("solution", d_u_now);
+  report.add("solution", d_u_prev);
+  report.add("time integrator", d_time_integrator->memory_report());
+  report.add("rhs", d_right_hand_side_evaluator->memory_report());
+  report.add("time step levels", d_time_step_levels);
+  report.add("tip evaluations", d_tip_evaluations);
+  return report;
+}
+
+std::shared_ptr<const NonlinearFlowUpwindEvaluator> ExplicitNonlinearFlowSolver::share_upwind_fluxes() {
+  d_share_upwind_fluxes = true;
+  return d_right_hand_side_evaluator->get_shared_flow_upwind_evaluator();
+}
+
+DofMap &ExplicitNonlinearFlowSolver::get_dof_map() {
+  return *d_dof_map;
+}
+
+std::vector<double> &ExplicitNonlinearFlowSolver::get_solution() {
+  return d_u_now;
+}
+
+const std::vector<double> &ExplicitNonlinearFlowSolver::get_solution() const {
+  return d_u_now;
+}
+
+const std::vector<double> &ExplicitNonlinearFlowSolver::get_previous_solution() const {
+  return d_u_prev;
+}
+
+size_t ExplicitNonlinearFlowSolver::get_degree() const { return d_degree; }
+
+namespace {
+
+ExplicitNonlinearFlowSolver::PointEvaluation create_evaluation(const LocalEdgeDofMap &local_dof_map, std::size_t micro_edge_id, double s_tilde) {
+  ExplicitNonlinearFlowSolver::PointEvaluation evaluation{
+    local_dof_map.first_dof(micro_edge_id, ExplicitNonlinearFlowSolver::Q_component),
+    local_dof_map.first_dof(micro_edge_id, ExplicitNonlinearFlowSolver::A_component),
+    local_dof_map.num_basis_functions(),
+    {}};
+  const auto phi = evaluate_legendre(s_tilde);
+  for (std::size_t k = 0; k < evaluation.num_basis_functions; k += 1)
+    evaluation.phi[k] = phi[k];
+  return evaluation;
+}
+
+} // namespace
+
+ExplicitNonlinearFlowSolver::PointEvaluation ExplicitNonlinearFlowSolver::create_tip_evaluation(const Vertex &v) const {
+  if (!v.is_leaf())
+    throw std::runtime_error("flow can only be calculated at leafs");
+
+  const auto &edge = d_graph->edge(v.get_edge_neighbors()[0]);
+  const auto &local_dof_map = d_dof_map->get_local_dof_map(edge);
+
+  if (edge.is_pointing_to(v.get_id()))
+    return create_evaluation(local_dof_map, edge.num_micro_edges() - 1, +1.);
+  else
+    return create_evaluation(local_dof_map, 0, -1.);
+}
+
+void ExplicitNonlinearFlowSolver::create_tip_evaluations() {
+  d_tip_evaluations.assign(d_graph->num_vertices(), PointEvaluation{0, 0, 0, {0, 0, 0, 0}});
+  for (auto v_id : d_graph->get_active_vertex_ids(mpi::rank(d_comm))) {
+    const auto &vertex = d_graph->vertex(v_id);
+    if (vertex.is_leaf() && d_graph->edge(vertex.get_edge_neighbors()[0]).rank() == mpi::rank(d_comm))
+      d_tip_evaluations[v_id] = create_tip_evaluation(vertex);
+  }
+}
+
+ExplicitNonlinearFlowSolver::PointEvaluation ExplicitNonlinearFlowSolver::get_tip_evaluation(const Vertex &v) const {
+  if (v.get_id() < d_tip_evaluations.size() && d_tip_evaluations[v.get_id()].num_basis_functions > 0)
+    return d_tip_evaluations[v.get_id()];
+  return create_tip_evaluation(v);
+}
+
+double ExplicitNonlinearFlowSolver::get_flow_at_vessel_tip(const Vertex &v) const {
+  double A, Q;
+  evaluate_1d_AQ_values(get_tip_evaluation(v), A, Q);
+
+  if (d_graph->edge(v.get_edge_neighbors()[0]).is_pointing_to(v.get_id())) {
+    return Q;
   } else {
-    Q = boundary_values_q.left;
-    A = boundary_values_a.left;
+    return -Q;
   }
 }
 
+void ExplicitNonlinearFlowSolver::get_1d_AQ_values_at_vertex(const Vertex &v, double &A, double &Q) const {
+  evaluate_1d_AQ_values(get_tip_evaluation(v), A, Q);
+}
+
 void ExplicitNonlinearFlowSolver::get_1d_pq_values_at_vertex(const Vertex &v, double &p, double &q) const {
-  auto &data = d_graph->get_edge(v.get_edge_neighbors()[0])->get_physical_data();
+  auto &data = d_graph->edge(v.get_edge_neighbors()[0]).get_physical_data();
 
   double A, Q;
   get_1d_AQ_values_at_vertex(v, A, Q);
@@ -210,12 +698,11 @@ void ExplicitNonlinearFlowSolver::get_1d_pq_values_at_vertex(const Vertex &v, do
 [[nodiscard]] Values0DModel ExplicitNonlinearFlowSolver::get_0D_values(const Vertex &v) const {
   Values0DModel result{0, 0};
 
-  const auto &edge = *d_graph->get_edge(v.get_edge_neighbors()[0]);
+  const auto &edge = d_graph->edge(v.get_edge_neighbors()[0]);
 
-  if (edge.rank() == mpi::rank(MPI_COMM_WORLD)) {
+  if (edge.rank() == mpi::rank(d_comm)) {
     const auto &vertex_dof_map = d_dof_map->get_local_dof_map(v);
-    const auto &vertex_dofs = vertex_dof_map.dof_indices();
-    const auto p_c = d_u_now[vertex_dofs[0]];
+    const auto p_c = d_u_now[vertex_dof_map.first_dof()];
 
     const auto &param = edge.get_physical_data();
 
@@ -229,29 +716,49 @@ void ExplicitNonlinearFlowSolver::get_1d_pq_values_at_vertex(const Vertex &v, do
     result.q = q;
   }
 
-  MPI_Bcast(&result.p_c, 1, MPI_DOUBLE, edge.rank(), MPI_COMM_WORLD);
-  MPI_Bcast(&result.q, 1, MPI_DOUBLE, edge.rank(), MPI_COMM_WORLD);
+  MPI_Bcast(&result.p_c, 1, MPI_DOUBLE, edge.rank(), d_comm);
+  MPI_Bcast(&result.q, 1, MPI_DOUBLE, edge.rank(), d_comm);
 
   return result;
 }
 
-void ExplicitNonlinearFlowSolver::evaluate_1d_AQ_values(const Edge &e, double s, double &A, double &Q) const {
-  // on which micro edge is the given value
-  auto micro_edge_id = static_cast<size_t>(std::ceil(e.num_micro_edges() * s));
+ExplicitNonlinearFlowSolver::PointEvaluation ExplicitNonlinearFlowSolver::create_point_evaluation(const Edge &e, double s) const {
+  if (e.has_micro_edge_lengths()) {
+    // the micro edges have different lengths, hence we search the one containing s
+    const auto lengths = e.get_micro_edge_lengths();
+    const double length = std::accumulate(lengths.begin(), lengths.end(), 0.);
+    double s_left = 0;
+    std::size_t micro_edge_id = 0;
+    while (micro_edge_id + 1 < lengths.size() && s_left + lengths[micro_edge_id] / length <= s) {
+      s_left += lengths[micro_edge_id] / length;
+      micro_edge_id += 1;
+    }
+    const double h = lengths[micro_edge_id] / length;
+    const double s_tilde = std::max(-1., std::min(1., 2 * (s - s_left) / h - 1));
+    return create_evaluation(d_dof_map->get_local_dof_map(e), micro_edge_id, s_tilde);
+  }
+
+  // on which micro edge is the given value, where the points between two micro edges belong to the right one
+  auto micro_edge_id = static_cast<size_t>(std::floor(e.num_micro_edges() * s));
   micro_edge_id = std::min(micro_edge_id, e.num_micro_edges() - 1);
   const double h = 1. / e.num_micro_edges();
   // get parametrization value on the micro edge
   const double s_tilde = 2 * (s - h * static_cast<double>(micro_edge_id)) / h - 1;
-  // get dof information
-  const auto &local_dof_map = d_dof_map->get_local_dof_map(e);
-  std::vector<size_t> dof(local_dof_map.num_basis_functions());
-  std::vector<double> dof_values(local_dof_map.num_basis_functions());
-  local_dof_map.dof_indices(micro_edge_id, A_component, dof);
-  extract_dof(dof, d_u_now, dof_values);
-  A = FETypeNetwork::evaluate_dof(dof_values, s_tilde);
-  local_dof_map.dof_indices(micro_edge_id, Q_component, dof);
-  extract_dof(dof, d_u_now, dof_values);
-  Q = FETypeNetwork::evaluate_dof(dof_values, s_tilde);
+  return create_evaluation(d_dof_map->get_local_dof_map(e), micro_edge_id, s_tilde);
+}
+
+void ExplicitNonlinearFlowSolver::evaluate_1d_AQ_values(const PointEvaluation &evaluation, double &A, double &Q) const {
+  // summed in the same order as FETypeNetwork::evaluate_dof
+  A = evaluation.phi[0] * d_u_now[evaluation.first_dof_A];
+  Q = evaluation.phi[0] * d_u_now[evaluation.first_dof_Q];
+  for (std::size_t k = 1; k < evaluation.num_basis_functions; k += 1) {
+    A += evaluation.phi[k] * d_u_now[evaluation.first_dof_A + k];
+    Q += evaluation.phi[k] * d_u_now[evaluation.first_dof_Q + k];
+  }
+}
+
+void ExplicitNonlinearFlowSolver::evaluate_1d_AQ_values(const Edge &e, double s, double &A, double &Q) const {
+  evaluate_1d_AQ_values(create_point_evaluation(e, s), A, Q);
 }
 
 void ExplicitNonlinearFlowSolver::evaluate_1d_pq_values(const Edge &e, double s, double &p, double &q) const {
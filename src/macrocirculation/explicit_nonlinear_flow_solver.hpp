@@ -8,14 +8,22 @@
 #ifndef TUMORMODELS_EXPLICIT_NONLINEAR_FLOW_SOLVER_HPP
 #define TUMORMODELS_EXPLICIT_NONLINEAR_FLOW_SOLVER_HPP
 
+#include <array>
 #include <cassert>
 #include <cmath>
 #include <functional>
 #include "gmm_legacy_facade.hpp"
 #include <memory>
 #include <mpi.h>
+#include <string>
 #include <vector>
 
+#include "degree_adaptivity.hpp"
+#include "mesh_adaptivity.hpp"
+#include "fe_type.hpp"
+#include "memory_report.hpp"
+#include "time_integrators.hpp"
+
 namespace macrocirculation {
 
 // forward declarations
@@ -23,14 +31,36 @@ class GraphStorage;
 class DofMap;
 class RightHandSideEvaluator;
 class TimeIntegrator;
+class ThreadPool;
+class HealthMonitor;
+class ConservationMonitor;
+class SnapshotHistory;
 class Vertex;
 class Edge;
+class CostMeasurement;
+class NonlinearFlowUpwindEvaluator;
+class SteadyFlowSolver;
 
 struct Values0DModel {
   double p_c;
   double q;
 };
 
+/*! @brief The characteristic speeds of the current solution and the cfl number of a time step, on this rank and on all ranks. */
+struct WaveSpeedDiagnostics {
+  /*! @brief The largest characteristic speed |Q/A| + c of the edges on this rank [cm s^{-1}]. */
+  double rank_max_speed;
+
+  /*! @brief The largest characteristic speed |Q/A| + c of all the edges [cm s^{-1}]. */
+  double max_speed;
+
+  /*! @brief The cfl number of the time step on this rank, where 1 is the stability limit of the time integrator. */
+  double rank_cfl;
+
+  /*! @brief The largest cfl number of the time step on all ranks. */
+  double cfl;
+};
+
 /*! @brief Interpolates a constant value. WARNING: Assumes legendre basis! */
 void interpolate_constant(MPI_Comm comm,
                           const GraphStorage &graph,
@@ -69,18 +99,231 @@ public:
 
   void solve(double tau, double t);
 
+  /*! @brief Calculates the largest stable time step for the current solution from the CFL condition
+   *             tau <= C * cfl * h / ((2 * degree + 1) * max(|Q/A| + c)),
+   *         where C is the stable time step factor of the time integrator (relative to the 3rd order ssp method), h is the micro edge length, c the wave speed, and the maximum is taken over the
+   *         boundaries and the mean value of every micro edge.
+   *         The minimum over all ranks is taken with a single reduction, hence the call is collective.
+   *
+   * @param cfl The safety factor of the CFL condition.
+   * @return    The stable time step for all ranks.
+   */
+  double calculate_stable_time_step(double cfl) const;
+
+  /*! @brief Evaluates the characteristic speeds of the current solution as calculate_stable_time_step,
+   *         and the cfl number of the time step tau, for which calculate_stable_time_step would return tau.
+   *         With local time stepping, every edge takes the step size of its level. The call is collective.
+   */
+  WaveSpeedDiagnostics calculate_wave_speed_diagnostics(double tau) const;
+
+  /*! @brief Evaluates the wave speed diagnostics after every num_steps-th time step with a single reduction,
+   *         and warns on rank 0, if the cfl number exceeds warning_cfl, such that fixed time steps close to the limit
+   *         are noticed before the solution breaks down. A value of 0 for num_steps disables the monitor, which is the default.
+   */
+  void set_wave_speed_monitor(std::size_t num_steps, double warning_cfl = 0.9);
+
+  /*! @brief Returns the diagnostics of the last monitored time step, which are NaN until the monitor evaluated them once. */
+  const WaveSpeedDiagnostics &get_wave_speed_diagnostics() const { return d_wave_speed_diagnostics; }
+
+  /*! @brief Takes a single time step starting at t with the largest stable time step for the given cfl number,
+   *         which is at most tau_max and does not step over t_stop.
+   *         The time t is advanced by the step and set to exactly t_stop in the last step, such that output times are hit exactly.
+   *         The call is collective.
+   *
+   * @return The time step size which was used.
+   */
+  double solve_adaptive(double tau_max, double &t, double t_stop, double cfl);
+
+  /*! @brief Enables local time stepping, where every edge is integrated with the time step 2^l tau of its level l
+   *         (see calculate_time_step_levels). Levels are at most max_level, and 0 disables local time stepping.
+   */
+  void set_max_time_step_level(std::size_t max_level);
+
+  /*! @brief Sets the time step levels of the local time stepping explicitly, indexed by the edge id.
+   *         The levels have to be the same on all ranks.
+   */
+  void set_time_step_levels(std::vector<std::size_t> levels);
+
+  const std::vector<std::size_t> &get_time_step_levels() const;
+
+  /*! @brief Advances the solution with local time stepping from t by the time step 2^L tau, where L is the largest level.
+   *         Within this interval the edges on level l take 2^(L-l) steps with the time step 2^l tau.
+   *         While an edge group is sub-cycled, the values of the other edges at the coupling vertices are frozen.
+   *         Without any levels this is a single call to solve.
+   *
+   * @param tau The time step of the finest level.
+   * @param t   The current time.
+   * @return    The time step size for the whole solution, i.e. 2^L tau.
+   */
+  double solve_multirate(double tau, double t);
+
+  /*! @brief Takes num_steps steps of solve_multirate starting at t, such that a driver only enters the solver once for many short steps.
+   *         The call is collective.
+   *
+   * @return The time after the last step.
+   */
+  double solve_n(std::size_t num_steps, double tau, double t);
+
   /*! @brief Configures the explicit euler method as the time integrator. */
   void use_explicit_euler_method();
 
   /*! @brief Configures a 3rd order RKM as the time integrator. */
   void use_ssp_method();
 
+  /*! @brief Treats the linear windkessel and vessel tree models implicitly, such that only the 1D model restricts the time step.
+   *         This needs one of the Shu-Osher schemes above and is only first order accurate for the 0D models.
+   */
+  void set_implicit_0d_models(bool implicit);
+
+  /*! @brief Integrates the linearized windkessel, vessel tree and rcl models exactly within each stage, such that only the 1D model restricts the time step.
+   *         The outflow of the vessel is assumed to be constant within a stage. This needs one of the Shu-Osher schemes above.
+   */
+  void set_exponential_0d_models(bool exponential);
+
+  /*! @brief Configures the 5-stage 3rd order SSP method with a larger stability region than use_ssp_method. */
+  void use_ssp_5_3_method();
+
+  /*! @brief Configures the 10-stage 4th order SSP method with a larger stability region than use_ssp_method. */
+  void use_ssp_10_4_method();
+
+  /*! @brief Stores the stages of the time integrator in single precision for screening runs, which is kept if the method changes.
+   *         The solution and all the arithmetic stay in double precision, see StoragePrecision.
+   */
+  void set_storage_precision(StoragePrecision precision);
+
+  /*! @brief Splits the edge loops of the right-hand side evaluation and the vector updates of the time integrator among the given number of threads inside of this rank.
+   *         A value of 1 disables the threading.
+   *
+   *  Every thread works on the same contiguous chunk of edges and dofs in all the loops, and first touches the solution, stage and flux vectors of its chunk,
+   *  such that they reside on its NUMA node.
+   *
+   * @param cores If not empty, the k-th thread, including the calling thread as thread 0, is bound to the core cores[k % cores.size()], see parse_core_list.
+   */
+  void set_num_threads(std::size_t num_threads, const std::vector<int> &cores = {});
+
+  /*! @brief Evaluates the right-hand side as a graph of edge and vertex tasks instead of a sequence of phases,
+   *         see RightHandSideEvaluator::set_task_scheduling. The results do not change.
+   */
+  void set_task_scheduling(bool enable);
+
+  /*! @brief Integrates the cells with the given quadrature, see RightHandSideEvaluator::set_quadrature_type.
+   *         The nodal gauss-lobatto variant needs fewer flux evaluations, and the solution is kept when the type changes.
+   */
+  void set_quadrature_type(QuadratureType type);
+
+  /*! @brief Starts measuring the computation times of the edges and vertices in the right-hand side evaluations,
+   *         which are the costs for rebalance. A running measurement is reset.
+   */
+  void start_cost_measurement();
+
+  /*! @brief Returns the running cost measurement, or a null pointer if it was not started. */
+  std::shared_ptr<const CostMeasurement> get_cost_measurement() const { return d_cost_measurement; }
+
+  /*! @brief Repartitions the graph with the measured costs, if the ranks are imbalanced by more than the given tolerance,
+   *         and migrates the solution to the new owners of the primitives without any restart.
+   *
+   *  The graph and the dof map are changed in place, where the dof map is rebuilt for the flow problem as in the examples,
+   *  i.e. with two components and only the local dofs. The measurement restarts afterwards.
+   *  Objects outside of the solver, which store rank dependent data of the graph, e.g. the writers, have to be recreated.
+   *  The call is collective.
+   *
+   * @return True, if the graph was repartitioned.
+   */
+  bool rebalance(double tolerance = 0.05);
+
+  /*! @brief Changes the degree of every edge, indexed by the edge id, and projects the current solution onto the new shape functions.
+   *         The call is collective and the degrees have to be the same on all ranks.
+   *         The time step levels of set_max_time_step_level depend on the degrees and have to be recalculated.
+   */
+  void set_edge_degrees(const std::vector<std::size_t> &edge_degrees);
+
+  /*! @brief Raises or lowers the degrees of the edges depending on the smoothness of the current solution, see select_edge_degrees.
+   *
+   * Smooth edges get a higher degree, while the edges near steep fronts get a lower one.
+   * The stable time step depends on the degrees, hence it should be recalculated afterwards.
+   *
+   * @return True, if the degree of an edge changed.
+   */
+  bool adapt_edge_degrees(const DegreeAdaptivitySettings &settings);
+
+  /*! @brief Refines and coarsens the micro edges of every edge depending on the jumps of the current solution, see jump_indicators,
+   *         and projects the solution onto the new micro edges.
+   *
+   * The micro edges near steep fronts are split, while they are merged again in the smooth regions.
+   * The graph and the dof map are changed in place, hence the writers have to be recreated as after rebalance.
+   * The stable time step and the time step levels depend on the shortest micro edges and should be recalculated afterwards.
+   * The call is collective.
+   *
+   * @return True, if the micro edges of an edge changed.
+   */
+  bool adapt_micro_edges(const MeshAdaptivitySettings &settings);
+
+  /*! @brief Reloads the parameters of the 0D boundary models from the vertices after they were updated in place,
+   *         such that e.g. a calibration can continue from the current solution.
+   */
+  void update_0d_parameters();
+
+  /*! @brief Renumbers the dofs of the 0D boundary models after the boundary conditions of some outlets were replaced,
+   *         e.g. by convert_rcr_to_partitioned_tree_bcs, and continues from the current solution.
+   *
+   *  The edges keep their dofs and hence their part of the solution and all the cached data of the edges.
+   *  The 0D models with the same number of dofs keep their values, while the dofs of the other ones start
+   *  with the pressure of the replaced model in all their compartments, and with zero flows for the rcl models.
+   *  The call is collective, and the dof map shared with the caller is changed in place.
+   */
+  void update_boundary_conditions();
+
+  /*! @brief Reloads only the outflow pressures of the 0D boundary models after Vertex::update_vessel_tip_pressures, without allocating. */
+  void update_outflow_pressures();
+
   RightHandSideEvaluator &get_rhs_evaluator();
 
+  /*! @brief Returns the memory of the solution vectors, the time integrator and the right-hand side evaluator.
+   *         The graph and the dof map are shared with other solvers, and have their own reports.
+   */
+  MemoryReport memory_report() const;
+
+  /*! @brief Returns a handle to the upwind evaluator of the flow, which from now on keeps a copy of the fluxes
+   *         at the beginning of every time step of solve.
+   *         A transport solver constructed with this handle consumes them for the previous solution instead of recalculating them.
+   */
+  std::shared_ptr<const NonlinearFlowUpwindEvaluator> share_upwind_fluxes();
+
+  /*! @brief Returns the monitor, which checks the solution after the time steps. */
+  HealthMonitor &get_health_monitor();
+
+  /*! @brief Returns the monitor of the volume balance and the energies, which accumulates the boundary flows after the time steps once it was reset. */
+  ConservationMonitor &get_conservation_monitor();
+
+  /*! @brief Returns the ring of the recent solutions, which records the solution after the time steps once it was configured.
+   *         Its snapshots have the dof layout of their time, hence it should be flushed before the dofs change.
+   */
+  SnapshotHistory &get_snapshot_history();
+
+  /*! @brief Writes the current solution including the 0D models at time t into a checkpoint, see write_checkpoint. */
+  void write_checkpoint(const std::string &path, double t) const;
+
+  /*! @brief Restores the solution from a checkpoint, which might have been written on a different number of ranks.
+   *         The restart is not bitwise, since the initial guesses of the newton iterations in the upwinding are not stored.
+   *
+   * @return The time of the checkpoint.
+   */
+  double read_checkpoint(const std::string &path);
+
+  /*! @brief Starts from the steady state of the given solver instead of the vessels at rest, see SteadyFlowSolver::interpolate. */
+  void set_to_steady_flow(const SteadyFlowSolver &steady_flow_solver);
+
   DofMap &get_dof_map();
 
   std::vector<double> &get_solution();
 
+  const std::vector<double> &get_solution() const;
+
+  /*! @brief Returns the solution before the last time step.
+   *         The buffers are swapped in every step, so the reference is only valid until the next step.
+   */
+  const std::vector<double> &get_previous_solution() const;
+
   // TODO: Move this somewhere else
   /*! @brief Calculates the flow Q pointing towards the vertex v. */
   [[nodiscard]] double get_flow_at_vessel_tip(const Vertex& v) const;
@@ -91,15 +334,54 @@ public:
 
   [[nodiscard]] Values0DModel get_0D_values(const Vertex& v) const;
 
+  /*! @brief The first dofs of Q and A on a micro edge together with the basis functions evaluated at a point of it,
+   *         such that repeated evaluations at the same point only cost a few multiply-adds.
+   */
+  struct PointEvaluation {
+    std::size_t first_dof_Q;
+    std::size_t first_dof_A;
+    std::size_t num_basis_functions;
+    std::array<double, max_fe_degree + 1> phi;
+  };
+
+  /*! @brief Precomputes the evaluation on the edge e parametrized on [0, 1] at \f$ s \in [0,1] \f$.
+   *         It stays valid until the dof map changes, e.g. in rebalance.
+   */
+  [[nodiscard]] PointEvaluation create_point_evaluation(const Edge& e, double s) const;
+
+  /*! @brief Evaluates A and Q of the current solution at a precomputed point. */
+  void evaluate_1d_AQ_values(const PointEvaluation& evaluation, double& A, double& Q) const;
+
   /*! @brief Evaluates A and Q of the current solution on the edge e parametrized on [0, 1] at \f$ s \in [0,1] \f$. */
   void evaluate_1d_AQ_values(const Edge& e, double s, double& A, double& Q) const;
 
   /*! @brief Evaluates p and q of the current solution on the edge e parametrized on [0, 1] at \f$ s \in [0,1] \f$. */
   void evaluate_1d_pq_values(const Edge& e, double s, double& p, double& q) const;
 
+  /*! @brief Returns the degree given at construction, which the edges can deviate from after set_edge_degrees. */
   size_t get_degree() const;
 
 private:
+  /*! @brief Creates the evaluation at the boundary of the edge at the leaf v. */
+  PointEvaluation create_tip_evaluation(const Vertex& v) const;
+
+  /*! @brief Returns the tabulated evaluation at the leaf v, which is only created on the fly for foreign edges. */
+  PointEvaluation get_tip_evaluation(const Vertex& v) const;
+
+  /*! @brief Tabulates the evaluations at the leafs of our edges for the current dof map. */
+  void create_tip_evaluations();
+
+  /*! @brief Hands the dof chunks of the threads to the time integrator, and moves the solution vectors to the NUMA nodes of the threads. */
+  void distribute_memory_among_threads();
+
+  /*! @brief The largest characteristic speed and the largest ratio of speed and micro edge length, which is scaled by the degree,
+   *         on the edges of this rank. If weight_levels is true, the ratios of the local time stepping are scaled by the step sizes of their levels.
+   */
+  void calculate_local_wave_speeds(bool weight_levels, double &max_speed, double &max_speed_per_length) const;
+
+  /*! @brief Counts a time step of size tau and evaluates the wave speed diagnostics, if we reached the interval of the monitor. */
+  void monitor_wave_speeds(double tau);
+
   /*! @brief The mpi communicator. */
   MPI_Comm d_comm;
 
@@ -118,14 +400,48 @@ private:
   /*! @brief Explicit time integrator to move the solution forwards in time. */
   std::unique_ptr<TimeIntegrator> d_time_integrator;
 
+  /*! @brief Checks the solution for NaNs and negative areas after the time steps. */
+  std::unique_ptr<HealthMonitor> d_health_monitor;
+
+  /*! @brief Balances the volume of the vessels against their boundary flows. */
+  std::unique_ptr<ConservationMonitor> d_conservation_monitor;
+
+  /*! @brief Keeps the recent solutions for writing them, when an event happens. */
+  std::unique_ptr<SnapshotHistory> d_snapshot_history;
+
+  /*! @brief The number of time steps between two evaluations of the wave speed diagnostics, where 0 disables them. */
+  std::size_t d_wave_speed_interval;
+
+  /*! @brief The time steps since the last evaluation of the wave speed diagnostics. */
+  std::size_t d_wave_speed_step;
+
+  /*! @brief The cfl number, from which on the wave speed monitor warns. */
+  double d_warning_cfl;
+
+  WaveSpeedDiagnostics d_wave_speed_diagnostics;
+
+  /*! @brief Optional thread pool for the edge loops. */
+  std::shared_ptr<ThreadPool> d_thread_pool;
+
+  /*! @brief The measured costs for the rebalancing, if the measurement was started. */
+  std::shared_ptr<CostMeasurement> d_cost_measurement;
+
+  /*! @brief True, if the fluxes at the beginning of every time step are kept for other solvers. */
+  bool d_share_upwind_fluxes;
+
+  /*! @brief The time step levels of the local time stepping, indexed by the edge id. Empty, if it is disabled. */
+  std::vector<std::size_t> d_time_step_levels;
+
+  /*! @brief The evaluations at the leafs of our edges, indexed by the vertex id, which are used in every time step
+   *         by the flow integrators and monitors. The other vertices have no basis functions.
+   */
+  std::vector<PointEvaluation> d_tip_evaluations;
+
   /*! @brief The solution at the current time step. */
   std::vector<double> d_u_now;
 
-  /*! @brief The solution at the previous time step. */
+  /*! @brief The solution at the previous time step, which is swapped with d_u_now in every step. */
   std::vector<double> d_u_prev;
-
-  /*! @brief The solution at the previous time step. */
-  std::vector<std::vector<double>> d_k;
 };
 
 } // namespace macrocirculation
@@ -7,15 +7,40 @@
 
 #include "explicit_transport_solver.hpp"
 
+#include "checkpoint.hpp"
 #include "communication/mpi.hpp"
 #include "dof_map.hpp"
+#include "explicit_nonlinear_flow_solver.hpp"
 #include "fe_type.hpp"
 #include "gmm_legacy_facade.hpp"
 #include "graph_storage.hpp"
 #include "right_hand_side_evaluator.hpp"
+#include "time_integrators.hpp"
+
+#include <algorithm>
 
 namespace macrocirculation {
 
+namespace {
+
+/*! @returns The number of components of the transport dof map, which agrees on all the ranks, even if a rank has no edges. */
+std::size_t num_transport_components(MPI_Comm comm, const GraphStorage &graph, const DofMap &dof_map) {
+  unsigned long long num_components = 0;
+  for (auto e_id : graph.get_active_edge_ids(mpi::rank(comm)))
+    num_components = std::max<unsigned long long>(num_components, dof_map.get_local_dof_map(graph.edge(e_id)).num_components());
+  CHECK_MPI_SUCCESS(MPI_Allreduce(MPI_IN_PLACE, &num_components, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, comm));
+  return num_components;
+}
+
+std::vector<EdgeBoundaryField> species_boundary_fields(const std::shared_ptr<DofMap> &dof_map, std::size_t num_species) {
+  std::vector<EdgeBoundaryField> fields;
+  for (std::size_t species = 0; species < num_species; species += 1)
+    fields.push_back({dof_map, species});
+  return fields;
+}
+
+} // namespace
+
 double current_inflow(double t) {
   // return -2 * std::pow(t / delta, 3) + 3 * std::pow(t / delta, 2);
   // return std::sin(M_PI * t * 3);
@@ -28,69 +53,376 @@ double current_inflow(double t) {
     return 1.;
 }
 
+/*! @brief Evaluates the inverse mass times the transport right-hand side for the flow of the current step,
+ *         whose upwinded fluxes were retained by the given source.
+ */
+class ExplicitTransportSolver::RightHandSide : public ExplicitRightHandSide {
+public:
+  explicit RightHandSide(ExplicitTransportSolver &solver)
+      : d_solver(solver),
+        d_flux_source(nullptr),
+        d_t_flow(NAN),
+        d_u_flow(nullptr),
+        d_gamma_per_species(solver.d_num_species, nullptr) {}
+
+  void set_flow(const NonlinearFlowUpwindEvaluator &flux_source, double t_flow, const std::vector<double> &u_flow) {
+    d_flux_source = &flux_source;
+    d_t_flow = t_flow;
+    d_u_flow = &u_flow;
+  }
+
+  void evaluate(double t, const std::vector<double> &gamma, std::vector<double> &rhs, double /*tau_euler*/) override {
+    // the flow is fixed during the step, so only the boundary values of gamma are exchanged for every stage
+    std::fill(d_gamma_per_species.begin(), d_gamma_per_species.end(), &gamma);
+    if (!d_solver.d_flow_upwind_evaluator.init_from(*d_flux_source, d_t_flow, *d_u_flow, d_gamma_per_species))
+      throw std::runtime_error("the flow fluxes for the transport step were not retained");
+    d_solver.calculate_fluxes_at_nfurcations(d_solver.d_flow_upwind_evaluator, d_t_flow, t);
+    d_solver.assemble_rhs(d_t_flow, *d_u_flow, gamma, rhs);
+  }
+
+private:
+  ExplicitTransportSolver &d_solver;
+
+  const NonlinearFlowUpwindEvaluator *d_flux_source;
+
+  double d_t_flow;
+
+  const std::vector<double> *d_u_flow;
+
+  /*! @brief Every species is an additional field of the flow evaluator, which is evaluated in the same vector. */
+  std::vector<const std::vector<double> *> d_gamma_per_species;
+};
+
+/*! @brief Assembles the time derivatives of the concentrations in the edge pass of the flow solver, see couple_to.
+ *         The cells and inner micro vertices of an edge are assembled right after its flow from the values of the flow kernel,
+ *         the macro edge boundaries after the upwinding of the flow, which has also exchanged the boundary values of the species.
+ */
+class ExplicitTransportSolver::CoupledAssembly : public CoupledEdgeAssembly {
+public:
+  explicit CoupledAssembly(ExplicitTransportSolver &solver)
+      : d_solver(solver),
+        d_gamma_per_species(solver.d_num_species, &solver.d_solution),
+        d_rhs(solver.d_dof_map_transport->num_dof(), 0),
+        d_t(NAN),
+        d_u(nullptr) {}
+
+  const std::vector<const std::vector<double> *> &get_boundary_field_values() const override { return d_gamma_per_species; }
+
+  void start(double /*t*/, const std::vector<double> & /*u_prev*/, std::size_t num_threads) override {
+    // the time derivatives are incomplete until finish
+    d_u = nullptr;
+    d_work.resize(num_threads);
+    d_edge_fe.resize(d_solver.d_flow_upwind_evaluator.get_boundary_evaluator().get_local_edge_index().num_slots(), nullptr);
+  }
+
+  void assemble_edge(double /*t*/, const CoupledEdgeFlow &flow, const std::vector<double> & /*u_prev*/, std::size_t thread_id) override {
+    const auto &edge = d_solver.d_graph->edge(flow.edge_id);
+    const auto &local_dof_map = d_solver.d_dof_map_transport->get_local_dof_map(edge);
+    const auto &gamma = d_solver.d_solution;
+    auto &work = d_work[thread_id];
+
+    const std::size_t num_species = d_solver.d_num_species;
+    const std::size_t num_micro_edges = flow.num_micro_edges;
+    const std::size_t num_basis_functions = local_dof_map.num_basis_functions();
+    const std::size_t num_qp = flow.fe.num_quad_points();
+
+    assert(local_dof_map.num_micro_edges() == num_micro_edges);
+    assert(flow.fe.get_degree() + 1 == num_basis_functions);
+
+    // the test functions of the flow kernel include the inverse mass, hence we assemble the time derivatives directly
+    const auto &phi = flow.fe.get_phi();
+    const auto &phi_b = flow.fe.get_phi_boundary();
+    const auto &phi_b_scaled = flow.fe.get_mass_scaled_phi_boundary();
+    const auto &dphi_JxW = flow.fe.get_mass_scaled_dphi_JxW();
+
+    // the macro edge boundaries are added in finish, once the species have been upwinded at the vertices
+    d_edge_fe[slot(flow.edge_id)] = &flow.fe;
+    work.gamma_flux.assign((num_micro_edges + 1) * num_species, 0.);
+    for (std::size_t micro_vertex_id = 1; micro_vertex_id < num_micro_edges; micro_vertex_id += 1) {
+      const double v = flow.Q_up[micro_vertex_id] / flow.A_up[micro_vertex_id];
+      const bool upwind_is_right = v < 0;
+      const std::size_t upwind_micro_edge_id = upwind_is_right ? micro_vertex_id : micro_vertex_id - 1;
+      const auto &phi_upwind = phi_b[upwind_is_right ? 0 : 1];
+
+      const double *gamma_dofs = local_dof_map.dof_values(gamma, upwind_micro_edge_id, 0);
+      double *gamma_fluxes = work.gamma_flux.data() + micro_vertex_id * num_species;
+      for (std::size_t species = 0; species < num_species; species += 1) {
+        double value = 0;
+        for (std::size_t i = 0; i < num_basis_functions; i += 1)
+          value += phi_upwind[i] * gamma_dofs[species * num_basis_functions + i];
+        gamma_fluxes[species] = value * v;
+      }
+    }
+
+    const auto micro_edge_lengths = edge.has_micro_edge_lengths() ? edge.get_micro_edge_lengths() : std::vector<double>();
+    const double h = edge.get_physical_data().length / static_cast<double>(num_micro_edges);
+
+    work.v_dphi_JxW.resize(num_basis_functions * num_qp);
+    work.gamma_qp.resize(num_qp);
+
+    for (std::size_t micro_edge_id = 0; micro_edge_id < num_micro_edges; micro_edge_id += 1) {
+      const double mass_scale = micro_edge_lengths.empty() ? 1. : h / micro_edge_lengths[micro_edge_id];
+
+      // the velocity of the flow kernel times the test function derivatives, which is shared by all the species
+      for (std::size_t i = 0; i < num_basis_functions; i += 1)
+        for (std::size_t qp = 0; qp < num_qp; qp += 1)
+          work.v_dphi_JxW[i * num_qp + qp] = flow.Q_qp[qp * num_micro_edges + micro_edge_id] / flow.A_qp[qp * num_micro_edges + micro_edge_id] * dphi_JxW[i][qp];
+
+      const double *gamma_loc = local_dof_map.dof_values(gamma, micro_edge_id, 0);
+      double *rhs_loc = d_rhs.data() + local_dof_map.first_dof(micro_edge_id, 0);
+
+      for (std::size_t species = 0; species < num_species; species += 1) {
+        const double *gamma_dofs = gamma_loc + species * num_basis_functions;
+        const double flux_up_l = work.gamma_flux[micro_edge_id * num_species + species];
+        const double flux_up_r = work.gamma_flux[(micro_edge_id + 1) * num_species + species];
+
+        for (std::size_t qp = 0; qp < num_qp; qp += 1) {
+          work.gamma_qp[qp] = 0;
+          for (std::size_t j = 0; j < num_basis_functions; j += 1)
+            work.gamma_qp[qp] += gamma_dofs[j] * phi[j][qp];
+        }
+
+        // every dof belongs to exactly one micro edge, hence we can assign instead of zeroing and adding
+        for (std::size_t i = 0; i < num_basis_functions; i += 1) {
+          double value = 0;
+          for (std::size_t qp = 0; qp < num_qp; qp += 1)
+            value += work.gamma_qp[qp] * work.v_dphi_JxW[i * num_qp + qp];
+          value -= flux_up_r * phi_b_scaled[1][i];
+          value += flux_up_l * phi_b_scaled[0][i];
+          rhs_loc[species * num_basis_functions + i] = mass_scale * value;
+        }
+      }
+    }
+  }
+
+  void finish(double t, const std::vector<double> &u_prev, const NonlinearFlowUpwindEvaluator &upwind) override {
+    d_solver.calculate_fluxes_at_nfurcations(upwind, t, t);
+
+    const std::size_t num_species = d_solver.d_num_species;
+    for (const auto e_id : d_solver.d_graph->get_active_edge_ids(mpi::rank(d_solver.d_comm))) {
+      const auto &edge = d_solver.d_graph->edge(e_id);
+      const auto &local_dof_map = d_solver.d_dof_map_transport->get_local_dof_map(edge);
+      const auto &phi_b = d_edge_fe[slot(e_id)]->get_mass_scaled_phi_boundary();
+      const std::size_t num_basis_functions = local_dof_map.num_basis_functions();
+      const std::size_t last_micro_edge_id = local_dof_map.num_micro_edges() - 1;
+
+      const auto micro_edge_lengths = edge.has_micro_edge_lengths() ? edge.get_micro_edge_lengths() : std::vector<double>();
+      const double h = edge.get_physical_data().length / static_cast<double>(local_dof_map.num_micro_edges());
+      const double mass_scale_l = micro_edge_lengths.empty() ? 1. : h / micro_edge_lengths.front();
+      const double mass_scale_r = micro_edge_lengths.empty() ? 1. : h / micro_edge_lengths.back();
+
+      double *rhs_l = d_rhs.data() + local_dof_map.first_dof(0, 0);
+      double *rhs_r = d_rhs.data() + local_dof_map.first_dof(last_micro_edge_id, 0);
+      for (std::size_t species = 0; species < num_species; species += 1) {
+        const double flux_l = d_solver.d_gamma_flux_l[d_solver.gamma_flux_index(e_id, species)];
+        const double flux_r = d_solver.d_gamma_flux_r[d_solver.gamma_flux_index(e_id, species)];
+        for (std::size_t i = 0; i < num_basis_functions; i += 1) {
+          rhs_l[species * num_basis_functions + i] += mass_scale_l * flux_l * phi_b[0][i];
+          rhs_r[species * num_basis_functions + i] -= mass_scale_r * flux_r * phi_b[1][i];
+        }
+      }
+    }
+
+    d_t = t;
+    d_u = &u_prev;
+  }
+
+  /*! @brief Returns the time derivatives, if they were assembled for the given flow, and nullptr otherwise.
+   *         They are handed out only once, since the concentrations change with the step.
+   */
+  const std::vector<double> *take_rhs_for(double t, const std::vector<double> &u_prev) {
+    if (d_u != &u_prev || d_t != t)
+      return nullptr;
+    d_u = nullptr;
+    return &d_rhs;
+  }
+
+private:
+  /*! @brief Temporary storage of the edge kernel, one per thread. */
+  struct EdgeWork {
+    std::vector<double> gamma_flux;
+    std::vector<double> v_dphi_JxW;
+    std::vector<double> gamma_qp;
+  };
+
+  std::size_t slot(std::size_t edge_id) const { return d_solver.d_flow_upwind_evaluator.get_boundary_evaluator().get_local_edge_index()(edge_id); }
+
+  ExplicitTransportSolver &d_solver;
+
+  /*! @brief Every species is an additional field of the upwinding of the flow, which is evaluated in the concentrations. */
+  std::vector<const std::vector<double> *> d_gamma_per_species;
+
+  /*! @brief The time derivatives of the concentrations. Only the dofs of our edges are written. */
+  std::vector<double> d_rhs;
+
+  /*! @brief The flow, for which d_rhs was assembled, or nullptr. */
+  double d_t;
+  const std::vector<double> *d_u;
+
+  std::vector<EdgeWork> d_work;
+
+  /*! @brief The shape functions of the flow kernel on the edges, indexed by their local edge index. */
+  std::vector<const FETypeNetwork *> d_edge_fe;
+};
+
 ExplicitTransportSolver::ExplicitTransportSolver(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, std::shared_ptr<DofMap> dof_map_flow, std::shared_ptr<DofMap> dof_map_transport)
+    : ExplicitTransportSolver(comm, std::move(graph), std::move(dof_map_flow), std::move(dof_map_transport), nullptr) {}
+
+ExplicitTransportSolver::ExplicitTransportSolver(MPI_Comm comm,
+                                                 std::shared_ptr<GraphStorage> graph,
+                                                 std::shared_ptr<DofMap> dof_map_flow,
+                                                 std::shared_ptr<DofMap> dof_map_transport,
+                                                 std::shared_ptr<const NonlinearFlowUpwindEvaluator> flow_upwind_evaluator)
     : d_comm(comm),
       d_graph(std::move(graph)),
       d_dof_map_flow(std::move(dof_map_flow)),
       d_dof_map_transport(std::move(dof_map_transport)),
-      d_flow_upwind_evaluator(comm, d_graph, d_dof_map_flow),
-      d_edge_boundary_communicator(Communicator::create_edge_boundary_value_communicator(comm, d_graph)),
-      d_gamma_macro_edge_boundary_value(2 * d_graph->num_edges()),
-      d_gamma_flux_l(d_graph->num_edges(), 0),
-      d_gamma_flux_r(d_graph->num_edges(), 0),
-      d_rhs(d_dof_map_transport->num_dof(), 0),
+      d_num_species(num_transport_components(comm, *d_graph, *d_dof_map_transport)),
+      d_flow_upwind_evaluator(comm, d_graph, d_dof_map_flow, species_boundary_fields(d_dof_map_transport, d_num_species)),
+      d_shared_flow_upwind_evaluator(std::move(flow_upwind_evaluator)),
+      d_gamma_flux_l(d_flow_upwind_evaluator.get_boundary_evaluator().get_local_edge_index().num_slots() * d_num_species, 0),
+      d_gamma_flux_r(d_flow_upwind_evaluator.get_boundary_evaluator().get_local_edge_index().num_slots() * d_num_species, 0),
       d_solution(d_dof_map_transport->num_dof(), 0),
-      d_inverse_mass(d_dof_map_transport->num_dof()) {
-  assemble_inverse_mass(d_comm, *d_graph, *d_dof_map_transport, d_inverse_mass);
+      d_solution_prev(d_dof_map_transport->num_dof(), 0),
+      d_time_integrator(std::make_unique<TimeIntegrator>(create_explicit_euler_shu_osher(), d_dof_map_transport->num_dof())),
+      d_right_hand_side(std::make_unique<RightHandSide>(*this)),
+      d_explicit_euler(true),
+      d_quadrature_type(QuadratureType::gauss),
+      d_num_sub_cycles(1),
+      d_num_accumulated(0),
+      d_accumulated_t(0),
+      d_accumulated_dt(0),
+      d_accumulated_flow_t(0) {
+  for (std::size_t species = 0; species < d_num_species; species += 1)
+    d_inflows.add(current_inflow);
 }
 
-void ExplicitTransportSolver::evaluate_macro_edge_boundary_values(const std::vector<double> &/*u_prev*/, const std::vector<double> &gamma_prev) {
-  std::vector<std::size_t> dof_indices(4, 0);
-  std::vector<double> local_dofs(4, 0);
-
-  for (const auto &e_id : d_graph->get_active_edge_ids(mpi::rank(d_comm))) {
-    const auto edge = d_graph->get_edge(e_id);
-    const auto &param = edge->get_physical_data();
+ExplicitTransportSolver::~ExplicitTransportSolver() = default;
 
-    const auto &local_dof_map = d_dof_map_transport->get_local_dof_map(*edge);
-    const double h = param.length / double(local_dof_map.num_micro_edges());
+std::size_t ExplicitTransportSolver::num_species() const { return d_num_species; }
 
-    FETypeNetwork fe(create_midpoint_rule(), local_dof_map.num_basis_functions() - 1);
-    fe.reinit(h);
+void ExplicitTransportSolver::set_inflow(std::size_t species, std::function<double(double)> concentration) {
+  d_inflows.set_function(species, std::move(concentration));
+}
 
-    dof_indices.resize(local_dof_map.num_basis_functions());
-    local_dofs.resize(local_dof_map.num_basis_functions());
+void ExplicitTransportSolver::set_inflow(std::size_t species, tabulated_periodic_function concentration) {
+  d_inflows.set_tabulation(species, std::move(concentration));
+}
 
-    local_dof_map.dof_indices(0, 0, dof_indices);
-    extract_dof(dof_indices, gamma_prev, local_dofs);
-    d_gamma_macro_edge_boundary_value[2 * edge->get_id() + 0] = fe.evaluate_dof_at_boundary_points(local_dofs).left;
+void ExplicitTransportSolver::set_quadrature_type(QuadratureType type) {
+  if (d_coupled_assembly != nullptr && type != d_quadrature_type)
+    throw std::runtime_error("the coupled transport has to use the quadrature of the flow");
+  d_quadrature_type = type;
+}
 
-    local_dof_map.dof_indices(local_dof_map.num_micro_edges() - 1, 0, dof_indices);
-    extract_dof(dof_indices, gamma_prev, local_dofs);
-    d_gamma_macro_edge_boundary_value[2 * edge->get_id() + 1] = fe.evaluate_dof_at_boundary_points(local_dofs).right;
-  }
+void ExplicitTransportSolver::couple_to(ExplicitNonlinearFlowSolver &flow_solver) {
+  auto &rhs_evaluator = flow_solver.get_rhs_evaluator();
+  if (!d_explicit_euler || d_num_sub_cycles != 1)
+    throw std::runtime_error("the coupled transport needs the explicit euler method without sub-cycles");
+  if (rhs_evaluator.get_quadrature_type() != d_quadrature_type)
+    throw std::runtime_error("the coupled transport has to use the quadrature of the flow");
+  if (&flow_solver.get_dof_map() != d_dof_map_flow.get())
+    throw std::runtime_error("the coupled transport has to use the dof map of the flow solver");
+
+  d_coupled_assembly = std::make_shared<CoupledAssembly>(*this);
+  rhs_evaluator.set_coupled_assembly(d_coupled_assembly, species_boundary_fields(d_dof_map_transport, d_num_species));
 }
 
 std::vector<double> &ExplicitTransportSolver::get_solution() { return d_solution; }
 
+MemoryReport ExplicitTransportSolver::memory_report() const {
+  MemoryReport report;
+  report.add("solution", d_solution);
+  report.add("solution", d_solution_prev);
+  report.add("flow average", d_flow_average);
+  report.add("gamma fluxes", d_gamma_flux_l);
+  report.add("gamma fluxes", d_gamma_flux_r);
+  report.add("time integrator", d_time_integrator->memory_report());
+  report.add("upwinding", d_flow_upwind_evaluator.memory_report());
+  return report;
+}
+
+void ExplicitTransportSolver::write_checkpoint(const std::string &path, double t) const {
+  macrocirculation::write_checkpoint(d_comm, path, *d_graph, *d_dof_map_transport, d_solution, t);
+}
+
+double ExplicitTransportSolver::read_checkpoint(const std::string &path) {
+  return macrocirculation::read_checkpoint(d_comm, path, *d_graph, *d_dof_map_transport, d_solution);
+}
+
 void ExplicitTransportSolver::solve(double t, double dt, const std::vector<double> &u_prev) {
-  //std::cout << "u_prev = " << u_prev << std::endl;
-  //std::cout << "solution = " << d_solution << std::endl;
-  d_flow_upwind_evaluator.init(t, u_prev);
-  evaluate_macro_edge_boundary_values(u_prev, d_solution);
-  d_edge_boundary_communicator.update_ghost_layer(d_gamma_macro_edge_boundary_value);
-  //std::cout << "boundary_values = " << d_gamma_macro_edge_boundary_value << std::endl;
-  calculate_fluxes_at_nfurcations(t, u_prev);
-  //std::cout << "gamma_flux_l = " << d_gamma_flux_l << std::endl;
-  //std::cout << "gamma_flux_r = " << d_gamma_flux_r << std::endl;
-  assemble_rhs(t, u_prev, d_solution, d_rhs);
-  //std::cout << "rhs = " << d_rhs << std::endl;
-  apply_inverse_mass();
-  // explicit euler step:
-  //std::cout << "rhs = " << d_rhs << std::endl;
-  //std::cout << "solution = " << d_solution << std::endl;
-  gmm::add(gmm::scaled(d_rhs, dt), d_solution);
-  //std::cout << "solution = " << d_solution << std::endl;
+  if (d_num_sub_cycles == 1) {
+    step(t, dt, t, u_prev);
+    return;
+  }
+
+  if (d_num_accumulated == 0) {
+    d_accumulated_t = t;
+    d_accumulated_dt = 0;
+    d_accumulated_flow_t = 0;
+    d_flow_average.assign(u_prev.size(), 0);
+  }
+
+  for (std::size_t k = 0; k < u_prev.size(); k += 1)
+    d_flow_average[k] += dt * u_prev[k];
+  d_accumulated_dt += dt;
+  d_accumulated_flow_t += dt * t;
+  d_num_accumulated += 1;
+
+  if (d_num_accumulated < d_num_sub_cycles)
+    return;
+
+  for (auto &value : d_flow_average)
+    value /= d_accumulated_dt;
+  d_num_accumulated = 0;
+
+  // the averaged flow belongs to the averaged time of its flow solutions
+  step(d_accumulated_t, d_accumulated_dt, d_accumulated_flow_t / d_accumulated_dt, d_flow_average);
+}
+
+void ExplicitTransportSolver::step(double t, double dt, double t_flow, const std::vector<double> &u_flow) {
+  // the flow solver might have assembled the time derivatives in its edge pass already, which is an explicit euler step
+  const std::vector<double> *coupled_rhs = d_coupled_assembly != nullptr ? d_coupled_assembly->take_rhs_for(t_flow, u_flow) : nullptr;
+  if (coupled_rhs != nullptr) {
+    std::swap(d_solution_prev, d_solution);
+    for (std::size_t k = 0; k < d_solution.size(); k += 1)
+      d_solution[k] = d_solution_prev[k] + dt * (*coupled_rhs)[k];
+    return;
+  }
+
+  // the flow fluxes are only recalculated if the flow solver has not retained them for u_flow
+  const NonlinearFlowUpwindEvaluator *flux_source = d_shared_flow_upwind_evaluator.get();
+  if (flux_source == nullptr || !flux_source->has_retained_fluxes(t_flow, u_flow)) {
+    d_flow_upwind_evaluator.retain_fluxes_for(u_flow);
+    d_flow_upwind_evaluator.init(t_flow, u_flow, std::vector<const std::vector<double> *>(d_num_species, &d_solution));
+    flux_source = &d_flow_upwind_evaluator;
+  }
+  d_right_hand_side->set_flow(*flux_source, t_flow, u_flow);
+
+  // the integrator overwrites the whole target buffer, so swapping is enough
+  std::swap(d_solution_prev, d_solution);
+  d_time_integrator->apply(d_solution_prev, t, dt, *d_right_hand_side, d_solution);
+}
+
+void ExplicitTransportSolver::use_explicit_euler_method() {
+  d_explicit_euler = true;
+  d_time_integrator = std::make_unique<TimeIntegrator>(create_explicit_euler_shu_osher(), d_dof_map_transport->num_dof());
+}
+
+void ExplicitTransportSolver::use_ssp_method() {
+  if (d_coupled_assembly != nullptr)
+    throw std::runtime_error("the coupled transport needs the explicit euler method");
+  d_explicit_euler = false;
+  d_time_integrator = std::make_unique<TimeIntegrator>(create_ssp_method_shu_osher(), d_dof_map_transport->num_dof());
+}
+
+void ExplicitTransportSolver::set_sub_cycles(std::size_t num_flow_steps) {
+  if (num_flow_steps == 0)
+    throw std::runtime_error("the transport needs at least one flow step per sub-cycle");
+  if (d_coupled_assembly != nullptr && num_flow_steps != 1)
+    throw std::runtime_error("the coupled transport cannot be sub-cycled");
+  d_num_sub_cycles = num_flow_steps;
+  d_num_accumulated = 0;
 }
 
 void ExplicitTransportSolver::calculate_fluxes_on_macro_edge(const double t,
@@ -102,8 +434,8 @@ void ExplicitTransportSolver::calculate_fluxes_on_macro_edge(const double t,
   const auto local_dof_map_flow = d_dof_map_flow->get_local_dof_map(edge);
   const auto local_dof_map_transport = d_dof_map_transport->get_local_dof_map(edge);
 
-  assert(gamma_fluxes_edge.size() == local_dof_map_transport.num_micro_vertices());
-  assert(gamma_fluxes_edge.size() == local_dof_map_flow.num_micro_vertices());
+  assert(gamma_fluxes_edge.size() == local_dof_map_transport.num_micro_vertices() * d_num_species);
+  assert(local_dof_map_transport.num_micro_vertices() == local_dof_map_flow.num_micro_vertices());
   // TODO: relax this precondition:
   assert(local_dof_map_flow.num_basis_functions() == local_dof_map_transport.num_basis_functions());
 
@@ -112,46 +444,40 @@ void ExplicitTransportSolver::calculate_fluxes_on_macro_edge(const double t,
 
   d_flow_upwind_evaluator.get_fluxes_on_macro_edge(t, edge, u_prev, Q_up_macro_edge, A_up_macro_edge);
 
-  const auto &param = edge.get_physical_data();
-  const double h = param.length / double(local_dof_map_transport.num_micro_edges());
-
   const std::size_t num_basis_functions = local_dof_map_transport.num_basis_functions();
 
-  // TODO: Make this more efficient by not recalculating the gradients.
-  // finite-element for left and right edge
+  // finite-element for the boundary values of the cells
   FETypeNetwork fe(create_trapezoidal_rule(), num_basis_functions - 1);
+  const auto &phi_b = fe.get_phi_boundary();
 
-  // dof indices for left and right edge
-  std::vector<std::size_t> dof_indices(num_basis_functions, 0);
-  std::vector<double> extracted_dof(num_basis_functions, 0);
-  std::vector<double> evaluated_at_qps(num_basis_functions, 0);
-
-  fe.reinit(h);
-
-  // TODO: the boundary values of each cell are evaluated twice
   for (std::size_t micro_vertex_id = 1; micro_vertex_id < local_dof_map_flow.num_micro_vertices() - 1; micro_vertex_id += 1) {
-    const std::size_t local_micro_edge_id_l = micro_vertex_id - 1;
-    const std::size_t local_micro_edge_id_r = micro_vertex_id;
+    const double v = Q_up_macro_edge[micro_vertex_id] / A_up_macro_edge[micro_vertex_id];
 
-    // get gamma:
-    local_dof_map_transport.dof_indices(local_micro_edge_id_l, 0, dof_indices);
-    extract_dof(dof_indices, gamma_prev, extracted_dof);
-    const double gamma_l = fe.evaluate_dof_at_boundary_points(extracted_dof).right;
-    local_dof_map_transport.dof_indices(local_micro_edge_id_r, 0, dof_indices);
-    extract_dof(dof_indices, gamma_prev, extracted_dof);
-    const double gamma_r = fe.evaluate_dof_at_boundary_points(extracted_dof).left;
+    // the upwind cell and its boundary at the micro vertex only depend on the velocity, not on the species
+    const bool upwind_is_right = v < 0;
+    const std::size_t upwind_micro_edge_id = upwind_is_right ? micro_vertex_id : micro_vertex_id - 1;
+    const auto &phi_upwind = phi_b[upwind_is_right ? 0 : 1];
 
-    const double v = Q_up_macro_edge[micro_vertex_id] / A_up_macro_edge[micro_vertex_id];
-    const double gamma = (v < 0) ? gamma_r : gamma_l;
+    // the coefficients of all the species on a micro edge are contiguous
+    const double *gamma_dofs = local_dof_map_transport.dof_values(gamma_prev, upwind_micro_edge_id, 0);
+    double *gamma_fluxes = gamma_fluxes_edge.data() + micro_vertex_id * d_num_species;
 
-    gamma_fluxes_edge[micro_vertex_id] = gamma * v;
+    for (std::size_t species = 0; species < d_num_species; species += 1) {
+      double gamma = 0;
+      for (std::size_t i = 0; i < num_basis_functions; i += 1)
+        gamma += phi_upwind[i] * gamma_dofs[species * num_basis_functions + i];
+      gamma_fluxes[species] = gamma * v;
+    }
   }
 
-  // update left fluxes
-  gamma_fluxes_edge[0] = d_gamma_flux_l[edge.get_id()];
+  const std::size_t last_micro_vertex_id = local_dof_map_transport.num_micro_vertices() - 1;
+  for (std::size_t species = 0; species < d_num_species; species += 1) {
+    // update left fluxes
+    gamma_fluxes_edge[species] = d_gamma_flux_l[gamma_flux_index(edge.get_id(), species)];
 
-  // update right fluxes
-  gamma_fluxes_edge[local_dof_map_transport.num_micro_vertices() - 1] = d_gamma_flux_r[edge.get_id()];
+    // update right fluxes
+    gamma_fluxes_edge[last_micro_vertex_id * d_num_species + species] = d_gamma_flux_r[gamma_flux_index(edge.get_id(), species)];
+  }
 }
 
 void ExplicitTransportSolver::assemble_rhs(double t, const std::vector<double> &u_prev, const std::vector<double> &gamma_prev, std::vector<double> &rhs) {
@@ -163,77 +489,93 @@ void ExplicitTransportSolver::assemble_rhs(double t, const std::vector<double> &
 
   // data structures for cell contributions
   for (const auto &e_id : d_graph->get_active_edge_ids(mpi::rank(d_comm))) {
-    const auto edge = d_graph->get_edge(e_id);
+    const auto *edge = &d_graph->edge(e_id);
     const auto local_dof_map_flow = d_dof_map_flow->get_local_dof_map(*edge);
     const auto local_dof_map_transport = d_dof_map_transport->get_local_dof_map(*edge);
 
     // calculate fluxes on macro edge
-    gamma_flux_macro_edge.resize(local_dof_map_transport.num_micro_vertices());
+    gamma_flux_macro_edge.resize(local_dof_map_transport.num_micro_vertices() * d_num_species);
     calculate_fluxes_on_macro_edge(t, *edge, u_prev, gamma_prev, gamma_flux_macro_edge);
 
     const std::size_t num_basis_functions = local_dof_map_transport.num_basis_functions();
 
-    QuadratureFormula qf = create_gauss4();
-    FETypeNetwork fe(qf, local_dof_map_transport.num_basis_functions() - 1);
+    const std::size_t degree = num_basis_functions - 1;
+    FETypeNetwork fe(create_quadrature_for_degree(d_quadrature_type, degree), degree, d_quadrature_type == QuadratureType::gauss_lobatto);
 
-    const auto &phi_b = fe.get_phi_boundary();
-    const auto &dphi = fe.get_dphi();
-    const auto &JxW = fe.get_JxW();
+    // the test functions include the inverse mass, hence we assemble the time derivatives directly
+    const auto &phi = fe.get_phi();
+    const auto &phi_b = fe.get_mass_scaled_phi_boundary();
+    const auto &dphi_JxW = fe.get_mass_scaled_dphi_JxW();
 
     std::vector<std::size_t> Q_dof_indices(num_basis_functions, 0);
     std::vector<std::size_t> A_dof_indices(num_basis_functions, 0);
-    std::vector<std::size_t> gamma_dof_indices(num_basis_functions, 0);
 
     std::vector<double> Q_prev_loc(num_basis_functions, 0);
     std::vector<double> A_prev_loc(num_basis_functions, 0);
-    std::vector<double> gamma_prev_loc(num_basis_functions, 0);
 
     std::vector<double> Q_prev_qp(fe.num_quad_points(), 0);
     std::vector<double> A_prev_qp(fe.num_quad_points(), 0);
     std::vector<double> gamma_prev_qp(fe.num_quad_points(), 0);
 
-    std::vector<double> rhs_loc(num_basis_functions);
+    // the velocity times the test function derivatives, which is shared by all the species
+    std::vector<double> v_dphi_JxW(num_basis_functions * fe.num_quad_points(), 0);
 
     const auto &param = edge->get_physical_data();
 
     const double h = param.length / local_dof_map_transport.num_micro_edges();
+    const auto micro_edge_lengths = edge->has_micro_edge_lengths() ? edge->get_micro_edge_lengths() : std::vector<double>();
+
+    fe.reinit(h);
 
     for (std::size_t micro_edge_id = 0; micro_edge_id < local_dof_map_transport.num_micro_edges(); micro_edge_id += 1) {
-      fe.reinit(h);
+      // the mass of a micro edge with a different length
+      const double mass_scale = micro_edge_lengths.empty() ? 1. : h / micro_edge_lengths[micro_edge_id];
 
       // evaluate Q and A inside cell
       local_dof_map_flow.dof_indices(micro_edge_id, 0, Q_dof_indices);
       local_dof_map_flow.dof_indices(micro_edge_id, 1, A_dof_indices);
-      local_dof_map_transport.dof_indices(micro_edge_id, 0, gamma_dof_indices);
 
       extract_dof(Q_dof_indices, u_prev, Q_prev_loc);
       extract_dof(A_dof_indices, u_prev, A_prev_loc);
-      extract_dof(gamma_dof_indices, gamma_prev, gamma_prev_loc);
 
       fe.evaluate_dof_at_quadrature_points(Q_prev_loc, Q_prev_qp);
       fe.evaluate_dof_at_quadrature_points(A_prev_loc, A_prev_qp);
-      fe.evaluate_dof_at_quadrature_points(gamma_prev_loc, gamma_prev_qp);
 
-      // get flux of the given rhs
-      const double flux_up_l = gamma_flux_macro_edge[micro_edge_id];
-      const double flux_up_r = gamma_flux_macro_edge[micro_edge_id + 1];
+      for (std::size_t i = 0; i < num_basis_functions; i += 1)
+        for (std::size_t qp = 0; qp < fe.num_quad_points(); qp += 1)
+          v_dphi_JxW[i * fe.num_quad_points() + qp] = Q_prev_qp[qp] / A_prev_qp[qp] * dphi_JxW[i][qp];
 
-      for (std::size_t i = 0; i < num_basis_functions; i += 1) {
-        // rhs integral
-        rhs_loc[i] = 0;
+      // the coefficients of all the species on a micro edge are contiguous
+      const double *gamma_prev_loc = local_dof_map_transport.dof_values(gamma_prev, micro_edge_id, 0);
+      double *rhs_loc = rhs.data() + local_dof_map_transport.first_dof(micro_edge_id, 0);
 
-        // cell contributions
-        for (std::size_t qp = 0; qp < fe.num_quad_points(); qp += 1)
-          rhs_loc[i] += Q_prev_qp[qp] / A_prev_qp[qp] * gamma_prev_qp[qp] * dphi[i][qp] * JxW[qp];
+      for (std::size_t species = 0; species < d_num_species; species += 1) {
+        const double *gamma_dofs = gamma_prev_loc + species * num_basis_functions;
 
-        // boundary contributions  - (Q/A\Gamma) ds, keep attention to the minus!
-        rhs_loc[i] -= flux_up_r * phi_b[1][i];
-        rhs_loc[i] += flux_up_l * phi_b[0][i];
-      }
+        // get flux of the given rhs
+        const double flux_up_l = gamma_flux_macro_edge[micro_edge_id * d_num_species + species];
+        const double flux_up_r = gamma_flux_macro_edge[(micro_edge_id + 1) * d_num_species + species];
+
+        for (std::size_t qp = 0; qp < fe.num_quad_points(); qp += 1) {
+          gamma_prev_qp[qp] = 0;
+          for (std::size_t j = 0; j < num_basis_functions; j += 1)
+            gamma_prev_qp[qp] += gamma_dofs[j] * phi[j][qp];
+        }
+
+        for (std::size_t i = 0; i < num_basis_functions; i += 1) {
+          double value = 0;
+
+          // cell contributions
+          for (std::size_t qp = 0; qp < fe.num_quad_points(); qp += 1)
+            value += gamma_prev_qp[qp] * v_dphi_JxW[i * fe.num_quad_points() + qp];
+
+          // boundary contributions  - (Q/A\Gamma) ds, keep attention to the minus!
+          value -= flux_up_r * phi_b[1][i];
+          value += flux_up_l * phi_b[0][i];
 
-      // copy into global vector
-      for (std::size_t i = 0; i < gamma_dof_indices.size(); i += 1)
-        rhs[gamma_dof_indices[i]] += rhs_loc[i];
+          rhs_loc[species * num_basis_functions + i] += mass_scale * value;
+        }
+      }
     }
   }
 }
@@ -273,17 +615,24 @@ void calculate_gamma_up_at_bifurcation(const std::vector<double> &sigma,
   }
 }
 
-void ExplicitTransportSolver::calculate_fluxes_at_nfurcations(double t, const std::vector<double> &/*u_prev*/) {
+void ExplicitTransportSolver::calculate_fluxes_at_nfurcations(const NonlinearFlowUpwindEvaluator &upwind, double t_flow, double t) {
   std::vector<double> Q_up_values(0, 0);
   std::vector<double> A_up_values(0, 0);
 
-  for (auto &v_id : d_graph->get_vertex_ids()) {
-    auto &vertex = *d_graph->get_vertex(v_id);
+  std::vector<bool> is_in;
+  std::vector<double> N_in(d_num_species, 0);
+
+  // the concentrations are shared by all the inflows
+  d_inflows.update(t);
+
+  // the same cached work list as for the flow, which only contains the vertices at our macro edges
+  for (auto &v_id : d_graph->get_active_and_connected_vertex_ids(mpi::rank(d_comm))) {
+    auto &vertex = d_graph->vertex(v_id);
 
-    d_flow_upwind_evaluator.get_fluxes_on_nfurcation(t, vertex, Q_up_values, A_up_values);
+    upwind.get_fluxes_on_nfurcation(t_flow, vertex, Q_up_values, A_up_values);
 
     if (vertex.is_leaf()) {
-      auto &edge = *d_graph->get_edge(vertex.get_edge_neighbors()[0]);
+      auto &edge = d_graph->edge(vertex.get_edge_neighbors()[0]);
 
       const double Q = Q_up_values.front();
       const double A = A_up_values.front();
@@ -292,70 +641,58 @@ void ExplicitTransportSolver::calculate_fluxes_at_nfurcations(double t, const st
 
       const bool is_inflow = (v > 0 && !edge.is_pointing_to(vertex.get_id())) || (v < 0 && edge.is_pointing_to(vertex.get_id()));
 
-      auto inflow_function = [=](double t) {
-        if (vertex.is_inflow_with_fixed_flow())
-          return current_inflow(t);
+      const bool is_inflow_with_fixed_flow = vertex.is_inflow_with_fixed_flow();
+
+      auto &gamma_flux = edge.is_pointing_to(vertex.get_id()) ? d_gamma_flux_r : d_gamma_flux_l;
+
+      for (std::size_t species = 0; species < d_num_species; species += 1) {
+        double &flux = gamma_flux[gamma_flux_index(edge.get_id(), species)];
+        if (is_inflow)
+          flux = is_inflow_with_fixed_flow ? Q * d_inflows.get(species) : 0.;
         else
-          return 0.;
-      };
-
-      if (is_inflow) {
-        // inflow
-        if (edge.is_pointing_to(vertex.get_id())) {
-          d_gamma_flux_r[edge.get_id()] = Q * inflow_function(t);
-        } else {
-          d_gamma_flux_l[edge.get_id()] = Q * inflow_function(t);
-        }
-      } else {
-        // outflow:
-        if (edge.is_pointing_to(vertex.get_id())) {
-          d_gamma_flux_r[edge.get_id()] = v * d_gamma_macro_edge_boundary_value[2 * edge.get_id() + 1];
-        } else {
-          d_gamma_flux_l[edge.get_id()] = v * d_gamma_macro_edge_boundary_value[2 * edge.get_id() + 0];
-        }
+          flux = v * upwind.get_additional_boundary_value(vertex, edge, species);
       }
     } else if (vertex.is_bifurcation()) {
       // do nothing if there is no flow
       if (gmm::vect_norminf(Q_up_values) < 1e-8)
         continue;
 
-      std::vector<double> gamma;
-      std::vector<bool> is_in;
+      const auto &neighbors = vertex.get_edge_neighbors();
+
+      // the in- and outflows only depend on the flow, hence they are shared by all the species
+      is_in.resize(neighbors.size());
 
       double Q_out = 0;
-      double N_in = 0;
+      std::fill(N_in.begin(), N_in.end(), 0.);
 
-      for (size_t k = 0; k < vertex.get_edge_neighbors().size(); k += 1) {
-        auto &edge = *d_graph->get_edge(vertex.get_edge_neighbors()[k]);
-        double gamma_value = edge.is_pointing_to(vertex.get_id()) ? d_gamma_macro_edge_boundary_value[2 * edge.get_id() + 1] : d_gamma_macro_edge_boundary_value[2 * edge.get_id() + 0];
+      for (size_t k = 0; k < neighbors.size(); k += 1) {
+        auto &edge = d_graph->edge(neighbors[k]);
         double v = Q_up_values[k] / A_up_values[k];
         const bool is_inflow_value = (v > 1e-8 && edge.is_pointing_to(vertex.get_id())) || (v < 1e-8 && !edge.is_pointing_to(vertex.get_id()));
 
-        gamma.push_back(gamma_value);
-        is_in.push_back(is_inflow_value);
+        is_in[k] = is_inflow_value;
 
-        if (!is_inflow_value)
+        if (!is_inflow_value) {
           Q_out += std::abs(Q_up_values[k]);
+          continue;
+        }
 
-        if (is_inflow_value)
-          N_in += std::abs(Q_up_values[k]) / A_up_values[k] * gamma_value;
+        for (std::size_t species = 0; species < d_num_species; species += 1)
+          N_in[species] += std::abs(Q_up_values[k]) / A_up_values[k] * upwind.get_additional_boundary_value(vertex, edge, species);
       }
 
-      for (std::size_t i = 0; i < vertex.get_edge_neighbors().size(); i += 1) {
-        auto &edge = *d_graph->get_edge(vertex.get_edge_neighbors()[i]);
+      for (std::size_t i = 0; i < neighbors.size(); i += 1) {
+        auto &edge = d_graph->edge(neighbors[i]);
         double v = Q_up_values[i] / A_up_values[i];
 
-        if (is_in[i]) {
-          if (edge.is_pointing_to(v_id))
-            d_gamma_flux_r[edge.get_id()] = v * d_gamma_macro_edge_boundary_value[2 * edge.get_id() + 1];
-          else
-            d_gamma_flux_l[edge.get_id()] = v * d_gamma_macro_edge_boundary_value[2 * edge.get_id() + 0];
-        } else {
-          const double flux = v * (A_up_values[i] / std::abs(Q_up_values[i])) * (std::abs(Q_up_values[i]) / Q_out) * N_in;
-          if (edge.is_pointing_to(v_id))
-            d_gamma_flux_r[edge.get_id()] = flux;
+        auto &gamma_flux = edge.is_pointing_to(v_id) ? d_gamma_flux_r : d_gamma_flux_l;
+
+        for (std::size_t species = 0; species < d_num_species; species += 1) {
+          double &flux = gamma_flux[gamma_flux_index(edge.get_id(), species)];
+          if (is_in[i])
+            flux = v * upwind.get_additional_boundary_value(vertex, edge, species);
           else
-            d_gamma_flux_l[edge.get_id()] = flux;
+            flux = v * (A_up_values[i] / std::abs(Q_up_values[i])) * (std::abs(Q_up_values[i]) / Q_out) * N_in[species];
         }
       }
     } else {
@@ -364,9 +701,4 @@ void ExplicitTransportSolver::calculate_fluxes_at_nfurcations(double t, const st
   }
 }
 
-void ExplicitTransportSolver::apply_inverse_mass() {
-  for (std::size_t i = 0; i < d_dof_map_transport->num_dof(); i += 1)
-    d_rhs[i] = d_inverse_mass[i] * d_rhs[i];
-}
-
 } // namespace macrocirculation
@@ -9,11 +9,14 @@
 #define TUMORMODELS_TRANSPORT_H
 
 #include <cmath>
+#include <functional>
 #include <memory>
 #include <mpi.h>
+#include <string>
 #include <utility>
 #include <vector>
 
+#include "fe_type.hpp"
 #include "nonlinear_flow_upwind_evaluator.hpp"
 
 namespace macrocirculation {
@@ -22,30 +25,112 @@ namespace macrocirculation {
 class GraphStorage;
 class DofMap;
 class Edge;
-
-/*! @brief A simple explicit euler solver for the transport equation. */
+class TimeIntegrator;
+class ExplicitNonlinearFlowSolver;
+
+/*! @brief An explicit solver for the transport equation, using the explicit euler by default.
+ *
+ *  Since the transport is advected with the flow velocity Q/A and not with the pulse wave speed,
+ *  the solver can take a single step for several steps of the flow, see set_sub_cycles.
+ *
+ *  Every component of the transport dof map is an independent species, see DofMap::create_for_transport.
+ *  All the species are advected with the same upwinded flow and their boundary values are exchanged in a single message.
+ */
 class ExplicitTransportSolver {
 public:
   ExplicitTransportSolver(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, std::shared_ptr<DofMap> dof_map_flow, std::shared_ptr<DofMap> dof_map_transport);
 
-  void evaluate_macro_edge_boundary_values(const std::vector<double> &u_prev, const std::vector<double> &gamma_prev);
+  /*! @brief Constructs a transport solver, which consumes the upwinded flow fluxes of the given evaluator, see ExplicitNonlinearFlowSolver::share_upwind_fluxes.
+   *         If solve is called with the solution, for which the flow fluxes were retained, only the boundary values of the transported quantity are exchanged.
+   *         Otherwise the flow fluxes are recalculated as usual.
+   */
+  ExplicitTransportSolver(MPI_Comm comm,
+                          std::shared_ptr<GraphStorage> graph,
+                          std::shared_ptr<DofMap> dof_map_flow,
+                          std::shared_ptr<DofMap> dof_map_transport,
+                          std::shared_ptr<const NonlinearFlowUpwindEvaluator> flow_upwind_evaluator);
+
+  ~ExplicitTransportSolver();
+
+  /*! @returns The number of transported species, which are the components of the transport dof map. */
+  std::size_t num_species() const;
+
+  /*! @brief Sets the concentration of the given species at the inflows with a fixed flow as a function of time.
+   *         By default every species enters with a smooth step from 0 to 1.
+   */
+  void set_inflow(std::size_t species, std::function<double(double)> concentration);
+
+  /*! @brief Same as above with a precomputed tabulation of the concentration. */
+  void set_inflow(std::size_t species, tabulated_periodic_function concentration);
+
+  /*! @brief Assembles the transport in the edge pass of the first stage of every step of the given flow solver,
+   *         which reuses the flow at the quadrature points and the upwinded fluxes of the flow kernel, while they are still in the cache.
+   *         The boundary values of the species are sent in the messages of the flow, hence a step needs a single ghost exchange.
+   *         Afterwards solve with the previous solution of the flow only applies the assembled time derivatives.
+   *         Calls of solve, for which the flow solver has assembled nothing, e.g. after its local time stepping, assemble the transport as usual.
+   *         This needs the explicit euler method, no sub-cycles, the quadrature and the flow dof map of the flow solver,
+   *         and the transport solver has to live as long as the flow solver evaluates its right-hand side.
+   */
+  void couple_to(ExplicitNonlinearFlowSolver &flow_solver);
+
+  /*! @brief Uses the explicit euler method for the transport steps. This is the default. */
+  void use_explicit_euler_method();
+
+  /*! @brief Uses the 3rd order ssp method for the transport steps. */
+  void use_ssp_method();
+
+  /*! @brief Takes only a single transport step for num_flow_steps calls of solve.
+   *         The step spans the time of all these calls and uses the time average of their flow solutions.
+   *         The default of 1 takes a transport step in every call.
+   */
+  void set_sub_cycles(std::size_t num_flow_steps);
+
+  /*! @brief Selects the quadrature of the cells, see RightHandSideEvaluator::set_quadrature_type. The default is QuadratureType::gauss. */
+  void set_quadrature_type(QuadratureType type);
 
   std::vector<double> &get_solution();
 
+  /*! @brief Returns the memory of the concentrations, the fluxes and the upwinding. */
+  MemoryReport memory_report() const;
+
+  /*! @brief Writes the current concentrations at time t into a checkpoint, see write_checkpoint. */
+  void write_checkpoint(const std::string &path, double t) const;
+
+  /*! @brief Restores the concentrations from a checkpoint, which might have been written on a different number of ranks.
+   *
+   * @return The time of the checkpoint.
+   */
+  double read_checkpoint(const std::string &path);
+
+  /*! @brief Advances the transport from t to t + dt with the flow solution u_prev at time t.
+   *         If sub-cycling is enabled, u_prev is only accumulated until the sub-cycle is complete.
+   */
   void solve(double t, double dt, const std::vector<double> &u_prev);
 
+  /*! @brief Calculates the upwinded fluxes of all the species at the micro vertices of the given macro edge.
+   *         The flux of species s at micro vertex i is stored at gamma_fluxes_edge[i * num_species() + s].
+   */
   void calculate_fluxes_on_macro_edge(double t,
                                       const Edge &edge,
                                       const std::vector<double> &u_prev,
                                       const std::vector<double> &gamma_prev,
                                       std::vector<double> &gamma_fluxes_edge);
 
+  /*! @brief Assembles the time derivatives of the concentrations, i.e. the right-hand side multiplied with the inverse mass. */
   void assemble_rhs(double t, const std::vector<double> &u_prev, const std::vector<double> &gamma_prev, std::vector<double> &rhs);
 
 private:
-  void calculate_fluxes_at_nfurcations(double t, const std::vector<double> &u_prev);
+  class RightHandSide;
+
+  class CoupledAssembly;
 
-  void apply_inverse_mass();
+  /*! @brief Takes a single transport step from t to t + dt with the fixed flow solution u_flow, which belongs to the time t_flow. */
+  void step(double t, double dt, double t_flow, const std::vector<double> &u_flow);
+
+  /*! @brief Calculates the gamma fluxes at the macro edge boundaries for the flow fluxes at t_flow and the inflow at time t,
+   *         where the given evaluator has upwinded the flow and exchanged the boundary values of the species.
+   */
+  void calculate_fluxes_at_nfurcations(const NonlinearFlowUpwindEvaluator &upwind, double t_flow, double t);
 
 private:
   MPI_Comm d_comm;
@@ -54,20 +139,57 @@ private:
   std::shared_ptr<DofMap> d_dof_map_flow;
   std::shared_ptr<DofMap> d_dof_map_transport;
 
-  NonlinearFlowUpwindEvaluator d_flow_upwind_evaluator;
+  std::size_t d_num_species;
 
-  Communicator d_edge_boundary_communicator;
+  /*! @brief Calculates the flow fluxes and also communicates the macro edge boundary values of all the species. */
+  NonlinearFlowUpwindEvaluator d_flow_upwind_evaluator;
 
-  std::vector<double> d_gamma_macro_edge_boundary_value;
+  /*! @brief The evaluator of the flow solver, whose retained fluxes we consume, or nullptr. */
+  std::shared_ptr<const NonlinearFlowUpwindEvaluator> d_shared_flow_upwind_evaluator;
 
+  /*! @brief The fluxes at the macro edge boundaries of the local edges, see gamma_flux_index. */
   std::vector<double> d_gamma_flux_l;
   std::vector<double> d_gamma_flux_r;
 
-  std::vector<double> d_rhs;
+  /*! @brief The index of the given species at the given edge inside the gamma fluxes, which uses the local edge index of the upwinding. */
+  std::size_t gamma_flux_index(std::size_t edge_id, std::size_t species) const {
+    return d_flow_upwind_evaluator.get_boundary_evaluator().get_local_edge_index()(edge_id) * d_num_species + species;
+  }
+
+  /*! @brief The concentrations of the species at the inflows, which are evaluated once for every stage time. */
+  BoundaryFunctionCache d_inflows;
+
   std::vector<double> d_solution;
 
-  /*! @brief Our current inverse mass vector, defining the diagonal inverse mass matrix. */
-  std::vector<double> d_inverse_mass;
+  /*! @brief The solution before the last step, which is swapped with d_solution in every step. */
+  std::vector<double> d_solution_prev;
+
+  std::unique_ptr<TimeIntegrator> d_time_integrator;
+
+  std::unique_ptr<RightHandSide> d_right_hand_side;
+
+  /*! @brief True, if d_time_integrator is the explicit euler method. */
+  bool d_explicit_euler;
+
+  /*! @brief The assembly in the edge pass of the flow solver, see couple_to, or nullptr. */
+  std::shared_ptr<CoupledAssembly> d_coupled_assembly;
+
+  /*! @brief The quadrature of the cells. */
+  QuadratureType d_quadrature_type;
+
+  /*! @brief The number of calls of solve, for which a single transport step is taken. */
+  std::size_t d_num_sub_cycles;
+
+  /*! @brief The number of flow solutions in the current sub-cycle, its start time and its length. */
+  std::size_t d_num_accumulated;
+  double d_accumulated_t;
+  double d_accumulated_dt;
+
+  /*! @brief The time integral of the times of the flow solutions in the current sub-cycle. */
+  double d_accumulated_flow_t;
+
+  /*! @brief The time integral of the flow solutions in the current sub-cycle. */
+  std::vector<double> d_flow_average;
 };
 
 void calculate_gamma_up_at_bifurcation(const std::vector<double> &sigma,
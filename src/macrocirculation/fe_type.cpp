@@ -10,85 +10,138 @@
 #include <cassert>
 #include <cmath>
 #include <stdexcept>
+#include <string>
 
 namespace macrocirculation {
 
-FETypeNetwork::FETypeNetwork(QuadratureFormula qf, std::size_t degree)
-    : d_qf(std::move(qf)),
-      d_degree(degree),
-      d_phi(d_degree + 1, std::vector<double>(d_qf.size())),
-      d_phi_boundary(2, std::vector<double>(d_degree + 1)),
-      d_dphi(d_degree + 1, std::vector<double>(d_qf.size())), d_JxW(d_qf.size()) {
-  // we only have lagrange polynomials up to order three
-  assert(d_degree < 4);
-
-  // phi inside of cell
-  for (std::size_t qp = 0; qp < d_qf.size(); qp += 1) {
-    d_phi[0][qp] = 1;
-    d_dphi[0][qp] = 0;
-
-    if (d_degree > 0) {
-      d_phi[1][qp] = legendre<1>(d_qf.ref_points[qp]);
-      d_dphi[1][qp] = NAN;
-    }
-
-    if (d_degree > 1) {
-      d_phi[2][qp] = legendre<2>(d_qf.ref_points[qp]);
-      d_dphi[2][qp] = NAN;
+QuadratureFormula create_gauss(std::size_t num_points) {
+  if (num_points == 0)
+    throw std::runtime_error("a gauss formula needs at least one point");
+
+  QuadratureFormula qf;
+  qf.ref_points.resize(num_points);
+  qf.ref_weights.resize(num_points);
+  const double n = static_cast<double>(num_points);
+  for (std::size_t k = 0; k < num_points; k += 1) {
+    // the chebyshev points are a good initial guess for the roots of the legendre polynomial of degree n
+    double x = -std::cos(M_PI * (static_cast<double>(k) + 0.75) / (n + 0.5));
+    double dp = 1;
+    for (std::size_t it = 0; it < 100; it += 1) {
+      // the three term recurrence yields p = P_n(x) and p_prev = P_{n-1}(x)
+      double p = 1, p_prev = 0;
+      for (std::size_t j = 1; j <= num_points; j += 1) {
+        const double p_next = ((2. * j - 1.) * x * p - (j - 1.) * p_prev) / static_cast<double>(j);
+        p_prev = p;
+        p = p_next;
+      }
+      dp = n * (x * p - p_prev) / (x * x - 1.);
+      const double dx = p / dp;
+      x -= dx;
+      if (std::abs(dx) < 1e-15)
+        break;
     }
+    qf.ref_points[k] = x;
+    qf.ref_weights[k] = 2. / ((1. - x * x) * dp * dp);
+  }
+  return qf;
+}
 
-    if (d_degree > 2) {
-      d_phi[3][qp] = legendre<3>(d_qf.ref_points[qp]);
-      d_dphi[3][qp] = NAN;
+QuadratureFormula create_gauss_lobatto(std::size_t num_points) {
+  if (num_points < 2)
+    throw std::runtime_error("a gauss-lobatto formula needs at least the two endpoints");
+
+  QuadratureFormula qf;
+  qf.ref_points.resize(num_points);
+  qf.ref_weights.resize(num_points);
+  // the inner points are the roots of P_n', where n = num_points - 1 is the degree of the interpolating polynomial
+  const std::size_t degree = num_points - 1;
+  const double n = static_cast<double>(degree);
+  for (std::size_t k = 0; k < num_points; k += 1) {
+    // the chebyshev-lobatto points are a good initial guess and already contain the endpoints
+    double x = -std::cos(M_PI * static_cast<double>(k) / n);
+    double p = 1;
+    for (std::size_t it = 0; it < 100; it += 1) {
+      // the three term recurrence yields p = P_n(x) and p_prev = P_{n-1}(x)
+      double p_prev = 0;
+      p = 1;
+      for (std::size_t j = 1; j <= degree; j += 1) {
+        const double p_next = ((2. * j - 1.) * x * p - (j - 1.) * p_prev) / static_cast<double>(j);
+        p_prev = p;
+        p = p_next;
+      }
+      // newton's method for (1 - x^2) P_n'(x) = n (P_{n-1}(x) - x P_n(x)), which also has the endpoints as roots
+      const double dx = (x * p - p_prev) / (num_points * p);
+      x -= dx;
+      if (std::abs(dx) < 1e-15)
+        break;
     }
-
-    if (d_degree > 3)
-      throw std::runtime_error("degree 3 not supported yet");
-
-    d_JxW[qp] = NAN;
+    qf.ref_points[k] = x;
+    qf.ref_weights[k] = 2. / (n * (n + 1.) * p * p);
   }
+  return qf;
+}
 
-  // phi on boundary
-  {
-    d_phi_boundary[0][0] = 1;
-    d_phi_boundary[1][0] = 1;
+namespace {
 
-    if (d_degree > 0) {
-      d_phi_boundary[0][1] = legendre<1>(-1.);
-      d_phi_boundary[1][1] = legendre<1>(+1.);
-    }
+/*! @brief The basis functions at the left and right boundary, which do not depend on the quadrature formula. */
+constexpr FETypeNetwork::BoundaryTable reference_phi_boundary{evaluate_legendre(-1.), evaluate_legendre(+1.)};
 
-    if (d_degree > 1) {
-      d_phi_boundary[0][2] = legendre<2>(-1.);
-      d_phi_boundary[1][2] = legendre<2>(+1.);
-    }
+} // namespace
 
-    if (d_degree > 2) {
-      d_phi_boundary[0][3] = legendre<3>(-1.);
-      d_phi_boundary[1][3] = legendre<3>(+1.);
-    }
+FETypeNetwork::FETypeNetwork(QuadratureFormula qf, std::size_t degree, bool lump_mass)
+    : d_qf(std::move(qf)),
+      d_degree(degree),
+      d_lump_mass(lump_mass),
+      d_phi{},
+      d_phi_boundary(reference_phi_boundary),
+      d_ref_dphi{},
+      d_dphi{},
+      d_JxW{},
+      d_inverse_mass{},
+      d_mass_scaled_phi_JxW{},
+      d_mass_scaled_dphi_JxW{},
+      d_mass_scaled_phi_boundary{} {
+  if (d_degree > max_fe_degree)
+    throw std::runtime_error("degree " + std::to_string(d_degree) + " not supported yet");
+  if (d_qf.size() > max_quad_points)
+    throw std::runtime_error("quadrature formulas with more than " + std::to_string(max_quad_points) + " points are not supported");
 
-    if (d_degree > 3)
-      throw std::runtime_error("degree 3 not supported yet");
+  for (std::size_t qp = 0; qp < d_qf.size(); qp += 1) {
+    const auto phi = evaluate_legendre(d_qf.ref_points[qp]);
+    const auto dphi = evaluate_diff_legendre(d_qf.ref_points[qp]);
+    for (std::size_t i = 0; i <= d_degree; i += 1) {
+      d_phi[i][qp] = phi[i];
+      d_ref_dphi[i][qp] = dphi[i];
+    }
   }
+
+  // the reference element has length 2
+  reinit(2.);
 }
 
 void FETypeNetwork::reinit(double length) {
   for (std::size_t qp = 0; qp < d_qf.size(); qp += 1) {
-    if (d_degree > 0)
-      d_dphi[1][qp] = diff_legendre<1>(d_qf.ref_points[qp]) * 2. / length;
-
-    if (d_degree > 1)
-      d_dphi[2][qp] = diff_legendre<2>(d_qf.ref_points[qp]) * 2. / length;
-
-    if (d_degree > 2)
-      d_dphi[3][qp] = diff_legendre<3>(d_qf.ref_points[qp]) * 2. / length;
-
-    if (d_degree > 3)
-      throw std::runtime_error("degree 3 not supported yet");
-
+    for (std::size_t i = 0; i <= d_degree; i += 1)
+      d_dphi[i][qp] = d_ref_dphi[i][qp] * 2. / length;
     d_JxW[qp] = d_qf.ref_weights[qp] * length / 2.;
   }
+
+  for (std::size_t i = 0; i <= d_degree; i += 1) {
+    double ref_mass = legendre_weight(i);
+    // the quadrature mass stays diagonal for the gauss-lobatto formulas with degree + 1 points, since only P_degree^2 is integrated inexactly
+    if (d_lump_mass) {
+      ref_mass = 0;
+      for (std::size_t qp = 0; qp < d_qf.size(); qp += 1)
+        ref_mass += d_phi[i][qp] * d_phi[i][qp] * d_qf.ref_weights[qp];
+    }
+    d_inverse_mass[i] = 1. / (ref_mass * length / 2.);
+    for (std::size_t qp = 0; qp < d_qf.size(); qp += 1) {
+      d_mass_scaled_phi_JxW[i][qp] = d_phi[i][qp] * d_JxW[qp] * d_inverse_mass[i];
+      d_mass_scaled_dphi_JxW[i][qp] = d_dphi[i][qp] * d_JxW[qp] * d_inverse_mass[i];
+    }
+    d_mass_scaled_phi_boundary[0][i] = d_phi_boundary[0][i] * d_inverse_mass[i];
+    d_mass_scaled_phi_boundary[1][i] = d_phi_boundary[1][i] * d_inverse_mass[i];
+  }
 }
 
 void FETypeNetwork::evaluate_dof_at_quadrature_points(const std::vector<double> &dof_values,
@@ -105,21 +158,14 @@ void FETypeNetwork::evaluate_dof_at_quadrature_points(const std::vector<double>
 }
 
 double FETypeNetwork::evaluate_dof(const std::vector<double> &dof_values, double s) {
-  const size_t degree =  dof_values.size() - 1;
-
-  double value = legendre<0>(s) * dof_values[0];
-
-  if (degree > 0)
-    value += legendre<1>(s) * dof_values[1];
+  if (dof_values.size() > max_fe_degree + 1)
+    throw std::runtime_error("degree " + std::to_string(dof_values.size() - 1) + " not implemented yet");
 
-  if (degree > 1)
-    value += legendre<2>(s) * dof_values[2];
+  const auto phi = evaluate_legendre(s);
 
-  if (degree > 2)
-    value += legendre<3>(s) * dof_values[3];
-
-  if (degree > 3)
-    throw std::runtime_error("degree 3 not implemented yet");
+  double value = phi[0] * dof_values[0];
+  for (std::size_t i = 1; i < dof_values.size(); i += 1)
+    value += phi[i] * dof_values[i];
 
   return value;
 }
@@ -135,27 +181,11 @@ std::size_t FETypeNetwork::get_degree() const {
 EdgeBoundaryValues FETypeNetwork::evaluate_dof_at_boundary_points(const std::vector<double> &dof_values) const {
   EdgeBoundaryValues values{0, 0};
 
-  values.left += legendre<0>(-1) * dof_values[0];
-  values.right += legendre<0>(+1) * dof_values[0];
-
-  if (d_degree > 0) {
-    values.left += legendre<1>(-1) * dof_values[1];
-    values.right += legendre<1>(+1) * dof_values[1];
-  }
-
-  if (d_degree > 1) {
-    values.left += legendre<2>(-1) * dof_values[2];
-    values.right += legendre<2>(+1) * dof_values[2];
+  for (std::size_t i = 0; i <= d_degree; i += 1) {
+    values.left += d_phi_boundary[0][i] * dof_values[i];
+    values.right += d_phi_boundary[1][i] * dof_values[i];
   }
 
-  if (d_degree > 2) {
-    values.left += legendre<3>(-1) * dof_values[3];
-    values.right += legendre<3>(+1) * dof_values[3];
-  }
-
-  if (d_degree > 3)
-    throw std::runtime_error("degree 3 not supported yet");
-
   return values;
 }
 
@@ -174,14 +204,8 @@ void FETypeNetwork::interpolate_linear_function(double v0, double v1, std::vecto
     dof_values[1] = diff;
   }
 
-  if (d_degree > 1)
-    dof_values[2] = 0;
-
-  if (d_degree > 2)
-    dof_values[3] = 0;
-
-  if (d_degree > 3)
-    throw std::runtime_error("degree 3 not supported yet");
+  for (std::size_t i = 2; i <= d_degree; i += 1)
+    dof_values[i] = 0;
 }
 
 QuadraturePointMapper::QuadraturePointMapper(const QuadratureFormula &qf)
@@ -8,6 +8,7 @@
 #ifndef TUMORMODELS_FE_TYPE_HPP
 #define TUMORMODELS_FE_TYPE_HPP
 
+#include <array>
 #include <utility>
 #include <vector>
 
@@ -34,6 +35,18 @@ template<>
 constexpr double legendre<3>(double x) {
   return 0.5 * (5 * x * x * x - 3 * x);
 }
+template<>
+constexpr double legendre<4>(double x) {
+  return (35 * x * x * x * x - 30 * x * x + 3) / 8.;
+}
+template<>
+constexpr double legendre<5>(double x) {
+  return (63 * x * x * x * x * x - 70 * x * x * x + 15 * x) / 8.;
+}
+template<>
+constexpr double legendre<6>(double x) {
+  return (231 * x * x * x * x * x * x - 315 * x * x * x * x + 105 * x * x - 5) / 16.;
+}
 
 // Collection of their derivatives
 template<std::size_t degree>
@@ -54,6 +67,77 @@ template<>
 constexpr double diff_legendre<3>(double x) {
   return 0.5 * (15 * x * x - 3);
 }
+template<>
+constexpr double diff_legendre<4>(double x) {
+  return 0.5 * (35 * x * x * x - 15 * x);
+}
+template<>
+constexpr double diff_legendre<5>(double x) {
+  return (315 * x * x * x * x - 210 * x * x + 15) / 8.;
+}
+template<>
+constexpr double diff_legendre<6>(double x) {
+  return (693 * x * x * x * x * x - 630 * x * x * x + 105 * x) / 8.;
+}
+
+/*! @brief The highest degree of the legendre basis. */
+constexpr std::size_t max_fe_degree = 6;
+
+/*! @brief The smallest number of gauss points, which is sufficient for the shape functions of the given degree.
+ *         We integrate polynomials of degree 2 * degree + 3 exactly, i.e. the quadratic part Q^2 of the flux times the test functions
+ *         up to degree 4. Constant shape functions give constant fluxes, hence the midpoint rule is exact for degree 0.
+ */
+constexpr std::size_t num_gauss_points(std::size_t degree) {
+  return degree == 0 ? 1 : degree + 2;
+}
+
+/*! @brief The number of gauss points for over-integration, which integrate polynomials of degree 3 * degree + 3 exactly.
+ *         This removes the aliasing of the quadratic part of the fluxes at every degree.
+ */
+constexpr std::size_t num_over_integration_points(std::size_t degree) {
+  return (3 * degree + 5) / 2;
+}
+
+/*! @brief The number of gauss-lobatto points for the shape functions of the given degree, i.e. one point per dof and at least the two endpoints. */
+constexpr std::size_t num_lobatto_points(std::size_t degree) {
+  return degree < 1 ? 2 : degree + 1;
+}
+
+/*! @brief The highest number of points of the quadrature formulas below. */
+constexpr std::size_t max_quad_points = num_over_integration_points(max_fe_degree);
+
+/*! @brief The quadrature formulas the cells of the explicit solvers can be integrated with.
+ *
+ *  - gauss integrates the mass and the polynomial part of the fluxes exactly with num_gauss_points.
+ *  - gauss_over_integration uses the num_over_integration_points for strongly nonlinear problems, at the price of more flux evaluations.
+ *  - gauss_lobatto collocates the fluxes at the num_lobatto_points nodes including the endpoints and lumps the mass matrix,
+ *    which is the nodal DG spectral element method written in the legendre basis. It needs fewer flux evaluations at the price of some aliasing.
+ */
+enum class QuadratureType { gauss, gauss_lobatto, gauss_over_integration };
+
+/*! @brief The number of points of the given quadrature type for shape functions of the given degree. */
+constexpr std::size_t num_quadrature_points(QuadratureType type, std::size_t degree) {
+  if (type == QuadratureType::gauss_lobatto)
+    return num_lobatto_points(degree);
+  if (type == QuadratureType::gauss_over_integration)
+    return num_over_integration_points(degree);
+  return num_gauss_points(degree);
+}
+
+/*! @brief The squared L2 norm of the legendre polynomial of the given degree on [-1,+1], i.e. the diagonal of the mass matrix. */
+constexpr double legendre_weight(std::size_t degree) {
+  return 2. / (2. * static_cast<double>(degree) + 1.);
+}
+
+/*! @brief Evaluates all the legendre polynomials up to max_fe_degree at x. */
+constexpr std::array<double, max_fe_degree + 1> evaluate_legendre(double x) {
+  return {legendre<0>(x), legendre<1>(x), legendre<2>(x), legendre<3>(x), legendre<4>(x), legendre<5>(x), legendre<6>(x)};
+}
+
+/*! @brief Evaluates the derivatives of all the legendre polynomials up to max_fe_degree at x. */
+constexpr std::array<double, max_fe_degree + 1> evaluate_diff_legendre(double x) {
+  return {diff_legendre<0>(x), diff_legendre<1>(x), diff_legendre<2>(x), diff_legendre<3>(x), diff_legendre<4>(x), diff_legendre<5>(x), diff_legendre<6>(x)};
+}
 
 /*! @brief Representation of a quadrature formula for the network. */
 struct QuadratureFormula {
@@ -79,6 +163,26 @@ inline QuadratureFormula create_gauss3() {
   return qf;
 }
 
+/*! @brief Creates a gauss quadrature formula with the given number of points, which are calculated with newton's method. */
+QuadratureFormula create_gauss(std::size_t num_points);
+
+/*! @brief Creates the gauss quadrature formula with num_gauss_points(degree) points for shape functions of the given degree. */
+inline QuadratureFormula create_gauss_for_degree(std::size_t degree) {
+  return num_gauss_points(degree) == 4 ? create_gauss4() : create_gauss(num_gauss_points(degree));
+}
+
+/*! @brief Creates a gauss-lobatto quadrature formula with the given number of points including both endpoints, which is exact for polynomials of degree 2 * num_points - 3. */
+QuadratureFormula create_gauss_lobatto(std::size_t num_points);
+
+/*! @brief Creates the quadrature formula of the given type for shape functions of the given degree. */
+inline QuadratureFormula create_quadrature_for_degree(QuadratureType type, std::size_t degree) {
+  if (type == QuadratureType::gauss_lobatto)
+    return create_gauss_lobatto(num_lobatto_points(degree));
+  if (type == QuadratureType::gauss_over_integration)
+    return create_gauss(num_over_integration_points(degree));
+  return create_gauss_for_degree(degree);
+}
+
 /*! @brief Creates tabulates the weights and points of the trapezoidal rule. */
 inline QuadratureFormula create_trapezoidal_rule() {
   QuadratureFormula qf;
@@ -100,34 +204,66 @@ struct EdgeBoundaryValues {
   double right;
 };
 
-/*! @brief Class for evaluating the legendre shape functions on our network edges. */
+/*! @brief Class for evaluating the legendre shape functions on our network edges.
+ *
+ *  The tables have a fixed size for the highest degree and the largest quadrature formula, such that they live inside the object.
+ *  Only the entries up to the degree and the number of quadrature points are meaningful.
+ *
+ *  Since the legendre polynomials are orthogonal, the mass matrix on a micro edge is diagonal.
+ *  Hence the explicit solvers test with the mass scaled tables, i.e. the test functions times the inverse of their mass,
+ *  which gives the time derivatives of the dofs directly and needs neither an inverse mass vector nor a sweep over it.
+ *  With a lumped mass, the mass is integrated with the quadrature formula instead, see QuadratureType::gauss_lobatto.
+ */
 class FETypeNetwork {
 public:
-  FETypeNetwork(QuadratureFormula qf, std::size_t degree);
+  using ShapeTable = std::array<std::array<double, max_quad_points>, max_fe_degree + 1>;
+
+  using BoundaryTable = std::array<std::array<double, max_fe_degree + 1>, 2>;
+
+  using WeightTable = std::array<double, max_quad_points>;
+
+  using BasisTable = std::array<double, max_fe_degree + 1>;
 
-  /*! @brief Updates the shape function values on the given edge. */
+  /*! @brief Creates the shape functions of the given degree, whose mass is integrated with qf, if lump_mass is true, or exactly otherwise. */
+  FETypeNetwork(QuadratureFormula qf, std::size_t degree, bool lump_mass = false);
+
+  /*! @brief Updates the shape function values on the given edge.
+   *         Only the derivatives, the weights and the mass depend on the length, hence the reference tables are just scaled.
+   */
   void reinit(double length);
 
   /*! @returns Returns a list of basis functions evaluated at the quadrature points.
    *           The list is structured by phi[ <shape-function-index> ][ <quadrature-point-index> ],
    *           which is the same as in libmesh.
    */
-  const std::vector<std::vector<double>> &get_phi() const { return d_phi; };
+  const ShapeTable &get_phi() const { return d_phi; };
 
   /*! @returns Returns a list of basis functions evaluated at the boundary poitns.
-   *           The list is structured by phi[ <shape-function-index> ][ <boundary-index> ],
+   *           The list is structured by phi[ <boundary-index> ][ <shape-function-index> ],
    *           where the left boundary has index 0 and the right boundary an index of 1.
    */
-  const std::vector<std::vector<double>> &get_phi_boundary() const { return d_phi_boundary; };
+  const BoundaryTable &get_phi_boundary() const { return d_phi_boundary; };
 
   /*! @returns Returns a list of derivative of basis functions evaluated at the quadrature points.
    *           The list is structured by dphi[ <shape-function-index> ][ <quadrature-point-index> ],
    *           which is the same as in libmesh.
    */
-  const std::vector<std::vector<double>> &get_dphi() const { return d_dphi; };
+  const ShapeTable &get_dphi() const { return d_dphi; };
 
   /*! @returns Returns a list of quadrature weights at each quadrature point. */
-  const std::vector<double> &get_JxW() const { return d_JxW; };
+  const WeightTable &get_JxW() const { return d_JxW; };
+
+  /*! @returns The inverse of the diagonal mass matrix on a micro edge of the length given to reinit, i.e. (2i+1)/length without lumping. */
+  const BasisTable &get_inverse_mass() const { return d_inverse_mass; };
+
+  /*! @returns The table phi[i][qp] * JxW[qp] * inverse_mass[i] for testing with the inverse mass folded in. */
+  const ShapeTable &get_mass_scaled_phi_JxW() const { return d_mass_scaled_phi_JxW; };
+
+  /*! @returns The table dphi[i][qp] * JxW[qp] * inverse_mass[i] for testing with the inverse mass folded in. */
+  const ShapeTable &get_mass_scaled_dphi_JxW() const { return d_mass_scaled_dphi_JxW; };
+
+  /*! @returns The table phi_boundary[b][i] * inverse_mass[i] for testing with the inverse mass folded in. */
+  const BoundaryTable &get_mass_scaled_phi_boundary() const { return d_mass_scaled_phi_boundary; };
 
   /*! @brief Evaluates the function with the given dof values at the quadratures points. */
   void evaluate_dof_at_quadrature_points(const std::vector<double> &dof_values,
@@ -156,13 +292,26 @@ private:
 
   std::size_t d_degree;
 
-  std::vector<std::vector<double>> d_phi;
+  bool d_lump_mass;
+
+  ShapeTable d_phi;
+
+  BoundaryTable d_phi_boundary;
+
+  /*! @brief The derivatives of the basis functions on the reference interval [-1,+1]. */
+  ShapeTable d_ref_dphi;
+
+  ShapeTable d_dphi;
+
+  WeightTable d_JxW;
+
+  BasisTable d_inverse_mass;
 
-  std::vector<std::vector<double>> d_phi_boundary;
+  ShapeTable d_mass_scaled_phi_JxW;
 
-  std::vector<std::vector<double>> d_dphi;
+  ShapeTable d_mass_scaled_dphi_JxW;
 
-  std::vector<double> d_JxW;
+  BoundaryTable d_mass_scaled_phi_boundary;
 };
 
 class QuadraturePointMapper {
@@ -0,0 +1,451 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "graph_binary_writer.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iterator>
+#include <nlohmann/json.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include "communication/mpi.hpp"
+#include "dof_map.hpp"
+#include "graph_storage.hpp"
+#include "phase_timers.hpp"
+
+namespace macrocirculation {
+
+namespace {
+
+bool is_little_endian() {
+  const std::uint16_t value = 1;
+  return *reinterpret_cast<const std::uint8_t *>(&value) == 1;
+}
+
+template<typename T>
+void append_bytes(std::vector<char> &bytes, const T &value) {
+  const auto *begin = reinterpret_cast<const char *>(&value);
+  bytes.insert(bytes.end(), begin, begin + sizeof(T));
+}
+
+template<typename T>
+T read_bytes(const char *&it) {
+  T value;
+  std::memcpy(&value, it, sizeof(T));
+  it += sizeof(T);
+  return value;
+}
+
+/*! @brief Appends the difference as varint, where the zigzag encoding maps small negative differences to small unsigned integers. */
+void append_varint(std::vector<char> &bytes, std::int64_t difference) {
+  auto value = (static_cast<std::uint64_t>(difference) << 1) ^ static_cast<std::uint64_t>(difference >> 63);
+  while (value >= 0x80) {
+    bytes.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  bytes.push_back(static_cast<char>(value));
+}
+
+std::int64_t read_varint(const char *&it) {
+  std::uint64_t value = 0;
+  for (unsigned shift = 0;; shift += 7) {
+    const auto byte = static_cast<std::uint8_t>(*it++);
+    value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+    if (byte < 0x80)
+      break;
+  }
+  return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+} // namespace
+
+GraphBinaryWriter::GraphBinaryWriter(MPI_Comm comm,
+                                     std::string foldername,
+                                     std::string datasetname,
+                                     std::shared_ptr<GraphStorage> graph)
+    : d_comm(comm),
+      d_foldername(std::move(foldername)),
+      d_datasetname(std::move(datasetname)),
+      d_graph(std::move(graph)),
+      d_is_setup(false),
+      d_shared_file(false),
+      d_io_comm(MPI_COMM_NULL),
+      d_shared_fh(MPI_FILE_NULL),
+      d_step_size(0),
+      d_record_offset(0),
+      d_num_written_steps(0) {}
+
+GraphBinaryWriter::~GraphBinaryWriter() {
+  if (d_shared_fh != MPI_FILE_NULL)
+    MPI_File_close(&d_shared_fh);
+  if (d_io_comm != MPI_COMM_NULL)
+    MPI_Comm_free(&d_io_comm);
+}
+
+void GraphBinaryWriter::set_shared_file(bool shared_file) {
+  if (d_is_setup)
+    throw std::runtime_error("the file layout cannot be changed after setup was called");
+  d_shared_file = shared_file;
+}
+
+void GraphBinaryWriter::add_setup_data(
+  const std::shared_ptr<DofMap> &dof_map,
+  size_t component_idx,
+  const std::string &component_name,
+  double tolerance) {
+  if (d_is_setup)
+    throw std::runtime_error("cannot add setup data after setup was called");
+  if (tolerance < 0)
+    throw std::runtime_error("the tolerance of " + component_name + " has to be non negative");
+
+  d_data_map[component_name] = {dof_map, component_idx, component_name, tolerance};
+}
+
+void GraphBinaryWriter::set_output_resolution(const OutputResolution &resolution) {
+  if (d_is_setup)
+    throw std::runtime_error("cannot change the output resolution after setup was called");
+  d_resolution = resolution;
+}
+
+void GraphBinaryWriter::setup() {
+  d_is_setup = true;
+  d_samplers.clear();
+  for (auto eid : d_graph->get_active_edge_ids(mpi::rank(d_comm)))
+    d_samplers.emplace(eid, EdgeSampler(d_graph->edge(eid), d_resolution));
+
+  if (d_shared_file) {
+    // the records in the shared file need a fixed size
+    if (is_quantized())
+      throw std::runtime_error("the shared file does not support lossy components");
+    setup_shared_file();
+    write_meta_file();
+    return;
+  }
+
+  // the file is only created by the first write
+  d_file.close();
+  d_record.resize(get_record_size(mpi::rank(d_comm)));
+  d_quantized.assign(d_record.size(), 0);
+
+  write_meta_file();
+}
+
+bool GraphBinaryWriter::is_quantized() const {
+  for (const auto &data_it : d_data_map)
+    if (data_it.second.tolerance > 0)
+      return true;
+  return false;
+}
+
+void GraphBinaryWriter::add_data(const std::string &name, const std::vector<double> &u) {
+  if (!d_is_setup)
+    throw std::runtime_error("data can only be added after calling setup");
+  if (d_data_map.count(name) == 0)
+    throw std::runtime_error("key " + name + " was not added in setup phase");
+  d_data.emplace(name, std::cref(u));
+}
+
+MemoryReport GraphBinaryWriter::memory_report() const {
+  MemoryReport report;
+  report.add("record", d_record);
+  report.add("quantized record", d_quantized);
+  report.add("encoded record", d_bytes);
+  return report;
+}
+
+void GraphBinaryWriter::write(double t) {
+  SCOPED_PHASE_TIMER("output");
+  std::size_t idx = 0;
+  d_record[idx++] = t;
+
+  for (auto &data_it : d_data_map) {
+    if (d_data.count(data_it.first) == 0)
+      throw std::runtime_error("component " + data_it.first + " was not added for writing");
+
+    const auto &u = d_data.at(data_it.first).get();
+    const auto &data = data_it.second;
+
+    for (auto eid : d_graph->get_active_edge_ids(mpi::rank(d_comm))) {
+      const auto &local_dof_map = data.dof_map->get_local_dof_map(d_graph->edge(eid));
+      const auto &sampler = d_samplers.at(eid);
+      for (std::size_t k = 0; k < sampler.size(); k += 1)
+        d_record[idx++] = sampler.evaluate(local_dof_map, u, data.component_idx, k);
+    }
+  }
+
+  if (!d_shared_file && !d_file.is_open())
+    open_file();
+
+  if (d_shared_file) {
+    write_shared_file();
+  } else if (is_quantized()) {
+    encode_record();
+    d_file.write(d_bytes.data(), static_cast<std::streamsize>(d_bytes.size()));
+    d_file.flush();
+  } else {
+    d_file.write(reinterpret_cast<const char *>(d_record.data()), static_cast<std::streamsize>(d_record.size() * sizeof(double)));
+    // without flushing a crashed run would lose its output
+    d_file.flush();
+  }
+
+  d_data.clear();
+}
+
+void GraphBinaryWriter::encode_record() {
+  d_bytes.clear();
+  append_bytes(d_bytes, d_record[0]);
+  append_bytes(d_bytes, std::uint64_t(0));
+  const std::size_t header_size = d_bytes.size();
+
+  // every component has the same number of values in the order of the index
+  const std::size_t num_values = (d_record.size() - 1) / d_data_map.size();
+  std::size_t idx = 1;
+  for (const auto &data_it : d_data_map) {
+    const double tolerance = data_it.second.tolerance;
+    if (tolerance > 0) {
+      const double inv_step = 0.5 / tolerance;
+      for (std::size_t k = idx; k < idx + num_values; k += 1) {
+        const double scaled = d_record[k] * inv_step;
+        if (!(std::abs(scaled) < 4e18))
+          throw std::runtime_error("the value " + std::to_string(d_record[k]) + " of " + data_it.first + " cannot be quantized with the tolerance " + std::to_string(tolerance));
+        const auto quantized = static_cast<std::int64_t>(std::llround(scaled));
+        append_varint(d_bytes, quantized - d_quantized[k]);
+        d_quantized[k] = quantized;
+      }
+    } else {
+      for (std::size_t k = idx; k < idx + num_values; k += 1)
+        append_bytes(d_bytes, d_record[k]);
+    }
+    idx += num_values;
+  }
+
+  const auto payload_size = static_cast<std::uint64_t>(d_bytes.size() - header_size);
+  std::memcpy(d_bytes.data() + sizeof(double), &payload_size, sizeof(payload_size));
+}
+
+void GraphBinaryWriter::open_file() {
+  const auto path = get_binary_file_path(mpi::rank(d_comm));
+  d_file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!d_file)
+    throw std::runtime_error("could not open " + path + " for writing");
+}
+
+void GraphBinaryWriter::setup_shared_file() {
+  const auto rank = mpi::rank(d_comm);
+
+  d_step_size = get_record_offset(mpi::size(d_comm));
+  d_record_offset = get_record_offset(rank);
+  d_record.resize(get_record_size(rank));
+
+  // the ranks without edges neither open the file nor take part in the collective writes
+  CHECK_MPI_SUCCESS(MPI_Comm_split(d_comm, owns_edges(rank) ? 0 : MPI_UNDEFINED, rank, &d_io_comm));
+  if (d_io_comm == MPI_COMM_NULL)
+    return;
+
+  const auto path = d_foldername + "/" + get_shared_file_name();
+  if (MPI_File_open(d_io_comm, path.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &d_shared_fh) != MPI_SUCCESS)
+    throw std::runtime_error("could not open " + path + " for writing");
+  CHECK_MPI_SUCCESS(MPI_File_set_size(d_shared_fh, 0));
+}
+
+void GraphBinaryWriter::write_shared_file() {
+  if (d_io_comm == MPI_COMM_NULL)
+    return;
+
+  const auto offset = static_cast<MPI_Offset>((d_num_written_steps * d_step_size + d_record_offset) * sizeof(double));
+  CHECK_MPI_SUCCESS(MPI_File_write_at_all(d_shared_fh, offset, d_record.data(), static_cast<int>(d_record.size()), MPI_DOUBLE, MPI_STATUS_IGNORE));
+  d_num_written_steps += 1;
+}
+
+bool GraphBinaryWriter::owns_edges(int rank) const {
+  return !d_graph->get_active_edge_ids(rank).empty();
+}
+
+std::size_t GraphBinaryWriter::get_record_offset(int rank) const {
+  std::size_t offset = 0;
+  for (int r = 0; r < rank; r += 1)
+    if (owns_edges(r))
+      offset += get_record_size(r);
+  return offset;
+}
+
+std::size_t GraphBinaryWriter::get_record_size(int rank) const {
+  // the dof maps of the other ranks are not initialized here, but the graph knows the number of points of all the edges
+  std::size_t record_size = 1;
+  for (auto eid : d_graph->get_active_edge_ids(rank))
+    record_size += d_data_map.size() * d_resolution.num_points(d_graph->edge(eid));
+  return record_size;
+}
+
+std::string GraphBinaryWriter::get_meta_file_name() const {
+  return d_foldername + "/" + d_datasetname + ".json";
+}
+
+std::string GraphBinaryWriter::get_binary_file_name(int rank) const {
+  std::stringstream name;
+  name << d_datasetname << "_rank" << std::setfill('0') << std::setw(5) << rank << ".bin";
+  return name.str();
+}
+
+std::string GraphBinaryWriter::get_shared_file_name() const {
+  return d_datasetname + ".bin";
+}
+
+std::string GraphBinaryWriter::get_binary_file_path(int rank) const {
+  return d_foldername + "/" + get_binary_file_name(rank);
+}
+
+void GraphBinaryWriter::write_meta_file() const {
+  // only one rank writes the file
+  if (mpi::rank(d_comm) != 0)
+    return;
+
+  using json = nlohmann::json;
+
+  auto rank_list = json::array();
+  auto vessel_list = json::array();
+  for (int rank = 0; rank < mpi::size(d_comm); rank += 1) {
+    if (d_shared_file) {
+      // a rank without edges has no record in the shared file
+      const std::size_t record_size = owns_edges(rank) ? get_record_size(rank) : 0;
+      rank_list.push_back({{"filepath", get_shared_file_name()}, {"record_size", record_size}, {"record_offset", get_record_offset(rank)}});
+    } else {
+      rank_list.push_back({{"filepath", get_binary_file_name(rank)}, {"record_size", get_record_size(rank)}});
+    }
+
+    // the offsets of the vessels within a record follow the loops of write
+    std::map<std::size_t, json> offsets;
+    std::size_t offset = 1;
+    for (auto &data_it : d_data_map) {
+      for (auto eid : d_graph->get_active_edge_ids(rank)) {
+        offsets[eid][data_it.first] = offset;
+        offset += d_resolution.num_points(d_graph->edge(eid));
+      }
+    }
+
+    for (auto eid : d_graph->get_active_edge_ids(rank)) {
+      const auto &edge = d_graph->edge(eid);
+
+      const auto &vertex_left = d_graph->vertex(edge.get_vertex_neighbors()[0]);
+      const auto &vertex_right = d_graph->vertex(edge.get_vertex_neighbors()[1]);
+
+      const auto coordinates = EdgeSampler(edge, d_resolution).get_coordinates();
+
+      auto &pdata = edge.get_physical_data();
+
+      json vertices_obj = {
+        {"left",
+         {{"id", vertex_left.get_id()},
+          {"name", vertex_left.get_name()}}},
+        {"right",
+         {{"id", vertex_right.get_id()},
+          {"name", vertex_right.get_name()}}}};
+
+      json vessel_obj = {
+        {"edge_id", edge.get_id()},
+        {"name", edge.get_name()},
+        {"coordinates", coordinates},
+        {"rank", rank},
+        {"offsets", offsets[eid]},
+        {"num_values", coordinates.size()},
+        {"vertices", vertices_obj},
+        {"A0", pdata.A0},
+        {"G0", pdata.G0}};
+
+      vessel_list.push_back(vessel_obj);
+    }
+  }
+
+  // the components in the order of the records
+  auto component_list = json::array();
+  for (const auto &data_it : d_data_map)
+    component_list.push_back({{"name", data_it.first}, {"tolerance", data_it.second.tolerance}});
+
+  json j;
+  j["format"] = "binary";
+  j["byte_order"] = is_little_endian() ? "little" : "big";
+  j["components"] = component_list;
+  if (is_quantized())
+    j["encoding"] = "quantized_delta";
+  j["ranks"] = rank_list;
+  if (d_shared_file)
+    j["step_size"] = get_record_offset(mpi::size(d_comm));
+  j["vessels"] = vessel_list;
+
+  std::ofstream f(get_meta_file_name(), std::ios::out);
+  f << j.dump(1);
+}
+
+std::vector<std::vector<double>> read_binary_records(const std::string &foldername, const std::string &datasetname, int rank) {
+  nlohmann::json meta;
+  std::ifstream meta_file(foldername + "/" + datasetname + ".json");
+  if (!meta_file)
+    throw std::runtime_error("could not open the index of " + datasetname);
+  meta_file >> meta;
+  if (meta.value("byte_order", "little") != (is_little_endian() ? "little" : "big"))
+    throw std::runtime_error("the records were written with a different byte order");
+
+  const auto &rank_info = meta["ranks"].at(static_cast<std::size_t>(rank));
+  const std::size_t record_size = rank_info["record_size"];
+  const std::size_t step_size = meta.value("step_size", record_size);
+  const std::size_t record_offset = rank_info.value("record_offset", std::size_t(0));
+
+  std::ifstream file(foldername + "/" + rank_info["filepath"].get<std::string>(), std::ios::binary);
+  const std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+  std::vector<std::vector<double>> records;
+  if (!meta.contains("encoding")) {
+    // a record, which is still being written, is ignored
+    const std::size_t num_steps = bytes.size() / (step_size * sizeof(double));
+    for (std::size_t step = 0; step < num_steps; step += 1) {
+      records.emplace_back(record_size);
+      std::memcpy(records.back().data(), bytes.data() + (step * step_size + record_offset) * sizeof(double), record_size * sizeof(double));
+    }
+    return records;
+  }
+
+  std::vector<double> tolerances;
+  for (const auto &component : meta["components"])
+    tolerances.push_back(component["tolerance"]);
+  const std::size_t num_values = (record_size - 1) / tolerances.size();
+
+  std::vector<std::int64_t> quantized(record_size, 0);
+  const std::size_t header_size = sizeof(double) + sizeof(std::uint64_t);
+  std::size_t position = 0;
+  while (position + header_size <= bytes.size()) {
+    const char *it = bytes.data() + position;
+    const double t = read_bytes<double>(it);
+    const auto payload_size = read_bytes<std::uint64_t>(it);
+    if (position + header_size + payload_size > bytes.size())
+      break;
+
+    std::vector<double> record(record_size);
+    record[0] = t;
+    std::size_t idx = 1;
+    for (double tolerance : tolerances) {
+      for (std::size_t k = idx; k < idx + num_values; k += 1) {
+        if (tolerance > 0) {
+          quantized[k] += read_varint(it);
+          record[k] = 2 * tolerance * static_cast<double>(quantized[k]);
+        } else {
+          record[k] = read_bytes<double>(it);
+        }
+      }
+      idx += num_values;
+    }
+    records.push_back(std::move(record));
+    position += header_size + payload_size;
+  }
+  return records;
+}
+
+} // namespace macrocirculation
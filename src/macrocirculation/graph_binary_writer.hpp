@@ -0,0 +1,175 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_GRAPH_BINARY_WRITER_HPP
+#define TUMORMODELS_GRAPH_BINARY_WRITER_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+#include "memory_report.hpp"
+#include "output_resolution.hpp"
+
+namespace macrocirculation {
+
+class GraphStorage;
+class DofMap;
+
+/*! @brief Writes the same vessel data as the GraphCSVWriter into a single binary file per rank.
+ *
+ *         Every call to write appends one record of doubles in the native byte order to the file of each rank,
+ *         which starts with the time, followed by the values at the output points, by default the left and right boundary
+ *         values of all the micro edges, of each component on each active edge of the rank.
+ *         The files are created by the first write and stay open between the writes, such that an output step costs a single write call per rank.
+ *         A json index written by rank 0 contains for every vessel the file of its rank and the offsets
+ *         of its components within a record, see tools/visualization/graph_data.py for a reader.
+ *
+ *         For many ranks the number of files can be reduced to a single one with set_shared_file,
+ *         where the records of all the ranks owning edges follow each other in rank order for each time step.
+ *         They are written with collective MPI-IO, in which only the ranks owning edges participate.
+ *
+ *         Components with a positive tolerance are stored lossy in the files per rank: Their values are rounded to integer
+ *         multiples of twice the tolerance, and the differences of these integers to the previous record are written as
+ *         zigzag encoded varints, which need a single byte for slowly changing values. The decoded values differ at most by the
+ *         tolerance from the written ones, and the errors do not accumulate over the records. Such a record consists of the time,
+ *         the number of bytes, which follow, and the components in the order of the index, where the lossless ones stay doubles.
+ */
+class GraphBinaryWriter {
+public:
+  GraphBinaryWriter(MPI_Comm comm,
+                    std::string foldername,
+                    std::string datasetname,
+                    std::shared_ptr<GraphStorage> graph);
+
+  GraphBinaryWriter(const GraphBinaryWriter &) = delete;
+  GraphBinaryWriter &operator=(const GraphBinaryWriter &) = delete;
+
+  /*! @brief Closes the shared file, which is collective over the ranks owning edges. */
+  ~GraphBinaryWriter();
+
+  /*! @brief Writes the records of all ranks into a single file with MPI-IO instead of one file per rank.
+   *         Has to be called before setup on all the ranks.
+   */
+  void set_shared_file(bool shared_file);
+
+  /*! @brief Adds a component, which is stored lossless or, for a positive tolerance, lossy with at most this absolute error. */
+  void add_setup_data(
+    const std::shared_ptr<DofMap> &dof_map,
+    size_t component_idx,
+    const std::string &component_name,
+    double tolerance = 0);
+
+  /*! @brief Sets the points along the vessels, at which the values are written. Has to be called before setup on all the ranks. */
+  void set_output_resolution(const OutputResolution &resolution);
+
+  /*! @brief Truncates the file of our rank and writes the index. */
+  void setup();
+
+  void add_data(const std::string &name, const std::vector<double> &u);
+
+  void write(double t);
+
+  /*! @brief Returns the memory of the record buffer. */
+  MemoryReport memory_report() const;
+
+private:
+  MPI_Comm d_comm;
+  std::string d_foldername;
+  std::string d_datasetname;
+
+  std::shared_ptr<GraphStorage> d_graph;
+
+  bool d_is_setup;
+
+  bool d_shared_file;
+
+  /*! @brief The ranks owning edges, which write into the shared file, or MPI_COMM_NULL. */
+  MPI_Comm d_io_comm;
+
+  MPI_File d_shared_fh;
+
+  /*! @brief The number of doubles in a time step of the shared file. */
+  std::size_t d_step_size;
+
+  /*! @brief The position of our record within a time step of the shared file. */
+  std::size_t d_record_offset;
+
+  std::size_t d_num_written_steps;
+
+  struct Data {
+    std::shared_ptr<DofMap> dof_map;
+    size_t component_idx;
+    std::string component_name;
+    double tolerance;
+  };
+
+  std::map<std::string, Data> d_data_map;
+
+  OutputResolution d_resolution;
+
+  /*! @brief The output points of our active edges. */
+  std::map<std::size_t, EdgeSampler> d_samplers;
+
+  std::map<std::string, std::reference_wrapper<const std::vector<double>>> d_data;
+
+  /*! @brief The file of our rank, which is opened by the first write. */
+  std::ofstream d_file;
+
+  /*! @brief The record, which is assembled before it is written in one go. */
+  std::vector<double> d_record;
+
+  /*! @brief The quantized values of the previous record, against which the lossy components are encoded. */
+  std::vector<std::int64_t> d_quantized;
+
+  /*! @brief The encoded record of the lossy components. */
+  std::vector<char> d_bytes;
+
+  /*! @brief True, if any component is stored lossy. */
+  bool is_quantized() const;
+
+  /*! @brief Encodes the assembled record into d_bytes. */
+  void encode_record();
+
+  /*! @brief The number of values in a record of the given rank. */
+  std::size_t get_record_size(int rank) const;
+
+  /*! @brief The position of the record of the given rank within a time step of the shared file. */
+  std::size_t get_record_offset(int rank) const;
+
+  /*! @brief Ranks without edges do not write anything into the shared file. */
+  bool owns_edges(int rank) const;
+
+  /*! @brief Creates the file of our rank, which truncates the one of a previous run. */
+  void open_file();
+
+  void setup_shared_file();
+
+  void write_shared_file();
+
+  void write_meta_file() const;
+
+  std::string get_meta_file_name() const;
+
+  std::string get_binary_file_name(int rank) const;
+  std::string get_shared_file_name() const;
+  std::string get_binary_file_path(int rank) const;
+};
+
+/*! @brief Reads all the complete records, which a GraphBinaryWriter wrote into the file of the given rank, and decodes the lossy components.
+ *         Every record starts with the time, followed by the components with the offsets of the index.
+ */
+std::vector<std::vector<double>> read_binary_records(const std::string &foldername, const std::string &datasetname, int rank);
+
+} // namespace macrocirculation
+
+#endif
@@ -0,0 +1,368 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "graph_cache.hpp"
+
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include "graph_storage.hpp"
+
+namespace macrocirculation {
+
+namespace {
+
+/*! @brief Identifies our graph caches and their version, which has to be increased whenever the layout changes. */
+constexpr std::array<char, 8> graph_cache_magic = {'M', 'C', '1', 'D', 'G', 'R', 'C', '1'};
+
+/*! @brief The boundary conditions, which can be stored in a cache. */
+enum class BoundaryType : std::uint64_t { undefined = 0,
+                                          free_outflow = 1,
+                                          windkessel = 2,
+                                          vessel_tree = 3,
+                                          rcl = 4,
+                                          linear_characteristic = 5,
+                                          nonlinear_characteristic = 6 };
+
+/*! @brief Appends the binary representation of the values to a buffer, which is written in one go. */
+class CacheWriter {
+public:
+  template<typename T>
+  void write(const T &value) {
+    d_buffer.write(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+
+  void write(const std::string &value) {
+    write<std::uint64_t>(value.size());
+    d_buffer.write(value.data(), static_cast<std::streamsize>(value.size()));
+  }
+
+  void write(const std::vector<double> &values) {
+    write<std::uint64_t>(values.size());
+    d_buffer.write(reinterpret_cast<const char *>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(double)));
+  }
+
+  std::string str() const { return d_buffer.str(); }
+
+private:
+  std::stringstream d_buffer;
+};
+
+/*! @brief Reads the values from the contents of a cache, which were read in one go. */
+class CacheReader {
+public:
+  explicit CacheReader(std::string data) : d_data(std::move(data)), d_position(0) {}
+
+  template<typename T>
+  T read() {
+    T value;
+    std::memcpy(&value, next(sizeof(T)), sizeof(T));
+    return value;
+  }
+
+  std::string read_string() {
+    const auto size = static_cast<std::size_t>(read<std::uint64_t>());
+    return std::string(next(size), size);
+  }
+
+  std::vector<double> read_vector() {
+    const auto size = static_cast<std::size_t>(read<std::uint64_t>());
+    std::vector<double> values(size);
+    if (size > 0)
+      std::memcpy(values.data(), next(size * sizeof(double)), size * sizeof(double));
+    return values;
+  }
+
+  std::size_t remaining() const { return d_data.size() - d_position; }
+
+private:
+  std::string d_data;
+  std::size_t d_position;
+
+  const char *next(std::size_t num_bytes) {
+    if (remaining() < num_bytes)
+      throw std::runtime_error("graph cache is truncated");
+    const char *data = d_data.data() + d_position;
+    d_position += num_bytes;
+    return data;
+  }
+};
+
+void write_boundary_data(CacheWriter &out, const Vertex &vertex) {
+  if (vertex.is_inflow_with_fixed_flow() || vertex.is_inflow_with_fixed_pressure())
+    throw std::runtime_error("the inflow at vertex " + vertex.get_name() + " is given by a function and cannot be cached");
+
+  if (vertex.is_free_outflow()) {
+    out.write(BoundaryType::free_outflow);
+  } else if (vertex.is_windkessel_outflow()) {
+    const auto &data = vertex.get_peripheral_vessel_data();
+    out.write(BoundaryType::windkessel);
+    out.write(data.resistance);
+    out.write(data.compliance);
+    out.write(data.p_out);
+  } else if (vertex.is_vessel_tree_outflow()) {
+    const auto &data = vertex.get_vessel_tree_data();
+    out.write(BoundaryType::vessel_tree);
+    out.write(data.resistances);
+    out.write(data.capacitances);
+    out.write(data.radii);
+    out.write(data.p_out);
+    out.write<std::uint64_t>(data.furcation_number);
+  } else if (vertex.is_rcl_outflow()) {
+    const auto &data = vertex.get_rcl_data();
+    out.write(BoundaryType::rcl);
+    out.write(data.resistances);
+    out.write(data.capacitances);
+    out.write(data.inductances);
+    out.write(data.p_out);
+  } else if (vertex.is_linear_characteristic_inflow()) {
+    const auto &data = vertex.get_linear_characteristic_data();
+    out.write(BoundaryType::linear_characteristic);
+    out.write(data.C);
+    out.write(data.L);
+    out.write<std::uint8_t>(data.points_towards_vertex);
+    out.write(data.p);
+    out.write(data.q);
+  } else if (vertex.is_nonlinear_characteristic_inflow()) {
+    const auto &data = vertex.get_nonlinear_characteristic_data();
+    out.write(BoundaryType::nonlinear_characteristic);
+    out.write(data.G0);
+    out.write(data.A0);
+    out.write(data.rho);
+    out.write<std::uint8_t>(data.points_towards_vertex);
+    out.write(data.p);
+    out.write(data.q);
+  } else {
+    out.write(BoundaryType::undefined);
+  }
+}
+
+void read_boundary_data(CacheReader &in, Vertex &vertex) {
+  const auto type = in.read<BoundaryType>();
+  if (type == BoundaryType::free_outflow) {
+    vertex.set_to_free_outflow();
+  } else if (type == BoundaryType::windkessel) {
+    const auto r = in.read<double>();
+    const auto c = in.read<double>();
+    vertex.set_to_windkessel_outflow(r, c);
+    vertex.update_vessel_tip_pressures(in.read<double>());
+  } else if (type == BoundaryType::vessel_tree) {
+    const auto resistances = in.read_vector();
+    const auto capacitances = in.read_vector();
+    const auto radii = in.read_vector();
+    const auto p_out = in.read<double>();
+    const auto furcation_number = static_cast<std::size_t>(in.read<std::uint64_t>());
+    vertex.set_to_vessel_tree_outflow(p_out, resistances, capacitances, radii, furcation_number);
+  } else if (type == BoundaryType::rcl) {
+    const auto resistances = in.read_vector();
+    const auto capacitances = in.read_vector();
+    const auto inductances = in.read_vector();
+    vertex.set_to_vessel_rcl_outflow(in.read<double>(), resistances, capacitances, inductances);
+  } else if (type == BoundaryType::linear_characteristic) {
+    const auto C = in.read<double>();
+    const auto L = in.read<double>();
+    const bool points_towards_vertex = in.read<std::uint8_t>() != 0;
+    const auto p = in.read<double>();
+    vertex.set_to_linear_characteristic_inflow(C, L, points_towards_vertex, p, in.read<double>());
+  } else if (type == BoundaryType::nonlinear_characteristic) {
+    const auto G0 = in.read<double>();
+    const auto A0 = in.read<double>();
+    const auto rho = in.read<double>();
+    const bool points_towards_vertex = in.read<std::uint8_t>() != 0;
+    const auto p = in.read<double>();
+    vertex.set_to_nonlinear_characteristic_inflow(G0, A0, rho, points_towards_vertex, p, in.read<double>());
+  } else if (type != BoundaryType::undefined) {
+    throw std::runtime_error("graph cache contains an unknown boundary condition");
+  }
+}
+
+} // namespace
+
+std::uint64_t source_files_hash(const std::vector<std::string> &filepaths) {
+  // FNV-1a over the contents and the lengths of all the files
+  std::uint64_t hash = 14695981039346656037ull;
+  const auto combine = [&hash](unsigned char byte) {
+    hash ^= byte;
+    hash *= 1099511628211ull;
+  };
+
+  std::vector<char> buffer(1 << 16);
+  for (const auto &filepath : filepaths) {
+    std::ifstream f(filepath, std::ios::in | std::ios::binary);
+    if (!f)
+      throw std::runtime_error("file " + filepath + " could not be opened");
+    std::uint64_t length = 0;
+    while (f) {
+      f.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+      const auto num_read = static_cast<std::size_t>(f.gcount());
+      for (std::size_t k = 0; k < num_read; k += 1)
+        combine(static_cast<unsigned char>(buffer[k]));
+      length += num_read;
+    }
+    for (std::size_t k = 0; k < 8; k += 1)
+      combine(static_cast<unsigned char>((length >> (8 * k)) & 0xff));
+  }
+  return hash;
+}
+
+void write_graph_cache(const std::string &filepath, const GraphStorage &graph, std::uint64_t source_hash, bool with_partition) {
+  CacheWriter out;
+  for (char c : graph_cache_magic)
+    out.write(c);
+  out.write(source_hash);
+  out.write<std::uint8_t>(with_partition);
+
+  const auto vertex_ids = graph.get_vertex_ids();
+  out.write<std::uint64_t>(vertex_ids.size());
+  for (auto v_id : vertex_ids) {
+    const auto &vertex = graph.vertex(v_id);
+    if (!vertex.get_inter_graph_connections().empty())
+      throw std::runtime_error("the inter graph connections of vertex " + vertex.get_name() + " cannot be cached");
+    if (vertex.is_continuity_vertex())
+      throw std::runtime_error("graphs with split edges cannot be cached, since the split is cheap to redo");
+    out.write<std::uint64_t>(v_id);
+    out.write(vertex.get_name());
+  }
+
+  const auto edge_ids = graph.get_edge_ids();
+  // the edges are recreated by connecting them in the order of their ids
+  for (std::size_t k = 0; k < edge_ids.size(); k += 1)
+    if (edge_ids[k] != k)
+      throw std::runtime_error("graphs with removed edges cannot be cached");
+  out.write<std::uint64_t>(edge_ids.size());
+  for (auto e_id : edge_ids) {
+    const auto &edge = graph.edge(e_id);
+    out.write<std::uint64_t>(e_id);
+    out.write<std::uint64_t>(edge.get_vertex_neighbors()[0]);
+    out.write<std::uint64_t>(edge.get_vertex_neighbors()[1]);
+    out.write<std::uint64_t>(edge.num_micro_edges());
+    out.write(edge.get_name());
+    if (with_partition)
+      out.write<std::int64_t>(edge.rank());
+
+    out.write<std::uint8_t>(edge.has_physical_data());
+    if (edge.has_physical_data()) {
+      const auto &data = edge.get_physical_data();
+      for (double value : {data.elastic_modulus, data.G0, data.A0, data.rho, data.length, data.viscosity, data.gamma, data.radius})
+        out.write(value);
+    }
+
+    out.write<std::uint8_t>(edge.has_discretization_data());
+    if (edge.has_discretization_data())
+      out.write(edge.get_discretization_data().lengths);
+
+    out.write<std::uint8_t>(edge.has_embedding_data());
+    if (edge.has_embedding_data()) {
+      const auto &points = edge.get_embedding_data().points;
+      out.write<std::uint64_t>(points.size());
+      for (const auto &p : points) {
+        out.write(p.x);
+        out.write(p.y);
+        out.write(p.z);
+      }
+    }
+  }
+
+  // the boundary conditions of the leaves can only be set after all the edges are connected
+  for (auto v_id : vertex_ids)
+    write_boundary_data(out, graph.vertex(v_id));
+
+  // a concurrent reader must never see a partially written cache
+  const auto tmp_filepath = filepath + ".tmp";
+  {
+    std::ofstream f(tmp_filepath, std::ios::out | std::ios::binary | std::ios::trunc);
+    const auto data = out.str();
+    f.write(data.data(), static_cast<std::streamsize>(data.size()));
+    if (!f)
+      throw std::runtime_error("could not write graph cache " + tmp_filepath);
+  }
+  if (std::rename(tmp_filepath.c_str(), filepath.c_str()) != 0)
+    throw std::runtime_error("could not move the graph cache to " + filepath);
+}
+
+bool read_graph_cache(const std::string &filepath, std::uint64_t source_hash, GraphStorage &graph) {
+  if (graph.num_vertices() > 0 || graph.num_edges() > 0)
+    throw std::runtime_error("a graph cache can only be read into an empty graph");
+
+  std::ifstream f(filepath, std::ios::in | std::ios::binary);
+  if (!f)
+    return false;
+  std::stringstream contents;
+  contents << f.rdbuf();
+  CacheReader in(contents.str());
+
+  // outdated caches are silently ignored
+  std::array<char, 8> magic{};
+  if (in.remaining() < magic.size() + sizeof(std::uint64_t))
+    return false;
+  for (auto &c : magic)
+    c = in.read<char>();
+  if (magic != graph_cache_magic || in.read<std::uint64_t>() != source_hash)
+    return false;
+  const bool with_partition = in.read<std::uint8_t>() != 0;
+
+  const auto num_vertices = static_cast<std::size_t>(in.read<std::uint64_t>());
+  std::vector<std::size_t> vertex_ids(num_vertices);
+  for (auto &v_id : vertex_ids) {
+    v_id = static_cast<std::size_t>(in.read<std::uint64_t>());
+    // the vertices of a graph storage are never removed, thus their ids are contiguous
+    if (v_id != graph.num_vertices())
+      throw std::runtime_error("graph cache " + filepath + " has non contiguous vertex ids");
+    graph.create_vertex()->set_name(in.read_string());
+  }
+
+  const auto num_edges = static_cast<std::size_t>(in.read<std::uint64_t>());
+  for (std::size_t k = 0; k < num_edges; k += 1) {
+    const auto e_id = static_cast<std::size_t>(in.read<std::uint64_t>());
+    const auto left_id = static_cast<std::size_t>(in.read<std::uint64_t>());
+    const auto right_id = static_cast<std::size_t>(in.read<std::uint64_t>());
+    const auto num_micro_edges = static_cast<std::size_t>(in.read<std::uint64_t>());
+    auto edge = graph.connect(graph.vertex(left_id), graph.vertex(right_id), num_micro_edges);
+    if (edge->get_id() != e_id)
+      throw std::runtime_error("graph cache " + filepath + " has non contiguous edge ids");
+    edge->set_name(in.read_string());
+    if (with_partition)
+      graph.assign_edge_to_rank(*edge, static_cast<int>(in.read<std::int64_t>()));
+
+    if (in.read<std::uint8_t>() != 0) {
+      std::array<double, 8> values{};
+      for (auto &value : values)
+        value = in.read<double>();
+      edge->add_physical_data(PhysicalData(values[0], values[1], values[2], values[3], values[4], values[5], values[6], values[7]));
+    }
+
+    if (in.read<std::uint8_t>() != 0)
+      edge->add_discretization_data({in.read_vector()});
+
+    if (in.read<std::uint8_t>() != 0) {
+      const auto num_points = static_cast<std::size_t>(in.read<std::uint64_t>());
+      std::vector<Point> points;
+      points.reserve(num_points);
+      for (std::size_t i = 0; i < num_points; i += 1) {
+        const auto x = in.read<double>();
+        const auto y = in.read<double>();
+        points.emplace_back(x, y, in.read<double>());
+      }
+      edge->add_embedding_data({points});
+    }
+  }
+
+  for (auto v_id : vertex_ids)
+    read_boundary_data(in, graph.vertex(v_id));
+
+  if (in.remaining() != 0)
+    throw std::runtime_error("graph cache " + filepath + " has trailing data");
+
+  return true;
+}
+
+} // namespace macrocirculation
@@ -0,0 +1,45 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_GRAPH_CACHE_HPP
+#define TUMORMODELS_GRAPH_CACHE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace macrocirculation {
+
+// forward declarations
+class GraphStorage;
+
+/*! @brief Calculates a hash of the contents of the given files, e.g. of the json meshes and boundary files a graph was read from.
+ *         Throws if a file cannot be read.
+ */
+std::uint64_t source_files_hash(const std::vector<std::string> &filepaths);
+
+/*! @brief Writes the graph into a versioned binary cache, which can be read much faster than the json files it was built from.
+ *
+ *  The cache stores the vertices with their names and boundary conditions and the edges with their names, physical,
+ *  discretization and embedding data, together with the given hash of the source files.
+ *  If with_partition is true, the ranks of the edges are stored as well.
+ *  Inflows given by functions and inter graph connections cannot be stored and throw, hence the cache should be written
+ *  before the inflow is set, as the graph reader produces it.
+ */
+void write_graph_cache(const std::string &filepath, const GraphStorage &graph, std::uint64_t source_hash, bool with_partition = false);
+
+/*! @brief Builds the graph from a cache written by write_graph_cache.
+ *
+ *  The graph has to be empty. If the cache does not exist, has a different version or was built from sources with a different hash,
+ *  nothing is read and false is returned, such that the caller can fall back to the source files.
+ *  Throws if the cache is valid but truncated.
+ */
+bool read_graph_cache(const std::string &filepath, std::uint64_t source_hash, GraphStorage &graph);
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_GRAPH_CACHE_HPP
@@ -16,8 +16,8 @@
 
 #include "communication/mpi.hpp"
 #include "dof_map.hpp"
-#include "fe_type.hpp"
 #include "graph_storage.hpp"
+#include "phase_timers.hpp"
 
 namespace macrocirculation {
 
@@ -41,9 +41,19 @@ void GraphCSVWriter::add_setup_data(
   d_data_map[component_name] = {dof_map, component_idx, component_name};
 }
 
+void GraphCSVWriter::set_output_resolution(const OutputResolution &resolution) {
+  if (is_setup)
+    throw std::runtime_error("cannot change the output resolution after setup was called");
+  d_resolution = resolution;
+}
+
 void GraphCSVWriter::setup() {
   is_setup = true;
-  clear_files();
+  d_samplers.clear();
+  for (auto eid : d_graph->get_active_edge_ids(mpi::rank(d_comm)))
+    d_samplers.emplace(eid, EdgeSampler(d_graph->edge(eid), d_resolution));
+  // the csv files of previous runs are truncated by our pool when the first write opens them
+  d_files.reset();
   write_meta_file();
 }
 
@@ -56,9 +66,9 @@ void GraphCSVWriter::add_data(const std::string &name, const std::vector<double>
 }
 
 void GraphCSVWriter::write(double t) {
+  SCOPED_PHASE_TIMER("output");
   // add time step
-  time_steps.push_back(t);
-  write_times();
+  write_time(t);
 
   // write the added data to disk
   for (auto &data_it : d_data_map) {
@@ -75,70 +85,44 @@ void GraphCSVWriter::write(double t) {
   reset_data();
 }
 
-void GraphCSVWriter::write_times() {
-  if (mpi::rank(d_comm) == 0) {
-    std::ofstream f(get_time_csv_file_path(), std::ios::out);
-
-    for (size_t k = 0; k < time_steps.size(); k += 1) {
-      if (k != 0)
-        f << ", ";
-      f << time_steps[k];
-    }
-  }
+void GraphCSVWriter::set_buffer_size(std::size_t buffer_size) {
+  d_files.set_buffer_size(buffer_size);
 }
 
-void GraphCSVWriter::reset_data() {
-  gmm_data.clear();
+void GraphCSVWriter::flush() {
+  d_files.flush();
 }
 
-void GraphCSVWriter::clear_files() {
-  // all csv files get cleared
-  for (auto &data_it : d_data_map) {
-    auto name = data_it.first;
-
-    for (auto eid : d_graph->get_active_edge_ids(mpi::rank(d_comm)))
-      std::ofstream(get_csv_file_path(name, eid), std::ios::out);
-  }
+void GraphCSVWriter::write_time(double t) {
+  // one line per time step, such that the file never has to be rewritten
+  if (mpi::rank(d_comm) == 0)
+    d_files.get(get_time_csv_file_path()) << t << '\n';
+}
 
-  if (mpi::rank(d_comm) == 0) {
-    std::ofstream(get_time_csv_file_path(), std::ios::out);
-  }
+void GraphCSVWriter::reset_data() {
+  gmm_data.clear();
 }
 
 template<typename VectorType>
-void GraphCSVWriter::write_generic(const Data &data, const VectorType &v) const {
+void GraphCSVWriter::write_generic(const Data &data, const VectorType &v) {
   auto dof_map = data.dof_map;
   auto component = data.component_idx;
 
   // write vessel data
   for (auto eid : d_graph->get_active_edge_ids(mpi::rank(d_comm))) {
-    const auto &edge = d_graph->get_edge(eid);
-    const auto &local_dof_map = dof_map->get_local_dof_map(*edge);
-    const double length = edge->has_physical_data() ? edge->get_physical_data().length : 1.;
-    const auto h = length / local_dof_map.num_micro_edges();
-
-    FETypeNetwork fe(create_midpoint_rule(), local_dof_map.num_basis_functions() - 1);
-    fe.reinit(h);
-
-    std::vector<std::size_t> dof_indices(local_dof_map.num_basis_functions(), 0);
-    std::vector<double> local_data(local_dof_map.num_basis_functions(), 0);
+    const auto &local_dof_map = dof_map->get_local_dof_map(d_graph->edge(eid));
+    const auto &sampler = d_samplers.at(eid);
 
     // append line to csv file
-    {
-      std::fstream filecsv(get_csv_file_path(data.component_name, eid), std::ios::app);
-
-      for (std::size_t micro_edge = 0; micro_edge < local_dof_map.num_micro_edges(); micro_edge += 1) {
-        if (micro_edge > 0)
-          filecsv << ",";
+    auto &filecsv = d_files.get(get_csv_file_path(data.component_name, eid));
 
-        local_dof_map.dof_indices(micro_edge, component, dof_indices);
-        extract_dof(dof_indices, v, local_data);
-        auto boundary_values = fe.evaluate_dof_at_boundary_points(local_data);
-
-        filecsv << boundary_values.left << "," << boundary_values.right;
-      }
-      filecsv << std::endl;
+    for (std::size_t k = 0; k < sampler.size(); k += 1) {
+      if (k > 0)
+        filecsv << ",";
+      filecsv << sampler.evaluate(local_dof_map, v, component, k);
     }
+    // no std::endl, which would flush the buffer
+    filecsv << '\n';
   }
 }
 
@@ -177,20 +161,14 @@ void GraphCSVWriter::write_meta_file() {
 
   auto vessel_list = json::array();
   for (auto eid : d_graph->get_edge_ids()) {
-    const auto edge = d_graph->get_edge(eid);
-    const double length = edge->has_physical_data() ? edge->get_physical_data().length : 1.;
-    const auto h = length / static_cast<double>(edge->num_micro_edges());
+    const auto &edge = d_graph->edge(eid);
 
-    const auto &vertex_left = *d_graph->get_vertex(edge->get_vertex_neighbors()[0]);
-    const auto &vertex_right = *d_graph->get_vertex(edge->get_vertex_neighbors()[1]);
+    const auto &vertex_left = d_graph->vertex(edge.get_vertex_neighbors()[0]);
+    const auto &vertex_right = d_graph->vertex(edge.get_vertex_neighbors()[1]);
 
-    std::vector<double> coordinates;
-    for (std::size_t micro_edge = 0; micro_edge < edge->num_micro_edges(); micro_edge += 1) {
-      coordinates.push_back(h * micro_edge);
-      coordinates.push_back(h * (micro_edge + 1));
-    }
+    const auto coordinates = EdgeSampler(edge, d_resolution).get_coordinates();
 
-    auto &pdata = edge->get_physical_data();
+    auto &pdata = edge.get_physical_data();
 
     json filepath_obj;
     for (auto d : d_data_map) {
@@ -206,8 +184,8 @@ void GraphCSVWriter::write_meta_file() {
         {"name", vertex_right.get_name()}}}};
 
     json vessel_obj = {
-      {"edge_id", edge->get_id()},
-      {"name", edge->get_name()},
+      {"edge_id", edge.get_id()},
+      {"name", edge.get_name()},
       {"coordinates", coordinates},
       {"filepaths", filepath_obj},
       {"vertices", vertices_obj},
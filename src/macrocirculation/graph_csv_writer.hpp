@@ -14,6 +14,9 @@
 #include <string>
 #include <vector>
 
+#include "buffered_file_pool.hpp"
+#include "output_resolution.hpp"
+
 namespace macrocirculation {
 
 class GraphStorage;
@@ -32,12 +35,21 @@ public:
     size_t component_idx,
     const std::string &component_name);
 
+  /*! @brief Sets the points along the vessels, at which the values are written, before setup is called. */
+  void set_output_resolution(const OutputResolution &resolution);
+
   void setup();
 
   void add_data(const std::string &name, const std::vector<double> &u);
 
   void write(double t);
 
+  /*! @brief Sets the buffer size in bytes of the csv files, which applies to the files opened by the next write. */
+  void set_buffer_size(std::size_t buffer_size);
+
+  /*! @brief Writes all the buffered data to the csv files, which otherwise happens when the writer is destroyed. */
+  void flush();
+
 private:
   MPI_Comm d_comm;
   std::string d_foldername;
@@ -47,8 +59,6 @@ private:
 
   bool is_setup;
 
-  std::vector<double> time_steps;
-
   struct Data {
     std::shared_ptr<DofMap> dof_map;
     size_t component_idx;
@@ -59,14 +69,21 @@ private:
 
   std::map<std::string, std::reference_wrapper<const std::vector<double>>> gmm_data;
 
+  OutputResolution d_resolution;
+
+  /*! @brief The output points of our active edges. */
+  std::map<std::size_t, EdgeSampler> d_samplers;
+
+  /*! @brief The csv files, which stay open between the writes. */
+  BufferedFilePool d_files;
+
 private:
   void reset_data();
 
-  void clear_files();
-
   void write_meta_file();
 
-  void write_times();
+  /*! @brief Appends the time step t as a new line of the time csv file. */
+  void write_time(double t);
 
   std::string get_meta_file_name() const;
 
@@ -77,7 +94,7 @@ private:
   std::string get_time_csv_file_path() const;
 
   template<typename VectorType>
-  void write_generic(const Data &data, const VectorType &v) const;
+  void write_generic(const Data &data, const VectorType &v);
 };
 
 } // namespace macrocirculation
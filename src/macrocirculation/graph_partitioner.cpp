@@ -7,16 +7,26 @@
 
 #include "graph_partitioner.hpp"
 #include "communication/mpi.hpp"
+#include "dof_map.hpp"
 #include "graph_storage.hpp"
+#include "phase_timers.hpp"
+#include "time_step_levels.hpp"
 #include <algorithm>
+#include <array>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <limits>
 #include <mpi.h>
 #include <queue>
+#include <stdexcept>
 
 namespace macrocirculation {
 
 void naive_mesh_partitioner(GraphStorage &graph, MPI_Comm comm) {
+  SCOPED_SETUP_TIMER("partition");
   int size;
   MPI_Comm_size(comm, &size);
 
@@ -25,8 +35,8 @@ void naive_mesh_partitioner(GraphStorage &graph, MPI_Comm comm) {
     std::size_t end_edge_id = ((rank + 1) * graph.num_edges()) / size;
 
     for (std::size_t edge_id = start_edge_id; edge_id < end_edge_id; edge_id += 1) {
-      auto edge = graph.get_edge(edge_id);
-      graph.assign_edge_to_rank(*edge, rank);
+      auto &edge = graph.edge(edge_id);
+      graph.assign_edge_to_rank(edge, rank);
     }
   }
 }
@@ -42,6 +52,7 @@ struct PrioritizedEdge {
 };
 
 void priority_mesh_partitioner(MPI_Comm comm, GraphStorage &graph, const std::function<int(const Edge &)> &estimator) {
+  SCOPED_SETUP_TIMER("partition");
   auto cmp = [](const RankPriorityPair &left, const RankPriorityPair &right) {
     return left.total_priority > right.total_priority;
   };
@@ -55,7 +66,7 @@ void priority_mesh_partitioner(MPI_Comm comm, GraphStorage &graph, const std::fu
   std::vector<PrioritizedEdge> edges;
 
   for (auto e_id : graph.get_edge_ids()) {
-    auto &edge = *graph.get_edge(e_id);
+    auto &edge = graph.edge(e_id);
     auto priority = estimator(edge);
     edges.push_back({e_id, priority});
   }
@@ -69,7 +80,7 @@ void priority_mesh_partitioner(MPI_Comm comm, GraphStorage &graph, const std::fu
     RankPriorityPair rank_priority = queue.top();
     queue.pop();
 
-    auto &edge = *graph.get_edge(pedge.edge_id);
+    auto &edge = graph.edge(pedge.edge_id);
     graph.assign_edge_to_rank(edge, rank_priority.rank);
 
     rank_priority.total_priority += pedge.total_priority;
@@ -77,28 +88,433 @@ void priority_mesh_partitioner(MPI_Comm comm, GraphStorage &graph, const std::fu
   }
 }
 
+namespace {
+
+/*! @brief Returns the neighbors of an edge, i.e. the edges sharing a vertex with it. */
+std::vector<std::size_t> get_edge_neighbors(const GraphStorage &graph, const Edge &edge) {
+  std::vector<std::size_t> neighbors;
+  for (auto v_id : edge.get_vertex_neighbors())
+    for (auto e_id : graph.vertex(v_id).get_edge_neighbors())
+      if (e_id != edge.get_id())
+        neighbors.push_back(e_id);
+  return neighbors;
+}
+
+/*! @brief Orders the edges of the given subset by a breadth first search inside the subset.
+ *         Disconnected components are appended one after another.
+ *         The edge from which an edge was reached is stored in parent, the roots of the components are their own parents.
+ */
+std::vector<std::size_t> breadth_first_order(const GraphStorage &graph, const std::vector<char> &in_subset, const std::vector<std::size_t> &subset, std::size_t start, std::vector<std::size_t> &parent) {
+  std::vector<char> visited(in_subset.size(), false);
+  std::vector<std::size_t> order;
+  order.reserve(subset.size());
+
+  std::size_t next_unvisited = 0;
+  std::queue<std::size_t> queue;
+  queue.push(start);
+  visited[start] = true;
+  parent[start] = start;
+  while (order.size() < subset.size()) {
+    if (queue.empty()) {
+      while (visited[subset[next_unvisited]])
+        next_unvisited += 1;
+      const auto root = subset[next_unvisited];
+      queue.push(root);
+      visited[root] = true;
+      parent[root] = root;
+    }
+
+    const auto e_id = queue.front();
+    queue.pop();
+    order.push_back(e_id);
+
+    for (auto n_id : get_edge_neighbors(graph, graph.edge(e_id))) {
+      if (in_subset[n_id] && !visited[n_id]) {
+        visited[n_id] = true;
+        parent[n_id] = e_id;
+        queue.push(n_id);
+      }
+    }
+  }
+  return order;
+}
+
+/*! @brief Orders the connected component of the start edge depth first and marks its edges as visited.
+ *         From every edge we only continue at the vertex through which we did not enter it,
+ *         since the edges at the other vertex were already pushed onto the stack by the previous edge.
+ */
+std::vector<std::size_t> depth_first_order(const GraphStorage &graph, std::size_t start, std::vector<char> &visited) {
+  const std::size_t no_vertex = std::numeric_limits<std::size_t>::max();
+
+  std::vector<std::size_t> order;
+  // the edges together with the vertex through which they were entered
+  std::vector<std::pair<std::size_t, std::size_t>> stack{{start, no_vertex}};
+  std::vector<std::size_t> next;
+  while (!stack.empty()) {
+    const auto [e_id, entry_vertex] = stack.back();
+    stack.pop_back();
+    if (visited[e_id])
+      continue;
+    visited[e_id] = true;
+    order.push_back(e_id);
+
+    next.clear();
+    for (auto v_id : graph.edge(e_id).get_vertex_neighbors()) {
+      if (v_id == entry_vertex)
+        continue;
+      for (auto n_id : graph.vertex(v_id).get_edge_neighbors())
+        if (!visited[n_id])
+          next.emplace_back(n_id);
+      // the first neighbor should be popped first
+      for (auto it = next.rbegin(); it != next.rend(); it++)
+        stack.emplace_back(*it, v_id);
+      next.clear();
+    }
+  }
+  return order;
+}
+
+/*! @brief Scratch arrays indexed by the edge ids, which are shared by all the bisections. */
+struct BisectionWorkspace {
+  std::vector<char> in_subset;
+  std::vector<std::size_t> parent;
+  std::vector<long> subtree_cost;
+};
+
+/*! @brief Splits the subset into two parts with the given share of costs and continues on both of them recursively.
+ *
+ *  The preferred split cuts a subtree off the breadth first spanning tree, which separates the parts at a single vertex
+ *  for tree like networks. If no subtree is well balanced, a breadth first prefix is taken instead.
+ */
+void bisect(const GraphStorage &graph, const std::vector<long> &costs, const std::vector<std::size_t> &subset, int first_part, int num_parts, BisectionWorkspace &ws, std::vector<int> &parts) {
+  if (num_parts == 1 || subset.size() <= 1) {
+    for (auto e_id : subset)
+      parts[e_id] = first_part;
+    return;
+  }
+
+  for (auto e_id : subset)
+    ws.in_subset[e_id] = true;
+
+  // the last edge of a breadth first search is far away from its start, which makes it a good root
+  const auto root = breadth_first_order(graph, ws.in_subset, subset, subset.front(), ws.parent).back();
+  const auto order = breadth_first_order(graph, ws.in_subset, subset, root, ws.parent);
+
+  for (auto e_id : subset)
+    ws.in_subset[e_id] = false;
+
+  const auto &parent = ws.parent;
+  auto &subtree_cost = ws.subtree_cost;
+
+  long total_cost = 0;
+  for (auto e_id : subset)
+    total_cost += costs[e_id];
+
+  const int num_left_parts = num_parts / 2;
+  const long left_target = (total_cost * num_left_parts) / num_parts;
+
+  // candidate 1: grow the left region by the breadth first order, and stop at the edge which brings it closest to the target
+  std::size_t split = 0;
+  long left_cost = 0;
+  while (split < order.size() - 1 && std::abs(left_cost + costs[order[split]] - left_target) <= std::abs(left_cost - left_target)) {
+    left_cost += costs[order[split]];
+    split += 1;
+  }
+  split = std::max<std::size_t>(split, 1);
+  const long prefix_imbalance = std::abs(left_cost - left_target);
+
+  // candidate 2: the subtree of the spanning tree, which is closest to the target cost of one of the two sides
+  for (auto e_id : order)
+    subtree_cost[e_id] = 0;
+  for (auto it = order.rbegin(); it != order.rend(); it++) {
+    subtree_cost[*it] += costs[*it];
+    if (parent[*it] != *it)
+      subtree_cost[parent[*it]] += subtree_cost[*it];
+  }
+  std::size_t best_subtree = order.front();
+  bool subtree_is_left = true;
+  long subtree_imbalance = std::numeric_limits<long>::max();
+  for (auto e_id : order) {
+    // a subtree containing everything does not split anything
+    if (subtree_cost[e_id] == total_cost && e_id == order.front())
+      continue;
+    const long as_left = std::abs(subtree_cost[e_id] - left_target);
+    const long as_right = std::abs(total_cost - subtree_cost[e_id] - left_target);
+    if (std::min(as_left, as_right) < subtree_imbalance) {
+      subtree_imbalance = std::min(as_left, as_right);
+      subtree_is_left = as_left <= as_right;
+      best_subtree = e_id;
+    }
+  }
+
+  std::vector<std::size_t> left;
+  std::vector<std::size_t> right;
+  // we accept a slightly worse balance for cutting at a single vertex
+  const bool use_subtree = subtree_imbalance <= std::max(prefix_imbalance, total_cost / 20);
+  if (use_subtree) {
+    // parents come before their children in the breadth first order
+    auto &in_subtree = ws.in_subset;
+    for (auto e_id : order) {
+      in_subtree[e_id] = (e_id == best_subtree) || (parent[e_id] != e_id && in_subtree[parent[e_id]]);
+      ((static_cast<bool>(in_subtree[e_id]) == subtree_is_left) ? left : right).push_back(e_id);
+    }
+    for (auto e_id : order)
+      in_subtree[e_id] = false;
+  } else {
+    left.assign(order.begin(), order.begin() + split);
+    right.assign(order.begin() + split, order.end());
+  }
+
+  bisect(graph, costs, left, first_part, num_left_parts, ws, parts);
+  bisect(graph, costs, right, first_part + num_left_parts, num_parts - num_left_parts, ws, parts);
+}
+
+} // namespace
+
+std::vector<int> topology_aware_partition(const GraphStorage &graph, const std::function<int(const Edge &)> &estimator, int num_parts) {
+  if (num_parts < 1)
+    throw std::runtime_error("topology_aware_partition: at least one part is needed");
+
+  const auto edge_ids = graph.get_edge_ids();
+  const std::size_t max_id = edge_ids.empty() ? 0 : edge_ids.back() + 1;
+
+  std::vector<long> costs(max_id, 0);
+  for (auto e_id : edge_ids)
+    costs[e_id] = estimator(graph.edge(e_id));
+
+  std::vector<int> parts(max_id, -1);
+  BisectionWorkspace ws{std::vector<char>(max_id, false), std::vector<std::size_t>(max_id, 0), std::vector<long>(max_id, 0)};
+  if (!edge_ids.empty())
+    bisect(graph, costs, edge_ids, 0, num_parts, ws, parts);
+  return parts;
+}
+
+void topology_aware_mesh_partitioner(MPI_Comm comm, GraphStorage &graph, const std::function<int(const Edge &)> &estimator) {
+  SCOPED_SETUP_TIMER("partition");
+  const auto parts = topology_aware_partition(graph, estimator, mpi::size(comm));
+  for (auto e_id : graph.get_edge_ids())
+    graph.assign_edge_to_rank(graph.edge(e_id), parts[e_id]);
+}
+
 int flow_cost_esimator(const GraphStorage &graph, const Edge &e, size_t degree) {
   size_t num_dofs = e.num_micro_edges() * (degree + 1);
 
   for (auto v_id : e.get_vertex_neighbors()) {
-    auto &vertex = *graph.get_vertex(v_id);
+    auto &vertex = graph.vertex(v_id);
     if (!vertex.bc_finalized())
       throw std::runtime_error("boundary conditions need to be set before distributing the graph");
     if (vertex.is_windkessel_outflow())
       num_dofs += 1;
     if (vertex.is_vessel_tree_outflow())
       num_dofs += vertex.get_vessel_tree_data().resistances.size();
+    if (vertex.is_rcl_outflow())
+      num_dofs += 2 * vertex.get_rcl_data().resistances.size();
   }
 
   return static_cast<int>(num_dofs);
 }
 
-void flow_mesh_partitioner(MPI_Comm comm, GraphStorage &graph, size_t degree) {
+void flow_mesh_partitioner(MPI_Comm comm, GraphStorage &graph, size_t degree, size_t max_time_step_level, bool topology_aware) {
+  // with local time stepping an edge on level l is evaluated 2^(max_level - l) times as often as the coarsest edges
+  const auto levels = calculate_time_step_levels(graph, max_time_step_level);
 
   auto estimator = [&](const Edge &e) {
-    return flow_cost_esimator(graph, e, degree);
+    const std::size_t num_sub_steps = std::size_t(1) << (max_time_step_level - levels[e.get_id()]);
+    return flow_cost_esimator(graph, e, degree) * static_cast<int>(num_sub_steps);
   };
-  priority_mesh_partitioner(comm, graph, estimator);
+  if (topology_aware)
+    topology_aware_mesh_partitioner(comm, graph, estimator);
+  else
+    priority_mesh_partitioner(comm, graph, estimator);
+}
+
+namespace {
+
+/*! @brief Identifies our partition files and their version, which has to be increased whenever the layout changes. */
+constexpr std::array<char, 8> partition_file_magic = {'M', 'C', '1', 'D', 'P', 'R', 'T', '1'};
+
+/*! @brief FNV-1a over the bytes of the values. */
+class MeshHasher {
+public:
+  template<typename T>
+  void add(const T &value) {
+    unsigned char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    for (auto byte : bytes) {
+      d_hash ^= byte;
+      d_hash *= 1099511628211ull;
+    }
+  }
+
+  std::uint64_t get() const { return d_hash; }
+
+private:
+  std::uint64_t d_hash = 14695981039346656037ull;
+};
+
+} // namespace
+
+std::uint64_t mesh_hash(const GraphStorage &graph, const std::vector<std::uint64_t> &settings) {
+  MeshHasher hasher;
+  hasher.add<std::uint64_t>(settings.size());
+  for (auto setting : settings)
+    hasher.add(setting);
+
+  hasher.add<std::uint64_t>(graph.num_vertices());
+  const auto edge_ids = graph.get_edge_ids();
+  hasher.add<std::uint64_t>(edge_ids.size());
+  for (auto e_id : edge_ids) {
+    const auto &edge = graph.edge(e_id);
+    hasher.add<std::uint64_t>(e_id);
+    hasher.add<std::uint64_t>(edge.get_vertex_neighbors()[0]);
+    hasher.add<std::uint64_t>(edge.get_vertex_neighbors()[1]);
+    hasher.add<std::uint64_t>(edge.num_micro_edges());
+    hasher.add<std::uint8_t>(edge.has_physical_data());
+    if (edge.has_physical_data()) {
+      const auto &data = edge.get_physical_data();
+      for (double value : {data.elastic_modulus, data.G0, data.A0, data.rho, data.length, data.viscosity, data.gamma, data.radius})
+        hasher.add(value);
+    }
+  }
+  return hasher.get();
+}
+
+void write_partition(MPI_Comm comm, const std::string &filepath, const GraphStorage &graph, std::uint64_t mesh_hash) {
+  if (mpi::rank(comm) != 0)
+    return;
+
+  const auto edge_ids = graph.get_edge_ids();
+  std::vector<std::int64_t> data;
+  data.reserve(2 * edge_ids.size());
+  for (auto e_id : edge_ids) {
+    data.push_back(static_cast<std::int64_t>(e_id));
+    data.push_back(graph.edge(e_id).rank());
+  }
+
+  // a concurrent reader must never see a partially written partition
+  const auto tmp_filepath = filepath + ".tmp";
+  {
+    std::ofstream f(tmp_filepath, std::ios::out | std::ios::binary | std::ios::trunc);
+    const std::array<std::uint64_t, 3> header{mesh_hash, static_cast<std::uint64_t>(mpi::size(comm)), edge_ids.size()};
+    f.write(partition_file_magic.data(), partition_file_magic.size());
+    f.write(reinterpret_cast<const char *>(header.data()), sizeof(header));
+    f.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size() * sizeof(std::int64_t)));
+    if (!f)
+      throw std::runtime_error("could not write partition " + tmp_filepath);
+  }
+  if (std::rename(tmp_filepath.c_str(), filepath.c_str()) != 0)
+    throw std::runtime_error("could not move the partition to " + filepath);
+}
+
+bool read_partition(MPI_Comm comm, const std::string &filepath, std::uint64_t mesh_hash, GraphStorage &graph) {
+  SCOPED_SETUP_TIMER("read partition");
+  const auto edge_ids = graph.get_edge_ids();
+
+  // the pairs of edge ids and ranks, which are only read on rank 0
+  std::vector<std::int64_t> data;
+  enum Status : int { missing = 0, valid = 1, truncated = 2 };
+  int status = missing;
+  if (mpi::rank(comm) == 0) {
+    std::ifstream f(filepath, std::ios::in | std::ios::binary);
+    std::array<char, 8> magic{};
+    std::array<std::uint64_t, 3> header{};
+    // outdated partitions and the ones of other meshes are silently ignored
+    if (f.read(magic.data(), magic.size()) && magic == partition_file_magic && f.read(reinterpret_cast<char *>(header.data()), sizeof(header))
+        && header[0] == mesh_hash && header[1] == static_cast<std::uint64_t>(mpi::size(comm)) && header[2] == edge_ids.size()) {
+      data.resize(2 * edge_ids.size());
+      status = f.read(reinterpret_cast<char *>(data.data()), static_cast<std::streamsize>(data.size() * sizeof(std::int64_t))) ? valid : truncated;
+    }
+  }
+  CHECK_MPI_SUCCESS(MPI_Bcast(&status, 1, MPI_INT, 0, comm));
+  if (status == truncated)
+    throw std::runtime_error("partition " + filepath + " is truncated");
+  if (status == missing)
+    return false;
+
+  data.resize(2 * edge_ids.size());
+  CHECK_MPI_SUCCESS(MPI_Bcast(data.data(), static_cast<int>(data.size()), MPI_INT64_T, 0, comm));
+  for (std::size_t k = 0; k < edge_ids.size(); k += 1) {
+    const auto rank = data[2 * k + 1];
+    if (data[2 * k] != static_cast<std::int64_t>(edge_ids[k]) || rank < 0 || rank >= mpi::size(comm))
+      throw std::runtime_error("partition " + filepath + " does not match the edges of the graph");
+    graph.assign_edge_to_rank(graph.edge(edge_ids[k]), static_cast<int>(rank));
+  }
+  return true;
+}
+
+void split_long_edges(GraphStorage &graph, std::size_t max_micro_edges) {
+  if (max_micro_edges == 0)
+    throw std::runtime_error("split_long_edges: the maximum number of micro edges has to be positive");
+
+  for (auto e_id : graph.get_edge_ids()) {
+    auto &edge = graph.edge(e_id);
+    const std::size_t num_parts = (edge.num_micro_edges() + max_micro_edges - 1) / max_micro_edges;
+    graph.split_edge(edge, num_parts);
+  }
+}
+
+std::vector<std::size_t> locality_edge_order(const GraphStorage &graph) {
+  const auto edge_ids = graph.get_edge_ids();
+  const std::size_t max_id = edge_ids.empty() ? 0 : edge_ids.back() + 1;
+
+  std::vector<char> visited(max_id, false);
+  std::vector<char> in_component(max_id, false);
+  std::vector<std::size_t> parent(max_id, 0);
+
+  std::vector<std::size_t> order;
+  order.reserve(edge_ids.size());
+  for (auto e_id : edge_ids) {
+    if (visited[e_id])
+      continue;
+
+    // a first traversal finds the component, in which the last edge of a breadth first search is a peripheral edge
+    const auto component = depth_first_order(graph, e_id, visited);
+    for (auto c_id : component) {
+      in_component[c_id] = true;
+      visited[c_id] = false;
+    }
+    const auto root = breadth_first_order(graph, in_component, component, e_id, parent).back();
+    for (auto c_id : component)
+      in_component[c_id] = false;
+
+    const auto component_order = depth_first_order(graph, root, visited);
+    order.insert(order.end(), component_order.begin(), component_order.end());
+  }
+  return order;
+}
+
+std::vector<std::size_t> partition_edges_among_threads(const GraphStorage &graph, const DofMap &dof_map, const std::vector<std::size_t> &edge_ids, std::size_t num_threads) {
+  num_threads = std::max<std::size_t>(num_threads, 1);
+
+  std::size_t total_work = 0;
+  for (auto e_id : edge_ids)
+    total_work += dof_map.get_local_dof_map(graph.edge(e_id)).num_micro_edges();
+
+  // thread k starts at the first edge, where the work of the previous edges exceeds k/num_threads of the total work
+  std::vector<std::size_t> offsets(num_threads + 1, edge_ids.size());
+  offsets[0] = 0;
+  std::size_t work = 0;
+  std::size_t thread_id = 1;
+  for (std::size_t k = 0; k < edge_ids.size() && thread_id < num_threads; k += 1) {
+    while (thread_id < num_threads && work * num_threads >= thread_id * total_work && work > 0) {
+      offsets[thread_id] = k;
+      thread_id += 1;
+    }
+    work += dof_map.get_local_dof_map(graph.edge(edge_ids[k])).num_micro_edges();
+  }
+  return offsets;
+}
+
+std::vector<std::size_t> get_dof_chunk_offsets(const GraphStorage &graph, const DofMap &dof_map, const std::vector<std::size_t> &edge_ids, const std::vector<std::size_t> &edge_chunk_offsets) {
+  const std::size_t num_threads = edge_chunk_offsets.size() - 1;
+  std::vector<std::size_t> offsets(num_threads + 1, dof_map.num_dof());
+  offsets[0] = 0;
+  for (std::size_t thread_id = 1; thread_id < num_threads; thread_id += 1) {
+    const auto k = edge_chunk_offsets[thread_id];
+    const auto first_dof = k < edge_ids.size() ? dof_map.get_local_dof_map(graph.edge(edge_ids[k])).first_dof(0, 0) : dof_map.num_dof();
+    offsets[thread_id] = std::max(offsets[thread_id - 1], first_dof);
+  }
+  return offsets;
 }
 
 } // namespace macrocirculation
@@ -8,13 +8,18 @@
 #ifndef TUMORMODELS_GRAPH_PARTITIONER_HPP
 #define TUMORMODELS_GRAPH_PARTITIONER_HPP
 
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <mpi.h>
+#include <string>
+#include <vector>
 
 namespace macrocirculation {
 
 // forward declarations
 class GraphStorage;
+class DofMap;
 class Edge;
 
 /*! @brief Distributes a graph to several processors through the ids of the assigned primitives.
@@ -26,9 +31,78 @@ void naive_mesh_partitioner(GraphStorage &graph, MPI_Comm comm = MPI_COMM_WORLD)
  */
 void priority_mesh_partitioner(MPI_Comm comm, GraphStorage &graph, const std::function<int (const Edge&)> & estimator);
 
+/*! @brief Splits the edges of a graph into the given number of connected parts with balanced costs.
+ *
+ *  The edges are bisected recursively. Each bisection grows a region by a breadth first search
+ *  starting at a peripheral edge, until the region has the cost share of its ranks.
+ *  Hence, the parts are contiguous, which keeps the number of cut vertices and neighbor ranks small.
+ *  For tree like arterial networks the parts become subtrees.
+ *
+ * @return The part for each edge id. Ids of removed edges get the part -1.
+ */
+std::vector<int> topology_aware_partition(const GraphStorage &graph, const std::function<int(const Edge &)> &estimator, int num_parts);
+
+/*! @brief Distributes a graph to several processors with topology_aware_partition.
+ *         In contrast to priority_mesh_partitioner, neighboring edges end up on the same ranks.
+ */
+void topology_aware_mesh_partitioner(MPI_Comm comm, GraphStorage &graph, const std::function<int(const Edge &)> &estimator);
+
 /*! @brief Distributes a graph to several processors using a cost estimator for the flow problem;
+ *         For local time stepping with the given maximum level (see calculate_time_step_levels),
+ *         the costs of the edges are weighted with the number of their sub steps.
+ *         If topology_aware is false, the edges are distributed greedily with priority_mesh_partitioner.
+ */
+void flow_mesh_partitioner(MPI_Comm comm, GraphStorage &graph, size_t degree, size_t max_time_step_level = 0, bool topology_aware = true);
+
+/*! @brief Calculates a hash of the vertices, the edges with their micro edges and the physical data of the edges,
+ *         which identifies the mesh a partition was calculated for. The settings of the partitioner, e.g. the degree,
+ *         are hashed as well, since they change the costs of the edges. The ranks of the edges are ignored.
+ */
+std::uint64_t mesh_hash(const GraphStorage &graph, const std::vector<std::uint64_t> &settings = {});
+
+/*! @brief Writes the ranks of the edges into a partition file, which is keyed by the given mesh hash and the number of ranks.
+ *         Only rank 0 writes, and the file is replaced atomically, such that a concurrent reader never sees a partial file.
+ */
+void write_partition(MPI_Comm comm, const std::string &filepath, const GraphStorage &graph, std::uint64_t mesh_hash);
+
+/*! @brief Assigns the edges to the ranks stored in a partition file written by write_partition, instead of partitioning the graph again.
+ *
+ *  Rank 0 reads the file and broadcasts the ranks, hence the call is collective. If the file does not exist, has a different version
+ *  or was written for another mesh hash or number of ranks, nothing is assigned and false is returned, such that the caller can
+ *  fall back to a partitioner. Throws if the file is valid but truncated.
+ */
+bool read_partition(MPI_Comm comm, const std::string &filepath, std::uint64_t mesh_hash, GraphStorage &graph);
+
+/*! @brief Splits all the edges with more than max_micro_edges micro edges into parts of at most this size.
+ *         The parts are joined at continuity vertices, such that the partitioners can distribute a long vessel over several ranks.
+ *         Has to be called before the boundary conditions are finalized.
+ */
+void split_long_edges(GraphStorage &graph, std::size_t max_micro_edges);
+
+/*! @brief Returns an order of the edges, in which topologically adjacent vessels are close to each other.
+ *
+ *  The edges are ordered depth first, starting at a peripheral edge of every connected component.
+ *  For tree like networks every subtree becomes a contiguous range, and a vessel is directly followed by its first child.
+ *  Passed to GraphStorage::set_edge_order after partitioning and before creating the dof map,
+ *  the bifurcation solves and the ghost packing touch nearby memory, while the edge ids stay the same.
+ */
+std::vector<std::size_t> locality_edge_order(const GraphStorage &graph);
+
+/*! @brief Sub-partitions the given edges of a rank among the threads of a ThreadPool.
+ *         The threads get contiguous chunks with roughly the same number of micro edges,
+ *         since the work in the edge loops is proportional to it.
+ *
+ * @return The chunk offsets for ThreadPool::parallel_for, i.e. thread k gets the edges in [offsets[k], offsets[k+1]).
+ */
+std::vector<std::size_t> partition_edges_among_threads(const GraphStorage &graph, const DofMap &dof_map, const std::vector<std::size_t> &edge_ids, std::size_t num_threads);
+
+/*! @brief Returns the ranges of a local dof vector, which belong to the edge chunks of partition_edges_among_threads.
+ *         The dofs of the edges have to be numbered in the order of edge_ids, as for the local dof maps,
+ *         and the dofs behind the edges, e.g. of the 0D models, belong to the last thread.
+ *
+ * @return The dof offsets for first_touch and ThreadPool::parallel_for, i.e. thread k gets the dofs in [offsets[k], offsets[k+1]).
  */
-void flow_mesh_partitioner(MPI_Comm comm, GraphStorage &graph, size_t degree);
+std::vector<std::size_t> get_dof_chunk_offsets(const GraphStorage &graph, const DofMap &dof_map, const std::vector<std::size_t> &edge_ids, const std::vector<std::size_t> &edge_chunk_offsets);
 
 } // namespace macrocirculation
 
@@ -5,27 +5,132 @@
 //  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <sstream>
 #include <utility>
 
 #include "communication/mpi.hpp"
 #include "graph_pvd_writer.hpp"
 #include "graph_storage.hpp"
+#include "phase_timers.hpp"
 
 namespace macrocirculation {
 
+namespace {
+
+bool is_little_endian() {
+  const std::uint16_t value = 1;
+  return *reinterpret_cast<const std::uint8_t *>(&value) == 1;
+}
+
+std::string encode_base64(const std::string &bytes) {
+  static const char *table = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+  std::string encoded;
+  encoded.reserve(4 * ((bytes.size() + 2) / 3));
+  for (std::size_t i = 0; i < bytes.size(); i += 3) {
+    const std::size_t num_bytes = std::min<std::size_t>(3, bytes.size() - i);
+    std::uint32_t block = 0;
+    for (std::size_t k = 0; k < num_bytes; k += 1)
+      block |= static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[i + k])) << (16 - 8 * k);
+    for (std::size_t k = 0; k < 4; k += 1)
+      encoded.push_back(k <= num_bytes ? table[(block >> (18 - 6 * k)) & 0x3f] : '=');
+  }
+  return encoded;
+}
+
+/*! @brief Encodes the values as text, or as binary block, which starts with its size in bytes as UInt64. */
+template <typename T>
+std::string encode(GraphPVDWriter::Format format, const std::vector<T> &values) {
+  if (format == GraphPVDWriter::Format::ascii) {
+    std::stringstream out;
+    for (const auto &value : values)
+      out << value << " ";
+    return out.str();
+  }
+
+  const std::uint64_t num_bytes = values.size() * sizeof(T);
+  std::string bytes(sizeof(num_bytes) + num_bytes, '\0');
+  std::memcpy(&bytes[0], &num_bytes, sizeof(num_bytes));
+  if (num_bytes > 0)
+    std::memcpy(&bytes[sizeof(num_bytes)], values.data(), num_bytes);
+
+  // uncompressed blocks are encoded together with their header
+  if (format == GraphPVDWriter::Format::base64)
+    return encode_base64(bytes);
+
+  return bytes;
+}
+
+} // namespace
+
 GraphPVDWriter::GraphPVDWriter(MPI_Comm comm, std::string folder_name, std::string dataset_name)
     : d_comm(comm),
       d_folder_name(std::move(folder_name)),
       d_dataset_name(std::move(dataset_name)),
       d_times(),
       d_points(),
+      d_format(Format::ascii),
+      d_double_precision(false),
+      d_geometry(),
       d_vertex_data() {}
 
 void GraphPVDWriter::set_points(std::vector<Point> points) {
   if (!d_vertex_data.empty())
     throw std::runtime_error("points data must be set before vertex data");
+
+  // most callers set the same points for every time step, which we do not want to encode again
+  const bool same_points = !d_geometry.empty() && points.size() == d_points.size() &&
+                           std::equal(points.begin(), points.end(), d_points.begin(), [](const Point &a, const Point &b) {
+                             return a.x == b.x && a.y == b.y && a.z == b.z;
+                           });
   d_points = std::move(points);
+  if (!same_points)
+    encode_geometry();
+}
+
+void GraphPVDWriter::set_format(Format format) {
+  d_format = format;
+  if (!d_geometry.empty())
+    encode_geometry();
+}
+
+void GraphPVDWriter::set_double_precision(bool double_precision) {
+  d_double_precision = double_precision;
+}
+
+std::string GraphPVDWriter::get_field_type() const {
+  return d_double_precision ? "Float64" : "Float32";
+}
+
+void GraphPVDWriter::encode_geometry() {
+  const std::size_t num_points = d_points.size();
+
+  std::vector<float> coordinates;
+  coordinates.reserve(3 * num_points);
+  for (const auto &p : d_points) {
+    coordinates.push_back(static_cast<float>(p.x));
+    coordinates.push_back(static_cast<float>(p.y));
+    coordinates.push_back(static_cast<float>(p.z));
+  }
+
+  // every line segment has its own two points
+  std::vector<std::int32_t> connectivity(num_points);
+  for (std::size_t idx = 0; idx < num_points; idx += 1)
+    connectivity[idx] = static_cast<std::int32_t>(idx);
+
+  // the end positions of all the cells (here line segments)
+  std::vector<std::int32_t> offsets(num_points / 2);
+  for (std::size_t idx = 0; idx < offsets.size(); idx += 1)
+    offsets[idx] = static_cast<std::int32_t>(2 * (idx + 1));
+
+  d_geometry = {
+    {"Float32", "", 3, encode(d_format, coordinates)},
+    {"Int32", "connectivity", 1, encode(d_format, connectivity)},
+    {"Int32", "offsets", 1, encode(d_format, offsets)}};
 }
 
 void GraphPVDWriter::add_vertex_data(const std::string &name, std::vector<double> data) {
@@ -36,15 +141,32 @@ void GraphPVDWriter::add_vertex_data(const std::string &name, std::vector<double
   d_vertex_data.push_back(std::move(NamedField(name, std::move(data))));
 }
 
+MemoryReport GraphPVDWriter::memory_report() const {
+  MemoryReport report;
+  report.add("times", d_times);
+  report.add("points", d_points);
+  report.add("geometry", d_geometry);
+  for (const auto &array : d_geometry)
+    report.add("geometry", array.data.capacity());
+  report.add("vertex data", d_vertex_data);
+  for (const auto &field : d_vertex_data)
+    report.add("vertex data", field.values);
+  return report;
+}
+
 void GraphPVDWriter::write(double time) {
+  SCOPED_PHASE_TIMER("output");
   if (!d_times.empty() && time < d_times.back())
     throw std::runtime_error("inserting values of the past in graph writer.");
 
   d_times.push_back(time);
 
+  if (d_geometry.empty())
+    encode_geometry();
+
   // write vtp file for current rank
   {
-    std::fstream vtp_file(d_folder_name + "/" + get_vtp_filename(d_times.size() - 1, mpi::rank(d_comm)), std::ios::out);
+    std::fstream vtp_file(d_folder_name + "/" + get_vtp_filename(d_times.size() - 1, mpi::rank(d_comm)), std::ios::out | std::ios::binary);
     write_vtp(vtp_file);
   }
 
@@ -81,53 +203,74 @@ void GraphPVDWriter::write_vtp(std::ostream &out) const {
 
   const std::size_t num_lines = num_points / 2;
 
+  std::vector<EncodedArray> fields;
+  for (const auto &nf : d_vertex_data) {
+    if (d_double_precision || d_format == Format::ascii) {
+      fields.push_back({get_field_type(), nf.name, 1, encode(d_format, nf.values)});
+    } else {
+      const std::vector<float> values(nf.values.begin(), nf.values.end());
+      fields.push_back({"Float32", nf.name, 1, encode(d_format, values)});
+    }
+  }
+
+  // the appended data follows the xml in the order of the arrays
+  std::uint64_t appended_offset = 0;
+  const auto write_data_array = [&](const EncodedArray &array) {
+    out << "<DataArray type=\"" << array.type << "\"";
+    if (!array.name.empty())
+      out << " Name=\"" << array.name << "\"";
+    if (array.num_components > 1)
+      out << " NumberOfComponents=\"" << array.num_components << "\"";
+    if (d_format == Format::raw_appended) {
+      out << " format=\"appended\" offset=\"" << appended_offset << "\"/>\n";
+      appended_offset += array.data.size();
+      return;
+    }
+    out << " format=\"" << (d_format == Format::ascii ? "ascii" : "binary") << "\">\n";
+    out << array.data << "\n";
+    out << "</DataArray>\n";
+  };
+
   out << "<?xml version=\"1.0\"?>\n";
-  out << "<VTKFile type=\"PolyData\" version=\"0.1\" byte_order=\"LittleEndian\">\n";
+  if (d_format == Format::ascii)
+    out << "<VTKFile type=\"PolyData\" version=\"0.1\" byte_order=\"LittleEndian\">\n";
+  else
+    out << "<VTKFile type=\"PolyData\" version=\"1.0\" byte_order=\"" << (is_little_endian() ? "LittleEndian" : "BigEndian") << "\" header_type=\"UInt64\">\n";
 
   out << "<PolyData>\n";
   out << "<Piece NumberOfPoints=\"" << num_points << "\" NumberOfLines=\"" << num_lines << "\">\n";
 
   // write the point coordinates
   out << "<Points>\n";
-  out << "<DataArray type=\"Float32\" NumberOfComponents=\"3\" format=\"ascii\">\n";
-  for (const auto &p : d_points)
-    out << p.x << " " << p.y << " " << p.z << " ";
-  out << "\n";
-  out << "</DataArray>\n";
+  write_data_array(d_geometry[0]);
   out << "</Points>\n";
 
   // connect the points with lines
   out << "<Lines>\n";
-  // the connectivity
-  out << "<DataArray type=\"Int32\" Name=\"connectivity\">\n";
-  for (std::size_t idx = 0; idx < num_points; idx += 1)
-    out << std::to_string(idx) << " ";
-  out << "\n";
-  out << "</DataArray>\n";
-  // the end positions of all the cells (here line segments)
-  out << "<DataArray type=\"Int32\" Name=\"offsets\">\n";
-  for (std::size_t idx = 0; idx < num_lines; idx += 1)
-    out << std::to_string(2 * (idx + 1)) << " ";
-  out << "\n";
-  out << "</DataArray>\n";
+  write_data_array(d_geometry[1]);
+  write_data_array(d_geometry[2]);
   out << "</Lines>\n";
 
   // write the scalar data
-  if (!d_vertex_data.empty()) {
-    out << "<PointData Scalars=\"" << d_vertex_data[0].name << "\">\n";
-    for (const auto &nf : d_vertex_data) {
-      out << "<DataArray type=\"Float32\" format=\"ascii\" Name=\"" << nf.name << "\">\n";
-      for (const auto &value : nf.values)
-        out << value << " ";
-      out << "\n";
-      out << "</DataArray>\n";
-    }
+  if (!fields.empty()) {
+    out << "<PointData Scalars=\"" << fields[0].name << "\">\n";
+    for (const auto &field : fields)
+      write_data_array(field);
     out << "</PointData>\n";
   }
 
   out << "</Piece>\n";
   out << "</PolyData>\n";
 
+  if (d_format == Format::raw_appended) {
+    out << "<AppendedData encoding=\"raw\">\n_";
+    for (const auto &array : d_geometry)
+      out << array.data;
+    for (const auto &field : fields)
+      out << field.data;
+    out << "\n</AppendedData>\n";
+  }
+
   out << "</VTKFile>\n";
 }
 
@@ -143,7 +286,7 @@ void GraphPVDWriter::write_pvtp(std::ostream &out) const {
   if (!d_vertex_data.empty()) {
     out << "<PPointData Scalars=\"" << d_vertex_data[0].name << "\">\n";
     for (const auto &nf : d_vertex_data)
-      out << "<PDataArray type=\"Float32\" Name=\"" << nf.name << "\" />\n";
+      out << "<PDataArray type=\"" << get_field_type() << "\" Name=\"" << nf.name << "\" />\n";
     out << "</PPointData>\n";
   }
 
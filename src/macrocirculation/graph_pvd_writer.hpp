@@ -8,11 +8,14 @@
 #ifndef TUMORMODELS_GRAPH_PVD_WRITER_HPP
 #define TUMORMODELS_GRAPH_PVD_WRITER_HPP
 
+#include <cstddef>
 #include <mpi.h>
 #include <ostream>
 #include <string>
 #include <vector>
 
+#include "memory_report.hpp"
+
 namespace macrocirculation {
 
 // forward declarations
@@ -28,6 +31,16 @@ class Point;
  */
 class GraphPVDWriter {
 public:
+  /*! @brief The encoding of the data arrays in the vtp files. */
+  enum class Format {
+    /*! @brief Human readable text, the default. */
+    ascii,
+    /*! @brief Base64 encoded binary data inside of the data arrays. */
+    base64,
+    /*! @brief Raw binary data appended after the xml, which is the smallest and fastest format. */
+    raw_appended
+  };
+
   /*! @brief Constructs a pvd writer, which writes into folder_name  pvd, vtp and pvtp files with the given dataset_name. */
   GraphPVDWriter(MPI_Comm comm, std::string folder_name, std::string dataset_name);
 
@@ -36,6 +49,12 @@ public:
    */
   void set_points(std::vector<Point> points);
 
+  /*! @brief Sets the encoding of the next vtp files. */
+  void set_format(Format format);
+
+  /*! @brief Writes the vertex data as Float64 instead of Float32 values. */
+  void set_double_precision(bool double_precision);
+
   /*! @brief Adds vertex data to save later.
    *         The data has to match the serialized point data given in set_points.
    *         Thus depending on the connectivity every vertex gets saved several times.
@@ -46,6 +65,9 @@ public:
   /*! @brief Writes the data for the current time. */
   void write(double time);
 
+  /*! @brief Returns the memory of the points, the encoded geometry and the vertex data. */
+  MemoryReport memory_report() const;
+
 private:
   const MPI_Comm d_comm;
   const std::string d_folder_name;
@@ -55,6 +77,21 @@ private:
 
   std::vector<Point> d_points;
 
+  Format d_format;
+
+  bool d_double_precision;
+
+  /*! @brief A data array, whose values are already converted into the text of the format. */
+  struct EncodedArray {
+    std::string type;
+    std::string name;
+    std::size_t num_components;
+    std::string data;
+  };
+
+  /*! @brief The points, connectivity and offsets, which are encoded once for all the time steps with the same points. */
+  std::vector<EncodedArray> d_geometry;
+
   struct NamedField {
     NamedField(std::string n, std::vector<double> v) : name(std::move(n)), values(std::move(v)) {}
 
@@ -66,6 +103,10 @@ private:
   std::vector<NamedField> d_vertex_data;
 
 private:
+  void encode_geometry();
+
+  std::string get_field_type() const;
+
   void write_vtp(std::ostream &out) const;
 
   void write_pvtp(std::ostream &out) const;
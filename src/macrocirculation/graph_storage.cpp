@@ -8,13 +8,31 @@
 #include <cmath> // (add before graph_storage.hpp) easy fix for compile error about std::abs
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstddef>
+#include <new>
+#include <numeric>
+#include <set>
 #include <utility>
 
+#include "communication/mpi.hpp"
+#include "communication/shared_memory_segment.hpp"
+#include "phase_timers.hpp"
+#include "spatial_index.hpp"
 #include "vessel_formulas.hpp"
 
 namespace macrocirculation {
 
+namespace {
+
+/*! @brief Counts the modifications of all the graphs, such that the caches of the graphs can detect outdated entries. */
+std::atomic<std::size_t> graph_revision{1};
+
+void invalidate_graph_caches() { graph_revision += 1; }
+
+} // namespace
+
 Point::Point(double x, double y, double z)
     : x(x), y(y), z(z) {}
 
@@ -39,7 +57,8 @@ std::size_t DiscretizationData::num_micro_edges() const {
 }
 
 Primitive::Primitive(std::size_t id)
-    : p_id(id) {}
+    : p_id(id),
+      p_name_index(nullptr) {}
 
 std::size_t Primitive::get_id() const {
   return p_id;
@@ -80,7 +99,7 @@ size_t Vertex::local_edge_index(const Edge &edge) const {
 }
 
 const Vertex &InterGraphConnection::get_vertex() const {
-  return *get_graph().get_vertex(d_vertex_id);
+  return get_graph().vertex(d_vertex_id);
 }
 
 
@@ -88,19 +107,46 @@ const std::string &Primitive::get_name() const {
   return p_name;
 }
 
-void Primitive::set_name(const std::string &name) {
-  p_name = name;
+namespace {
+
+/*! @brief Adds the entry of the given name and id to the index. */
+void insert_into_name_index(NameIndex &index, const std::string &name, std::size_t id) {
+  index[name].insert(id);
+}
+
+/*! @brief Removes the entry of the given name and id from the index. */
+void erase_from_name_index(NameIndex &index, const std::string &name, std::size_t id) {
+  const auto it = index.find(name);
+  if (it == index.end())
+    return;
+  it->second.erase(id);
+  if (it->second.empty())
+    index.erase(it);
 }
 
-double default_inflow_function(double) {
-  throw std::runtime_error("inflow value at inflow boundary not set");
+/*! @brief Returns the smallest id with the given name, like a search by increasing ids would, or nullptr if there is none. */
+const std::size_t *find_in_name_index(const NameIndex &index, const std::string &name) {
+  const auto it = index.find(name);
+  if (it == index.end() || it->second.empty())
+    return nullptr;
+  return &*it->second.begin();
+}
+
+} // namespace
+
+void Primitive::set_name(const std::string &name) {
+  if (p_name_index != nullptr) {
+    erase_from_name_index(*p_name_index, p_name, p_id);
+    insert_into_name_index(*p_name_index, name, p_id);
+  }
+  p_name = name;
 }
 
 Vertex::Vertex(std::size_t id)
     : Primitive(id),
-      p_inflow_value(default_inflow_function),
       p_flow_type(FlowType::Undefined),
-      d_bcs_finalized(false) {}
+      d_bcs_finalized(false),
+      d_is_continuity_vertex(false) {}
 
 const std::vector<std::size_t> &Vertex::get_edge_neighbors() const {
   return p_neighbors;
@@ -120,13 +166,29 @@ bool Vertex::is_bifurcation() const {
   return p_neighbors.size() > 1;
 }
 
+bool Vertex::is_continuity_vertex() const {
+  return d_is_continuity_vertex;
+}
+
+template<typename Data>
+const Data &Vertex::get_boundary_data() const {
+  if (p_boundary_data == nullptr || !std::holds_alternative<Data>(*p_boundary_data))
+    throw std::runtime_error("the boundary condition of vertex " + get_name() + " has no such data");
+  return std::get<Data>(*p_boundary_data);
+}
+
+template<typename Data>
+Data &Vertex::get_boundary_data() {
+  return const_cast<Data &>(static_cast<const Vertex &>(*this).get_boundary_data<Data>());
+}
+
 void Vertex::set_to_inflow_with_fixed_flow(std::function<double(double)> inflow_value) {
   if (!is_leaf())
     throw std::runtime_error("inflow bc can only be set for leaf nodes (vertex name = " + get_name() + ")");
   if (d_bcs_finalized)
     throw std::runtime_error("finalized boundary conditions cannot be changed.");
   p_flow_type = FlowType::InflowFixedFlow;
-  p_inflow_value = std::move(inflow_value);
+  p_boundary_data = std::make_unique<BoundaryData>(std::move(inflow_value));
 }
 
 void Vertex::set_to_inflow_with_fixed_pressure(std::function<double(double)> pressure_value) {
@@ -135,7 +197,7 @@ void Vertex::set_to_inflow_with_fixed_pressure(std::function<double(double)> pre
   if (d_bcs_finalized)
     throw std::runtime_error("finalized boundary conditions cannot be changed.");
   p_flow_type = FlowType::InflowFixedPressure;
-  p_inflow_value = std::move(pressure_value);
+  p_boundary_data = std::make_unique<BoundaryData>(std::move(pressure_value));
 }
 
 void Vertex::set_to_free_outflow() {
@@ -144,7 +206,7 @@ void Vertex::set_to_free_outflow() {
   if (d_bcs_finalized)
     throw std::runtime_error("finalized boundary conditions cannot be changed.");
   p_flow_type = FlowType::FreeOutflow;
-  p_inflow_value = default_inflow_function;
+  p_boundary_data = nullptr;
 }
 
 void Vertex::set_to_windkessel_outflow(double r, double c) {
@@ -153,10 +215,8 @@ void Vertex::set_to_windkessel_outflow(double r, double c) {
   if (d_bcs_finalized)
     throw std::runtime_error("finalized boundary conditions cannot be changed.");
   p_flow_type = FlowType::Windkessel;
-  p_peripheral_vessel_data.resistance = r;
-  p_peripheral_vessel_data.compliance = c;
-  // TODO: Make this settable from outside!
-  p_peripheral_vessel_data.p_out = 5.0 * 1.333322;
+  // TODO: Make p_out settable from outside!
+  p_boundary_data = std::make_unique<BoundaryData>(PeripheralVesselData{r, c, 5.0 * 1.333322});
 }
 
 void Vertex::set_to_vessel_tree_outflow(double p, const std::vector<double> &resistances, const std::vector<double> &capacitances, const std::vector<double> &radii, size_t furcation_number) {
@@ -165,41 +225,56 @@ void Vertex::set_to_vessel_tree_outflow(double p, const std::vector<double> &res
   if (d_bcs_finalized)
     throw std::runtime_error("finalized boundary conditions cannot be changed.");
   p_flow_type = FlowType::VesselTree;
-  p_vessel_tree_data.p_out = p;
-  p_vessel_tree_data.resistances = resistances;
-  p_vessel_tree_data.capacitances = capacitances;
-  p_vessel_tree_data.radii = radii;
-  p_vessel_tree_data.furcation_number = furcation_number;
+  p_boundary_data = std::make_unique<BoundaryData>(VesselTreeData{resistances, capacitances, radii, p, furcation_number});
 }
 
 bool Vertex::bc_finalized() const { return d_bcs_finalized; }
 
 void Vertex::finalize_bcs() { d_bcs_finalized = true; }
 
+void Vertex::unfinalize_bcs() { d_bcs_finalized = false; }
+
 void Vertex::update_vessel_tip_pressures(double p) {
   if (is_vessel_tree_outflow())
-    p_vessel_tree_data.p_out = p;
+    get_boundary_data<VesselTreeData>().p_out = p;
   else if (is_rcl_outflow())
-    p_rcl_data.p_out = p;
+    get_boundary_data<RCLModel>().p_out = p;
   else if (is_windkessel_outflow())
-    p_peripheral_vessel_data.p_out = p;
+    get_boundary_data<PeripheralVesselData>().p_out = p;
   else
     throw std::runtime_error("updating the boundary pressure was not implemented for the given boundary type.");
 }
 
+void Vertex::update_windkessel_parameters(double r, double c) {
+  if (!is_windkessel_outflow())
+    throw std::runtime_error("vertex " + get_name() + " has no windkessel bc whose parameters could be updated.");
+  auto &data = get_boundary_data<PeripheralVesselData>();
+  data.resistance = r;
+  data.compliance = c;
+  invalidate_graph_caches();
+}
+
+void Vertex::update_vessel_tree_parameters(const std::vector<double> &resistances, const std::vector<double> &capacitances) {
+  if (!is_vessel_tree_outflow())
+    throw std::runtime_error("vertex " + get_name() + " has no vessel tree bc whose parameters could be updated.");
+  auto &data = get_boundary_data<VesselTreeData>();
+  if (resistances.size() != data.resistances.size() || capacitances.size() != data.capacitances.size())
+    throw std::runtime_error("the number of compartments of the vessel tree at vertex " + get_name() + " cannot be changed.");
+  data.resistances = resistances;
+  data.capacitances = capacitances;
+  invalidate_graph_caches();
+}
+
 const PeripheralVesselData &Vertex::get_peripheral_vessel_data() const {
-  assert(is_windkessel_outflow());
-  return p_peripheral_vessel_data;
+  return get_boundary_data<PeripheralVesselData>();
 }
 
 const VesselTreeData &Vertex::get_vessel_tree_data() const {
-  assert(is_vessel_tree_outflow());
-  return p_vessel_tree_data;
+  return get_boundary_data<VesselTreeData>();
 }
 
 const RCLModel &Vertex::get_rcl_data() const {
-  assert(is_rcl_outflow());
-  return p_rcl_data;
+  return get_boundary_data<RCLModel>();
 }
 
 bool Vertex::is_rcl_outflow() const {
@@ -207,13 +282,11 @@ bool Vertex::is_rcl_outflow() const {
 }
 
 const LinearCharacteristicData &Vertex::get_linear_characteristic_data() const {
-  assert(is_linear_characteristic_inflow());
-  return p_linear_characteristic_data;
+  return get_boundary_data<LinearCharacteristicData>();
 }
 
 const NonlinearCharacteristicData &Vertex::get_nonlinear_characteristic_data() const {
-  assert(is_nonlinear_characteristic_inflow());
-  return p_nonlinear_characteristic_data;
+  return get_boundary_data<NonlinearCharacteristicData>();
 }
 
 bool Vertex::is_free_outflow() const { return p_flow_type == FlowType::FreeOutflow; }
@@ -239,7 +312,9 @@ bool Vertex::is_nonlinear_characteristic_inflow() const {
 }
 
 double Vertex::get_inflow_value(double time) const {
-  return p_inflow_value(time);
+  if (!is_inflow_with_fixed_flow() && !is_inflow_with_fixed_pressure())
+    throw std::runtime_error("inflow value at inflow boundary not set");
+  return get_boundary_data<std::function<double(double)>>()(time);
 }
 
 void Vertex::set_to_linear_characteristic_inflow(double C, double L, bool points_towards_vertex, double p, double q) {
@@ -249,11 +324,7 @@ void Vertex::set_to_linear_characteristic_inflow(double C, double L, bool points
     throw std::runtime_error("finalized boundary conditions cannot be changed.");
   p_flow_type = FlowType::LinearCharacteristic;
   double sigma = points_towards_vertex ? +1 : -1;
-  p_linear_characteristic_data.C = C;
-  p_linear_characteristic_data.L = L;
-  p_linear_characteristic_data.points_towards_vertex = points_towards_vertex;
-  p_linear_characteristic_data.p = p;
-  p_linear_characteristic_data.q = sigma * q;
+  p_boundary_data = std::make_unique<BoundaryData>(LinearCharacteristicData{C, L, points_towards_vertex, p, sigma * q});
 }
 
 void Vertex::set_to_vessel_rcl_outflow(double p, const std::vector<double> &resistances, const std::vector<double> &capacitances, const std::vector<double> &inductances) {
@@ -262,10 +333,7 @@ void Vertex::set_to_vessel_rcl_outflow(double p, const std::vector<double> &resi
   if (d_bcs_finalized)
     throw std::runtime_error("finalized boundary conditions cannot be changed.");
   p_flow_type = FlowType::RCLModel;
-  p_rcl_data.resistances = resistances;
-  p_rcl_data.capacitances = capacitances;
-  p_rcl_data.inductances = inductances;
-  p_rcl_data.p_out = p;
+  p_boundary_data = std::make_unique<BoundaryData>(RCLModel{resistances, capacitances, inductances, p});
 }
 
 void Vertex::set_to_nonlinear_characteristic_inflow(double G0, double A0, double rho, bool points_towards_vertex, double p, double q) {
@@ -275,30 +343,28 @@ void Vertex::set_to_nonlinear_characteristic_inflow(double G0, double A0, double
     throw std::runtime_error("finalized boundary conditions cannot be changed.");
   p_flow_type = FlowType::NonlinearCharacteristic;
   double sigma = points_towards_vertex ? +1 : -1;
-  p_nonlinear_characteristic_data.G0 = G0;
-  p_nonlinear_characteristic_data.A0 = A0;
-  p_nonlinear_characteristic_data.rho = rho;
-  p_nonlinear_characteristic_data.points_towards_vertex = points_towards_vertex;
-  p_nonlinear_characteristic_data.p = p;
-  p_nonlinear_characteristic_data.q = sigma * q;
+  p_boundary_data = std::make_unique<BoundaryData>(NonlinearCharacteristicData{G0, A0, rho, points_towards_vertex, p, sigma * q});
 }
 
 void Vertex::update_linear_characteristic_inflow(double p, double q) {
   assert(p_flow_type == FlowType::LinearCharacteristic);
-  double sigma = p_linear_characteristic_data.points_towards_vertex ? +1 : -1;
-  p_linear_characteristic_data.p = p;
-  p_linear_characteristic_data.q = sigma * q;
+  auto &data = get_boundary_data<LinearCharacteristicData>();
+  double sigma = data.points_towards_vertex ? +1 : -1;
+  data.p = p;
+  data.q = sigma * q;
 }
 
 void Vertex::update_nonlinear_characteristic_inflow(double p, double q) {
   assert(p_flow_type == FlowType::NonlinearCharacteristic);
-  double sigma = p_nonlinear_characteristic_data.points_towards_vertex ? +1 : -1;
-  p_nonlinear_characteristic_data.p = p;
-  p_nonlinear_characteristic_data.q = sigma * q;
+  auto &data = get_boundary_data<NonlinearCharacteristicData>();
+  double sigma = data.points_towards_vertex ? +1 : -1;
+  data.p = p;
+  data.q = sigma * q;
 }
 
 void Vertex::add_inter_graph_connection(std::shared_ptr<GraphStorage> graph, Vertex &v) {
   d_inter_graph_connections.emplace_back(graph, v);
+  invalidate_graph_caches();
 }
 
 const std::vector<InterGraphConnection> &Vertex::get_inter_graph_connections() const {
@@ -327,7 +393,7 @@ const EmbeddingData &Edge::get_embedding_data() const {
 }
 
 void Edge::add_physical_data(const PhysicalData &data) {
-  physical_data = std::make_unique<PhysicalData>(data);
+  physical_data = std::make_shared<PhysicalData>(data);
 }
 
 void Edge::add_discretization_data(const DiscretizationData &data) {
@@ -336,6 +402,8 @@ void Edge::add_discretization_data(const DiscretizationData &data) {
 
 void Edge::add_embedding_data(const EmbeddingData &data) {
   embedding_data = std::make_unique<EmbeddingData>(data);
+  // the spatial indices of the graphs are outdated
+  invalidate_graph_caches();
 };
 
 bool Edge::has_physical_data() const {
@@ -362,14 +430,14 @@ void GraphStorage::reorder_edges(Vertex &v) {
   if (v.get_edge_neighbors().size() <= 1)
     return;
 
-  const auto e0 = get_edge(v.get_edge_neighbors()[0]);
-  const auto e1 = get_edge(v.get_edge_neighbors()[1]);
+  const auto &e0 = edge(v.get_edge_neighbors()[0]);
+  const auto &e1 = edge(v.get_edge_neighbors()[1]);
 
-  if (e0->is_pointing_to(v.get_id()) == e1->is_pointing_to(v.get_id()))
+  if (e0.is_pointing_to(v.get_id()) == e1.is_pointing_to(v.get_id()))
     throw std::runtime_error("edges cannot be reordered");
 
   // nothing to reorder
-  if (e0->is_pointing_to(v.get_id()))
+  if (e0.is_pointing_to(v.get_id()))
     return;
 
   std::swap(v.p_neighbors[0], v.p_neighbors[1]);
@@ -384,54 +452,55 @@ Edge::Edge(std::size_t id,
     : Primitive(id),
       p_neighbors({v1.get_id(), v2.get_id()}),
       d_rank(0),
-      d_micro_edges(),
-      d_micro_vertices() {
+      d_first_micro_edge_id(0),
+      d_first_micro_vertex_id(0),
+      d_num_micro_edges(0) {
+  create_micro_primitives(first_micro_edge_id, first_micro_vertex_id, num_micro_edges);
+};
+
+void Edge::create_micro_primitives(std::size_t first_micro_edge_id, std::size_t first_micro_vertex_id, std::size_t num_micro_edges) {
   assert(num_micro_edges > 0);
 
-  // create micro edges
-  for (std::size_t local_micro_edge_id = 0; local_micro_edge_id < num_micro_edges; local_micro_edge_id += 1)
-    d_micro_edges.emplace_back(local_micro_edge_id, first_micro_edge_id + local_micro_edge_id);
-
-  // create micro vertices
-  for (std::size_t local_micro_vertex_id = 0; local_micro_vertex_id < num_micro_edges + 1; local_micro_vertex_id += 1)
-    d_micro_vertices.emplace_back(local_micro_vertex_id, first_micro_vertex_id + local_micro_vertex_id);
-
-  // connect inner micro_vertices
-  d_micro_vertices[0].d_right_edge = &d_micro_edges[0];
-  d_micro_vertices[0].d_right_vertex = &d_micro_vertices[1];
-  for (std::size_t local_micro_vertex_id = 1; local_micro_vertex_id < num_micro_edges; local_micro_vertex_id += 1) {
-    d_micro_vertices[local_micro_vertex_id].d_left_edge = &d_micro_edges[local_micro_vertex_id - 1];
-    d_micro_vertices[local_micro_vertex_id].d_right_edge = &d_micro_edges[local_micro_vertex_id];
-    d_micro_vertices[local_micro_vertex_id].d_left_vertex = &d_micro_vertices[local_micro_vertex_id - 1];
-    d_micro_vertices[local_micro_vertex_id].d_right_vertex = &d_micro_vertices[local_micro_vertex_id + 1];
-  }
-  d_micro_vertices.back().d_left_edge = &d_micro_edges.back();
-  d_micro_vertices.back().d_left_vertex = &d_micro_vertices.back() - 1;
-};
+  d_first_micro_edge_id = first_micro_edge_id;
+  d_first_micro_vertex_id = first_micro_vertex_id;
+  d_num_micro_edges = num_micro_edges;
+}
+
+bool Edge::has_micro_edge_lengths() const {
+  return has_discretization_data() && discretization_data->num_micro_edges() == num_micro_edges();
+}
+
+std::vector<double> Edge::get_micro_edge_lengths() const {
+  if (has_micro_edge_lengths())
+    return discretization_data->lengths;
+  return std::vector<double>(num_micro_edges(), get_physical_data().length / static_cast<double>(num_micro_edges()));
+}
 
-std::size_t Edge::num_micro_edges() const { return d_micro_edges.size(); };
+std::size_t Edge::num_micro_edges() const { return d_num_micro_edges; };
 
-std::size_t Edge::num_micro_vertices() const { return d_micro_edges.size() + 1; };
+std::size_t Edge::num_micro_vertices() const { return d_num_micro_edges + 1; };
 
-const std::vector<MicroEdge> &Edge::micro_edges() const { return d_micro_edges; };
+MicroPrimitiveRange<MicroEdge> Edge::micro_edges() const {
+  return {0, d_num_micro_edges, d_first_micro_edge_id, d_first_micro_vertex_id, d_num_micro_edges};
+};
 
-const std::vector<MicroVertex> &Edge::micro_vertices() const { return d_micro_vertices; }
+MicroPrimitiveRange<MicroVertex> Edge::micro_vertices() const {
+  return {0, d_num_micro_edges + 1, d_first_micro_edge_id, d_first_micro_vertex_id, d_num_micro_edges};
+}
 
 const std::vector<std::size_t> &Edge::get_vertex_neighbors() const {
   return p_neighbors;
 };
 
-Edge::InnerVerticesIterator Edge::inner_micro_vertices() const {
-  return InnerVerticesIterator{d_micro_vertices};
+MicroPrimitiveRange<MicroVertex> Edge::inner_micro_vertices() const {
+  return {1, d_num_micro_edges, d_first_micro_edge_id, d_first_micro_vertex_id, d_num_micro_edges};
 }
 
-const MicroVertex &Edge::left_micro_vertex() const {
-  assert(!d_micro_vertices.empty());
-  return d_micro_vertices[0];
+MicroVertex Edge::left_micro_vertex() const {
+  return {0, d_first_micro_edge_id, d_first_micro_vertex_id, d_num_micro_edges};
 }
-const MicroVertex &Edge::right_micro_vertex() const {
-  assert(!d_micro_vertices.empty());
-  return d_micro_vertices.back();
+MicroVertex Edge::right_micro_vertex() const {
+  return {d_num_micro_edges, d_first_micro_edge_id, d_first_micro_vertex_id, d_num_micro_edges};
 }
 
 std::size_t Edge::get_adajcent_micro_edge_id(const Vertex &vertex) const {
@@ -442,49 +511,236 @@ std::size_t Edge::get_adajcent_micro_edge_id(const Vertex &vertex) const {
 }
 
 GraphStorage::GraphStorage()
-    : p_next_edge_id(0),
-      p_next_vertex_id(0),
+    : d_num_edges(0),
+      d_adjacency_offsets_data(nullptr),
+      d_adjacency_data(nullptr),
       d_num_micro_edges(0),
-      d_num_micro_vertices(0){};
+      d_num_micro_vertices(0),
+      d_restricted_rank(-1){};
+
+GraphStorage::~GraphStorage() {
+  for (auto &edge : p_edges)
+    if (edge != nullptr)
+      edge->p_name_index = nullptr;
+  for (auto &vertex : p_vertices)
+    if (vertex != nullptr)
+      vertex->p_name_index = nullptr;
+}
 
 std::shared_ptr<Edge> GraphStorage::get_edge(std::size_t id) {
-  return p_edges.at(id);
+  edge(id);
+  return p_edges[id];
 };
 
 std::shared_ptr<const Edge> GraphStorage::get_edge(std::size_t id) const {
-  return p_edges.at(id);
+  edge(id);
+  return p_edges[id];
 }
 
 std::shared_ptr<Vertex> GraphStorage::get_vertex(std::size_t id) {
   return p_vertices.at(id);
 }
+
 std::shared_ptr<const Vertex> GraphStorage::get_vertex(std::size_t id) const {
   return p_vertices.at(id);
 }
 
+Edge &GraphStorage::edge(std::size_t id) {
+  return const_cast<Edge &>(static_cast<const GraphStorage &>(*this).edge(id));
+}
+
+const Edge &GraphStorage::edge(std::size_t id) const {
+  if (id >= p_edges.size() || p_edges[id] == nullptr)
+    throw std::out_of_range("GraphStorage::edge: edge with id " + std::to_string(id) + " not found in storage");
+  return *p_edges[id];
+}
+
+Vertex &GraphStorage::vertex(std::size_t id) {
+  return const_cast<Vertex &>(static_cast<const GraphStorage &>(*this).vertex(id));
+}
+
+const Vertex &GraphStorage::vertex(std::size_t id) const {
+  if (id >= p_vertices.size() || p_vertices[id] == nullptr)
+    throw std::out_of_range("GraphStorage::vertex: vertex with id " + std::to_string(id) + " not found in storage");
+  return *p_vertices[id];
+}
+
+GraphStorage::AdjacentEdgesRange GraphStorage::adjacent_edges(std::size_t vertex_id) const {
+  if (!is_finalized())
+    throw std::runtime_error("GraphStorage::adjacent_edges: adjacency not available. Please call GraphStorage::finalize_bcs() before.");
+  if (vertex_id >= p_vertices.size())
+    throw std::out_of_range("GraphStorage::adjacent_edges: vertex with id " + std::to_string(vertex_id) + " not found in storage");
+  return {d_adjacency_data + d_adjacency_offsets_data[vertex_id], d_adjacency_data + d_adjacency_offsets_data[vertex_id + 1]};
+}
+
+MemoryReport GraphStorage::memory_report() const {
+  MemoryReport report;
+
+  report.add("edges", p_edges);
+  for (const auto &e : p_edges) {
+    if (e == nullptr)
+      continue;
+    report.add("edges", sizeof(Edge) + e->get_name().capacity() + e->p_neighbors.capacity() * sizeof(std::size_t));
+    if (e->physical_data != nullptr && (d_shared_segment == nullptr || !d_shared_segment->contains(e->physical_data.get())))
+      report.add("edges", sizeof(PhysicalData));
+    if (e->discretization_data != nullptr)
+      report.add("edges", sizeof(DiscretizationData) + e->discretization_data->lengths.capacity() * sizeof(double));
+    if (e->embedding_data != nullptr)
+      report.add("embedding", sizeof(EmbeddingData) + e->embedding_data->points.capacity() * sizeof(Point));
+  }
+
+  report.add("vertices", p_vertices);
+  for (const auto &v : p_vertices) {
+    if (v == nullptr)
+      continue;
+    report.add("vertices", sizeof(Vertex) + v->get_name().capacity());
+    report.add("vertices", v->p_neighbors);
+    report.add("vertices", v->d_inter_graph_connections);
+    if (v->p_boundary_data == nullptr)
+      continue;
+    std::size_t bytes = sizeof(Vertex::BoundaryData);
+    if (v->is_vessel_tree_outflow()) {
+      const auto &data = v->get_vessel_tree_data();
+      bytes += (data.resistances.capacity() + data.capacitances.capacity() + data.radii.capacity()) * sizeof(double);
+    } else if (v->is_rcl_outflow()) {
+      const auto &data = v->get_rcl_data();
+      bytes += (data.resistances.capacity() + data.capacitances.capacity() + data.inductances.capacity()) * sizeof(double);
+    }
+    report.add("boundary data", bytes);
+  }
+
+  report.add("adjacency", d_adjacency_offsets);
+  report.add("adjacency", d_adjacency);
+  report.add("edge order", d_edge_order);
+  if (d_shared_segment != nullptr && d_shared_segment->is_writer())
+    report.add("node shared", d_shared_segment->size());
+
+  // only the keys and ids are counted, not the nodes of the containers
+  for (const auto *index : {&d_edge_name_index, &d_vertex_name_index})
+    for (const auto &it : *index)
+      report.add("name index", it.first.capacity() + it.second.size() * sizeof(std::size_t));
+
+  std::lock_guard<std::mutex> lock(d_cache_mutex);
+  std::size_t cache_bytes = 0;
+  for (const auto *cache : {&d_cache.active_edge_ids, &d_cache.active_vertex_ids, &d_cache.active_and_connected_vertex_ids})
+    for (const auto &it : *cache)
+      cache_bytes += it.second.capacity() * sizeof(std::size_t);
+  for (const auto &it : d_cache.ghost_edge_ids)
+    cache_bytes += it.second.capacity() * sizeof(std::size_t);
+  report.add("rank cache", cache_bytes);
+
+  return report;
+}
+
+bool GraphStorage::is_finalized() const {
+  return d_adjacency_offsets_data != nullptr;
+}
+
+void GraphStorage::build_adjacency() {
+  d_adjacency_offsets.assign(p_vertices.size() + 1, 0);
+  d_adjacency.clear();
+  for (std::size_t v_id = 0; v_id < p_vertices.size(); v_id += 1) {
+    for (auto e_id : p_vertices[v_id]->get_edge_neighbors())
+      d_adjacency.push_back({e_id, edge(e_id).is_pointing_to(v_id)});
+    d_adjacency_offsets[v_id + 1] = d_adjacency.size();
+  }
+  d_adjacency_offsets_data = d_adjacency_offsets.data();
+  d_adjacency_data = d_adjacency.data();
+}
+
+void GraphStorage::invalidate_adjacency() {
+  d_adjacency_offsets.clear();
+  d_adjacency.clear();
+  d_adjacency_offsets_data = nullptr;
+  d_adjacency_data = nullptr;
+}
+
+void GraphStorage::share_on_node(MPI_Comm comm) {
+  if (!is_finalized())
+    throw std::runtime_error("GraphStorage::share_on_node: the graph has to be finalized");
+  if (is_restricted())
+    throw std::runtime_error("GraphStorage::share_on_node: a graph restricted to a rank differs between the ranks of a node");
+
+  // the first rank of a node writes the data for all the ranks of the node, hence the layout has to agree on all of them
+  const std::size_t num_offsets = p_vertices.size() + 1;
+  const std::size_t num_adjacent_edges = d_adjacency_offsets_data[p_vertices.size()];
+  long sizes[6] = {static_cast<long>(p_edges.size()), static_cast<long>(num_offsets), static_cast<long>(num_adjacent_edges)};
+  for (std::size_t k = 0; k < 3; k += 1)
+    sizes[k + 3] = -sizes[k];
+  CHECK_MPI_SUCCESS(MPI_Allreduce(MPI_IN_PLACE, sizes, 6, MPI_LONG, MPI_MAX, comm));
+  for (std::size_t k = 0; k < 3; k += 1)
+    if (sizes[k] != -sizes[k + 3])
+      throw std::runtime_error("GraphStorage::share_on_node: the graph differs between the ranks");
+
+  const auto aligned = [](std::size_t bytes) {
+    const std::size_t alignment = alignof(std::max_align_t);
+    return (bytes + alignment - 1) / alignment * alignment;
+  };
+  const std::size_t offsets_start = aligned(p_edges.size() * sizeof(PhysicalData));
+  const std::size_t adjacency_start = offsets_start + aligned(num_offsets * sizeof(std::size_t));
+  auto segment = std::make_shared<SharedMemorySegment>(comm, adjacency_start + num_adjacent_edges * sizeof(AdjacentEdge));
+
+  auto *bytes = static_cast<char *>(segment->data());
+  auto *physical_data = reinterpret_cast<PhysicalData *>(bytes);
+  auto *offsets = reinterpret_cast<std::size_t *>(bytes + offsets_start);
+  auto *adjacency = reinterpret_cast<AdjacentEdge *>(bytes + adjacency_start);
+
+  segment->fence();
+  if (segment->is_writer()) {
+    for (std::size_t e_id = 0; e_id < p_edges.size(); e_id += 1)
+      if (p_edges[e_id] != nullptr && p_edges[e_id]->has_physical_data())
+        new (physical_data + e_id) PhysicalData(p_edges[e_id]->get_physical_data());
+    std::copy(d_adjacency_offsets_data, d_adjacency_offsets_data + num_offsets, offsets);
+    std::copy(d_adjacency_data, d_adjacency_data + num_adjacent_edges, adjacency);
+  }
+  segment->fence();
+
+  // the edges share the ownership of the segment, such that their physical data stays valid as long as they exist
+  for (std::size_t e_id = 0; e_id < p_edges.size(); e_id += 1)
+    if (p_edges[e_id] != nullptr && p_edges[e_id]->has_physical_data())
+      p_edges[e_id]->physical_data = std::shared_ptr<PhysicalData>(segment, physical_data + e_id);
+
+  std::vector<std::size_t>().swap(d_adjacency_offsets);
+  std::vector<AdjacentEdge>().swap(d_adjacency);
+  d_adjacency_offsets_data = offsets;
+  d_adjacency_data = adjacency;
+  d_shared_segment = std::move(segment);
+}
+
+
 std::shared_ptr<Vertex> GraphStorage::create_vertex() {
-  const auto id = p_next_vertex_id++;
+  const auto id = p_vertices.size();
   auto vertex = std::make_shared<Vertex>(id);
-  p_vertices[id] = vertex;
+  vertex->p_name_index = &d_vertex_name_index;
+  insert_into_name_index(d_vertex_name_index, vertex->get_name(), id);
+  p_vertices.push_back(vertex);
+  invalidate_adjacency();
+  d_edge_order.clear();
+  invalidate_graph_caches();
   return vertex;
 };
 
 std::shared_ptr<Edge> GraphStorage::connect(Vertex &v1, Vertex &v2, std::size_t num_micro_edges) {
-  return connect(v1, v2, p_next_edge_id++, num_micro_edges);
+  return connect(v1, v2, p_edges.size(), num_micro_edges);
 }
 
 std::shared_ptr<Edge> GraphStorage::connect(Vertex &v1, Vertex &v2, std::size_t edge_id, std::size_t num_local_micro_edges) {
-  if (p_vertices.find(v1.get_id()) == p_vertices.end() || p_vertices.find(v2.get_id()) == p_vertices.end())
+  if (v1.get_id() >= p_vertices.size() || v2.get_id() >= p_vertices.size())
     throw std::runtime_error("vertices not found in storage");
 
   if (v1.get_id() == v2.get_id())
     throw std::runtime_error("connecting same vertex");
 
-  if (p_edges.find(edge_id) != p_edges.end())
+  if (edge_id < p_edges.size() && p_edges[edge_id] != nullptr)
     throw std::runtime_error("edge with given id already in the graph");
 
   auto edge = std::make_shared<Edge>(edge_id, v1, v2, d_num_micro_edges, d_num_micro_vertices, num_local_micro_edges);
+  if (edge_id >= p_edges.size())
+    p_edges.resize(edge_id + 1);
   p_edges[edge_id] = edge;
+  d_num_edges += 1;
+  edge->p_name_index = &d_edge_name_index;
+  insert_into_name_index(d_edge_name_index, edge->get_name(), edge_id);
 
   v1.p_neighbors.push_back(edge->get_id());
   v2.p_neighbors.push_back(edge->get_id());
@@ -492,27 +748,217 @@ std::shared_ptr<Edge> GraphStorage::connect(Vertex &v1, Vertex &v2, std::size_t
   d_num_micro_edges += num_local_micro_edges;
   d_num_micro_vertices += num_local_micro_edges + 1;
 
+  invalidate_adjacency();
+  d_edge_order.clear();
+  invalidate_graph_caches();
+
   return edge;
 }
 
+std::size_t GraphStorage::create_in_bulk(std::size_t num_vertices, std::vector<EdgeDescription> edges) {
+  const std::size_t first_vertex_id = p_vertices.size();
+  const std::size_t first_edge_id = p_edges.size();
+
+  std::vector<std::size_t> num_neighbors(num_vertices, 0);
+  for (std::size_t k = 0; k < edges.size(); k += 1) {
+    const auto &description = edges[k];
+    if (description.left_vertex >= num_vertices || description.right_vertex >= num_vertices)
+      throw std::runtime_error("GraphStorage::create_in_bulk: edge " + std::to_string(k) + " refers to a vertex, which is not created");
+    if (description.left_vertex == description.right_vertex)
+      throw std::runtime_error("GraphStorage::create_in_bulk: edge " + std::to_string(k) + " connects the same vertex");
+    if (description.num_micro_edges == 0)
+      throw std::runtime_error("GraphStorage::create_in_bulk: edge " + std::to_string(k) + " has no micro edges");
+    num_neighbors[description.left_vertex] += 1;
+    num_neighbors[description.right_vertex] += 1;
+  }
+
+  // the new ids have the default name, hence they are appended to the same sorted set
+  p_vertices.reserve(first_vertex_id + num_vertices);
+  for (std::size_t k = 0; k < num_vertices; k += 1) {
+    auto vertex = std::make_shared<Vertex>(first_vertex_id + k);
+    vertex->p_name_index = &d_vertex_name_index;
+    vertex->p_neighbors.reserve(num_neighbors[k]);
+    auto &ids = d_vertex_name_index[vertex->get_name()];
+    ids.insert(ids.end(), vertex->get_id());
+    p_vertices.push_back(std::move(vertex));
+  }
+
+  p_edges.reserve(first_edge_id + edges.size());
+  for (std::size_t k = 0; k < edges.size(); k += 1) {
+    auto &description = edges[k];
+    auto &v1 = *p_vertices[first_vertex_id + description.left_vertex];
+    auto &v2 = *p_vertices[first_vertex_id + description.right_vertex];
+    auto edge = std::make_shared<Edge>(first_edge_id + k, v1, v2, d_num_micro_edges, d_num_micro_vertices, description.num_micro_edges);
+    edge->p_name_index = &d_edge_name_index;
+    auto &ids = d_edge_name_index[edge->get_name()];
+    ids.insert(ids.end(), edge->get_id());
+    edge->physical_data = std::make_unique<PhysicalData>(description.physical_data);
+    if (!description.embedding_data.points.empty())
+      edge->embedding_data = std::make_unique<EmbeddingData>(EmbeddingData{std::move(description.embedding_data.points)});
+    v1.p_neighbors.push_back(edge->get_id());
+    v2.p_neighbors.push_back(edge->get_id());
+    p_edges.push_back(std::move(edge));
+    d_num_micro_edges += description.num_micro_edges;
+    d_num_micro_vertices += description.num_micro_edges + 1;
+  }
+
+  d_num_edges += edges.size();
+
+  d_edge_order.clear();
+  build_adjacency();
+  invalidate_graph_caches();
+
+  return first_edge_id;
+}
+
 void GraphStorage::remove(Edge &e) {
-  p_edges.erase(p_edges.find(e.get_id()));
-  auto v0 = get_vertex(e.get_vertex_neighbors()[0]);
-  auto v1 = get_vertex(e.get_vertex_neighbors()[1]);
-  v0->p_neighbors.erase(std::remove(v0->p_neighbors.begin(), v0->p_neighbors.end(), e.get_id()), v0->p_neighbors.end());
-  v1->p_neighbors.erase(std::remove(v1->p_neighbors.begin(), v1->p_neighbors.end(), e.get_id()), v1->p_neighbors.end());
+  const auto edge_id = e.get_id();
+  // keep the edge alive until we are done, since the storage might hold the last reference
+  auto edge_ptr = get_edge(edge_id);
+  p_edges[edge_id] = nullptr;
+  d_num_edges -= 1;
+  erase_from_name_index(d_edge_name_index, e.get_name(), edge_id);
+  e.p_name_index = nullptr;
+  auto &v0 = vertex(e.get_vertex_neighbors()[0]);
+  auto &v1 = vertex(e.get_vertex_neighbors()[1]);
+  v0.p_neighbors.erase(std::remove(v0.p_neighbors.begin(), v0.p_neighbors.end(), edge_id), v0.p_neighbors.end());
+  v1.p_neighbors.erase(std::remove(v1.p_neighbors.begin(), v1.p_neighbors.end(), edge_id), v1.p_neighbors.end());
   e.p_neighbors.clear();
+  invalidate_adjacency();
+  d_edge_order.clear();
+  invalidate_graph_caches();
+}
+
+namespace {
+
+/*! @brief Returns the part of the polyline between the given fractions of its arc length. */
+std::vector<Point> get_polyline_segment(const std::vector<Point> &points, double begin, double end) {
+  std::vector<double> arc_length(points.size(), 0);
+  for (std::size_t k = 1; k < points.size(); k += 1)
+    arc_length[k] = arc_length[k - 1] + Point::distance(points[k - 1], points[k]);
+
+  const auto point_at = [&](double s) {
+    std::size_t k = 1;
+    while (k < points.size() - 1 && arc_length[k] < s)
+      k += 1;
+    const double segment_length = arc_length[k] - arc_length[k - 1];
+    const double theta = segment_length > 0 ? (s - arc_length[k - 1]) / segment_length : 0;
+    return convex_combination(points[k - 1], points[k], std::max(0., std::min(1., theta)));
+  };
+
+  const double s_begin = begin * arc_length.back();
+  const double s_end = end * arc_length.back();
+
+  std::vector<Point> segment{point_at(s_begin)};
+  for (std::size_t k = 1; k < points.size() - 1; k += 1)
+    if (arc_length[k] > s_begin && arc_length[k] < s_end)
+      segment.push_back(points[k]);
+  segment.push_back(point_at(s_end));
+  return segment;
+}
+
+} // namespace
+
+std::vector<std::size_t> GraphStorage::split_edge(Edge &edge, std::size_t num_parts) {
+  const std::size_t num_micro_edges = edge.num_micro_edges();
+  if (num_parts < 1 || num_parts > num_micro_edges)
+    throw std::runtime_error("GraphStorage::split_edge: cannot split an edge with " + std::to_string(num_micro_edges) + " micro edges into " + std::to_string(num_parts) + " parts");
+
+  if (num_parts == 1)
+    return {edge.get_id()};
+
+  auto &v_first = vertex(edge.get_vertex_neighbors()[0]);
+  auto &v_last = vertex(edge.get_vertex_neighbors()[1]);
+  if (v_first.bc_finalized() || v_last.bc_finalized())
+    throw std::runtime_error("GraphStorage::split_edge: edges have to be split before the boundary conditions are finalized");
+
+  // keep the edge alive, since we still need its data after removing it from the storage
+  auto old_edge = get_edge(edge.get_id());
+  const auto old_position_first = std::find(v_first.p_neighbors.begin(), v_first.p_neighbors.end(), edge.get_id()) - v_first.p_neighbors.begin();
+  const auto old_position_last = std::find(v_last.p_neighbors.begin(), v_last.p_neighbors.end(), edge.get_id()) - v_last.p_neighbors.begin();
+  remove(edge);
+
+  std::vector<std::size_t> part_ids;
+  std::size_t first_micro_edge = 0;
+  Vertex *v_left = &v_first;
+  for (std::size_t part = 0; part < num_parts; part += 1) {
+    const std::size_t last_micro_edge = ((part + 1) * num_micro_edges) / num_parts;
+    const std::size_t num_local_micro_edges = last_micro_edge - first_micro_edge;
+
+    Vertex *v_right = &v_last;
+    if (part + 1 < num_parts) {
+      v_right = create_vertex().get();
+      v_right->d_is_continuity_vertex = true;
+    }
+
+    const std::size_t part_id = (part == 0) ? old_edge->get_id() : p_edges.size();
+    auto &part_edge = *connect(*v_left, *v_right, part_id, num_local_micro_edges);
+    part_ids.push_back(part_id);
+
+    part_edge.set_name(part == 0 ? old_edge->get_name() : old_edge->get_name() + "_" + std::to_string(part));
+    part_edge.d_rank = old_edge->d_rank;
+
+    const double begin = static_cast<double>(first_micro_edge) / num_micro_edges;
+    const double end = static_cast<double>(last_micro_edge) / num_micro_edges;
+
+    if (old_edge->has_physical_data()) {
+      auto data = old_edge->get_physical_data();
+      data.length *= end - begin;
+      part_edge.add_physical_data(data);
+    }
+
+    if (old_edge->has_discretization_data()) {
+      const auto &lengths = old_edge->get_discretization_data().lengths;
+      part_edge.add_discretization_data({std::vector<double>(lengths.begin() + first_micro_edge, lengths.begin() + last_micro_edge)});
+    }
+
+    if (old_edge->has_embedding_data() && old_edge->get_embedding_data().points.size() >= 2)
+      part_edge.add_embedding_data({get_polyline_segment(old_edge->get_embedding_data().points, begin, end)});
+
+    first_micro_edge = last_micro_edge;
+    v_left = v_right;
+  }
+
+  // the outer vertices keep their order of neighbors
+  std::rotate(v_first.p_neighbors.begin() + old_position_first, v_first.p_neighbors.end() - 1, v_first.p_neighbors.end());
+  std::rotate(v_last.p_neighbors.begin() + old_position_last, v_last.p_neighbors.end() - 1, v_last.p_neighbors.end());
+
+  return part_ids;
+}
+
+void GraphStorage::set_micro_edge_lengths(Edge &edge, const std::vector<double> &lengths) {
+  if (lengths.empty())
+    throw std::runtime_error("GraphStorage::set_micro_edge_lengths: an edge needs at least one micro edge");
+
+  const double length = std::accumulate(lengths.begin(), lengths.end(), 0.);
+  if (edge.has_physical_data() && std::abs(length - edge.get_physical_data().length) > 1e-8 * edge.get_physical_data().length)
+    throw std::runtime_error("GraphStorage::set_micro_edge_lengths: the micro edges of " + edge.get_name() + " do not add up to its length");
+
+  // the new micro primitives get fresh global ids
+  edge.create_micro_primitives(d_num_micro_edges, d_num_micro_vertices, lengths.size());
+  d_num_micro_edges += lengths.size();
+  d_num_micro_vertices += lengths.size() + 1;
+
+  edge.add_discretization_data({lengths});
+
+  invalidate_graph_caches();
 }
 
 std::vector<std::size_t> GraphStorage::get_edge_ids() const {
   std::vector<std::size_t> keys;
-  transform(p_edges.begin(), p_edges.end(), back_inserter(keys), [](auto v) { return v.first; });
+  keys.reserve(d_num_edges);
+  for (const auto &edge : p_edges)
+    if (edge != nullptr)
+      keys.push_back(edge->get_id());
   return keys;
 }
 
 std::vector<std::size_t> GraphStorage::get_vertex_ids() const {
   std::vector<std::size_t> keys;
-  transform(p_vertices.begin(), p_vertices.end(), back_inserter(keys), [](auto v) { return v.first; });
+  keys.reserve(p_vertices.size());
+  for (std::size_t v_id = 0; v_id < p_vertices.size(); v_id += 1)
+    if (p_vertices[v_id] != nullptr)
+      keys.push_back(v_id);
   return keys;
 }
 
@@ -521,47 +967,117 @@ size_t GraphStorage::num_vertices() const {
 }
 
 size_t GraphStorage::num_edges() const {
-  return p_edges.size();
+  return d_num_edges;
 }
 
-std::vector<std::size_t> GraphStorage::get_active_edge_ids(int rank) const {
-  std::vector<std::size_t> active_edge_ids;
-  for (const auto &it : p_edges) {
-    auto edge = it.second;
-
-    if (edge->rank() == rank)
-      active_edge_ids.push_back(edge->get_id());
+void GraphStorage::update_cache_revision() const {
+  const std::size_t revision = graph_revision;
+  if (d_cache.revision != revision) {
+    d_cache = RankCache();
+    d_cache.revision = revision;
   }
-  return active_edge_ids;
 }
 
-std::vector<std::size_t> GraphStorage::get_active_vertex_ids(int rank) const {
-  std::vector<std::size_t> active_vertex_ids;
-  for (const auto &v_it : p_vertices) {
-    auto vertex = v_it.second;
+template<typename Key, typename Function>
+const std::vector<std::size_t> &GraphStorage::get_cached(std::map<Key, std::vector<std::size_t>> RankCache::*cache, const Key &key, Function calculate) const {
+  std::lock_guard<std::mutex> lock(d_cache_mutex);
+  update_cache_revision();
+
+  auto &entries = d_cache.*cache;
+  auto it = entries.find(key);
+  if (it == entries.end())
+    it = entries.emplace(key, calculate()).first;
+  return it->second;
+}
 
-    if (vertex_is_neighbor_of_rank(*vertex, rank))
-      active_vertex_ids.push_back(vertex->get_id());
+void GraphStorage::set_edge_order(std::vector<std::size_t> edge_order) {
+  if (is_restricted())
+    throw std::runtime_error("GraphStorage::set_edge_order: the order has to be set before the graph is restricted to a rank");
+
+  std::vector<char> found(p_edges.size(), false);
+  for (auto e_id : edge_order) {
+    if (e_id >= p_edges.size() || p_edges[e_id] == nullptr || found[e_id])
+      throw std::runtime_error("GraphStorage::set_edge_order: the order has to contain every edge exactly once");
+    found[e_id] = true;
   }
-  return active_vertex_ids;
+  if (edge_order.size() != d_num_edges)
+    throw std::runtime_error("GraphStorage::set_edge_order: the order has to contain every edge exactly once");
+
+  d_edge_order = std::move(edge_order);
+  invalidate_graph_caches();
 }
 
-std::vector<std::size_t> GraphStorage::get_active_and_connected_vertex_ids(int rank) const {
-  std::vector<std::size_t> active_vertex_ids;
-  for (const auto &v_it : p_vertices) {
-    auto vertex = v_it.second;
+std::vector<std::size_t> GraphStorage::get_edge_order() const {
+  return d_edge_order.empty() ? get_edge_ids() : d_edge_order;
+}
+
+std::vector<std::size_t> GraphStorage::get_vertex_order() const {
+  if (d_edge_order.empty())
+    return get_vertex_ids();
 
-    if (vertex_is_neighbor_of_rank(*vertex, rank) || vertex_is_connected_to_rank(*vertex, rank))
-      active_vertex_ids.push_back(vertex->get_id());
+  // the vertices follow the edges in the order of their first appearance
+  std::vector<char> found(p_vertices.size(), false);
+  std::vector<std::size_t> vertex_order;
+  vertex_order.reserve(p_vertices.size());
+  for (auto e_id : d_edge_order) {
+    for (auto v_id : edge(e_id).get_vertex_neighbors()) {
+      if (!found[v_id]) {
+        found[v_id] = true;
+        vertex_order.push_back(v_id);
+      }
+    }
   }
-  return active_vertex_ids;
+  // isolated vertices are appended
+  for (std::size_t v_id = 0; v_id < p_vertices.size(); v_id += 1)
+    if (!found[v_id] && p_vertices[v_id] != nullptr)
+      vertex_order.push_back(v_id);
+  return vertex_order;
+}
+
+void GraphStorage::check_available_for_rank(bool available, const std::string &function) const {
+  if (is_restricted() && !available)
+    throw std::runtime_error("GraphStorage::" + function + ": the graph was restricted to rank " + std::to_string(d_restricted_rank) + ", hence the lists of other ranks are not available");
+}
+
+const std::vector<std::size_t> &GraphStorage::get_active_edge_ids(int rank) const {
+  check_available_for_rank(rank == d_restricted_rank, "get_active_edge_ids");
+  return get_cached(&RankCache::active_edge_ids, rank, [this, rank]() {
+    std::vector<std::size_t> active_edge_ids;
+    for (auto e_id : get_edge_order()) {
+      if (edge(e_id).rank() == rank)
+        active_edge_ids.push_back(e_id);
+    }
+    return active_edge_ids;
+  });
+}
+
+const std::vector<std::size_t> &GraphStorage::get_active_vertex_ids(int rank) const {
+  check_available_for_rank(rank == d_restricted_rank, "get_active_vertex_ids");
+  return get_cached(&RankCache::active_vertex_ids, rank, [this, rank]() {
+    std::vector<std::size_t> active_vertex_ids;
+    for (auto v_id : get_vertex_order()) {
+      if (vertex_is_neighbor_of_rank(vertex(v_id), rank))
+        active_vertex_ids.push_back(v_id);
+    }
+    return active_vertex_ids;
+  });
+}
+
+const std::vector<std::size_t> &GraphStorage::get_active_and_connected_vertex_ids(int rank) const {
+  check_available_for_rank(rank == d_restricted_rank, "get_active_and_connected_vertex_ids");
+  return get_cached(&RankCache::active_and_connected_vertex_ids, rank, [this, rank]() {
+    std::vector<std::size_t> active_vertex_ids;
+    for (auto v_id : get_vertex_order()) {
+      if (vertex_is_neighbor_of_rank(vertex(v_id), rank) || vertex_is_connected_to_rank(vertex(v_id), rank))
+        active_vertex_ids.push_back(v_id);
+    }
+    return active_vertex_ids;
+  });
 }
 
 bool GraphStorage::edge_is_neighbor_of_rank(const Edge &e, int rank) const {
   for (auto v_id : e.get_vertex_neighbors()) {
-    auto vertex = get_vertex(v_id);
-
-    if (vertex_is_neighbor_of_rank(*vertex, rank))
+    if (vertex_is_neighbor_of_rank(vertex(v_id), rank))
       return true;
   }
   return false;
@@ -580,9 +1096,7 @@ bool GraphStorage::vertex_is_connected_to_rank(const Vertex &vertex, int rank) c
 
 bool GraphStorage::edge_is_connected_to_rank(const Edge &e, int rank) const {
   for (auto v_id : e.get_vertex_neighbors()) {
-    auto vertex = get_vertex(v_id);
-
-    if (vertex_is_connected_to_rank(*vertex, rank))
+    if (vertex_is_connected_to_rank(vertex(v_id), rank))
       return true;
   }
   return false;
@@ -590,85 +1104,230 @@ bool GraphStorage::edge_is_connected_to_rank(const Edge &e, int rank) const {
 
 bool GraphStorage::vertex_is_neighbor_of_rank(const Vertex &v, int rank) const {
   for (const auto &e_id : v.get_edge_neighbors()) {
-    auto neighbor_edge = get_edge(e_id);
-    if (neighbor_edge->rank() == rank)
+    // edges released by restrict_to_rank are neither assigned to nor adjacent to the restricted rank
+    if (p_edges[e_id] != nullptr && p_edges[e_id]->rank() == rank)
       return true;
   }
   return false;
 }
 
-std::vector<std::size_t> GraphStorage::get_ghost_edge_ids(int main_rank, int ghost_rank) const {
-  std::vector<std::size_t> ghost_edge_ids;
-  for (const auto &it : p_edges) {
-    auto ghost_rank_edge = it.second;
+const std::vector<std::size_t> &GraphStorage::get_ghost_edge_ids(int main_rank, int ghost_rank) const {
+  check_available_for_rank(main_rank == d_restricted_rank || ghost_rank == d_restricted_rank, "get_ghost_edge_ids");
+  return get_cached(&RankCache::ghost_edge_ids, std::make_pair(main_rank, ghost_rank), [this, main_rank, ghost_rank]() {
+    std::vector<std::size_t> ghost_edge_ids;
+    for (auto e_id : get_edge_order()) {
+      const auto &ghost_rank_edge = edge(e_id);
+      // if the edge does not belong to the ghost rank we skip it
+      if (ghost_rank_edge.rank() != ghost_rank)
+        continue;
 
-    // if the edge does not belong to the ghost rank we skip it
-    if (ghost_rank_edge->rank() != ghost_rank)
-      continue;
-
-    if (edge_is_neighbor_of_rank(*ghost_rank_edge, main_rank) || edge_is_connected_to_rank(*ghost_rank_edge, main_rank))
-      ghost_edge_ids.push_back(ghost_rank_edge->get_id());
+      if (edge_is_neighbor_of_rank(ghost_rank_edge, main_rank) || edge_is_connected_to_rank(ghost_rank_edge, main_rank))
+        ghost_edge_ids.push_back(e_id);
+    }
+    return ghost_edge_ids;
+  });
+}
+
+std::vector<int> GraphStorage::get_neighbor_ranks(int rank) const {
+  check_available_for_rank(rank == d_restricted_rank, "get_neighbor_ranks");
+  std::set<int> neighbor_ranks;
+  const auto add_edge_ranks = [&neighbor_ranks](const GraphStorage &graph, const Vertex &v) {
+    for (auto e_id : v.get_edge_neighbors())
+      if (graph.p_edges[e_id] != nullptr)
+        neighbor_ranks.insert(graph.p_edges[e_id]->rank());
+  };
+  // the ghost layers only contain edges at the vertices of the rank, or at vertices connected to them
+  for (auto v_id : get_active_and_connected_vertex_ids(rank)) {
+    const auto &v = vertex(v_id);
+    add_edge_ranks(*this, v);
+    for (auto &con : v.get_inter_graph_connections())
+      add_edge_ranks(con.get_graph(), con.get_vertex());
   }
-  return ghost_edge_ids;
+  neighbor_ranks.erase(rank);
+  return {neighbor_ranks.begin(), neighbor_ranks.end()};
 }
 
 void GraphStorage::assign_edge_to_rank(Edge &edge, int rank) {
+  if (is_restricted())
+    throw std::runtime_error("GraphStorage::assign_edge_to_rank: a graph restricted to a rank cannot be repartitioned");
   edge.assign_to_rank(rank);
+  invalidate_graph_caches();
+}
+
+std::shared_ptr<const PointKDTree> GraphStorage::get_spatial_index(bool vertices) const {
+  std::lock_guard<std::mutex> lock(d_cache_mutex);
+  update_cache_revision();
+
+  if (d_cache.vertex_points == nullptr) {
+    std::vector<Point> vertex_points, edge_points;
+    std::vector<std::size_t> vertex_ids, edge_ids;
+    for (const auto &edge : p_edges) {
+      if (edge == nullptr || !edge->has_embedding_data())
+        continue;
+      const auto &points = edge->get_embedding_data().points;
+      for (const auto &point : points) {
+        edge_points.push_back(point);
+        edge_ids.push_back(edge->get_id());
+      }
+      // the first and last point of a polyline are the coordinates of its vertices
+      if (points.size() >= 2) {
+        vertex_points.push_back(points.front());
+        vertex_ids.push_back(edge->get_vertex_neighbors()[0]);
+        vertex_points.push_back(points.back());
+        vertex_ids.push_back(edge->get_vertex_neighbors()[1]);
+      }
+    }
+    d_cache.vertex_points = std::make_shared<const PointKDTree>(vertex_points, vertex_ids);
+    d_cache.edge_points = std::make_shared<const PointKDTree>(edge_points, edge_ids);
+  }
+
+  return vertices ? d_cache.vertex_points : d_cache.edge_points;
 }
 
+namespace {
+
+/*! @brief Sorts the ids and removes the duplicates. */
+void make_unique_ids(std::vector<std::size_t> &ids) {
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+}
+
+} // namespace
+
 std::vector<std::shared_ptr<Vertex>> GraphStorage::find_embedded_vertices(const Point &p) const {
-  std::vector<std::shared_ptr<Vertex>> found_vertices;
+  const double tolerance = 1e-12;
 
-  for (const auto &it : p_vertices) {
-    const auto vertex = it.second;
+  // the euclidean norm is bounded by the l1 norm, hence the candidates contain all the vertices we search
+  std::vector<std::size_t> candidates;
+  get_spatial_index(true)->find_within_radius(p, tolerance, candidates);
+  make_unique_ids(candidates);
 
+  std::vector<std::shared_ptr<Vertex>> found_vertices;
+  for (auto v_id : candidates) {
+    const auto &v = vertex(v_id);
     bool has_coordinates = false;
-    for (const auto e_id : vertex->get_edge_neighbors()) {
-      const auto edge = get_edge(e_id);
-      if (edge->has_embedding_data() && edge->get_embedding_data().points.size() >= 2) {
-        const auto &points = edge->get_embedding_data().points;
-        const auto p_edge = edge->is_pointing_to(vertex->get_id()) ? points.back() : points.front();
+    for (const auto e_id : v.get_edge_neighbors()) {
+      const auto &e = edge(e_id);
+      if (e.has_embedding_data() && e.get_embedding_data().points.size() >= 2) {
+        const auto &points = e.get_embedding_data().points;
+        const auto p_edge = e.is_pointing_to(v_id) ? points.back() : points.front();
         const double norm = std::abs(p_edge.x - p.x) + std::abs(p_edge.y - p.y) + std::abs(p_edge.z - p.z);
-        if (norm < 1e-12)
+        if (norm < tolerance)
           has_coordinates = true;
       }
     }
 
     if (has_coordinates)
-      found_vertices.push_back(vertex);
+      found_vertices.push_back(p_vertices[v_id]);
   }
 
   return found_vertices;
 }
 
+std::vector<std::shared_ptr<Vertex>> GraphStorage::find_embedded_vertices(const Point &p, double radius) const {
+  std::vector<std::size_t> ids;
+  get_spatial_index(true)->find_within_radius(p, radius, ids);
+  make_unique_ids(ids);
+
+  std::vector<std::shared_ptr<Vertex>> found_vertices;
+  for (auto v_id : ids)
+    found_vertices.push_back(p_vertices[v_id]);
+  return found_vertices;
+}
+
+std::shared_ptr<Vertex> GraphStorage::find_nearest_embedded_vertex(const Point &p) const {
+  std::size_t v_id;
+  double distance;
+  if (!get_spatial_index(true)->find_nearest(p, v_id, distance))
+    return nullptr;
+  return p_vertices[v_id];
+}
+
+std::vector<std::size_t> GraphStorage::find_embedded_edges(const Point &p, double radius) const {
+  std::vector<std::size_t> ids;
+  get_spatial_index(false)->find_within_radius(p, radius, ids);
+  make_unique_ids(ids);
+  return ids;
+}
+
 std::shared_ptr<Edge> GraphStorage::find_edge_by_name(const std::string &name) {
-  auto pos = std::find_if(p_edges.begin(), p_edges.end(), [&](auto e) { return e.second->get_name() == name; });
+  const auto *id = find_in_name_index(d_edge_name_index, name);
 
-  if (pos == p_edges.end())
+  if (id == nullptr)
     throw std::runtime_error("edge " + name + " not found in graph storage.");
 
-  return pos->second;
+  return p_edges[*id];
 }
 
 bool GraphStorage::has_named_vertex(const std::string &name) const {
-  auto pos = std::find_if(p_vertices.begin(), p_vertices.end(), [&](auto v) { return v.second->get_name() == name; });
-  return pos != p_vertices.end();
+  return find_in_name_index(d_vertex_name_index, name) != nullptr;
 }
 
 std::shared_ptr<Vertex> GraphStorage::find_vertex_by_name(const std::string &name) {
-  auto pos = std::find_if(p_vertices.begin(), p_vertices.end(), [&](auto v) { return v.second->get_name() == name; });
+  const auto *id = find_in_name_index(d_vertex_name_index, name);
 
-  if (pos == p_vertices.end())
+  if (id == nullptr)
     throw std::runtime_error("vertex " + name + " not found in graph storage.");
 
-  return pos->second;
+  return p_vertices[*id];
 }
 
 void GraphStorage::finalize_bcs() {
-  for (auto it : p_vertices) {
-    auto &vertex = *it.second;
-    vertex.finalize_bcs();
+  SCOPED_SETUP_TIMER("finalize bcs");
+  if (is_restricted())
+    throw std::runtime_error("GraphStorage::finalize_bcs: the boundary conditions have to be finalized before the graph is restricted to a rank");
+  for (auto &vertex : p_vertices)
+    vertex->finalize_bcs();
+  build_adjacency();
+}
+
+void GraphStorage::restrict_to_rank(int rank) {
+  if (!is_finalized())
+    throw std::runtime_error("GraphStorage::restrict_to_rank: the graph has to be finalized before");
+  if (is_restricted())
+    throw std::runtime_error("GraphStorage::restrict_to_rank: the graph was already restricted");
+  for (const auto &v : p_vertices)
+    if (!v->get_inter_graph_connections().empty())
+      throw std::runtime_error("GraphStorage::restrict_to_rank: graphs connected to other graphs cannot be restricted");
+
+  // the owned edges and their ghost layers w.r.t. all the ranks owning an adjacent edge
+  std::vector<char> keep_edge(p_edges.size(), false);
+  for (auto e_id : get_active_edge_ids(rank))
+    keep_edge[e_id] = true;
+  for (auto other_rank : get_neighbor_ranks(rank))
+    for (auto e_id : get_ghost_edge_ids(rank, other_rank))
+      keep_edge[e_id] = true;
+
+  std::vector<char> keep_vertex(p_vertices.size(), false);
+  for (std::size_t e_id = 0; e_id < p_edges.size(); e_id += 1)
+    if (keep_edge[e_id])
+      for (auto v_id : p_edges[e_id]->get_vertex_neighbors())
+        keep_vertex[v_id] = true;
+
+  // the neighbor lists and the adjacency keep the global topology, such that the kept vertices do not change
+  for (std::size_t e_id = 0; e_id < p_edges.size(); e_id += 1) {
+    if (p_edges[e_id] == nullptr || keep_edge[e_id])
+      continue;
+    erase_from_name_index(d_edge_name_index, p_edges[e_id]->get_name(), e_id);
+    p_edges[e_id]->p_name_index = nullptr;
+    p_edges[e_id] = nullptr;
+  }
+  for (std::size_t v_id = 0; v_id < p_vertices.size(); v_id += 1) {
+    if (keep_vertex[v_id])
+      continue;
+    erase_from_name_index(d_vertex_name_index, p_vertices[v_id]->get_name(), v_id);
+    p_vertices[v_id]->p_name_index = nullptr;
+    p_vertices[v_id] = nullptr;
   }
+
+  d_edge_order.erase(std::remove_if(d_edge_order.begin(), d_edge_order.end(), [&](std::size_t e_id) { return !keep_edge[e_id]; }), d_edge_order.end());
+  d_edge_order.shrink_to_fit();
+  d_restricted_rank = rank;
+  invalidate_graph_caches();
+}
+
+bool GraphStorage::is_restricted() const {
+  return d_restricted_rank >= 0;
 }
 
 bool GraphStorage::owns_primitive(const Vertex &vertex, size_t rank) const {
@@ -682,8 +1341,15 @@ std::vector<double> get_normals(const GraphStorage &graph, const Vertex &v) {
 }
 
 void get_normals(const GraphStorage &graph, const Vertex &v, std::vector<double> &sigma) {
+  if (graph.is_finalized()) {
+    const auto adjacent_edges = graph.adjacent_edges(v.get_id());
+    for (size_t k = 0; k < adjacent_edges.size(); k += 1)
+      sigma[k] = adjacent_edges[k].pointing_to ? +1. : -1.;
+    return;
+  }
+
   for (size_t k = 0; k < v.get_edge_neighbors().size(); k += 1) {
-    auto &e = *graph.get_edge(v.get_edge_neighbors()[k]);
+    auto &e = graph.edge(v.get_edge_neighbors()[k]);
     sigma[k] = e.is_pointing_to(v.get_id()) ? +1. : -1.;
   }
 }
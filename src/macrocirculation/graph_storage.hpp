@@ -13,15 +13,25 @@
 #include <functional>
 #include <map>
 #include <memory>
+#include <mpi.h>
+#include <mutex>
+#include <set>
+#include <type_traits>
+#include <unordered_map>
 #include <utility>
+#include <variant>
 #include <vector>
 #include <string>
 
+#include "memory_report.hpp"
+
 namespace macrocirculation {
 
 class GraphStorage;
 class Edge;
+class SharedMemorySegment;
 class Vertex;
+class PointKDTree;
 class MicroEdge;
 class MicroVertex;
 
@@ -144,6 +154,7 @@ private:
   size_t d_vertex_id;
 };
 
+/*! @brief A micro edge of an edge, which is computed from its index, since the micro edges of an edge are numbered consecutively. */
 class MicroEdge {
 public:
   MicroEdge(std::size_t local_id, std::size_t global_id)
@@ -151,58 +162,114 @@ public:
         d_global_id(global_id) {}
 
   std::size_t get_local_id() const { return d_local_id; }
-  std::size_t get_global_id() const { return d_local_id; }
+  std::size_t get_global_id() const { return d_global_id; }
 
 private:
   std::size_t d_local_id;
   std::size_t d_global_id;
 };
 
+/*! @brief A micro vertex of an edge, whose neighbors are computed from its index.
+ *         The micro vertex k lies between the micro edges k-1 and k, hence only the inner micro vertices have both neighbors.
+ */
 class MicroVertex {
 public:
-  MicroVertex(std::size_t local_id, std::size_t global_id)
+  MicroVertex(std::size_t local_id, std::size_t first_micro_edge_id, std::size_t first_micro_vertex_id, std::size_t num_micro_edges)
       : d_local_id(local_id),
-        d_global_id(global_id),
-        d_left_edge(nullptr),
-        d_right_edge(nullptr),
-        d_left_vertex(nullptr),
-        d_right_vertex(nullptr) {}
+        d_first_micro_edge_id(first_micro_edge_id),
+        d_first_micro_vertex_id(first_micro_vertex_id),
+        d_num_micro_edges(num_micro_edges) {}
 
   std::size_t get_local_id() const { return d_local_id; }
-  std::size_t get_global_id() const { return d_local_id; }
+  std::size_t get_global_id() const { return d_first_micro_vertex_id + d_local_id; }
 
-  MicroEdge *get_left_edge() const {
-    assert(d_left_edge != nullptr);
-    return d_left_edge;
+  MicroEdge get_left_edge() const {
+    assert(d_local_id > 0);
+    return {d_local_id - 1, d_first_micro_edge_id + d_local_id - 1};
   }
 
-  MicroEdge *get_right_edge() const {
-    assert(d_right_edge != nullptr);
-    return d_right_edge;
+  MicroEdge get_right_edge() const {
+    assert(d_local_id < d_num_micro_edges);
+    return {d_local_id, d_first_micro_edge_id + d_local_id};
   }
 
-  MicroVertex *get_left_vertex() const {
-    assert(d_left_vertex != nullptr);
-    return d_left_vertex;
+  MicroVertex get_left_vertex() const {
+    assert(d_local_id > 0);
+    return {d_local_id - 1, d_first_micro_edge_id, d_first_micro_vertex_id, d_num_micro_edges};
   }
-  MicroVertex *get_right_vertex() const {
-    assert(d_right_vertex != nullptr);
-    return d_right_vertex;
+
+  MicroVertex get_right_vertex() const {
+    assert(d_local_id < d_num_micro_edges);
+    return {d_local_id + 1, d_first_micro_edge_id, d_first_micro_vertex_id, d_num_micro_edges};
   }
 
-protected:
+private:
   std::size_t d_local_id;
-  std::size_t d_global_id;
+  std::size_t d_first_micro_edge_id;
+  std::size_t d_first_micro_vertex_id;
+  std::size_t d_num_micro_edges;
+};
+
+/*! @brief The consecutive micro edges or micro vertices of an edge with the local ids [first, last), which are created on access. */
+template<typename MicroPrimitive>
+class MicroPrimitiveRange {
+public:
+  class Iterator {
+  public:
+    Iterator(const MicroPrimitiveRange &range, std::size_t local_id)
+        : d_range(&range),
+          d_local_id(local_id) {}
+
+    MicroPrimitive operator*() const { return d_range->create(d_local_id); }
+    Iterator &operator++() {
+      d_local_id += 1;
+      return *this;
+    }
+    bool operator==(const Iterator &other) const { return d_local_id == other.d_local_id; }
+    bool operator!=(const Iterator &other) const { return d_local_id != other.d_local_id; }
+
+  private:
+    const MicroPrimitiveRange *d_range;
+    std::size_t d_local_id;
+  };
+
+  MicroPrimitiveRange(std::size_t first, std::size_t last, std::size_t first_micro_edge_id, std::size_t first_micro_vertex_id, std::size_t num_micro_edges)
+      : d_first(first),
+        d_last(last),
+        d_first_micro_edge_id(first_micro_edge_id),
+        d_first_micro_vertex_id(first_micro_vertex_id),
+        d_num_micro_edges(num_micro_edges) {}
 
-  MicroEdge *d_left_edge;
-  MicroEdge *d_right_edge;
+  Iterator begin() const { return {*this, d_first}; }
+  Iterator end() const { return {*this, d_last}; }
 
-  MicroVertex *d_left_vertex;
-  MicroVertex *d_right_vertex;
+  std::size_t size() const { return d_last - d_first; }
+  bool empty() const { return d_first == d_last; }
 
-  friend Edge;
+  MicroPrimitive operator[](std::size_t k) const { return create(d_first + k); }
+  MicroPrimitive front() const { return create(d_first); }
+  MicroPrimitive back() const { return create(d_last - 1); }
+
+private:
+  std::size_t d_first;
+  std::size_t d_last;
+  std::size_t d_first_micro_edge_id;
+  std::size_t d_first_micro_vertex_id;
+  std::size_t d_num_micro_edges;
+
+  MicroPrimitive create(std::size_t local_id) const {
+    if constexpr (std::is_same<MicroPrimitive, MicroEdge>::value)
+      return {local_id, d_first_micro_edge_id + local_id};
+    else
+      return {local_id, d_first_micro_edge_id, d_first_micro_vertex_id, d_num_micro_edges};
+  }
 };
 
+/*! @brief Maps the names of the primitives in a graph storage to their ids. Names do not have to be unique.
+ *         The ids are sorted, such that even a name shared by many primitives, like the default empty one, is cheap to update.
+ */
+using NameIndex = std::unordered_map<std::string, std::set<std::size_t>>;
+
 class Primitive {
 public:
   explicit Primitive(std::size_t id);
@@ -210,12 +277,19 @@ public:
   std::size_t get_id() const;
 
   const std::string &get_name() const;
+
+  /*! @brief Renames the primitive and updates the name index of its graph storage. */
   void set_name(const std::string &name);
 
 protected:
   std::size_t p_id;
 
   std::string p_name;
+
+  /*! @brief The name index of the graph storage owning the primitive, or null. */
+  NameIndex *p_name_index;
+
+  friend GraphStorage;
 };
 
 // TODO: add securicty assertion to Vertex for a flow type
@@ -245,12 +319,21 @@ public:
 
   bool is_bifurcation() const;
 
+  /*! @brief Was the vertex created by splitting an edge? Its two edges then share their physical data and only join the parts of one vessel. */
+  bool is_continuity_vertex() const;
+
   /*! @brief Returns true if the boundary conditions on this vertex have been finalized and are not allowed to change anymore. */
   bool bc_finalized() const;
 
   /*! @brief Finalizes the boundary conditions on this vertex. After this, they cannot be changed anymore! */
   void finalize_bcs();
 
+  /*! @brief Allows to change the finalized boundary conditions again, e.g. to replace a windkessel by a vessel tree during a calibration.
+   *         The solvers have to update their dofs after the boundary conditions were finalized again,
+   *         see ExplicitNonlinearFlowSolver::update_boundary_conditions.
+   */
+  void unfinalize_bcs();
+
   /*! @brief Marks the given vertex as part of the inflow boundary, where the given time dependent function provides the boundary values. */
   void set_to_inflow_with_fixed_flow(std::function<double(double)> inflow_value);
 
@@ -276,6 +359,14 @@ public:
    */
   void update_vessel_tip_pressures(double p);
 
+  /*! @brief Changes the resistance and capacitance of a windkessel outflow in place, which is also allowed after the boundary conditions were finalized,
+   *         since the dofs do not change. The solvers have to update their cached 0D parameters afterwards.
+   */
+  void update_windkessel_parameters(double r, double c);
+
+  /*! @brief Changes the resistances and capacitances of a vessel tree outflow in place, where the number of compartments has to stay the same. */
+  void update_vessel_tree_parameters(const std::vector<double> &resistances, const std::vector<double> &capacitances);
+
   void set_to_nonlinear_characteristic_inflow(double G0, double A0, double rh0, bool points_towards_vertex, double p, double q);
 
   void update_nonlinear_characteristic_inflow(double p, double q);
@@ -319,19 +410,22 @@ public:
   static void connect(const std::shared_ptr<GraphStorage> &g1, Vertex &v1, const std::shared_ptr<GraphStorage> &g2, Vertex &v2);
 
 private:
-  std::function<double(double)> p_inflow_value;
-
-  FlowType p_flow_type;
-
-  PeripheralVesselData p_peripheral_vessel_data;
+  /*! @brief The parameters of the boundary condition, i.e. the inflow function or the data of the 0D model. */
+  using BoundaryData = std::variant<std::function<double(double)>, PeripheralVesselData, VesselTreeData, LinearCharacteristicData, NonlinearCharacteristicData, RCLModel>;
 
-  VesselTreeData p_vessel_tree_data;
+  /*! @brief Returns the boundary data of the given type, or throws if the vertex has a different boundary condition. */
+  template<typename Data>
+  const Data &get_boundary_data() const;
 
-  LinearCharacteristicData p_linear_characteristic_data;
+  template<typename Data>
+  Data &get_boundary_data();
 
-  NonlinearCharacteristicData p_nonlinear_characteristic_data;
+  FlowType p_flow_type;
 
-  RCLModel p_rcl_data;
+  /*! @brief The boundary data is stored out of line, such that interior vertices stay small during traversals.
+   *         It is null for interior vertices and free outflows.
+   */
+  std::unique_ptr<BoundaryData> p_boundary_data;
 
   std::vector<InterGraphConnection> d_inter_graph_connections;
 
@@ -339,24 +433,13 @@ private:
 
   bool d_bcs_finalized;
 
+  bool d_is_continuity_vertex;
+
   friend GraphStorage;
 };
 
 class Edge : public Primitive {
 public:
-  struct InnerVerticesIterator {
-    explicit InnerVerticesIterator(const std::vector<MicroVertex> &vertices)
-        : d_vertices(vertices) {
-      assert(d_vertices.size() > 2);
-    }
-
-    const MicroVertex *begin() const { return (&d_vertices.front()) + 1; }
-    const MicroVertex *end() const { return (&d_vertices.back()); }
-
-  private:
-    const std::vector<MicroVertex> &d_vertices;
-  };
-
   const std::vector<std::size_t> &get_vertex_neighbors() const;
 
   const PhysicalData &get_physical_data() const;
@@ -382,14 +465,25 @@ public:
   std::size_t num_micro_edges() const;
   std::size_t num_micro_vertices() const;
 
-  const std::vector<MicroEdge> &micro_edges() const;
+  /*! @brief Returns true, if the discretization data gives the lengths of the micro edges, which then can differ from each other. */
+  bool has_micro_edge_lengths() const;
+
+  /*! @brief Returns the lengths of the micro edges, which are length / num_micro_edges without discretization data. */
+  std::vector<double> get_micro_edge_lengths() const;
 
-  const std::vector<MicroVertex> &micro_vertices() const;
+  MicroPrimitiveRange<MicroEdge> micro_edges() const;
 
-  InnerVerticesIterator inner_micro_vertices() const;
+  MicroPrimitiveRange<MicroVertex> micro_vertices() const;
 
-  const MicroVertex &left_micro_vertex() const;
-  const MicroVertex &right_micro_vertex() const;
+  /*! @brief The micro vertices without the first and the last one. */
+  MicroPrimitiveRange<MicroVertex> inner_micro_vertices() const;
+
+  MicroVertex left_micro_vertex() const;
+  MicroVertex right_micro_vertex() const;
+
+  /*! @brief The global id of the first micro edge, where the micro edges of an edge have consecutive global ids, as do its micro vertices. */
+  std::size_t get_first_micro_edge_id() const { return d_first_micro_edge_id; }
+  std::size_t get_first_micro_vertex_id() const { return d_first_micro_vertex_id; }
 
   Edge(std::size_t id,
        const Vertex &v1,
@@ -407,45 +501,164 @@ protected:
     */
   void assign_to_rank(int rank);
 
+  /*! @brief Replaces the micro edges and vertices by num_micro_edges new ones with consecutive global ids. */
+  void create_micro_primitives(std::size_t first_micro_edge_id, std::size_t first_micro_vertex_id, std::size_t num_micro_edges);
+
   std::vector<std::size_t> p_neighbors;
 
-  std::unique_ptr<PhysicalData> physical_data;
+  /*! @brief The physical data, which might be owned by the edge or be part of the node shared segment of the graph. */
+  std::shared_ptr<PhysicalData> physical_data;
   std::unique_ptr<DiscretizationData> discretization_data;
   std::unique_ptr<EmbeddingData> embedding_data;
 
   int d_rank;
 
-  std::vector<MicroEdge> d_micro_edges;
-  std::vector<MicroVertex> d_micro_vertices;
+  /*! @brief The micro primitives are not stored, since they follow from their index and these global ids,
+   *         while the lengths of non-uniform micro edges are kept in the discretization data.
+   */
+  std::size_t d_first_micro_edge_id;
+  std::size_t d_first_micro_vertex_id;
+  std::size_t d_num_micro_edges;
 
   friend GraphStorage;
 };
 
+/*! @brief An edge for GraphStorage::create_in_bulk. */
+struct EdgeDescription {
+  /*! @brief The first and second vertex of the edge as indices into the vertices created together with it. */
+  std::size_t left_vertex;
+  std::size_t right_vertex;
+
+  std::size_t num_micro_edges;
+
+  PhysicalData physical_data;
+
+  /*! @brief The polyline of the vessel, where no points mean that the edge is not embedded. */
+  EmbeddingData embedding_data;
+};
+
+/*! @brief An edge adjacent to a vertex, together with its orientation. */
+struct AdjacentEdge {
+  std::size_t edge_id;
+
+  /*! @brief Is the edge pointing towards the vertex? */
+  bool pointing_to;
+};
+
 class GraphStorage {
 public:
+  /*! @brief The edges adjacent to a vertex inside the compressed adjacency array. */
+  struct AdjacentEdgesRange {
+    const AdjacentEdge *begin() const { return d_begin; }
+    const AdjacentEdge *end() const { return d_end; }
+
+    std::size_t size() const { return static_cast<std::size_t>(d_end - d_begin); }
+
+    const AdjacentEdge &operator[](std::size_t k) const { return d_begin[k]; }
+
+    const AdjacentEdge *d_begin;
+    const AdjacentEdge *d_end;
+  };
+
   GraphStorage();
 
+  /*! @brief Detaches the primitives from the name index, since they might outlive the storage. */
+  ~GraphStorage();
+
+  /*! @brief Returns a shared owner of the edge, e.g. to keep it alive while it is removed from the storage.
+   *         Every call touches the atomic reference count, hence the library only uses edge() for the plain accesses.
+   */
   std::shared_ptr<Edge> get_edge(std::size_t id);
   std::shared_ptr<const Edge> get_edge(std::size_t id) const;
 
+  /*! @brief Returns a shared owner of the vertex, see get_edge. */
   std::shared_ptr<Vertex> get_vertex(std::size_t id);
   std::shared_ptr<const Vertex> get_vertex(std::size_t id) const;
 
+  /*! @brief Returns the edge with the given id by reference.
+   *         In contrast to get_edge, no reference count is touched, which makes this the accessor for the hot loops.
+   */
+  Edge &edge(std::size_t id);
+  const Edge &edge(std::size_t id) const;
+
+  /*! @brief Returns the vertex with the given id by reference. */
+  Vertex &vertex(std::size_t id);
+  const Vertex &vertex(std::size_t id) const;
+
+  /*! @brief Returns the edges adjacent to the given vertex, together with their orientation.
+   *
+   *  The adjacency is stored contiguously for all the vertices and is built in finalize_bcs.
+   *  Hence, this method throws if the graph was modified after the last call of finalize_bcs.
+   */
+  AdjacentEdgesRange adjacent_edges(std::size_t vertex_id) const;
+
+  /*! @brief Is the compressed adjacency available, i.e. was the graph finalized and not modified since? */
+  bool is_finalized() const;
+
   std::shared_ptr<Vertex> create_vertex();
   std::shared_ptr<Edge> connect(Vertex &v1, Vertex &v2, std::size_t num_micro_edges);
+
+  /*! @brief Creates num_vertices new vertices and connects them by the given edges in a single pass, e.g. for large imported or synthetic networks.
+   *
+   *  In contrast to create_vertex and connect, the storage and the neighbor lists are allocated once,
+   *  and the adjacency is built at the end.
+   *  The new vertices and edges get consecutive ids behind the existing ones and the default names.
+   *  Their boundary conditions can be set afterwards, before finalize_bcs is called.
+   *
+   * @return The id of the first new edge.
+   */
+  std::size_t create_in_bulk(std::size_t num_vertices, std::vector<EdgeDescription> edges);
   void remove(Edge &e);
 
+  /*! @brief Splits the given edge into parts with nearly the same number of micro edges, which are joined at continuity vertices.
+   *
+   *  This allows distributing a long vessel over several ranks.
+   *  The first part keeps the id and name of the edge, while the other parts get new ids and the name suffixes _1, _2, ...
+   *  The physical, discretization and embedding data are split along the vessel.
+   *  Has to be called before finalize_bcs.
+   *
+   * @return The ids of the parts, ordered from the first to the second vertex of the edge.
+   */
+  std::vector<std::size_t> split_edge(Edge &edge, std::size_t num_parts);
+
+  /*! @brief Replaces the micro edges of the given edge by micro edges with the given lengths, which have to add up to its length.
+   *
+   *  The lengths are stored in the discretization data of the edge, which are then used by the flow solver.
+   *  Since the graph is replicated, every rank has to call this for the same edges and lengths.
+   */
+  void set_micro_edge_lengths(Edge &edge, const std::vector<double> &lengths);
+
   std::vector<std::size_t> get_edge_ids() const;
   std::vector<std::size_t> get_vertex_ids() const;
 
   size_t num_vertices() const;
   size_t num_edges() const;
 
-  /*! @brief Finalizes all the boundary conditions on the vertices. */
+  /*! @brief Finalizes all the boundary conditions on the vertices and builds the compressed vertex to edge adjacency. */
   void finalize_bcs();
 
-  /*! @brief Returns all the edge ids assigned to the given rank. */
-  std::vector<std::size_t> get_active_edge_ids(int rank) const;
+  /*! @brief Sets the order in which the rank dependent lists, and hence the dof map and the solver loops, traverse the edges.
+   *
+   *  The ids of the primitives are not changed, such that the output stays stable.
+   *  The vertices are traversed in the order in which they first appear on the ordered edges.
+   *  The order is reset to the id order, if primitives are added or removed.
+   *
+   * @param edge_order A permutation of all the edge ids, e.g. from locality_edge_order.
+   */
+  void set_edge_order(std::vector<std::size_t> edge_order);
+
+  /*! @brief Returns all the edge ids in the traversal order set by set_edge_order. */
+  std::vector<std::size_t> get_edge_order() const;
+
+  /*! @brief Returns all the vertex ids in the traversal order induced by the edge order. */
+  std::vector<std::size_t> get_vertex_order() const;
+
+  /*! @brief Returns all the edge ids assigned to the given rank in the traversal order.
+   *
+   *  The rank dependent id lists are cached, and the returned references stay valid
+   *  until a graph is modified, i.e. until new primitives are added, removed, connected or assigned to ranks.
+   */
+  const std::vector<std::size_t> &get_active_edge_ids(int rank) const;
 
   /*! @brief Returns all the edge ids for the ghost layer of main_rank w.r.t. ghost_rank.
     *
@@ -453,19 +666,39 @@ public:
     * @param ghost_rank  The rank which acts as a ghost.
     * @return            A list of edge ids of the ghost.
     */
-  std::vector<std::size_t> get_ghost_edge_ids(int main_rank, int ghost_rank) const;
+  const std::vector<std::size_t> &get_ghost_edge_ids(int main_rank, int ghost_rank) const;
+
+  /*! @brief Returns the ranks, which exchange ghost layers with the given rank in any direction, in ascending order.
+   *
+   *  The ranks are discovered from the edges around the vertices of the given rank, including the vertices of connected graphs,
+   *  hence the ghost layers have to be calculated only for these ranks instead of for all pairs of ranks.
+   */
+  std::vector<int> get_neighbor_ranks(int rank) const;
 
   /*! @brief Returns all the vertex ids, which he on active neighbor edge. */
-  std::vector<std::size_t> get_active_vertex_ids(int rank) const;
+  const std::vector<std::size_t> &get_active_vertex_ids(int rank) const;
 
-  std::vector<std::size_t> get_active_and_connected_vertex_ids(int rank) const;
+  const std::vector<std::size_t> &get_active_and_connected_vertex_ids(int rank) const;
 
   bool owns_primitive(const Vertex &vertex, size_t rank) const;
 
   void assign_edge_to_rank(Edge &edge, int rank);
 
+  /*! @brief Returns all the vertices, whose embedding coordinates coincide with the given point, ordered by their ids.
+   *
+   *  This and the other spatial queries use k-d trees over the embedding, which are built on the first query after a modification of a graph.
+   */
   std::vector<std::shared_ptr<Vertex>> find_embedded_vertices(const Point &p) const;
 
+  /*! @brief Returns all the vertices with embedding coordinates within the given euclidean distance to the point, ordered by their ids. */
+  std::vector<std::shared_ptr<Vertex>> find_embedded_vertices(const Point &p, double radius) const;
+
+  /*! @brief Returns the vertex with the embedding coordinates closest to the given point, or nullptr if no vertex is embedded. */
+  std::shared_ptr<Vertex> find_nearest_embedded_vertex(const Point &p) const;
+
+  /*! @brief Returns the ids of all the edges with a point of their embedding polyline within the given euclidean distance, ordered by their ids. */
+  std::vector<std::size_t> find_embedded_edges(const Point &p, double radius) const;
+
   /*! @brief Searches the given named edge. */
   std::shared_ptr<Edge> find_edge_by_name(const std::string &name);
 
@@ -474,6 +707,37 @@ public:
 
   bool has_named_vertex(const std::string &name) const;
 
+  /*! @brief Moves the physical data of the edges and the compressed adjacency into a single segment per node, which the ranks of the node share,
+   *         such that a large network is only stored once per node instead of once per rank.
+   *
+   *  The graph has to be finalized and has to be the same on all the ranks of comm, and the call is collective.
+   *  The names, the embedding, the boundary conditions and the assignment to ranks stay private to every rank.
+   *  The shared data is read-only: a modification of the adjacency or new physical data of an edge replace the shared data by private copies.
+   *  Since the segment is freed collectively, the ranks of a node have to destroy their graphs in the same order.
+   */
+  void share_on_node(MPI_Comm comm);
+
+  /*! @brief Releases all the primitives, which the given rank does not need after the partitioning,
+   *         such that the memory of a distributed network scales with its part of the network.
+   *
+   *  The rank keeps the edges assigned to it, their ghost layers w.r.t. all the other ranks and the vertices of these edges.
+   *  The primitives keep their global ids, hence num_edges, num_vertices, the dof maps and the output stay valid,
+   *  while edge and vertex throw for the released ids.
+   *  Afterwards only the rank dependent lists of the given rank, or for get_ghost_edge_ids the lists between it and another rank, are available.
+   *  The graph has to be finalized, must not be connected to other graphs and must not be modified or repartitioned afterwards.
+   *  Since the ranks keep different primitives, a restricted graph cannot be shared on a node.
+   */
+  void restrict_to_rank(int rank);
+
+  /*! @brief Returns true, if the primitives not needed on the rank were released by restrict_to_rank. */
+  bool is_restricted() const;
+
+  /*! @brief Returns the memory of the primitives, their boundary data, the adjacency and the caches.
+   *         Unless the graph was restricted to a rank, it does not shrink with the number of ranks.
+   *         A node shared segment is only counted on the first rank of its node as "node shared".
+   */
+  MemoryReport memory_report() const;
+
 private:
   std::shared_ptr<Edge> connect(Vertex &v1, Vertex &v2, std::size_t edge_id, std::size_t num_micro_edges);
 
@@ -497,14 +761,77 @@ private:
   /*! @brief Returns true if the given vertex is to connected to another graph with an edge assigned to the given rank. */
   bool vertex_is_connected_to_rank(const Vertex &vertex, int rank) const;
 
-  std::map<std::size_t, std::shared_ptr<Edge>> p_edges;
-  std::map<std::size_t, std::shared_ptr<Vertex>> p_vertices;
+  /*! @brief Throws, if the graph was restricted to a rank and the given rank dependent list is not available anymore. */
+  void check_available_for_rank(bool available, const std::string &function) const;
+
+  /*! @brief Builds the compressed vertex to edge adjacency from the neighbor lists of the vertices. */
+  void build_adjacency();
+
+  /*! @brief Drops the compressed adjacency after a modification of the topology. */
+  void invalidate_adjacency();
 
-  std::size_t p_next_edge_id;
-  std::size_t p_next_vertex_id;
+  /*! @brief The primitives indexed by their id. Removed and released primitives leave a nullptr behind, so the ids stay dense. */
+  std::vector<std::shared_ptr<Edge>> p_edges;
+  std::vector<std::shared_ptr<Vertex>> p_vertices;
+
+  std::size_t d_num_edges;
+
+  /*! @brief The ids of the primitives by their names, which are kept up to date by Primitive::set_name. */
+  NameIndex d_edge_name_index;
+  NameIndex d_vertex_name_index;
+
+  /*! @brief The traversal order of the edges. If empty, they are traversed by their ids. */
+  std::vector<std::size_t> d_edge_order;
+
+  /*! @brief The adjacent edges of vertex k are stored in d_adjacency[d_adjacency_offsets[k]], ..., d_adjacency[d_adjacency_offsets[k+1]-1]. */
+  std::vector<std::size_t> d_adjacency_offsets;
+  std::vector<AdjacentEdge> d_adjacency;
+
+  /*! @brief The adjacency, which is read, where the arrays are either the vectors above or part of the node shared segment.
+   *         A nullptr means, that the adjacency is not available.
+   */
+  const std::size_t *d_adjacency_offsets_data;
+  const AdjacentEdge *d_adjacency_data;
+
+  /*! @brief The segment for share_on_node, which the edges keep alive with their physical data. */
+  std::shared_ptr<SharedMemorySegment> d_shared_segment;
 
   std::size_t d_num_micro_edges;
   std::size_t d_num_micro_vertices;
+
+  /*! @brief The rank passed to restrict_to_rank, or -1 if all the primitives are stored. */
+  int d_restricted_rank;
+
+  /*! @brief Caches the rank dependent id lists.
+   *         Since the lists with connected primitives depend on other graphs, the cache is invalidated by modifications of any graph.
+   */
+  struct RankCache {
+    /*! @brief The number of graph modifications, for which the cache was filled. */
+    std::size_t revision = 0;
+
+    std::map<int, std::vector<std::size_t>> active_edge_ids;
+    std::map<int, std::vector<std::size_t>> active_vertex_ids;
+    std::map<int, std::vector<std::size_t>> active_and_connected_vertex_ids;
+    std::map<std::pair<int, int>, std::vector<std::size_t>> ghost_edge_ids;
+
+    /*! @brief The coordinates of the vertices and the points of the edge polylines, tagged with the primitive ids. */
+    std::shared_ptr<const PointKDTree> vertex_points;
+    std::shared_ptr<const PointKDTree> edge_points;
+  };
+
+  /*! @brief Resets the cache, if a graph was modified since it was filled. The cache mutex has to be locked. */
+  void update_cache_revision() const;
+
+  /*! @brief Returns the k-d tree over the vertex coordinates (vertices = true) or the edge polylines, and builds both if necessary. */
+  std::shared_ptr<const PointKDTree> get_spatial_index(bool vertices) const;
+
+  /*! @brief Returns the cached entry for the given key, and calculates it if necessary. */
+  template<typename Key, typename Function>
+  const std::vector<std::size_t> &get_cached(std::map<Key, std::vector<std::size_t>> RankCache::*cache, const Key &key, Function calculate) const;
+
+  /*! @brief The cache is filled lazily from const methods, which might be called from several threads. */
+  mutable std::mutex d_cache_mutex;
+  mutable RankCache d_cache;
 };
 
 std::vector<double> get_normals(const GraphStorage &graph, const Vertex &v);
@@ -0,0 +1,156 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "hardware_counters.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace macrocirculation {
+
+namespace {
+
+#ifdef __linux__
+
+/*! @brief The events of the calling thread, which form a single group, such that they are read with one system call. */
+struct ThreadCounters {
+  ThreadCounters() {
+    const auto &events = HardwareCounters::get_events();
+    positions.fill(HardwareCounters::max_events);
+    for (std::size_t k = 0; k < events.size(); k += 1) {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = events[k].type;
+      attr.config = events[k].config;
+      attr.read_format = PERF_FORMAT_GROUP;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      const int fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0));
+      if (fd < 0)
+        continue;
+      if (leader < 0)
+        leader = fd;
+      fds.push_back(fd);
+      positions[k] = num_opened++;
+    }
+  }
+
+  ~ThreadCounters() {
+    for (auto fd : fds)
+      close(fd);
+  }
+
+  ThreadCounters(const ThreadCounters &) = delete;
+  ThreadCounters &operator=(const ThreadCounters &) = delete;
+
+  int leader{-1};
+  std::vector<int> fds;
+  /*! @brief The position of every event in the values of the group, or max_events, if it could not be opened. */
+  std::array<std::size_t, HardwareCounters::max_events> positions{};
+  std::size_t num_opened{0};
+};
+
+ThreadCounters &get_thread_counters() {
+  thread_local ThreadCounters counters;
+  return counters;
+}
+
+#endif
+
+std::vector<HardwareCounters::Event> create_events() {
+  std::vector<HardwareCounters::Event> events;
+#ifdef __linux__
+  events.push_back({"task clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, 1.});
+  events.push_back({"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, 1.});
+  events.push_back({"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, 1.});
+  events.push_back({"cache references", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES, 1.});
+  events.push_back({"cache misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, 1.});
+#endif
+  const char *raw = std::getenv("MACROCIRCULATION_HARDWARE_EVENTS");
+  if (raw != nullptr) {
+    for (auto &event : HardwareCounters::parse_raw_events(raw))
+      events.push_back(std::move(event));
+  }
+  if (events.size() > HardwareCounters::max_events)
+    throw std::runtime_error("HardwareCounters: at most " + std::to_string(HardwareCounters::max_events) + " events are supported");
+  return events;
+}
+
+} // namespace
+
+const std::vector<HardwareCounters::Event> &HardwareCounters::get_events() {
+  static const std::vector<Event> events = create_events();
+  return events;
+}
+
+std::vector<HardwareCounters::Event> HardwareCounters::parse_raw_events(const std::string &list) {
+  std::vector<Event> events;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (item.empty())
+      continue;
+    const auto equal = item.find('=');
+    if (equal == std::string::npos || equal == 0)
+      throw std::runtime_error("HardwareCounters: the raw event " + item + " is not of the form name=0xconfig*weight");
+    const auto star = item.find('*', equal);
+    const std::string config = item.substr(equal + 1, star == std::string::npos ? std::string::npos : star - equal - 1);
+    const double weight = star == std::string::npos ? 1. : std::stod(item.substr(star + 1));
+    // PERF_TYPE_RAW
+    events.push_back({item.substr(0, equal), 4, std::stoull(config, nullptr, 0), weight});
+  }
+  return events;
+}
+
+bool HardwareCounters::available() {
+#ifdef __linux__
+  return get_thread_counters().num_opened > 0;
+#else
+  return false;
+#endif
+}
+
+HardwareCounters::Counts HardwareCounters::read() {
+  Counts counts{};
+#ifdef __linux__
+  auto &counters = get_thread_counters();
+  if (counters.num_opened == 0)
+    return counts;
+
+  // the group is read as its number of events followed by their values
+  std::array<std::uint64_t, max_events + 1> values{};
+  const auto bytes = ::read(counters.leader, values.data(), (counters.num_opened + 1) * sizeof(std::uint64_t));
+  if (bytes < 0)
+    return counts;
+
+  for (std::size_t k = 0; k < max_events; k += 1) {
+    if (counters.positions[k] < counters.num_opened)
+      counts[k] = values[counters.positions[k] + 1];
+  }
+#endif
+  return counts;
+}
+
+std::size_t HardwareCounters::index_of(const std::string &name) {
+  const auto &events = get_events();
+  for (std::size_t k = 0; k < events.size(); k += 1) {
+    if (events[k].name == name)
+      return k;
+  }
+  return max_events;
+}
+
+} // namespace macrocirculation
@@ -0,0 +1,63 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_HARDWARE_COUNTERS_HPP
+#define TUMORMODELS_HARDWARE_COUNTERS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace macrocirculation {
+
+/*! @brief Reads the performance counters of the calling thread with the perf_event interface of linux.
+ *
+ *  The phase timers add the counts of these events to their phases, if the library was compiled with MACROCIRCULATION_HARDWARE_COUNTERS
+ *  (cmake option LibMacrocirculation_Enable_Hardware_Counters).
+ *  By default the task clock, the cycles, the instructions and the references and misses of the last level cache are counted.
+ *  Floating point operations have no portable event, hence they are given as raw events of the cpu in the environment variable
+ *  MACROCIRCULATION_HARDWARE_EVENTS, e.g. for the double precision events of intel cpus
+ *    MACROCIRCULATION_HARDWARE_EVENTS="flops scalar=0x01c7*1,flops 128=0x04c7*2,flops 256=0x10c7*4"
+ *  where the weight after the star is the number of flops per count.
+ *  Events, which cannot be opened, e.g. in virtual machines or with a restrictive /proc/sys/kernel/perf_event_paranoid, always count zero.
+ */
+class HardwareCounters {
+public:
+  static constexpr std::size_t max_events = 12;
+
+  using Counts = std::array<std::uint64_t, max_events>;
+
+  struct Event {
+    std::string name;
+    /*! @brief The type and config of the perf_event_attr. */
+    std::uint32_t type;
+    std::uint64_t config;
+    /*! @brief The flops per count of the events, whose names start with "flops", otherwise one. */
+    double weight;
+  };
+
+  /*! @brief Returns the events in the order of the counts, i.e. the default events followed by the ones of MACROCIRCULATION_HARDWARE_EVENTS. */
+  static const std::vector<Event> &get_events();
+
+  /*! @brief Parses a comma separated list of raw events in the format "name=0xconfig*weight", where the weight is optional. */
+  static std::vector<Event> parse_raw_events(const std::string &list);
+
+  /*! @brief Returns true, if at least one event could be opened on the calling thread. */
+  static bool available();
+
+  /*! @brief Returns the counts of the calling thread since its first read. */
+  static Counts read();
+
+  /*! @brief Returns the index of the event with the given name, or max_events, if there is none. */
+  static std::size_t index_of(const std::string &name);
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_HARDWARE_COUNTERS_HPP
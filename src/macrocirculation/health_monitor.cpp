@@ -0,0 +1,148 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "health_monitor.hpp"
+
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include "communication/mpi.hpp"
+#include "dof_map.hpp"
+#include "graph_storage.hpp"
+
+namespace macrocirculation {
+
+HealthMonitor::HealthMonitor(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, std::shared_ptr<DofMap> dof_map)
+    : d_comm(comm),
+      d_graph(std::move(graph)),
+      d_dof_map(std::move(dof_map)),
+      d_level(HealthCheckLevel::endpoint),
+      d_interval(1),
+      d_step(0) {}
+
+void HealthMonitor::set_level(HealthCheckLevel level) { d_level = level; }
+
+HealthCheckLevel HealthMonitor::get_level() const { return d_level; }
+
+void HealthMonitor::set_interval(std::size_t num_steps) {
+  if (num_steps == 0)
+    throw std::runtime_error("the interval of the health checks has to be positive");
+  d_interval = num_steps;
+}
+
+void HealthMonitor::step(const std::vector<double> &u) {
+  if (d_level == HealthCheckLevel::off)
+    return;
+
+  d_step += 1;
+  if (d_step < d_interval)
+    return;
+  d_step = 0;
+
+  check(u);
+}
+
+void HealthMonitor::check(const std::vector<double> &u) const {
+  const auto error = find_error(u, d_level);
+  if (!error.empty())
+    throw std::runtime_error("health check failed on rank " + std::to_string(mpi::rank(d_comm)) + ": " + error);
+}
+
+std::string HealthMonitor::find_error(const std::vector<double> &u, HealthCheckLevel level) const {
+  if (level == HealthCheckLevel::off || u.empty())
+    return "";
+
+  if (level == HealthCheckLevel::endpoint) {
+    if (!std::isfinite(u.front()) || !std::isfinite(u.back()))
+      return "solution contains non finite values";
+    return "";
+  }
+
+  const bool full = level == HealthCheckLevel::full;
+
+  for (const auto &e_id : d_graph->get_active_edge_ids(mpi::rank(d_comm))) {
+    const auto &local_dof_map = d_dof_map->get_local_dof_map(d_graph->edge(e_id));
+    const std::size_t num_micro_edges = local_dof_map.num_micro_edges();
+
+    std::string error;
+    if (full) {
+      error = check_micro_edges(u, e_id, 0, num_micro_edges, true);
+    } else {
+      error = check_micro_edges(u, e_id, 0, 1, false);
+      if (error.empty())
+        error = check_micro_edges(u, e_id, num_micro_edges - 1, num_micro_edges, false);
+    }
+    if (!error.empty())
+      return error;
+  }
+
+  for (const auto &v_id : d_graph->get_active_vertex_ids(mpi::rank(d_comm))) {
+    const auto &vertex = d_graph->vertex(v_id);
+    // only the 0D models have dofs on the vertices
+    if (!vertex.is_leaf() || !(vertex.is_windkessel_outflow() || vertex.is_vessel_tree_outflow() || vertex.is_rcl_outflow()))
+      continue;
+    const auto &vertex_dof_map = d_dof_map->get_local_dof_map(vertex);
+    for (auto i = vertex_dof_map.first_dof(); i < vertex_dof_map.first_dof() + vertex_dof_map.num_local_dof(); i += 1) {
+      if (!std::isfinite(u[i])) {
+        std::stringstream ss;
+        ss << "non finite value " << u[i] << " at vertex " << v_id << " (" << vertex.get_name() << ")";
+        return ss.str();
+      }
+    }
+  }
+
+  return "";
+}
+
+std::string HealthMonitor::check_micro_edges(const std::vector<double> &u, std::size_t edge_id, std::size_t first_micro_edge, std::size_t last_micro_edge, bool check_area) const {
+  const auto &edge = d_graph->edge(edge_id);
+  const auto &local_dof_map = d_dof_map->get_local_dof_map(edge);
+  const std::size_t num_basis_functions = local_dof_map.num_basis_functions();
+
+  const auto describe = [&](const std::string &what, std::size_t micro_edge_id, double value) {
+    std::stringstream ss;
+    ss << what << " " << value << " on edge " << edge_id << " (" << edge.get_name() << ") at micro edge " << micro_edge_id;
+    return ss.str();
+  };
+
+  // all the dofs of consecutive micro edges are contiguous, hence we can scan them in one go
+  const std::size_t begin = local_dof_map.first_dof(first_micro_edge, 0);
+  const std::size_t end = begin + (last_micro_edge - first_micro_edge) * local_dof_map.micro_edge_stride();
+  bool finite = true;
+  for (std::size_t i = begin; i < end; i += 1)
+    finite &= std::isfinite(u[i]);
+
+  if (!finite) {
+    for (std::size_t i = begin; i < end; i += 1)
+      if (!std::isfinite(u[i]))
+        return describe("non finite value", first_micro_edge + (i - begin) / local_dof_map.micro_edge_stride(), u[i]);
+  }
+
+  if (!check_area || local_dof_map.num_components() < 2)
+    return "";
+
+  // the area is the second component, and the legendre polynomials are +1 at the right and -1^i at the left boundary
+  for (std::size_t micro_edge_id = first_micro_edge; micro_edge_id < last_micro_edge; micro_edge_id += 1) {
+    const double *A = local_dof_map.dof_values(u, micro_edge_id, 1);
+    double A_left = 0;
+    double A_right = 0;
+    for (std::size_t i = 0; i < num_basis_functions; i += 1) {
+      A_left += (i % 2 == 0 ? +1 : -1) * A[i];
+      A_right += A[i];
+    }
+    if (A_left <= 0)
+      return describe("non positive area", micro_edge_id, A_left);
+    if (A_right <= 0)
+      return describe("non positive area", micro_edge_id, A_right);
+  }
+
+  return "";
+}
+
+} // namespace macrocirculation
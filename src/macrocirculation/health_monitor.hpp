@@ -0,0 +1,78 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_HEALTH_MONITOR_HPP
+#define TUMORMODELS_HEALTH_MONITOR_HPP
+
+#include <memory>
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+namespace macrocirculation {
+
+// forward declarations
+class GraphStorage;
+class DofMap;
+
+/*! @brief The thoroughness of the solution health checks. */
+enum class HealthCheckLevel {
+  /*! @brief No checks at all. */
+  off,
+  /*! @brief Only checks the first and last entry of the solution vector for NaNs. */
+  endpoint,
+  /*! @brief Checks the first and last micro edge of every edge and all the vertex dofs. */
+  sampled,
+  /*! @brief Checks all the dofs and the positivity of the area at all micro edge boundaries. */
+  full
+};
+
+/*! @brief Checks the (Q, A) flow solution for NaNs, infinite values and negative areas.
+ *
+ *  The checks are only executed every n-th call to step, such that production runs pay almost nothing.
+ *  If a check fails, an exception naming the edge or vertex with the broken values is thrown on the failing rank.
+ */
+class HealthMonitor {
+public:
+  HealthMonitor(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, std::shared_ptr<DofMap> dof_map);
+
+  void set_level(HealthCheckLevel level);
+
+  HealthCheckLevel get_level() const;
+
+  /*! @brief Sets after how many steps the next check is executed. */
+  void set_interval(std::size_t num_steps);
+
+  /*! @brief Counts a time step and checks the solution, if we reached the check interval. */
+  void step(const std::vector<double> &u);
+
+  /*! @brief Checks the given solution immediately with the configured level, e.g. once per output interval. */
+  void check(const std::vector<double> &u) const;
+
+  /*! @brief Checks the given solution and returns an error description, which is empty if the solution is healthy. */
+  std::string find_error(const std::vector<double> &u, HealthCheckLevel level) const;
+
+private:
+  MPI_Comm d_comm;
+
+  std::shared_ptr<GraphStorage> d_graph;
+
+  std::shared_ptr<DofMap> d_dof_map;
+
+  HealthCheckLevel d_level;
+
+  std::size_t d_interval;
+
+  std::size_t d_step;
+
+  /*! @brief Checks the micro edges in [first_micro_edge, last_micro_edge) of the given edge. */
+  std::string check_micro_edges(const std::vector<double> &u, std::size_t edge_id, std::size_t first_micro_edge, std::size_t last_micro_edge, bool check_area) const;
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_HEALTH_MONITOR_HPP
@@ -0,0 +1,271 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "impedance_solver.hpp"
+
+#include <Eigen/Sparse>
+#include <Eigen/SparseLU>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "graph_storage.hpp"
+#include "vessel_formulas.hpp"
+
+namespace macrocirculation {
+
+namespace {
+
+using Complex = ImpedanceSolver::Complex;
+
+/*! @brief The number of samples of an inflow function over a period for its fourier coefficients. */
+constexpr std::size_t num_period_samples = 1000;
+
+/*! @brief The linearized vessel as a transmission line for a single angular frequency.
+ *         Along the vessel p(x) = p_l cosh(gamma x) - z S(x) Q_l and Q(x) = Q_l cosh(gamma x) - y S(x) p_l with S(x) = sinh(gamma x) / gamma,
+ *         which stays finite for omega = 0, where the vessel is its Poiseuille resistance.
+ */
+struct TransmissionLine {
+  TransmissionLine(const PhysicalData &param, double omega)
+      : z(linear::get_L(param) * linear::get_R(param), omega * linear::get_L(param)),
+        y(0, omega * linear::get_C(param)),
+        gamma(std::sqrt(z * y)),
+        length(param.length) {}
+
+  Complex z;
+  Complex y;
+  Complex gamma;
+  double length;
+
+  Complex cosh(double x) const { return std::cosh(gamma * x); }
+
+  Complex sinh_over_gamma(double x) const { return std::abs(gamma) == 0 ? Complex(x) : std::sinh(gamma * x) / gamma; }
+
+  /*! @brief The coefficients of the flow Q_l = a p_l - b p_r at the start of the vessel, which by symmetry also gives the flow Q_r = b p_l - a p_r at its end. */
+  void get_admittances(Complex &a, Complex &b) const {
+    const Complex zS = z * sinh_over_gamma(length);
+    if (std::abs(zS) == 0)
+      throw std::runtime_error("the impedance solver needs a resistance in every vessel for the mean flow");
+    b = 1. / zS;
+    a = cosh(length) * b;
+  }
+};
+
+bool is_0d_outflow(const Vertex &vertex) {
+  return vertex.is_windkessel_outflow() || vertex.is_vessel_tree_outflow() || vertex.is_rcl_outflow();
+}
+
+double get_outflow_pressure(const Vertex &vertex) {
+  if (vertex.is_windkessel_outflow())
+    return vertex.get_peripheral_vessel_data().p_out;
+  else if (vertex.is_vessel_tree_outflow())
+    return vertex.get_vessel_tree_data().p_out;
+  else
+    return vertex.get_rcl_data().p_out;
+}
+
+} // namespace
+
+std::complex<double> calculate_vessel_input_impedance(const PhysicalData &param, double omega, std::complex<double> Z_load) {
+  // p_r = Z_load Q_r eliminated from the flows Q_l = a p_l - b p_r and Q_r = b p_l - a p_r
+  Complex a, b;
+  TransmissionLine(param, omega).get_admittances(a, b);
+  return (1. + a * Z_load) / (a + (a * a - b * b) * Z_load);
+}
+
+std::complex<double> calculate_outflow_impedance(const Vertex &vertex, const PhysicalData &param, double omega) {
+  const Complex i_omega(0, omega);
+
+  // the 0D models are coupled to the vessel by its characteristic resistance R1
+  const double R1 = calculate_R1(param);
+  if (vertex.is_free_outflow())
+    return R1;
+
+  if (vertex.is_windkessel_outflow()) {
+    const auto &data = vertex.get_peripheral_vessel_data();
+    const double R2 = data.resistance - R1;
+    return R1 + R2 / (1. + i_omega * R2 * data.compliance);
+  }
+
+  // the chains are collapsed from their outflow pressure towards the vessel
+  Complex Z = 0;
+  if (vertex.is_vessel_tree_outflow()) {
+    // every level splits the flow into furcation_number parallel vessels
+    const auto &data = vertex.get_vessel_tree_data();
+    const auto n = static_cast<double>(data.furcation_number);
+    for (std::size_t k = data.resistances.size(); k > 0; k -= 1)
+      Z = 1. / (i_omega * data.capacitances[k - 1] + 1. / (data.resistances[k - 1] + Z / n));
+  } else {
+    const auto &data = vertex.get_rcl_data();
+    for (std::size_t k = data.resistances.size(); k > 0; k -= 1)
+      Z = 1. / (i_omega * data.capacitances[k - 1] + 1. / (data.resistances[k - 1] + i_omega * data.inductances[k - 1] + Z));
+  }
+  return R1 + Z;
+}
+
+ImpedanceSolver::ImpedanceSolver(std::shared_ptr<GraphStorage> graph, double period, std::size_t num_harmonics)
+    : d_graph(std::move(graph)),
+      d_period(period),
+      d_num_harmonics(num_harmonics),
+      d_inflows(num_harmonics + 1, std::vector<Complex>(d_graph->num_vertices(), 0.)),
+      d_p(num_harmonics + 1, std::vector<Complex>(d_graph->num_vertices(), 0.)),
+      d_Q(num_harmonics + 1, std::vector<Complex>(d_graph->num_edges(), 0.)) {
+  if (d_period <= 0)
+    throw std::runtime_error("the period of the impedance solver has to be positive");
+  if (2 * d_num_harmonics >= num_period_samples)
+    throw std::runtime_error("the impedance solver resolves at most " + std::to_string(num_period_samples / 2 - 1) + " harmonics");
+
+  for (auto e_id : d_graph->get_edge_ids())
+    if (!d_graph->edge(e_id).has_physical_data())
+      throw std::runtime_error("the impedance solver needs the physical data of all the edges");
+
+  for (auto v_id : d_graph->get_vertex_ids()) {
+    const auto &vertex = d_graph->vertex(v_id);
+    if (vertex.is_linear_characteristic_inflow() || vertex.is_nonlinear_characteristic_inflow())
+      throw std::runtime_error("the impedance solver does not support the characteristic inflow at vertex " + vertex.get_name());
+    if (!vertex.is_inflow_with_fixed_flow() && !vertex.is_inflow_with_fixed_pressure())
+      continue;
+
+    // the discrete fourier transform of the midpoint samples
+    for (std::size_t j = 0; j < num_period_samples; j += 1) {
+      const double t = (static_cast<double>(j) + 0.5) * d_period / num_period_samples;
+      const double value = vertex.get_inflow_value(t) / num_period_samples;
+      for (std::size_t k = 0; k <= d_num_harmonics; k += 1)
+        d_inflows[k][v_id] += value * std::exp(Complex(0, -get_angular_frequency(k) * t));
+    }
+  }
+}
+
+double ImpedanceSolver::get_angular_frequency(std::size_t k) const {
+  return 2 * M_PI * static_cast<double>(k) / d_period;
+}
+
+void ImpedanceSolver::solve() {
+  std::vector<Complex> sources;
+  for (std::size_t k = 0; k <= d_num_harmonics; k += 1) {
+    const double omega = get_angular_frequency(k);
+
+    // the outflow pressures are constant, hence they only drive the mean flow
+    sources = d_inflows[k];
+    if (k == 0) {
+      for (auto v_id : d_graph->get_vertex_ids())
+        if (is_0d_outflow(d_graph->vertex(v_id)))
+          sources[v_id] = get_outflow_pressure(d_graph->vertex(v_id));
+    }
+
+    d_p[k] = solve_for_frequency(omega, sources, no_vertex);
+
+    for (auto e_id : d_graph->get_edge_ids()) {
+      const auto &edge = d_graph->edge(e_id);
+      Complex a, b;
+      TransmissionLine(edge.get_physical_data(), omega).get_admittances(a, b);
+      d_Q[k][e_id] = a * d_p[k][edge.get_vertex_neighbors()[0]] - b * d_p[k][edge.get_vertex_neighbors()[1]];
+    }
+  }
+}
+
+Complex ImpedanceSolver::calculate_input_impedance(std::size_t vertex_id, double omega) const {
+  const auto &vertex = d_graph->vertex(vertex_id);
+  if (!vertex.is_inflow_with_fixed_flow() && !vertex.is_inflow_with_fixed_pressure())
+    throw std::runtime_error("the input impedance is only defined at the inflows");
+
+  std::vector<Complex> sources(d_graph->num_vertices(), 0.);
+  sources[vertex_id] = 1.;
+  return solve_for_frequency(omega, sources, vertex_id)[vertex_id];
+}
+
+std::vector<Complex> ImpedanceSolver::solve_for_frequency(double omega, const std::vector<Complex> &sources, std::size_t driven_vertex_id) const {
+  using SparseMatrix = Eigen::SparseMatrix<Complex>;
+
+  const auto num_vertices = static_cast<Eigen::Index>(d_graph->num_vertices());
+
+  // the mass balances, where the rows of fixed pressures and unconnected vertices are the identity
+  const auto is_identity_row = [=](const Vertex &v) {
+    return v.is_unconnected() || (v.is_inflow_with_fixed_pressure() && v.get_id() != driven_vertex_id);
+  };
+
+  std::vector<Eigen::Triplet<Complex>> triplets;
+  for (auto e_id : d_graph->get_edge_ids()) {
+    const auto &edge = d_graph->edge(e_id);
+    const auto l = static_cast<Eigen::Index>(edge.get_vertex_neighbors()[0]);
+    const auto r = static_cast<Eigen::Index>(edge.get_vertex_neighbors()[1]);
+    Complex a, b;
+    TransmissionLine(edge.get_physical_data(), omega).get_admittances(a, b);
+    if (!is_identity_row(d_graph->vertex(l))) {
+      triplets.emplace_back(l, l, a);
+      triplets.emplace_back(l, r, -b);
+    }
+    if (!is_identity_row(d_graph->vertex(r))) {
+      triplets.emplace_back(r, l, -b);
+      triplets.emplace_back(r, r, a);
+    }
+  }
+
+  Eigen::VectorXcd rhs = Eigen::VectorXcd::Zero(num_vertices);
+  for (auto v_id : d_graph->get_vertex_ids()) {
+    const auto &vertex = d_graph->vertex(v_id);
+    const auto row = static_cast<Eigen::Index>(v_id);
+    if (is_identity_row(vertex)) {
+      triplets.emplace_back(row, row, 1.);
+      rhs[row] = vertex.is_unconnected() ? 0. : sources[v_id];
+    } else if (vertex.is_inflow_with_fixed_flow() || vertex.is_inflow_with_fixed_pressure()) {
+      rhs[row] = sources[v_id];
+    } else if (vertex.is_free_outflow() || is_0d_outflow(vertex)) {
+      // the flow (p - p_out) / Z leaves the network
+      const Complex Z = calculate_outflow_impedance(vertex, d_graph->edge(vertex.get_edge_neighbors()[0]).get_physical_data(), omega);
+      triplets.emplace_back(row, row, 1. / Z);
+      rhs[row] = sources[v_id] / Z;
+    }
+  }
+
+  SparseMatrix A(num_vertices, num_vertices);
+  A.setFromTriplets(triplets.begin(), triplets.end());
+  Eigen::SparseLU<SparseMatrix> lu;
+  lu.compute(A);
+  if (lu.info() != Eigen::Success)
+    throw std::runtime_error("the system of the impedance solver could not be factorized");
+  const Eigen::VectorXcd p = lu.solve(rhs);
+
+  return std::vector<Complex>(p.data(), p.data() + p.size());
+}
+
+double ImpedanceSolver::evaluate_series(const std::vector<Complex> &harmonics, double t) const {
+  double value = harmonics[0].real();
+  for (std::size_t k = 1; k < harmonics.size(); k += 1)
+    value += 2 * (harmonics[k] * std::exp(Complex(0, get_angular_frequency(k) * t))).real();
+  return value;
+}
+
+double ImpedanceSolver::get_pressure(std::size_t vertex_id, double t) const {
+  std::vector<Complex> harmonics(d_num_harmonics + 1);
+  for (std::size_t k = 0; k <= d_num_harmonics; k += 1)
+    harmonics[k] = d_p[k][vertex_id];
+  return evaluate_series(harmonics, t);
+}
+
+double ImpedanceSolver::get_pressure(const Edge &edge, double s, double t) const {
+  std::vector<Complex> harmonics(d_num_harmonics + 1);
+  for (std::size_t k = 0; k <= d_num_harmonics; k += 1) {
+    const TransmissionLine line(edge.get_physical_data(), get_angular_frequency(k));
+    const double x = s * line.length;
+    harmonics[k] = d_p[k][edge.get_vertex_neighbors()[0]] * line.cosh(x) - line.z * line.sinh_over_gamma(x) * d_Q[k][edge.get_id()];
+  }
+  return evaluate_series(harmonics, t);
+}
+
+double ImpedanceSolver::get_flow(const Edge &edge, double s, double t) const {
+  std::vector<Complex> harmonics(d_num_harmonics + 1);
+  for (std::size_t k = 0; k <= d_num_harmonics; k += 1) {
+    const TransmissionLine line(edge.get_physical_data(), get_angular_frequency(k));
+    const double x = s * line.length;
+    harmonics[k] = d_Q[k][edge.get_id()] * line.cosh(x) - line.y * line.sinh_over_gamma(x) * d_p[k][edge.get_vertex_neighbors()[0]];
+  }
+  return evaluate_series(harmonics, t);
+}
+
+} // namespace macrocirculation
@@ -0,0 +1,110 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_IMPEDANCE_SOLVER_HPP
+#define TUMORMODELS_IMPEDANCE_SOLVER_HPP
+
+#include <complex>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace macrocirculation {
+
+// forward declarations
+class GraphStorage;
+class Edge;
+class Vertex;
+struct PhysicalData;
+
+/*! @brief The input impedance of a vessel of the linearized model for the angular frequency omega, which is closed by the impedance Z_load at its other end. */
+std::complex<double> calculate_vessel_input_impedance(const PhysicalData &param, double omega, std::complex<double> Z_load);
+
+/*! @brief The impedance of the outflow model at a leaf towards its outflow pressure for the angular frequency omega,
+ *         where param is the physical data of the vessel at the leaf.
+ *         The windkessel, vessel tree and rcl models are coupled by the characteristic resistance R1 of the vessel,
+ *         and a free outflow is only this resistance.
+ */
+std::complex<double> calculate_outflow_impedance(const Vertex &vertex, const PhysicalData &param, double omega);
+
+/*! @brief Calculates the periodic pressures and flows of the linearized flow model in the frequency domain,
+ *         e.g. as a quick estimate of the pulse waves for a calibration of the compliances or a what-if study.
+ *
+ *  Every vessel is a transmission line with the series impedance z = L R + i omega L and the shunt admittance y = i omega C per length,
+ *  where L, C and R are the coefficients of the linearized model, see linear::get_L, linear::get_C and linear::get_R.
+ *  The windkessel, vessel tree and rcl outflows are the impedances of their 0D models in series with their input resistance R1,
+ *  and a free outflow is the characteristic impedance of its vessel.
+ *  The inflows are expanded into a fourier series over the given period, and every harmonic is a single complex sparse solve for the vertex pressures.
+ *
+ *  The network is small compared to the 1D model, hence every rank solves all of it without any communication.
+ */
+class ImpedanceSolver {
+public:
+  using Complex = std::complex<double>;
+
+  ImpedanceSolver(std::shared_ptr<GraphStorage> graph, double period, std::size_t num_harmonics);
+
+  /*! @brief Solves for the harmonics 0, ..., num_harmonics of all the pressures and flows. */
+  void solve();
+
+  std::size_t get_num_harmonics() const { return d_num_harmonics; }
+
+  /*! @brief The angular frequency 2 pi k / period of the k-th harmonic. */
+  double get_angular_frequency(std::size_t k) const;
+
+  /*! @brief The input impedance of the network at the given inflow vertex for the angular frequency omega,
+   *         i.e. the pressure for a unit flow into the network, while the other inflows keep their pressure or flow at zero.
+   */
+  Complex calculate_input_impedance(std::size_t vertex_id, double omega) const;
+
+  /*! @brief The k-th fourier coefficient of the pressure at the given vertex. */
+  Complex get_pressure_harmonic(std::size_t vertex_id, std::size_t k) const { return d_p[k][vertex_id]; }
+
+  /*! @brief The k-th fourier coefficient of the flow at the start of the given edge in its direction. */
+  Complex get_flow_harmonic(std::size_t edge_id, std::size_t k) const { return d_Q[k][edge_id]; }
+
+  /*! @brief The pressure at the given vertex and time. */
+  double get_pressure(std::size_t vertex_id, double t) const;
+
+  /*! @brief The pressure at the relative position s in [0,1] along the given edge and the given time. */
+  double get_pressure(const Edge &edge, double s, double t) const;
+
+  /*! @brief The flow at the relative position s in [0,1] along the given edge in its direction and the given time. */
+  double get_flow(const Edge &edge, double s, double t) const;
+
+private:
+  std::shared_ptr<GraphStorage> d_graph;
+
+  double d_period;
+
+  std::size_t d_num_harmonics;
+
+  /*! @brief The fourier coefficients of the inflow functions, indexed by the harmonic and the vertex id. */
+  std::vector<std::vector<Complex>> d_inflows;
+
+  /*! @brief The pressure harmonics indexed by the harmonic and the vertex id. */
+  std::vector<std::vector<Complex>> d_p;
+
+  /*! @brief The flow harmonics at the start of the edges indexed by the harmonic and the edge id. */
+  std::vector<std::vector<Complex>> d_Q;
+
+  static constexpr std::size_t no_vertex = std::numeric_limits<std::size_t>::max();
+
+  /*! @brief Solves the network for the angular frequency omega and returns the vertex pressures.
+   *
+   * @param sources           The flows at the flow inflows, the pressures at the pressure inflows and the outflow pressures at the 0D outflows, indexed by the vertex id.
+   * @param driven_vertex_id  An inflow vertex whose source is a flow, even if it prescribes the pressure, or no_vertex.
+   */
+  std::vector<Complex> solve_for_frequency(double omega, const std::vector<Complex> &sources, std::size_t driven_vertex_id) const;
+
+  /*! @brief Reconstructs the real signal at time t from its harmonics. */
+  double evaluate_series(const std::vector<Complex> &harmonics, double t) const;
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_IMPEDANCE_SOLVER_HPP
@@ -0,0 +1,428 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "implicit_linear_flow_solver.hpp"
+
+#include <Eigen/Sparse>
+#include <Eigen/SparseLU>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+#include "communication/mpi.hpp"
+#include "dof_map.hpp"
+#include "fe_type.hpp"
+#include "graph_storage.hpp"
+#include "vessel_formulas.hpp"
+
+namespace macrocirculation {
+
+namespace {
+
+using Triplet = Eigen::Triplet<double>;
+using SparseMatrix = Eigen::SparseMatrix<double>;
+
+/*! @brief A linear combination of dofs, given by pairs of the global dof index and the coefficient. */
+using LinearForm = std::vector<std::pair<std::size_t, double>>;
+
+/*! @brief The end of a micro edge at a vertex or at an inner micro vertex. */
+struct JunctionEnd {
+  /*! @brief The global indices of the first basis functions of p and q on the micro edge. */
+  std::size_t p_dof;
+  std::size_t q_dof;
+
+  std::size_t num_basis_functions;
+
+  /*! @brief The values of the basis functions at the end. */
+  std::array<double, max_fe_degree + 1> phi;
+
+  /*! @brief +1 if the micro edge points towards the junction, -1 otherwise. */
+  double sigma;
+
+  /*! @brief The characteristic impedance sqrt(L/C) of the edge. */
+  double Z;
+
+  /*! @brief Only the rows of the owned edges are assembled. */
+  bool owned;
+};
+
+double impedance(const PhysicalData &param) {
+  return std::sqrt(linear::get_L(param) / linear::get_C(param));
+}
+
+JunctionEnd create_junction_end(const LocalEdgeDofMap &local_dof_map, std::size_t micro_edge_id, bool pointing_to, const PhysicalData &param, bool owned) {
+  JunctionEnd end{};
+  end.p_dof = local_dof_map.first_dof(micro_edge_id, ImplicitLinearFlowSolver::p_component);
+  end.q_dof = local_dof_map.first_dof(micro_edge_id, ImplicitLinearFlowSolver::q_component);
+  end.num_basis_functions = local_dof_map.num_basis_functions();
+  // the shape functions are legendre polynomials, which are +/-1 at the boundaries of the reference interval
+  const auto phi = evaluate_legendre(pointing_to ? 1. : -1.);
+  std::copy(phi.begin(), phi.end(), end.phi.begin());
+  end.sigma = pointing_to ? +1. : -1.;
+  end.Z = impedance(param);
+  end.owned = owned;
+  return end;
+}
+
+JunctionEnd create_junction_end(const DofMap &dof_map, const Edge &edge, std::size_t vertex_id, bool owned) {
+  const auto &local_dof_map = dof_map.get_local_dof_map(edge);
+  const bool pointing_to = edge.is_pointing_to(vertex_id);
+  const std::size_t micro_edge_id = pointing_to ? local_dof_map.num_micro_edges() - 1 : 0;
+  return create_junction_end(local_dof_map, micro_edge_id, pointing_to, edge.get_physical_data(), owned);
+}
+
+/*! @brief Returns the characteristic W = p + sigma Z q, which leaves the edge at the junction. */
+LinearForm outgoing_characteristic(const JunctionEnd &end) {
+  LinearForm W;
+  for (std::size_t j = 0; j < end.num_basis_functions; j += 1) {
+    W.emplace_back(end.p_dof + j, end.phi[j]);
+    W.emplace_back(end.q_dof + j, end.sigma * end.Z * end.phi[j]);
+  }
+  return W;
+}
+
+/*! @brief Adds the boundary terms of the end to its rows for the given upwinded pressure p*.
+ *
+ *  The flow into the junction is given by (W - p*) / Z, such that
+ *  the p rows get the terms (W - p*) / Z phi_i and the q rows get the terms sigma p* phi_i.
+ */
+void add_flux_rows(const JunctionEnd &end, const LinearForm &W, const LinearForm &p_star, std::vector<Triplet> &triplets) {
+  for (std::size_t i = 0; i < end.num_basis_functions; i += 1) {
+    const auto p_row = static_cast<Eigen::Index>(end.p_dof + i);
+    const auto q_row = static_cast<Eigen::Index>(end.q_dof + i);
+    for (const auto &[col, value] : W)
+      triplets.emplace_back(p_row, static_cast<Eigen::Index>(col), end.phi[i] * value / end.Z);
+    for (const auto &[col, value] : p_star) {
+      triplets.emplace_back(p_row, static_cast<Eigen::Index>(col), -end.phi[i] * value / end.Z);
+      triplets.emplace_back(q_row, static_cast<Eigen::Index>(col), end.sigma * end.phi[i] * value);
+    }
+  }
+}
+
+/*! @brief Returns the right-hand side coefficients for a boundary value g, which enters p* = ... + c g. */
+std::vector<std::pair<std::size_t, double>> flux_source_rows(const JunctionEnd &end, double c) {
+  std::vector<std::pair<std::size_t, double>> rows;
+  for (std::size_t i = 0; i < end.num_basis_functions; i += 1) {
+    rows.emplace_back(end.p_dof + i, end.phi[i] * c / end.Z);
+    rows.emplace_back(end.q_dof + i, -end.sigma * end.phi[i] * c);
+  }
+  return rows;
+}
+
+void scale_and_append(const LinearForm &form, double factor, LinearForm &out) {
+  for (const auto &[col, value] : form)
+    out.emplace_back(col, factor * value);
+}
+
+/*! @brief Couples the ends by the continuity of the pressure and the conservation of the flow. */
+void assemble_inner_junction(const std::vector<JunctionEnd> &ends, std::vector<Triplet> &triplets) {
+  double sum_admittance = 0;
+  for (const auto &end : ends)
+    sum_admittance += 1. / end.Z;
+
+  // p* is the mean of the outgoing characteristics weighted by the admittances
+  LinearForm p_star;
+  for (const auto &end : ends)
+    scale_and_append(outgoing_characteristic(end), 1. / end.Z / sum_admittance, p_star);
+
+  for (const auto &end : ends)
+    if (end.owned)
+      add_flux_rows(end, outgoing_characteristic(end), p_star, triplets);
+}
+
+/*! @brief Returns the characteristic impedance of the model on the other side of a characteristic inflow. */
+double characteristic_inflow_impedance(const Vertex &vertex) {
+  if (vertex.is_linear_characteristic_inflow()) {
+    const auto &data = vertex.get_linear_characteristic_data();
+    return std::sqrt(data.L / data.C);
+  }
+  return calculate_R1(vertex.get_nonlinear_characteristic_data());
+}
+
+/*! @brief Gathers the triplets of all the ranks. */
+std::vector<Triplet> allgather_triplets(MPI_Comm comm, const std::vector<Triplet> &triplets) {
+  std::vector<unsigned long long> rows;
+  std::vector<unsigned long long> cols;
+  std::vector<double> values;
+  for (const auto &t : triplets) {
+    rows.push_back(static_cast<unsigned long long>(t.row()));
+    cols.push_back(static_cast<unsigned long long>(t.col()));
+    values.push_back(t.value());
+  }
+
+  const int num_local = static_cast<int>(triplets.size());
+  std::vector<int> counts(static_cast<std::size_t>(mpi::size(comm)), 0);
+  CHECK_MPI_SUCCESS(MPI_Allgather(&num_local, 1, MPI_INT, counts.data(), 1, MPI_INT, comm));
+  std::vector<int> displacements(counts.size(), 0);
+  std::partial_sum(counts.begin(), counts.end() - 1, displacements.begin() + 1);
+  const auto num_total = static_cast<std::size_t>(displacements.back() + counts.back());
+
+  std::vector<unsigned long long> all_rows(num_total);
+  std::vector<unsigned long long> all_cols(num_total);
+  std::vector<double> all_values(num_total);
+  CHECK_MPI_SUCCESS(MPI_Allgatherv(rows.data(), num_local, MPI_UNSIGNED_LONG_LONG, all_rows.data(), counts.data(), displacements.data(), MPI_UNSIGNED_LONG_LONG, comm));
+  CHECK_MPI_SUCCESS(MPI_Allgatherv(cols.data(), num_local, MPI_UNSIGNED_LONG_LONG, all_cols.data(), counts.data(), displacements.data(), MPI_UNSIGNED_LONG_LONG, comm));
+  CHECK_MPI_SUCCESS(MPI_Allgatherv(values.data(), num_local, MPI_DOUBLE, all_values.data(), counts.data(), displacements.data(), MPI_DOUBLE, comm));
+
+  std::vector<Triplet> result;
+  result.reserve(num_total);
+  for (std::size_t k = 0; k < num_total; k += 1)
+    result.emplace_back(static_cast<Eigen::Index>(all_rows[k]), static_cast<Eigen::Index>(all_cols[k]), all_values[k]);
+  return result;
+}
+
+} // namespace
+
+struct ImplicitLinearFlowSolver::LinearSystem {
+  /*! @brief The mass rows of this rank, which yield the right-hand side of this rank. */
+  SparseMatrix owned_mass;
+
+  /*! @brief The mass and the remaining operator of all the ranks. */
+  SparseMatrix mass;
+  SparseMatrix op;
+
+  /*! @brief The factorization of mass / tau + op. */
+  Eigen::SparseLU<SparseMatrix> lu;
+};
+
+ImplicitLinearFlowSolver::ImplicitLinearFlowSolver(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, std::shared_ptr<DofMap> dof_map, std::size_t degree)
+    : d_comm(comm),
+      d_graph(std::move(graph)),
+      d_dof_map(std::move(dof_map)),
+      d_degree(degree),
+      d_system(std::make_unique<LinearSystem>()),
+      d_tau(0),
+      d_u(d_dof_map->num_dof(), 0),
+      d_rhs(d_dof_map->num_dof(), 0) {
+  unsigned long long num_owned_dofs = d_dof_map->num_owned_dofs();
+  CHECK_MPI_SUCCESS(MPI_Allreduce(MPI_IN_PLACE, &num_owned_dofs, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, d_comm));
+  if (num_owned_dofs != d_dof_map->num_dof())
+    throw std::runtime_error("the implicit linear flow solver needs a dof map with a global numbering.");
+
+  assemble();
+}
+
+ImplicitLinearFlowSolver::~ImplicitLinearFlowSolver() = default;
+
+std::shared_ptr<DofMap> ImplicitLinearFlowSolver::create_dof_map(MPI_Comm comm, const GraphStorage &graph, std::size_t degree) {
+  auto dof_map = std::make_shared<DofMap>(graph.num_vertices(), graph.num_edges());
+  dof_map->create(comm, graph, 2, degree, true);
+  return dof_map;
+}
+
+void ImplicitLinearFlowSolver::assemble() {
+  const auto rank = mpi::rank(d_comm);
+  const auto num_dof = static_cast<Eigen::Index>(d_dof_map->num_dof());
+
+  std::vector<Triplet> mass_triplets;
+  std::vector<Triplet> op_triplets;
+
+  // the cells and the inner micro vertices of the owned edges
+  for (const auto &e_id : d_graph->get_active_edge_ids(rank)) {
+    const auto &edge = d_graph->edge(e_id);
+    const auto &param = edge.get_physical_data();
+    const auto &local_dof_map = d_dof_map->get_local_dof_map(edge);
+    const std::size_t num_basis_functions = local_dof_map.num_basis_functions();
+
+    const double C = linear::get_C(param);
+    const double L = linear::get_L(param);
+    const double R = linear::get_R(param);
+
+    FETypeNetwork fe(create_gauss_for_degree(num_basis_functions - 1), num_basis_functions - 1);
+    const auto &phi = fe.get_phi();
+    const auto &dphi = fe.get_dphi();
+    const auto &JxW = fe.get_JxW();
+
+    const auto lengths = edge.get_micro_edge_lengths();
+    for (std::size_t m = 0; m < local_dof_map.num_micro_edges(); m += 1) {
+      fe.reinit(lengths[m]);
+
+      const auto p_dof = static_cast<Eigen::Index>(local_dof_map.first_dof(m, p_component));
+      const auto q_dof = static_cast<Eigen::Index>(local_dof_map.first_dof(m, q_component));
+
+      for (std::size_t i = 0; i < num_basis_functions; i += 1) {
+        for (std::size_t j = 0; j < num_basis_functions; j += 1) {
+          // the mass and the integral of phi_j against the derivative of phi_i
+          double mass = 0;
+          double transport = 0;
+          for (std::size_t qp = 0; qp < fe.num_quad_points(); qp += 1) {
+            mass += phi[i][qp] * phi[j][qp] * JxW[qp];
+            transport += phi[j][qp] * dphi[i][qp] * JxW[qp];
+          }
+
+          const auto row = static_cast<Eigen::Index>(i);
+          const auto col = static_cast<Eigen::Index>(j);
+          mass_triplets.emplace_back(p_dof + row, p_dof + col, C * mass);
+          mass_triplets.emplace_back(q_dof + row, q_dof + col, L * mass);
+          op_triplets.emplace_back(p_dof + row, q_dof + col, -transport);
+          op_triplets.emplace_back(q_dof + row, p_dof + col, -transport);
+          op_triplets.emplace_back(q_dof + row, q_dof + col, L * R * mass);
+        }
+      }
+    }
+
+    for (std::size_t m = 1; m < local_dof_map.num_micro_edges(); m += 1) {
+      const std::vector<JunctionEnd> ends{create_junction_end(local_dof_map, m - 1, true, param, true),
+                                          create_junction_end(local_dof_map, m, false, param, true)};
+      assemble_inner_junction(ends, op_triplets);
+    }
+  }
+
+  // the vertices at the owned edges
+  d_sources.clear();
+  for (const auto &v_id : d_graph->get_active_and_connected_vertex_ids(rank)) {
+    const auto &vertex = d_graph->vertex(v_id);
+
+    if (!vertex.is_leaf()) {
+      std::vector<JunctionEnd> ends;
+      for (const auto &adjacent_edge : d_graph->adjacent_edges(v_id)) {
+        const auto &edge = d_graph->edge(adjacent_edge.edge_id);
+        ends.push_back(create_junction_end(*d_dof_map, edge, v_id, edge.rank() == rank));
+      }
+      assemble_inner_junction(ends, op_triplets);
+      continue;
+    }
+
+    // the leaves are assembled by the rank of their edge, which also owns the dofs of the 0D models
+    const auto &edge = d_graph->edge(vertex.get_edge_neighbors()[0]);
+    if (edge.rank() != rank)
+      continue;
+
+    const auto end = create_junction_end(*d_dof_map, edge, v_id, true);
+    const auto W = outgoing_characteristic(end);
+
+    LinearForm p_star;
+    if (vertex.is_inflow_with_fixed_flow()) {
+      // the flow Q_in into the network yields p* = W + Z Q_in
+      p_star = W;
+      d_sources.push_back({v_id, flux_source_rows(end, end.Z)});
+    } else if (vertex.is_inflow_with_fixed_pressure()) {
+      d_sources.push_back({v_id, flux_source_rows(end, 1.)});
+    } else if (vertex.is_free_outflow()) {
+      // no characteristic enters the edge
+      scale_and_append(W, 0.5, p_star);
+    } else if (vertex.is_windkessel_outflow()) {
+      // the characteristic resistance R1 = Z is in front of the compliance with the pressure p_c
+      const auto p_c_dof = d_dof_map->get_local_dof_map(vertex).first_dof();
+      const auto &data = vertex.get_peripheral_vessel_data();
+      const double R2 = data.resistance - end.Z;
+      scale_and_append(W, 0.5, p_star);
+      p_star.emplace_back(p_c_dof, 0.5);
+
+      // C dp_c/dt = (W - p_c) / (2 Z) - (p_c - p_out) / R2
+      const auto row = static_cast<Eigen::Index>(p_c_dof);
+      mass_triplets.emplace_back(row, row, data.compliance);
+      op_triplets.emplace_back(row, row, 1. / R2 + 0.5 / end.Z);
+      for (const auto &[col, value] : W)
+        op_triplets.emplace_back(row, static_cast<Eigen::Index>(col), -0.5 * value / end.Z);
+      d_sources.push_back({v_id, {{p_c_dof, 1. / R2}}});
+    } else if (vertex.is_linear_characteristic_inflow() || vertex.is_nonlinear_characteristic_inflow()) {
+      // the other model is upwinded like a second edge with its outgoing characteristic W_o as the boundary value
+      const double Z_o = characteristic_inflow_impedance(vertex);
+      const double sum_admittance = 1. / end.Z + 1. / Z_o;
+      scale_and_append(W, 1. / end.Z / sum_admittance, p_star);
+      d_sources.push_back({v_id, flux_source_rows(end, 1. / Z_o / sum_admittance)});
+    } else {
+      throw std::runtime_error("undefined boundary type for the implicit linear flow solver (vertex name = " + vertex.get_name() + ")");
+    }
+
+    add_flux_rows(end, W, p_star, op_triplets);
+  }
+
+  d_system->owned_mass.resize(num_dof, num_dof);
+  d_system->owned_mass.setFromTriplets(mass_triplets.begin(), mass_triplets.end());
+
+  const auto all_mass_triplets = allgather_triplets(d_comm, mass_triplets);
+  d_system->mass.resize(num_dof, num_dof);
+  d_system->mass.setFromTriplets(all_mass_triplets.begin(), all_mass_triplets.end());
+
+  const auto all_op_triplets = allgather_triplets(d_comm, op_triplets);
+  d_system->op.resize(num_dof, num_dof);
+  d_system->op.setFromTriplets(all_op_triplets.begin(), all_op_triplets.end());
+}
+
+void ImplicitLinearFlowSolver::factorize(double tau) {
+  const SparseMatrix A = d_system->mass / tau + d_system->op;
+  d_system->lu.compute(A);
+  if (d_system->lu.info() != Eigen::Success)
+    throw std::runtime_error("the matrix of the implicit linear flow solver could not be factorized.");
+  d_tau = tau;
+}
+
+double ImplicitLinearFlowSolver::source_value(const Vertex &v, double t) const {
+  if (v.is_inflow_with_fixed_flow() || v.is_inflow_with_fixed_pressure())
+    return v.get_inflow_value(t);
+  if (v.is_windkessel_outflow())
+    return v.get_peripheral_vessel_data().p_out;
+  // the outgoing characteristic of the other model, where q is the flow into the vertex
+  const double Z_o = characteristic_inflow_impedance(v);
+  if (v.is_linear_characteristic_inflow()) {
+    const auto &data = v.get_linear_characteristic_data();
+    return data.p + Z_o * data.q;
+  }
+  const auto &data = v.get_nonlinear_characteristic_data();
+  return data.p + Z_o * data.q;
+}
+
+void ImplicitLinearFlowSolver::solve(double tau, double t) {
+  if (tau != d_tau)
+    factorize(tau);
+
+  // the right-hand side of the owned rows, which are summed over all the ranks
+  Eigen::Map<Eigen::VectorXd> rhs(d_rhs.data(), static_cast<Eigen::Index>(d_rhs.size()));
+  Eigen::Map<Eigen::VectorXd> u(d_u.data(), static_cast<Eigen::Index>(d_u.size()));
+  rhs = d_system->owned_mass * u / tau;
+
+  for (const auto &source : d_sources) {
+    const double value = source_value(d_graph->vertex(source.vertex_id), t + tau);
+    for (const auto &[row, coefficient] : source.rows)
+      d_rhs[row] += coefficient * value;
+  }
+
+  CHECK_MPI_SUCCESS(MPI_Allreduce(MPI_IN_PLACE, d_rhs.data(), static_cast<int>(d_rhs.size()), MPI_DOUBLE, MPI_SUM, d_comm));
+
+  u = d_system->lu.solve(rhs);
+}
+
+const std::vector<double> &ImplicitLinearFlowSolver::get_solution() const { return d_u; }
+
+void ImplicitLinearFlowSolver::get_1d_pq_values_at_vertex(const Vertex &v, double &p, double &q) const {
+  const auto &edge = d_graph->edge(v.get_edge_neighbors()[0]);
+  evaluate_1d_pq_values(edge, edge.is_pointing_to(v.get_id()) ? 1. : 0., p, q);
+}
+
+void ImplicitLinearFlowSolver::evaluate_1d_pq_values(const Edge &e, double s, double &p, double &q) const {
+  const auto &local_dof_map = d_dof_map->get_local_dof_map(e);
+
+  // search the micro edge containing s, where the points between two micro edges belong to the left one
+  const auto lengths = e.get_micro_edge_lengths();
+  const double length = std::accumulate(lengths.begin(), lengths.end(), 0.);
+  double s_left = 0;
+  std::size_t micro_edge_id = 0;
+  while (micro_edge_id + 1 < lengths.size() && s_left + lengths[micro_edge_id] / length < s) {
+    s_left += lengths[micro_edge_id] / length;
+    micro_edge_id += 1;
+  }
+  const double h = lengths[micro_edge_id] / length;
+  const double s_tilde = std::max(-1., std::min(1., 2 * (s - s_left) / h - 1));
+
+  const auto phi = evaluate_legendre(s_tilde);
+  p = 0;
+  q = 0;
+  for (std::size_t j = 0; j < local_dof_map.num_basis_functions(); j += 1) {
+    p += phi[j] * d_u[local_dof_map.first_dof(micro_edge_id, p_component) + j];
+    q += phi[j] * d_u[local_dof_map.first_dof(micro_edge_id, q_component) + j];
+  }
+}
+
+std::shared_ptr<DofMap> ImplicitLinearFlowSolver::get_dof_map() const { return d_dof_map; }
+
+size_t ImplicitLinearFlowSolver::get_degree() const { return d_degree; }
+
+} // namespace macrocirculation
@@ -0,0 +1,112 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_IMPLICIT_LINEAR_FLOW_SOLVER_HPP
+#define TUMORMODELS_IMPLICIT_LINEAR_FLOW_SOLVER_HPP
+
+#include <cstddef>
+#include <memory>
+#include <mpi.h>
+#include <utility>
+#include <vector>
+
+namespace macrocirculation {
+
+// forward declarations
+class GraphStorage;
+class DofMap;
+class Edge;
+class Vertex;
+
+/*! @brief Solves the linearized flow equations
+ *           C p_t + q_z = 0,
+ *           L q_t + p_z = - L R q,
+ *         with an implicit euler method, such that the time step is not restricted by the wave speed.
+ *
+ *  The equations are discretized with the same DG method as the nonlinear model, and the upwinded values at the vertices
+ *  are given by the characteristics p -/+ sqrt(L/C) q. Hence, the whole scheme is linear and its matrix only depends on the time step.
+ *  Every rank assembles the rows of its edges with the global numbering of the dof map.
+ *  The rows of all the ranks are gathered and factorized once, such that every step only needs a reduction of the right-hand side
+ *  and a redundant solve on every rank. This is meant for small networks, e.g. of peripheral vessels,
+ *  which are coupled to the nonlinear model by characteristic inflows.
+ */
+class ImplicitLinearFlowSolver {
+public:
+  /*! @brief The components of the solution on the edges. */
+  static const size_t p_component = 0;
+  static const size_t q_component = 1;
+
+  /*! @brief Constructs the solver.
+   *
+   * @param comm     The communicator.
+   * @param graph    The graph with finalized boundary conditions, which is partitioned already.
+   * @param dof_map  A dof map with two components and a global numbering, see create_dof_map.
+   * @param degree   The degree of the shape functions, which the dof map was created with.
+   */
+  ImplicitLinearFlowSolver(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, std::shared_ptr<DofMap> dof_map, std::size_t degree);
+
+  ~ImplicitLinearFlowSolver();
+
+  /*! @brief Creates a dof map with the global numbering, which the solver needs. */
+  static std::shared_ptr<DofMap> create_dof_map(MPI_Comm comm, const GraphStorage &graph, std::size_t degree);
+
+  /*! @brief Advances the solution from t to t + tau. The matrix is only factorized again if tau changed. */
+  void solve(double tau, double t);
+
+  /*! @brief Returns the solution with the global numbering, which is known on every rank. */
+  const std::vector<double> &get_solution() const;
+
+  void get_1d_pq_values_at_vertex(const Vertex &v, double &p, double &q) const;
+
+  /*! @brief Evaluates p and q on the edge at the parametrization s in [0, 1]. Works for the owned and the ghost edges. */
+  void evaluate_1d_pq_values(const Edge &e, double s, double &p, double &q) const;
+
+  std::shared_ptr<DofMap> get_dof_map() const;
+
+  size_t get_degree() const;
+
+private:
+  /*! @brief The sparse matrices and their factorization, which keep Eigen out of this header. */
+  struct LinearSystem;
+
+  /*! @brief A value of a boundary condition, which is added to the right-hand side with fixed coefficients. */
+  struct BoundarySource {
+    std::size_t vertex_id;
+    std::vector<std::pair<std::size_t, double>> rows;
+  };
+
+  MPI_Comm d_comm;
+
+  std::shared_ptr<GraphStorage> d_graph;
+
+  std::shared_ptr<DofMap> d_dof_map;
+
+  std::size_t d_degree;
+
+  std::unique_ptr<LinearSystem> d_system;
+
+  std::vector<BoundarySource> d_sources;
+
+  /*! @brief The time step of the factorized matrix, which is zero before the first step. */
+  double d_tau;
+
+  std::vector<double> d_u;
+
+  std::vector<double> d_rhs;
+
+  /*! @brief Assembles the mass and the remaining operator in the rows of this rank. */
+  void assemble();
+
+  void factorize(double tau);
+
+  /*! @brief Returns the boundary value at the given vertex, which enters the right-hand side. */
+  double source_value(const Vertex &v, double t) const;
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_IMPLICIT_LINEAR_FLOW_SOLVER_HPP
@@ -11,6 +11,7 @@
 #include "dof_map.hpp"
 #include "fe_type.hpp"
 #include "graph_storage.hpp"
+#include "interpolation_plan.hpp"
 
 namespace macrocirculation {
 
@@ -41,50 +42,9 @@ void interpolate_to_vertices(const MPI_Comm comm,
                              const std::vector<double> &dof_vector,
                              std::vector<Point> &points,
                              std::vector<double> &interpolated) {
-  points.clear();
-  interpolated.clear();
-
-  std::vector<std::size_t> dof_indices;
-  std::vector<double> dof_vector_local;
-  std::vector<double> evaluated_at_qps;
-
-  for (auto e_id : graph.get_active_edge_ids(mpi::rank(comm))) {
-    auto edge = graph.get_edge(e_id);
-
-    // we only write out embedded vessel segments
-    if (!edge->has_embedding_data())
-      continue;
-    const auto &embedding = edge->get_embedding_data();
-
-    auto local_dof_map = map.get_local_dof_map(*edge);
-
-    if (embedding.points.size() == 2 && local_dof_map.num_micro_edges() > 1)
-      linear_interpolate_points(embedding.points[0], embedding.points[1], local_dof_map.num_micro_edges(), points);
-    else if (embedding.points.size() == local_dof_map.num_micro_edges() + 1)
-      add_discontinuous_points(embedding.points, points);
-    else
-      throw std::runtime_error("this type of embedding is not implemented");
-
-    FETypeNetwork fe(create_trapezoidal_rule(), local_dof_map.num_basis_functions() - 1);
-
-    dof_indices.resize(local_dof_map.num_basis_functions());
-    dof_vector_local.resize(local_dof_map.num_basis_functions());
-    evaluated_at_qps.resize(fe.num_quad_points());
-
-    const auto &param = edge->get_physical_data();
-    const double h = param.length / local_dof_map.num_micro_edges();
-
-    fe.reinit(h);
-
-    for (std::size_t micro_edge_id = 0; micro_edge_id < local_dof_map.num_micro_edges(); micro_edge_id += 1) {
-      local_dof_map.dof_indices(micro_edge_id, component, dof_indices);
-      extract_dof(dof_indices, dof_vector, dof_vector_local);
-      const auto boundary_values = fe.evaluate_dof_at_boundary_points(dof_vector_local);
-
-      interpolated.push_back(boundary_values.left);
-      interpolated.push_back(boundary_values.right);
-    }
-  }
+  const InterpolationPlan plan(comm, graph, map);
+  plan.interpolate(component, dof_vector, interpolated);
+  points = plan.get_points();
 }
 
 void fill_with_radius(const MPI_Comm comm, const GraphStorage &graph, std::vector<Point> &points, std::vector<double> &interpolated) {
@@ -131,23 +91,23 @@ void fill_with_edge_parameter(const MPI_Comm comm, const GraphStorage &graph, st
   std::vector<double> evaluated_at_qps;
 
   for (auto e_id : graph.get_active_edge_ids(mpi::rank(comm))) {
-    auto edge = graph.get_edge(e_id);
+    auto &edge = graph.edge(e_id);
 
     // we only write out embedded vessel segments
-    if (!edge->has_embedding_data())
+    if (!edge.has_embedding_data())
       continue;
-    const auto &embedding = edge->get_embedding_data();
+    const auto &embedding = edge.get_embedding_data();
 
-    if (embedding.points.size() == 2 && edge->num_micro_edges() > 1)
-      linear_interpolate_points(embedding.points[0], embedding.points[1], edge->num_micro_edges(), points);
-    else if (embedding.points.size() == edge->num_micro_edges() + 1)
+    if (embedding.points.size() == 2 && edge.num_micro_edges() > 1)
+      linear_interpolate_points(embedding.points[0], embedding.points[1], edge.num_micro_edges(), points);
+    else if (embedding.points.size() == edge.num_micro_edges() + 1)
       add_discontinuous_points(embedding.points, points);
     else
       throw std::runtime_error("this type of embedding is not implemented");
 
-    const double quantity = extractor(*edge);
+    const double quantity = extractor(edge);
 
-    for (std::size_t micro_edge_id = 0; micro_edge_id < edge->num_micro_edges(); micro_edge_id += 1) {
+    for (std::size_t micro_edge_id = 0; micro_edge_id < edge.num_micro_edges(); micro_edge_id += 1) {
       interpolated.push_back(quantity);
       interpolated.push_back(quantity);
     }
@@ -163,22 +123,22 @@ void fill_with_edge_parameter(const MPI_Comm comm, const GraphStorage &graph, co
   std::vector<double> evaluated_at_qps;
 
   for (auto e_id : graph.get_active_edge_ids(mpi::rank(comm))) {
-    auto edge = graph.get_edge(e_id);
+    auto &edge = graph.edge(e_id);
 
     // we only write out embedded vessel segments
-    if (!edge->has_embedding_data())
+    if (!edge.has_embedding_data())
       continue;
-    const auto &embedding = edge->get_embedding_data();
+    const auto &embedding = edge.get_embedding_data();
 
-    if (embedding.points.size() == 2 && edge->num_micro_edges() > 1)
-      linear_interpolate_points(embedding.points[0], embedding.points[1], edge->num_micro_edges(), points);
-    else if (embedding.points.size() == edge->num_micro_edges() + 1)
+    if (embedding.points.size() == 2 && edge.num_micro_edges() > 1)
+      linear_interpolate_points(embedding.points[0], embedding.points[1], edge.num_micro_edges(), points);
+    else if (embedding.points.size() == edge.num_micro_edges() + 1)
       add_discontinuous_points(embedding.points, points);
     else
       throw std::runtime_error("this type of embedding is not implemented");
 
-    for (std::size_t micro_edge_id = 0; micro_edge_id < edge->num_micro_edges(); micro_edge_id += 1) {
-      const double quantity = extractor(*edge, micro_edge_id);
+    for (std::size_t micro_edge_id = 0; micro_edge_id < edge.num_micro_edges(); micro_edge_id += 1) {
+      const double quantity = extractor(edge, micro_edge_id);
       interpolated.push_back(quantity);
       interpolated.push_back(quantity);
     }
@@ -26,6 +26,7 @@ void linear_interpolate_points(const Point &left,
                                std::size_t num_micro_edges,
                                std::vector<Point> &points);
 
+/*! @brief Evaluates a component at the endpoints of the micro edges, see InterpolationPlan for repeated evaluations. */
 void interpolate_to_vertices(MPI_Comm comm,
                              const GraphStorage &graph,
                              const DofMap &map,
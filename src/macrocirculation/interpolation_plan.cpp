@@ -0,0 +1,108 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "interpolation_plan.hpp"
+
+#include <cmath>
+#include <stdexcept>
+
+#include "communication/mpi.hpp"
+#include "explicit_nonlinear_flow_solver.hpp"
+#include "vessel_formulas.hpp"
+
+namespace macrocirculation {
+
+InterpolationPlan::InterpolationPlan(MPI_Comm comm, const GraphStorage &graph, const DofMap &map, const OutputResolution &resolution) {
+  for (auto e_id : graph.get_active_edge_ids(mpi::rank(comm))) {
+    const auto &edge = graph.edge(e_id);
+
+    // we only write out embedded vessel segments
+    if (!edge.has_embedding_data())
+      continue;
+
+    EdgeEntry entry{e_id, map.get_local_dof_map(edge), EdgeSampler(edge, resolution), edge.has_physical_data(), 0, 0, 0, 0};
+    entry.sampler.add_points(edge, d_points);
+    if (entry.has_physical_data) {
+      const auto &param = edge.get_physical_data();
+      entry.G0 = param.G0;
+      entry.A0 = param.A0;
+      entry.rho = param.rho;
+      entry.c0 = param.get_c0();
+    }
+    d_edges.push_back(std::move(entry));
+  }
+}
+
+void InterpolationPlan::fill_with_vessel_id(std::vector<double> &vessel_ids) const {
+  vessel_ids.clear();
+  vessel_ids.reserve(size());
+  for (const auto &entry : d_edges)
+    vessel_ids.insert(vessel_ids.end(), entry.sampler.size(), static_cast<double>(entry.edge_id));
+}
+
+void InterpolationPlan::interpolate(std::size_t component, const std::vector<double> &dof_vector, std::vector<double> &interpolated) const {
+  interpolated.resize(size());
+
+  std::size_t idx = 0;
+  for (const auto &entry : d_edges) {
+    for (std::size_t k = 0; k < entry.sampler.size(); k += 1, idx += 1)
+      interpolated[idx] = entry.sampler.evaluate(entry.local_dof_map, dof_vector, component, k);
+  }
+}
+
+void InterpolationPlan::evaluate(const std::vector<double> &dof_vector, InterpolatedFlowFields &fields) const {
+  fields.Q.resize(size());
+  fields.A.resize(size());
+  fields.p_static.resize(size());
+  fields.p_total.resize(size());
+  fields.velocity.resize(size());
+
+  std::size_t idx = 0;
+  for (const auto &entry : d_edges) {
+    if (!entry.has_physical_data)
+      throw std::runtime_error("cannot evaluate the pressures on edges without physical parameters");
+
+    for (std::size_t k = 0; k < entry.sampler.size(); k += 1, idx += 1) {
+      const double Q = entry.sampler.evaluate(entry.local_dof_map, dof_vector, ExplicitNonlinearFlowSolver::Q_component, k);
+      const double A = entry.sampler.evaluate(entry.local_dof_map, dof_vector, ExplicitNonlinearFlowSolver::A_component, k);
+      fields.Q[idx] = Q;
+      fields.A[idx] = A;
+      fields.p_static[idx] = nonlinear::get_p_from_A(A, entry.G0, entry.A0);
+      fields.p_total[idx] = nonlinear::get_p_from_QA(Q, A, entry);
+      fields.velocity[idx] = Q / A;
+    }
+  }
+}
+
+template<typename Function>
+void InterpolationPlan::for_each_point(Function f) const {
+  std::size_t idx = 0;
+  for (const auto &entry : d_edges) {
+    if (!entry.has_physical_data)
+      throw std::runtime_error("cannot evaluate the pressures on edges without physical parameters");
+
+    for (std::size_t k = 0; k < entry.sampler.size(); k += 1, idx += 1)
+      f(entry, idx);
+  }
+}
+
+void InterpolationPlan::calculate_static_pressure(const std::vector<double> &A, std::vector<double> &p_static) const {
+  p_static.resize(size());
+  for_each_point([&](const EdgeEntry &entry, std::size_t k) { p_static[k] = nonlinear::get_p_from_A(A[k], entry.G0, entry.A0); });
+}
+
+void InterpolationPlan::calculate_total_pressure(const std::vector<double> &Q, const std::vector<double> &A, std::vector<double> &p_total) const {
+  p_total.resize(size());
+  for_each_point([&](const EdgeEntry &entry, std::size_t k) { p_total[k] = nonlinear::get_p_from_QA(Q[k], A[k], entry); });
+}
+
+void InterpolationPlan::calculate_wave_speed(const std::vector<double> &A, std::vector<double> &c) const {
+  c.resize(size());
+  for_each_point([&](const EdgeEntry &entry, std::size_t k) { c[k] = entry.c0 * std::pow(A[k] / entry.A0, 0.25); });
+}
+
+} // namespace macrocirculation
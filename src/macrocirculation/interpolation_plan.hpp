@@ -0,0 +1,97 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_INTERPOLATION_PLAN_HPP
+#define TUMORMODELS_INTERPOLATION_PLAN_HPP
+
+#include <cstddef>
+#include <mpi.h>
+#include <vector>
+
+#include "dof_map.hpp"
+#include "graph_storage.hpp"
+#include "output_resolution.hpp"
+
+namespace macrocirculation {
+
+/*! @brief The fields of the nonlinear flow solver at the points of an InterpolationPlan. */
+struct InterpolatedFlowFields {
+  std::vector<double> Q;
+  std::vector<double> A;
+  std::vector<double> p_static;
+  std::vector<double> p_total;
+  std::vector<double> velocity;
+};
+
+/*! @brief Caches everything needed to evaluate the solution at the output points of the embedded vessels.
+ *
+ *  By default the points and the values are ordered as in interpolate_to_vertices, i.e. every micro edge of every embedded,
+ *  active edge contributes its left and right endpoint. With a resampling OutputResolution the edges contribute their
+ *  equidistant output points instead, such that the output does not grow with the refinement of the solver.
+ *  Since neither the embedding nor the dof map change during a simulation, the plan is created once and the points,
+ *  the local dof maps and the values of the basis functions at the points are reused for every output,
+ *  instead of being rebuilt for every field.
+ */
+class InterpolationPlan {
+public:
+  InterpolationPlan(MPI_Comm comm, const GraphStorage &graph, const DofMap &map, const OutputResolution &resolution = {});
+
+  /*! @brief The output points of all the embedded edges. */
+  const std::vector<Point> &get_points() const { return d_points; }
+
+  /*! @brief Fills the vessel ids of the edges at the points. */
+  void fill_with_vessel_id(std::vector<double> &vessel_ids) const;
+
+  /*! @brief The number of points and hence of values in every interpolated field. */
+  std::size_t size() const { return d_points.size(); }
+
+  /*! @brief Evaluates the given component of the dof vector at the points. */
+  void interpolate(std::size_t component, const std::vector<double> &dof_vector, std::vector<double> &interpolated) const;
+
+  /*! @brief Evaluates Q and A of the nonlinear flow solver together with the static and total pressure and the
+   *         velocity at the points in a single pass. The fields are resized to the number of points, hence
+   *         their memory is reused, if the same fields are passed for every output.
+   */
+  void evaluate(const std::vector<double> &dof_vector, InterpolatedFlowFields &fields) const;
+
+  /*! @brief Calculates the static pressure at the points from the area, which was interpolated at them. */
+  void calculate_static_pressure(const std::vector<double> &A, std::vector<double> &p_static) const;
+
+  /*! @brief Calculates the total pressure at the points from the flow and area, which were interpolated at them. */
+  void calculate_total_pressure(const std::vector<double> &Q, const std::vector<double> &A, std::vector<double> &p_total) const;
+
+  /*! @brief Calculates the wave speed at the points from the area, which was interpolated at them. */
+  void calculate_wave_speed(const std::vector<double> &A, std::vector<double> &c) const;
+
+private:
+  struct EdgeEntry {
+    std::size_t edge_id;
+
+    LocalEdgeDofMap local_dof_map;
+
+    /*! @brief The output points of the edge with the basis functions at them. */
+    EdgeSampler sampler;
+
+    bool has_physical_data;
+    double G0;
+    double A0;
+    double rho;
+    double c0;
+  };
+
+  std::vector<Point> d_points;
+
+  std::vector<EdgeEntry> d_edges;
+
+  /*! @brief Calls f(entry, k) for every point k with the entry of its edge, which needs physical parameters. */
+  template<typename Function>
+  void for_each_point(Function f) const;
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_INTERPOLATION_PLAN_HPP
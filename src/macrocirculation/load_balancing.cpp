@@ -0,0 +1,137 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "load_balancing.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+#include "communication/mpi.hpp"
+#include "dof_map.hpp"
+#include "graph_storage.hpp"
+
+namespace macrocirculation {
+
+CostMeasurement::CostMeasurement(std::size_t num_edges, std::size_t num_vertices)
+    : d_edge_costs(num_edges, 0),
+      d_vertex_costs(num_vertices, 0) {}
+
+void CostMeasurement::reset() {
+  std::fill(d_edge_costs.begin(), d_edge_costs.end(), 0.);
+  std::fill(d_vertex_costs.begin(), d_vertex_costs.end(), 0.);
+}
+
+std::vector<double> CostMeasurement::get_total_edge_costs(MPI_Comm comm, const GraphStorage &graph) const {
+  std::vector<double> costs = d_edge_costs;
+  for (auto v_id : graph.get_vertex_ids()) {
+    const auto &neighbors = graph.vertex(v_id).get_edge_neighbors();
+    for (auto e_id : neighbors)
+      costs[e_id] += d_vertex_costs[v_id] / static_cast<double>(neighbors.size());
+  }
+  CHECK_MPI_SUCCESS(MPI_Allreduce(MPI_IN_PLACE, costs.data(), static_cast<int>(costs.size()), MPI_DOUBLE, MPI_SUM, comm));
+  return costs;
+}
+
+double calculate_load_imbalance(MPI_Comm comm, const GraphStorage &graph, const std::vector<double> &edge_costs) {
+  // every rank sums its own edges, such that the graph may be restricted to the ranks
+  const int rank = mpi::rank(comm);
+  std::vector<double> rank_costs(static_cast<std::size_t>(mpi::size(comm)), 0);
+  for (auto e_id : graph.get_active_edge_ids(rank))
+    rank_costs[static_cast<std::size_t>(rank)] += edge_costs[e_id];
+  CHECK_MPI_SUCCESS(MPI_Allreduce(MPI_IN_PLACE, rank_costs.data(), static_cast<int>(rank_costs.size()), MPI_DOUBLE, MPI_SUM, comm));
+
+  const double mean = std::accumulate(rank_costs.begin(), rank_costs.end(), 0.) / static_cast<double>(rank_costs.size());
+  if (!(mean > 0))
+    return 0;
+  return *std::max_element(rank_costs.begin(), rank_costs.end()) / mean - 1;
+}
+
+namespace {
+
+/*! @brief Calls f(dof_indices) for the dofs of the given edge and then for the dofs of its leaf vertices.
+ *         The order is the same on all ranks, hence no ids have to be sent.
+ */
+template<typename Function>
+void for_edge_dofs(const GraphStorage &graph, const DofMap &dof_map, const Edge &edge, Function f) {
+  const auto &local_dof_map = dof_map.get_local_dof_map(edge);
+  // the dofs of an edge are contiguous
+  std::vector<std::size_t> dof_indices(local_dof_map.num_local_dof());
+  std::iota(dof_indices.begin(), dof_indices.end(), local_dof_map.first_dof(0, 0));
+  f(dof_indices);
+
+  for (auto v_id : edge.get_vertex_neighbors()) {
+    const auto &vertex = graph.vertex(v_id);
+    if (vertex.is_leaf())
+      f(dof_map.get_local_dof_map(vertex).dof_indices());
+  }
+}
+
+} // namespace
+
+void migrate_primitive_values(MPI_Comm comm,
+                              const GraphStorage &graph,
+                              const std::vector<int> &old_edge_ranks,
+                              const DofMap &old_dof_map,
+                              const std::vector<double> &u_old,
+                              const DofMap &new_dof_map,
+                              std::vector<double> &u_new) {
+  const auto rank = mpi::rank(comm);
+  const auto size = static_cast<std::size_t>(mpi::size(comm));
+
+  std::vector<std::vector<double>> send_values(size);
+  std::vector<int> receive_counts(size, 0);
+  for (auto e_id : graph.get_edge_ids()) {
+    const auto &edge = graph.edge(e_id);
+    const int old_rank = old_edge_ranks[e_id];
+    const int new_rank = edge.rank();
+
+    if (old_rank == rank) {
+      auto &buffer = send_values[static_cast<std::size_t>(new_rank)];
+      for_edge_dofs(graph, old_dof_map, edge, [&](const std::vector<std::size_t> &dof_indices) {
+        for (auto i : dof_indices)
+          buffer.push_back(u_old[i]);
+      });
+    }
+
+    if (new_rank == rank) {
+      for_edge_dofs(graph, new_dof_map, edge, [&](const std::vector<std::size_t> &dof_indices) {
+        receive_counts[static_cast<std::size_t>(old_rank)] += static_cast<int>(dof_indices.size());
+      });
+    }
+  }
+
+  std::vector<int> send_counts(size), send_offsets(size), receive_offsets(size);
+  std::vector<double> send_buffer;
+  for (std::size_t r = 0; r < size; r += 1) {
+    send_counts[r] = static_cast<int>(send_values[r].size());
+    send_offsets[r] = static_cast<int>(send_buffer.size());
+    send_buffer.insert(send_buffer.end(), send_values[r].begin(), send_values[r].end());
+    receive_offsets[r] = (r == 0) ? 0 : receive_offsets[r - 1] + receive_counts[r - 1];
+  }
+  std::vector<double> receive_buffer(static_cast<std::size_t>(receive_offsets.back() + receive_counts.back()));
+
+  CHECK_MPI_SUCCESS(MPI_Alltoallv(send_buffer.data(), send_counts.data(), send_offsets.data(), MPI_DOUBLE,
+                                  receive_buffer.data(), receive_counts.data(), receive_offsets.data(), MPI_DOUBLE,
+                                  comm));
+
+  // the values from every rank arrive in the order of the edge ids
+  u_new.assign(new_dof_map.num_dof(), 0);
+  std::vector<int> position = receive_offsets;
+  for (auto e_id : graph.get_edge_ids()) {
+    const auto &edge = graph.edge(e_id);
+    if (edge.rank() != rank)
+      continue;
+    auto &pos = position[static_cast<std::size_t>(old_edge_ranks[e_id])];
+    for_edge_dofs(graph, new_dof_map, edge, [&](const std::vector<std::size_t> &dof_indices) {
+      for (auto i : dof_indices)
+        u_new[i] = receive_buffer[static_cast<std::size_t>(pos++)];
+    });
+  }
+}
+
+} // namespace macrocirculation
@@ -0,0 +1,108 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_LOAD_BALANCING_HPP
+#define TUMORMODELS_LOAD_BALANCING_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <mpi.h>
+#include <vector>
+
+namespace macrocirculation {
+
+// forward declarations
+class GraphStorage;
+class DofMap;
+
+/*! @brief Accumulates the measured computation times of the edges and vertices, which are used as costs for a repartitioning.
+ *
+ *  Different threads may add costs at the same time, as long as they work on different primitives.
+ */
+class CostMeasurement {
+public:
+  CostMeasurement(std::size_t num_edges, std::size_t num_vertices);
+
+  using Clock = std::chrono::steady_clock;
+
+  /*! @brief Returns the seconds since the given time point. */
+  static double seconds_since(Clock::time_point start) { return std::chrono::duration<double>(Clock::now() - start).count(); }
+
+  void add_edge_cost(std::size_t edge_id, double seconds) { d_edge_costs[edge_id] += seconds; }
+
+  void add_vertex_cost(std::size_t vertex_id, double seconds) { d_vertex_costs[vertex_id] += seconds; }
+
+  /*! @brief The costs measured on this rank, indexed by the edge and vertex ids. */
+  const std::vector<double> &get_edge_costs() const { return d_edge_costs; }
+  const std::vector<double> &get_vertex_costs() const { return d_vertex_costs; }
+
+  void reset();
+
+  /*! @brief Returns the costs of every edge summed over all the ranks, where the costs of a vertex are shared equally by its edges.
+   *         The call is collective.
+   */
+  std::vector<double> get_total_edge_costs(MPI_Comm comm, const GraphStorage &graph) const;
+
+private:
+  std::vector<double> d_edge_costs;
+  std::vector<double> d_vertex_costs;
+};
+
+/*! @brief Adds the time between its construction and destruction to the cost of a primitive. Does nothing without a measurement. */
+class ScopedCostTimer {
+public:
+  enum class Kind { edge,
+                    vertex };
+
+  ScopedCostTimer(CostMeasurement *measurement, Kind kind, std::size_t id)
+      : d_measurement(measurement),
+        d_kind(kind),
+        d_id(id),
+        d_start(measurement != nullptr ? CostMeasurement::Clock::now() : CostMeasurement::Clock::time_point()) {}
+
+  ScopedCostTimer(const ScopedCostTimer &) = delete;
+  ScopedCostTimer &operator=(const ScopedCostTimer &) = delete;
+
+  ~ScopedCostTimer() {
+    if (d_measurement == nullptr)
+      return;
+    const double seconds = CostMeasurement::seconds_since(d_start);
+    if (d_kind == Kind::edge)
+      d_measurement->add_edge_cost(d_id, seconds);
+    else
+      d_measurement->add_vertex_cost(d_id, seconds);
+  }
+
+private:
+  CostMeasurement *d_measurement;
+  Kind d_kind;
+  std::size_t d_id;
+  CostMeasurement::Clock::time_point d_start;
+};
+
+/*! @brief Returns the load imbalance max_r(c_r) / mean_r(c_r) - 1 of the rank costs c_r for the given edge costs
+ *         and the current assignment of the edges to the ranks of comm.
+ */
+double calculate_load_imbalance(MPI_Comm comm, const GraphStorage &graph, const std::vector<double> &edge_costs);
+
+/*! @brief Moves the values of u on the edges and their leaf vertices from the old owners to the new owners of the edges.
+ *
+ *  The graph has to be assigned to the new ranks already, while old_edge_ranks contains the previous rank of every edge.
+ *  The old dof map belongs to the previous partitioning and the new dof map to the current one.
+ *  The values are exchanged with a single all-to-all communication, and the call is collective.
+ */
+void migrate_primitive_values(MPI_Comm comm,
+                              const GraphStorage &graph,
+                              const std::vector<int> &old_edge_ranks,
+                              const DofMap &old_dof_map,
+                              const std::vector<double> &u_old,
+                              const DofMap &new_dof_map,
+                              std::vector<double> &u_new);
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_LOAD_BALANCING_HPP
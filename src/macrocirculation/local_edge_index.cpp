@@ -0,0 +1,48 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "local_edge_index.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include "graph_storage.hpp"
+
+namespace macrocirculation {
+
+LocalEdgeIndex::LocalEdgeIndex(const GraphStorage &graph, int rank) {
+  // removed edges leave gaps in the ids, hence the table has to cover the largest id
+  std::size_t num_ids = 0;
+  for (auto e_id : graph.get_edge_ids())
+    num_ids = std::max(num_ids, e_id + 1);
+  if (num_ids >= std::numeric_limits<std::uint32_t>::max())
+    throw std::runtime_error("LocalEdgeIndex: too many edges for 32 bit slots");
+
+  const auto unassigned = std::numeric_limits<std::uint32_t>::max();
+  d_slots.assign(num_ids, unassigned);
+
+  auto add = [&](std::size_t e_id) {
+    if (d_slots[e_id] == unassigned)
+      d_slots[e_id] = static_cast<std::uint32_t>(d_num_local_edges++);
+  };
+
+  for (auto e_id : graph.get_active_edge_ids(rank))
+    add(e_id);
+
+  // the ghost edges of every neighbor rank, in the traversal order
+  for (int other : graph.get_neighbor_ranks(rank))
+    for (auto e_id : graph.get_ghost_edge_ids(rank, other))
+      add(e_id);
+
+  for (auto &slot : d_slots) {
+    if (slot == unassigned)
+      slot = static_cast<std::uint32_t>(d_num_local_edges);
+  }
+}
+
+} // namespace macrocirculation
@@ -0,0 +1,58 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_LOCAL_EDGE_INDEX_HPP
+#define TUMORMODELS_LOCAL_EDGE_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace macrocirculation {
+
+// forward declarations
+class GraphStorage;
+
+/*! @brief Numbers the edges of a rank and of its ghost layer contiguously,
+ *         such that per edge data can be stored in arrays, whose size only depends on the local part of the graph.
+ *
+ *  The local edges are the edges assigned to the rank, followed by the ghost edges of all the other ranks.
+ *  All the other edges share a single slot after the local ones, which is meant to hold invalid values.
+ *  Since the graph is known on every rank, the table from edge ids to slots still has an entry for every edge,
+ *  but it only takes 4 bytes per edge instead of the data itself.
+ */
+class LocalEdgeIndex {
+public:
+  LocalEdgeIndex() = default;
+
+  /*! @brief Numbers the local edges of the given rank in the traversal order of the graph. */
+  LocalEdgeIndex(const GraphStorage &graph, int rank);
+
+  /*! @brief Returns the slot of the given edge. */
+  std::size_t operator()(std::size_t edge_id) const { return d_slots[edge_id]; }
+
+  /*! @brief Returns true, if the edge is assigned to our rank or part of its ghost layer. */
+  bool is_local(std::size_t edge_id) const { return d_slots[edge_id] < d_num_local_edges; }
+
+  /*! @brief Returns the number of edges of our rank and of its ghost layer. */
+  std::size_t num_local_edges() const { return d_num_local_edges; }
+
+  /*! @brief Returns the size of an array with an entry for every slot, i.e. for every local edge and the shared slot of the others. */
+  std::size_t num_slots() const { return d_num_local_edges + 1; }
+
+  /*! @brief Returns the memory of the table from edge ids to slots. */
+  std::size_t memory_bytes() const { return d_slots.capacity() * sizeof(std::uint32_t); }
+
+private:
+  std::vector<std::uint32_t> d_slots;
+
+  std::size_t d_num_local_edges{0};
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_LOCAL_EDGE_INDEX_HPP
@@ -0,0 +1,102 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "memory_report.hpp"
+
+#include <fstream>
+#include <iomanip>
+#include <nlohmann/json.hpp>
+
+#include "communication/mpi.hpp"
+
+namespace macrocirculation {
+
+void MemoryReport::add(const std::string &component, std::size_t bytes) {
+  for (auto &entry : d_entries) {
+    if (entry.component == component) {
+      entry.bytes += bytes;
+      return;
+    }
+  }
+  d_entries.push_back({component, bytes});
+}
+
+void MemoryReport::add(const std::string &prefix, const MemoryReport &report) {
+  for (const auto &entry : report.d_entries)
+    add(prefix + "/" + entry.component, entry.bytes);
+}
+
+std::size_t MemoryReport::get(const std::string &component) const {
+  for (const auto &entry : d_entries) {
+    if (entry.component == component)
+      return entry.bytes;
+  }
+  return 0;
+}
+
+std::size_t MemoryReport::total() const {
+  std::size_t bytes = 0;
+  for (const auto &entry : d_entries)
+    bytes += entry.bytes;
+  return bytes;
+}
+
+std::vector<MemoryReport::Statistics> MemoryReport::reduce(MPI_Comm comm) const {
+  // the ranks might know different components, e.g. if they do not own a writer
+  std::vector<std::string> local_components;
+  for (const auto &entry : d_entries)
+    local_components.push_back(entry.component);
+  auto components = mpi::allgather_union(comm, local_components);
+
+  std::vector<double> bytes;
+  for (const auto &component : components)
+    bytes.push_back(static_cast<double>(get(component)));
+  components.emplace_back("total");
+  bytes.push_back(static_cast<double>(total()));
+
+  const int n = static_cast<int>(bytes.size());
+  std::vector<double> min(bytes.size()), max(bytes.size()), sum(bytes.size());
+  CHECK_MPI_SUCCESS(MPI_Allreduce(bytes.data(), min.data(), n, MPI_DOUBLE, MPI_MIN, comm));
+  CHECK_MPI_SUCCESS(MPI_Allreduce(bytes.data(), max.data(), n, MPI_DOUBLE, MPI_MAX, comm));
+  CHECK_MPI_SUCCESS(MPI_Allreduce(bytes.data(), sum.data(), n, MPI_DOUBLE, MPI_SUM, comm));
+
+  const int num_ranks = mpi::size(comm);
+  std::vector<Statistics> statistics;
+  for (std::size_t k = 0; k < components.size(); k += 1)
+    statistics.push_back({components[k], min[k], sum[k] / num_ranks, max[k], sum[k]});
+  return statistics;
+}
+
+void MemoryReport::print(MPI_Comm comm, std::ostream &os) const {
+  const auto statistics = reduce(comm);
+  if (mpi::rank(comm) != 0)
+    return;
+
+  const double mib = 1024. * 1024.;
+  os << std::left << std::setw(48) << "component" << std::right << std::setw(14) << "min [MiB]" << std::setw(14) << "avg [MiB]" << std::setw(14) << "max [MiB]" << std::setw(14) << "sum [MiB]" << "\n";
+  for (const auto &s : statistics)
+    os << std::left << std::setw(48) << s.component << std::right << std::setw(14) << s.min / mib << std::setw(14) << s.avg / mib << std::setw(14) << s.max / mib << std::setw(14) << s.sum / mib << "\n";
+  os << std::flush;
+}
+
+void MemoryReport::write_json(MPI_Comm comm, const std::string &filepath) const {
+  const auto statistics = reduce(comm);
+  if (mpi::rank(comm) != 0)
+    return;
+
+  using json = nlohmann::json;
+
+  json j = json::array();
+  for (const auto &s : statistics)
+    j.push_back({{"component", s.component}, {"min", s.min}, {"avg", s.avg}, {"max", s.max}, {"sum", s.sum}});
+
+  std::ofstream o(filepath);
+  o << std::setw(4);
+  o << j;
+}
+
+} // namespace macrocirculation
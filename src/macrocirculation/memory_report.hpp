@@ -0,0 +1,81 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_MEMORY_REPORT_HPP
+#define TUMORMODELS_MEMORY_REPORT_HPP
+
+#include <cstddef>
+#include <mpi.h>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace macrocirculation {
+
+/*! @brief The heap memory of the components of a subsystem on this rank, e.g. to see which data structures grow with the network.
+ *
+ *  The components are named by paths like "graph/edges", and reports of subsystems are nested with add.
+ *  The bytes of a vector are its capacity, while the bookkeeping of the allocator and of small containers is ignored.
+ *  Hence, a report is a lower bound of the memory, which is accurate for the large arrays.
+ *
+ *  A memory_report method only counts the memory owned by its object.
+ *  Shared objects like the graph or the dof map have to be added separately, such that they are not counted twice.
+ */
+class MemoryReport {
+public:
+  struct Entry {
+    std::string component;
+    std::size_t bytes;
+  };
+
+  /*! @brief The bytes of a component over the ranks of a communicator. */
+  struct Statistics {
+    std::string component;
+    double min;
+    double avg;
+    double max;
+    double sum;
+  };
+
+  /*! @brief Adds the bytes to the component, which is created if necessary. */
+  void add(const std::string &component, std::size_t bytes);
+
+  /*! @brief Adds the allocated memory of the given vector to the component. */
+  template<typename T>
+  void add(const std::string &component, const std::vector<T> &values) { add(component, values.capacity() * sizeof(T)); }
+
+  /*! @brief Adds all the components of the given report with the given prefix, e.g. "solver/rhs" for the report of a right hand side evaluator. */
+  void add(const std::string &prefix, const MemoryReport &report);
+
+  /*! @brief Returns the components in the order of their first addition. */
+  const std::vector<Entry> &get_entries() const { return d_entries; }
+
+  /*! @brief Returns the bytes of the given component, or zero if it is unknown. */
+  std::size_t get(const std::string &component) const;
+
+  /*! @brief Returns the bytes of all the components. */
+  std::size_t total() const;
+
+  /*! @brief Reduces the components over all the ranks of comm, where components unknown to a rank count as zero bytes.
+   *         The statistics are sorted by the component names, and the last one is the total with the name "total".
+   *         The call is collective.
+   */
+  std::vector<Statistics> reduce(MPI_Comm comm) const;
+
+  /*! @brief Prints the reduced components in MiB on the root of comm. The call is collective. */
+  void print(MPI_Comm comm, std::ostream &os) const;
+
+  /*! @brief Writes the reduced components in bytes as json on the root of comm. The call is collective. */
+  void write_json(MPI_Comm comm, const std::string &filepath) const;
+
+private:
+  std::vector<Entry> d_entries;
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_MEMORY_REPORT_HPP
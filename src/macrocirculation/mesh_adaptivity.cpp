@@ -0,0 +1,170 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "mesh_adaptivity.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "communication/mpi.hpp"
+#include "dof_map.hpp"
+#include "fe_type.hpp"
+#include "graph_storage.hpp"
+
+namespace macrocirculation {
+
+std::vector<double> jump_indicators(const LocalEdgeDofMap &local_dof_map, const std::vector<double> &u) {
+  const std::size_t num_micro_edges = local_dof_map.num_micro_edges();
+  const std::size_t num_basis_functions = local_dof_map.num_basis_functions();
+
+  std::vector<double> indicators(num_micro_edges, 0);
+  for (std::size_t component = 0; component < local_dof_map.num_components(); component += 1) {
+    // the mean value of a legendre expansion is its first coefficient
+    double scale = 0;
+    for (std::size_t micro_edge_id = 0; micro_edge_id < num_micro_edges; micro_edge_id += 1)
+      scale = std::max(scale, std::abs(local_dof_map.dof_values(u, micro_edge_id, component)[0]));
+    if (!(scale > 0))
+      continue;
+
+    for (std::size_t micro_edge_id = 0; micro_edge_id + 1 < num_micro_edges; micro_edge_id += 1) {
+      const double *left_dofs = local_dof_map.dof_values(u, micro_edge_id, component);
+      const double *right_dofs = local_dof_map.dof_values(u, micro_edge_id + 1, component);
+
+      // the legendre polynomials are 1 at the right end and (-1)^i at the left end
+      double u_left = 0;
+      double u_right = 0;
+      for (std::size_t i = 0; i < num_basis_functions; i += 1) {
+        u_left += left_dofs[i];
+        u_right += (i % 2 == 0 ? 1. : -1.) * right_dofs[i];
+      }
+
+      const double jump = std::abs(u_right - u_left) / scale;
+      indicators[micro_edge_id] = std::max(indicators[micro_edge_id], jump);
+      indicators[micro_edge_id + 1] = std::max(indicators[micro_edge_id + 1], jump);
+    }
+  }
+  return indicators;
+}
+
+std::vector<double> adapt_micro_edge_lengths(const std::vector<double> &lengths,
+                                             const std::vector<double> &indicators,
+                                             const MeshAdaptivitySettings &settings) {
+  std::vector<double> new_lengths;
+  new_lengths.reserve(2 * lengths.size());
+
+  for (std::size_t micro_edge_id = 0; micro_edge_id < lengths.size(); micro_edge_id += 1) {
+    const double h = lengths[micro_edge_id];
+
+    if (indicators[micro_edge_id] > settings.refine_threshold && h / 2 >= settings.min_micro_edge_length) {
+      new_lengths.push_back(h / 2);
+      new_lengths.push_back(h / 2);
+      continue;
+    }
+
+    const bool has_neighbor = micro_edge_id + 1 < lengths.size();
+    if (has_neighbor && indicators[micro_edge_id] < settings.coarsen_threshold && indicators[micro_edge_id + 1] < settings.coarsen_threshold && h + lengths[micro_edge_id + 1] <= settings.max_micro_edge_length) {
+      new_lengths.push_back(h + lengths[micro_edge_id + 1]);
+      micro_edge_id += 1;
+      continue;
+    }
+
+    new_lengths.push_back(h);
+  }
+
+  return new_lengths;
+}
+
+void transfer_to_micro_edges(MPI_Comm comm,
+                             const GraphStorage &graph,
+                             const DofMap &old_dof_map,
+                             const std::vector<std::vector<double>> &old_micro_edge_lengths,
+                             const std::vector<double> &u_old,
+                             const DofMap &new_dof_map,
+                             std::vector<double> &u_new) {
+  u_new.assign(new_dof_map.num_dof(), 0.);
+
+  const int rank = mpi::rank(comm);
+  for (auto e_id : graph.get_active_edge_ids(rank)) {
+    const auto &edge = graph.edge(e_id);
+    const auto &old_local_dof_map = old_dof_map.get_local_dof_map(edge);
+    const auto &new_local_dof_map = new_dof_map.get_local_dof_map(edge);
+    const auto &old_lengths = old_micro_edge_lengths[e_id];
+    const auto new_lengths = edge.get_micro_edge_lengths();
+    const std::size_t num_components = old_local_dof_map.num_components();
+    const std::size_t old_num_basis_functions = old_local_dof_map.num_basis_functions();
+    const std::size_t new_num_basis_functions = new_local_dof_map.num_basis_functions();
+
+    // unchanged edges are copied without any rounding
+    if (old_lengths == new_lengths && old_num_basis_functions == new_num_basis_functions) {
+      for (std::size_t micro_edge_id = 0; micro_edge_id < new_lengths.size(); micro_edge_id += 1) {
+        for (std::size_t component = 0; component < num_components; component += 1) {
+          const double *old_dofs = old_local_dof_map.dof_values(u_old, micro_edge_id, component);
+          std::copy(old_dofs, old_dofs + old_num_basis_functions, new_local_dof_map.dof_values(u_new, micro_edge_id, component));
+        }
+      }
+      continue;
+    }
+
+    // the product of an old and a new shape function is integrated exactly
+    const auto qf = create_gauss_for_degree(std::max(old_num_basis_functions, new_num_basis_functions) - 1);
+
+    // we walk along the edge over the overlaps of the old and new micro edges
+    std::size_t old_id = 0;
+    std::size_t new_id = 0;
+    double old_left = 0;
+    double new_left = 0;
+    while (old_id < old_lengths.size() && new_id < new_lengths.size()) {
+      const double old_right = old_left + old_lengths[old_id];
+      const double new_right = new_left + new_lengths[new_id];
+      const double left = std::max(old_left, new_left);
+      const double right = std::min(old_right, new_right);
+
+      if (right > left) {
+        for (std::size_t qp = 0; qp < qf.size(); qp += 1) {
+          const double x = left + (right - left) * (qf.ref_points[qp] + 1) / 2;
+          const double w = qf.ref_weights[qp] * (right - left) / 2;
+          const auto phi_old = evaluate_legendre(2 * (x - old_left) / old_lengths[old_id] - 1);
+          const auto phi_new = evaluate_legendre(2 * (x - new_left) / new_lengths[new_id] - 1);
+
+          for (std::size_t component = 0; component < num_components; component += 1) {
+            const double *old_dofs = old_local_dof_map.dof_values(u_old, old_id, component);
+            double *new_dofs = new_local_dof_map.dof_values(u_new, new_id, component);
+
+            double value = 0;
+            for (std::size_t j = 0; j < old_num_basis_functions; j += 1)
+              value += old_dofs[j] * phi_old[j];
+
+            // the mass matrix of a micro edge is diagonal with the entries legendre_weight(i) * h / 2
+            for (std::size_t i = 0; i < new_num_basis_functions; i += 1)
+              new_dofs[i] += w * value * phi_new[i] / (legendre_weight(i) * new_lengths[new_id] / 2);
+          }
+        }
+      }
+
+      if (old_right < new_right) {
+        old_left = old_right;
+        old_id += 1;
+      } else {
+        new_left = new_right;
+        new_id += 1;
+      }
+    }
+  }
+
+  for (auto v_id : graph.get_active_vertex_ids(rank)) {
+    const auto &vertex = graph.vertex(v_id);
+    if (!graph.owns_primitive(vertex, rank) || !vertex.is_leaf())
+      continue;
+
+    const auto &old_local_dof_map = old_dof_map.get_local_dof_map(vertex);
+    const auto &new_local_dof_map = new_dof_map.get_local_dof_map(vertex);
+    for (std::size_t component = 0; component < new_local_dof_map.num_local_dof(); component += 1)
+      u_new[new_local_dof_map.dof_index(component)] = u_old[old_local_dof_map.dof_index(component)];
+  }
+}
+
+} // namespace macrocirculation
@@ -0,0 +1,71 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_MESH_ADAPTIVITY_HPP
+#define TUMORMODELS_MESH_ADAPTIVITY_HPP
+
+#include <cstddef>
+#include <limits>
+#include <mpi.h>
+#include <vector>
+
+namespace macrocirculation {
+
+// forward declarations
+class GraphStorage;
+class DofMap;
+class LocalEdgeDofMap;
+
+/*! @brief Settings for refining and coarsening the micro edges of every edge from the jumps of the solution. */
+struct MeshAdaptivitySettings {
+  /*! @brief A micro edge is split into two halves, if its jump indicator is above this value. */
+  double refine_threshold{1e-3};
+
+  /*! @brief Two neighboring micro edges are merged, if both jump indicators are below this value. */
+  double coarsen_threshold{1e-5};
+
+  /*! @brief Micro edges are not split, if their halves would be shorter than this. */
+  double min_micro_edge_length{0};
+
+  /*! @brief Micro edges are not merged, if the result would be longer than this. */
+  double max_micro_edge_length{std::numeric_limits<double>::infinity()};
+};
+
+/*! @brief Returns the jump indicator of every micro edge of an edge.
+ *
+ *  The indicator of a micro edge is the largest jump of the discontinuous solution at its inner boundaries,
+ *  relative to the largest mean value of the component on the edge, and maximized over all the components.
+ *  The boundaries at the ends of the edge do not contribute, since the vertices are coupled by the upwinding.
+ */
+std::vector<double> jump_indicators(const LocalEdgeDofMap &local_dof_map, const std::vector<double> &u);
+
+/*! @brief Returns the new lengths of the micro edges of an edge from their jump indicators.
+ *
+ *  Micro edges above the refinement threshold are split into halves, while pairs of neighboring micro edges below the
+ *  coarsening threshold are merged. Hence, a refinement is exactly reverted by a later coarsening.
+ */
+std::vector<double> adapt_micro_edge_lengths(const std::vector<double> &lengths,
+                                             const std::vector<double> &indicators,
+                                             const MeshAdaptivitySettings &settings);
+
+/*! @brief Projects u_old in L2 onto the shape functions of new_dof_map, where the micro edges of the edges changed.
+ *
+ *  The old lengths of the micro edges are indexed by the edge id, while the graph already has the new ones.
+ *  Both solutions are piecewise polynomials on the edge, hence the overlaps of the old and new micro edges are integrated exactly.
+ *  In particular the integrals of the components are preserved. The values of the vertices are copied.
+ */
+void transfer_to_micro_edges(MPI_Comm comm,
+                             const GraphStorage &graph,
+                             const DofMap &old_dof_map,
+                             const std::vector<std::vector<double>> &old_micro_edge_lengths,
+                             const std::vector<double> &u_old,
+                             const DofMap &new_dof_map,
+                             std::vector<double> &u_new);
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_MESH_ADAPTIVITY_HPP
@@ -0,0 +1,440 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "mesh_tools.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "0d_boundary_conditions.hpp"
+#include "graph_storage.hpp"
+#include "impedance_solver.hpp"
+#include "vessel_formulas.hpp"
+
+namespace macrocirculation {
+
+namespace {
+
+/*! @brief Resamples the polygonal chain linearly at num_points points, which are equidistant along its arc length. */
+std::vector<Point> resample(const std::vector<Point> &points, std::size_t num_points) {
+  std::vector<double> arc_lengths(points.size(), 0.);
+  for (std::size_t k = 1; k < points.size(); k += 1)
+    arc_lengths[k] = arc_lengths[k - 1] + Point::distance(points[k - 1], points[k]);
+
+  std::vector<Point> resampled;
+  resampled.reserve(num_points);
+  std::size_t segment = 0;
+  for (std::size_t k = 0; k < num_points; k += 1) {
+    const double s = arc_lengths.back() * static_cast<double>(k) / static_cast<double>(num_points - 1);
+    while (segment + 2 < points.size() && arc_lengths[segment + 1] < s)
+      segment += 1;
+    const double segment_length = arc_lengths[segment + 1] - arc_lengths[segment];
+    const double theta = segment_length > 0 ? std::clamp((s - arc_lengths[segment]) / segment_length, 0., 1.) : 0.;
+    resampled.push_back(convex_combination(points[segment], points[segment + 1], theta));
+  }
+  return resampled;
+}
+
+/*! @brief Inverts the relation of G0 and the wall thickness in PhysicalData::set_from_data. */
+double get_wall_thickness(const PhysicalData &data) {
+  const double nu = 0.5;
+  const double E = data.elastic_modulus / 100;
+  return data.G0 * (1 - nu * nu) * std::sqrt(data.A0) / (std::sqrt(M_PI) * E);
+}
+
+/*! @brief The lumped parameters of a subtree as seen from its root vertex. */
+struct SubtreeLoad {
+  std::complex<double> impedance = 0;
+
+  double resistance = 0;
+  double compliance = 0;
+  double inductance = 0;
+
+  /*! @brief The outflow pressure, which gives the same steady flow for the total resistance as the outflows. */
+  double p_out = 0;
+
+  std::size_t num_vessels = 0;
+};
+
+/*! @brief Combines parallel subtrees at their common root. */
+SubtreeLoad in_parallel(const std::vector<SubtreeLoad> &loads) {
+  SubtreeLoad load;
+  std::complex<double> admittance = 0;
+  double conductance = 0;
+  double inverse_inductance = 0;
+  double weighted_p_out = 0;
+  for (const auto &l : loads) {
+    admittance += 1. / l.impedance;
+    conductance += 1. / l.resistance;
+    inverse_inductance += l.inductance > 0 ? 1. / l.inductance : 0.;
+    load.compliance += l.compliance;
+    weighted_p_out += l.p_out / l.resistance;
+    load.num_vessels += l.num_vessels;
+  }
+  load.impedance = 1. / admittance;
+  load.resistance = 1. / conductance;
+  load.p_out = load.resistance * weighted_p_out;
+  load.inductance = inverse_inductance > 0 ? 1. / inverse_inductance : 0.;
+  return load;
+}
+
+/*! @brief The load of the 0D outflow at an original leaf, which is attached to a vessel with the given physical data. */
+SubtreeLoad get_outflow_load(const Vertex &vertex, const PhysicalData &param, double omega) {
+  SubtreeLoad load;
+  load.impedance = calculate_outflow_impedance(vertex, param, omega);
+  load.resistance = calculate_outflow_impedance(vertex, param, 0).real();
+  if (vertex.is_windkessel_outflow()) {
+    load.compliance = vertex.get_peripheral_vessel_data().compliance;
+    load.p_out = vertex.get_peripheral_vessel_data().p_out;
+  } else if (vertex.is_vessel_tree_outflow()) {
+    // the k-th level has furcation_number^k compartments
+    const auto &data = vertex.get_vessel_tree_data();
+    double num_compartments = 1;
+    for (auto c : data.capacitances) {
+      load.compliance += num_compartments * c;
+      num_compartments *= static_cast<double>(data.furcation_number);
+    }
+    load.p_out = data.p_out;
+  } else if (vertex.is_rcl_outflow()) {
+    const auto &data = vertex.get_rcl_data();
+    load.compliance = std::accumulate(data.capacitances.begin(), data.capacitances.end(), 0.);
+    load.inductance = std::accumulate(data.inductances.begin(), data.inductances.end(), 0.);
+    load.p_out = data.p_out;
+  }
+  return load;
+}
+
+/*! @brief The load of a subtree at the start of a vessel with the given physical data, which ends in the subtree with the given load. */
+SubtreeLoad through_vessel(const SubtreeLoad &end_load, const PhysicalData &param, double omega) {
+  const double resistance = linear::get_L(param) * linear::get_R(param) * param.length;
+  SubtreeLoad load = end_load;
+  // the steady input impedance is only the resistance in series, which is also defined for the inviscid vessels
+  load.impedance = omega > 0 ? calculate_vessel_input_impedance(param, omega, end_load.impedance) : end_load.impedance + resistance;
+  load.resistance += resistance;
+  load.compliance += linear::get_C(param) * param.length;
+  load.inductance += linear::get_L(param) * param.length;
+  load.num_vessels += 1;
+  return load;
+}
+
+/*! @brief The largest ratio of the wave speed and a micro edge length over all the edges. */
+double get_max_cfl_rate(const GraphStorage &graph) {
+  double max_rate = 0;
+  for (auto e_id : graph.get_edge_ids()) {
+    const auto &edge = graph.edge(e_id);
+    const auto lengths = edge.get_micro_edge_lengths();
+    max_rate = std::max(max_rate, calculate_c0(edge.get_physical_data()) / *std::min_element(lengths.begin(), lengths.end()));
+  }
+  return max_rate;
+}
+
+/*! @brief Copies the boundary condition of a leaf, except for the inflow functions, which cannot be read back. */
+void copy_boundary_condition(const Vertex &from, Vertex &to) {
+  if (from.is_windkessel_outflow()) {
+    const auto &data = from.get_peripheral_vessel_data();
+    to.set_to_windkessel_outflow(data.resistance, data.compliance);
+    to.update_vessel_tip_pressures(data.p_out);
+  } else if (from.is_vessel_tree_outflow()) {
+    const auto &data = from.get_vessel_tree_data();
+    to.set_to_vessel_tree_outflow(data.p_out, data.resistances, data.capacitances, data.radii, data.furcation_number);
+  } else if (from.is_rcl_outflow()) {
+    const auto &data = from.get_rcl_data();
+    to.set_to_vessel_rcl_outflow(data.p_out, data.resistances, data.capacitances, data.inductances);
+  } else if (from.is_linear_characteristic_inflow()) {
+    const auto &data = from.get_linear_characteristic_data();
+    to.set_to_linear_characteristic_inflow(data.C, data.L, data.points_towards_vertex, data.p, data.q);
+  } else if (from.is_nonlinear_characteristic_inflow()) {
+    const auto &data = from.get_nonlinear_characteristic_data();
+    to.set_to_nonlinear_characteristic_inflow(data.G0, data.A0, data.rho, data.points_towards_vertex, data.p, data.q);
+  }
+}
+
+/*! @brief Attaches the 0D model of the given type for the subtree load to the leaf, whose vessel has the given physical data. */
+void set_lumped_outflow(Vertex &vertex, const Edge &edge, const SubtreeLoad &load, LumpedOutflowModel model) {
+  const double R1 = calculate_R1(edge.get_physical_data());
+  // the input resistance R1 of a vessel much thicker than the subtree may exceed its total resistance
+  const double R_0d = std::max(load.resistance - R1, 1e-2 * load.resistance);
+
+  if (model == LumpedOutflowModel::windkessel) {
+    vertex.set_to_windkessel_outflow(R1 + R_0d, load.compliance);
+    vertex.update_vessel_tip_pressures(load.p_out);
+  } else if (model == LumpedOutflowModel::rcl) {
+    vertex.set_to_vessel_rcl_outflow(load.p_out, {R_0d}, {load.compliance}, {load.inductance});
+  } else {
+    // the estimated binary tree of the vessel is rescaled to the resistance and compliance of the subtree
+    auto tree = calculate_edge_tree_parameters(edge);
+    if (tree.R.empty()) {
+      tree.R = {1.};
+      tree.C = {1.};
+      tree.radii = {edge.get_physical_data().radius};
+    }
+    double R_tree = 0;
+    double C_tree = 0;
+    double num_compartments = 1;
+    for (std::size_t k = 0; k < tree.R.size(); k += 1) {
+      R_tree += tree.R[k] / num_compartments;
+      C_tree += tree.C[k] * num_compartments;
+      num_compartments *= 2;
+    }
+    for (auto &R : tree.R)
+      R *= R_0d / R_tree;
+    for (auto &C : tree.C)
+      C *= load.compliance / C_tree;
+    vertex.set_to_vessel_tree_outflow(load.p_out, tree.R, tree.C, tree.radii, 2);
+  }
+}
+
+} // namespace
+
+std::size_t refine_uniformly(GraphStorage &graph, double mesh_width) {
+  if (!(mesh_width > 0))
+    throw std::runtime_error("the mesh width has to be positive");
+
+  std::size_t num_changed_edges = 0;
+  for (auto e_id : graph.get_edge_ids()) {
+    auto &edge = graph.edge(e_id);
+    const double length = edge.get_physical_data().length;
+    const auto num_micro_edges = static_cast<std::size_t>(std::max(1., std::ceil(length / mesh_width)));
+
+    const auto old_lengths = edge.get_micro_edge_lengths();
+    const std::vector<double> lengths(num_micro_edges, length / static_cast<double>(num_micro_edges));
+    if (lengths == old_lengths)
+      continue;
+
+    graph.set_micro_edge_lengths(edge, lengths);
+    if (edge.has_embedding_data() && edge.get_embedding_data().points.size() >= 2)
+      edge.add_embedding_data({resample(edge.get_embedding_data().points, num_micro_edges + 1)});
+    num_changed_edges += 1;
+  }
+  return num_changed_edges;
+}
+
+Edge &connect_by_name(GraphStorage &graph, const std::string &left_vertex_name, const std::string &right_vertex_name, std::size_t num_micro_edges, const PhysicalData &physical_data) {
+  auto left = graph.find_vertex_by_name(left_vertex_name);
+  auto right = graph.find_vertex_by_name(right_vertex_name);
+  if (left == nullptr || right == nullptr)
+    throw std::runtime_error("cannot connect " + left_vertex_name + " and " + right_vertex_name + ", since one of them does not exist");
+
+  // the outflow models of leaves, which become interior vertices, are removed while they are still leaves
+  for (auto *v : {left.get(), right.get()}) {
+    if (v->is_leaf() && (v->is_windkessel_outflow() || v->is_vessel_tree_outflow() || v->is_rcl_outflow()))
+      v->set_to_free_outflow();
+  }
+
+  auto edge = graph.connect(*left, *right, num_micro_edges);
+  edge->add_physical_data(physical_data);
+  edge->set_name("con_vertex(" + left_vertex_name + ")_vertex(" + right_vertex_name + ")");
+
+  return *edge;
+}
+
+std::size_t scale_windkessel_parameters(GraphStorage &graph, const std::string &name_prefix, double resistance_factor, double compliance_factor) {
+  std::size_t num_scaled = 0;
+  for (auto v_id : graph.get_vertex_ids()) {
+    auto &v = graph.vertex(v_id);
+    if (!v.is_windkessel_outflow() || v.get_name().compare(0, name_prefix.size(), name_prefix) != 0)
+      continue;
+    const auto &data = v.get_peripheral_vessel_data();
+    v.update_windkessel_parameters(resistance_factor * data.resistance, compliance_factor * data.compliance);
+    num_scaled += 1;
+  }
+  return num_scaled;
+}
+
+void write_mesh_json(const std::string &filepath, const GraphStorage &graph) {
+  using json = nlohmann::json;
+
+  // the reader expects the vertex ids to be the positions in the vertex list
+  const auto vertex_ids = graph.get_vertex_ids();
+  std::vector<std::size_t> vertex_index(graph.num_vertices() == 0 ? 0 : *std::max_element(vertex_ids.begin(), vertex_ids.end()) + 1, 0);
+  for (std::size_t k = 0; k < vertex_ids.size(); k += 1)
+    vertex_index[vertex_ids[k]] = k;
+
+  json vertices = json::array();
+  for (std::size_t k = 0; k < vertex_ids.size(); k += 1) {
+    const auto &v = graph.vertex(vertex_ids[k]);
+    json vertex = {{"id", k}, {"name", v.get_name()}};
+    if (v.is_leaf() && v.is_windkessel_outflow()) {
+      vertex["peripheral_resistance"] = v.get_peripheral_vessel_data().resistance;
+      vertex["peripheral_compliance"] = v.get_peripheral_vessel_data().compliance;
+    }
+    vertices.push_back(std::move(vertex));
+  }
+
+  json vessels = json::array();
+  for (auto e_id : graph.get_edge_ids()) {
+    const auto &edge = graph.edge(e_id);
+    const auto &data = edge.get_physical_data();
+    json vessel = {{"id", vessels.size()},
+                   {"name", edge.get_name()},
+                   {"left_vertex_id", vertex_index[edge.get_vertex_neighbors()[0]]},
+                   {"right_vertex_id", vertex_index[edge.get_vertex_neighbors()[1]]},
+                   {"number_edges", edge.num_micro_edges()},
+                   {"vessel_length", data.length},
+                   {"radius", data.radius},
+                   {"wall_thickness", get_wall_thickness(data)},
+                   {"elastic_modulus", data.elastic_modulus},
+                   {"gamma", data.gamma}};
+    if (edge.has_embedding_data()) {
+      json points = json::array();
+      for (const auto &p : edge.get_embedding_data().points)
+        points.push_back({p.x, p.y, p.z});
+      vessel["embedded_coordinates"] = std::move(points);
+    }
+    vessels.push_back(std::move(vessel));
+  }
+
+  std::ofstream file(filepath);
+  if (!file.good())
+    throw std::runtime_error("file " + filepath + " could not be opened");
+  file << json{{"vertices", std::move(vertices)}, {"vessels", std::move(vessels)}};
+}
+
+LumpingReport lump_peripheral_subtrees(const GraphStorage &graph, const LumpingSettings &settings, GraphStorage &reduced) {
+  if (reduced.num_vertices() > 0 || reduced.num_edges() > 0)
+    throw std::runtime_error("the reduced graph has to be empty");
+
+  const auto vertex_ids = graph.get_vertex_ids();
+  const auto edge_ids = graph.get_edge_ids();
+  const std::size_t vertex_storage_size = vertex_ids.empty() ? 0 : *std::max_element(vertex_ids.begin(), vertex_ids.end()) + 1;
+  const std::size_t edge_storage_size = edge_ids.empty() ? 0 : *std::max_element(edge_ids.begin(), edge_ids.end()) + 1;
+
+  const auto is_lumpable = [&](const Edge &edge) {
+    const auto &param = edge.get_physical_data();
+    return param.radius < settings.min_radius || calculate_c0(param) > settings.max_wave_speed;
+  };
+  const auto is_outflow = [](const Vertex &v) {
+    return v.is_leaf() && (v.is_free_outflow() || v.is_windkessel_outflow() || v.is_vessel_tree_outflow() || v.is_rcl_outflow());
+  };
+
+  // the subtrees are peeled off from the outflows, where a vertex is removed together with its last remaining vessel
+  std::vector<std::size_t> num_remaining_edges(vertex_storage_size, 0);
+  std::vector<bool> edge_removed(edge_storage_size, false);
+  std::vector<bool> vertex_removed(vertex_storage_size, false);
+  std::vector<std::vector<std::pair<std::size_t, std::size_t>>> children(vertex_storage_size);
+  std::vector<std::size_t> queue;
+  for (auto v_id : vertex_ids) {
+    num_remaining_edges[v_id] = graph.vertex(v_id).get_edge_neighbors().size();
+    if (is_outflow(graph.vertex(v_id)))
+      queue.push_back(v_id);
+  }
+  while (!queue.empty()) {
+    const auto v_id = queue.back();
+    queue.pop_back();
+    // the last vessel of a network without inflows has been removed from its other vertex
+    if (num_remaining_edges[v_id] == 0)
+      continue;
+    const auto &neighbors = graph.vertex(v_id).get_edge_neighbors();
+    const auto e_id = *std::find_if(neighbors.begin(), neighbors.end(), [&](auto id) { return !edge_removed[id]; });
+    const auto &edge = graph.edge(e_id);
+    const auto w_id = edge.get_vertex_neighbors()[0] == v_id ? edge.get_vertex_neighbors()[1] : edge.get_vertex_neighbors()[0];
+    // the vessels at the inflows and isolated vessels are never lumped
+    if (!is_lumpable(edge) || graph.vertex(w_id).is_leaf())
+      continue;
+    edge_removed[e_id] = true;
+    vertex_removed[v_id] = true;
+    num_remaining_edges[v_id] = 0;
+    children[w_id].emplace_back(e_id, v_id);
+    num_remaining_edges[w_id] -= 1;
+    if (num_remaining_edges[w_id] == 1)
+      queue.push_back(w_id);
+  }
+
+  // the subtrees, which meet at a vertex with several remaining vessels, keep their first vessel and are attached to its other vertex
+  std::vector<std::size_t> roots;
+  for (auto v_id : vertex_ids) {
+    if (!vertex_removed[v_id] && !children[v_id].empty())
+      roots.push_back(v_id);
+  }
+  std::vector<std::size_t> cut_vertices;
+  for (auto v_id : roots) {
+    if (num_remaining_edges[v_id] == 1) {
+      cut_vertices.push_back(v_id);
+      continue;
+    }
+    for (const auto &[e_id, c_id] : children[v_id]) {
+      edge_removed[e_id] = false;
+      vertex_removed[c_id] = false;
+      if (!children[c_id].empty())
+        cut_vertices.push_back(c_id);
+    }
+  }
+
+  // the load of a lumped subtree at its root
+  const auto get_load = [&](std::size_t root_id, double frequency, auto &&get_load) -> SubtreeLoad {
+    std::vector<SubtreeLoad> loads;
+    for (const auto &[e_id, c_id] : children[root_id]) {
+      const auto &param = graph.edge(e_id).get_physical_data();
+      const auto end_load = children[c_id].empty() ? get_outflow_load(graph.vertex(c_id), param, frequency) : get_load(c_id, frequency, get_load);
+      loads.push_back(through_vessel(end_load, param, frequency));
+    }
+    return in_parallel(loads);
+  };
+
+  LumpingReport report;
+  report.max_cfl_rate_before = get_max_cfl_rate(graph);
+
+  // the remaining network is copied with contiguous ids
+  std::vector<std::size_t> new_vertex_ids(vertex_storage_size, 0);
+  for (auto v_id : vertex_ids) {
+    if (vertex_removed[v_id])
+      continue;
+    auto new_vertex = reduced.create_vertex();
+    new_vertex->set_name(graph.vertex(v_id).get_name());
+    new_vertex_ids[v_id] = new_vertex->get_id();
+  }
+  for (auto e_id : edge_ids) {
+    if (edge_removed[e_id]) {
+      report.num_lumped_vessels += 1;
+      continue;
+    }
+    const auto &edge = graph.edge(e_id);
+    auto &left = reduced.vertex(new_vertex_ids[edge.get_vertex_neighbors()[0]]);
+    auto &right = reduced.vertex(new_vertex_ids[edge.get_vertex_neighbors()[1]]);
+    auto new_edge = reduced.connect(left, right, edge.num_micro_edges());
+    new_edge->set_name(edge.get_name());
+    new_edge->add_physical_data(edge.get_physical_data());
+    if (edge.has_micro_edge_lengths())
+      reduced.set_micro_edge_lengths(*new_edge, edge.get_micro_edge_lengths());
+    if (edge.has_embedding_data())
+      new_edge->add_embedding_data(edge.get_embedding_data());
+  }
+  for (auto v_id : vertex_ids) {
+    if (!vertex_removed[v_id] && children[v_id].empty() && graph.vertex(v_id).is_leaf())
+      copy_boundary_condition(graph.vertex(v_id), reduced.vertex(new_vertex_ids[v_id]));
+  }
+
+  for (auto v_id : cut_vertices) {
+    auto &vertex = reduced.vertex(new_vertex_ids[v_id]);
+    const auto &edge = reduced.edge(vertex.get_edge_neighbors()[0]);
+    const auto load = get_load(v_id, settings.reference_frequency, get_load);
+    const auto steady_load = get_load(v_id, 0., get_load);
+    set_lumped_outflow(vertex, edge, steady_load, settings.model);
+
+    const auto &param = edge.get_physical_data();
+    const double resistance = calculate_outflow_impedance(vertex, param, 0).real();
+    const auto impedance = calculate_outflow_impedance(vertex, param, settings.reference_frequency);
+    report.subtrees.push_back({vertex.get_name(),
+                               load.num_vessels,
+                               steady_load.resistance,
+                               steady_load.compliance,
+                               std::abs(resistance - steady_load.resistance) / steady_load.resistance,
+                               std::abs(impedance - load.impedance) / std::abs(load.impedance)});
+  }
+
+  report.max_cfl_rate_after = get_max_cfl_rate(reduced);
+  return report;
+}
+
+} // namespace macrocirculation
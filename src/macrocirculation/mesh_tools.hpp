@@ -0,0 +1,109 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_MESH_TOOLS_HPP
+#define TUMORMODELS_MESH_TOOLS_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace macrocirculation {
+
+// forward declarations
+class GraphStorage;
+class Edge;
+struct PhysicalData;
+
+/*! @brief Splits every edge into micro edges of equal length, which are at most as long as the given mesh width.
+ *         The embedding of an edge is resampled linearly along its arc length, such that it has a point at every micro vertex.
+ *
+ * @return The number of edges whose micro edges changed.
+ */
+std::size_t refine_uniformly(GraphStorage &graph, double mesh_width);
+
+/*! @brief Connects the vertices with the given names by a new vessel, e.g. to merge two networks, which were appended to the same graph.
+ *         Outflow models of the vertices are replaced by free outflows, since the vertices are no leaves anymore.
+ */
+Edge &connect_by_name(GraphStorage &graph, const std::string &left_vertex_name, const std::string &right_vertex_name, std::size_t num_micro_edges, const PhysicalData &physical_data);
+
+/*! @brief Scales the resistances and compliances of the windkessel outflows, whose vertex names start with the given prefix.
+ *
+ * @return The number of scaled windkessel outflows.
+ */
+std::size_t scale_windkessel_parameters(GraphStorage &graph, const std::string &name_prefix, double resistance_factor, double compliance_factor = 1);
+
+/*! @brief Writes the graph as a json mesh, which EmbeddedGraphReader::append reads back including the windkessel outflows.
+ *         The vertices and edges are numbered contiguously in the order of their ids.
+ *         Only the number of micro edges is stored, hence micro edges with different lengths become uniform.
+ */
+void write_mesh_json(const std::string &filepath, const GraphStorage &graph);
+
+/*! @brief The 0D model, which replaces a lumped subtree. */
+enum class LumpedOutflowModel { windkessel,
+                                vessel_tree,
+                                rcl };
+
+struct LumpingSettings {
+  /*! @brief Vessels with a smaller radius are lumped. */
+  double min_radius = 0;
+
+  /*! @brief Vessels with a faster wave speed c0 are lumped, since they restrict the time step the most. */
+  double max_wave_speed = std::numeric_limits<double>::infinity();
+
+  LumpedOutflowModel model = LumpedOutflowModel::windkessel;
+
+  /*! @brief The angular frequency, at which the impedance of the 0D models is compared to the one of the subtrees, e.g. of the heart rate. */
+  double reference_frequency = 2 * M_PI;
+};
+
+/*! @brief The 0D model of a single lumped subtree and how well it approximates the subtree. */
+struct LumpedSubtree {
+  /*! @brief The name of the cut vertex, where the 0D model is attached. */
+  std::string vertex_name;
+
+  std::size_t num_lumped_vessels;
+
+  /*! @brief The total resistance and compliance of the subtree including its outflows. */
+  double resistance;
+  double compliance;
+
+  /*! @brief The relative error of the resistance of the 0D model, which is only nonzero if its input resistance exceeds the one of the subtree. */
+  double resistance_error;
+
+  /*! @brief The relative error of the impedance of the 0D model at the reference frequency. */
+  double impedance_error;
+};
+
+struct LumpingReport {
+  std::vector<LumpedSubtree> subtrees;
+
+  std::size_t num_lumped_vessels = 0;
+
+  /*! @brief The largest ratio c0 / h of a wave speed and a micro edge length before and after the reduction, to which the explicit time step is inversely proportional. */
+  double max_cfl_rate_before = 0;
+  double max_cfl_rate_after = 0;
+};
+
+/*! @brief Replaces the terminal subtrees of small or stiff vessels by 0D outflows at the vertices, where they branch off the remaining network.
+ *
+ *  Starting at the outflows, all the vessels whose radius is below settings.min_radius or whose wave speed is above settings.max_wave_speed
+ *  are removed as long as they end in a part of the network, which is only connected to the rest by a single vessel.
+ *  The outflows of such a subtree are collapsed through its vessels into a total resistance, compliance and inductance
+ *  with the linearized model, see linear::get_L, linear::get_C and linear::get_R, which parametrize the new 0D model.
+ *  If several lumpable subtrees meet at a vertex with remaining vessels, their first vessels are kept, since a 0D model needs a leaf.
+ *
+ *  The reduced network is written into the empty graph reduced with contiguous ids, such that it can be stored by write_graph_cache.
+ *  The inflow functions are not copied, hence they have to be set on the reduced graph again.
+ */
+LumpingReport lump_peripheral_subtrees(const GraphStorage &graph, const LumpingSettings &settings, GraphStorage &reduced);
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_MESH_TOOLS_HPP
@@ -0,0 +1,247 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "metrics_exporter.hpp"
+
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <nlohmann/json.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include "communication/mpi.hpp"
+#include "dof_map.hpp"
+#include "explicit_nonlinear_flow_solver.hpp"
+#include "nonlinear_flow_upwind_evaluator.hpp"
+#include "right_hand_side_evaluator.hpp"
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace macrocirculation {
+
+namespace {
+
+/*! @brief The resident memory of this process in bytes, or 0 where it is unknown. */
+double get_resident_memory() {
+#ifdef __linux__
+  std::ifstream statm("/proc/self/statm");
+  std::size_t num_pages = 0;
+  std::size_t num_resident_pages = 0;
+  if (statm >> num_pages >> num_resident_pages)
+    return static_cast<double>(num_resident_pages) * static_cast<double>(sysconf(_SC_PAGESIZE));
+#endif
+  return 0;
+}
+
+/*! @brief Escapes the backslashes and quotes of a prometheus label value. */
+std::string escape_label(const std::string &value) {
+  std::string escaped;
+  for (char c : value) {
+    if (c == '\\' || c == '"')
+      escaped += '\\';
+    escaped += c;
+  }
+  return escaped;
+}
+
+/*! @brief Formats a sample value, where prometheus spells the undefined values as NaN. */
+std::string format_value(double value) {
+  if (std::isnan(value))
+    return "NaN";
+  std::ostringstream ss;
+  ss.precision(17);
+  ss << value;
+  return ss.str();
+}
+
+} // namespace
+
+MetricsExporter::MetricsExporter(MPI_Comm comm, std::string filepath, MetricsFormat format)
+    : d_comm(comm),
+      d_filepath(std::move(filepath)),
+      d_format(format),
+      d_interval(60),
+      d_check_interval(100),
+      d_start(Clock::now()),
+      d_num_steps(0),
+      d_steps_since_check(0),
+      d_last_wall_time(0),
+      d_last_num_steps(0),
+      d_last_t(std::numeric_limits<double>::quiet_NaN()) {}
+
+void MetricsExporter::set_interval(double seconds, std::size_t check_interval) {
+  if (seconds < 0)
+    throw std::runtime_error("the interval of the metrics must not be negative");
+  if (check_interval == 0)
+    throw std::runtime_error("the check interval of the metrics has to be positive");
+  d_interval = seconds;
+  d_check_interval = check_interval;
+}
+
+double MetricsExporter::get_wall_time() const {
+  return std::chrono::duration<double>(Clock::now() - d_start).count();
+}
+
+bool MetricsExporter::step(ExplicitNonlinearFlowSolver &solver, double t, double tau) {
+  // the rates of the first export start with the first step
+  if (d_num_steps == 0 && std::isnan(d_last_t))
+    d_last_t = t - tau;
+
+  d_num_steps += 1;
+  d_steps_since_check += 1;
+  if (d_steps_since_check < d_check_interval)
+    return false;
+  d_steps_since_check = 0;
+
+  // the clocks of the ranks differ, hence rank 0 decides for all of them
+  int due = get_wall_time() - d_last_wall_time >= d_interval;
+  CHECK_MPI_SUCCESS(MPI_Bcast(&due, 1, MPI_INT, 0, d_comm));
+  if (!due)
+    return false;
+
+  write(solver, t, tau);
+  return true;
+}
+
+RuntimeMetrics MetricsExporter::collect(ExplicitNonlinearFlowSolver &solver, double t, double tau) const {
+  RuntimeMetrics metrics;
+  metrics.t = t;
+  metrics.wall_time = get_wall_time();
+  metrics.num_steps = d_num_steps;
+
+  // the sums and maxima over the ranks are reduced together
+  std::array<double, 2> sums{static_cast<double>(solver.get_dof_map().num_owned_dofs()), static_cast<double>(solver.memory_report().total())};
+  CHECK_MPI_SUCCESS(MPI_Allreduce(MPI_IN_PLACE, sums.data(), static_cast<int>(sums.size()), MPI_DOUBLE, MPI_SUM, d_comm));
+  double resident_memory = get_resident_memory();
+  CHECK_MPI_SUCCESS(MPI_Allreduce(MPI_IN_PLACE, &resident_memory, 1, MPI_DOUBLE, MPI_MAX, d_comm));
+  metrics.num_dofs = static_cast<std::size_t>(sums[0]);
+  metrics.solver_memory = sums[1];
+  metrics.max_resident_memory = resident_memory;
+
+  const double elapsed = metrics.wall_time - d_last_wall_time;
+  const auto num_steps = static_cast<double>(d_num_steps - d_last_num_steps);
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  metrics.steps_per_second = elapsed > 0 ? num_steps / elapsed : nan;
+  metrics.dofs_per_second = metrics.steps_per_second * static_cast<double>(metrics.num_dofs);
+  metrics.simulated_time_per_second = elapsed > 0 ? (t - d_last_t) / elapsed : nan;
+
+  const auto wave_speeds = solver.calculate_wave_speed_diagnostics(tau);
+  metrics.cfl = wave_speeds.cfl;
+  metrics.max_wave_speed = wave_speeds.max_speed;
+
+  metrics.newton = solver.get_rhs_evaluator().get_flow_upwind_evaluator().get_newton_statistics(true);
+
+  metrics.phases = PhaseTimers::reduce(d_comm);
+
+  return metrics;
+}
+
+RuntimeMetrics MetricsExporter::write(ExplicitNonlinearFlowSolver &solver, double t, double tau) {
+  const auto metrics = collect(solver, t, tau);
+  d_last_wall_time = metrics.wall_time;
+  d_last_num_steps = metrics.num_steps;
+  d_last_t = t;
+
+  if (mpi::rank(d_comm) != 0)
+    return metrics;
+
+  if (d_format == MetricsFormat::json_lines)
+    write_json_line(metrics);
+  else
+    write_prometheus(metrics);
+
+  return metrics;
+}
+
+void MetricsExporter::write_json_line(const RuntimeMetrics &metrics) const {
+  using json = nlohmann::json;
+
+  json phases = json::array();
+  for (const auto &s : metrics.phases)
+    phases.push_back({{"phase", s.path}, {"calls", s.calls}, {"min", s.min}, {"avg", s.avg}, {"max", s.max}});
+
+  const json j = {
+    {"t", metrics.t},
+    {"wall_time", metrics.wall_time},
+    {"steps", metrics.num_steps},
+    {"dofs", metrics.num_dofs},
+    {"steps_per_second", metrics.steps_per_second},
+    {"dofs_per_second", metrics.dofs_per_second},
+    {"simulated_time_per_second", metrics.simulated_time_per_second},
+    {"cfl", metrics.cfl},
+    {"max_wave_speed", metrics.max_wave_speed},
+    {"newton", {{"solves", metrics.newton.num_solves}, {"iterations", metrics.newton.num_iterations}, {"average_iterations", metrics.newton.average_iterations()}, {"max_iterations", metrics.newton.max_iterations}, {"failures", metrics.newton.num_failures}, {"max_residual", metrics.newton.max_residual}}},
+    {"memory", {{"solver", metrics.solver_memory}, {"max_resident", metrics.max_resident_memory}}},
+    {"phases", phases}};
+
+  // a line is written at once, such that readers following the file only see complete lines
+  std::ofstream f(d_filepath, std::ios::out | std::ios::app);
+  f << j.dump() + "\n";
+  if (!f)
+    throw std::runtime_error("could not write the metrics to " + d_filepath);
+}
+
+void MetricsExporter::write_prometheus(const RuntimeMetrics &metrics) const {
+  std::ostringstream ss;
+
+  const auto add = [&ss](const std::string &name, const std::string &type, const std::string &help, double value) {
+    ss << "# HELP macrocirculation_" << name << " " << help << "\n";
+    ss << "# TYPE macrocirculation_" << name << " " << type << "\n";
+    ss << "macrocirculation_" << name << " " << format_value(value) << "\n";
+  };
+
+  add("simulated_time_seconds", "gauge", "The simulated time.", metrics.t);
+  add("wall_time_seconds", "gauge", "The wall clock time of the run.", metrics.wall_time);
+  add("steps_total", "counter", "The number of time steps.", static_cast<double>(metrics.num_steps));
+  add("dofs", "gauge", "The number of dofs of the flow.", static_cast<double>(metrics.num_dofs));
+  add("steps_per_second", "gauge", "The time steps per second since the previous export.", metrics.steps_per_second);
+  add("dofs_per_second", "gauge", "The dof updates per second since the previous export.", metrics.dofs_per_second);
+  add("simulated_time_per_second", "gauge", "The simulated seconds per second since the previous export.", metrics.simulated_time_per_second);
+  add("cfl", "gauge", "The largest cfl number of the last time step.", metrics.cfl);
+  add("max_wave_speed", "gauge", "The largest characteristic speed in cm/s.", metrics.max_wave_speed);
+  add("newton_solves_total", "counter", "The newton solves at the n-furcations.", static_cast<double>(metrics.newton.num_solves));
+  add("newton_iterations_total", "counter", "The newton iterations at the n-furcations.", static_cast<double>(metrics.newton.num_iterations));
+  add("newton_max_iterations", "gauge", "The most iterations of a newton solve.", static_cast<double>(metrics.newton.max_iterations));
+  add("newton_failures_total", "counter", "The newton solves, which did not converge.", static_cast<double>(metrics.newton.num_failures));
+  add("newton_max_residual", "gauge", "The largest final residual of a newton solve.", metrics.newton.max_residual);
+  add("solver_memory_bytes", "gauge", "The heap memory of the solver on all ranks.", metrics.solver_memory);
+  add("max_resident_memory_bytes", "gauge", "The largest resident memory of a rank.", metrics.max_resident_memory);
+
+  if (!metrics.phases.empty()) {
+    ss << "# HELP macrocirculation_phase_seconds The accumulated time of a solver phase over the ranks.\n";
+    ss << "# TYPE macrocirculation_phase_seconds gauge\n";
+    for (const auto &s : metrics.phases) {
+      const auto phase = escape_label(s.path);
+      ss << "macrocirculation_phase_seconds{phase=\"" << phase << "\",stat=\"min\"} " << format_value(s.min) << "\n";
+      ss << "macrocirculation_phase_seconds{phase=\"" << phase << "\",stat=\"avg\"} " << format_value(s.avg) << "\n";
+      ss << "macrocirculation_phase_seconds{phase=\"" << phase << "\",stat=\"max\"} " << format_value(s.max) << "\n";
+    }
+    ss << "# HELP macrocirculation_phase_calls_total The most calls of a solver phase on a rank.\n";
+    ss << "# TYPE macrocirculation_phase_calls_total counter\n";
+    for (const auto &s : metrics.phases)
+      ss << "macrocirculation_phase_calls_total{phase=\"" << escape_label(s.path) << "\"} " << s.calls << "\n";
+  }
+
+  // a scraper must never see a partially written file
+  const auto tmp_filepath = d_filepath + ".tmp";
+  {
+    std::ofstream f(tmp_filepath, std::ios::out | std::ios::trunc);
+    f << ss.str();
+    if (!f)
+      throw std::runtime_error("could not write the metrics to " + tmp_filepath);
+  }
+  if (std::rename(tmp_filepath.c_str(), d_filepath.c_str()) != 0)
+    throw std::runtime_error("could not move the metrics to " + d_filepath);
+}
+
+} // namespace macrocirculation
@@ -0,0 +1,130 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_METRICS_EXPORTER_HPP
+#define TUMORMODELS_METRICS_EXPORTER_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+#include "newton_statistics.hpp"
+#include "phase_timers.hpp"
+
+namespace macrocirculation {
+
+// forward declarations
+class ExplicitNonlinearFlowSolver;
+
+/*! @brief The file formats of the MetricsExporter. */
+enum class MetricsFormat {
+  /*! @brief Appends every export as a single json object on its own line, such that the file is a time series. */
+  json_lines,
+  /*! @brief Replaces the file with the latest export in the prometheus text exposition format, e.g. for the textfile collector of a node exporter. */
+  prometheus
+};
+
+/*! @brief The progress, throughput and health of a running flow solver over all ranks. */
+struct RuntimeMetrics {
+  /*! @brief The simulated time [s]. */
+  double t;
+
+  /*! @brief The wall clock time since the exporter was constructed [s]. */
+  double wall_time;
+
+  /*! @brief The number of time steps since the exporter was constructed. */
+  std::size_t num_steps;
+
+  /*! @brief The number of dofs of the flow on all ranks. */
+  std::size_t num_dofs;
+
+  /*! @brief The time steps, dof updates and simulated seconds per wall clock second since the previous export. */
+  double steps_per_second;
+  double dofs_per_second;
+  double simulated_time_per_second;
+
+  /*! @brief The largest cfl number of the last time step and the largest characteristic speed [cm s^{-1}]. */
+  double cfl;
+  double max_wave_speed;
+
+  /*! @brief The newton solves of the upwinding at the n-furcations summed over the ranks since the start of the solver. */
+  NewtonStatistics newton;
+
+  /*! @brief The heap memory of the solver summed over the ranks [bytes]. */
+  double solver_memory;
+
+  /*! @brief The largest resident memory of a rank, which is 0 where the operating system does not report it [bytes]. */
+  double max_resident_memory;
+
+  /*! @brief The times of the setup phases, and of the solver phases if they are recorded with MACROCIRCULATION_PHASE_TIMERS. */
+  std::vector<PhaseTimers::Statistics> phases;
+};
+
+/*! @brief Periodically writes the RuntimeMetrics of a flow solver to a machine readable file on rank 0,
+ *         such that the throughput and health of long runs can be watched while they are running.
+ *
+ *  Whether an export is due is only decided every check_interval-th step with a single broadcast of the clock of rank 0,
+ *  hence all the ranks take part in the collective export in the same step and the other steps cost nothing.
+ */
+class MetricsExporter {
+public:
+  MetricsExporter(MPI_Comm comm, std::string filepath, MetricsFormat format);
+
+  /*! @brief Sets the wall clock seconds between two exports, and after how many steps the ranks check whether an export is due.
+   *         The default is an export every minute, checked every 100 steps.
+   */
+  void set_interval(double seconds, std::size_t check_interval = 100);
+
+  /*! @brief Counts a time step of the solver, which ended at t, and writes the metrics if an export is due.
+   *         The step size tau is the one of calculate_wave_speed_diagnostics. The call is collective.
+   *
+   * @return True, if the metrics were written.
+   */
+  bool step(ExplicitNonlinearFlowSolver &solver, double t, double tau);
+
+  /*! @brief Collects the metrics of the solver at time t. The call is collective. */
+  RuntimeMetrics collect(ExplicitNonlinearFlowSolver &solver, double t, double tau) const;
+
+  /*! @brief Collects the metrics and writes them on rank 0 immediately, e.g. at the end of a run. The call is collective. */
+  RuntimeMetrics write(ExplicitNonlinearFlowSolver &solver, double t, double tau);
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  MPI_Comm d_comm;
+
+  std::string d_filepath;
+
+  MetricsFormat d_format;
+
+  double d_interval;
+
+  std::size_t d_check_interval;
+
+  Clock::time_point d_start;
+
+  std::size_t d_num_steps;
+
+  std::size_t d_steps_since_check;
+
+  /*! @brief The wall clock time, number of steps and simulated time of the previous export. */
+  double d_last_wall_time;
+  std::size_t d_last_num_steps;
+  double d_last_t;
+
+  double get_wall_time() const;
+
+  void write_json_line(const RuntimeMetrics &metrics) const;
+
+  void write_prometheus(const RuntimeMetrics &metrics) const;
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_METRICS_EXPORTER_HPP
@@ -0,0 +1,87 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "newton_statistics.hpp"
+
+#include "communication/mpi.hpp"
+
+#include <algorithm>
+
+namespace macrocirculation {
+
+void NewtonStatistics::add(std::size_t iterations, double residual, bool converged) {
+  num_solves += 1;
+  num_iterations += iterations;
+  max_iterations = std::max(max_iterations, iterations);
+  if (!converged)
+    num_failures += 1;
+  max_residual = std::max(max_residual, residual);
+  iteration_histogram[std::min(iterations, num_histogram_bins - 1)] += 1;
+}
+
+void NewtonStatistics::merge(const NewtonStatistics &other) {
+  num_solves += other.num_solves;
+  num_iterations += other.num_iterations;
+  max_iterations = std::max(max_iterations, other.max_iterations);
+  num_failures += other.num_failures;
+  max_residual = std::max(max_residual, other.max_residual);
+  for (std::size_t k = 0; k < num_histogram_bins; k += 1)
+    iteration_histogram[k] += other.iteration_histogram[k];
+}
+
+void NewtonStatistics::reset() { *this = NewtonStatistics(); }
+
+double NewtonStatistics::average_iterations() const {
+  return num_solves > 0 ? static_cast<double>(num_iterations) / static_cast<double>(num_solves) : 0.;
+}
+
+NewtonStatistics reduce(MPI_Comm comm, const NewtonStatistics &stats) {
+  // all the counters are summed, except for the maxima
+  constexpr std::size_t num_sums = 3 + NewtonStatistics::num_histogram_bins;
+  std::array<unsigned long long, num_sums> local_sums{};
+  local_sums[0] = stats.num_solves;
+  local_sums[1] = stats.num_iterations;
+  local_sums[2] = stats.num_failures;
+  for (std::size_t k = 0; k < NewtonStatistics::num_histogram_bins; k += 1)
+    local_sums[3 + k] = stats.iteration_histogram[k];
+
+  std::array<unsigned long long, num_sums> global_sums{};
+  CHECK_MPI_SUCCESS(MPI_Allreduce(local_sums.data(), global_sums.data(), num_sums, MPI_UNSIGNED_LONG_LONG, MPI_SUM, comm));
+
+  unsigned long long local_max_iterations = stats.max_iterations;
+  unsigned long long global_max_iterations = 0;
+  CHECK_MPI_SUCCESS(MPI_Allreduce(&local_max_iterations, &global_max_iterations, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, comm));
+
+  double global_max_residual = 0;
+  CHECK_MPI_SUCCESS(MPI_Allreduce(&stats.max_residual, &global_max_residual, 1, MPI_DOUBLE, MPI_MAX, comm));
+
+  NewtonStatistics result;
+  result.num_solves = global_sums[0];
+  result.num_iterations = global_sums[1];
+  result.num_failures = global_sums[2];
+  for (std::size_t k = 0; k < NewtonStatistics::num_histogram_bins; k += 1)
+    result.iteration_histogram[k] = global_sums[3 + k];
+  result.max_iterations = global_max_iterations;
+  result.max_residual = global_max_residual;
+  return result;
+}
+
+std::ostream &operator<<(std::ostream &os, const NewtonStatistics &stats) {
+  os << "solves = " << stats.num_solves
+     << ", average iterations = " << stats.average_iterations()
+     << ", max iterations = " << stats.max_iterations
+     << ", failures = " << stats.num_failures
+     << ", max residual = " << stats.max_residual
+     << ", histogram = [";
+  for (std::size_t k = 0; k < NewtonStatistics::num_histogram_bins; k += 1) {
+    os << (k > 0 ? ", " : "") << k << (k + 1 == NewtonStatistics::num_histogram_bins ? "+: " : ": ") << stats.iteration_histogram[k];
+  }
+  os << "]";
+  return os;
+}
+
+} // namespace macrocirculation
@@ -0,0 +1,60 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_NEWTON_STATISTICS_HPP
+#define TUMORMODELS_NEWTON_STATISTICS_HPP
+
+#include <array>
+#include <cstddef>
+#include <mpi.h>
+#include <ostream>
+
+namespace macrocirculation {
+
+/*! @brief Counters for the convergence behavior of newton iterations, e.g. at the n-furcations of the upwinding.
+ *
+ *  Adding a solve only updates a few integers, hence the counters can stay enabled in production runs.
+ */
+struct NewtonStatistics {
+  /*! @brief The last histogram bin collects all solves with at least num_histogram_bins-1 iterations. */
+  static constexpr std::size_t num_histogram_bins = 8;
+
+  std::size_t num_solves = 0;
+
+  std::size_t num_iterations = 0;
+
+  std::size_t max_iterations = 0;
+
+  /*! @brief The number of solves which stopped at the maximum number of iterations without converging. */
+  std::size_t num_failures = 0;
+
+  /*! @brief The largest residual of all the solves after the last iteration. */
+  double max_residual = 0;
+
+  /*! @brief The ith entry counts the solves which needed i iterations. */
+  std::array<std::size_t, num_histogram_bins> iteration_histogram{};
+
+  /*! @brief Records the outcome of a single newton solve. */
+  void add(std::size_t iterations, double residual, bool converged);
+
+  /*! @brief Adds the counters of other to this object. */
+  void merge(const NewtonStatistics &other);
+
+  void reset();
+
+  double average_iterations() const;
+};
+
+/*! @brief Sums the statistics of all the ranks of the communicator. Has to be called collectively. */
+NewtonStatistics reduce(MPI_Comm comm, const NewtonStatistics &stats);
+
+/*! @brief Prints a short human readable summary with the iteration histogram. */
+std::ostream &operator<<(std::ostream &os, const NewtonStatistics &stats);
+
+} // namespace macrocirculation
+
+#endif
@@ -3,119 +3,392 @@
 #include "communication/mpi.hpp"
 #include "dof_map.hpp"
 #include "fe_type.hpp"
+#include "graph_partitioner.hpp"
 #include "graph_storage.hpp"
+#include "load_balancing.hpp"
+#include "numa.hpp"
+#include "phase_timers.hpp"
+#include "thread_pool.hpp"
 #include "vessel_formulas.hpp"
 
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <limits>
+#include <string>
 #include <utility>
 
 namespace macrocirculation {
 
-NonlinearFlowUpwindEvaluator::NonlinearFlowUpwindEvaluator(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, std::shared_ptr<DofMap> dof_map)
+namespace {
+
+std::vector<EdgeBoundaryField> flow_boundary_fields(const std::shared_ptr<DofMap> &dof_map, const std::vector<EdgeBoundaryField> &additional_fields) {
+  std::vector<EdgeBoundaryField> fields{{dof_map, 0}, {dof_map, 1}};
+  fields.insert(fields.end(), additional_fields.begin(), additional_fields.end());
+  return fields;
+}
+
+/*! @brief Returns the parameters, the pressure and the inflow of the model on the other side of a characteristic inflow.
+ *
+ *  A linearized model with the capacitance C and the inductance L per length is represented by the vessel at rest,
+ *  which has the same C and L with the density rho of the edge, i.e. A0 = rho / L and G0 = 2 A0 / C.
+ */
+void characteristic_inflow_state(const Vertex &vertex, double rho, VesselParameters &param, double &p, double &q) {
+  if (vertex.is_linear_characteristic_inflow()) {
+    const auto &data = vertex.get_linear_characteristic_data();
+    const double A0 = rho / data.L;
+    param = {2 * A0 / data.C, A0, rho};
+    p = data.p;
+    q = data.q;
+  } else {
+    const auto &data = vertex.get_nonlinear_characteristic_data();
+    param = {data.G0, data.A0, data.rho};
+    p = data.p;
+    q = data.q;
+  }
+}
+
+} // namespace
+
+NonlinearFlowUpwindEvaluator::NonlinearFlowUpwindEvaluator(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, std::shared_ptr<DofMap> dof_map, const std::vector<EdgeBoundaryField> &additional_fields)
     : d_comm(comm),
       d_graph(std::move(graph)),
       d_dof_map(std::move(dof_map)),
-      d_A_boundary_evaluator(comm, d_graph, d_dof_map, 1),
-      d_Q_boundary_evaluator(comm, d_graph, d_dof_map, 0),
-      d_Q_macro_edge_flux_l(d_graph->num_edges()),
-      d_Q_macro_edge_flux_r(d_graph->num_edges()),
-      d_A_macro_edge_flux_l(d_graph->num_edges()),
-      d_A_macro_edge_flux_r(d_graph->num_edges()),
-      d_current_t(NAN) {}
-
-void NonlinearFlowUpwindEvaluator::init(double t, const std::vector<double> &u_prev) {
-  d_current_t = t;
+      d_boundary_evaluator(comm, d_graph, flow_boundary_fields(d_dof_map, additional_fields)),
+      d_Q_macro_edge_flux_l(d_boundary_evaluator.get_local_edge_index().num_slots()),
+      d_Q_macro_edge_flux_r(d_boundary_evaluator.get_local_edge_index().num_slots()),
+      d_A_macro_edge_flux_l(d_boundary_evaluator.get_local_edge_index().num_slots()),
+      d_A_macro_edge_flux_r(d_boundary_evaluator.get_local_edge_index().num_slots()),
+      d_num_unsupported_leaves(0),
+      d_vertex_newton_statistics(d_graph->num_vertices()),
+      d_current_t(NAN),
+      d_current_u(nullptr),
+      d_inner_flux_t(NAN),
+      d_retain_u(nullptr),
+      d_retained{NAN, nullptr, {}, {}, {}, {}, {}, {}},
+      d_scratch(1) {
+  setup_inner_fluxes();
+  setup_vertex_work_lists();
+}
+
+NonlinearFlowUpwindEvaluator::~NonlinearFlowUpwindEvaluator() = default;
+
+void NonlinearFlowUpwindEvaluator::set_additional_fields(const std::vector<EdgeBoundaryField> &additional_fields) {
+  d_boundary_evaluator.set_fields(flow_boundary_fields(d_dof_map, additional_fields));
+  d_current_t = NAN;
+  d_inner_flux_t = NAN;
+}
+
+void NonlinearFlowUpwindEvaluator::init(double t, const std::vector<double> &u_prev, const std::vector<const std::vector<double> *> &additional_u_prev) {
+  start_init(t, u_prev, additional_u_prev);
+  finish_init(t, u_prev);
+}
+
+void NonlinearFlowUpwindEvaluator::start_init(double t, const std::vector<double> &u_prev, const std::vector<const std::vector<double> *> &additional_u_prev) {
+  SCOPED_PHASE_TIMER("upwinding start");
+  // the macro edge fluxes are invalid until the boundary values have arrived
+  d_current_t = NAN;
+
+  if (additional_u_prev.size() + 2 != d_boundary_evaluator.num_fields())
+    throw std::runtime_error("FlowUpwindEvaluator needs one vector for every additional field");
+
+  // the temporary arrays of the last stage are not needed anymore
+  for (auto &scratch : d_scratch)
+    scratch.reset();
+
+  // the vertex tasks on several threads only read the inflows
+  d_inflow_cache.update(t);
 
-  d_A_boundary_evaluator.init(u_prev);
-  d_Q_boundary_evaluator.init(u_prev);
+  // Q and A are evaluated from u_prev and the additional fields from their own vectors, all in one message per neighbor
+  d_boundary_evaluator.start_init(get_u_prev_per_field(u_prev, additional_u_prev));
+
+  // the inner fluxes only depend on our own edges, hence they are calculated while the messages are in flight
+  calculate_inner_fluxes(u_prev);
+  d_inner_flux_t = t;
+}
+
+void NonlinearFlowUpwindEvaluator::finish_init(double t, const std::vector<double> &u_prev) {
+  SCOPED_PHASE_TIMER("upwinding finish");
+  if (d_inner_flux_t != t)
+    throw std::runtime_error("FlowUpwindEvaluator::finish_init was called without start_init for the given time step");
+
+  d_boundary_evaluator.finish_init();
 
   calculate_nfurcation_fluxes(u_prev);
   calculate_inout_fluxes(t, u_prev);
+
+  complete_init(t, u_prev);
+}
+
+void NonlinearFlowUpwindEvaluator::complete_init(double t, const std::vector<double> &u_prev) {
+  d_current_t = t;
+  d_current_u = &u_prev;
+
+  if (d_retain_u == &u_prev) {
+    d_retained.t = t;
+    d_retained.u = &u_prev;
+    d_retained.Q_macro_edge_flux_l = d_Q_macro_edge_flux_l;
+    d_retained.Q_macro_edge_flux_r = d_Q_macro_edge_flux_r;
+    d_retained.A_macro_edge_flux_l = d_A_macro_edge_flux_l;
+    d_retained.A_macro_edge_flux_r = d_A_macro_edge_flux_r;
+    d_retained.Q_inner_flux = d_Q_inner_flux;
+    d_retained.A_inner_flux = d_A_inner_flux;
+    d_retain_u = nullptr;
+  }
+}
+
+const std::vector<const std::vector<double> *> &NonlinearFlowUpwindEvaluator::get_u_prev_per_field(const std::vector<double> &u_prev, const std::vector<const std::vector<double> *> &additional_u_prev) {
+  d_u_prev_per_field.resize(2 + additional_u_prev.size());
+  d_u_prev_per_field[Q_field] = &u_prev;
+  d_u_prev_per_field[A_field] = &u_prev;
+  std::copy(additional_u_prev.begin(), additional_u_prev.end(), d_u_prev_per_field.begin() + 2);
+  return d_u_prev_per_field;
+}
+
+void NonlinearFlowUpwindEvaluator::retain_fluxes_for(const std::vector<double> &u_prev) {
+  d_retain_u = &u_prev;
+}
+
+bool NonlinearFlowUpwindEvaluator::init_from(const NonlinearFlowUpwindEvaluator &source, double t, const std::vector<double> &u_prev, const std::vector<const std::vector<double> *> &additional_u_prev) {
+  const auto &retained = source.d_retained;
+  if (!source.has_retained_fluxes(t, u_prev))
+    return false;
+
+  // both evaluators have to store the fluxes of the same edges in the same layout
+  if (source.d_graph != d_graph || source.d_dof_map != d_dof_map || retained.Q_inner_flux.size() != d_Q_inner_flux.size() || retained.Q_macro_edge_flux_l.size() != d_Q_macro_edge_flux_l.size())
+    return false;
+
+  if (additional_u_prev.size() + 2 != d_boundary_evaluator.num_fields())
+    throw std::runtime_error("FlowUpwindEvaluator needs one vector for every additional field");
+
+  d_boundary_evaluator.start_init(get_u_prev_per_field(u_prev, additional_u_prev));
+
+  d_Q_macro_edge_flux_l = retained.Q_macro_edge_flux_l;
+  d_Q_macro_edge_flux_r = retained.Q_macro_edge_flux_r;
+  d_A_macro_edge_flux_l = retained.A_macro_edge_flux_l;
+  d_A_macro_edge_flux_r = retained.A_macro_edge_flux_r;
+  d_Q_inner_flux = retained.Q_inner_flux;
+  d_A_inner_flux = retained.A_inner_flux;
+
+  d_boundary_evaluator.finish_init();
+
+  d_inner_flux_t = t;
+  d_current_t = t;
+  d_current_u = &u_prev;
+  return true;
+}
+
+void NonlinearFlowUpwindEvaluator::get_inner_fluxes_on_macro_edge(double t, const Edge &edge, std::vector<double> &Q_up, std::vector<double> &A_up) const {
+  get_inner_fluxes_on_macro_edge(t, edge.get_id(), d_dof_map->get_local_dof_map(edge).num_micro_vertices(), Q_up, A_up);
+}
+
+void NonlinearFlowUpwindEvaluator::get_inner_fluxes_on_macro_edge(double t, std::size_t edge_id, std::size_t num_micro_vertices, std::vector<double> &Q_up, std::vector<double> &A_up) const {
+  if (d_inner_flux_t != t)
+    throw std::runtime_error("FlowUpwindEvaluator was not initialized for the given time step");
+
+  assert(Q_up.size() == num_micro_vertices);
+  assert(A_up.size() == num_micro_vertices);
+
+  const std::size_t offset = d_inner_flux_offset.at(slot(edge_id));
+  if (offset == std::numeric_limits<std::size_t>::max())
+    throw std::runtime_error("fluxes were not calculated on edge with id " + std::to_string(edge_id));
+
+  std::copy(d_Q_inner_flux.begin() + offset + 1, d_Q_inner_flux.begin() + offset + num_micro_vertices - 1, Q_up.begin() + 1);
+  std::copy(d_A_inner_flux.begin() + offset + 1, d_A_inner_flux.begin() + offset + num_micro_vertices - 1, A_up.begin() + 1);
+}
+
+void NonlinearFlowUpwindEvaluator::get_inner_flux_values(double t, std::size_t edge_id, const double *&Q_up, const double *&A_up) const {
+  if (d_inner_flux_t != t)
+    throw std::runtime_error("FlowUpwindEvaluator was not initialized for the given time step");
+
+  const std::size_t offset = d_inner_flux_offset.at(slot(edge_id));
+  if (offset == std::numeric_limits<std::size_t>::max())
+    throw std::runtime_error("fluxes were not calculated on edge with id " + std::to_string(edge_id));
+
+  Q_up = d_Q_inner_flux.data() + offset;
+  A_up = d_A_inner_flux.data() + offset;
 }
 
 void NonlinearFlowUpwindEvaluator::get_fluxes_on_macro_edge(double t, const Edge &edge, const std::vector<double> &u_prev, std::vector<double> &Q_up_macro_edge, std::vector<double> &A_up_macro_edge) const {
   // evaluator was initialized with the correct time step
   if (d_current_t != t)
     throw std::runtime_error("FlowUpwindEvaluator was not initialized for the given time step");
+  // the fluxes were cached by init, hence they belong to the solution passed there
+  if (d_current_u != &u_prev)
+    throw std::runtime_error("FlowUpwindEvaluator was not initialized for the given solution");
 
   const auto local_dof_map = d_dof_map->get_local_dof_map(edge);
+  const std::size_t num_micro_vertices = local_dof_map.num_micro_vertices();
 
-  assert(Q_up_macro_edge.size() == local_dof_map.num_micro_vertices());
-  assert(A_up_macro_edge.size() == local_dof_map.num_micro_vertices());
+  assert(Q_up_macro_edge.size() == num_micro_vertices);
+  assert(A_up_macro_edge.size() == num_micro_vertices);
 
-  const auto &param = edge.get_physical_data();
-  const double h = param.length / local_dof_map.num_micro_edges();
+  const std::size_t offset = d_inner_flux_offset.at(slot(edge.get_id()));
+  if (offset == std::numeric_limits<std::size_t>::max())
+    throw std::runtime_error("fluxes were not calculated on edge with id " + std::to_string(edge.get_id()));
 
-  const std::size_t num_basis_functions = local_dof_map.num_basis_functions();
+  // the fluxes at the inner micro vertices were calculated during init
+  std::copy(d_Q_inner_flux.begin() + offset, d_Q_inner_flux.begin() + offset + num_micro_vertices, Q_up_macro_edge.begin());
+  std::copy(d_A_inner_flux.begin() + offset, d_A_inner_flux.begin() + offset + num_micro_vertices, A_up_macro_edge.begin());
 
-  // TODO: Make this more efficient by not recalculating the gradients.
-  // finite-element for left and right edge
-  FETypeNetwork fe(create_trapezoidal_rule(), num_basis_functions - 1);
+  // update left fluxes
+  Q_up_macro_edge[0] = d_Q_macro_edge_flux_l[slot(edge.get_id())];
+  A_up_macro_edge[0] = d_A_macro_edge_flux_l[slot(edge.get_id())];
 
-  // dof indices for left and right edge
-  std::vector<std::size_t> Q_dof_indices_l(num_basis_functions, 0);
-  std::vector<std::size_t> A_dof_indices_l(num_basis_functions, 0);
-  std::vector<std::size_t> Q_dof_indices_r(num_basis_functions, 0);
-  std::vector<std::size_t> A_dof_indices_r(num_basis_functions, 0);
+  // update right fluxes
+  Q_up_macro_edge[num_micro_vertices - 1] = d_Q_macro_edge_flux_r[slot(edge.get_id())];
+  A_up_macro_edge[num_micro_vertices - 1] = d_A_macro_edge_flux_r[slot(edge.get_id())];
+}
 
-  // local views of our previous solution
-  std::vector<double> Q_prev_loc_l(num_basis_functions, 0);
-  std::vector<double> A_prev_loc_l(num_basis_functions, 0);
-  std::vector<double> Q_prev_loc_r(num_basis_functions, 0);
-  std::vector<double> A_prev_loc_r(num_basis_functions, 0);
+double NonlinearFlowUpwindEvaluator::get_additional_boundary_value(const Vertex &v, const Edge &edge, std::size_t k) const {
+  if (std::isnan(d_current_t))
+    throw std::runtime_error("FlowUpwindEvaluator was not initialized");
+  return d_boundary_evaluator(v, edge, 2 + k);
+}
 
-  // previous solution evaluated at quadrature points
-  // we have 2 quadrature points for the trapezoidal rule
-  std::vector<double> Q_prev_qp_l(2, 0);
-  std::vector<double> A_prev_qp_l(2, 0);
-  std::vector<double> Q_prev_qp_r(2, 0);
-  std::vector<double> A_prev_qp_r(2, 0);
+void NonlinearFlowUpwindEvaluator::get_fluxes_at_macro_edge_boundaries(double t, const Edge &edge, double &Q_l, double &A_l, double &Q_r, double &A_r) const {
+  get_fluxes_at_macro_edge_boundaries(t, edge.get_id(), Q_l, A_l, Q_r, A_r);
+}
 
-  fe.reinit(h);
+void NonlinearFlowUpwindEvaluator::get_fluxes_at_macro_edge_boundaries(double t, std::size_t edge_id, double &Q_l, double &A_l, double &Q_r, double &A_r) const {
+  if (d_current_t != t)
+    throw std::runtime_error("FlowUpwindEvaluator was not initialized for the given time step");
 
-  // TODO: the boundary values of each cell are evaluated twice
-  for (std::size_t micro_vertex_id = 1; micro_vertex_id < local_dof_map.num_micro_vertices() - 1; micro_vertex_id += 1) {
-    const std::size_t local_micro_edge_id_l = micro_vertex_id - 1;
-    const std::size_t local_micro_edge_id_r = micro_vertex_id;
+  Q_l = d_Q_macro_edge_flux_l[slot(edge_id)];
+  A_l = d_A_macro_edge_flux_l[slot(edge_id)];
+  Q_r = d_Q_macro_edge_flux_r[slot(edge_id)];
+  A_r = d_A_macro_edge_flux_r[slot(edge_id)];
+}
 
-    local_dof_map.dof_indices(local_micro_edge_id_l, 0, Q_dof_indices_l);
-    local_dof_map.dof_indices(local_micro_edge_id_r, 0, Q_dof_indices_r);
-    local_dof_map.dof_indices(local_micro_edge_id_l, 1, A_dof_indices_l);
-    local_dof_map.dof_indices(local_micro_edge_id_r, 1, A_dof_indices_r);
+void NonlinearFlowUpwindEvaluator::setup_inner_fluxes() {
+  d_inner_flux_edge_ids = d_graph->get_active_edge_ids(mpi::rank(d_comm));
+  d_inner_flux_offset.assign(d_boundary_evaluator.get_local_edge_index().num_slots(), std::numeric_limits<std::size_t>::max());
 
-    extract_dof(Q_dof_indices_l, u_prev, Q_prev_loc_l);
-    extract_dof(A_dof_indices_l, u_prev, A_prev_loc_l);
-    extract_dof(Q_dof_indices_r, u_prev, Q_prev_loc_r);
-    extract_dof(A_dof_indices_r, u_prev, A_prev_loc_r);
+  std::size_t offset = 0;
+  for (auto e_id : d_inner_flux_edge_ids) {
+    d_inner_flux_offset[slot(e_id)] = offset;
+    offset += d_dof_map->get_local_dof_map(d_graph->edge(e_id)).num_micro_vertices();
+  }
 
-    fe.evaluate_dof_at_quadrature_points(Q_prev_loc_l, Q_prev_qp_l);
-    fe.evaluate_dof_at_quadrature_points(A_prev_loc_l, A_prev_qp_l);
-    fe.evaluate_dof_at_quadrature_points(Q_prev_loc_r, Q_prev_qp_r);
-    fe.evaluate_dof_at_quadrature_points(A_prev_loc_r, A_prev_qp_r);
+  d_inner_flux_chunk_offsets = {0, d_inner_flux_edge_ids.size()};
 
-    const double Q_l = Q_prev_qp_l[1];
-    const double A_l = A_prev_qp_l[1];
-    const double Q_r = Q_prev_qp_r[0];
-    const double A_r = A_prev_qp_r[0];
+  d_Q_inner_flux.assign(offset, NAN);
+  d_A_inner_flux.assign(offset, NAN);
+}
 
-    const double W2_l = nonlinear::get_w2_from_QA(Q_l, A_l, param);
-    const double W1_r = nonlinear::get_w1_from_QA(Q_r, A_r, param);
+void NonlinearFlowUpwindEvaluator::setup_vertex_work_lists() {
+  d_fixed_flow_inflows.clear();
+  d_fixed_pressure_inflows.clear();
+  d_free_outflows.clear();
+  d_windkessel_outflows.clear();
+  d_characteristic_inflows.clear();
+  d_continuity_vertices.clear();
+  d_nfurcations.clear();
+  d_inflow_cache.clear();
+  d_num_unsupported_leaves = 0;
 
-    double Q_up = 0, A_up = 0;
+  for (const auto &v_id : d_graph->get_active_and_connected_vertex_ids(mpi::rank(d_comm))) {
+    const auto &vertex = d_graph->vertex(v_id);
+
+    if (vertex.is_leaf()) {
+      const auto &edge = d_graph->edge(vertex.get_edge_neighbors()[0]);
+      LeafWork leaf{v_id, edge.get_id(), edge.is_pointing_to(v_id), &edge.get_physical_data()};
+
+      if (vertex.is_inflow_with_fixed_flow() || vertex.is_inflow_with_fixed_pressure()) {
+        auto tabulation = d_inflow_tabulations.find(v_id);
+        if (tabulation != d_inflow_tabulations.end())
+          leaf.inflow = d_inflow_cache.add(tabulation->second);
+        else
+          leaf.inflow = d_inflow_cache.add([&vertex](double t) { return vertex.get_inflow_value(t); });
+      }
 
-    solve_W12(Q_up, A_up, W1_r, W2_l, param.G0, param.rho, param.A0);
+      if (vertex.is_inflow_with_fixed_flow())
+        d_fixed_flow_inflows.push_back(leaf);
+      else if (vertex.is_inflow_with_fixed_pressure())
+        d_fixed_pressure_inflows.push_back(leaf);
+      else if (vertex.is_free_outflow())
+        d_free_outflows.push_back(leaf);
+      else if (vertex.is_windkessel_outflow() || vertex.is_vessel_tree_outflow() || vertex.is_rcl_outflow())
+        d_windkessel_outflows.push_back({leaf, d_dof_map->get_local_dof_map(vertex).first_dof(), calculate_R1(edge.get_physical_data())});
+      else if (vertex.is_nonlinear_characteristic_inflow() || vertex.is_linear_characteristic_inflow())
+        d_characteristic_inflows.push_back(leaf);
+      else
+        d_num_unsupported_leaves += 1;
+    } else if (vertex.is_bifurcation()) {
+      const auto adjacent_edges = d_graph->adjacent_edges(v_id);
+
+      if (vertex.is_continuity_vertex() && adjacent_edges[0].pointing_to != adjacent_edges[1].pointing_to) {
+        const std::size_t in_idx = adjacent_edges[0].pointing_to ? 0 : 1;
+        const auto in_edge_id = adjacent_edges[in_idx].edge_id;
+        const auto out_edge_id = adjacent_edges[1 - in_idx].edge_id;
+        d_continuity_vertices.push_back({v_id, in_edge_id, out_edge_id, &d_graph->edge(in_edge_id).get_physical_data()});
+        continue;
+      }
 
-    Q_up_macro_edge[micro_vertex_id] = Q_up;
-    A_up_macro_edge[micro_vertex_id] = A_up;
+      NFurcationWork work{v_id, {}, {}, {}};
+      for (const auto &adjacent_edge : adjacent_edges) {
+        const auto &data_e = d_graph->edge(adjacent_edge.edge_id).get_physical_data();
+        work.edge_ids.push_back(adjacent_edge.edge_id);
+        work.pointing_to.push_back(adjacent_edge.pointing_to);
+        work.parameters.emplace_back(data_e.G0, data_e.A0, data_e.rho);
+      }
+      d_nfurcations.push_back(std::move(work));
+    }
   }
+}
 
-  // update left fluxes
-  Q_up_macro_edge[0] = d_Q_macro_edge_flux_l[edge.get_id()];
-  A_up_macro_edge[0] = d_A_macro_edge_flux_l[edge.get_id()];
+void NonlinearFlowUpwindEvaluator::calculate_inner_fluxes(const std::vector<double> &u_prev) {
+  SCOPED_PHASE_TIMER("inner upwinding");
+  parallel_for(d_thread_pool.get(), d_inner_flux_chunk_offsets, [&](std::size_t thread_id, std::size_t begin, std::size_t end) {
+    auto &scratch = d_scratch[thread_id];
+
+    for (std::size_t k = begin; k < end; k += 1) {
+      const auto &edge = d_graph->edge(d_inner_flux_edge_ids[k]);
+      const auto &local_dof_map = d_dof_map->get_local_dof_map(edge);
+      const auto &param = edge.get_physical_data();
+
+      const std::size_t num_micro_edges = local_dof_map.num_micro_edges();
+      const std::size_t num_basis_functions = local_dof_map.num_basis_functions();
+
+      // the traces of Q and A at the left and right boundary of every micro edge
+      double *Q_l = scratch.allocate<double>(num_micro_edges);
+      double *Q_r = scratch.allocate<double>(num_micro_edges);
+      double *A_l = scratch.allocate<double>(num_micro_edges);
+      double *A_r = scratch.allocate<double>(num_micro_edges);
+
+      // Evaluate the traces of every micro edge exactly once.
+      // The legendre polynomials are +1 at the right and (-1)^i at the left boundary.
+      for (std::size_t micro_edge_id = 0; micro_edge_id < num_micro_edges; micro_edge_id += 1) {
+        const double *Q_dofs = local_dof_map.dof_values(u_prev, micro_edge_id, 0);
+        const double *A_dofs = local_dof_map.dof_values(u_prev, micro_edge_id, 1);
+
+        double Q_left = 0, Q_right = 0, A_left = 0, A_right = 0;
+        for (std::size_t i = 0; i < num_basis_functions; i += 1) {
+          const double sgn = (i % 2 == 0) ? +1. : -1.;
+          Q_left += sgn * Q_dofs[i];
+          A_left += sgn * A_dofs[i];
+          Q_right += Q_dofs[i];
+          A_right += A_dofs[i];
+        }
 
-  // update right fluxes
-  Q_up_macro_edge[local_dof_map.num_micro_vertices() - 1] = d_Q_macro_edge_flux_r[edge.get_id()];
-  A_up_macro_edge[local_dof_map.num_micro_vertices() - 1] = d_A_macro_edge_flux_r[edge.get_id()];
+        Q_l[micro_edge_id] = Q_left;
+        Q_r[micro_edge_id] = Q_right;
+        A_l[micro_edge_id] = A_left;
+        A_r[micro_edge_id] = A_right;
+      }
+
+      double *Q_up = &d_Q_inner_flux[d_inner_flux_offset[slot(edge.get_id())]];
+      double *A_up = &d_A_inner_flux[d_inner_flux_offset[slot(edge.get_id())]];
+
+      // upwinding at the inner micro vertices in one batch, where the micro vertex k lies between the micro edges k-1 and k
+      const std::size_t num_inner = num_micro_edges - 1;
+      double *W1_r = scratch.allocate<double>(num_inner);
+      double *W2_l = scratch.allocate<double>(num_inner);
+      nonlinear::batch::get_w2_from_QA(num_inner, Q_r, A_r, param, W2_l, d_formula_tolerance);
+      nonlinear::batch::get_w1_from_QA(num_inner, Q_l + 1, A_l + 1, param, W1_r, d_formula_tolerance);
+      nonlinear::batch::solve_W12(num_inner, W1_r, W2_l, param, Q_up + 1, A_up + 1);
+    }
+  });
 }
 
 void NonlinearFlowUpwindEvaluator::get_fluxes_on_nfurcation(double t, const Vertex &v, std::vector<double> &Q_up, std::vector<double> &A_up) const {
@@ -127,70 +400,180 @@ void NonlinearFlowUpwindEvaluator::get_fluxes_on_nfurcation(double t, const Vert
   A_up.resize(v.get_edge_neighbors().size());
 
   for (size_t neighbor_edge_idx = 0; neighbor_edge_idx < v.get_edge_neighbors().size(); neighbor_edge_idx += 1) {
-    const auto &edge = *d_graph->get_edge(v.get_edge_neighbors()[neighbor_edge_idx]);
+    const auto &edge = d_graph->edge(v.get_edge_neighbors()[neighbor_edge_idx]);
 
     if (edge.is_pointing_to(v.get_id())) {
-      Q_up[neighbor_edge_idx] = d_Q_macro_edge_flux_r[edge.get_id()];
-      A_up[neighbor_edge_idx] = d_A_macro_edge_flux_r[edge.get_id()];
+      Q_up[neighbor_edge_idx] = d_Q_macro_edge_flux_r[slot(edge.get_id())];
+      A_up[neighbor_edge_idx] = d_A_macro_edge_flux_r[slot(edge.get_id())];
     } else {
-      Q_up[neighbor_edge_idx] = d_Q_macro_edge_flux_l[edge.get_id()];
-      A_up[neighbor_edge_idx] = d_A_macro_edge_flux_l[edge.get_id()];
+      Q_up[neighbor_edge_idx] = d_Q_macro_edge_flux_l[slot(edge.get_id())];
+      A_up[neighbor_edge_idx] = d_A_macro_edge_flux_l[slot(edge.get_id())];
     }
   }
 }
 
-void NonlinearFlowUpwindEvaluator::calculate_nfurcation_fluxes(const std::vector<double> &/*u_prev*/) {
-  for (const auto &v_id : d_graph->get_active_and_connected_vertex_ids(mpi::rank(d_comm))) {
-    const auto vertex = d_graph->get_vertex(v_id);
+const NewtonStatistics &NonlinearFlowUpwindEvaluator::get_newton_statistics(const Vertex &v) const {
+  return d_vertex_newton_statistics.at(v.get_id());
+}
+
+NewtonStatistics NonlinearFlowUpwindEvaluator::get_newton_statistics(bool reduce_over_ranks) const {
+  NewtonStatistics stats;
+  for (const auto &vertex_stats : d_vertex_newton_statistics)
+    stats.merge(vertex_stats);
+  return reduce_over_ranks ? reduce(d_comm, stats) : stats;
+}
 
-    // we only handle bifurcations
-    if (!vertex->is_bifurcation())
-      continue;
+void NonlinearFlowUpwindEvaluator::reset_newton_statistics() {
+  for (auto &vertex_stats : d_vertex_newton_statistics)
+    vertex_stats.reset();
+}
 
-    const size_t num_vessels = vertex->get_edge_neighbors().size();
+void NonlinearFlowUpwindEvaluator::set_thread_pool(std::shared_ptr<ThreadPool> pool) {
+  d_thread_pool = pool;
+  d_boundary_evaluator.set_thread_pool(pool);
+  d_scratch.resize(d_thread_pool ? d_thread_pool->num_threads() : 1);
+  d_inner_flux_chunk_offsets = partition_edges_among_threads(*d_graph, *d_dof_map, d_inner_flux_edge_ids, d_thread_pool ? d_thread_pool->num_threads() : 1);
+
+  // the inner fluxes of an edge chunk are written by its thread, hence they are placed on its NUMA node
+  std::vector<std::size_t> flux_chunk_offsets(d_inner_flux_chunk_offsets.size(), d_Q_inner_flux.size());
+  for (std::size_t k = 0; k + 1 < d_inner_flux_chunk_offsets.size(); k += 1) {
+    const auto e_idx = d_inner_flux_chunk_offsets[k];
+    if (e_idx < d_inner_flux_edge_ids.size())
+      flux_chunk_offsets[k] = d_inner_flux_offset[slot(d_inner_flux_edge_ids[e_idx])];
+  }
+  first_touch(d_thread_pool.get(), flux_chunk_offsets, d_Q_inner_flux);
+  first_touch(d_thread_pool.get(), flux_chunk_offsets, d_A_inner_flux);
+}
 
-    // get edges
-    std::vector<std::shared_ptr<Edge>> e;
-    for (size_t vessel_idx = 0; vessel_idx < num_vessels; vessel_idx += 1)
-      e.push_back(d_graph->get_edge(vertex->get_edge_neighbors()[vessel_idx]));
+void NonlinearFlowUpwindEvaluator::set_cost_measurement(std::shared_ptr<CostMeasurement> measurement) {
+  d_cost_measurement = std::move(measurement);
+}
 
-    // check orientation
-    std::vector<bool> e_in;
-    for (size_t vessel_idx = 0; vessel_idx < num_vessels; vessel_idx += 1)
-      e_in.push_back(e[vessel_idx]->is_pointing_to(vertex->get_id()));
+void NonlinearFlowUpwindEvaluator::set_formula_tolerance(double tolerance) {
+  d_formula_tolerance = tolerance;
+}
 
-    // get data
-    std::vector<VesselParameters> p_e;
-    for (size_t vessel_idx = 0; vessel_idx < num_vessels; vessel_idx += 1) {
-      const auto &data_e = e[vessel_idx]->get_physical_data();
-      p_e.emplace_back(data_e.G0, data_e.A0, data_e.rho);
-    }
+void NonlinearFlowUpwindEvaluator::set_inflow_tabulation(std::size_t vertex_id, tabulated_periodic_function tabulation) {
+  const auto &vertex = d_graph->vertex(vertex_id);
+  if (!vertex.is_inflow_with_fixed_flow() && !vertex.is_inflow_with_fixed_pressure())
+    throw std::runtime_error("only the inflow at a vertex with a fixed flow or pressure can be tabulated (vertex name = " + vertex.get_name() + ")");
 
-    // evaluate on edges
-    std::vector<double> Q_e(num_vessels);
-    std::vector<double> A_e(num_vessels);
-    d_Q_boundary_evaluator(*vertex, Q_e);
-    d_A_boundary_evaluator(*vertex, A_e);
-
-    // get upwinded values at bifurcation
-    std::vector<double> Q_up(num_vessels, 0);
-    std::vector<double> A_up(num_vessels, 0);
-    solve_at_nfurcation(Q_e, A_e, p_e, e_in, Q_up, A_up);
-
-    // save upwinded values into upwind vector
-    for (size_t vessel_idx = 0; vessel_idx < num_vessels; vessel_idx += 1) {
-      if (e_in[vessel_idx]) {
-        d_Q_macro_edge_flux_r[e[vessel_idx]->get_id()] = Q_up[vessel_idx];
-        d_A_macro_edge_flux_r[e[vessel_idx]->get_id()] = A_up[vessel_idx];
-      } else {
-        d_Q_macro_edge_flux_l[e[vessel_idx]->get_id()] = Q_up[vessel_idx];
-        d_A_macro_edge_flux_l[e[vessel_idx]->get_id()] = A_up[vessel_idx];
-      }
-    }
+  d_inflow_tabulations.insert_or_assign(vertex_id, std::move(tabulation));
+  setup_vertex_work_lists();
+  d_current_t = NAN;
+}
+
+void NonlinearFlowUpwindEvaluator::reinit() {
+  d_boundary_evaluator.reinit();
+  setup_inner_fluxes();
+  setup_vertex_work_lists();
+  set_thread_pool(d_thread_pool);
+  // the local edges were renumbered, and the fluxes of edges, which were owned by other ranks, are outdated anyway
+  const auto num_slots = d_boundary_evaluator.get_local_edge_index().num_slots();
+  for (auto *flux : {&d_Q_macro_edge_flux_l, &d_Q_macro_edge_flux_r, &d_A_macro_edge_flux_l, &d_A_macro_edge_flux_r}) {
+    flux->assign(num_slots, 0.);
+    flux->shrink_to_fit();
+  }
+  d_current_t = NAN;
+  d_inner_flux_t = NAN;
+  d_retain_u = nullptr;
+  d_retained = RetainedFluxes{NAN, nullptr, {}, {}, {}, {}, {}, {}};
+}
+
+void NonlinearFlowUpwindEvaluator::update_vertex_dofs() {
+  setup_vertex_work_lists();
+  // the fluxes at the 0D models depend on their new dofs
+  d_current_t = NAN;
+  d_retain_u = nullptr;
+  d_retained = RetainedFluxes{NAN, nullptr, {}, {}, {}, {}, {}, {}};
+}
+
+MemoryReport NonlinearFlowUpwindEvaluator::memory_report() const {
+  MemoryReport report;
+  report.add("boundary evaluator", d_boundary_evaluator.memory_report());
+  for (const auto *flux : {&d_Q_macro_edge_flux_l, &d_Q_macro_edge_flux_r, &d_A_macro_edge_flux_l, &d_A_macro_edge_flux_r})
+    report.add("macro edge fluxes", *flux);
+  report.add("inner fluxes", d_Q_inner_flux);
+  report.add("inner fluxes", d_A_inner_flux);
+  report.add("inner flux offsets", d_inner_flux_offset);
+  for (const auto *flux : {&d_retained.Q_macro_edge_flux_l, &d_retained.Q_macro_edge_flux_r, &d_retained.A_macro_edge_flux_l, &d_retained.A_macro_edge_flux_r, &d_retained.Q_inner_flux, &d_retained.A_inner_flux})
+    report.add("retained fluxes", *flux);
+  std::size_t work_list_bytes = d_inner_flux_edge_ids.capacity() * sizeof(std::size_t);
+  work_list_bytes += (d_fixed_flow_inflows.capacity() + d_fixed_pressure_inflows.capacity() + d_free_outflows.capacity() + d_characteristic_inflows.capacity()) * sizeof(LeafWork);
+  work_list_bytes += d_windkessel_outflows.capacity() * sizeof(WindkesselWork) + d_continuity_vertices.capacity() * sizeof(ContinuityWork);
+  for (const auto &work : d_nfurcations)
+    work_list_bytes += sizeof(NFurcationWork) + work.edge_ids.capacity() * sizeof(std::size_t) + work.parameters.capacity() * sizeof(VesselParameters) + work.pointing_to.capacity() / 8;
+  report.add("vertex work lists", work_list_bytes);
+  report.add("newton statistics", d_vertex_newton_statistics);
+  std::size_t scratch_bytes = d_u_prev_per_field.capacity() * sizeof(const std::vector<double> *);
+  for (const auto &scratch : d_scratch)
+    scratch_bytes += scratch.capacity();
+  report.add("scratch", scratch_bytes);
+  return report;
+}
+
+void NonlinearFlowUpwindEvaluator::calculate_nfurcation_fluxes(const std::vector<double> &/*u_prev*/) {
+  SCOPED_PHASE_TIMER("n-furcations");
+  // the vertex only joins two parts of a split vessel, hence we upwind exactly as on an inner micro vertex
+  parallel_for(d_thread_pool.get(), d_continuity_vertices.size(), [&](std::size_t, std::size_t begin, std::size_t end) {
+    for (std::size_t k = begin; k < end; k += 1)
+      upwind_continuity_vertex(d_continuity_vertices[k]);
+  });
+
+  // every n-furcation writes only the fluxes of its own edge boundaries, hence the vertices can be split among the threads
+  parallel_for(d_thread_pool.get(), d_nfurcations.size(), [&](std::size_t thread_id, std::size_t begin, std::size_t end) {
+    for (std::size_t k = begin; k < end; k += 1)
+      upwind_nfurcation(d_nfurcations[k], d_scratch[thread_id]);
+  });
+}
+
+void NonlinearFlowUpwindEvaluator::upwind_continuity_vertex(const ContinuityWork &work) {
+  ScopedCostTimer timer(d_cost_measurement.get(), ScopedCostTimer::Kind::vertex, work.vertex_id);
+
+  const auto &param = *work.param;
+  const double W2_l = nonlinear::get_w2_from_QA(d_boundary_evaluator.get_value(work.in_edge_id, true, Q_field), d_boundary_evaluator.get_value(work.in_edge_id, true, A_field), param);
+  const double W1_r = nonlinear::get_w1_from_QA(d_boundary_evaluator.get_value(work.out_edge_id, false, Q_field), d_boundary_evaluator.get_value(work.out_edge_id, false, A_field), param);
+  double Q_up = d_Q_macro_edge_flux_r[slot(work.in_edge_id)];
+  double A_up = d_A_macro_edge_flux_r[slot(work.in_edge_id)];
+  solve_W12(Q_up, A_up, W1_r, W2_l, param.G0, param.rho, param.A0);
+  set_macro_edge_flux(work.in_edge_id, true, Q_up, A_up);
+  set_macro_edge_flux(work.out_edge_id, false, Q_up, A_up);
+}
+
+void NonlinearFlowUpwindEvaluator::upwind_nfurcation(const NFurcationWork &work, ScratchArena &scratch) {
+  ScopedCostTimer timer(d_cost_measurement.get(), ScopedCostTimer::Kind::vertex, work.vertex_id);
+
+  // the traces and the upwinded values
+  const size_t num_vessels = work.edge_ids.size();
+  double *Q_e = scratch.allocate<double>(num_vessels);
+  double *A_e = scratch.allocate<double>(num_vessels);
+  double *Q_up = scratch.allocate<double>(num_vessels);
+  double *A_up = scratch.allocate<double>(num_vessels);
+
+  // the upwinded values of the last call are our initial guess
+  bool warm_start = true;
+  for (size_t vessel_idx = 0; vessel_idx < num_vessels; vessel_idx += 1) {
+    const auto e_id = work.edge_ids[vessel_idx];
+    const bool in = work.pointing_to[vessel_idx];
+    Q_e[vessel_idx] = d_boundary_evaluator.get_value(e_id, in, Q_field);
+    A_e[vessel_idx] = d_boundary_evaluator.get_value(e_id, in, A_field);
+    Q_up[vessel_idx] = in ? d_Q_macro_edge_flux_r[slot(e_id)] : d_Q_macro_edge_flux_l[slot(e_id)];
+    A_up[vessel_idx] = in ? d_A_macro_edge_flux_r[slot(e_id)] : d_A_macro_edge_flux_l[slot(e_id)];
+    warm_start = warm_start && A_up[vessel_idx] > 0;
   }
+
+  // get upwinded values at bifurcation
+  double residual = 0;
+  double *newton_scratch = scratch.allocate<double>(nfurcation_scratch_size(num_vessels));
+  const auto num_iter = solve_at_nfurcation(num_vessels, Q_e, A_e, work.parameters.data(), work.pointing_to, Q_up, A_up, warm_start, &residual, newton_scratch);
+  d_vertex_newton_statistics[work.vertex_id].add(num_iter, residual, num_iter < nfurcation_max_iterations);
+
+  // save upwinded values into upwind vector
+  for (size_t vessel_idx = 0; vessel_idx < num_vessels; vessel_idx += 1)
+    set_macro_edge_flux(work.edge_ids[vessel_idx], work.pointing_to[vessel_idx], Q_up[vessel_idx], A_up[vessel_idx]);
 }
 
-void calculate_windkessel_upwind_values(const PhysicalData &param, bool is_pointing_to, double R1, double Q_DG, double A_DG, double p_c, double &Q_out, double &A_out) {
+void calculate_windkessel_upwind_values(const PhysicalData &param, bool is_pointing_to, double R1, double Q_DG, double A_DG, double p_c, double A_init, double &Q_out, double &A_out, NewtonStatistics &stats) {
   const auto W = is_pointing_to ? nonlinear::get_w2_from_QA(Q_DG, A_DG, param)
                                 : nonlinear::get_w1_from_QA(Q_DG, A_DG, param);
 
@@ -198,171 +581,262 @@ void calculate_windkessel_upwind_values(const PhysicalData &param, bool is_point
 
   const auto f = [&](auto A_out) {
     auto p = param.G0 * (std::sqrt(A_out / param.A0) - 1);
-    return W - (p - p_c) / (A_out * R1) - 4 * c0 * std::pow(A_out / param.A0, 0.25);
+    return W - (p - p_c) / (A_out * R1) - 4 * c0 * std::sqrt(std::sqrt(A_out / param.A0));
   };
 
   const auto df = [&](auto A_out) {
     auto p = param.G0 * (std::sqrt(A_out / param.A0) - 1);
     auto dp = param.G0 * 0.5 / std::sqrt(A_out * param.A0);
-    return -dp / (A_out * R1) + (p - p_c) / (A_out * A_out * R1) - c0 * std::pow(A_out, -0.75) / std::pow(param.A0, 0.25);
+    // A^{-3/4} A0^{-1/4} = (A/A0)^{1/4} / A without calls to pow
+    return -dp / (A_out * R1) + (p - p_c) / (A_out * A_out * R1) - c0 * std::sqrt(std::sqrt(A_out / param.A0)) / A_out;
   };
 
   const double TOL = 1.0e-10;
   const double omega = 0.5 / 2.;
-  double error = INFINITY;
-  int num_iter = 0;
+  const int max_iter = 250;
 
-  A_out = A_DG;
+  A_out = A_init;
+
+  double error = std::abs(f(A_out));
+  int num_iter = 0;
 
-  while (num_iter < 250 && error > TOL) {
-    // std::cout << "f_prev" << f(A_out) << std::endl;
+  while (num_iter < max_iter && error > TOL) {
     const double f_value = f(A_out);
     const double df_value = df(A_out);
     const double dx = -f_value / df_value;
 
-    A_out = A_out + omega * dx;
+    // close to the solution the full newton step converges quadratically, otherwise we fall back to a damped step
+    const double A_full = A_out + dx;
+    const double error_full = A_full > 0 ? std::abs(f(A_full)) : INFINITY;
+    if (error_full < error) {
+      A_out = A_full;
+      error = error_full;
+    } else {
+      A_out = A_out + omega * dx;
+      error = std::abs(f(A_out));
+    }
 
-    error = std::abs(f(A_out));
     num_iter += 1;
 
-    // std::cout << "f_now " << f(A_out) << std::endl;
-    if (num_iter == 250)
+    if (num_iter == max_iter)
       std::cerr << "warning: Newton did not converge" << std::endl;
   }
 
+  stats.add(static_cast<std::size_t>(num_iter), error, error <= TOL);
+
   const double sgn = is_pointing_to ? +1 : -1;
 
   Q_out = sgn * (nonlinear::get_p_from_A(A_out, param.G0, param.A0) - p_c) / R1;
 }
 
 void NonlinearFlowUpwindEvaluator::calculate_inout_fluxes(double t, const std::vector<double> &u_prev) {
-  // initial value of the flow
-  // TODO: make this more generic for other initial flow values
-  const double Q_init = 0;
+  SCOPED_PHASE_TIMER("boundary conditions");
+  if (d_num_unsupported_leaves > 0)
+    throw std::runtime_error("undefined boundary type!");
 
-  for (const auto &v_id : d_graph->get_active_and_connected_vertex_ids(mpi::rank(d_comm))) {
-    const auto vertex = d_graph->get_vertex(v_id);
+  // usually the inflows were already evaluated by start_init
+  d_inflow_cache.update(t);
 
-    // exterior boundary
-    if (vertex->is_leaf()) {
-      const auto edge = d_graph->get_edge(vertex->get_edge_neighbors()[0]);
+  for (const auto &leaf : d_fixed_flow_inflows)
+    upwind_fixed_flow_inflow(leaf);
 
-      const auto &param = edge->get_physical_data();
+  for (const auto &leaf : d_fixed_pressure_inflows)
+    upwind_fixed_pressure_inflow(leaf);
 
-      // does the vessel point towards the vertex?
-      const bool in = edge->is_pointing_to(vertex->get_id());
+  for (const auto &leaf : d_free_outflows)
+    upwind_free_outflow(leaf);
 
-      const double Q = d_Q_boundary_evaluator(*vertex, *edge);
-      const double A = d_A_boundary_evaluator(*vertex, *edge);
+  for (const auto &work : d_windkessel_outflows)
+    upwind_windkessel_outflow(work, u_prev);
 
-      // inflow boundary
-      if (vertex->is_inflow_with_fixed_flow()) {
-        const double Q_star = (in ? -1 : +1) * vertex->get_inflow_value(t);
-        const double A_up = nonlinear::inflow::get_upwinded_A_from_Q(Q, A, in, Q_star, param);
+  for (const auto &leaf : d_characteristic_inflows)
+    upwind_characteristic_inflow(leaf);
+}
 
-        if (in) {
-          d_Q_macro_edge_flux_r[edge->get_id()] = Q_star;
-          d_A_macro_edge_flux_r[edge->get_id()] = A_up;
-        } else {
-          d_Q_macro_edge_flux_l[edge->get_id()] = Q_star;
-          d_A_macro_edge_flux_l[edge->get_id()] = A_up;
-        }
-      } else if (vertex->is_inflow_with_fixed_pressure()) {
-        const double p_up = vertex->get_inflow_value(t);
-        const double A_up = nonlinear::get_A_from_p(p_up, param.G0, param.A0);
-        const double Q_up = nonlinear::inflow::get_upwinded_Q_from_A(Q, A, (in ? +1 : -1), A_up, param);
-
-        if (in) {
-          d_Q_macro_edge_flux_r[edge->get_id()] = Q_up;
-          d_A_macro_edge_flux_r[edge->get_id()] = A_up;
-        } else {
-          d_Q_macro_edge_flux_l[edge->get_id()] = Q_up;
-          d_A_macro_edge_flux_l[edge->get_id()] = A_up;
-        }
-      } else if (vertex->is_free_outflow()) {
-        // TODO: make this more generic for other initial flow values
-        const double A_init = param.A0;
-
-        double W1, W2;
-
-        if (in) {
-          W1 = nonlinear::get_w1_from_QA(Q_init, A_init, param);
-          W2 = nonlinear::get_w2_from_QA(Q, A, param);
-        } else {
-          W1 = nonlinear::get_w1_from_QA(Q, A, param);
-          W2 = nonlinear::get_w2_from_QA(Q_init, A_init, param);
-        }
+void NonlinearFlowUpwindEvaluator::leaf_traces(const LeafWork &leaf, double &Q, double &A) const {
+  Q = d_boundary_evaluator.get_value(leaf.edge_id, leaf.pointing_to, Q_field);
+  A = d_boundary_evaluator.get_value(leaf.edge_id, leaf.pointing_to, A_field);
+}
 
-        double Q_up = 0, A_up = 0;
-        solve_W12(Q_up, A_up, W1, W2, param.G0, param.rho, param.A0);
+void NonlinearFlowUpwindEvaluator::upwind_fixed_flow_inflow(const LeafWork &leaf) {
+  ScopedCostTimer timer(d_cost_measurement.get(), ScopedCostTimer::Kind::vertex, leaf.vertex_id);
+  double Q, A;
+  leaf_traces(leaf, Q, A);
+  const bool in = leaf.pointing_to;
+  const double Q_star = (in ? -1 : +1) * d_inflow_cache.get(leaf.inflow);
+  const double A_up = nonlinear::inflow::get_upwinded_A_from_Q(Q, A, in, Q_star, *leaf.param);
+  set_macro_edge_flux(leaf.edge_id, in, Q_star, A_up);
+}
 
-        if (in) {
-          d_Q_macro_edge_flux_r[edge->get_id()] = Q_up;
-          d_A_macro_edge_flux_r[edge->get_id()] = A_up;
-        } else {
-          d_Q_macro_edge_flux_l[edge->get_id()] = Q_up;
-          d_A_macro_edge_flux_l[edge->get_id()] = A_up;
-        }
-      } else if (vertex->is_windkessel_outflow() || vertex->is_vessel_tree_outflow()) {
-        const bool is_pointing_to = edge->is_pointing_to(vertex->get_id());
+void NonlinearFlowUpwindEvaluator::upwind_fixed_pressure_inflow(const LeafWork &leaf) {
+  ScopedCostTimer timer(d_cost_measurement.get(), ScopedCostTimer::Kind::vertex, leaf.vertex_id);
+  double Q, A;
+  leaf_traces(leaf, Q, A);
+  const auto &param = *leaf.param;
+  const double p_up = d_inflow_cache.get(leaf.inflow);
+  const double A_up = nonlinear::get_A_from_p(p_up, param.G0, param.A0);
+  const double Q_up = nonlinear::inflow::get_upwinded_Q_from_A(Q, A, (leaf.pointing_to ? +1 : -1), A_up, param);
+  set_macro_edge_flux(leaf.edge_id, leaf.pointing_to, Q_up, A_up);
+}
 
-        const auto &vertex_dof_map = d_dof_map->get_local_dof_map(*vertex);
+void NonlinearFlowUpwindEvaluator::upwind_free_outflow(const LeafWork &leaf) {
+  ScopedCostTimer timer(d_cost_measurement.get(), ScopedCostTimer::Kind::vertex, leaf.vertex_id);
+  double Q, A;
+  leaf_traces(leaf, Q, A);
+  const auto &param = *leaf.param;
 
-        // check that we have dofs assigned for q and p
-        assert(vertex_dof_map.num_local_dof() == 1);
+  // TODO: make this more generic for other initial flow values
+  const double Q_init = 0;
+  const double A_init = param.A0;
+
+  double W1, W2;
+  if (leaf.pointing_to) {
+    W1 = nonlinear::get_w1_from_QA(Q_init, A_init, param);
+    W2 = nonlinear::get_w2_from_QA(Q, A, param);
+  } else {
+    W1 = nonlinear::get_w1_from_QA(Q, A, param);
+    W2 = nonlinear::get_w2_from_QA(Q_init, A_init, param);
+  }
 
-        // get Q and p add vessel tip
-        const auto &vertex_dofs = vertex_dof_map.dof_indices();
+  double Q_up = 0, A_up = 0;
+  solve_W12(Q_up, A_up, W1, W2, param.G0, param.rho, param.A0);
+  set_macro_edge_flux(leaf.edge_id, leaf.pointing_to, Q_up, A_up);
+}
 
-        const auto p_c = u_prev[vertex_dofs[0]];
+void NonlinearFlowUpwindEvaluator::upwind_windkessel_outflow(const WindkesselWork &work, const std::vector<double> &u_prev) {
+  const auto &leaf = work.leaf;
+  ScopedCostTimer timer(d_cost_measurement.get(), ScopedCostTimer::Kind::vertex, leaf.vertex_id);
+  double Q, A;
+  leaf_traces(leaf, Q, A);
 
-        const double R1 = calculate_R1(param);
+  // start the newton iteration from the last upwinded value, if available
+  const double A_prev = leaf.pointing_to ? d_A_macro_edge_flux_r[slot(leaf.edge_id)] : d_A_macro_edge_flux_l[slot(leaf.edge_id)];
+  const double A_init = A_prev > 0 ? A_prev : A;
 
-        double Q_out = 0;
-        double A_out = 0;
-        calculate_windkessel_upwind_values(param, is_pointing_to, R1, Q, A, p_c, Q_out, A_out);
+  double Q_out = 0;
+  double A_out = 0;
+  calculate_windkessel_upwind_values(*leaf.param, leaf.pointing_to, work.R1, Q, A, u_prev[work.p_c_dof], A_init, Q_out, A_out, d_vertex_newton_statistics[leaf.vertex_id]);
+  set_macro_edge_flux(leaf.edge_id, leaf.pointing_to, Q_out, A_out);
+}
 
-        if (is_pointing_to) {
-          d_Q_macro_edge_flux_r[edge->get_id()] = Q_out;
-          d_A_macro_edge_flux_r[edge->get_id()] = A_out;
-        } else {
-          d_Q_macro_edge_flux_l[edge->get_id()] = Q_out;
-          d_A_macro_edge_flux_l[edge->get_id()] = A_out;
-        }
-      } else if (vertex->is_nonlinear_characteristic_inflow()) {
+void NonlinearFlowUpwindEvaluator::upwind_characteristic_inflow(const LeafWork &leaf) {
+  ScopedCostTimer timer(d_cost_measurement.get(), ScopedCostTimer::Kind::vertex, leaf.vertex_id);
+  double Q, A;
+  leaf_traces(leaf, Q, A);
+  const auto &param = *leaf.param;
+
+  // the coupling values of the other model change in every step, hence we read them from the vertex
+  VesselParameters param_r;
+  double p_r = 0;
+  double q_r = 0;
+  characteristic_inflow_state(d_graph->vertex(leaf.vertex_id), param.rho, param_r, p_r, q_r);
+
+  double A_r = nonlinear::get_A_from_p(p_r, param_r.G0, param_r.A0);
+
+  // the edge and the other model are upwinded as a bifurcation, which needs no memory on the heap
+  const std::array<double, 2> Q_list = {Q, q_r};
+  const std::array<double, 2> A_list = {A, A_r};
+
+  std::array<double, 2> Q_up_list = Q_list;
+  std::array<double, 2> A_up_list = A_list;
+
+  // the last upwinded value on the edge is the initial guess, the characteristic of the 0D model is known anyway
+  const double Q_prev = leaf.pointing_to ? d_Q_macro_edge_flux_r[slot(leaf.edge_id)] : d_Q_macro_edge_flux_l[slot(leaf.edge_id)];
+  const double A_prev = leaf.pointing_to ? d_A_macro_edge_flux_r[slot(leaf.edge_id)] : d_A_macro_edge_flux_l[slot(leaf.edge_id)];
+  const bool warm_start = A_prev > 0;
+  if (warm_start) {
+    Q_up_list[0] = Q_prev;
+    A_up_list[0] = A_prev;
+  }
 
-        auto &data = vertex->get_nonlinear_characteristic_data();
+  const std::array<VesselParameters, 2> param_list = {{{param.G0, param.A0, param.rho}, param_r}};
 
-        double A_r = nonlinear::get_A_from_p(data, data.p);
+  const std::array<bool, 2> points_to_vertex_list = {leaf.pointing_to, true};
 
-        std::vector<double> Q_list = {Q, data.q};
-        std::vector<double> A_list = {A, A_r};
+  double residual = 0;
+  const auto num_iter = solve_at_nfurcation(2, Q_list.data(), A_list.data(), param_list.data(), points_to_vertex_list, Q_up_list.data(), A_up_list.data(), warm_start, &residual, static_cast<double *>(nullptr));
+  d_vertex_newton_statistics[leaf.vertex_id].add(num_iter, residual, num_iter < nfurcation_max_iterations);
 
-        std::vector<double> Q_up_list = Q_list;
-        std::vector<double> A_up_list = A_list;
+  set_macro_edge_flux(leaf.edge_id, leaf.pointing_to, Q_up_list[0], A_up_list[0]);
+}
 
-        std::vector<VesselParameters> param_list = {
-          {param.G0, param.A0, param.rho},
-          {data.G0, data.A0, data.rho}};
+template<typename ContinuityFun, typename NFurcationFun, typename LeafFun, typename WindkesselFun>
+void NonlinearFlowUpwindEvaluator::visit_vertex_task(std::size_t task, ContinuityFun continuity_fun, NFurcationFun nfurcation_fun, LeafFun leaf_fun, WindkesselFun windkessel_fun) const {
+  // the tasks are numbered by the work lists in the order of calculate_nfurcation_fluxes and calculate_inout_fluxes
+  if (task < d_continuity_vertices.size())
+    return continuity_fun(d_continuity_vertices[task]);
+  task -= d_continuity_vertices.size();
+  if (task < d_nfurcations.size())
+    return nfurcation_fun(d_nfurcations[task]);
+  task -= d_nfurcations.size();
+  if (task < d_fixed_flow_inflows.size())
+    return leaf_fun(d_fixed_flow_inflows[task], LeafType::fixed_flow);
+  task -= d_fixed_flow_inflows.size();
+  if (task < d_fixed_pressure_inflows.size())
+    return leaf_fun(d_fixed_pressure_inflows[task], LeafType::fixed_pressure);
+  task -= d_fixed_pressure_inflows.size();
+  if (task < d_free_outflows.size())
+    return leaf_fun(d_free_outflows[task], LeafType::free_outflow);
+  task -= d_free_outflows.size();
+  if (task < d_windkessel_outflows.size())
+    return windkessel_fun(d_windkessel_outflows[task]);
+  task -= d_windkessel_outflows.size();
+  if (task < d_characteristic_inflows.size())
+    return leaf_fun(d_characteristic_inflows[task], LeafType::characteristic);
+  throw std::runtime_error("vertex task " + std::to_string(task) + " does not exist");
+}
 
-        std::vector<bool> points_to_vertex_list = {
-          edge->is_pointing_to(v_id),
-          true};
+std::size_t NonlinearFlowUpwindEvaluator::num_vertex_tasks() const {
+  return d_continuity_vertices.size() + d_nfurcations.size() + d_fixed_flow_inflows.size() + d_fixed_pressure_inflows.size() + d_free_outflows.size() + d_windkessel_outflows.size() + d_characteristic_inflows.size();
+}
 
-        solve_at_nfurcation(Q_list, A_list, param_list, points_to_vertex_list, Q_up_list, A_up_list);
+std::size_t NonlinearFlowUpwindEvaluator::get_vertex_task_vertex_id(std::size_t task) const {
+  std::size_t vertex_id = 0;
+  visit_vertex_task(
+    task,
+    [&](const ContinuityWork &work) { vertex_id = work.vertex_id; },
+    [&](const NFurcationWork &work) { vertex_id = work.vertex_id; },
+    [&](const LeafWork &leaf, auto) { vertex_id = leaf.vertex_id; },
+    [&](const WindkesselWork &work) { vertex_id = work.leaf.vertex_id; });
+  return vertex_id;
+}
 
-        if (edge->is_pointing_to(v_id)) {
-          d_Q_macro_edge_flux_r[edge->get_id()] = Q_up_list[0];
-          d_A_macro_edge_flux_r[edge->get_id()] = A_up_list[0];
-        } else {
-          d_Q_macro_edge_flux_l[edge->get_id()] = Q_up_list[0];
-          d_A_macro_edge_flux_l[edge->get_id()] = A_up_list[0];
-        }
-      } else {
-        throw std::runtime_error("undefined boundary type!");
-      }
-    }
-  }
+void NonlinearFlowUpwindEvaluator::calculate_vertex_task(std::size_t task, std::size_t thread_id, const std::vector<double> &u_prev) {
+  visit_vertex_task(
+    task,
+    [&](const ContinuityWork &work) { upwind_continuity_vertex(work); },
+    [&](const NFurcationWork &work) { upwind_nfurcation(work, d_scratch[thread_id]); },
+    [&](const LeafWork &leaf, LeafType type) {
+      if (type == LeafType::fixed_flow)
+        upwind_fixed_flow_inflow(leaf);
+      else if (type == LeafType::fixed_pressure)
+        upwind_fixed_pressure_inflow(leaf);
+      else if (type == LeafType::free_outflow)
+        upwind_free_outflow(leaf);
+      else
+        upwind_characteristic_inflow(leaf);
+    },
+    [&](const WindkesselWork &work) { upwind_windkessel_outflow(work, u_prev); });
+}
+
+void NonlinearFlowUpwindEvaluator::get_vertex_task_fluxes(std::size_t edge_id, double &Q_l, double &A_l, double &Q_r, double &A_r) const {
+  Q_l = d_Q_macro_edge_flux_l[slot(edge_id)];
+  A_l = d_A_macro_edge_flux_l[slot(edge_id)];
+  Q_r = d_Q_macro_edge_flux_r[slot(edge_id)];
+  A_r = d_A_macro_edge_flux_r[slot(edge_id)];
+}
+
+void NonlinearFlowUpwindEvaluator::finish_vertex_tasks(double t, const std::vector<double> &u_prev) {
+  SCOPED_PHASE_TIMER("upwinding finish");
+  if (d_inner_flux_t != t)
+    throw std::runtime_error("FlowUpwindEvaluator::finish_vertex_tasks was called without start_init for the given time step");
+  if (d_num_unsupported_leaves > 0)
+    throw std::runtime_error("undefined boundary type!");
+
+  // all the messages have been received by the tasks, but the sends still have to complete
+  d_boundary_evaluator.finish_init();
+
+  complete_init(t, u_prev);
 }
 
 } // namespace macrocirculation
\ No newline at end of file
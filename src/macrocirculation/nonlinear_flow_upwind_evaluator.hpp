@@ -8,11 +8,15 @@
 #ifndef TUMORMODELS_NONLINEAR_FLOW_UPWIND_EVALUATOR_HPP
 #define TUMORMODELS_NONLINEAR_FLOW_UPWIND_EVALUATOR_HPP
 
+#include <map>
 #include <mpi.h>
 #include <memory>
 #include <vector>
 
+#include "boundary_function_cache.hpp"
 #include "edge_boundary_evaluator.hpp"
+#include "newton_statistics.hpp"
+#include "scratch_arena.hpp"
 
 namespace macrocirculation {
 
@@ -21,6 +25,10 @@ class GraphStorage;
 class DofMap;
 class Vertex;
 class Edge;
+class ThreadPool;
+class CostMeasurement;
+struct PhysicalData;
+struct VesselParameters;
 
 /*! @brief Class for calculating the currently upwinded values for the flow (Q, A).
  *
@@ -29,17 +37,102 @@ class Edge;
  */
 class NonlinearFlowUpwindEvaluator {
 public:
-  NonlinearFlowUpwindEvaluator(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, std::shared_ptr<DofMap> dof_map);
+  /*! @brief Constructs the evaluator for Q and A in the given dof map.
+   *
+   * @param additional_fields Further fields, e.g. a transported quantity, whose macro edge boundary values
+   *                          are sent together with Q and A, such that only one exchange is necessary.
+   */
+  NonlinearFlowUpwindEvaluator(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, std::shared_ptr<DofMap> dof_map, const std::vector<EdgeBoundaryField> &additional_fields = {});
+
+  ~NonlinearFlowUpwindEvaluator();
+
+  /*! @brief Replaces the additional fields of the constructor, e.g. to send a transported quantity together with the flow of a solver.
+   *         The fluxes have to be recalculated afterwards.
+   */
+  void set_additional_fields(const std::vector<EdgeBoundaryField> &additional_fields);
+
+  /*! @returns The number of additional fields, for which init needs a vector. */
+  std::size_t num_additional_fields() const { return d_boundary_evaluator.num_fields() - 2; }
 
-  void init(double t, const std::vector<double> &u_prev);
+  /*! @brief Calculates all the fluxes for the given solution.
+   *         The k-th additional field is evaluated for the k-th vector of additional_u_prev.
+   */
+  void init(double t, const std::vector<double> &u_prev, const std::vector<const std::vector<double> *> &additional_u_prev = {});
+
+  /*! @brief First half of init, which starts the communication of the macro edge boundary values
+   *         and calculates the fluxes at the inner micro vertices, which need no data from other ranks.
+   *         Until finish_init is called, only get_inner_fluxes_on_macro_edge may be used.
+   */
+  void start_init(double t, const std::vector<double> &u_prev, const std::vector<const std::vector<double> *> &additional_u_prev = {});
+
+  /*! @brief Second half of init, which waits for the boundary values and calculates the fluxes at the macro edge boundaries. */
+  void finish_init(double t, const std::vector<double> &u_prev);
+
+  /*! @brief Returns the number of vertex tasks, which replace finish_init in a task based evaluation.
+   *         Every task upwinds the fluxes at one vertex and only writes the fluxes of the edge boundaries at this vertex.
+   */
+  std::size_t num_vertex_tasks() const;
+
+  /*! @brief Returns the id of the vertex of the given vertex task. */
+  std::size_t get_vertex_task_vertex_id(std::size_t task) const;
+
+  /*! @brief Upwinds the fluxes of the given vertex task after start_init.
+   *         The boundary values of all the edges at the vertex have to be available, i.e. those of the ghost edges have to be
+   *         received by get_boundary_evaluator().progress_init. Different tasks can run concurrently on different threads.
+   */
+  void calculate_vertex_task(std::size_t task, std::size_t thread_id, const std::vector<double> &u_prev);
+
+  /*! @brief Returns the fluxes at the boundaries of the given edge, whose vertex tasks are done, while other vertex tasks may still run. */
+  void get_vertex_task_fluxes(std::size_t edge_id, double &Q_l, double &A_l, double &Q_r, double &A_r) const;
+
+  /*! @brief Replaces finish_init after all the vertex tasks are done and all the ghost values were received. */
+  void finish_vertex_tasks(double t, const std::vector<double> &u_prev);
+
+  /*! @brief Keeps a copy of the fluxes of the next init for the given solution vector,
+   *         such that other evaluators can still consume them after further inits with other vectors, see init_from.
+   *         The flow solver uses this to share the fluxes at the beginning of every time step.
+   */
+  void retain_fluxes_for(const std::vector<double> &u_prev);
+
+  /*! @returns True, if fluxes were retained for the given time and solution vector. */
+  bool has_retained_fluxes(double t, const std::vector<double> &u_prev) const { return d_retained.t == t && d_retained.u == &u_prev; }
+
+  /*! @brief Works like init, but takes the flow fluxes, which the source retained for the given time and solution,
+   *         instead of recalculating them. Only the macro edge boundary values, e.g. of the additional fields, are exchanged.
+   *
+   * @return False, if the source has retained no matching fluxes. Nothing is initialized then.
+   */
+  bool init_from(const NonlinearFlowUpwindEvaluator &source, double t, const std::vector<double> &u_prev, const std::vector<const std::vector<double> *> &additional_u_prev = {});
 
-  /*! @brief Recalculates the current fluxes from the given time.
+  /*! @brief Returns the fluxes, which init calculated for the given time, at the micro vertices of the edge.
    *
    * @param t       The current time for the inflow boundary conditions.
-   * @param u_prev  The solution for which we calculate the fluxes.
+   * @param u_prev  The solution for which we calculate the fluxes, which has to be the vector passed to init.
    */
   void get_fluxes_on_macro_edge(double t, const Edge &edge, const std::vector<double> &u_prev, std::vector<double> &Q_up, std::vector<double> &A_up) const;
 
+  /*! @brief Returns the fluxes at the inner micro vertices of the given macro edge, which are available after start_init.
+   *         The entries at the two macro edge boundaries are left untouched.
+   */
+  void get_inner_fluxes_on_macro_edge(double t, const Edge &edge, std::vector<double> &Q_up, std::vector<double> &A_up) const;
+
+  /*! @brief Same as above for an edge with the given id and number of micro vertices, such that the kernels do not need the graph. */
+  void get_inner_fluxes_on_macro_edge(double t, std::size_t edge_id, std::size_t num_micro_vertices, std::vector<double> &Q_up, std::vector<double> &A_up) const;
+
+  /*! @brief Returns pointers to the fluxes at the micro vertices of the given macro edge without copying them, e.g. for the batched kernels.
+   *         Only the values at the inner micro vertices are valid, and only until the next init.
+   */
+  void get_inner_flux_values(double t, std::size_t edge_id, const double *&Q_up, const double *&A_up) const;
+
+  /*! @brief Returns the value of the k-th additional field at the given vertex on the given macro edge. */
+  double get_additional_boundary_value(const Vertex &v, const Edge &edge, std::size_t k = 0) const;
+
+  /*! @brief Returns the fluxes at the left and right boundary of the given macro edge. */
+  void get_fluxes_at_macro_edge_boundaries(double t, const Edge &edge, double &Q_l, double &A_l, double &Q_r, double &A_r) const;
+
+  /*! @brief Same as above for the edge with the given id. */
+  void get_fluxes_at_macro_edge_boundaries(double t, std::size_t edge_id, double &Q_l, double &A_l, double &Q_r, double &A_r) const;
+
   /*! @brief Recalculates the current flux values of (Q, A) at the given nfurcation.
    *
    * @param t       The current time for the inflow boundary conditions.
@@ -47,6 +140,53 @@ public:
    */
   void get_fluxes_on_nfurcation(double t, const Vertex &v, std::vector<double> &Q_up, std::vector<double> &A_up) const;
 
+  /*! @brief Returns the convergence statistics of the newton solves at the given vertex since the last reset. */
+  const NewtonStatistics &get_newton_statistics(const Vertex &v) const;
+
+  /*! @brief Returns the accumulated convergence statistics of the newton solves on all the vertices of this rank.
+   *         If reduce_over_ranks is true, the statistics are summed over all the ranks, and the call is collective.
+   */
+  NewtonStatistics get_newton_statistics(bool reduce_over_ranks = false) const;
+
+  void reset_newton_statistics();
+
+  /*! @brief Splits the edge and n-furcation loops among the threads of the given pool. */
+  void set_thread_pool(std::shared_ptr<ThreadPool> pool);
+
+  /*! @brief Measures the computation times of the upwinding at the vertices, if a measurement is given. */
+  void set_cost_measurement(std::shared_ptr<CostMeasurement> measurement);
+
+  /*! @brief Sets the relative tolerance of the characteristics at the inner micro vertices.
+   *         From nonlinear::batch::fast_tolerance on, their roots are evaluated in single precision.
+   *         The default of zero keeps double precision.
+   */
+  void set_formula_tolerance(double tolerance);
+
+  /*! @brief Replaces the function of the inflow at the given vertex, which has a fixed flow or pressure, by a precomputed tabulation. */
+  void set_inflow_tabulation(std::size_t vertex_id, tabulated_periodic_function tabulation);
+
+  /*! @brief Returns the values of the inflows of our vertices, which are evaluated once for the time of every start_init. */
+  const BoundaryFunctionCache &get_inflow_cache() const { return d_inflow_cache; }
+
+  /*! @brief Rebuilds the communication, the flux storage of the active edges and the vertex work lists,
+   *         e.g. after the graph was repartitioned or the boundary types were changed.
+   *         The newton iterations at the vertices start without their previous solutions afterwards.
+   */
+  void reinit();
+
+  /*! @brief Rebuilds only the work lists of the vertices after the dofs of the 0D models were renumbered,
+   *         while the edges, their dofs and hence the inner fluxes and the communication stay the same.
+   */
+  void update_vertex_dofs();
+
+  /*! @brief Returns the evaluator, which evaluates and communicates the values at the macro edge boundaries. */
+  const EdgeBoundaryEvaluator &get_boundary_evaluator() const { return d_boundary_evaluator; }
+
+  EdgeBoundaryEvaluator &get_boundary_evaluator() { return d_boundary_evaluator; }
+
+  /*! @brief Returns the memory of the fluxes, the boundary values and the vertex work lists. */
+  MemoryReport memory_report() const;
+
 private:
   /*! @brief Calculates the fluxes at nfurcations for the given time step at the macro edge boundaries.
    *
@@ -60,6 +200,30 @@ private:
    */
   void calculate_inout_fluxes(double t, const std::vector<double> &u_prev);
 
+  /*! @brief Marks the fluxes as valid for the time t and retains them if requested. */
+  void complete_init(double t, const std::vector<double> &u_prev);
+
+  /*! @brief Calculates the fluxes at the inner micro vertices of all the active macro edges.
+   *
+   * @param u_prev  The solution for which we calculate the fluxes.
+   */
+  void calculate_inner_fluxes(const std::vector<double> &u_prev);
+
+  /*! @brief Reserves the storage for the fluxes at the inner micro vertices. */
+  void setup_inner_fluxes();
+
+  /*! @brief Sorts the active and connected vertices into homogeneous work lists by their type. */
+  void setup_vertex_work_lists();
+
+  /*! @brief Stores the upwinded values at the left (right = false) or right (right = true) boundary of the given edge. */
+  void set_macro_edge_flux(std::size_t edge_id, bool right, double Q, double A) {
+    (right ? d_Q_macro_edge_flux_r : d_Q_macro_edge_flux_l)[slot(edge_id)] = Q;
+    (right ? d_A_macro_edge_flux_r : d_A_macro_edge_flux_l)[slot(edge_id)] = A;
+  }
+
+  /*! @brief The index of the given edge inside the macro edge flux vectors. */
+  std::size_t slot(std::size_t edge_id) const { return d_boundary_evaluator.get_local_edge_index()(edge_id); }
+
 private:
   MPI_Comm d_comm;
 
@@ -69,23 +233,161 @@ private:
   /*! @brief The dof map for our domain */
   std::shared_ptr<DofMap> d_dof_map;
 
-  /*! @brief Stores the values of the A-component at the macro-edge boundaries. */
-  EdgeBoundaryEvaluator d_A_boundary_evaluator;
+  /*! @brief The indices of Q and A inside the boundary evaluator, the additional fields follow after them. */
+  static constexpr std::size_t Q_field = 0;
+  static constexpr std::size_t A_field = 1;
 
-  /*! @brief Stores the values of the Q-component at the macro-edge boundaries. */
-  EdgeBoundaryEvaluator d_Q_boundary_evaluator;
+  /*! @brief Stores the values of Q, A and the additional fields at the macro-edge boundaries. */
+  EdgeBoundaryEvaluator d_boundary_evaluator;
 
-  /*! @brief Contains the flux-values of Q at the left boundary point of the given macro-edge.
-    *         The ith vector entry corresponds to the ith macro-edge id.
+  /*! @brief Contains the flux-values of Q at the left boundary point of the local macro-edges.
+    *         The entries are ordered by the local edge index of the boundary evaluator, see slot.
     */
   std::vector<double> d_Q_macro_edge_flux_l;
   std::vector<double> d_Q_macro_edge_flux_r;
   std::vector<double> d_A_macro_edge_flux_l;
   std::vector<double> d_A_macro_edge_flux_r;
 
+  /*! @brief The active edges for which we cache the fluxes at the inner micro vertices. */
+  std::vector<std::size_t> d_inner_flux_edge_ids;
+
+  /*! @brief The chunks of d_inner_flux_edge_ids, which the threads of the pool work on. */
+  std::vector<std::size_t> d_inner_flux_chunk_offsets;
+
+  /*! @brief The offset of the micro vertex fluxes of an edge inside the inner flux vectors, indexed by the slot of the edge. */
+  std::vector<std::size_t> d_inner_flux_offset;
+
+  /*! @brief The fluxes at all the micro vertices of the active edges, for the current time step. */
+  std::vector<double> d_Q_inner_flux;
+  std::vector<double> d_A_inner_flux;
+
+  /*! @brief The boundary of a macro edge at a leaf, i.e. the only edge of the vertex. */
+  struct LeafWork {
+    std::size_t vertex_id;
+    std::size_t edge_id;
+    /*! @brief True, if the vertex is at the right boundary of the edge. */
+    bool pointing_to;
+    const PhysicalData *param;
+    /*! @brief The index of the inflow function inside the inflow cache, only used for fixed flows and pressures. */
+    std::size_t inflow{0};
+  };
+
+  /*! @brief A windkessel, vessel tree or rcl outflow, which is coupled through the pressure of its first compartment. */
+  struct WindkesselWork {
+    LeafWork leaf;
+    std::size_t p_c_dof;
+    double R1;
+  };
+
+  /*! @brief A vertex joining the two parts of a split vessel, which is upwinded as an inner micro vertex. */
+  struct ContinuityWork {
+    std::size_t vertex_id;
+    std::size_t in_edge_id;
+    std::size_t out_edge_id;
+    const PhysicalData *param;
+  };
+
+  /*! @brief An n-furcation with its edges, orientations and parameters packed for solve_at_nfurcation. */
+  struct NFurcationWork {
+    std::size_t vertex_id;
+    std::vector<std::size_t> edge_ids;
+    std::vector<bool> pointing_to;
+    std::vector<VesselParameters> parameters;
+  };
+
+  /*! @brief The work lists of the active and connected vertices, which are built once for every partition. */
+  std::vector<LeafWork> d_fixed_flow_inflows;
+  std::vector<LeafWork> d_fixed_pressure_inflows;
+  std::vector<LeafWork> d_free_outflows;
+  std::vector<WindkesselWork> d_windkessel_outflows;
+  std::vector<LeafWork> d_characteristic_inflows;
+  std::vector<ContinuityWork> d_continuity_vertices;
+  std::vector<NFurcationWork> d_nfurcations;
+
+  /*! @brief Upwind the fluxes at a single vertex of the work lists. */
+  void upwind_continuity_vertex(const ContinuityWork &work);
+  void upwind_nfurcation(const NFurcationWork &work, ScratchArena &scratch);
+  void upwind_fixed_flow_inflow(const LeafWork &leaf);
+  void upwind_fixed_pressure_inflow(const LeafWork &leaf);
+  void upwind_free_outflow(const LeafWork &leaf);
+  void upwind_windkessel_outflow(const WindkesselWork &work, const std::vector<double> &u_prev);
+  void upwind_characteristic_inflow(const LeafWork &leaf);
+
+  /*! @brief Returns the traces of Q and A of the edge at the leaf. */
+  void leaf_traces(const LeafWork &leaf, double &Q, double &A) const;
+
+  /*! @brief The work lists of leaves, which share the type LeafWork. */
+  enum class LeafType { fixed_flow, fixed_pressure, free_outflow, characteristic };
+
+  /*! @brief Calls the function for the type of work item of the given vertex task. */
+  template<typename ContinuityFun, typename NFurcationFun, typename LeafFun, typename WindkesselFun>
+  void visit_vertex_task(std::size_t task, ContinuityFun continuity_fun, NFurcationFun nfurcation_fun, LeafFun leaf_fun, WindkesselFun windkessel_fun) const;
+
+  /*! @brief The values of the inflow functions of the fixed flow and pressure leaves at the current stage time. */
+  BoundaryFunctionCache d_inflow_cache;
+
+  /*! @brief The tabulations, which replace the inflow functions of the given vertices. */
+  std::map<std::size_t, tabulated_periodic_function> d_inflow_tabulations;
+
+  /*! @brief The number of leaves with a boundary type, which the upwinding does not support. */
+  std::size_t d_num_unsupported_leaves;
+
+  /*! @brief The statistics of the newton solves at n-furcations and boundaries, indexed by the vertex id. */
+  std::vector<NewtonStatistics> d_vertex_newton_statistics;
+
+  /*! @brief The time for which the macro edge fluxes were calculated. */
   double d_current_t;
+
+  /*! @brief The solution vector, for which the fluxes were calculated. */
+  const std::vector<double> *d_current_u;
+
+  /*! @brief The time for which the fluxes at the inner micro vertices were calculated. */
+  double d_inner_flux_t;
+
+  /*! @brief The solution vector, for whose next init the fluxes are retained, or nullptr. */
+  const std::vector<double> *d_retain_u;
+
+  /*! @brief A copy of the macro edge and inner fluxes, which were retained for the solution vector u at the time t. */
+  struct RetainedFluxes {
+    double t;
+    const std::vector<double> *u;
+    std::vector<double> Q_macro_edge_flux_l;
+    std::vector<double> Q_macro_edge_flux_r;
+    std::vector<double> A_macro_edge_flux_l;
+    std::vector<double> A_macro_edge_flux_r;
+    std::vector<double> Q_inner_flux;
+    std::vector<double> A_inner_flux;
+  };
+
+  RetainedFluxes d_retained;
+
+  /*! @brief Optional thread pool for the n-furcation loop. */
+  std::shared_ptr<ThreadPool> d_thread_pool;
+
+  /*! @brief The temporary arrays of the upwinding, one arena per thread, which are released at the start of every stage. */
+  std::vector<ScratchArena> d_scratch;
+
+  /*! @brief The vectors of Q, A and the additional fields for the boundary evaluator, which are reused in every stage. */
+  std::vector<const std::vector<double> *> d_u_prev_per_field;
+
+  /*! @brief Returns the vectors of Q, A and the additional fields for the boundary evaluator. */
+  const std::vector<const std::vector<double> *> &get_u_prev_per_field(const std::vector<double> &u_prev, const std::vector<const std::vector<double> *> &additional_u_prev);
+
+  /*! @brief Optional measurement of the computation times at the vertices. */
+  std::shared_ptr<CostMeasurement> d_cost_measurement;
+
+  /*! @brief The relative tolerance of the batch formulas at the inner micro vertices. */
+  double d_formula_tolerance{0};
 };
 
+/*! @brief Upwinds the flow into a windkessel, whose first compartment has the pressure p_c, with a damped newton iteration.
+ *
+ * @param R1       The characteristic resistance of the vessel.
+ * @param A_init   The initial guess for the upwinded area, e.g. of the previous evaluation.
+ * @param stats    Records the newton iterations.
+ */
+void calculate_windkessel_upwind_values(const PhysicalData &param, bool is_pointing_to, double R1, double Q_DG, double A_DG, double p_c, double A_init, double &Q_out, double &A_out, NewtonStatistics &stats);
+
 } // namespace macrocirculation
 
 #endif
\ No newline at end of file
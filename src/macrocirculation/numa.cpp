@@ -0,0 +1,99 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "numa.hpp"
+
+#include <cstdint>
+#include <sstream>
+
+#include "communication/mpi.hpp"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace macrocirculation {
+
+std::vector<int> parse_core_list(const std::string &cores) {
+  std::vector<int> core_ids;
+  std::stringstream ss(cores);
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    if (range.empty())
+      continue;
+    try {
+      std::size_t pos = 0;
+      const int first = std::stoi(range, &pos);
+      int last = first;
+      if (pos < range.size()) {
+        if (range[pos] != '-')
+          throw std::invalid_argument(range);
+        std::size_t pos_last = 0;
+        last = std::stoi(range.substr(pos + 1), &pos_last);
+        if (pos + 1 + pos_last != range.size())
+          throw std::invalid_argument(range);
+      }
+      if (first < 0 || last < first)
+        throw std::invalid_argument(range);
+      for (int core = first; core <= last; core += 1)
+        core_ids.push_back(core);
+    } catch (const std::logic_error &) {
+      throw std::runtime_error("parse_core_list: invalid range " + range + " in the core list " + cores);
+    }
+  }
+  return core_ids;
+}
+
+std::vector<int> select_cores_of_rank(MPI_Comm comm, const std::vector<int> &node_cores, std::size_t num_threads) {
+  if (node_cores.empty())
+    return {};
+
+  MPI_Comm node_comm;
+  CHECK_MPI_SUCCESS(MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, mpi::rank(comm), MPI_INFO_NULL, &node_comm));
+  const auto node_rank = static_cast<std::size_t>(mpi::rank(node_comm));
+  CHECK_MPI_SUCCESS(MPI_Comm_free(&node_comm));
+
+  num_threads = std::max<std::size_t>(num_threads, 1);
+  std::vector<int> cores;
+  for (std::size_t k = 0; k < num_threads; k += 1)
+    cores.push_back(node_cores[(node_rank * num_threads + k) % node_cores.size()]);
+  return cores;
+}
+
+void pin_thread_to_core(int core) {
+#ifdef __linux__
+  if (core < 0 || core >= CPU_SETSIZE)
+    throw std::runtime_error("pin_thread_to_core: invalid core " + std::to_string(core));
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(core, &cpu_set);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set) != 0)
+    throw std::runtime_error("pin_thread_to_core: the thread could not be bound to core " + std::to_string(core));
+#else
+  throw std::runtime_error("pin_thread_to_core: binding threads to cores is not supported on this platform");
+#endif
+}
+
+void release_pages(void *data, std::size_t bytes) {
+#ifdef __linux__
+  const auto page_size = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+  const auto begin = reinterpret_cast<std::uintptr_t>(data);
+  const std::uintptr_t first_page = (begin + page_size - 1) / page_size * page_size;
+  const std::uintptr_t last_page = (begin + bytes) / page_size * page_size;
+  // the private anonymous pages of the heap are zero after the release, and the failure of the hint is harmless
+  if (first_page < last_page)
+    madvise(reinterpret_cast<void *>(first_page), last_page - first_page, MADV_DONTNEED);
+#else
+  (void) data;
+  (void) bytes;
+#endif
+}
+
+} // namespace macrocirculation
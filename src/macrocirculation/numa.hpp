@@ -0,0 +1,61 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_NUMA_HPP
+#define TUMORMODELS_NUMA_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <mpi.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+namespace macrocirculation {
+
+/*! @brief Parses a list of cores like "0-3,8,10-11" into the core ids 0, 1, 2, 3, 8, 10, 11. */
+std::vector<int> parse_core_list(const std::string &cores);
+
+/*! @brief Returns the cores for the threads of this rank, where the ranks of a node get consecutive blocks of num_threads cores from the cores of the node.
+ *         If there are less cores than threads on the node, the cores are reused cyclically. The call is collective.
+ */
+std::vector<int> select_cores_of_rank(MPI_Comm comm, const std::vector<int> &node_cores, std::size_t num_threads);
+
+/*! @brief Binds the calling thread to the given core. Throws, if the operating system does not support or rejects the binding. */
+void pin_thread_to_core(int core);
+
+/*! @brief Returns the pages of the given memory to the operating system, such that the next thread writing to a page places it on its NUMA node.
+ *         Only the pages lying completely inside the range are released, and their content is lost.
+ *         Does nothing, where the operating system does not support it.
+ */
+void release_pages(void *data, std::size_t bytes);
+
+/*! @brief Moves the pages of the values to the NUMA nodes of the threads, which process them.
+ *
+ *  The pages are released and then first touched by the k-th thread of the pool for the values in [chunk_offsets[k], chunk_offsets[k+1]),
+ *  which are the ranges the threads work on in the parallel loops. The values do not change.
+ *  Since std::vector zeroes new values on the allocating thread, this is called after allocating the vectors of a parallel loop.
+ */
+template<typename T>
+void first_touch(ThreadPool *pool, const std::vector<std::size_t> &chunk_offsets, std::vector<T> &values) {
+  if (pool == nullptr || values.empty())
+    return;
+  if (chunk_offsets.empty() || chunk_offsets.back() != values.size())
+    throw std::runtime_error("first_touch: the chunks do not cover the values");
+
+  const std::vector<T> copy = values;
+  release_pages(values.data(), values.size() * sizeof(T));
+  pool->parallel_for(chunk_offsets, [&](std::size_t, std::size_t begin, std::size_t end) {
+    std::copy(copy.begin() + static_cast<std::ptrdiff_t>(begin), copy.begin() + static_cast<std::ptrdiff_t>(end), values.begin() + static_cast<std::ptrdiff_t>(begin));
+  });
+}
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_NUMA_HPP
@@ -0,0 +1,80 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "output_resolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace macrocirculation {
+
+namespace {
+
+double get_length(const Edge &edge) {
+  return edge.has_physical_data() ? edge.get_physical_data().length : 1.;
+}
+
+} // namespace
+
+std::size_t OutputResolution::num_points(const Edge &edge) const {
+  if (!is_resampled())
+    return 2 * edge.num_micro_edges();
+
+  const auto num_points_by_length = static_cast<std::size_t>(std::ceil(points_per_cm * get_length(edge))) + 1;
+  return std::max<std::size_t>({2, points_per_vessel, points_per_cm > 0 ? num_points_by_length : 0});
+}
+
+EdgeSampler::EdgeSampler(const Edge &edge, const OutputResolution &resolution)
+    : d_num_micro_edges(edge.num_micro_edges()),
+      d_length(get_length(edge)) {
+  const std::size_t num_points = resolution.num_points(edge);
+  d_micro_edges.reserve(num_points);
+  d_positions.reserve(num_points);
+
+  if (!resolution.is_resampled()) {
+    for (std::size_t micro_edge = 0; micro_edge < d_num_micro_edges; micro_edge += 1) {
+      d_micro_edges.insert(d_micro_edges.end(), {micro_edge, micro_edge});
+      d_positions.insert(d_positions.end(), {0., 1.});
+    }
+  } else {
+    for (std::size_t k = 0; k < num_points; k += 1) {
+      const double s = static_cast<double>(k) / static_cast<double>(num_points - 1) * static_cast<double>(d_num_micro_edges);
+      // the right end of the vessel belongs to the last micro edge
+      const auto micro_edge = std::min(static_cast<std::size_t>(s), d_num_micro_edges - 1);
+      d_micro_edges.push_back(micro_edge);
+      d_positions.push_back(s - static_cast<double>(micro_edge));
+    }
+  }
+
+  d_phi.reserve(num_points);
+  for (double position : d_positions)
+    d_phi.push_back(evaluate_legendre(2 * position - 1));
+}
+
+std::vector<double> EdgeSampler::get_coordinates() const {
+  const double h = d_length / static_cast<double>(d_num_micro_edges);
+  std::vector<double> coordinates;
+  coordinates.reserve(size());
+  for (std::size_t k = 0; k < size(); k += 1)
+    coordinates.push_back(h * (static_cast<double>(d_micro_edges[k]) + d_positions[k]));
+  return coordinates;
+}
+
+void EdgeSampler::add_points(const Edge &edge, std::vector<Point> &points) const {
+  const auto &embedding = edge.get_embedding_data();
+  for (std::size_t k = 0; k < size(); k += 1) {
+    if (embedding.points.size() == d_num_micro_edges + 1)
+      points.push_back(convex_combination(embedding.points[d_micro_edges[k]], embedding.points[d_micro_edges[k] + 1], d_positions[k]));
+    else if (embedding.points.size() == 2)
+      points.push_back(convex_combination(embedding.points[0], embedding.points[1], (static_cast<double>(d_micro_edges[k]) + d_positions[k]) / static_cast<double>(d_num_micro_edges)));
+    else
+      throw std::runtime_error("this type of embedding is not implemented");
+  }
+}
+
+} // namespace macrocirculation
@@ -0,0 +1,82 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_OUTPUT_RESOLUTION_HPP
+#define TUMORMODELS_OUTPUT_RESOLUTION_HPP
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include "dof_map.hpp"
+#include "fe_type.hpp"
+#include "graph_storage.hpp"
+
+namespace macrocirculation {
+
+/*! @brief The number of output points along a vessel, which is independent of the micro edges of the solver.
+ *
+ *  By default every micro edge contributes its left and right endpoint, as the solution is discontinuous.
+ *  With a positive points_per_cm or points_per_vessel, the vessels are instead sampled at equidistant points including
+ *  both ends, where the finer of both resolutions wins and every vessel gets at least its two ends.
+ *  Edges without physical data are taken to be 1 cm long.
+ */
+struct OutputResolution {
+  double points_per_cm = 0;
+
+  std::size_t points_per_vessel = 0;
+
+  /*! @brief True, if the vessels are sampled instead of writing the endpoints of every micro edge. */
+  bool is_resampled() const { return points_per_cm > 0 || points_per_vessel > 0; }
+
+  /*! @brief The number of output points on the given edge. */
+  std::size_t num_points(const Edge &edge) const;
+};
+
+/*! @brief The output points of an edge for an OutputResolution together with the values of the legendre polynomials at them.
+ *
+ *  Since the basis values are cached, evaluating a component at a point only needs the coefficients of its micro edge.
+ *  The values of all the polynomials up to max_fe_degree are stored, hence the sampler serves every dof map on the edge.
+ */
+class EdgeSampler {
+public:
+  EdgeSampler(const Edge &edge, const OutputResolution &resolution);
+
+  /*! @brief The number of output points. */
+  std::size_t size() const { return d_micro_edges.size(); }
+
+  /*! @brief The distances of the points from the left vertex, i.e. the coordinates of the vessel in the csv and binary indices. */
+  std::vector<double> get_coordinates() const;
+
+  /*! @brief Appends the points on the embedding of the edge, which has to be a straight line or a point per micro vertex. */
+  void add_points(const Edge &edge, std::vector<Point> &points) const;
+
+  /*! @brief Evaluates the given component at the k-th output point. */
+  double evaluate(const LocalEdgeDofMap &local_dof_map, const std::vector<double> &u, std::size_t component, std::size_t k) const {
+    const double *values = local_dof_map.dof_values(u, d_micro_edges[k], component);
+    const auto &phi = d_phi[k];
+    double value = 0;
+    for (std::size_t i = 0; i < local_dof_map.num_basis_functions(); i += 1)
+      value += phi[i] * values[i];
+    return value;
+  }
+
+private:
+  std::size_t d_num_micro_edges;
+
+  double d_length;
+
+  /*! @brief The micro edge of every point and its position on it in [0, 1]. */
+  std::vector<std::size_t> d_micro_edges;
+  std::vector<double> d_positions;
+
+  std::vector<std::array<double, max_fe_degree + 1>> d_phi;
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_OUTPUT_RESOLUTION_HPP
@@ -0,0 +1,126 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "parareal_solver.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "communication/mpi.hpp"
+#include "explicit_nonlinear_flow_solver.hpp"
+
+namespace macrocirculation {
+
+PararealSolver::PararealSolver(MPI_Comm comm, std::size_t num_slices)
+    : d_comm(comm),
+      d_slice_comm(MPI_COMM_NULL),
+      d_time_comm(MPI_COMM_NULL),
+      d_num_slices(num_slices),
+      d_slice(0) {
+  const auto size = static_cast<std::size_t>(mpi::size(comm));
+  const auto rank = static_cast<std::size_t>(mpi::rank(comm));
+  if (num_slices == 0 || size % num_slices != 0)
+    throw std::runtime_error("PararealSolver: the " + std::to_string(size) + " ranks cannot be split into " + std::to_string(num_slices) + " slices");
+
+  const std::size_t ranks_per_slice = size / num_slices;
+  d_slice = rank / ranks_per_slice;
+  CHECK_MPI_SUCCESS(MPI_Comm_split(comm, static_cast<int>(d_slice), static_cast<int>(rank), &d_slice_comm));
+  CHECK_MPI_SUCCESS(MPI_Comm_split(comm, static_cast<int>(rank % ranks_per_slice), static_cast<int>(d_slice), &d_time_comm));
+}
+
+PararealSolver::~PararealSolver() {
+  MPI_Comm_free(&d_time_comm);
+  MPI_Comm_free(&d_slice_comm);
+}
+
+void PararealSolver::set_fine_propagator(Propagator fine) { d_fine = std::move(fine); }
+
+void PararealSolver::set_coarse_propagator(Propagator coarse) { d_coarse = std::move(coarse); }
+
+PararealSolver::Propagator PararealSolver::create_propagator(ExplicitNonlinearFlowSolver &solver, double tau) {
+  return [&solver, tau](double t, double t_end, std::vector<double> &u) {
+    const auto num_steps = static_cast<std::size_t>(std::round((t_end - t) / tau));
+    if (std::abs(static_cast<double>(num_steps) * tau - (t_end - t)) > 1e-12 * std::max(1., std::abs(t_end)))
+      throw std::runtime_error("the time step " + std::to_string(tau) + " does not divide the slice [" + std::to_string(t) + ", " + std::to_string(t_end) + "]");
+
+    solver.get_solution() = u;
+    for (std::size_t step = 0; step < num_steps; step += 1)
+      solver.solve(tau, t + static_cast<double>(step) * tau);
+    u = solver.get_solution();
+  };
+}
+
+std::size_t PararealSolver::solve(double t_start, double slice_length, std::vector<double> &u, double tolerance, std::size_t max_iterations) {
+  if (!d_fine || !d_coarse)
+    throw std::runtime_error("PararealSolver: the fine and the coarse propagator have to be set");
+
+  const double t = t_start + static_cast<double>(d_slice) * slice_length;
+  const double t_end = t + slice_length;
+  const bool has_previous = d_slice > 0;
+  const bool has_next = d_slice + 1 < d_num_slices;
+  const int previous = static_cast<int>(d_slice) - 1;
+  const int next = static_cast<int>(d_slice) + 1;
+  const auto n = static_cast<int>(u.size());
+
+  d_changes.clear();
+
+  // the start value of our slice, which is exact on slice 0
+  std::vector<double> u_start = u;
+
+  // the initial start values from a sequential sweep of the coarse propagator
+  if (has_previous)
+    CHECK_MPI_SUCCESS(MPI_Recv(u_start.data(), n, MPI_DOUBLE, previous, 0, d_time_comm, MPI_STATUS_IGNORE));
+  std::vector<double> g_old = u_start;
+  d_coarse(t, t_end, g_old);
+  std::vector<double> u_end = g_old;
+  if (has_next)
+    CHECK_MPI_SUCCESS(MPI_Send(u_end.data(), n, MPI_DOUBLE, next, 0, d_time_comm));
+
+  std::vector<double> f(u.size());
+  std::vector<double> g_new(u.size());
+  std::size_t iteration = 0;
+  while (iteration < std::min(max_iterations, d_num_slices)) {
+    iteration += 1;
+
+    // the fine propagators of all the slices run concurrently
+    f = u_start;
+    d_fine(t, t_end, f);
+
+    // the correction is passed on from slice to slice
+    if (has_previous)
+      CHECK_MPI_SUCCESS(MPI_Recv(u_start.data(), n, MPI_DOUBLE, previous, 0, d_time_comm, MPI_STATUS_IGNORE));
+    g_new = u_start;
+    d_coarse(t, t_end, g_new);
+
+    std::array<double, 2> change_and_scale{0., 0.};
+    for (std::size_t k = 0; k < u_end.size(); k += 1) {
+      const double value = g_new[k] + f[k] - g_old[k];
+      change_and_scale[0] = std::max(change_and_scale[0], std::abs(value - u_end[k]));
+      change_and_scale[1] = std::max(change_and_scale[1], std::abs(value));
+      u_end[k] = value;
+    }
+    std::swap(g_old, g_new);
+
+    if (has_next)
+      CHECK_MPI_SUCCESS(MPI_Send(u_end.data(), n, MPI_DOUBLE, next, 0, d_time_comm));
+
+    CHECK_MPI_SUCCESS(MPI_Allreduce(MPI_IN_PLACE, change_and_scale.data(), 2, MPI_DOUBLE, MPI_MAX, d_comm));
+    const double change = change_and_scale[1] > 0 ? change_and_scale[0] / change_and_scale[1] : change_and_scale[0];
+    d_changes.push_back(change);
+    if (change <= tolerance)
+      break;
+  }
+
+  u = u_end;
+  return iteration;
+}
+
+} // namespace macrocirculation
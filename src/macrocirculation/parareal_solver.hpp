@@ -0,0 +1,100 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_PARAREAL_SOLVER_HPP
+#define TUMORMODELS_PARAREAL_SOLVER_HPP
+
+#include <cstddef>
+#include <functional>
+#include <mpi.h>
+#include <vector>
+
+namespace macrocirculation {
+
+// forward declarations
+class ExplicitNonlinearFlowSolver;
+
+/*! @brief Parallel-in-time integration with the parareal iteration over consecutive time slices, e.g. cardiac cycles.
+ *
+ *  The communicator is split into num_slices groups of consecutive ranks, and every group integrates one slice
+ *  with its own graph and solvers on the slice communicator. Hence, all the groups have to partition their graphs in the same way,
+ *  such that the k-th rank of every group holds the same dofs. Within an iteration all the slices run the expensive fine propagator concurrently
+ *  from their current start values, and afterwards the cheap coarse propagator corrects the start values slice by slice:
+ *      U_{n+1}^{k+1} = G(U_n^{k+1}) + F(U_n^k) - G(U_n^k).
+ *  After k iterations the first k slices agree with the fine propagator, hence at most num_slices iterations are needed.
+ */
+class PararealSolver {
+public:
+  /*! @brief Advances the given solution vector from the 1st time to the 2nd time on the ranks of a slice. */
+  using Propagator = std::function<void(double, double, std::vector<double> &)>;
+
+  /*! @brief Splits the communicator into the slices. The size of the communicator has to be a multiple of num_slices. */
+  PararealSolver(MPI_Comm comm, std::size_t num_slices);
+
+  PararealSolver(const PararealSolver &) = delete;
+  PararealSolver &operator=(const PararealSolver &) = delete;
+
+  ~PararealSolver();
+
+  /*! @brief The communicator of our slice, on which the graph and the solvers of the propagators have to be created. */
+  MPI_Comm get_slice_comm() const { return d_slice_comm; }
+
+  std::size_t num_slices() const { return d_num_slices; }
+
+  /*! @brief The index of the slice of our rank. */
+  std::size_t get_slice() const { return d_slice; }
+
+  /*! @brief Sets the accurate propagator, whose solution the iteration converges to. */
+  void set_fine_propagator(Propagator fine);
+
+  /*! @brief Sets the cheap propagator, e.g. with a larger time step, a lower degree or a reduced network.
+   *         It has to work on the same dof vectors as the fine propagator.
+   */
+  void set_coarse_propagator(Propagator coarse);
+
+  /*! @brief Creates a propagator, which takes steps of length tau with the given solver.
+   *         The solver has to stay alive as long as the propagator, and tau has to divide the slice length.
+   */
+  static Propagator create_propagator(ExplicitNonlinearFlowSolver &solver, double tau);
+
+  /*! @brief Integrates num_slices slices of the given length starting from t_start. This is collective on the communicator.
+   *
+   * @param u               The solution at t_start on entry, which only slice 0 uses,
+   *                        and the solution at the end of the slice of our rank on exit.
+   * @param tolerance       The iteration stops as soon as the largest change of the values at the ends of the slices
+   *                        is below the tolerance relative to the largest value.
+   * @param max_iterations  The iteration stops after at most max_iterations or num_slices iterations.
+   * @return The number of iterations.
+   */
+  std::size_t solve(double t_start, double slice_length, std::vector<double> &u, double tolerance, std::size_t max_iterations);
+
+  /*! @brief Returns the relative changes at the ends of the slices in every iteration of the last solve. */
+  const std::vector<double> &get_changes() const { return d_changes; }
+
+private:
+  MPI_Comm d_comm;
+
+  /*! @brief The ranks of our slice. */
+  MPI_Comm d_slice_comm;
+
+  /*! @brief The ranks with the same rank in every slice, which exchange the values at the slice boundaries. */
+  MPI_Comm d_time_comm;
+
+  std::size_t d_num_slices;
+
+  std::size_t d_slice;
+
+  Propagator d_fine;
+
+  Propagator d_coarse;
+
+  std::vector<double> d_changes;
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_PARAREAL_SOLVER_HPP
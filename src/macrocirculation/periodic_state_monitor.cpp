@@ -0,0 +1,150 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "periodic_state_monitor.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include "communication/mpi.hpp"
+#include "explicit_nonlinear_flow_solver.hpp"
+#include "graph_storage.hpp"
+
+namespace macrocirculation {
+
+PeriodicStateMonitor::PeriodicStateMonitor(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, double period, std::size_t num_samples)
+    : d_comm(comm),
+      d_graph(std::move(graph)),
+      d_period(period),
+      d_num_samples(num_samples),
+      d_tolerance(1e-3),
+      d_t_start(std::numeric_limits<double>::quiet_NaN()),
+      d_t_last(0),
+      d_num_periods(0),
+      d_difference(std::numeric_limits<double>::infinity()),
+      d_converged(false) {
+  if (d_period <= 0)
+    throw std::runtime_error("the period of the periodic state monitor has to be positive");
+  if (d_num_samples == 0)
+    throw std::runtime_error("the periodic state monitor needs at least one sample per period");
+
+  for (auto v_id : d_graph->get_active_vertex_ids(mpi::rank(d_comm))) {
+    auto &v = d_graph->vertex(v_id);
+    if (v.is_leaf() && d_graph->edge(v.get_edge_neighbors()[0]).rank() == mpi::rank(d_comm))
+      d_vertex_ids.push_back(v_id);
+  }
+}
+
+void PeriodicStateMonitor::set_tolerance(double tolerance) { d_tolerance = tolerance; }
+
+bool PeriodicStateMonitor::is_converged() const { return d_converged; }
+
+double PeriodicStateMonitor::get_difference() const { return d_difference; }
+
+std::size_t PeriodicStateMonitor::get_num_periods() const { return d_num_periods; }
+
+double PeriodicStateMonitor::get_end_of_last_period() const { return d_t_start; }
+
+double PeriodicStateMonitor::get_period() const { return d_period; }
+
+void PeriodicStateMonitor::evaluate_tips(const ExplicitNonlinearFlowSolver &solver, std::vector<double> &values) const {
+  values.resize(2 * d_vertex_ids.size());
+  for (std::size_t i = 0; i < d_vertex_ids.size(); i += 1) {
+    auto &v = d_graph->vertex(d_vertex_ids[i]);
+    const double sigma = d_graph->edge(v.get_edge_neighbors()[0]).is_pointing_to(v.get_id()) ? +1. : -1.;
+    double p, q;
+    solver.get_1d_pq_values_at_vertex(v, p, q);
+    values[2 * i] = p;
+    values[2 * i + 1] = sigma * q;
+  }
+}
+
+bool PeriodicStateMonitor::update(const ExplicitNonlinearFlowSolver &solver, double t) {
+  std::vector<double> values;
+  evaluate_tips(solver, values);
+
+  // the first period starts at the next multiple of the period length
+  if (std::isnan(d_t_start)) {
+    d_t_start = d_period * std::ceil(t / d_period - 1e-12);
+    d_t_last = t;
+    d_values_last = std::move(values);
+    return false;
+  }
+
+  bool period_completed = false;
+
+  const std::size_t num_values = values.size();
+  // without any vessel tips on this rank we store a dummy value to count the samples
+  const std::size_t values_per_sample = std::max<std::size_t>(num_values, 1);
+  const double sample_distance = d_period / static_cast<double>(d_num_samples);
+
+  // sample all the times we passed during the last step
+  while (t > d_t_last) {
+    const std::size_t sample = d_samples.size() / values_per_sample;
+    const double t_sample = d_t_start + static_cast<double>(sample) * sample_distance;
+    if (t_sample > t + 1e-12)
+      break;
+
+    // the first sample of the next period completes the current one
+    if (sample == d_num_samples) {
+      d_num_periods += 1;
+      if (d_num_periods > 1) {
+        d_difference = calculate_difference();
+        d_converged = d_converged || d_difference < d_tolerance;
+      }
+      std::swap(d_samples, d_samples_prev);
+      d_samples.clear();
+      d_t_start += d_period;
+      period_completed = true;
+      continue;
+    }
+
+    const double theta = std::clamp((t_sample - d_t_last) / (t - d_t_last), 0., 1.);
+    for (std::size_t k = 0; k < num_values; k += 1)
+      d_samples.push_back((1 - theta) * d_values_last[k] + theta * values[k]);
+
+    if (num_values == 0)
+      d_samples.push_back(0);
+  }
+
+  d_t_last = t;
+  d_values_last = std::move(values);
+
+  return period_completed;
+}
+
+double PeriodicStateMonitor::calculate_difference() const {
+  const std::size_t num_tips = d_vertex_ids.size();
+
+  // the largest differences and amplitudes of the pressures and the flows over all the tips,
+  // such that vessel tips with almost no flow do not dominate the relative difference
+  std::array<double, 4> data = {0, 0, 0, 0};
+  for (std::size_t j = 0; j < d_num_samples; j += 1) {
+    for (std::size_t i = 0; i < num_tips; i += 1) {
+      for (std::size_t k = 0; k < 2; k += 1) {
+        const std::size_t idx = (j * num_tips + i) * 2 + k;
+        data[k] = std::max(data[k], std::abs(d_samples[idx] - d_samples_prev[idx]));
+        data[2 + k] = std::max(data[2 + k], std::abs(d_samples_prev[idx]));
+      }
+    }
+  }
+
+  MPI_Allreduce(MPI_IN_PLACE, data.data(), static_cast<int>(data.size()), MPI_DOUBLE, MPI_MAX, d_comm);
+
+  double difference = 0;
+  for (std::size_t k = 0; k < 2; k += 1)
+    // signals which vanish everywhere are compared absolutely
+    difference = std::max(difference, data[2 + k] > 0 ? data[k] / data[2 + k] : data[k]);
+
+  return difference;
+}
+
+} // namespace macrocirculation
@@ -0,0 +1,98 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_PERIODIC_STATE_MONITOR_HPP
+#define TUMORMODELS_PERIODIC_STATE_MONITOR_HPP
+
+#include <cstddef>
+#include <memory>
+#include <mpi.h>
+#include <vector>
+
+namespace macrocirculation {
+
+// forward declarations
+class GraphStorage;
+class ExplicitNonlinearFlowSolver;
+
+/*! @brief Detects if the flow has reached a periodic steady state.
+ *
+ *  The pressure and outflow at all the vessel tips are sampled at equidistant times of every period of the inflow.
+ *  After each completed period, these signatures are compared with the ones of the previous period.
+ *  The state is considered as periodic, once the largest difference of the pressures and flows,
+ *  relative to their largest amplitude at all the vessel tips, drops below the tolerance.
+ *  The periods start at multiples of the period length, such that the signatures are aligned with the inflow.
+ */
+class PeriodicStateMonitor {
+public:
+  PeriodicStateMonitor(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, double period, std::size_t num_samples = 64);
+
+  /*! @brief Sets the relative tolerance between two periods, below which the state is periodic. */
+  void set_tolerance(double tolerance);
+
+  /*! @brief Samples the solution of the solver at time t, which has to be called after every time step.
+   *         Between the time steps the values are interpolated linearly.
+   *
+   * @return True if a period was completed during this call.
+   */
+  bool update(const ExplicitNonlinearFlowSolver &solver, double t);
+
+  /*! @brief Returns true once the difference between two successive periods was below the tolerance. */
+  bool is_converged() const;
+
+  /*! @brief The relative difference between the last two completed periods, infinity if we have less than two periods. */
+  double get_difference() const;
+
+  /*! @brief The number of completed periods. */
+  std::size_t get_num_periods() const;
+
+  /*! @brief The time at which the last completed period ended. */
+  double get_end_of_last_period() const;
+
+  double get_period() const;
+
+private:
+  MPI_Comm d_comm;
+
+  std::shared_ptr<GraphStorage> d_graph;
+
+  double d_period;
+
+  std::size_t d_num_samples;
+
+  double d_tolerance;
+
+  /*! @brief The ids of the vessel tips, whose edge is owned by this rank. */
+  std::vector<std::size_t> d_vertex_ids;
+
+  /*! @brief The start of the current period, NaN before the first call to update. */
+  double d_t_start;
+
+  /*! @brief The time and tip values of the last call to update. */
+  double d_t_last;
+  std::vector<double> d_values_last;
+
+  /*! @brief The samples of the current and previous period, where the value of quantity k at tip i and sample j has the index (j * num_tips + i) * 2 + k. */
+  std::vector<double> d_samples;
+  std::vector<double> d_samples_prev;
+
+  std::size_t d_num_periods;
+
+  double d_difference;
+
+  bool d_converged;
+
+  /*! @brief Evaluates the pressure and the flow out of the network at all our vessel tips. */
+  void evaluate_tips(const ExplicitNonlinearFlowSolver &solver, std::vector<double> &values) const;
+
+  /*! @brief Calculates the relative difference between the current and the previous period over all ranks. */
+  double calculate_difference() const;
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_PERIODIC_STATE_MONITOR_HPP
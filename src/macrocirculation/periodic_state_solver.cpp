@@ -0,0 +1,161 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "periodic_state_solver.hpp"
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <stdexcept>
+#include <utility>
+
+#include "communication/mpi.hpp"
+#include "dof_map.hpp"
+#include "graph_storage.hpp"
+
+namespace macrocirculation {
+
+PeriodicStateSolver::PeriodicStateSolver(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, std::shared_ptr<DofMap> dof_map, double period)
+    : d_comm(comm),
+      d_graph(std::move(graph)),
+      d_dof_map(std::move(dof_map)),
+      d_period(period),
+      d_depth(5),
+      d_accelerate_all_dofs(false),
+      d_converged(false) {
+  if (d_period <= 0)
+    throw std::runtime_error("the period of the periodic state solver has to be positive");
+}
+
+void PeriodicStateSolver::set_propagator(Propagator propagator) { d_propagator = std::move(propagator); }
+
+void PeriodicStateSolver::set_depth(std::size_t depth) { d_depth = depth; }
+
+void PeriodicStateSolver::set_accelerate_all_dofs(bool accelerate_all_dofs) { d_accelerate_all_dofs = accelerate_all_dofs; }
+
+std::vector<std::size_t> PeriodicStateSolver::collect_dofs() const {
+  const auto rank = mpi::rank(d_comm);
+
+  std::vector<std::size_t> dofs;
+  if (d_accelerate_all_dofs) {
+    for (auto e_id : d_graph->get_active_edge_ids(rank)) {
+      const auto &local_dof_map = d_dof_map->get_local_dof_map(d_graph->edge(e_id));
+      const std::size_t first_dof = local_dof_map.first_dof(0, 0);
+      for (std::size_t i = first_dof; i < first_dof + local_dof_map.num_local_dof(); i += 1)
+        dofs.push_back(i);
+    }
+  }
+
+  for (auto v_id : d_graph->get_active_vertex_ids(rank)) {
+    const auto &vertex = d_graph->vertex(v_id);
+    // only the 0D models have dofs on the vertices
+    if (!vertex.is_leaf() || !(vertex.is_windkessel_outflow() || vertex.is_vessel_tree_outflow() || vertex.is_rcl_outflow()))
+      continue;
+    for (auto i : d_dof_map->get_local_dof_map(vertex).dof_indices())
+      dofs.push_back(i);
+  }
+
+  return dofs;
+}
+
+double PeriodicStateSolver::solve(double t_start, std::vector<double> &u, double tolerance, std::size_t max_cycles) {
+  if (!d_propagator)
+    throw std::runtime_error("PeriodicStateSolver: the propagator has to be set");
+
+  const auto dofs = collect_dofs();
+  const std::size_t n = dofs.size();
+
+  // the accelerated dofs at the start of the current cycle and the residual and the state after the previous cycle
+  std::vector<double> x(n);
+  for (std::size_t i = 0; i < n; i += 1)
+    x[i] = u[dofs[i]];
+  std::vector<double> g_prev;
+  std::vector<double> p_prev;
+
+  // the differences of the residuals and the states after the last cycles, oldest first
+  std::deque<std::vector<double>> delta_g;
+  std::deque<std::vector<double>> delta_p;
+
+  std::vector<double> g(n);
+  std::vector<double> p(n);
+
+  d_residuals.clear();
+  d_converged = false;
+
+  double t = t_start;
+  for (std::size_t cycle = 0; cycle < max_cycles; cycle += 1) {
+    d_propagator(t, t + d_period, u);
+    t += d_period;
+
+    double max_values[2] = {0, 0};
+    for (std::size_t i = 0; i < n; i += 1) {
+      p[i] = u[dofs[i]];
+      g[i] = p[i] - x[i];
+      max_values[0] = std::max(max_values[0], std::abs(g[i]));
+      max_values[1] = std::max(max_values[1], std::abs(p[i]));
+    }
+    CHECK_MPI_SUCCESS(MPI_Allreduce(MPI_IN_PLACE, max_values, 2, MPI_DOUBLE, MPI_MAX, d_comm));
+    d_residuals.push_back(max_values[1] > 0 ? max_values[0] / max_values[1] : max_values[0]);
+
+    if (d_residuals.back() < tolerance) {
+      d_converged = true;
+      return t;
+    }
+
+    // the ranks without accelerated dofs have empty residuals, but have to keep the same history as the others
+    if (cycle > 0 && d_depth > 0) {
+      delta_g.emplace_back(n);
+      delta_p.emplace_back(n);
+      for (std::size_t i = 0; i < n; i += 1) {
+        delta_g.back()[i] = g[i] - g_prev[i];
+        delta_p.back()[i] = p[i] - p_prev[i];
+      }
+      if (delta_g.size() > d_depth) {
+        delta_g.pop_front();
+        delta_p.pop_front();
+      }
+    }
+    g_prev = g;
+    p_prev = p;
+
+    // the coefficients gamma minimize |g - delta_g gamma| over all ranks, where the normal equations are small enough to be reduced in a single call
+    const std::size_t m = delta_g.size();
+    Eigen::VectorXd gamma = Eigen::VectorXd::Zero(static_cast<Eigen::Index>(m));
+    if (m > 0) {
+      std::vector<double> sums(m * m + m, 0.);
+      for (std::size_t j = 0; j < m; j += 1) {
+        for (std::size_t k = 0; k < m; k += 1)
+          for (std::size_t i = 0; i < n; i += 1)
+            sums[j * m + k] += delta_g[j][i] * delta_g[k][i];
+        for (std::size_t i = 0; i < n; i += 1)
+          sums[m * m + j] += delta_g[j][i] * g[i];
+      }
+      CHECK_MPI_SUCCESS(MPI_Allreduce(MPI_IN_PLACE, sums.data(), static_cast<int>(sums.size()), MPI_DOUBLE, MPI_SUM, d_comm));
+
+      const auto size = static_cast<Eigen::Index>(m);
+      Eigen::MatrixXd normal_matrix = Eigen::Map<Eigen::MatrixXd>(sums.data(), size, size);
+      const Eigen::VectorXd rhs = Eigen::Map<Eigen::VectorXd>(sums.data() + m * m, size);
+      // a small tikhonov regularization for nearly linearly dependent residuals
+      normal_matrix.diagonal().array() += 1e-12 * std::max(normal_matrix.trace(), 1e-300);
+      gamma = normal_matrix.ldlt().solve(rhs);
+    }
+
+    // the anderson step x = P(x) - delta_p gamma, the other dofs continue from P(x)
+    for (std::size_t i = 0; i < n; i += 1) {
+      double value = p[i];
+      for (std::size_t j = 0; j < m; j += 1)
+        value -= delta_p[j][i] * gamma[static_cast<Eigen::Index>(j)];
+      x[i] = value;
+      u[dofs[i]] = value;
+    }
+  }
+
+  return t;
+}
+
+} // namespace macrocirculation
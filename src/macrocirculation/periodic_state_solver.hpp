@@ -0,0 +1,86 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_PERIODIC_STATE_SOLVER_HPP
+#define TUMORMODELS_PERIODIC_STATE_SOLVER_HPP
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mpi.h>
+#include <vector>
+
+namespace macrocirculation {
+
+// forward declarations
+class GraphStorage;
+class DofMap;
+
+/*! @brief Finds the periodic state of the flow by solving u = P(u) for the map P, which advances the solution by one period of the inflow.
+ *
+ *  Instead of simulating cycles until the 0D models have been filled, every cycle is followed by an anderson acceleration step,
+ *  which extrapolates the state at the start of the next cycle from the residuals P(u) - u of the last cycles.
+ *  By default only the dofs of the 0D models are accelerated, since their slow relaxation with the time constants R C dominates,
+ *  while the waves in the vessels are damped within a few cycles anyway. The remaining dofs simply continue from P(u).
+ *  The few dot products of the acceleration are reduced over all ranks, hence the iteration is collective on the communicator.
+ */
+class PeriodicStateSolver {
+public:
+  /*! @brief Advances the given solution vector from the 1st time to the 2nd time, e.g. PararealSolver::create_propagator. */
+  using Propagator = std::function<void(double, double, std::vector<double> &)>;
+
+  PeriodicStateSolver(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, std::shared_ptr<DofMap> dof_map, double period);
+
+  void set_propagator(Propagator propagator);
+
+  /*! @brief The number of previous cycles, from which the next state is extrapolated. Zero gives the plain simulation of the cycles. */
+  void set_depth(std::size_t depth);
+
+  /*! @brief Accelerates all the dofs instead of only the ones of the 0D models. */
+  void set_accelerate_all_dofs(bool accelerate_all_dofs);
+
+  /*! @brief Iterates over cycles until the largest change of the accelerated dofs within a cycle is below the tolerance relative to their largest value.
+   *
+   * @param t_start     The time of u on entry, which should be the start of a period of the inflow.
+   * @param u           The initial guess on entry and the periodic state at the returned time on exit.
+   * @param max_cycles  The iteration stops after at most max_cycles evaluations of the propagator.
+   * @return The time of u on exit, which is t_start plus the number of cycles times the period.
+   */
+  double solve(double t_start, std::vector<double> &u, double tolerance, std::size_t max_cycles);
+
+  /*! @brief Returns true if the tolerance was reached in the last solve. */
+  bool is_converged() const { return d_converged; }
+
+  /*! @brief The relative residuals of all the cycles of the last solve. */
+  const std::vector<double> &get_residuals() const { return d_residuals; }
+
+private:
+  MPI_Comm d_comm;
+
+  std::shared_ptr<GraphStorage> d_graph;
+
+  std::shared_ptr<DofMap> d_dof_map;
+
+  double d_period;
+
+  Propagator d_propagator;
+
+  std::size_t d_depth;
+
+  bool d_accelerate_all_dofs;
+
+  bool d_converged;
+
+  std::vector<double> d_residuals;
+
+  /*! @brief The accelerated dofs of our rank. */
+  std::vector<std::size_t> collect_dofs() const;
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_PERIODIC_STATE_SOLVER_HPP
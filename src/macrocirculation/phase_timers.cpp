@@ -0,0 +1,206 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "phase_timers.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <nlohmann/json.hpp>
+
+#include "communication/mpi.hpp"
+
+namespace macrocirculation {
+
+namespace {
+
+/*! @brief Owns the trees of all the threads, such that they outlive the threads of a pool. */
+struct PhaseTimerRegistry {
+  std::mutex mutex;
+  std::vector<std::shared_ptr<PhaseTimers::Node>> roots;
+};
+
+PhaseTimerRegistry &get_registry() {
+  static PhaseTimerRegistry registry;
+  return registry;
+}
+
+/*! @brief The tree of the calling thread and its current phase. */
+struct ThreadPhases {
+  ThreadPhases()
+      : root(std::make_shared<PhaseTimers::Node>(PhaseTimers::Node{"", nullptr, 0., 0, {}})),
+        current(root.get()) {
+    auto &registry = get_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.roots.push_back(root);
+  }
+
+  std::shared_ptr<PhaseTimers::Node> root;
+  PhaseTimers::Node *current;
+};
+
+ThreadPhases &get_thread_phases() {
+  thread_local ThreadPhases phases;
+  return phases;
+}
+
+/*! @brief The accumulated values of a path over the threads of a rank. */
+struct PathTimes {
+  double seconds{0};
+  std::size_t calls{0};
+  HardwareCounters::Counts counts{};
+};
+
+/*! @brief Adds the seconds, calls and counts of the node and its descendants to the times of their paths. */
+void collect(const PhaseTimers::Node &node, const std::string &path, std::map<std::string, PathTimes> &times) {
+  for (const auto &child : node.children) {
+    const std::string child_path = path.empty() ? child->name : path + "/" + child->name;
+    auto &entry = times[child_path];
+    entry.seconds += child->seconds;
+    entry.calls += child->calls;
+    for (std::size_t k = 0; k < entry.counts.size(); k += 1)
+      entry.counts[k] += child->counts[k];
+    collect(*child, child_path, times);
+  }
+}
+
+void reset(PhaseTimers::Node &node) {
+  node.seconds = 0;
+  node.calls = 0;
+  node.counts.fill(0);
+  for (auto &child : node.children)
+    reset(*child);
+}
+
+/*! @brief Orders the paths such that the children directly follow their parent. */
+bool path_less(const std::string &a, const std::string &b) {
+  const auto separator_first = [](char c) { return c == '/' ? '\x01' : c; };
+  return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), [&](char x, char y) { return separator_first(x) < separator_first(y); });
+}
+
+} // namespace
+
+PhaseTimers::Node *PhaseTimers::Node::child(const char *child_name) {
+  for (auto &c : children)
+    if (c->name == child_name || std::strcmp(c->name, child_name) == 0)
+      return c.get();
+  children.push_back(std::make_unique<Node>(Node{child_name, this, 0., 0, {}}));
+  return children.back().get();
+}
+
+PhaseTimers::Node *PhaseTimers::enter(const char *name) {
+  auto &phases = get_thread_phases();
+  phases.current = phases.current->child(name);
+  return phases.current;
+}
+
+void PhaseTimers::leave(Node *node, double seconds) {
+  node->seconds += seconds;
+  node->calls += 1;
+  get_thread_phases().current = node->parent;
+}
+
+std::vector<PhaseTimers::Statistics> PhaseTimers::reduce(MPI_Comm comm) {
+  // the times of this rank merged over its threads
+  std::map<std::string, PathTimes> local_times;
+  {
+    auto &registry = get_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (const auto &root : registry.roots)
+      collect(*root, "", local_times);
+  }
+
+  // the ranks may know different phases, hence we gather the union of all the paths
+  std::vector<std::string> local_paths;
+  for (const auto &it : local_times)
+    local_paths.push_back(it.first);
+  auto paths = mpi::allgather_union(comm, local_paths);
+  std::sort(paths.begin(), paths.end(), path_less);
+
+  const std::size_t num_events = HardwareCounters::get_events().size();
+  std::vector<double> seconds(paths.size(), 0.);
+  std::vector<unsigned long> calls(paths.size(), 0);
+  std::vector<double> counts(paths.size() * num_events, 0.);
+  for (std::size_t k = 0; k < paths.size(); k += 1) {
+    auto it = local_times.find(paths[k]);
+    if (it != local_times.end()) {
+      seconds[k] = it->second.seconds;
+      calls[k] = it->second.calls;
+      for (std::size_t e = 0; e < num_events; e += 1)
+        counts[k * num_events + e] = static_cast<double>(it->second.counts[e]);
+    }
+  }
+
+  const int n = static_cast<int>(paths.size());
+  std::vector<double> min(paths.size()), max(paths.size()), sum(paths.size());
+  std::vector<unsigned long> max_calls(paths.size());
+  CHECK_MPI_SUCCESS(MPI_Allreduce(seconds.data(), min.data(), n, MPI_DOUBLE, MPI_MIN, comm));
+  CHECK_MPI_SUCCESS(MPI_Allreduce(seconds.data(), max.data(), n, MPI_DOUBLE, MPI_MAX, comm));
+  CHECK_MPI_SUCCESS(MPI_Allreduce(seconds.data(), sum.data(), n, MPI_DOUBLE, MPI_SUM, comm));
+  CHECK_MPI_SUCCESS(MPI_Allreduce(calls.data(), max_calls.data(), n, MPI_UNSIGNED_LONG, MPI_MAX, comm));
+  std::vector<double> sum_counts(counts.size());
+  CHECK_MPI_SUCCESS(MPI_Allreduce(counts.data(), sum_counts.data(), static_cast<int>(counts.size()), MPI_DOUBLE, MPI_SUM, comm));
+
+  const int num_ranks = mpi::size(comm);
+  std::vector<Statistics> statistics;
+  for (std::size_t k = 0; k < paths.size(); k += 1) {
+    const auto first = sum_counts.begin() + static_cast<std::ptrdiff_t>(k * num_events);
+    statistics.push_back({paths[k], max_calls[k], min[k], sum[k] / num_ranks, max[k], std::vector<double>(first, first + static_cast<std::ptrdiff_t>(num_events))});
+  }
+  return statistics;
+}
+
+void PhaseTimers::print(MPI_Comm comm, std::ostream &os) {
+  const auto statistics = reduce(comm);
+  if (mpi::rank(comm) != 0)
+    return;
+
+  os << std::left << std::setw(48) << "phase" << std::right << std::setw(12) << "calls" << std::setw(14) << "min [s]" << std::setw(14) << "avg [s]" << std::setw(14) << "max [s]" << "\n";
+  for (const auto &s : statistics) {
+    // the phases are indented by their depth and only show their own name
+    const auto depth = static_cast<std::size_t>(std::count(s.path.begin(), s.path.end(), '/'));
+    const auto name_begin = s.path.find_last_of('/');
+    const std::string name = std::string(2 * depth, ' ') + (name_begin == std::string::npos ? s.path : s.path.substr(name_begin + 1));
+    os << std::left << std::setw(48) << name << std::right << std::setw(12) << s.calls << std::setw(14) << s.min << std::setw(14) << s.avg << std::setw(14) << s.max << "\n";
+  }
+  os << std::flush;
+}
+
+void PhaseTimers::write_json(MPI_Comm comm, const std::string &filepath) {
+  const auto statistics = reduce(comm);
+  if (mpi::rank(comm) != 0)
+    return;
+
+  using json = nlohmann::json;
+
+  json j = json::array();
+  for (const auto &s : statistics) {
+    json phase = {{"phase", s.path}, {"calls", s.calls}, {"min", s.min}, {"avg", s.avg}, {"max", s.max}};
+#ifdef MACROCIRCULATION_HARDWARE_COUNTERS
+    const auto &events = HardwareCounters::get_events();
+    for (std::size_t k = 0; k < events.size(); k += 1)
+      phase["counts"][events[k].name] = s.counts[k];
+#endif
+    j.push_back(phase);
+  }
+
+  std::ofstream o(filepath);
+  o << std::setw(4);
+  o << j;
+}
+
+void PhaseTimers::reset() {
+  auto &registry = get_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (auto &root : registry.roots)
+    macrocirculation::reset(*root);
+}
+
+} // namespace macrocirculation
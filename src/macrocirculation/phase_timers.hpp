@@ -0,0 +1,136 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_PHASE_TIMERS_HPP
+#define TUMORMODELS_PHASE_TIMERS_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mpi.h>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "hardware_counters.hpp"
+#include "phase_trace.hpp"
+
+namespace macrocirculation {
+
+/*! @brief Accumulates the wall clock times of the nested phases of a run, e.g. "solve/rhs/cell assembly".
+ *
+ *  The solver stack only records its phases, if the library was compiled with MACROCIRCULATION_PHASE_TIMERS
+ *  (cmake option LibMacrocirculation_Enable_Phase_Timers), otherwise SCOPED_PHASE_TIMER expands to nothing.
+ *  The setup phases, e.g. reading the mesh or creating the dof map, are always recorded with SCOPED_SETUP_TIMER.
+ *  Every thread records into its own tree of phases, hence the timers need no synchronization,
+ *  and the trees of all the threads are merged by their paths.
+ *  The times of a phase include the times of its children.
+ *  With MACROCIRCULATION_HARDWARE_COUNTERS the phases also accumulate the counts of the HardwareCounters of their threads.
+ *  While a PhaseTrace is recording, every phase is also added to the timeline of its thread.
+ */
+class PhaseTimers {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /*! @brief A phase in the tree of a single thread. */
+  struct Node {
+    const char *name;
+    Node *parent;
+    double seconds;
+    std::size_t calls;
+    std::vector<std::unique_ptr<Node>> children;
+    HardwareCounters::Counts counts{};
+
+    /*! @brief Returns the child with the given name, which is created on its first call. */
+    Node *child(const char *child_name);
+  };
+
+  /*! @brief The times of a phase over the ranks, where the times of the threads of a rank are summed up. */
+  struct Statistics {
+    /*! @brief The names of the phase and its parents separated by slashes. */
+    std::string path;
+    /*! @brief The maximum number of calls on a rank. */
+    std::size_t calls;
+    double min;
+    double avg;
+    double max;
+    /*! @brief The counts of the hardware events summed over the threads and ranks, in the order of HardwareCounters::get_events. */
+    std::vector<double> counts;
+  };
+
+  /*! @brief Enters a child phase of the current phase of this thread and returns it. */
+  static Node *enter(const char *name);
+
+  /*! @brief Leaves the given phase, which is the current phase of this thread, and adds the time to it. */
+  static void leave(Node *node, double seconds);
+
+  /*! @brief Returns the statistics of all phases over the ranks of comm, where the parents precede their children.
+   *         The call is collective and must not overlap with recording threads.
+   */
+  static std::vector<Statistics> reduce(MPI_Comm comm);
+
+  /*! @brief Prints the statistics as an indented table on the root of comm. The call is collective. */
+  static void print(MPI_Comm comm, std::ostream &os);
+
+  /*! @brief Writes the statistics as a json list on the root of comm. The call is collective. */
+  static void write_json(MPI_Comm comm, const std::string &filepath);
+
+  /*! @brief Zeros the times of all the phases, e.g. after a warm up. */
+  static void reset();
+};
+
+/*! @brief Adds the time between its construction and destruction to a child phase of the current phase. */
+class ScopedPhaseTimer {
+public:
+  explicit ScopedPhaseTimer(const char *name)
+      : d_node(PhaseTimers::enter(name)),
+#ifdef MACROCIRCULATION_HARDWARE_COUNTERS
+        d_start_counts(HardwareCounters::read()),
+#endif
+        d_start(PhaseTimers::Clock::now()) {}
+
+  ScopedPhaseTimer(const ScopedPhaseTimer &) = delete;
+  ScopedPhaseTimer &operator=(const ScopedPhaseTimer &) = delete;
+
+  ~ScopedPhaseTimer() {
+#ifdef MACROCIRCULATION_HARDWARE_COUNTERS
+    const auto counts = HardwareCounters::read();
+    for (std::size_t k = 0; k < counts.size(); k += 1)
+      d_node->counts[k] += counts[k] - d_start_counts[k];
+#endif
+    const auto end = PhaseTimers::Clock::now();
+    if (PhaseTrace::is_recording())
+      PhaseTrace::record(d_node->name, d_start, end);
+    PhaseTimers::leave(d_node, std::chrono::duration<double>(end - d_start).count());
+  }
+
+private:
+  PhaseTimers::Node *d_node;
+#ifdef MACROCIRCULATION_HARDWARE_COUNTERS
+  HardwareCounters::Counts d_start_counts;
+#endif
+  PhaseTimers::Clock::time_point d_start;
+};
+
+} // namespace macrocirculation
+
+#define SCOPED_PHASE_TIMER_CONCAT_IMPL(a, b) a##b
+#define SCOPED_PHASE_TIMER_CONCAT(a, b) SCOPED_PHASE_TIMER_CONCAT_IMPL(a, b)
+
+/*! @brief Times the rest of the enclosing scope as a phase with the given name, if the phase timers are compiled in. */
+#ifdef MACROCIRCULATION_PHASE_TIMERS
+#define SCOPED_PHASE_TIMER(name) ::macrocirculation::ScopedPhaseTimer SCOPED_PHASE_TIMER_CONCAT(scoped_phase_timer_, __LINE__)(name)
+#else
+#define SCOPED_PHASE_TIMER(name)
+#endif
+
+/*! @brief Times the rest of the enclosing scope as a setup phase with the given name, e.g. the construction of the dof map.
+ *         The setup phases run once per run, hence they are recorded even without MACROCIRCULATION_PHASE_TIMERS.
+ */
+#define SCOPED_SETUP_TIMER(name) ::macrocirculation::ScopedPhaseTimer SCOPED_PHASE_TIMER_CONCAT(scoped_setup_timer_, __LINE__)(name)
+
+#endif //TUMORMODELS_PHASE_TIMERS_HPP
@@ -0,0 +1,164 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "phase_trace.hpp"
+
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
+
+#include "communication/mpi.hpp"
+
+namespace macrocirculation {
+
+namespace {
+
+/*! @brief The ring buffer of a thread, where the oldest event is overwritten first. */
+struct ThreadTrace {
+  std::vector<PhaseTrace::Event> events;
+  std::size_t next{0};
+  std::size_t num_recorded{0};
+};
+
+/*! @brief Owns the ring buffers of all the threads, such that they outlive the threads of a pool. */
+struct TraceRegistry {
+  std::mutex mutex;
+  std::vector<std::shared_ptr<ThreadTrace>> threads;
+  std::size_t capacity{0};
+  PhaseTrace::Clock::time_point epoch;
+};
+
+TraceRegistry &get_registry() {
+  static TraceRegistry registry;
+  return registry;
+}
+
+ThreadTrace &get_thread_trace() {
+  thread_local std::shared_ptr<ThreadTrace> trace = [] {
+    auto t = std::make_shared<ThreadTrace>();
+    auto &registry = get_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.threads.push_back(t);
+    return t;
+  }();
+  return *trace;
+}
+
+} // namespace
+
+std::atomic<bool> &PhaseTrace::get_recording_flag() {
+  static std::atomic<bool> recording{false};
+  return recording;
+}
+
+void PhaseTrace::start(MPI_Comm comm, std::size_t capacity) {
+  get_recording_flag().store(false, std::memory_order_release);
+
+  auto &registry = get_registry();
+  {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (auto &thread : registry.threads) {
+      thread->events.clear();
+      thread->events.shrink_to_fit();
+      thread->next = 0;
+      thread->num_recorded = 0;
+    }
+    registry.capacity = capacity;
+  }
+
+  CHECK_MPI_SUCCESS(MPI_Barrier(comm));
+  registry.epoch = Clock::now();
+  get_recording_flag().store(capacity > 0, std::memory_order_release);
+}
+
+void PhaseTrace::stop() {
+  get_recording_flag().store(false, std::memory_order_release);
+}
+
+void PhaseTrace::record(const char *name, Clock::time_point start, Clock::time_point end) {
+  const auto &registry = get_registry();
+  auto &trace = get_thread_trace();
+
+  const Event event{name,
+                    std::chrono::duration<double, std::micro>(start - registry.epoch).count(),
+                    std::chrono::duration<double, std::micro>(end - start).count()};
+  if (trace.events.size() < registry.capacity)
+    trace.events.push_back(event);
+  else
+    trace.events[trace.next] = event;
+  trace.next = (trace.next + 1) % registry.capacity;
+  trace.num_recorded += 1;
+}
+
+std::vector<std::vector<PhaseTrace::Event>> PhaseTrace::get_events() {
+  auto &registry = get_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+
+  std::vector<std::vector<Event>> events;
+  for (const auto &thread : registry.threads) {
+    // once a buffer is full, its oldest event is the next one to be overwritten
+    std::vector<Event> thread_events;
+    const auto n = thread->events.size();
+    const auto first = n < registry.capacity ? 0 : thread->next;
+    for (std::size_t k = 0; k < n; k += 1)
+      thread_events.push_back(thread->events[(first + k) % n]);
+    events.push_back(std::move(thread_events));
+  }
+  return events;
+}
+
+std::size_t PhaseTrace::num_dropped_events() {
+  auto &registry = get_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+
+  std::size_t num_dropped = 0;
+  for (const auto &thread : registry.threads)
+    num_dropped += thread->num_recorded - thread->events.size();
+  return num_dropped;
+}
+
+void PhaseTrace::write_chrome_json(MPI_Comm comm, const std::string &filepath) {
+  using json = nlohmann::json;
+
+  const int rank = mpi::rank(comm);
+  const auto events = get_events();
+
+  json local = json::array();
+  local.push_back({{"name", "process_name"}, {"ph", "M"}, {"pid", rank}, {"args", {{"name", "rank " + std::to_string(rank)}}}});
+  for (std::size_t thread = 0; thread < events.size(); thread += 1) {
+    for (const auto &e : events[thread])
+      local.push_back({{"name", e.name}, {"ph", "X"}, {"ts", e.start}, {"dur", e.duration}, {"pid", rank}, {"tid", thread}});
+  }
+  const std::string local_string = local.dump();
+
+  // the events of every rank are gathered as a json string on the root
+  const int num_ranks = mpi::size(comm);
+  const int local_size = static_cast<int>(local_string.size());
+  std::vector<int> sizes(num_ranks, 0);
+  CHECK_MPI_SUCCESS(MPI_Gather(&local_size, 1, MPI_INT, sizes.data(), 1, MPI_INT, 0, comm));
+  std::vector<int> displacements(num_ranks, 0);
+  for (int r = 1; r < num_ranks; r += 1)
+    displacements[r] = displacements[r - 1] + sizes[r - 1];
+  std::string all(rank == 0 ? static_cast<std::size_t>(displacements.back() + sizes.back()) : 0, '\0');
+  CHECK_MPI_SUCCESS(MPI_Gatherv(local_string.data(), local_size, MPI_CHAR, &all[0], sizes.data(), displacements.data(), MPI_CHAR, 0, comm));
+
+  if (rank != 0)
+    return;
+
+  json trace_events = json::array();
+  for (int r = 0; r < num_ranks; r += 1) {
+    for (auto &e : json::parse(all.substr(static_cast<std::size_t>(displacements[r]), static_cast<std::size_t>(sizes[r]))))
+      trace_events.push_back(std::move(e));
+  }
+
+  json j = {{"traceEvents", trace_events}, {"displayTimeUnit", "ms"}};
+  std::ofstream o(filepath);
+  o << j;
+}
+
+} // namespace macrocirculation
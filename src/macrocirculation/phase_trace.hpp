@@ -0,0 +1,69 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_PHASE_TRACE_HPP
+#define TUMORMODELS_PHASE_TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+namespace macrocirculation {
+
+/*! @brief Records the begin and end of the timed phases of every thread on a timeline, e.g. to see which ranks wait in the ghost exchange.
+ *
+ *  The trace is switched on and off at runtime, but it only sees the phases of SCOPED_PHASE_TIMER,
+ *  hence the library has to be compiled with MACROCIRCULATION_PHASE_TIMERS.
+ *  Every thread records into a ring buffer with a fixed capacity, which keeps the latest events,
+ *  such that the memory of a trace is bounded even if it is never stopped.
+ */
+class PhaseTrace {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /*! @brief A phase of a thread with its times in microseconds since the start of the trace. */
+  struct Event {
+    const char *name;
+    double start;
+    double duration;
+  };
+
+  /*! @brief Clears the previous trace and starts recording at most capacity events per thread.
+   *         The call is collective, such that the timelines of the ranks start together.
+   */
+  static void start(MPI_Comm comm, std::size_t capacity);
+
+  /*! @brief Stops recording, while the recorded events are kept until the next start. */
+  static void stop();
+
+  /*! @brief Returns true, if the phases are recorded. */
+  static bool is_recording() { return get_recording_flag().load(std::memory_order_acquire); }
+
+  /*! @brief Adds a phase of the calling thread to its ring buffer. */
+  static void record(const char *name, Clock::time_point start, Clock::time_point end);
+
+  /*! @brief Returns the events of all the threads of this rank, where the outer index is the thread. */
+  static std::vector<std::vector<Event>> get_events();
+
+  /*! @brief Returns the number of events of this rank, which were overwritten in the ring buffers. */
+  static std::size_t num_dropped_events();
+
+  /*! @brief Writes the events of all the ranks in the chrome tracing format, which is read by chrome://tracing or https://ui.perfetto.dev.
+   *         Every rank is a process and every thread a thread of the trace. The call is collective.
+   */
+  static void write_chrome_json(MPI_Comm comm, const std::string &filepath);
+
+private:
+  static std::atomic<bool> &get_recording_flag();
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_PHASE_TRACE_HPP
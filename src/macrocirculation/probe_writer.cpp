@@ -0,0 +1,259 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "probe_writer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <limits>
+#include <nlohmann/json.hpp>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+#include "communication/mpi.hpp"
+#include "dof_map.hpp"
+#include "explicit_nonlinear_flow_solver.hpp"
+#include "fe_type.hpp"
+#include "phase_timers.hpp"
+#include "vessel_formulas.hpp"
+
+namespace macrocirculation {
+
+namespace {
+
+bool is_little_endian() {
+  const std::uint16_t value = 1;
+  return *reinterpret_cast<const std::uint8_t *>(&value) == 1;
+}
+
+/*! @brief Projects p onto the segment from a to b and returns the parameter of the projection in [0,1]. */
+double project_onto_segment(const Point &p, const Point &a, const Point &b) {
+  const double dx = b.x - a.x, dy = b.y - a.y, dz = b.z - a.z;
+  const double length_squared = dx * dx + dy * dy + dz * dz;
+  if (length_squared == 0)
+    return 0;
+  const double theta = ((p.x - a.x) * dx + (p.y - a.y) * dy + (p.z - a.z) * dz) / length_squared;
+  return std::max(0., std::min(1., theta));
+}
+
+} // namespace
+
+ProbeWriter::ProbeWriter(MPI_Comm comm,
+                         std::string foldername,
+                         std::string datasetname,
+                         std::shared_ptr<GraphStorage> graph,
+                         std::shared_ptr<DofMap> dof_map)
+    : d_comm(comm),
+      d_foldername(std::move(foldername)),
+      d_datasetname(std::move(datasetname)),
+      d_graph(std::move(graph)),
+      d_dof_map(std::move(dof_map)),
+      d_is_setup(false),
+      d_buffer_size(1 << 20) {}
+
+ProbeWriter::~ProbeWriter() {
+  if (d_is_setup)
+    flush();
+}
+
+void ProbeWriter::add_probe(const std::string &edge_name, double s, std::string probe_name) {
+  if (probe_name.empty()) {
+    std::stringstream name;
+    name << edge_name << "_" << s;
+    probe_name = name.str();
+  }
+  add_probe(d_graph->find_edge_by_name(edge_name)->get_id(), s, std::move(probe_name));
+}
+
+void ProbeWriter::add_probe(const Point &p, std::string probe_name) {
+  // the embedded points are mapped linearly onto the vessels, as in interpolate_to_vertices
+  double best_distance = std::numeric_limits<double>::infinity();
+  std::size_t best_edge_id = 0;
+  double best_s = 0;
+  for (std::size_t e_id = 0; e_id < d_graph->num_edges(); e_id += 1) {
+    const auto &edge = d_graph->edge(e_id);
+    if (!edge.has_embedding_data())
+      continue;
+    const auto &points = edge.get_embedding_data().points;
+    for (std::size_t k = 0; k + 1 < points.size(); k += 1) {
+      const double theta = project_onto_segment(p, points[k], points[k + 1]);
+      const double distance = Point::distance(p, convex_combination(points[k], points[k + 1], theta));
+      if (distance < best_distance) {
+        best_distance = distance;
+        best_edge_id = e_id;
+        best_s = (static_cast<double>(k) + theta) / static_cast<double>(points.size() - 1);
+      }
+    }
+  }
+
+  if (std::isinf(best_distance))
+    throw std::runtime_error("probes at points need embedded vessels");
+
+  if (probe_name.empty()) {
+    std::stringstream name;
+    name << "(" << p.x << "," << p.y << "," << p.z << ")";
+    probe_name = name.str();
+  }
+  add_probe(best_edge_id, best_s, std::move(probe_name));
+}
+
+void ProbeWriter::add_probe(std::size_t edge_id, double s, std::string probe_name) {
+  if (d_is_setup)
+    throw std::runtime_error("cannot add probes after setup was called");
+  if (s < 0 || s > 1)
+    throw std::runtime_error("the coordinate of probe " + probe_name + " is not in [0,1]");
+
+  const auto num_micro_edges = d_graph->edge(edge_id).num_micro_edges();
+  const auto micro_edge = std::min(static_cast<std::size_t>(s * static_cast<double>(num_micro_edges)), num_micro_edges - 1);
+  d_probes.push_back({std::move(probe_name), edge_id, s, micro_edge});
+}
+
+void ProbeWriter::set_buffer_size(std::size_t buffer_size) {
+  d_buffer_size = buffer_size;
+}
+
+void ProbeWriter::setup() {
+  if (d_is_setup)
+    throw std::runtime_error("setup was already called");
+  d_is_setup = true;
+
+  const auto rank = mpi::rank(d_comm);
+  for (const auto &probe : d_probes) {
+    const auto &edge = d_graph->edge(probe.edge_id);
+    if (edge.rank() != rank)
+      continue;
+
+    const auto &local_dof_map = d_dof_map->get_local_dof_map(edge);
+    const auto &param = edge.get_physical_data();
+
+    // the reference coordinate in [-1,+1] on the micro edge
+    const double x = probe.s * static_cast<double>(edge.num_micro_edges()) - static_cast<double>(probe.micro_edge);
+    const double xi = 2 * x - 1;
+
+    LocalProbe local_probe{
+      local_dof_map.first_dof(probe.micro_edge, ExplicitNonlinearFlowSolver::Q_component),
+      local_dof_map.first_dof(probe.micro_edge, ExplicitNonlinearFlowSolver::A_component),
+      param.G0,
+      param.A0,
+      {}};
+    const auto phi = evaluate_legendre(xi);
+    local_probe.phi.assign(phi.begin(), phi.begin() + static_cast<std::ptrdiff_t>(local_dof_map.num_basis_functions()));
+    d_local_probes.push_back(std::move(local_probe));
+  }
+
+  if (!d_local_probes.empty()) {
+    const auto path = d_foldername + "/" + get_binary_file_name(rank);
+    d_file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!d_file)
+      throw std::runtime_error("could not open " + path + " for writing");
+  }
+
+  write_meta_file();
+}
+
+MemoryReport ProbeWriter::memory_report() const {
+  MemoryReport report;
+  report.add("probes", d_probes);
+  report.add("probes", d_local_probes);
+  for (const auto &probe : d_local_probes)
+    report.add("probes", probe.phi);
+  report.add("buffer", d_buffer);
+  return report;
+}
+
+void ProbeWriter::write(double t, const std::vector<double> &u) {
+  SCOPED_PHASE_TIMER("output");
+  if (!d_is_setup)
+    throw std::runtime_error("probes can only be written after calling setup");
+
+  if (d_local_probes.empty())
+    return;
+
+  d_buffer.push_back(t);
+  for (const auto &probe : d_local_probes) {
+    double q = 0, a = 0;
+    for (std::size_t k = 0; k < probe.phi.size(); k += 1) {
+      q += probe.phi[k] * u[probe.first_dof_q + k];
+      a += probe.phi[k] * u[probe.first_dof_a + k];
+    }
+    d_buffer.push_back(nonlinear::get_p_from_A(a, probe.G0, probe.A0));
+    d_buffer.push_back(q);
+    d_buffer.push_back(a);
+  }
+
+  if (d_buffer.size() * sizeof(double) >= d_buffer_size)
+    flush();
+}
+
+void ProbeWriter::flush() {
+  if (!d_file.is_open() || d_buffer.empty())
+    return;
+  d_file.write(reinterpret_cast<const char *>(d_buffer.data()), static_cast<std::streamsize>(d_buffer.size() * sizeof(double)));
+  d_file.flush();
+  d_buffer.clear();
+}
+
+std::size_t ProbeWriter::get_record_size(int rank) const {
+  std::size_t num_probes = 0;
+  for (const auto &probe : d_probes)
+    if (d_graph->edge(probe.edge_id).rank() == rank)
+      num_probes += 1;
+  // ranks without probes do not write anything
+  return num_probes > 0 ? 1 + num_quantities * num_probes : 0;
+}
+
+std::string ProbeWriter::get_meta_file_name() const {
+  return d_foldername + "/" + d_datasetname + ".json";
+}
+
+std::string ProbeWriter::get_binary_file_name(int rank) const {
+  std::stringstream name;
+  name << d_datasetname << "_rank" << std::setfill('0') << std::setw(5) << rank << ".bin";
+  return name.str();
+}
+
+void ProbeWriter::write_meta_file() const {
+  // only one rank writes the file
+  if (mpi::rank(d_comm) != 0)
+    return;
+
+  using json = nlohmann::json;
+
+  auto rank_list = json::array();
+  for (int rank = 0; rank < mpi::size(d_comm); rank += 1)
+    rank_list.push_back({{"filepath", get_binary_file_name(rank)}, {"record_size", get_record_size(rank)}});
+
+  // the offsets of the probes within a record follow the order in which they were added
+  std::vector<std::size_t> next_offset(static_cast<std::size_t>(mpi::size(d_comm)), 1);
+  auto probe_list = json::array();
+  for (const auto &probe : d_probes) {
+    const auto &edge = d_graph->edge(probe.edge_id);
+    auto &offset = next_offset[static_cast<std::size_t>(edge.rank())];
+    probe_list.push_back({{"name", probe.name},
+                          {"edge_id", probe.edge_id},
+                          {"edge_name", edge.get_name()},
+                          {"s", probe.s},
+                          {"micro_edge", probe.micro_edge},
+                          {"rank", edge.rank()},
+                          {"offsets", {{"p", offset}, {"q", offset + 1}, {"a", offset + 2}}}});
+    offset += num_quantities;
+  }
+
+  json j;
+  j["format"] = "binary";
+  j["byte_order"] = is_little_endian() ? "little" : "big";
+  j["ranks"] = rank_list;
+  j["probes"] = probe_list;
+
+  std::ofstream f(get_meta_file_name(), std::ios::out);
+  f << j.dump(1);
+}
+
+} // namespace macrocirculation
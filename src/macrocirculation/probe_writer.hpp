@@ -0,0 +1,128 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_PROBE_WRITER_HPP
+#define TUMORMODELS_PROBE_WRITER_HPP
+
+#include <cstddef>
+#include <fstream>
+#include <memory>
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+#include "graph_storage.hpp"
+
+namespace macrocirculation {
+
+// forward declarations
+class DofMap;
+
+/*! @brief Records the static pressure, the flow and the area of the nonlinear flow solver at a few points of the network.
+ *
+ *  The probes are given by a vessel name and a coordinate s in [0,1] along the vessel, or by a point, which is projected
+ *  onto the closest embedded vessel. In setup they are resolved once to their rank, micro edge and the values of the
+ *  basis functions, such that writing a time step only costs a few multiply-adds per probe.
+ *
+ *  Every rank owning probes appends a record of doubles in the native byte order to its binary file,
+ *  which starts with the time, followed by p, q and a of each of its probes.
+ *  The records are buffered and only reach the disk once the buffer is full, on flush or when the writer is destroyed.
+ *  A json index written by rank 0 has the same layout as the one of the GraphBinaryWriter, with a list of probes
+ *  instead of vessels, see tools/visualization/graph_data.py for a reader.
+ */
+class ProbeWriter {
+public:
+  ProbeWriter(MPI_Comm comm,
+              std::string foldername,
+              std::string datasetname,
+              std::shared_ptr<GraphStorage> graph,
+              std::shared_ptr<DofMap> dof_map);
+
+  ProbeWriter(const ProbeWriter &) = delete;
+  ProbeWriter &operator=(const ProbeWriter &) = delete;
+
+  ~ProbeWriter();
+
+  /*! @brief Adds a probe on the named vessel at s in [0,1], where 0 is its left and 1 its right vertex.
+   *         An empty probe name is replaced by the vessel name and s.
+   */
+  void add_probe(const std::string &edge_name, double s, std::string probe_name = "");
+
+  /*! @brief Adds a probe at the point of the embedded vessels, which is closest to p. */
+  void add_probe(const Point &p, std::string probe_name = "");
+
+  /*! @brief Sets the buffer size in bytes, after which the records are written to the file. */
+  void set_buffer_size(std::size_t buffer_size);
+
+  /*! @brief Resolves the probes, truncates the file of our rank and writes the index. Has to be called on all the ranks. */
+  void setup();
+
+  /*! @brief Evaluates all the probes of our rank for the solution u at time t. */
+  void write(double t, const std::vector<double> &u);
+
+  /*! @brief Writes the buffered records of our rank to its file. */
+  void flush();
+
+  /*! @brief Returns the memory of the probes and of the buffered records. */
+  MemoryReport memory_report() const;
+
+  /*! @brief The number of doubles per probe in a record. */
+  static constexpr std::size_t num_quantities = 3;
+
+private:
+  struct Probe {
+    std::string name;
+    std::size_t edge_id;
+    double s;
+    std::size_t micro_edge;
+  };
+
+  /*! @brief A probe of our rank together with everything needed to evaluate it. */
+  struct LocalProbe {
+    std::size_t first_dof_q;
+    std::size_t first_dof_a;
+    double G0;
+    double A0;
+    /*! @brief The basis functions evaluated at the reference coordinate of the probe. */
+    std::vector<double> phi;
+  };
+
+  MPI_Comm d_comm;
+  std::string d_foldername;
+  std::string d_datasetname;
+
+  std::shared_ptr<GraphStorage> d_graph;
+  std::shared_ptr<DofMap> d_dof_map;
+
+  bool d_is_setup;
+
+  std::size_t d_buffer_size;
+
+  std::vector<Probe> d_probes;
+
+  std::vector<LocalProbe> d_local_probes;
+
+  /*! @brief The file of our rank, which is only opened if we own probes. */
+  std::ofstream d_file;
+
+  /*! @brief The records, which were not yet written to the file. */
+  std::vector<double> d_buffer;
+
+  void add_probe(std::size_t edge_id, double s, std::string probe_name);
+
+  std::size_t get_record_size(int rank) const;
+
+  void write_meta_file() const;
+
+  std::string get_meta_file_name() const;
+
+  std::string get_binary_file_name(int rank) const;
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_PROBE_WRITER_HPP
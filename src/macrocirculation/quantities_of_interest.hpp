@@ -18,6 +18,7 @@ class GraphStorage;
 class DofMap;
 class Point;
 
+/*! @brief Evaluates the total pressure at the endpoints of the micro edges, see InterpolationPlan for repeated evaluations. */
 void calculate_total_pressure(MPI_Comm comm,
                               const GraphStorage &graph,
                               const DofMap &map,
@@ -25,6 +26,7 @@ void calculate_total_pressure(MPI_Comm comm,
                               std::vector<Point> &points,
                               std::vector<double> &interpolated);
 
+/*! @brief Evaluates the static pressure at the endpoints of the micro edges, see InterpolationPlan for repeated evaluations. */
 void calculate_static_pressure(MPI_Comm comm,
                                const GraphStorage &graph,
                                const DofMap &map,
@@ -15,109 +15,110 @@
 #include "communication/mpi.hpp"
 #include "explicit_nonlinear_flow_solver.hpp"
 #include "graph_storage.hpp"
+#include "implicit_linear_flow_solver.hpp"
 #include "vessel_formulas.hpp"
 
 namespace macrocirculation {
 
 FlowIntegrator::FlowIntegrator(std::shared_ptr<GraphStorage> graph)
-    : d_graph(std::move(graph)) {
+    : FlowIntegrator(MPI_COMM_WORLD, std::move(graph)) {}
+
+FlowIntegrator::FlowIntegrator(MPI_Comm comm, std::shared_ptr<GraphStorage> graph)
+    : d_comm(comm),
+      d_graph(std::move(graph)) {
   reset();
 }
 
 void FlowIntegrator::reset() {
-  d_total_flows.clear();
+  d_outlet_vertex_ids.clear();
+  d_outlet_numbers.assign(d_graph->num_vertices(), static_cast<size_t>(-1));
 
-  for (auto v_id : d_graph->get_active_vertex_ids(mpi::rank(MPI_COMM_WORLD))) {
-    if (d_graph->get_vertex(v_id)->is_free_outflow())
-      d_total_flows[v_id] = 0.;
+  for (auto v_id : d_graph->get_vertex_ids()) {
+    if (!d_graph->vertex(v_id).is_leaf())
+      continue;
+    d_outlet_numbers[v_id] = d_outlet_vertex_ids.size();
+    d_outlet_vertex_ids.push_back(v_id);
   }
+
+  d_total_flows.assign(d_outlet_vertex_ids.size(), 0.);
 }
 
 void FlowIntegrator::update_flow(const ExplicitNonlinearFlowSolver &solver, double tau) {
   update_flow_abstract(solver, tau);
 }
 
+void FlowIntegrator::update_flow(const ImplicitLinearFlowSolver &solver, double tau) {
+  update_flow_abstract(solver, tau);
+}
+
 template<typename Solver>
 void FlowIntegrator::update_flow_abstract(const Solver &solver, double tau) {
-  for (auto v_id : d_graph->get_active_vertex_ids(mpi::rank(MPI_COMM_WORLD))) {
-    auto v = d_graph->get_vertex(v_id);
-    if (v->is_leaf()) {
-      auto &edge = *d_graph->get_edge(v->get_edge_neighbors()[0]);
+  for (auto v_id : d_graph->get_active_vertex_ids(mpi::rank(d_comm))) {
+    auto &v = d_graph->vertex(v_id);
+    if (v.is_leaf()) {
+      auto &edge = d_graph->edge(v.get_edge_neighbors()[0]);
       double sigma = edge.is_pointing_to(v_id) ? +1. : -1;
       double p, q;
-      solver.get_1d_pq_values_at_vertex(*v, p, q);
-      d_total_flows[v_id] += sigma * q * tau;
+      solver.get_1d_pq_values_at_vertex(v, p, q);
+      d_total_flows[d_outlet_numbers[v_id]] += sigma * q * tau;
     }
   }
 }
 
-FlowData FlowIntegrator::get_free_outflow_data() const {
-  FlowData data;
-  data.total_flow = 0;
+std::vector<double> FlowIntegrator::reduce_total_flows() const {
+  std::vector<double> total_flows(d_total_flows);
+  MPI_Allreduce(MPI_IN_PLACE, total_flows.data(), static_cast<int>(total_flows.size()), MPI_DOUBLE, MPI_SUM, d_comm);
+  return total_flows;
+}
 
-  for (auto v_id : d_graph->get_vertex_ids()) {
-    auto v = d_graph->get_vertex(v_id);
-    if (v->is_free_outflow()) {
-      auto &e = *d_graph->get_edge(v->get_edge_neighbors()[0]);
-      double q = 0;
-      if (e.rank() == mpi::rank(MPI_COMM_WORLD)) {
-        q = d_total_flows.at(v_id);
-      }
-      std::cout << v_id << " " << q << std::endl;
-      MPI_Bcast(&q, 1, MPI_DOUBLE, e.rank(), MPI_COMM_WORLD);
-      data.flows[v_id] = q;
-      data.total_flow += q;
-    }
-  }
-  return data;
-};
+FlowData FlowIntegrator::get_outflow_data(const std::function<bool(const Vertex &)> &predicate) const {
+  const auto total_flows = reduce_total_flows();
 
-FlowData FlowIntegrator::get_windkessel_outflow_data() const {
-  // TODO: This is a direct copy of get_free_outflow_data with one change. Refactor this
   FlowData data;
   data.total_flow = 0;
 
-  for (auto v_id : d_graph->get_vertex_ids()) {
-    auto v = d_graph->get_vertex(v_id);
-    if (v->is_windkessel_outflow()) {  // CHANGE!
-      auto &e = *d_graph->get_edge(v->get_edge_neighbors()[0]);
-      double q = 0;
-      if (e.rank() == mpi::rank(MPI_COMM_WORLD)) {
-        q = d_total_flows.at(v_id);
-      }
+  for (std::size_t outlet = 0; outlet < d_outlet_vertex_ids.size(); outlet += 1) {
+    const auto v_id = d_outlet_vertex_ids[outlet];
+    if (predicate(d_graph->vertex(v_id))) {
+      const double q = total_flows[outlet];
       std::cout << v_id << " " << q << std::endl;
-      MPI_Bcast(&q, 1, MPI_DOUBLE, e.rank(), MPI_COMM_WORLD);
       data.flows[v_id] = q;
       data.total_flow += q;
     }
   }
   return data;
-};
+}
 
+FlowData FlowIntegrator::get_free_outflow_data() const {
+  return get_outflow_data([](const Vertex &v) { return v.is_free_outflow(); });
+}
 
-double get_total_edge_capacitance(const std::shared_ptr<GraphStorage> &graph) {
-  double total_C_edge = 0;
-  for (auto e_id : graph->get_active_edge_ids(mpi::rank(MPI_COMM_WORLD))) {
-    auto e = graph->get_edge(e_id);
-    auto &data = e->get_physical_data();
+FlowData FlowIntegrator::get_windkessel_outflow_data() const {
+  return get_outflow_data([](const Vertex &v) { return v.is_windkessel_outflow(); });
+}
+
+double get_total_edge_capacitance(const std::shared_ptr<GraphStorage> &graph, MPI_Comm comm) {
+  // the capacitances are summed in the order of the edges, such that the total does not depend on the number of ranks
+  std::vector<double> C_edges(graph->num_edges(), 0);
+  for (auto e_id : graph->get_active_edge_ids(mpi::rank(comm))) {
+    auto &e = graph->edge(e_id);
+    auto &data = e.get_physical_data();
 
     double c0 = calculate_c0(data.G0, data.rho, data.A0); // [cm/s]
 
     // in meter
     double C_e = data.length * data.A0 / (data.rho * std::pow(c0, 2));
 
-    total_C_edge += C_e;
+    C_edges[e_id] = C_e;
   }
 
-  MPI_Allreduce(&total_C_edge, &total_C_edge, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
-
-  return total_C_edge;
+  return mpi::ordered_sum(comm, C_edges, 1)[0];
 }
 
-double get_total_edge_capacitance(const std::vector<std::shared_ptr<GraphStorage>> &list) {
+double get_total_edge_capacitance(const std::vector<std::shared_ptr<GraphStorage>> &list, MPI_Comm comm) {
   double sum = 0;
   for (auto graph : list)
-    sum += get_total_edge_capacitance(graph);
+    sum += get_total_edge_capacitance(graph, comm);
   return sum;
 }
 
@@ -129,7 +130,11 @@ double get_total_flow(const std::vector<FlowData> &flows) {
 }
 
 RCREstimator::RCREstimator(std::vector<std::shared_ptr<GraphStorage>> graph_list)
-    : d_graph_list(std::move(graph_list)),
+    : RCREstimator(MPI_COMM_WORLD, std::move(graph_list)) {}
+
+RCREstimator::RCREstimator(MPI_Comm comm, std::vector<std::shared_ptr<GraphStorage>> graph_list)
+    : d_comm(comm),
+      d_graph_list(std::move(graph_list)),
       d_total_C_edge(0),
       d_total_R(1.34),   // 1.34e8 Pa s / m^3   ([Pa s / m^-3] = 10^{-8} [kg/s cm])
       d_total_C(9.45e-1) // 9.e5e-9 m^3/Pa ([m^3 / Pa] = 10^8 [cm s^2 / kg])
@@ -138,7 +143,7 @@ RCREstimator::RCREstimator(std::vector<std::shared_ptr<GraphStorage>> graph_list
 }
 
 void RCREstimator::reset() {
-  d_total_C_edge = get_total_edge_capacitance(d_graph_list);
+  d_total_C_edge = get_total_edge_capacitance(d_graph_list, d_comm);
 }
 
 void RCREstimator::set_total_C(double C) { d_total_C = C; }
@@ -167,9 +172,9 @@ std::map<size_t, RCRData> RCREstimator::estimate_parameters(const std::map<size_
   return resistances;
 };
 
-void parameters_to_json(const std::string &filepath, const std::map<size_t, RCRData> &parameters, const std::shared_ptr<GraphStorage> &storage) {
+void parameters_to_json(const std::string &filepath, const std::map<size_t, RCRData> &parameters, const std::shared_ptr<GraphStorage> &storage, MPI_Comm comm) {
   // only root writes the file
-  if (mpi::rank(MPI_COMM_WORLD) != 0)
+  if (mpi::rank(comm) != 0)
     return;
 
   using json = nlohmann::json;
@@ -181,7 +186,7 @@ void parameters_to_json(const std::string &filepath, const std::map<size_t, RCRD
   for (auto it : parameters) {
     const auto v_id = it.first;
     const auto data = it.second;
-    const auto &v = *storage->get_vertex(v_id);
+    const auto &v = storage->vertex(v_id);
 
     if (v.get_name().empty())
       throw std::runtime_error("cannot serialize unnamed vertex");
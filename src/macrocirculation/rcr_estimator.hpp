@@ -8,13 +8,17 @@
 #ifndef TUMORMODELS_RCR_ESTIMATOR_HPP
 #define TUMORMODELS_RCR_ESTIMATOR_HPP
 
+#include <functional>
 #include <map>
 #include <memory>
 #include <mpi.h>
+#include <string>
+#include <vector>
 
 namespace macrocirculation {
 
 class GraphStorage;
+class Vertex;
 class ExplicitNonlinearFlowSolver;
 class ImplicitLinearFlowSolver;
 
@@ -31,31 +35,53 @@ class FlowIntegrator {
 public:
   explicit FlowIntegrator(std::shared_ptr<GraphStorage> graph);
 
+  FlowIntegrator(MPI_Comm comm, std::shared_ptr<GraphStorage> graph);
+
   void reset();
 
   /*! @brief Adds the flow contributions of the current time step to the total amount */
   void update_flow(const ExplicitNonlinearFlowSolver &solver, double tau);
 
+  /*! @brief Adds the flow contributions of the current time step of the linearized model to the total amount */
+  void update_flow(const ImplicitLinearFlowSolver &solver, double tau);
+
   /*! @brief Returns a data structure containing _all_ the flows and the total flow. */
   FlowData get_free_outflow_data() const;
 
   FlowData get_windkessel_outflow_data() const;
 
 protected:
+  MPI_Comm d_comm;
+
   std::shared_ptr<GraphStorage> d_graph;
 
-  /*! @brief Maps vertex ids to the total flow integrated over time. */
-  std::map<size_t, double> d_total_flows;
+  /*! @brief The vertex ids of all the vessel tips, which numbers the outlets identically on all the ranks. */
+  std::vector<size_t> d_outlet_vertex_ids;
+
+  /*! @brief The outlet number of every vertex id, or -1 if the vertex is no vessel tip. */
+  std::vector<size_t> d_outlet_numbers;
+
+  /*! @brief The total flow integrated over time, indexed by the outlet number.
+   *         Every rank only accumulates the outlets of its edges, hence the partial sums of all the ranks
+   *         add up to the total flows even if the edges were moved to other ranks in between.
+   */
+  std::vector<double> d_total_flows;
+
+  /*! @brief Sums the total flows of all the ranks with a single reduction on the whole array. */
+  std::vector<double> reduce_total_flows() const;
+
+  /*! @brief Collects the reduced flows of all the outlets satisfying the predicate. */
+  FlowData get_outflow_data(const std::function<bool(const Vertex &)> &predicate) const;
 
   template<typename Solver>
   void update_flow_abstract(const Solver &solver, double tau);
 };
 
 /*! @returns The total edge capacitance by summing over all ranks. */
-double get_total_edge_capacitance(const std::shared_ptr<GraphStorage> &graph);
+double get_total_edge_capacitance(const std::shared_ptr<GraphStorage> &graph, MPI_Comm comm = MPI_COMM_WORLD);
 
 /*! @returns The total edge capacitance for a list of vessel networks by summing over all ranks. */
-double get_total_edge_capacitance(const std::vector<std::shared_ptr<GraphStorage>> &list);
+double get_total_edge_capacitance(const std::vector<std::shared_ptr<GraphStorage>> &list, MPI_Comm comm = MPI_COMM_WORLD);
 
 /*! @returns The total flow through all free-outflow boundaries. */
 double get_total_flow(const std::vector<FlowData> &flows);
@@ -75,6 +101,8 @@ public:
   /*! @brief Constructs the RCR-estimator from a list of vessel networks. */
   RCREstimator(std::vector<std::shared_ptr<GraphStorage>> graph_list);
 
+  RCREstimator(MPI_Comm comm, std::vector<std::shared_ptr<GraphStorage>> graph_list);
+
   /*! @brief Resets the total edge capacitance. */
   void reset();
 
@@ -99,6 +127,8 @@ public:
   static double capacitance_from_flow(double total_C, double flow);
 
 protected:
+  MPI_Comm d_comm;
+
   std::vector<std::shared_ptr<GraphStorage>> d_graph_list;
 
   /*! @brief Maps vertex ids to the total flow integrated over time. */
@@ -114,7 +144,7 @@ protected:
   double d_total_C;
 };
 
-void parameters_to_json(const std::string &filepath, const std::map<size_t, RCRData> &parameters, const std::shared_ptr<GraphStorage> &storage);
+void parameters_to_json(const std::string &filepath, const std::map<size_t, RCRData> &parameters, const std::shared_ptr<GraphStorage> &storage, MPI_Comm comm = MPI_COMM_WORLD);
 
 } // namespace macrocirculation
 
@@ -7,15 +7,92 @@
 
 #include "right_hand_side_evaluator.hpp"
 
+#include <Eigen/Dense>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <unsupported/Eigen/MatrixFunctions>
 #include <utility>
 
 #include "communication/mpi.hpp"
 #include "dof_map.hpp"
-#include "fe_type.hpp"
+#include "graph_partitioner.hpp"
+#include "load_balancing.hpp"
+#include "phase_timers.hpp"
+#include "task_graph.hpp"
+#include "thread_pool.hpp"
 #include "vessel_formulas.hpp"
 
 namespace macrocirculation {
 
+namespace {
+
+/*! @brief The derivative of the flow out of the vessel with respect to the pressure of the first 0D compartment.
+ *         The characteristic resistance rho c / A of the vessel is roughly R1 and lies in series with R1.
+ */
+inline double dQ_out_dp_c(double R1) { return 1. / (2 * R1); }
+
+/*! @brief Solves (I - tau J) x = f in place for a tridiagonal J of size n given by its lower, main and upper diagonal with the thomas algorithm.
+ *         c is resized to n and used as temporary storage.
+ */
+void solve_implicit_euler_tridiagonal(double tau, std::size_t n, const double *lower, const double *diag, const double *upper, double *f, std::vector<double> &c) {
+  c.resize(n);
+
+  // forward elimination
+  double b = 1 - tau * diag[0];
+  c[0] = -tau * upper[0] / b;
+  f[0] /= b;
+  for (std::size_t k = 1; k < n; k += 1) {
+    const double a = -tau * lower[k];
+    b = 1 - tau * diag[k] - a * c[k - 1];
+    c[k] = -tau * upper[k] / b;
+    f[k] = (f[k] - a * f[k - 1]) / b;
+  }
+
+  // back substitution
+  for (std::size_t k = n - 1; k-- > 0;)
+    f[k] -= c[k] * f[k + 1];
+}
+
+/*! @brief Calculates phi_1(tau J) = (tau J)^{-1} (e^{tau J} - I) for a tridiagonal J of size n into the dense row-major matrix phi.
+ *         phi_1(tau J) is the upper right block of the exponential of the augmented matrix [[tau J, I], [0, 0]].
+ */
+void calculate_phi_1_tridiagonal(double tau, std::size_t n, const double *lower, const double *diag, const double *upper, double *phi) {
+  const auto m = static_cast<Eigen::Index>(n);
+  Eigen::MatrixXd augmented = Eigen::MatrixXd::Zero(2 * m, 2 * m);
+  for (Eigen::Index k = 0; k < m; k += 1) {
+    if (k > 0)
+      augmented(k, k - 1) = tau * lower[k];
+    augmented(k, k) = tau * diag[k];
+    if (k + 1 < m)
+      augmented(k, k + 1) = tau * upper[k];
+    augmented(k, m + k) = 1;
+  }
+  const Eigen::MatrixXd exponential = augmented.exp();
+  Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(phi, m, m) = exponential.topRightCorner(m, m);
+}
+
+/*! @brief Replaces f by the product of the dense row-major n x n matrix with f.
+ *         x is resized to n and used as temporary storage.
+ */
+void multiply_dense(std::size_t n, const double *matrix, double *f, std::vector<double> &x) {
+  x.assign(f, f + n);
+  for (std::size_t i = 0; i < n; i += 1) {
+    double sum = 0;
+    for (std::size_t j = 0; j < n; j += 1)
+      sum += matrix[i * n + j] * x[j];
+    f[i] = sum;
+  }
+}
+
+/*! @brief The number of step lengths, for which we keep the propagators of the exponential euler step. */
+constexpr std::size_t max_cached_step_lengths = 16;
+
+} // namespace
+
 default_S::default_S(double phi)
     : d_phi(phi) {}
 
@@ -34,299 +111,1191 @@ void default_S::operator()(double,
   const double mu = e.get_physical_data().viscosity;
   const double gamma = e.get_physical_data().gamma;
 
+  // the friction coefficient is the same for all quadrature points
+  const double friction = -2 * mu * M_PI * (gamma + 2);
+
   for (std::size_t qp = 0; qp < Q.size(); qp += 1) {
-    S_Q_out[qp] = -2 * mu * M_PI * (gamma + 2) * Q[qp] / A[qp];
+    S_Q_out[qp] = friction * Q[qp] / A[qp];
     S_A_out[qp] = d_phi;
   }
 }
 
+namespace {
+
+/*! @brief The 0D models are integrated without a mass matrix. */
+void assemble_inverse_mass_on_vertices(MPI_Comm comm, const GraphStorage &graph, const DofMap &dof_map, std::vector<double> &inv_mass) {
+  for (const auto &v_id : graph.get_active_vertex_ids(mpi::rank(comm))) {
+    auto &vertex = graph.vertex(v_id);
+
+    // TODO: This is stupid!
+    if (vertex.is_windkessel_outflow() || vertex.is_vessel_tree_outflow() || vertex.is_rcl_outflow()) {
+      auto &vertex_dof_map = dof_map.get_local_dof_map(vertex);
+      for (auto i = vertex_dof_map.first_dof(); i < vertex_dof_map.first_dof() + vertex_dof_map.num_local_dof(); i += 1) {
+        inv_mass[i] = 1;
+      }
+    }
+  }
+}
+
+} // namespace
+
 void assemble_inverse_mass(MPI_Comm comm, const GraphStorage &graph, const DofMap &dof_map, std::vector<double> &inv_mass) {
+  SCOPED_SETUP_TIMER("inverse mass");
   // make sure that the inverse mass vector is large enough
   assert(inv_mass.size() == dof_map.num_dof());
 
-  // the squared norm of the legendre polynomials on [-1, +1]
-  std::vector<double> legendre_weight = {2, 2. / 3., 0.4, 0.285714};
-
-  std::vector<std::size_t> dof_indices(4, 0);
+  std::vector<std::size_t> dof_indices(max_fe_degree + 1, 0);
 
   for (const auto &e_id : graph.get_active_edge_ids(mpi::rank(comm))) {
-    const auto edge = graph.get_edge(e_id);
+    const auto *edge = &graph.edge(e_id);
     const auto local_dof_map = dof_map.get_local_dof_map(*edge);
 
     const std::size_t num_basis_functions = local_dof_map.num_basis_functions();
 
-    // assert that we have precalculated enough weights
-    assert(num_basis_functions <= legendre_weight.size());
+    assert(num_basis_functions <= max_fe_degree + 1);
 
     dof_indices.resize(num_basis_functions);
 
     const auto edge_length = edge->get_physical_data().length;
     const auto micro_edge_length = edge_length / local_dof_map.num_micro_edges();
-    const double edge_weight = micro_edge_length / 2;
+    const auto micro_edge_lengths = edge->has_micro_edge_lengths() ? edge->get_micro_edge_lengths() : std::vector<double>();
 
     for (std::size_t component = 0; component < local_dof_map.num_components(); component += 1) {
       for (std::size_t local_micro_edge_id = 0; local_micro_edge_id < local_dof_map.num_micro_edges();
            local_micro_edge_id += 1) {
+        const double edge_weight = (micro_edge_lengths.empty() ? micro_edge_length : micro_edge_lengths[local_micro_edge_id]) / 2;
         local_dof_map.dof_indices(local_micro_edge_id, component, dof_indices);
 
         for (std::size_t i = 0; i < num_basis_functions; i += 1) {
-          const double mass = legendre_weight[i] * edge_weight;
+          const double mass = legendre_weight(i) * edge_weight;
           inv_mass[dof_indices[i]] = 1. / mass;
         }
       }
     }
   }
 
-  for (const auto &v_id : graph.get_active_vertex_ids(mpi::rank(comm))) {
-    auto &vertex = *graph.get_vertex(v_id);
 
-    // TODO: This is stupid!
-    if (vertex.is_windkessel_outflow() || vertex.is_vessel_tree_outflow()) {
-      auto &vertex_dof_map = dof_map.get_local_dof_map(vertex);
-      auto &indices = vertex_dof_map.dof_indices();
-      for (auto i : indices) {
-        inv_mass[i] = 1;
-      }
-    }
-  }
+  assemble_inverse_mass_on_vertices(comm, graph, dof_map, inv_mass);
 }
 
 RightHandSideEvaluator::RightHandSideEvaluator(MPI_Comm comm,
                                                std::shared_ptr<GraphStorage> graph,
-                                               std::shared_ptr<DofMap> dof_map,
-                                               std::size_t degree)
+                                               std::shared_ptr<DofMap> dof_map)
     : d_comm(comm),
       d_graph(std::move(graph)),
       d_dof_map(std::move(dof_map)),
-      d_flow_upwind_evaluator(comm, d_graph, d_dof_map),
-      d_S_evaluator(default_S{
-        0 // 0 cm^2/s, no wall permeability
-      }),
-      d_degree(degree),
-      d_inverse_mass(d_dof_map->num_dof()) {
-  assemble_inverse_mass(d_comm, *d_graph, *d_dof_map, d_inverse_mass);
+      d_flow_upwind_evaluator(std::make_shared<NonlinearFlowUpwindEvaluator>(comm, d_graph, d_dof_map)),
+      d_S_type(SourceType::default_S),
+      d_default_S_phi(0), // 0 cm^2/s, no wall permeability
+      d_quadrature_type(QuadratureType::gauss),
+      d_edge_kernels{},
+      d_batch_kernels{},
+      d_max_batched_micro_edges(8),
+      d_edge_work(1),
+      d_coupled_u(nullptr),
+      d_assemble_coupled(false),
+      d_0d_treatment(ZeroDTreatment::explicit_stages),
+      d_task_scheduling(false),
+      d_first_receive_task(0) {
+  select_edge_kernel();
+  setup_caches();
+}
+
+RightHandSideEvaluator::~RightHandSideEvaluator() = default;
+
+void RightHandSideEvaluator::select_edge_kernel() {
+  // select the kernels once, so that the hot loop knows all the array sizes and the source term at compile time
+  const bool use_default_S = d_S_type == SourceType::default_S;
+  if (d_quadrature_type == QuadratureType::gauss_lobatto)
+    d_edge_kernels = get_edge_kernels<QuadratureType::gauss_lobatto>(use_default_S);
+  else if (d_quadrature_type == QuadratureType::gauss_over_integration)
+    d_edge_kernels = get_edge_kernels<QuadratureType::gauss_over_integration>(use_default_S);
+  else
+    d_edge_kernels = get_edge_kernels<QuadratureType::gauss>(use_default_S);
+
+  // the batches always use the default right-hand side S
+  constexpr auto degrees = std::make_index_sequence<max_fe_degree + 1>{};
+  if (d_quadrature_type == QuadratureType::gauss_lobatto)
+    d_batch_kernels = get_batch_kernels<QuadratureType::gauss_lobatto>(degrees);
+  else if (d_quadrature_type == QuadratureType::gauss_over_integration)
+    d_batch_kernels = get_batch_kernels<QuadratureType::gauss_over_integration>(degrees);
+  else
+    d_batch_kernels = get_batch_kernels<QuadratureType::gauss>(degrees);
+}
+
+void RightHandSideEvaluator::set_quadrature_type(QuadratureType type) {
+  d_quadrature_type = type;
+  select_edge_kernel();
+  // the quadrature points of the edges and the inverse mass change
+  setup_caches();
+}
+
+void RightHandSideEvaluator::reinit() {
+  d_flow_upwind_evaluator->reinit();
+  setup_caches();
+}
+
+void RightHandSideEvaluator::update_0d_parameters() {
+  setup_0d_models();
+}
+
+void RightHandSideEvaluator::update_vertex_dofs() {
+  d_flow_upwind_evaluator->update_vertex_dofs();
+  setup_0d_models();
+
+  // the leaves might have changed between the vertex work lists
+  d_task_graph.reset();
+}
+
+void RightHandSideEvaluator::update_outflow_pressures() {
+  for (auto &model : d_windkessel_models)
+    model.p_v = d_graph->vertex(model.vertex_id).get_peripheral_vessel_data().p_out;
+  for (const auto &outflow : d_vessel_tree_outflows)
+    d_vessel_tree_compartments.p[outflow.first_slot + outflow.num_compartments] = d_graph->vertex(outflow.vertex_id).get_vessel_tree_data().p_out;
+  for (auto &model : d_rcl_models)
+    model.p_out = d_graph->vertex(model.vertex_id).get_rcl_data().p_out;
+}
+
+void RightHandSideEvaluator::setup_caches() {
+  setup_fe_cache();
+  setup_edge_coefficients();
+  setup_edge_chunks();
+  setup_0d_models();
+
+  // the vertex work lists and the neighbors of the upwinding might have changed
+  d_task_graph.reset();
 }
 
-void RightHandSideEvaluator::evaluate(const double t, const std::vector<double> &u_prev, std::vector<double> &rhs) {
-  d_flow_upwind_evaluator.init(t, u_prev);
-  calculate_rhs(t, u_prev, rhs);
-  // std::cout << "rhs " << rhs << std::endl;
-  apply_inverse_mass(rhs);
-  if (std::isnan(rhs.front()) || std::isnan(rhs.back())) {
-    throw std::runtime_error("contains nans");
+void RightHandSideEvaluator::VesselTreeCompartments::resize(std::size_t num_slots) {
+  for (auto *values : {&p, &Q_in, &inv_C, &G_prev, &G_next, &f, &lower, &diag, &upper})
+    values->resize(num_slots, 0.);
+}
+
+void RightHandSideEvaluator::setup_0d_models() {
+  d_windkessel_models.clear();
+  d_vessel_tree_outflows.clear();
+  d_vessel_tree_compartments = {};
+  d_rcl_models.clear();
+  d_zero_0d_dofs.clear();
+  d_exponential_propagators.clear();
+
+  for (const auto &v_id : d_graph->get_active_vertex_ids(mpi::rank(d_comm))) {
+    const auto &vertex = d_graph->vertex(v_id);
+    if (!vertex.is_leaf())
+      continue;
+
+    const auto &edge = d_graph->edge(vertex.get_edge_neighbors()[0]);
+    const auto vertex_dof_map = d_dof_map->get_local_dof_map(vertex);
+
+    // the 0D models are integrated together with their edge
+    if (!is_edge_active(edge.get_id())) {
+      // we have to zero the dofs of the inactive models, since rhs is not zeroed in advance
+      for (std::size_t k = 0; k < vertex_dof_map.num_local_dof(); k += 1)
+        d_zero_0d_dofs.push_back(vertex_dof_map.dof_index(k));
+      continue;
+    }
+
+    const double sgn = edge.is_pointing_to(v_id) ? +1 : -1;
+
+    if (vertex.is_windkessel_outflow()) {
+      assert(edge.has_physical_data());
+      const auto &data = vertex.get_peripheral_vessel_data();
+      const double R1 = edge_coefficients(edge.get_id()).R1;
+      d_windkessel_models.push_back({v_id, edge.get_id(), sgn, vertex_dof_map.first_dof(), R1, data.resistance - R1, data.p_out, data.compliance});
+    } else if (vertex.is_vessel_tree_outflow()) {
+      assert(edge.has_physical_data());
+      const auto &vtd = vertex.get_vessel_tree_data();
+      assert(vertex_dof_map.num_local_dof() == vtd.capacitances.size());
+      assert(vertex_dof_map.num_local_dof() == vtd.resistances.size());
+
+      const auto &R = vtd.resistances;
+      const auto &C = vtd.capacitances;
+      const double n = static_cast<double>(vtd.furcation_number);
+      const std::size_t num_compartments = vertex_dof_map.num_local_dof();
+
+      // the chain is enclosed by a ghost slot in front and one behind, which holds the outflow pressure
+      auto &block = d_vessel_tree_compartments;
+      const std::size_t first_slot = block.p.size() + 1;
+      block.resize(first_slot + num_compartments + 1);
+      block.p[first_slot + num_compartments] = vtd.p_out;
+
+      for (std::size_t k = 0; k < num_compartments; k += 1) {
+        const std::size_t slot = first_slot + k;
+        block.inv_C[slot] = 1. / C[k];
+        block.G_prev[slot] = k > 0 ? 1. / (n * R[k - 1]) : 0.;
+        block.G_next[slot] = 1. / R[k];
+
+        // the jacobian of the linear chain of compartments
+        block.lower[slot] = block.G_prev[slot] * block.inv_C[slot];
+        block.diag[slot] = -(block.G_prev[slot] + block.G_next[slot]) * block.inv_C[slot];
+        if (k < num_compartments - 1)
+          block.upper[slot] = block.G_next[slot] * block.inv_C[slot];
+      }
+      // the outflow from the vessel decreases with the pressure of the first compartment
+      block.diag[first_slot] -= dQ_out_dp_c(edge_coefficients(edge.get_id()).R1) * block.inv_C[first_slot];
+
+      d_vessel_tree_outflows.push_back({v_id, edge.get_id(), sgn, vertex_dof_map.first_dof(), first_slot, num_compartments});
+    } else if (vertex.is_rcl_outflow()) {
+      assert(edge.has_physical_data());
+      const auto &data = vertex.get_rcl_data();
+      const std::size_t num_compartments = data.resistances.size();
+      assert(vertex_dof_map.num_local_dof() == 2 * num_compartments);
+      assert(data.capacitances.size() == num_compartments);
+      assert(data.inductances.size() == num_compartments);
+
+      RCLChainModel model{v_id, edge.get_id(), sgn, vertex_dof_map.first_dof(), num_compartments, data.p_out, data.resistances, {}, {}, {}, {}, {}};
+      for (std::size_t k = 0; k < num_compartments; k += 1) {
+        model.inv_C.push_back(1. / data.capacitances[k]);
+        model.inv_L.push_back(1. / data.inductances[k]);
+      }
+
+      // the jacobian of the chain, whose pressure and flow rows only couple to their neighbors in the interleaved order
+      model.lower.assign(2 * num_compartments, 0);
+      model.diag.assign(2 * num_compartments, 0);
+      model.upper.assign(2 * num_compartments, 0);
+      for (std::size_t k = 0; k < num_compartments; k += 1) {
+        // pressure row: C_k dp_k/dt = q_{k-1} - q_k
+        if (k > 0)
+          model.lower[2 * k] = model.inv_C[k];
+        model.upper[2 * k] = -model.inv_C[k];
+        // flow row: L_k dq_k/dt = p_k - p_{k+1} - R_k q_k
+        model.lower[2 * k + 1] = model.inv_L[k];
+        model.diag[2 * k + 1] = -model.R[k] * model.inv_L[k];
+        if (k < num_compartments - 1)
+          model.upper[2 * k + 1] = -model.inv_L[k];
+      }
+      // the outflow from the vessel decreases with the pressure of the first compartment
+      model.diag[0] = -dQ_out_dp_c(edge_coefficients(edge.get_id()).R1) * model.inv_C[0];
+
+      d_rcl_models.push_back(std::move(model));
+    }
   }
 }
 
-void RightHandSideEvaluator::set_rhs_S(VectorEvaluator S_evaluator) {
-  d_S_evaluator = std::move(S_evaluator);
+void RightHandSideEvaluator::set_cost_measurement(std::shared_ptr<CostMeasurement> measurement) {
+  d_cost_measurement = std::move(measurement);
+  d_flow_upwind_evaluator->set_cost_measurement(d_cost_measurement);
 }
 
-void RightHandSideEvaluator::calculate_rhs(const double t, const std::vector<double> &u_prev, std::vector<double> &rhs) {
-  // first zero rhs
-  for (std::size_t idx = 0; idx < rhs.size(); idx += 1)
-    rhs[idx] = 0;
+void RightHandSideEvaluator::setup_edge_chunks() {
+  std::vector<std::size_t> edge_ids;
+  for (const auto &data : d_edge_fe_data)
+    edge_ids.push_back(data.edge_id);
+  d_edge_chunk_offsets = partition_edges_among_threads(*d_graph, *d_dof_map, edge_ids, d_thread_pool ? d_thread_pool->num_threads() : 1);
+  setup_edge_batches();
+}
+
+void RightHandSideEvaluator::set_edge_batching(std::size_t max_micro_edges) {
+  d_max_batched_micro_edges = max_micro_edges;
+  setup_edge_batches();
+}
+
+void RightHandSideEvaluator::setup_edge_batches() {
+  d_edge_batches.clear();
+  d_edge_batch_start.assign(d_edge_fe_data.size(), std::numeric_limits<std::size_t>::max());
+  if (d_max_batched_micro_edges == 0)
+    return;
+
+  const auto is_short = [this](std::size_t k) { return d_edge_fe_data[k].local_dof_map->num_micro_edges() <= d_max_batched_micro_edges; };
+  const auto degree = [this](std::size_t k) { return d_edge_fe_data[k].fe->get_degree(); };
+
+  // the batches stay inside the chunks, such that every thread still writes only its own dofs
+  for (std::size_t chunk = 0; chunk + 1 < d_edge_chunk_offsets.size(); chunk += 1) {
+    const std::size_t end = d_edge_chunk_offsets[chunk + 1];
+    for (std::size_t first = d_edge_chunk_offsets[chunk]; first < end;) {
+      std::size_t last = first;
+      while (last < end && is_short(last) && degree(last) == degree(first))
+        last += 1;
+
+      // a single short edge gains nothing from a batch
+      if (last - first < 2) {
+        first = std::max(last, first + 1);
+        continue;
+      }
+
+      // the shape functions on a micro edge of length 1 are scaled to the length of every micro edge
+      const auto key = std::make_pair(degree(first), 1.);
+      auto it = d_fe_cache.find(key);
+      if (it == d_fe_cache.end()) {
+        it = d_fe_cache.emplace(key, FETypeNetwork(create_quadrature_for_degree(d_quadrature_type, key.first), key.first, d_quadrature_type == QuadratureType::gauss_lobatto)).first;
+        it->second.reinit(1.);
+      }
 
-  std::vector<double> Q_up_macro_edge(0, 0);
-  std::vector<double> A_up_macro_edge(0, 0);
+      EdgeBatch batch{first, last, &it->second, 0, {}, {}, {}};
+      for (std::size_t k = first; k < last; k += 1) {
+        const auto &edge = d_graph->edge(d_edge_fe_data[k].edge_id);
+        const std::size_t num_micro_edges = d_edge_fe_data[k].local_dof_map->num_micro_edges();
+        const double h = edge.get_physical_data().length / num_micro_edges;
+        const auto lengths = edge.has_micro_edge_lengths() ? edge.get_micro_edge_lengths() : std::vector<double>(num_micro_edges, h);
+        const auto &coefficients = edge_coefficients(edge.get_id());
+        batch.micro_edge_scales.insert(batch.micro_edge_scales.end(), lengths.begin(), lengths.end());
+        batch.F_Q_factor.insert(batch.F_Q_factor.end(), num_micro_edges, coefficients.F_Q_factor);
+        batch.friction.insert(batch.friction.end(), num_micro_edges, coefficients.friction);
+        batch.num_micro_edges += num_micro_edges;
+      }
+
+      d_edge_batch_start[first] = d_edge_batches.size();
+      d_edge_batches.push_back(std::move(batch));
+      first = last;
+    }
+  }
+}
+
+std::vector<std::size_t> RightHandSideEvaluator::get_dof_chunk_offsets() const {
+  std::vector<std::size_t> edge_ids;
+  for (const auto &data : d_edge_fe_data)
+    edge_ids.push_back(data.edge_id);
+  return macrocirculation::get_dof_chunk_offsets(*d_graph, *d_dof_map, edge_ids, d_edge_chunk_offsets);
+}
+
+void RightHandSideEvaluator::setup_edge_coefficients() {
+  // the kernels and 0D models only need the coefficients of our edges, which share the numbering of the upwind fluxes
+  const auto &local_edges = d_flow_upwind_evaluator->get_boundary_evaluator().get_local_edge_index();
+  d_edge_coefficients.assign(local_edges.num_slots(), EdgeCoefficients{NAN, NAN, NAN});
+  d_edge_coefficients.shrink_to_fit();
+
+  for (const auto &e_id : d_graph->get_edge_ids()) {
+    const auto *edge = &d_graph->edge(e_id);
+    if (!local_edges.is_local(e_id) || !edge->has_physical_data())
+      continue;
+    const auto &param = edge->get_physical_data();
+    auto &coefficients = d_edge_coefficients[local_edges(e_id)];
+    coefficients.F_Q_factor = param.G0 / (3 * param.rho * std::sqrt(param.A0));
+    coefficients.R1 = param.rho * param.get_c0() / param.A0;
+    coefficients.friction = -2 * param.viscosity * M_PI * (param.gamma + 2);
+  }
+}
+
+MemoryReport RightHandSideEvaluator::memory_report() const {
+  MemoryReport report;
+  report.add("upwinding", d_flow_upwind_evaluator->memory_report());
+  std::size_t fe_bytes = d_edge_fe_data.capacity() * sizeof(EdgeFEData) + d_fe_cache.size() * sizeof(FETypeNetwork);
+  for (const auto &data : d_edge_fe_data)
+    fe_bytes += (data.points.capacity() + data.micro_edge_scales.capacity()) * sizeof(double);
+  report.add("edge fe data", fe_bytes);
+  std::size_t batch_bytes = d_edge_batches.capacity() * sizeof(EdgeBatch) + d_edge_batch_start.capacity() * sizeof(std::size_t);
+  for (const auto &batch : d_edge_batches)
+    batch_bytes += (batch.micro_edge_scales.capacity() + batch.F_Q_factor.capacity() + batch.friction.capacity()) * sizeof(double);
+  report.add("edge batches", batch_bytes);
+  report.add("edge coefficients", d_edge_coefficients);
+  std::size_t models_bytes = d_windkessel_models.capacity() * sizeof(WindkesselModel) + d_vessel_tree_outflows.capacity() * sizeof(VesselTreeOutflow);
+  const auto &block = d_vessel_tree_compartments;
+  for (const auto *v : {&block.p, &block.Q_in, &block.inv_C, &block.G_prev, &block.G_next, &block.f, &block.lower, &block.diag, &block.upper})
+    models_bytes += v->capacity() * sizeof(double);
+  models_bytes += d_rcl_models.capacity() * sizeof(RCLChainModel);
+  for (const auto &model : d_rcl_models)
+    for (const auto *v : {&model.R, &model.inv_C, &model.inv_L, &model.lower, &model.diag, &model.upper})
+      models_bytes += v->capacity() * sizeof(double);
+  models_bytes += d_zero_0d_dofs.capacity() * sizeof(std::size_t) + (d_vessel_tree_scratch.capacity() + d_rcl_f.capacity()) * sizeof(double);
+  report.add("0d models", models_bytes);
+  std::size_t propagator_bytes = d_exponential_propagators.capacity() * sizeof(ExponentialPropagators);
+  for (const auto &p : d_exponential_propagators)
+    propagator_bytes += (p.windkessel.capacity() + p.vessel_trees.capacity() + p.rcl.capacity()) * sizeof(double);
+  report.add("0d propagators", propagator_bytes);
+  std::size_t work_bytes = d_edge_work.capacity() * sizeof(EdgeWorkData);
+  for (const auto &w : d_edge_work)
+    for (const auto *v : {&w.Q_up, &w.A_up, &w.Q_loc, &w.A_loc, &w.Q_qp, &w.A_qp, &w.F_Q, &w.S_Q, &w.S_A, &w.F_Q_up, &w.f_loc_Q, &w.f_loc_A, &w.Q_up_r, &w.F_Q_up_r})
+      work_bytes += v->capacity() * sizeof(double);
+  report.add("edge work data", work_bytes);
+  report.add("active edges", d_is_edge_active.capacity() / 8);
+  return report;
+}
+
+void RightHandSideEvaluator::set_thread_pool(std::shared_ptr<ThreadPool> pool) {
+  d_thread_pool = std::move(pool);
+  d_flow_upwind_evaluator->set_thread_pool(d_thread_pool);
+  d_edge_work.resize(d_thread_pool ? d_thread_pool->num_threads() : 1);
+  setup_edge_chunks();
+}
+
+void RightHandSideEvaluator::set_task_scheduling(bool enable) {
+  d_task_scheduling = enable;
+}
+
+void RightHandSideEvaluator::setup_fe_cache() {
+  d_fe_cache.clear();
+  d_edge_fe_data.clear();
 
-  // data structures for cell contributions
   for (const auto &e_id : d_graph->get_active_edge_ids(mpi::rank(d_comm))) {
-    const auto edge = d_graph->get_edge(e_id);
+    const auto *edge = &d_graph->edge(e_id);
     const auto local_dof_map = d_dof_map->get_local_dof_map(*edge);
 
-    // calculate fluxes on macro edge
-    Q_up_macro_edge.resize(local_dof_map.num_micro_vertices());
-    A_up_macro_edge.resize(local_dof_map.num_micro_vertices());
-    d_flow_upwind_evaluator.get_fluxes_on_macro_edge(t, *edge, u_prev, Q_up_macro_edge, A_up_macro_edge);
-
-    const std::size_t num_basis_functions = local_dof_map.num_basis_functions();
+    const std::size_t degree = local_dof_map.num_basis_functions() - 1;
+    const QuadratureFormula qf = create_quadrature_for_degree(d_quadrature_type, degree);
+    const double h = edge->get_physical_data().length / local_dof_map.num_micro_edges();
 
-    std::vector<double> f_loc_Q(num_basis_functions);
-    std::vector<double> f_loc_A(num_basis_functions);
+    // edges with the same micro edge length share their shape functions
+    const auto key = std::make_pair(degree, h);
+    auto it = d_fe_cache.find(key);
+    if (it == d_fe_cache.end()) {
+      it = d_fe_cache.emplace(key, FETypeNetwork(qf, degree, d_quadrature_type == QuadratureType::gauss_lobatto)).first;
+      it->second.reinit(h);
+    }
 
-    QuadratureFormula qf = create_gauss4();
-    FETypeNetwork fe(qf, local_dof_map.num_basis_functions() - 1);
+    const std::size_t num_micro_edges = local_dof_map.num_micro_edges();
 
-    const auto &phi = fe.get_phi();
-    const auto &phi_b = fe.get_phi_boundary();
-    const auto &dphi = fe.get_dphi();
-    const auto &JxW = fe.get_JxW();
+    EdgeFEData data{e_id, &it->second, &d_dof_map->get_local_dof_map(*edge), std::vector<double>(qf.size() * num_micro_edges, 0), {}};
 
-    // some right hand sides need the physical location of the quadrature points
     QuadraturePointMapper qpm(qf);
-    const auto &points = qpm.get_quadrature_points();
+    if (!edge->has_micro_edge_lengths()) {
+      for (std::size_t micro_edge_id = 0; micro_edge_id < num_micro_edges; micro_edge_id += 1) {
+        qpm.reinit(micro_edge_id * h, static_cast<double>(1 + micro_edge_id) * h);
+        for (std::size_t qp = 0; qp < qf.size(); qp += 1)
+          data.points[qp * num_micro_edges + micro_edge_id] = qpm.get_quadrature_points()[qp];
+      }
+    } else {
+      // the shape functions are initialized for the mean length h, and the kernel scales the integrals of the cells
+      const auto lengths = edge->get_micro_edge_lengths();
+      data.micro_edge_scales.resize(num_micro_edges);
+      double s_left = 0;
+      for (std::size_t micro_edge_id = 0; micro_edge_id < num_micro_edges; micro_edge_id += 1) {
+        qpm.reinit(s_left, s_left + lengths[micro_edge_id]);
+        for (std::size_t qp = 0; qp < qf.size(); qp += 1)
+          data.points[qp * num_micro_edges + micro_edge_id] = qpm.get_quadrature_points()[qp];
+        data.micro_edge_scales[micro_edge_id] = lengths[micro_edge_id] / h;
+        s_left += lengths[micro_edge_id];
+      }
+    }
 
-    std::vector<std::size_t> Q_dof_indices(num_basis_functions, 0);
-    std::vector<std::size_t> A_dof_indices(num_basis_functions, 0);
+    d_edge_fe_data.push_back(std::move(data));
+  }
+}
 
-    std::vector<double> Q_prev_loc(num_basis_functions, 0);
-    std::vector<double> A_prev_loc(num_basis_functions, 0);
+void RightHandSideEvaluator::evaluate(const double t, const std::vector<double> &u_prev, std::vector<double> &rhs, const double tau_euler) {
+  calculate_rhs(t, u_prev, rhs, tau_euler);
+}
 
-    std::vector<double> Q_prev_qp(fe.num_quad_points(), 0);
-    std::vector<double> A_prev_qp(fe.num_quad_points(), 0);
+void RightHandSideEvaluator::set_coupled_assembly(std::shared_ptr<CoupledEdgeAssembly> assembly, const std::vector<EdgeBoundaryField> &boundary_fields) {
+  if (assembly == nullptr && !boundary_fields.empty())
+    throw std::runtime_error("the boundary fields belong to a coupled assembly");
+  d_flow_upwind_evaluator->set_additional_fields(boundary_fields);
+  d_coupled_assembly = std::move(assembly);
+  d_coupled_u = nullptr;
 
-    const auto &F_A = Q_prev_qp;
-    std::vector<double> F_Q(Q_prev_qp.size(), 0);
+  // the messages of the neighbors carry more values
+  d_task_graph.reset();
+}
 
-    std::vector<double> S_Q(fe.num_quad_points(), 0);
-    std::vector<double> S_A(fe.num_quad_points(), 0);
+void RightHandSideEvaluator::set_implicit_0d_models(bool implicit) {
+  d_0d_treatment = implicit ? ZeroDTreatment::implicit_euler : ZeroDTreatment::explicit_stages;
+}
 
-    const auto &param = edge->get_physical_data();
+void RightHandSideEvaluator::set_exponential_0d_models(bool exponential) {
+  d_0d_treatment = exponential ? ZeroDTreatment::exponential_euler : ZeroDTreatment::explicit_stages;
+}
+
+const RightHandSideEvaluator::ExponentialPropagators &RightHandSideEvaluator::get_exponential_propagators(const double tau) {
+  for (const auto &propagators : d_exponential_propagators)
+    if (propagators.tau == tau)
+      return propagators;
+
+  // changing step lengths, e.g. from a cfl condition, would otherwise let the cache grow without bound
+  if (d_exponential_propagators.size() >= max_cached_step_lengths)
+    d_exponential_propagators.erase(d_exponential_propagators.begin());
 
-    const double h = param.length / local_dof_map.num_micro_edges();
+  ExponentialPropagators propagators{tau, {}, {}, {}};
 
-    for (std::size_t micro_edge_id = 0; micro_edge_id < local_dof_map.num_micro_edges(); micro_edge_id += 1) {
-      fe.reinit(h);
-      qpm.reinit(micro_edge_id * h, static_cast<double>(1 + micro_edge_id) * h);
+  for (const auto &model : d_windkessel_models) {
+    const double z = -tau / model.C * (dQ_out_dp_c(model.R1) + 1. / model.R2);
+    propagators.windkessel.push_back(z != 0 ? std::expm1(z) / z : 1.);
+  }
 
-      // evaluate Q and A inside cell
-      local_dof_map.dof_indices(micro_edge_id, 0, Q_dof_indices);
-      local_dof_map.dof_indices(micro_edge_id, 1, A_dof_indices);
+  const auto &block = d_vessel_tree_compartments;
+  for (const auto &outflow : d_vessel_tree_outflows) {
+    const std::size_t n = outflow.num_compartments;
+    const std::size_t slot = outflow.first_slot;
+    const std::size_t offset = propagators.vessel_trees.size();
+    propagators.vessel_trees.resize(offset + n * n);
+    calculate_phi_1_tridiagonal(tau, n, &block.lower[slot], &block.diag[slot], &block.upper[slot], &propagators.vessel_trees[offset]);
+  }
 
-      extract_dof(Q_dof_indices, u_prev, Q_prev_loc);
-      extract_dof(A_dof_indices, u_prev, A_prev_loc);
+  for (const auto &model : d_rcl_models) {
+    const std::size_t n = 2 * model.num_compartments;
+    const std::size_t offset = propagators.rcl.size();
+    propagators.rcl.resize(offset + n * n);
+    calculate_phi_1_tridiagonal(tau, n, model.lower.data(), model.diag.data(), model.upper.data(), &propagators.rcl[offset]);
+  }
 
-      fe.evaluate_dof_at_quadrature_points(Q_prev_loc, Q_prev_qp);
-      fe.evaluate_dof_at_quadrature_points(A_prev_loc, A_prev_qp);
+  d_exponential_propagators.push_back(std::move(propagators));
+  return d_exponential_propagators.back();
+}
 
-      // evaluate Q and A on boundary
-      const double Q_up_0 = Q_up_macro_edge[micro_edge_id];
-      const double Q_up_1 = Q_up_macro_edge[micro_edge_id + 1];
-      const double A_up_0 = A_up_macro_edge[micro_edge_id];
-      const double A_up_1 = A_up_macro_edge[micro_edge_id + 1];
+void RightHandSideEvaluator::set_active_edges(std::vector<bool> is_edge_active) {
+  if (!is_edge_active.empty() && is_edge_active.size() != d_graph->num_edges())
+    throw std::runtime_error("the active edge vector has to contain an entry for every edge");
+  d_is_edge_active = std::move(is_edge_active);
+  setup_0d_models();
+}
+
+void RightHandSideEvaluator::set_rhs_S(VectorEvaluator S_evaluator) {
+  d_S_evaluator = std::move(S_evaluator);
+  d_S_type = SourceType::vector;
+  select_edge_kernel();
+}
 
-      // the A-component of our F function
-      const auto F_Q_eval = [&param](double Q, double A) -> double {
-        return std::pow(Q, 2) / A + param.G0 / (3 * param.rho * std::sqrt(param.A0)) * std::pow(A, 3. / 2.);
-      };
+void RightHandSideEvaluator::set_rhs_S(const default_S &S) {
+  d_default_S_phi = S.get_phi();
+  d_S_type = SourceType::default_S;
+  select_edge_kernel();
+}
 
-      // evaluate F = (F_Q, F_A) at the quadrature points
-      for (std::size_t qp = 0; qp < fe.num_quad_points(); qp += 1)
-        F_Q[qp] = F_Q_eval(Q_prev_qp[qp], A_prev_qp[qp]);
+void RightHandSideEvaluator::set_rhs_S_batch(BatchEvaluator S_evaluator) {
+  d_S_batch_evaluator = std::move(S_evaluator);
+  d_S_type = SourceType::batch;
+  select_edge_kernel();
+}
 
-      // evaluate S = (S_Q, S_A) at the quadrature points
-      d_S_evaluator(t, *edge, points, Q_prev_qp, A_prev_qp, S_Q, S_A);
+void RightHandSideEvaluator::add_macro_edge_boundary_fluxes(const double t, std::vector<double> &rhs) const {
+  SCOPED_PHASE_TIMER("macro edge fluxes");
+  parallel_for(d_thread_pool.get(), d_edge_chunk_offsets, [&](std::size_t, std::size_t begin, std::size_t end) {
+    for (std::size_t k = begin; k < end; k += 1) {
+      const auto &fe_data = d_edge_fe_data[k];
+      if (!is_edge_active(fe_data.edge_id))
+        continue;
+
+      double Q_l, A_l, Q_r, A_r;
+      d_flow_upwind_evaluator->get_fluxes_at_macro_edge_boundaries(t, fe_data.edge_id, Q_l, A_l, Q_r, A_r);
+      add_macro_edge_boundary_fluxes_on_edge(fe_data, Q_l, A_l, Q_r, A_r, rhs);
+    }
+  });
+}
 
-      for (std::size_t i = 0; i < num_basis_functions; i += 1) {
-        // rhs integral
-        f_loc_A[i] = 0;
-        f_loc_Q[i] = 0;
+void RightHandSideEvaluator::add_macro_edge_boundary_fluxes_on_edge(const EdgeFEData &fe_data, double Q_l, double A_l, double Q_r, double A_r, std::vector<double> &rhs) const {
+  const auto &local_dof_map = *fe_data.local_dof_map;
+  const auto &phi_b = fe_data.fe->get_mass_scaled_phi_boundary();
+  const double F_Q_factor = edge_coefficients(fe_data.edge_id).F_Q_factor;
+
+  // the tables contain the inverse mass of a micro edge of the length of fe
+  const std::size_t last_micro_edge = local_dof_map.num_micro_edges() - 1;
+  const double scale_l = fe_data.micro_edge_scales.empty() ? 1. : 1. / fe_data.micro_edge_scales[0];
+  const double scale_r = fe_data.micro_edge_scales.empty() ? 1. : 1. / fe_data.micro_edge_scales[last_micro_edge];
+
+  const double F_Q_l = Q_l * Q_l / A_l + F_Q_factor * A_l * std::sqrt(A_l);
+  const double F_Q_r = Q_r * Q_r / A_r + F_Q_factor * A_r * std::sqrt(A_r);
+
+  // boundary contributions - [ F(U_up) phi ] of the first and the last micro edge
+  const std::size_t Q_first_l = local_dof_map.first_dof(0, 0);
+  const std::size_t A_first_l = local_dof_map.first_dof(0, 1);
+  const std::size_t Q_first_r = local_dof_map.first_dof(last_micro_edge, 0);
+  const std::size_t A_first_r = local_dof_map.first_dof(last_micro_edge, 1);
+  for (std::size_t i = 0; i < local_dof_map.num_basis_functions(); i += 1) {
+    rhs[Q_first_l + i] += scale_l * F_Q_l * phi_b[0][i];
+    rhs[A_first_l + i] += scale_l * Q_l * phi_b[0][i];
+    rhs[Q_first_r + i] -= scale_r * F_Q_r * phi_b[1][i];
+    rhs[A_first_r + i] -= scale_r * Q_r * phi_b[1][i];
+  }
+}
 
-        // cell contributions
-        for (std::size_t qp = 0; qp < fe.num_quad_points(); qp += 1) {
-          f_loc_Q[i] += phi[i][qp] * S_Q[qp] * JxW[qp];
-          f_loc_Q[i] += dphi[i][qp] * F_Q[qp] * JxW[qp];
+void RightHandSideEvaluator::assemble_edge(std::size_t k, std::size_t thread_id, double t, const std::vector<double> &u_prev, std::vector<double> &rhs) {
+  if (is_edge_active(d_edge_fe_data[k].edge_id)) {
+    ScopedCostTimer timer(d_cost_measurement.get(), ScopedCostTimer::Kind::edge, d_edge_fe_data[k].edge_id);
+    const auto &fe_data = d_edge_fe_data[k];
+    auto &work = d_edge_work[thread_id];
+    (this->*d_edge_kernels[fe_data.fe->get_degree()])(t, fe_data, u_prev, rhs, work);
+    // the kernel leaves the flow at the quadrature points and the inner fluxes of the edge in the work data of our thread
+    if (d_assemble_coupled)
+      d_coupled_assembly->assemble_edge(t, {fe_data.edge_id, *fe_data.fe, fe_data.local_dof_map->num_micro_edges(), work.Q_qp.data(), work.A_qp.data(), work.Q_up.data(), work.A_up.data()}, u_prev, thread_id);
+  } else {
+    const auto &local_dof_map = *d_edge_fe_data[k].local_dof_map;
+    const auto first = rhs.begin() + static_cast<std::ptrdiff_t>(local_dof_map.first_dof(0, 0));
+    std::fill(first, first + static_cast<std::ptrdiff_t>(local_dof_map.num_local_dof()), 0.);
+  }
+}
 
-          f_loc_A[i] += phi[i][qp] * S_A[qp] * JxW[qp];
-          f_loc_A[i] += dphi[i][qp] * F_A[qp] * JxW[qp];
-        }
+void RightHandSideEvaluator::assemble_edges(std::size_t begin, std::size_t end, std::size_t thread_id, double t, const std::vector<double> &u_prev, std::vector<double> &rhs) {
+  // the batches only replace the kernels of single edges, if nothing needs the edges one by one
+  const bool use_batches = !d_edge_batches.empty() && d_S_type == SourceType::default_S && d_is_edge_active.empty() && d_cost_measurement == nullptr && !d_assemble_coupled;
+  for (std::size_t k = begin; k < end;) {
+    const std::size_t batch_id = use_batches ? d_edge_batch_start[k] : std::numeric_limits<std::size_t>::max();
+    if (batch_id == std::numeric_limits<std::size_t>::max()) {
+      assemble_edge(k, thread_id, t, u_prev, rhs);
+      k += 1;
+      continue;
+    }
+    const auto &batch = d_edge_batches[batch_id];
+    (this->*d_batch_kernels[batch.fe->get_degree()])(t, batch, u_prev, rhs, d_edge_work[thread_id]);
+    k = batch.last;
+  }
+}
 
-        // boundary contributions  - tau [ F(U_up) phi ] ds, keep attention to the minus!
-        f_loc_Q[i] -= F_Q_eval(Q_up_1, A_up_1) * phi_b[1][i];
-        f_loc_Q[i] += F_Q_eval(Q_up_0, A_up_0) * phi_b[0][i];
+void RightHandSideEvaluator::setup_task_graph() {
+  const auto &upwind = *d_flow_upwind_evaluator;
+  const auto &communicator = upwind.get_boundary_evaluator().get_communicator();
+  const std::size_t num_edges = d_edge_fe_data.size();
+  const std::size_t num_vertex_tasks = upwind.num_vertex_tasks();
+  const int rank = mpi::rank(d_comm);
+
+  d_task_graph = std::make_unique<TaskGraph>();
+  auto &tasks = *d_task_graph;
+  for (std::size_t k = 0; k < 2 * num_edges + num_vertex_tasks; k += 1)
+    tasks.add_task();
+
+  // the message of a neighbor contains the boundary values of all the ghost edges it owns
+  d_first_receive_task = tasks.num_tasks();
+  std::map<int, std::size_t> receive_task;
+  for (std::size_t k = 0; k < communicator.num_receive_neighbors(); k += 1)
+    receive_task[communicator.get_receive_neighbor_rank(k)] = tasks.add_external_task();
+  d_arrived_neighbors.reserve(communicator.num_receive_neighbors());
+
+  std::vector<std::size_t> edge_index(d_graph->num_edges(), std::numeric_limits<std::size_t>::max());
+  for (std::size_t k = 0; k < num_edges; k += 1) {
+    edge_index[d_edge_fe_data[k].edge_id] = k;
+    tasks.add_dependency(k, num_edges + num_vertex_tasks + k);
+  }
 
-        f_loc_A[i] -= Q_up_1 * phi_b[1][i];
-        f_loc_A[i] += Q_up_0 * phi_b[0][i];
-      }
+  for (std::size_t v = 0; v < num_vertex_tasks; v += 1) {
+    const auto &vertex = d_graph->vertex(upwind.get_vertex_task_vertex_id(v));
+    for (const auto e_id : vertex.get_edge_neighbors()) {
+      // the boundary values of a ghost edge have to be received, those of our own edges are evaluated before the tasks start
+      const int owner = d_graph->edge(e_id).rank();
+      if (owner != rank && receive_task.count(owner) > 0)
+        tasks.add_dependency(receive_task[owner], num_edges + v);
 
-      // copy into global vector
-      for (std::size_t i = 0; i < Q_dof_indices.size(); i += 1) {
-        rhs[Q_dof_indices[i]] += f_loc_Q[i];
-      }
-      for (std::size_t i = 0; i < A_dof_indices.size(); i += 1) {
-        rhs[A_dof_indices[i]] += f_loc_A[i];
-      }
+      if (edge_index[e_id] != std::numeric_limits<std::size_t>::max())
+        tasks.add_dependency(num_edges + v, num_edges + num_vertex_tasks + edge_index[e_id]);
     }
   }
+}
 
-  // add windkessel contributions
-  for (const auto &v_id : d_graph->get_active_vertex_ids(mpi::rank(d_comm))) {
-    const auto vertex = d_graph->get_vertex(v_id);
+void RightHandSideEvaluator::calculate_rhs_with_tasks(const double t, const std::vector<double> &u_prev, std::vector<double> &rhs) {
+  SCOPED_PHASE_TIMER("task graph");
+  if (!d_task_graph)
+    setup_task_graph();
+
+  auto &upwind = *d_flow_upwind_evaluator;
+  const std::size_t num_edges = d_edge_fe_data.size();
+  const std::size_t num_vertex_tasks = upwind.num_vertex_tasks();
+
+  const auto run_task = [&](std::size_t thread_id, std::size_t task) {
+    if (task < num_edges) {
+      assemble_edge(task, thread_id, t, u_prev, rhs);
+    } else if (task < num_edges + num_vertex_tasks) {
+      upwind.calculate_vertex_task(task - num_edges, thread_id, u_prev);
+    } else {
+      const auto &fe_data = d_edge_fe_data[task - num_edges - num_vertex_tasks];
+      if (!is_edge_active(fe_data.edge_id))
+        return;
+      double Q_l, A_l, Q_r, A_r;
+      upwind.get_vertex_task_fluxes(fe_data.edge_id, Q_l, A_l, Q_r, A_r);
+      add_macro_edge_boundary_fluxes_on_edge(fe_data, Q_l, A_l, Q_r, A_r, rhs);
+    }
+  };
 
-    Q_up_macro_edge.resize(1);
-    A_up_macro_edge.resize(1);
+  // the vertices at the ghost edges of a neighbor are released as soon as its message has arrived
+  const auto poll = [&](TaskGraph &tasks) {
+    d_arrived_neighbors.clear();
+    upwind.get_boundary_evaluator().progress_init(d_arrived_neighbors);
+    for (const auto k : d_arrived_neighbors)
+      tasks.complete(d_first_receive_task + k);
+  };
 
-    if (vertex->is_leaf() && vertex->is_windkessel_outflow()) {
-      const auto &edge = *d_graph->get_edge(vertex->get_edge_neighbors()[0]);
-      assert(edge.has_physical_data());
-      const auto &param = edge.get_physical_data();
+  d_task_graph->run(d_thread_pool.get(), run_task, poll);
+
+  upwind.finish_vertex_tasks(t, u_prev);
+}
+
+void RightHandSideEvaluator::calculate_rhs(const double t, const std::vector<double> &u_prev, std::vector<double> &rhs, const double tau_euler) {
+  SCOPED_PHASE_TIMER("rhs");
+  d_assemble_coupled = d_coupled_assembly != nullptr && d_coupled_u == &u_prev;
+  if (d_assemble_coupled) {
+    d_coupled_u = nullptr;
+    d_coupled_assembly->start(t, u_prev, d_edge_work.size());
+  }
+
+  // starts the exchange of the ghost layer, which we need only for the fluxes at the macro edge boundaries
+  if (d_coupled_assembly != nullptr)
+    d_flow_upwind_evaluator->start_init(t, u_prev, d_coupled_assembly->get_boundary_field_values());
+  else
+    d_flow_upwind_evaluator->start_init(t, u_prev);
+
+  if (d_task_scheduling) {
+    calculate_rhs_with_tasks(t, u_prev, rhs);
+  } else {
+    // cell and boundary contributions on the edges, which already include the inverse mass
+    // every dof belongs to exactly one edge, hence the edges can be split among the threads
+    // the edges are sub-partitioned among the threads by their number of micro edges
+    {
+      SCOPED_PHASE_TIMER("cell assembly");
+      parallel_for(d_thread_pool.get(), d_edge_chunk_offsets, [&](std::size_t thread_id, std::size_t begin, std::size_t end) {
+        assemble_edges(begin, end, thread_id, t, u_prev, rhs);
+      });
+    }
+
+    // the n-furcations need the ghost layer, hence we wait for it only after the cell contributions are assembled
+    d_flow_upwind_evaluator->finish_init(t, u_prev);
+    add_macro_edge_boundary_fluxes(t, rhs);
+  }
+
+  if (d_assemble_coupled) {
+    SCOPED_PHASE_TIMER("coupled boundaries");
+    d_coupled_assembly->finish(t, u_prev, *d_flow_upwind_evaluator);
+    d_assemble_coupled = false;
+  }
+
+  SCOPED_PHASE_TIMER("0d models");
 
-      const bool is_pointing_to = edge.is_pointing_to(vertex->get_id());
+  for (auto i : d_zero_0d_dofs)
+    rhs[i] = 0;
 
-      const auto &vertex_dof_map = d_dof_map->get_local_dof_map(*vertex);
-      const auto &vertex_dofs = vertex_dof_map.dof_indices();
+  const double tau_implicit = d_0d_treatment == ZeroDTreatment::implicit_euler ? tau_euler : 0.;
+  const bool exponential = d_0d_treatment == ZeroDTreatment::exponential_euler && tau_euler > 0;
+  const ExponentialPropagators *propagators = exponential ? &get_exponential_propagators(tau_euler) : nullptr;
 
-      d_flow_upwind_evaluator.get_fluxes_on_nfurcation(t, *vertex, Q_up_macro_edge, A_up_macro_edge);
-      auto Q_out = Q_up_macro_edge.front();
+  // the upwinded flow at the boundary of the edge of a 0D model
+  const auto get_Q_out = [this, t](std::size_t edge_id, double sgn) {
+    double Q_l, A_l, Q_r, A_r;
+    d_flow_upwind_evaluator->get_fluxes_at_macro_edge_boundaries(t, edge_id, Q_l, A_l, Q_r, A_r);
+    return sgn > 0 ? Q_r : Q_l;
+  };
 
-      const double sgn = is_pointing_to ? +1 : -1;
+  // add windkessel contributions
+  for (std::size_t m = 0; m < d_windkessel_models.size(); m += 1) {
+    const auto &model = d_windkessel_models[m];
+    ScopedCostTimer timer(d_cost_measurement.get(), ScopedCostTimer::Kind::vertex, model.vertex_id);
+
+    const double Q_out = get_Q_out(model.edge_id, model.sgn);
+    const double p_c = u_prev[model.p_c_dof];
 
-      const auto p_c = u_prev[vertex_dofs[0]];
+    rhs[model.p_c_dof] = windkessel_pressure_rhs(model.sgn * Q_out, p_c, model.p_v, model.R2, model.C);
 
-      // TODO: Move this calculation to the vertex.
-      const double R1 = param.rho * param.get_c0() / param.A0;
-      const double R2 = vertex->get_peripheral_vessel_data().resistance - R1;
+    // implicit euler step for the linearized model
+    if (tau_implicit > 0)
+      rhs[model.p_c_dof] /= 1. + tau_implicit / model.C * (dQ_out_dp_c(model.R1) + 1. / model.R2);
+
+    // exact step for the linearized model
+    if (exponential)
+      rhs[model.p_c_dof] *= propagators->windkessel[m];
+  }
 
-      // pressure in the veins:
-      const double p_v = vertex->get_peripheral_vessel_data().p_out;
+  // gather the inflows and pressures of all the vessel trees into the compartment block
+  auto &block = d_vessel_tree_compartments;
+  for (const auto &outflow : d_vessel_tree_outflows) {
+    ScopedCostTimer timer(d_cost_measurement.get(), ScopedCostTimer::Kind::vertex, outflow.vertex_id);
+    block.Q_in[outflow.first_slot] = outflow.sgn * get_Q_out(outflow.edge_id, outflow.sgn);
+    std::copy_n(u_prev.begin() + static_cast<std::ptrdiff_t>(outflow.first_dof), outflow.num_compartments, block.p.begin() + static_cast<std::ptrdiff_t>(outflow.first_slot));
+  }
+
+  // a single loop without branches over the compartments of all the vessel trees, the first and last slot are always ghosts
+  {
+    const std::size_t num_slots = block.p.size();
+    const double *p = block.p.data();
+    const double *Q_in = block.Q_in.data();
+    const double *inv_C = block.inv_C.data();
+    const double *G_prev = block.G_prev.data();
+    const double *G_next = block.G_next.data();
+    double *f = block.f.data();
+    for (std::size_t k = 1; k + 1 < num_slots; k += 1)
+      f[k] = inv_C[k] * (Q_in[k] + G_prev[k] * (p[k - 1] - p[k]) - G_next[k] * (p[k] - p[k + 1]));
+  }
 
-      rhs[vertex_dofs[0]] = 1. / vertex->get_peripheral_vessel_data().compliance * (sgn * Q_out - (p_c - p_v) / R2);
+  // implicit or exponential euler step for the linear chains of compartments and scatter into the right-hand side
+  std::size_t propagator_offset = 0;
+  for (const auto &outflow : d_vessel_tree_outflows) {
+    const std::size_t slot = outflow.first_slot;
+    if (tau_implicit > 0)
+      solve_implicit_euler_tridiagonal(tau_implicit, outflow.num_compartments, &block.lower[slot], &block.diag[slot], &block.upper[slot], &block.f[slot], d_vessel_tree_scratch);
+    if (exponential) {
+      multiply_dense(outflow.num_compartments, &propagators->vessel_trees[propagator_offset], &block.f[slot], d_vessel_tree_scratch);
+      propagator_offset += outflow.num_compartments * outflow.num_compartments;
     }
-    // TODO: merge code with windkessel
-    else if (vertex->is_leaf() && vertex->is_vessel_tree_outflow()) {
-      const auto &edge = *d_graph->get_edge(vertex->get_edge_neighbors()[0]);
-      assert(edge.has_physical_data());
+    std::copy_n(block.f.begin() + static_cast<std::ptrdiff_t>(slot), outflow.num_compartments, rhs.begin() + static_cast<std::ptrdiff_t>(outflow.first_dof));
+  }
 
-      const bool is_pointing_to = edge.is_pointing_to(vertex->get_id());
+  propagator_offset = 0;
+  for (const auto &model : d_rcl_models) {
+    ScopedCostTimer timer(d_cost_measurement.get(), ScopedCostTimer::Kind::vertex, model.vertex_id);
+
+    const std::size_t N = model.num_compartments;
+    const double *p = &u_prev[model.first_dof];
+    const double *q = p + N;
+    double *f_p = &rhs[model.first_dof];
+    double *f_q = f_p + N;
+
+    const double Q_in = model.sgn * get_Q_out(model.edge_id, model.sgn);
+    for (std::size_t k = 0; k < N; k += 1) {
+      const double q_prev = k > 0 ? q[k - 1] : Q_in;
+      const double p_next = k + 1 < N ? p[k + 1] : model.p_out;
+      f_p[k] = model.inv_C[k] * (q_prev - q[k]);
+      f_q[k] = model.inv_L[k] * (p[k] - p_next - model.R[k] * q[k]);
+    }
 
-      const auto &vertex_dof_map = d_dof_map->get_local_dof_map(*vertex);
-      const auto &vertex_dofs = vertex_dof_map.dof_indices();
+    // implicit or exponential euler step for the chain in the interleaved order, in which its jacobian is tridiagonal
+    if (tau_implicit > 0 || exponential) {
+      d_rcl_f.resize(2 * N);
+      for (std::size_t k = 0; k < N; k += 1) {
+        d_rcl_f[2 * k] = f_p[k];
+        d_rcl_f[2 * k + 1] = f_q[k];
+      }
+      if (exponential) {
+        multiply_dense(2 * N, &propagators->rcl[propagator_offset], d_rcl_f.data(), d_vessel_tree_scratch);
+        propagator_offset += 4 * N * N;
+      } else {
+        solve_implicit_euler_tridiagonal(tau_implicit, 2 * N, model.lower.data(), model.diag.data(), model.upper.data(), d_rcl_f.data(), d_vessel_tree_scratch);
+      }
+      for (std::size_t k = 0; k < N; k += 1) {
+        f_p[k] = d_rcl_f[2 * k];
+        f_q[k] = d_rcl_f[2 * k + 1];
+      }
+    }
+  }
+}
 
-      d_flow_upwind_evaluator.get_fluxes_on_nfurcation(t, *vertex, Q_up_macro_edge, A_up_macro_edge);
-      auto Q_out = Q_up_macro_edge.front();
+template<std::size_t degree, QuadratureType quadrature, bool use_default_S>
+void RightHandSideEvaluator::calculate_rhs_on_edge(const double t, const EdgeFEData &fe_data, const std::vector<double> &u_prev, std::vector<double> &rhs, EdgeWorkData &work) const {
+  constexpr std::size_t num_basis_functions = degree + 1;
+  constexpr std::size_t num_qp = num_quadrature_points(quadrature, degree);
+
+  const auto &local_dof_map = *fe_data.local_dof_map;
+  const FETypeNetwork &fe = *fe_data.fe;
+
+  assert(local_dof_map.num_basis_functions() == num_basis_functions);
+  assert(fe.num_quad_points() == num_qp);
+
+  // copy the shape functions into fixed size arrays, such that all the loops below can be unrolled.
+  // The test functions include the weights and the inverse mass, hence the kernel directly assembles the time derivatives.
+  std::array<std::array<double, num_qp>, num_basis_functions> phi{};
+  std::array<std::array<double, num_qp>, num_basis_functions> phi_JxW{};
+  std::array<std::array<double, num_qp>, num_basis_functions> dphi_JxW{};
+  std::array<std::array<double, num_basis_functions>, 2> phi_b{};
+  for (std::size_t i = 0; i < num_basis_functions; i += 1) {
+    for (std::size_t qp = 0; qp < num_qp; qp += 1) {
+      phi[i][qp] = fe.get_phi()[i][qp];
+      phi_JxW[i][qp] = fe.get_mass_scaled_phi_JxW()[i][qp];
+      dphi_JxW[i][qp] = fe.get_mass_scaled_dphi_JxW()[i][qp];
+    }
+    phi_b[0][i] = fe.get_mass_scaled_phi_boundary()[0][i];
+    phi_b[1][i] = fe.get_mass_scaled_phi_boundary()[1][i];
+  }
 
-      const double sgn = is_pointing_to ? +1 : -1;
+  const std::size_t num_micro_edges = local_dof_map.num_micro_edges();
+
+  // calculate fluxes on macro edge
+  // The fluxes at the macro edge boundaries need the ghost layer, which is still in flight.
+  // Hence we assemble with zero fluxes there and add them later in add_macro_edge_boundary_fluxes.
+  const std::size_t num_micro_vertices = local_dof_map.num_micro_vertices();
+  work.Q_up.resize(num_micro_vertices);
+  work.A_up.resize(num_micro_vertices);
+  d_flow_upwind_evaluator->get_inner_fluxes_on_macro_edge(t, fe_data.edge_id, num_micro_vertices, work.Q_up, work.A_up);
+  work.Q_up[0] = work.Q_up[num_micro_vertices - 1] = 0;
+  work.A_up[0] = work.A_up[num_micro_vertices - 1] = 0;
+
+  // All the temporary values are stored as structure of arrays, i.e. the values of consecutive micro edges
+  // at the same quadrature point (or for the same basis function) are contiguous in memory.
+  // This way the loops over the micro edges can be vectorized by the compiler.
+  auto &Q_loc = work.Q_loc;
+  auto &A_loc = work.A_loc;
+  auto &Q_qp = work.Q_qp;
+  auto &A_qp = work.A_qp;
+  auto &F_Q = work.F_Q;
+  auto &S_Q = work.S_Q;
+  auto &S_A = work.S_A;
+  auto &F_Q_up = work.F_Q_up;
+  auto &f_loc_Q = work.f_loc_Q;
+  auto &f_loc_A = work.f_loc_A;
+
+  Q_loc.resize(num_basis_functions * num_micro_edges);
+  A_loc.resize(num_basis_functions * num_micro_edges);
+  Q_qp.resize(num_qp * num_micro_edges);
+  A_qp.resize(num_qp * num_micro_edges);
+  F_Q.resize(num_qp * num_micro_edges);
+  S_Q.resize(num_qp * num_micro_edges);
+  S_A.resize(num_qp * num_micro_edges);
+  F_Q_up.resize(num_micro_vertices);
+  f_loc_Q.resize(num_basis_functions * num_micro_edges);
+  f_loc_A.resize(num_basis_functions * num_micro_edges);
+
+  // gather the dofs of all the micro edges, which are contiguous for every micro edge
+  for (std::size_t micro_edge_id = 0; micro_edge_id < num_micro_edges; micro_edge_id += 1) {
+    const double *Q_dofs = local_dof_map.dof_values(u_prev, micro_edge_id, 0);
+    const double *A_dofs = local_dof_map.dof_values(u_prev, micro_edge_id, 1);
+    for (std::size_t i = 0; i < num_basis_functions; i += 1) {
+      Q_loc[i * num_micro_edges + micro_edge_id] = Q_dofs[i];
+      A_loc[i * num_micro_edges + micro_edge_id] = A_dofs[i];
+    }
+  }
 
-      std::vector<double> p_c;
-      for (size_t k = 0; k < vertex_dofs.size(); k += 1) {
-        p_c.push_back(u_prev[vertex_dofs[k]]);
+  // evaluate Q and A inside the cells
+  for (std::size_t qp = 0; qp < num_qp; qp += 1) {
+    double *Q_qp_row = &Q_qp[qp * num_micro_edges];
+    double *A_qp_row = &A_qp[qp * num_micro_edges];
+    for (std::size_t me = 0; me < num_micro_edges; me += 1) {
+      Q_qp_row[me] = 0;
+      A_qp_row[me] = 0;
+    }
+    for (std::size_t i = 0; i < num_basis_functions; i += 1) {
+      const double phi_i = phi[i][qp];
+      const double *Q_loc_row = &Q_loc[i * num_micro_edges];
+      const double *A_loc_row = &A_loc[i * num_micro_edges];
+      for (std::size_t me = 0; me < num_micro_edges; me += 1) {
+        Q_qp_row[me] += phi_i * Q_loc_row[me];
+        A_qp_row[me] += phi_i * A_loc_row[me];
       }
+    }
+  }
 
-      // std::cout << p_c << std::endl;
+  const double F_Q_factor = edge_coefficients(fe_data.edge_id).F_Q_factor;
 
-      const auto &vtd = vertex->get_vessel_tree_data();
-      assert(vertex_dofs.size() == vtd.capacitances.size());
-      assert(vertex_dofs.size() == vtd.resistances.size());
-      const auto &C = vtd.capacitances;
-      // const double R_in = param.rho * param.get_c0() / param.A0;
-      const double p_out = vtd.p_out;
-      // we copy the resistances vector:
-      std::vector<double> R{vtd.resistances};
+  // evaluate F = (F_Q, F_A) at the quadrature points, where A^{3/2} = A sqrt(A) avoids the expensive call to pow
+  const auto &F_A = Q_qp;
+  for (std::size_t k = 0; k < F_Q.size(); k += 1) {
+    const double Q = Q_qp[k];
+    const double A = A_qp[k];
+    F_Q[k] = Q * Q / A + F_Q_factor * A * std::sqrt(A);
+  }
 
-      const auto n = static_cast< double >(vtd.furcation_number);
+  // evaluate F_Q at the upwinded values on the inner micro vertices
+  F_Q_up[0] = F_Q_up[num_micro_vertices - 1] = 0;
+  for (std::size_t k = 1; k + 1 < num_micro_vertices; k += 1) {
+    const double Q = work.Q_up[k];
+    const double A = work.A_up[k];
+    F_Q_up[k] = Q * Q / A + F_Q_factor * A * std::sqrt(A);
+  }
+
+  // evaluate S = (S_Q, S_A) at the quadrature points of all the micro edges in one go
+  if (use_default_S) {
+    const double friction = edge_coefficients(fe_data.edge_id).friction;
+    for (std::size_t k = 0; k < S_Q.size(); k += 1) {
+      S_Q[k] = friction * Q_qp[k] / A_qp[k];
+      S_A[k] = d_default_S_phi;
+    }
+  } else if (d_S_type == SourceType::batch) {
+    d_S_batch_evaluator(t, d_graph->edge(fe_data.edge_id), S_Q.size(), fe_data.points.data(), Q_qp.data(), A_qp.data(), S_Q.data(), S_A.data());
+  } else {
+    d_S_evaluator(t, d_graph->edge(fe_data.edge_id), fe_data.points, Q_qp, A_qp, S_Q, S_A);
+  }
 
-      // std::cout << "vid " << vertex->get_id() << " Q_out = " << Q_out << std::endl;
+  // on micro edges of different lengths JxW scales with the length and dphi with its inverse, hence only the sources are scaled
+  if (!fe_data.micro_edge_scales.empty()) {
+    for (std::size_t qp = 0; qp < num_qp; qp += 1) {
+      for (std::size_t me = 0; me < num_micro_edges; me += 1) {
+        S_Q[qp * num_micro_edges + me] *= fe_data.micro_edge_scales[me];
+        S_A[qp * num_micro_edges + me] *= fe_data.micro_edge_scales[me];
+      }
+    }
+  }
 
-      // first
-      rhs[vertex_dofs[0]] = 1. / C[0] * (sgn * Q_out - (p_c[0] - p_c[1]) / R[0]);
+  for (std::size_t i = 0; i < num_basis_functions; i += 1) {
+    double *f_Q = &f_loc_Q[i * num_micro_edges];
+    double *f_A = &f_loc_A[i * num_micro_edges];
 
-      // std::cout << rhs[vertex_dofs[0]] << std::endl;
+    for (std::size_t me = 0; me < num_micro_edges; me += 1) {
+      f_Q[me] = 0;
+      f_A[me] = 0;
+    }
 
+    // cell contributions
+    for (std::size_t qp = 0; qp < num_qp; qp += 1) {
+      const double phi_JxW_i = phi_JxW[i][qp];
+      const double dphi_JxW_i = dphi_JxW[i][qp];
+      const double *S_Q_row = &S_Q[qp * num_micro_edges];
+      const double *S_A_row = &S_A[qp * num_micro_edges];
+      const double *F_Q_row = &F_Q[qp * num_micro_edges];
+      const double *F_A_row = &F_A[qp * num_micro_edges];
+      for (std::size_t me = 0; me < num_micro_edges; me += 1) {
+        f_Q[me] += phi_JxW_i * S_Q_row[me] + dphi_JxW_i * F_Q_row[me];
+        f_A[me] += phi_JxW_i * S_A_row[me] + dphi_JxW_i * F_A_row[me];
+      }
+    }
 
-      // middle
-      for (size_t k = 1; k < p_c.size() - 1; k += 1)
-        rhs[vertex_dofs[k]] = 1. / C[k] * ((p_c[k - 1] - p_c[k]) / (n * R[k - 1]) - (p_c[k] - p_c[k + 1]) / R[k]);
+    // boundary contributions  - tau [ F(U_up) phi ] ds, keep attention to the minus!
+    const double phi_b_l = phi_b[0][i];
+    const double phi_b_r = phi_b[1][i];
+    for (std::size_t me = 0; me < num_micro_edges; me += 1) {
+      f_Q[me] += F_Q_up[me] * phi_b_l - F_Q_up[me + 1] * phi_b_r;
+      f_A[me] += work.Q_up[me] * phi_b_l - work.Q_up[me + 1] * phi_b_r;
+    }
+  }
 
-      //last
-      const size_t k_last = p_c.size() - 1;
-      rhs[vertex_dofs[k_last]] = 1. / C[k_last] * ((p_c[k_last - 1] - p_c[k_last]) / (n * R[k_last - 1]) - (p_c[k_last] - p_out) / (R[k_last]));
+  // copy into global vector, where the mass of a micro edge of different length is corrected.
+  // Every dof belongs to exactly one micro edge, hence we can assign instead of zeroing and adding.
+  for (std::size_t micro_edge_id = 0; micro_edge_id < num_micro_edges; micro_edge_id += 1) {
+    const std::size_t Q_first = local_dof_map.first_dof(micro_edge_id, 0);
+    const std::size_t A_first = local_dof_map.first_dof(micro_edge_id, 1);
+    const double scale = fe_data.micro_edge_scales.empty() ? 1. : 1. / fe_data.micro_edge_scales[micro_edge_id];
+    for (std::size_t i = 0; i < num_basis_functions; i += 1) {
+      rhs[Q_first + i] = scale * f_loc_Q[i * num_micro_edges + micro_edge_id];
+      rhs[A_first + i] = scale * f_loc_A[i * num_micro_edges + micro_edge_id];
     }
   }
 }
 
-void RightHandSideEvaluator::apply_inverse_mass(std::vector<double> &rhs) {
-  for (std::size_t i = 0; i < d_dof_map->num_dof(); i += 1)
-    rhs[i] = d_inverse_mass[i] * rhs[i];
+template<std::size_t degree, QuadratureType quadrature>
+void RightHandSideEvaluator::calculate_rhs_on_batch(const double t, const EdgeBatch &batch, const std::vector<double> &u_prev, std::vector<double> &rhs, EdgeWorkData &work) const {
+  constexpr std::size_t num_basis_functions = degree + 1;
+  constexpr std::size_t num_qp = num_quadrature_points(quadrature, degree);
+
+  const FETypeNetwork &fe = *batch.fe;
+  assert(fe.num_quad_points() == num_qp);
+
+  // the same tables as in calculate_rhs_on_edge, but for a micro edge of length 1
+  std::array<std::array<double, num_qp>, num_basis_functions> phi{};
+  std::array<std::array<double, num_qp>, num_basis_functions> phi_JxW{};
+  std::array<std::array<double, num_qp>, num_basis_functions> dphi_JxW{};
+  std::array<std::array<double, num_basis_functions>, 2> phi_b{};
+  for (std::size_t i = 0; i < num_basis_functions; i += 1) {
+    for (std::size_t qp = 0; qp < num_qp; qp += 1) {
+      phi[i][qp] = fe.get_phi()[i][qp];
+      phi_JxW[i][qp] = fe.get_mass_scaled_phi_JxW()[i][qp];
+      dphi_JxW[i][qp] = fe.get_mass_scaled_dphi_JxW()[i][qp];
+    }
+    phi_b[0][i] = fe.get_mass_scaled_phi_boundary()[0][i];
+    phi_b[1][i] = fe.get_mass_scaled_phi_boundary()[1][i];
+  }
+
+  // all the micro edges of the batch form a single structure of arrays
+  const std::size_t num_micro_edges = batch.num_micro_edges;
+
+  auto &Q_loc = work.Q_loc;
+  auto &A_loc = work.A_loc;
+  auto &Q_qp = work.Q_qp;
+  auto &A_qp = work.A_qp;
+  auto &F_Q = work.F_Q;
+  auto &S_Q = work.S_Q;
+  auto &S_A = work.S_A;
+  auto &Q_up_l = work.Q_up;
+  auto &Q_up_r = work.Q_up_r;
+  auto &F_Q_up_l = work.F_Q_up;
+  auto &F_Q_up_r = work.F_Q_up_r;
+  auto &f_loc_Q = work.f_loc_Q;
+  auto &f_loc_A = work.f_loc_A;
+
+  Q_loc.resize(num_basis_functions * num_micro_edges);
+  A_loc.resize(num_basis_functions * num_micro_edges);
+  Q_qp.resize(num_qp * num_micro_edges);
+  A_qp.resize(num_qp * num_micro_edges);
+  F_Q.resize(num_qp * num_micro_edges);
+  S_Q.resize(num_qp * num_micro_edges);
+  S_A.resize(num_qp * num_micro_edges);
+  Q_up_l.resize(num_micro_edges);
+  Q_up_r.resize(num_micro_edges);
+  F_Q_up_l.resize(num_micro_edges);
+  F_Q_up_r.resize(num_micro_edges);
+  f_loc_Q.resize(num_basis_functions * num_micro_edges);
+  f_loc_A.resize(num_basis_functions * num_micro_edges);
+
+  // gather the dofs and the upwinded values at both micro vertices of every micro edge
+  std::size_t offset = 0;
+  for (std::size_t k = batch.first; k < batch.last; k += 1) {
+    const auto &fe_data = d_edge_fe_data[k];
+    const auto &local_dof_map = *fe_data.local_dof_map;
+    const std::size_t num_edge_micro_edges = local_dof_map.num_micro_edges();
+
+    for (std::size_t micro_edge_id = 0; micro_edge_id < num_edge_micro_edges; micro_edge_id += 1) {
+      const double *Q_dofs = local_dof_map.dof_values(u_prev, micro_edge_id, 0);
+      const double *A_dofs = local_dof_map.dof_values(u_prev, micro_edge_id, 1);
+      for (std::size_t i = 0; i < num_basis_functions; i += 1) {
+        Q_loc[i * num_micro_edges + offset + micro_edge_id] = Q_dofs[i];
+        A_loc[i * num_micro_edges + offset + micro_edge_id] = A_dofs[i];
+      }
+    }
+
+    // the fluxes at the macro edge boundaries are added later in add_macro_edge_boundary_fluxes
+    const double *Q_up = nullptr;
+    const double *A_up = nullptr;
+    d_flow_upwind_evaluator->get_inner_flux_values(t, fe_data.edge_id, Q_up, A_up);
+    const double F_Q_factor = batch.F_Q_factor[offset];
+    Q_up_l[offset] = F_Q_up_l[offset] = 0;
+    Q_up_r[offset + num_edge_micro_edges - 1] = F_Q_up_r[offset + num_edge_micro_edges - 1] = 0;
+    for (std::size_t micro_vertex_id = 1; micro_vertex_id < num_edge_micro_edges; micro_vertex_id += 1) {
+      const double Q = Q_up[micro_vertex_id];
+      const double A = A_up[micro_vertex_id];
+      const double F = Q * Q / A + F_Q_factor * A * std::sqrt(A);
+      Q_up_r[offset + micro_vertex_id - 1] = Q;
+      F_Q_up_r[offset + micro_vertex_id - 1] = F;
+      Q_up_l[offset + micro_vertex_id] = Q;
+      F_Q_up_l[offset + micro_vertex_id] = F;
+    }
+
+    offset += num_edge_micro_edges;
+  }
+
+  // evaluate Q and A inside the cells
+  for (std::size_t qp = 0; qp < num_qp; qp += 1) {
+    double *Q_qp_row = &Q_qp[qp * num_micro_edges];
+    double *A_qp_row = &A_qp[qp * num_micro_edges];
+    for (std::size_t me = 0; me < num_micro_edges; me += 1) {
+      Q_qp_row[me] = 0;
+      A_qp_row[me] = 0;
+    }
+    for (std::size_t i = 0; i < num_basis_functions; i += 1) {
+      const double phi_i = phi[i][qp];
+      const double *Q_loc_row = &Q_loc[i * num_micro_edges];
+      const double *A_loc_row = &A_loc[i * num_micro_edges];
+      for (std::size_t me = 0; me < num_micro_edges; me += 1) {
+        Q_qp_row[me] += phi_i * Q_loc_row[me];
+        A_qp_row[me] += phi_i * A_loc_row[me];
+      }
+    }
+  }
+
+  // evaluate F and the default S with the coefficients of the edge of every micro edge, where the sources are scaled to its length
+  const auto &F_A = Q_qp;
+  const double *F_Q_factor = batch.F_Q_factor.data();
+  const double *friction = batch.friction.data();
+  const double *scales = batch.micro_edge_scales.data();
+  for (std::size_t qp = 0; qp < num_qp; qp += 1) {
+    const double *Q_qp_row = &Q_qp[qp * num_micro_edges];
+    const double *A_qp_row = &A_qp[qp * num_micro_edges];
+    double *F_Q_row = &F_Q[qp * num_micro_edges];
+    double *S_Q_row = &S_Q[qp * num_micro_edges];
+    double *S_A_row = &S_A[qp * num_micro_edges];
+    for (std::size_t me = 0; me < num_micro_edges; me += 1) {
+      const double Q = Q_qp_row[me];
+      const double A = A_qp_row[me];
+      F_Q_row[me] = Q * Q / A + F_Q_factor[me] * A * std::sqrt(A);
+      S_Q_row[me] = scales[me] * (friction[me] * Q / A);
+      S_A_row[me] = scales[me] * d_default_S_phi;
+    }
+  }
+
+  for (std::size_t i = 0; i < num_basis_functions; i += 1) {
+    double *f_Q = &f_loc_Q[i * num_micro_edges];
+    double *f_A = &f_loc_A[i * num_micro_edges];
+
+    for (std::size_t me = 0; me < num_micro_edges; me += 1) {
+      f_Q[me] = 0;
+      f_A[me] = 0;
+    }
+
+    // cell contributions
+    for (std::size_t qp = 0; qp < num_qp; qp += 1) {
+      const double phi_JxW_i = phi_JxW[i][qp];
+      const double dphi_JxW_i = dphi_JxW[i][qp];
+      const double *S_Q_row = &S_Q[qp * num_micro_edges];
+      const double *S_A_row = &S_A[qp * num_micro_edges];
+      const double *F_Q_row = &F_Q[qp * num_micro_edges];
+      const double *F_A_row = &F_A[qp * num_micro_edges];
+      for (std::size_t me = 0; me < num_micro_edges; me += 1) {
+        f_Q[me] += phi_JxW_i * S_Q_row[me] + dphi_JxW_i * F_Q_row[me];
+        f_A[me] += phi_JxW_i * S_A_row[me] + dphi_JxW_i * F_A_row[me];
+      }
+    }
+
+    // boundary contributions  - tau [ F(U_up) phi ] ds, keep attention to the minus!
+    const double phi_b_l = phi_b[0][i];
+    const double phi_b_r = phi_b[1][i];
+    for (std::size_t me = 0; me < num_micro_edges; me += 1) {
+      f_Q[me] += F_Q_up_l[me] * phi_b_l - F_Q_up_r[me] * phi_b_r;
+      f_A[me] += Q_up_l[me] * phi_b_l - Q_up_r[me] * phi_b_r;
+    }
+  }
+
+  // scatter into the global vector, where the tables of length 1 are corrected by the lengths of the micro edges
+  offset = 0;
+  for (std::size_t k = batch.first; k < batch.last; k += 1) {
+    const auto &local_dof_map = *d_edge_fe_data[k].local_dof_map;
+    const std::size_t num_edge_micro_edges = local_dof_map.num_micro_edges();
+    for (std::size_t micro_edge_id = 0; micro_edge_id < num_edge_micro_edges; micro_edge_id += 1) {
+      const std::size_t Q_first = local_dof_map.first_dof(micro_edge_id, 0);
+      const std::size_t A_first = local_dof_map.first_dof(micro_edge_id, 1);
+      const double scale = 1. / scales[offset + micro_edge_id];
+      for (std::size_t i = 0; i < num_basis_functions; i += 1) {
+        rhs[Q_first + i] = scale * f_loc_Q[i * num_micro_edges + offset + micro_edge_id];
+        rhs[A_first + i] = scale * f_loc_A[i * num_micro_edges + offset + micro_edge_id];
+      }
+    }
+    offset += num_edge_micro_edges;
+  }
 }
 
-} // namespace macrocirculation
\ No newline at end of file
+} // namespace macrocirculation
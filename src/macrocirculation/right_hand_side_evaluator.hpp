@@ -8,10 +8,15 @@
 #ifndef TUMORMODELS_RIGHT_HAND_SIDE_EVALUATOR_HPP
 #define TUMORMODELS_RIGHT_HAND_SIDE_EVALUATOR_HPP
 
+#include "fe_type.hpp"
 #include "nonlinear_flow_upwind_evaluator.hpp"
+#include "time_integrators.hpp"
+#include <array>
 #include <functional>
+#include <map>
 #include <memory>
 #include <mpi.h>
+#include <utility>
 #include <vector>
 
 namespace macrocirculation {
@@ -19,8 +24,12 @@ namespace macrocirculation {
 // forward declarations
 class GraphStorage;
 class DofMap;
+class LocalEdgeDofMap;
 class Vertex;
 class Edge;
+class ThreadPool;
+class CostMeasurement;
+class TaskGraph;
 
 /*! @brief Functional to evaluate the right-hand-side S. */
 class default_S {
@@ -38,12 +47,57 @@ public:
                   std::vector<double> &S_Q_out,
                   std::vector<double> &S_A_out) const;
 
+  /*! @returns The wall permeability [cm^2 s^{-1}]. */
+  double get_phi() const { return d_phi; }
+
 private:
   /*! @brief Wall permeability [cm^2 s^{-1}]. */
   double d_phi;
 };
 
-/*! @brief Assembles the inverse mass. WARNING: Assumes legendre basis! */
+/*! @brief The flow on a macro edge, as the edge kernel of the RightHandSideEvaluator has just evaluated it. */
+struct CoupledEdgeFlow {
+  std::size_t edge_id;
+
+  /*! @brief The shape functions and quadrature of the kernel on a micro edge. */
+  const FETypeNetwork &fe;
+
+  std::size_t num_micro_edges;
+
+  /*! @brief Q and A at the quadrature points, where the point qp of micro edge me has the index qp * num_micro_edges + me. */
+  const double *Q_qp;
+  const double *A_qp;
+
+  /*! @brief The upwinded Q and A at the micro vertices, which are zero at the two macro edge boundaries. */
+  const double *Q_up;
+  const double *A_up;
+};
+
+/*! @brief A further equation on the edges of the flow, e.g. a transport, which is assembled in the same edge pass as the flow,
+ *         see RightHandSideEvaluator::set_coupled_assembly.
+ */
+class CoupledEdgeAssembly {
+public:
+  virtual ~CoupledEdgeAssembly() = default;
+
+  /*! @brief Returns the vectors of the additional fields of the upwinding, whose macro edge boundary values are sent together with Q and A. */
+  virtual const std::vector<const std::vector<double> *> &get_boundary_field_values() const = 0;
+
+  /*! @brief Is called before the edge pass, which uses at most num_threads threads. */
+  virtual void start(double t, const std::vector<double> &u_prev, std::size_t num_threads) = 0;
+
+  /*! @brief Assembles the cells and the inner micro vertices of an edge on the thread, which has just assembled its flow.
+   *         Different edges are assembled concurrently.
+   */
+  virtual void assemble_edge(double t, const CoupledEdgeFlow &flow, const std::vector<double> &u_prev, std::size_t thread_id) = 0;
+
+  /*! @brief Adds the contributions at the macro edge boundaries, once the upwinding of the flow and the exchange of the boundary values are done. */
+  virtual void finish(double t, const std::vector<double> &u_prev, const NonlinearFlowUpwindEvaluator &upwind) = 0;
+};
+
+/*! @brief Assembles the inverse mass. WARNING: Assumes legendre basis!
+ *         The explicit solvers do not need it, since they test with the mass scaled tables of FETypeNetwork.
+ */
 void assemble_inverse_mass(MPI_Comm comm, const GraphStorage &graph, const DofMap &dof_map, std::vector<double> &inv_mass);
 
 /*! @brief Our flow equation d/dt u + d/dz F(u) = 0, can be written with a DG ansatz as,
@@ -54,16 +108,24 @@ void assemble_inverse_mass(MPI_Comm comm, const GraphStorage &graph, const DofMa
  *              M^{-1}( (F(u), d/dz v) - F(u(x_r))v(x_r) + F(u(x_l))v(x_l) )
  *         and can be easily used in a time integrator.
  */
-class RightHandSideEvaluator {
+class RightHandSideEvaluator : public ExplicitRightHandSide {
 public:
-  RightHandSideEvaluator(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, std::shared_ptr<DofMap> dof_map, std::size_t degree);
+  /*! @brief The degree of the shape functions is taken from the local dof map of every edge, such that the edges can have different degrees. */
+  RightHandSideEvaluator(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, std::shared_ptr<DofMap> dof_map);
+
+  ~RightHandSideEvaluator() override;
 
-  void evaluate(double t, const std::vector<double> &u_prev, std::vector<double> &rhs);
+  /*! @brief Evaluates the right-hand side including the inverse mass at time t for the given solution u_prev.
+   *         Only the dofs owned by this rank are written, all the other entries of rhs are left untouched.
+   *         tau_euler is the length of the explicit euler step in which the time integrator uses the right-hand side.
+   *         It is only needed if the 0D models are treated implicitly or exponentially, see set_implicit_0d_models and set_exponential_0d_models.
+   */
+  void evaluate(double t, const std::vector<double> &u_prev, std::vector<double> &rhs, double tau_euler = 0) override;
 
   /*! @brief Function type to evaluate a vectorial quantity at all the quadrature points in one go:
    *         - the 1st argument is the current time,
    *         - the 2nd argument the vessel,
-   *         - the 3rd argument are the quadrature points on the edge,
+   *         - the 3rd argument are the quadrature points on the edge (of all its micro edges),
    *         - the 4th and 5th components are for the flow Q and the area A, while
    *         - the 5th and 6th are the components of the vector evaluated at the quadrature points.
    */
@@ -75,10 +137,289 @@ public:
                                              std::vector<double> &,
                                              std::vector<double> &)>;
 
+  /*! @brief Function type to evaluate the right-hand side S at all the quadrature points of a macro edge in one go on contiguous arrays:
+   *         - the 1st argument is the current time,
+   *         - the 2nd argument the vessel,
+   *         - the 3rd argument is the number n of quadrature points on the edge,
+   *         - the 4th argument are the n quadrature points on the edge,
+   *         - the 5th and 6th arguments are the n values of the flow Q and the area A, while
+   *         - the 7th and 8th arguments are the n values of S_Q and S_A, which have to be written.
+   */
+  using BatchEvaluator = std::function<void(double,
+                                            const Edge &,
+                                            std::size_t,
+                                            const double *,
+                                            const double *,
+                                            const double *,
+                                            double *,
+                                            double *)>;
+
   /*! @brief Sets the right-hand side S. */
   void set_rhs_S(VectorEvaluator S_evaluator);
 
+  /*! @brief Sets the default right-hand side S, which is evaluated directly inside of the edge kernels without any function call. */
+  void set_rhs_S(const default_S &S);
+
+  /*! @brief Sets the right-hand side S, which gets all the quadrature data of a macro edge as contiguous arrays. */
+  void set_rhs_S_batch(BatchEvaluator S_evaluator);
+
+  /*! @brief Selects the quadrature of the cells, where QuadratureType::gauss_lobatto collocates the fluxes at the nodes with a lumped mass
+   *         and QuadratureType::gauss_over_integration integrates them with more points than the degree needs.
+   *         The dofs stay in the legendre basis, hence the solution can be used with any type. The default is QuadratureType::gauss.
+   */
+  void set_quadrature_type(QuadratureType type);
+
+  QuadratureType get_quadrature_type() const { return d_quadrature_type; }
+
+  /*! @brief Rebuilds the cached finite-element tables, the inverse mass and the communication of the upwinding.
+   *         Has to be called whenever the graph or the dof map were changed after construction, e.g. by a repartitioning.
+   */
+  void reinit();
+
+  /*! @brief Reloads the parameters of the 0D models from the vertices, e.g. after Vertex::update_windkessel_parameters.
+   *         In contrast to reinit, the dofs have to stay the same.
+   */
+  void update_0d_parameters();
+
+  /*! @brief Updates the 0D models after DofMap::renumber_vertex_dofs, i.e. after their boundary conditions changed.
+   *         In contrast to reinit, the cached data of the edges and the communication are kept, since the edge dofs did not change.
+   */
+  void update_vertex_dofs();
+
+  /*! @brief Reloads only the outflow pressures of the 0D models after Vertex::update_vessel_tip_pressures.
+   *         In contrast to update_0d_parameters this does not allocate, such that it can be called after every time step.
+   */
+  void update_outflow_pressures();
+
+  /*! @brief Measures the computation times of the edges and the vertices in the following evaluations, if a measurement is given. */
+  void set_cost_measurement(std::shared_ptr<CostMeasurement> measurement);
+
+  /*! @brief Splits the edge loops among the threads of the given pool.
+   *         The right-hand side S has to be thread-safe in this case.
+   */
+  void set_thread_pool(std::shared_ptr<ThreadPool> pool);
+
+  /*! @brief Returns the ranges of the dof vectors, which the threads write in the edge loops, see get_dof_chunk_offsets in graph_partitioner.hpp. */
+  std::vector<std::size_t> get_dof_chunk_offsets() const;
+
+  /*! @brief Evaluates the 1D model as a graph of tasks instead of the sequence of cell assembly, ghost layer exchange,
+   *         upwinding at the vertices and boundary fluxes. A vertex is upwinded as soon as the boundary values of all its edges
+   *         were evaluated or received, and the boundary fluxes of an edge are added as soon as its cell contributions
+   *         and the upwinding at both of its vertices are done. The ready tasks run on the threads of the pool, which steal from each other,
+   *         while the calling thread also polls for the messages of the neighboring ranks. The results are the same as without tasks.
+   */
+  void set_task_scheduling(bool enable);
+
+  /*! @brief Assembles consecutive edges with at most max_micro_edges micro edges and the same degree in batches,
+   *         whose cells are evaluated by a single kernel as one contiguous block, such that short vessels do not pay
+   *         the overhead of a kernel call each. The default is 8, and 0 disables the batches.
+   *         The batches are only used with the default right-hand side S, and not with the task graph, local time stepping,
+   *         a cost measurement or a coupled assembly, which all work with single edges.
+   *         The results only change by round-off, since a batch scales the shape functions to the lengths of its micro edges.
+   */
+  void set_edge_batching(std::size_t max_micro_edges);
+
+  /*! @returns The number of batches of short edges on our rank. */
+  std::size_t num_edge_batches() const { return d_edge_batches.size(); }
+
+  /*! @brief Restricts the evaluation to the edges with is_edge_active[edge_id] == true, e.g. for local time stepping.
+   *         The right-hand side on the other edges and their 0D boundary models is set to zero.
+   *         An empty vector activates all the edges.
+   */
+  void set_active_edges(std::vector<bool> is_edge_active);
+
+  /*! @brief Assembles the given equation in the same edge pass as the flow, such that it reuses the flow at the quadrature points
+   *         and the upwinded fluxes while they are still in the cache. The macro edge boundary values of the given fields are sent
+   *         in the messages of the flow, hence every evaluation exchanges them, even if the coupled equation is not assembled.
+   *         A nullptr removes the coupled equation.
+   */
+  void set_coupled_assembly(std::shared_ptr<CoupledEdgeAssembly> assembly, const std::vector<EdgeBoundaryField> &boundary_fields);
+
+  /*! @returns True, if a coupled equation was set. */
+  bool has_coupled_assembly() const { return d_coupled_assembly != nullptr; }
+
+  /*! @brief Assembles the coupled equation in the next evaluation for the given solution vector, which is the first stage of a time step.
+   *         The flow solver calls this in every step of solve, the local time stepping does not assemble the coupled equation.
+   */
+  void assemble_coupled_for(const std::vector<double> &u_prev) { d_coupled_u = &u_prev; }
+
+  /*! @brief Treats the linear windkessel, vessel tree and rcl models implicitly, while the 1D model stays explicit.
+   *         The right-hand side of the 0D dofs is replaced by (I - tau_euler J)^{-1} f,
+   *         where f is the explicit right-hand side and J its tridiagonal jacobian with respect to the 0D pressures and flows.
+   *         Hence, an explicit euler step of length tau_euler becomes an implicit euler step for the 0D models,
+   *         and their small capacitances and inductances do not restrict the time step anymore.
+   *         The rcl models are usually too stiff to be integrated explicitly.
+   *         This is only first order accurate for the 0D models.
+   */
+  void set_implicit_0d_models(bool implicit);
+
+  /*! @brief Integrates the linearized windkessel, vessel tree and rcl models exactly over each explicit euler step of length tau_euler,
+   *         assuming that the flow of the vessel is constant within the step.
+   *         The right-hand side of the 0D dofs is replaced by phi_1(tau_euler J) f with phi_1(z) = (e^z - 1) / z,
+   *         which removes the stability constraint of the 0D models without damping their dynamics like the implicit euler step.
+   *         The dense matrices phi_1(tau_euler J) are precomputed once per model and step length,
+   *         such that the 0D models only cost a small matrix-vector product per outlet and stage.
+   *         This overrides set_implicit_0d_models and vice versa.
+   */
+  void set_exponential_0d_models(bool exponential);
+
+  /*! @brief Returns the evaluator for the upwinded fluxes, e.g. to query its newton statistics. */
+  const NonlinearFlowUpwindEvaluator &get_flow_upwind_evaluator() const { return *d_flow_upwind_evaluator; }
+
+  NonlinearFlowUpwindEvaluator &get_flow_upwind_evaluator() { return *d_flow_upwind_evaluator; }
+
+  /*! @brief Returns a handle to the evaluator for the upwinded fluxes, which other solvers can keep. */
+  std::shared_ptr<const NonlinearFlowUpwindEvaluator> get_shared_flow_upwind_evaluator() const { return d_flow_upwind_evaluator; }
+
+  /*! @brief Returns the memory of the finite-element caches, the 0D models and the upwinding. */
+  MemoryReport memory_report() const;
+
 private:
+  /*! @brief Precalculated finite-element data for all the micro edges of a single macro edge. */
+  struct EdgeFEData {
+    /*! @brief The id of the macro edge. */
+    std::size_t edge_id;
+
+    /*! @brief The shape functions on a micro edge, shared by all edges with the same degree and micro edge length. */
+    const FETypeNetwork *fe;
+
+    /*! @brief The dofs of the edge, such that the edge loops of a step do not look up the graph. */
+    const LocalEdgeDofMap *local_dof_map;
+
+    /*! @brief The physical quadrature points of all micro edges, where the point qp of micro edge me has the index qp * num_micro_edges + me. */
+    std::vector<double> points;
+
+    /*! @brief The ratios of the micro edge lengths and the length h of fe, which is empty if all the micro edges have the length h. */
+    std::vector<double> micro_edge_scales;
+  };
+
+  /*! @brief Physical coefficients of a macro edge, which are needed by the kernels. */
+  struct EdgeCoefficients {
+    /*! @brief The factor G0 / (3 rho sqrt(A0)) in front of A^{3/2} in the flux F_Q. */
+    double F_Q_factor;
+
+    /*! @brief The characteristic resistance R1 = rho c0 / A0 of the vessel. */
+    double R1;
+
+    /*! @brief The friction factor -2 mu pi (gamma + 2) of the default right-hand side S_Q. */
+    double friction;
+  };
+
+  /*! @brief The consecutive edges [first, last) of d_edge_fe_data, which are assembled by a single kernel, see set_edge_batching.
+   *         The values of the micro edges are stored in the order of the edges, i.e. as if the edges were a single edge.
+   */
+  struct EdgeBatch {
+    std::size_t first;
+    std::size_t last;
+
+    /*! @brief The shape functions of the degree of the batch on a micro edge of length 1. */
+    const FETypeNetwork *fe;
+
+    std::size_t num_micro_edges;
+
+    /*! @brief The length of every micro edge, which scales the shape functions of fe. */
+    std::vector<double> micro_edge_scales;
+
+    /*! @brief The coefficients of the edge of every micro edge. */
+    std::vector<double> F_Q_factor;
+    std::vector<double> friction;
+  };
+
+  /*! @brief Temporary storage of an edge kernel in a structure of arrays layout over the micro edges.
+   *         Every thread has its own instance, which is aligned to a cache line to avoid false sharing.
+   */
+  struct alignas(64) EdgeWorkData {
+    /*! @brief The upwinded values on the micro vertices of a macro edge. */
+    std::vector<double> Q_up;
+    std::vector<double> A_up;
+
+    std::vector<double> Q_loc;
+    std::vector<double> A_loc;
+    std::vector<double> Q_qp;
+    std::vector<double> A_qp;
+    std::vector<double> F_Q;
+    std::vector<double> S_Q;
+    std::vector<double> S_A;
+    std::vector<double> F_Q_up;
+    std::vector<double> f_loc_Q;
+    std::vector<double> f_loc_A;
+
+    /*! @brief The values at the right micro vertex of every micro edge in the batched kernel, where Q_up and F_Q_up hold those at the left one. */
+    std::vector<double> Q_up_r;
+    std::vector<double> F_Q_up_r;
+  };
+
+  /*! @brief The packed parameters and dofs of a windkessel outflow. */
+  struct WindkesselModel {
+    std::size_t vertex_id;
+    std::size_t edge_id;
+    /*! @brief +1 if the edge points towards the vertex, otherwise -1. */
+    double sgn;
+    std::size_t p_c_dof;
+    double R1;
+    double R2;
+    double p_v;
+    double C;
+  };
+
+  /*! @brief A vessel tree outflow, whose chain of compartments occupies consecutive slots of the compartment block. */
+  struct VesselTreeOutflow {
+    std::size_t vertex_id;
+    std::size_t edge_id;
+    /*! @brief +1 if the edge points towards the vertex, otherwise -1. */
+    double sgn;
+    /*! @brief The first dof of the contiguous compartment pressures. */
+    std::size_t first_dof;
+    /*! @brief The slot of the first compartment inside the compartment block. */
+    std::size_t first_slot;
+    std::size_t num_compartments;
+  };
+
+  /*! @brief The compartments of all the vessel tree outflows of our rank as a structure of arrays.
+   *         Every chain is enclosed by two ghost slots: the one in front has no conductance to the first compartment,
+   *         the one behind holds the outflow pressure. Hence all the compartments are evaluated with the same stencil
+   *         f = (Q_in + G_prev (p_prev - p) - G_next (p - p_next)) / C, and the ghost slots yield zero since 1/C vanishes.
+   */
+  struct VesselTreeCompartments {
+    /*! @brief The compartment pressures, which are gathered from the solution, and the fixed outflow pressures. */
+    std::vector<double> p;
+    /*! @brief The flow from the vessel, which is only nonzero at the first compartment of a chain. */
+    std::vector<double> Q_in;
+    std::vector<double> inv_C;
+    /*! @brief The conductances 1/(n R_{k-1}) to the previous and 1/R_k to the next slot. */
+    std::vector<double> G_prev;
+    std::vector<double> G_next;
+    /*! @brief The right-hand side of the compartments, before it is scattered into the global vector. */
+    std::vector<double> f;
+    /*! @brief The tridiagonal jacobian with respect to the compartment pressures for the implicit euler step. */
+    std::vector<double> lower;
+    std::vector<double> diag;
+    std::vector<double> upper;
+
+    void resize(std::size_t num_slots);
+  };
+
+  /*! @brief The packed parameters and dofs of an rcl outflow.
+   *         Its dofs are the pressures p_0, ..., p_{N-1} of the compartments followed by the flows q_0, ..., q_{N-1} between them,
+   *         where q_k flows through R_k and L_k from p_k to p_{k+1} and p_N is the outflow pressure.
+   */
+  struct RCLChainModel {
+    std::size_t vertex_id;
+    std::size_t edge_id;
+    /*! @brief +1 if the edge points towards the vertex, otherwise -1. */
+    double sgn;
+    std::size_t first_dof;
+    std::size_t num_compartments;
+    double p_out;
+    std::vector<double> R;
+    std::vector<double> inv_C;
+    std::vector<double> inv_L;
+    /*! @brief The tridiagonal jacobian in the interleaved order p_0, q_0, p_1, q_1, ... for the implicit euler step. */
+    std::vector<double> lower;
+    std::vector<double> diag;
+    std::vector<double> upper;
+  };
+
   MPI_Comm d_comm;
 
   /*! @brief The current domain for solving the equation. */
@@ -87,24 +428,214 @@ private:
   /*! @brief The dof map for our domain */
   std::shared_ptr<DofMap> d_dof_map;
 
-  NonlinearFlowUpwindEvaluator d_flow_upwind_evaluator;
+  std::shared_ptr<NonlinearFlowUpwindEvaluator> d_flow_upwind_evaluator;
 
   /*! @brief Evaluates the Q- and A-component of the right-hand side S,
    *         given Q and A at eacht of the quadrature points.
    */
   VectorEvaluator d_S_evaluator;
 
-  /*! @brief The degree of the finite-element shape functions. */
-  std::size_t d_degree;
+  /*! @brief Evaluates the right-hand side S on contiguous arrays. */
+  BatchEvaluator d_S_batch_evaluator;
+
+  /*! @brief The different kinds of right-hand sides S. */
+  enum class SourceType { default_S, vector, batch };
+
+  /*! @brief The kind of right-hand side S we currently use. */
+  SourceType d_S_type;
+
+  /*! @brief The wall permeability of the default right-hand side S. */
+  double d_default_S_phi;
+
+  /*! @brief The quadrature of the cells for all the edges. */
+  QuadratureType d_quadrature_type;
+
+  /*! @brief Finite-element types already initialized on a micro edge, keyed by (degree, micro edge length). */
+  std::map<std::pair<std::size_t, double>, FETypeNetwork> d_fe_cache;
+
+  /*! @brief The finite-element data for each of our active edges. */
+  std::vector<EdgeFEData> d_edge_fe_data;
+
+  /*! @brief The physical coefficients of the edges of our rank and its ghost layer, indexed by their local edge index. */
+  std::vector<EdgeCoefficients> d_edge_coefficients;
+
+  /*! @brief Returns the physical coefficients of a local edge. */
+  const EdgeCoefficients &edge_coefficients(std::size_t edge_id) const { return d_edge_coefficients[d_flow_upwind_evaluator->get_boundary_evaluator().get_local_edge_index()(edge_id)]; }
+
+  /*! @brief The 0D models on the active edges of our rank, which are assembled without any branching on the vertex type. */
+  std::vector<WindkesselModel> d_windkessel_models;
+  std::vector<VesselTreeOutflow> d_vessel_tree_outflows;
+  VesselTreeCompartments d_vessel_tree_compartments;
+  std::vector<RCLChainModel> d_rcl_models;
+
+  /*! @brief The 0D dofs, whose right-hand side is zero, i.e. the models of inactive edges. */
+  std::vector<std::size_t> d_zero_0d_dofs;
+
+  /*! @brief Temporary storage for the implicit euler step of the vessel trees and rcl models. */
+  std::vector<double> d_vessel_tree_scratch;
+
+  /*! @brief The interleaved right-hand side of an rcl model for its implicit euler step. */
+  std::vector<double> d_rcl_f;
+
+  /*! @brief The matrices phi_1(tau J) of all our 0D models for a single step length tau, see set_exponential_0d_models. */
+  struct ExponentialPropagators {
+    double tau;
+    /*! @brief One scalar per windkessel model. */
+    std::vector<double> windkessel;
+    /*! @brief The dense row-major matrices of the vessel trees, one after another in the order of d_vessel_tree_outflows. */
+    std::vector<double> vessel_trees;
+    /*! @brief The dense row-major matrices of the rcl models in their interleaved order, one after another. */
+    std::vector<double> rcl;
+  };
+
+  /*! @brief The propagators for the step lengths of the stages of our time integrator. */
+  std::vector<ExponentialPropagators> d_exponential_propagators;
+
+  /*! @brief Returns the propagators for the step length tau and calculates them, if they are not cached yet. */
+  const ExponentialPropagators &get_exponential_propagators(double tau);
+
+  /*! @brief Rebuilds the inverse mass and all the rank dependent caches of the edge loops. */
+  void setup_caches();
+
+  /*! @brief Sorts the 0D models of our rank into the work lists by their type. */
+  void setup_0d_models();
+
+  /*! @brief Fills the finite-element cache for all the active edges. */
+  void setup_fe_cache();
+
+  /*! @brief Calculates the physical coefficients for all the edges with physical data. */
+  void setup_edge_coefficients();
+
+  /*! @brief Type of the kernels assembling the cell and boundary contributions of a single edge. */
+  using EdgeKernel = void (RightHandSideEvaluator::*)(double, const EdgeFEData &, const std::vector<double> &, std::vector<double> &, EdgeWorkData &) const;
+
+  /*! @brief The edge kernels indexed by the degree of the edge, selected at construction. */
+  std::array<EdgeKernel, max_fe_degree + 1> d_edge_kernels;
+
+  /*! @brief Type of the kernels assembling the cells of a batch of edges. */
+  using BatchKernel = void (RightHandSideEvaluator::*)(double, const EdgeBatch &, const std::vector<double> &, std::vector<double> &, EdgeWorkData &) const;
 
-  /*! @brief Our current inverse mass vector, defining the diagonal inverse mass matrix. */
-  std::vector<double> d_inverse_mass;
+  /*! @brief The batch kernels indexed by the degree of the batch, selected at construction. */
+  std::array<BatchKernel, max_fe_degree + 1> d_batch_kernels;
 
-  /*! @brief Assembles from the fluxes and the previous values a new right hand side function. */
-  void calculate_rhs(double t, const std::vector<double> &u_prev, std::vector<double> &rhs);
+  /*! @brief The largest number of micro edges of a batched edge, where 0 disables the batches. */
+  std::size_t d_max_batched_micro_edges;
 
-  /*! @brief Applies the inverse mass to our right hand side and saves the result to u_now. */
-  void apply_inverse_mass(std::vector<double> &rhs);
+  /*! @brief The batches of short edges, which never cross the chunks of the threads. */
+  std::vector<EdgeBatch> d_edge_batches;
+
+  /*! @brief The index of the batch starting at the k-th edge of d_edge_fe_data, or the maximum of std::size_t. */
+  std::vector<std::size_t> d_edge_batch_start;
+
+  /*! @brief Groups the short edges of our chunks into batches. */
+  void setup_edge_batches();
+
+  /*! @brief Temporary storage for the edge kernels, one per thread. */
+  std::vector<EdgeWorkData> d_edge_work;
+
+  /*! @brief The equation, which is assembled in the edge pass of the flow, or nullptr. */
+  std::shared_ptr<CoupledEdgeAssembly> d_coupled_assembly;
+
+  /*! @brief The solution vector, for whose next evaluation the coupled equation is assembled, or nullptr. */
+  const std::vector<double> *d_coupled_u;
+
+  /*! @brief True, while the current evaluation also assembles the coupled equation. */
+  bool d_assemble_coupled;
+
+  /*! @brief If not empty, only the edges marked as active are evaluated. */
+  std::vector<bool> d_is_edge_active;
+
+  /*! @brief Optional thread pool for the edge loops. */
+  std::shared_ptr<ThreadPool> d_thread_pool;
+
+  /*! @brief Optional measurement of the computation times of the edges and 0D models. */
+  std::shared_ptr<CostMeasurement> d_cost_measurement;
+
+  /*! @brief The chunks of d_edge_fe_data, which the threads of the pool work on. */
+  std::vector<std::size_t> d_edge_chunk_offsets;
+
+  /*! @brief The ways to integrate the linear 0D models. */
+  enum class ZeroDTreatment { explicit_stages, implicit_euler, exponential_euler };
+
+  /*! @brief How the linear 0D models are integrated within the stages. */
+  ZeroDTreatment d_0d_treatment;
+
+  /*! @brief True, if the right-hand side is evaluated by d_task_graph. */
+  bool d_task_scheduling;
+
+  /*! @brief The cell tasks of all the edges of d_edge_fe_data, then the vertex tasks of the upwinding, then the boundary flux tasks of the edges,
+   *         and finally an external task for the message of every receive neighbor. It is built at the first use after a reinit.
+   */
+  std::unique_ptr<TaskGraph> d_task_graph;
+
+  /*! @brief The first task of the receive neighbors in the task graph. */
+  std::size_t d_first_receive_task;
+
+  /*! @brief The receive neighbors, whose messages arrived in a poll of the task graph. */
+  std::vector<std::size_t> d_arrived_neighbors;
+
+  /*! @brief Builds the task graph for the current partition. */
+  void setup_task_graph();
+
+  /*! @brief Evaluates the 1D model with the task graph after the upwinding was started. */
+  void calculate_rhs_with_tasks(double t, const std::vector<double> &u_prev, std::vector<double> &rhs);
+
+  /*! @brief Assembles the cell contributions of the k-th edge of d_edge_fe_data, or sets them to zero for an inactive edge. */
+  void assemble_edge(std::size_t k, std::size_t thread_id, double t, const std::vector<double> &u_prev, std::vector<double> &rhs);
+
+  /*! @brief Assembles the cell contributions of the edges [begin, end) of d_edge_fe_data, where the batches are used if possible. */
+  void assemble_edges(std::size_t begin, std::size_t end, std::size_t thread_id, double t, const std::vector<double> &u_prev, std::vector<double> &rhs);
+
+  /*! @brief Sub-partitions the edges of d_edge_fe_data among the threads of our pool. */
+  void setup_edge_chunks();
+
+  /*! @brief Selects the edge kernels for all the degrees, the current type of right-hand side S and the quadrature. */
+  void select_edge_kernel();
+
+  /*! @brief Checks if the edge with the given id has to be evaluated. */
+  bool is_edge_active(std::size_t edge_id) const { return d_is_edge_active.empty() || d_is_edge_active[edge_id]; }
+
+  /*! @brief Assembles the cell and boundary contributions of a single edge with shape functions of the given degree.
+   *         If use_default_S is true, the default right-hand side is evaluated inline.
+   */
+  template<std::size_t degree, QuadratureType quadrature, bool use_default_S>
+  void calculate_rhs_on_edge(double t, const EdgeFEData &fe_data, const std::vector<double> &u_prev, std::vector<double> &rhs, EdgeWorkData &work) const;
+
+  /*! @brief Assembles the cells of a batch of edges with shape functions of the given degree and the default right-hand side S.
+   *         The fluxes at the macro edge boundaries are added later like for single edges.
+   */
+  template<std::size_t degree, QuadratureType quadrature>
+  void calculate_rhs_on_batch(double t, const EdgeBatch &batch, const std::vector<double> &u_prev, std::vector<double> &rhs, EdgeWorkData &work) const;
+
+  /*! @brief Returns the batch kernels for all the degrees with the given quadrature. */
+  template<QuadratureType quadrature, std::size_t... degrees>
+  static std::array<BatchKernel, sizeof...(degrees)> get_batch_kernels(std::index_sequence<degrees...>) {
+    return {&RightHandSideEvaluator::calculate_rhs_on_batch<degrees, quadrature>...};
+  }
+
+  /*! @brief Returns the edge kernels for the given degrees. */
+  template<QuadratureType quadrature, bool use_default_S, std::size_t... degrees>
+  static std::array<EdgeKernel, sizeof...(degrees)> get_edge_kernels(std::index_sequence<degrees...>) {
+    return {&RightHandSideEvaluator::calculate_rhs_on_edge<degrees, quadrature, use_default_S>...};
+  }
+
+  /*! @brief Returns the edge kernels for all the degrees with the given quadrature. */
+  template<QuadratureType quadrature>
+  static std::array<EdgeKernel, max_fe_degree + 1> get_edge_kernels(bool use_default_S) {
+    constexpr auto degrees = std::make_index_sequence<max_fe_degree + 1>{};
+    return use_default_S ? get_edge_kernels<quadrature, true>(degrees) : get_edge_kernels<quadrature, false>(degrees);
+  }
+
+  /*! @brief Adds the flux contributions at the macro edge boundaries, which the edge kernels skip, to the right-hand side. */
+  void add_macro_edge_boundary_fluxes(double t, std::vector<double> &rhs) const;
+
+  /*! @brief Adds the given upwinded values at the left and right boundary of the edge as flux contributions to the right-hand side. */
+  void add_macro_edge_boundary_fluxes_on_edge(const EdgeFEData &fe_data, double Q_l, double A_l, double Q_r, double A_r, std::vector<double> &rhs) const;
+
+  /*! @brief Assembles from the fluxes and the previous values a new right hand side function.
+   *         The ghost layer communication overlaps with the assembly of the cell contributions.
+   */
+  void calculate_rhs(double t, const std::vector<double> &u_prev, std::vector<double> &rhs, double tau_euler);
 };
 
 } // namespace macrocirculation
@@ -0,0 +1,90 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "roofline.hpp"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace macrocirculation {
+
+namespace {
+
+double ratio(double numerator, double denominator) {
+  return denominator > 0 ? numerator / denominator : 0.;
+}
+
+double count_of(const PhaseTimers::Statistics &s, const std::vector<HardwareCounters::Event> &events, const std::string &event_name) {
+  for (std::size_t k = 0; k < std::min(events.size(), s.counts.size()); k += 1) {
+    if (events[k].name == event_name)
+      return s.counts[k];
+  }
+  return 0.;
+}
+
+} // namespace
+
+std::vector<RooflinePoint> place_on_roofline(const std::vector<PhaseTimers::Statistics> &statistics, const MachinePeaks &peaks, int num_ranks) {
+  return place_on_roofline(statistics, HardwareCounters::get_events(), peaks, num_ranks);
+}
+
+std::vector<RooflinePoint> place_on_roofline(const std::vector<PhaseTimers::Statistics> &statistics, const std::vector<HardwareCounters::Event> &events, const MachinePeaks &peaks, int num_ranks) {
+  const double ridge = peaks.flops_per_second / peaks.bytes_per_second;
+
+  std::vector<RooflinePoint> points;
+  for (const auto &s : statistics) {
+    if (!(s.avg > 0))
+      continue;
+
+    double flops = 0;
+    double vector_flops = 0;
+    for (std::size_t k = 0; k < std::min(events.size(), s.counts.size()); k += 1) {
+      if (events[k].name.rfind("flops", 0) != 0)
+        continue;
+      flops += events[k].weight * s.counts[k];
+      if (events[k].weight > 1)
+        vector_flops += events[k].weight * s.counts[k];
+    }
+    flops /= num_ranks;
+    vector_flops /= num_ranks;
+
+    const double cache_misses = count_of(s, events, "cache misses") / num_ranks;
+    const double bytes = cache_misses * static_cast<double>(peaks.cache_line_bytes);
+
+    RooflinePoint point;
+    point.path = s.path;
+    point.seconds = s.avg;
+    point.flops = flops;
+    point.bytes = bytes;
+    point.arithmetic_intensity = ratio(flops, bytes);
+    point.flops_per_second = flops / s.avg;
+    point.attainable_flops_per_second = std::min(peaks.flops_per_second, point.arithmetic_intensity * peaks.bytes_per_second);
+    point.vector_ratio = ratio(vector_flops, flops);
+    point.instructions_per_cycle = ratio(count_of(s, events, "instructions"), count_of(s, events, "cycles"));
+    point.cache_miss_ratio = ratio(count_of(s, events, "cache misses"), count_of(s, events, "cache references"));
+    if (flops > 0 && bytes > 0)
+      point.bound = point.arithmetic_intensity < ridge ? "memory" : "compute";
+    else
+      point.bound = "unknown";
+    points.push_back(point);
+  }
+  return points;
+}
+
+void print_roofline(const std::vector<RooflinePoint> &points, const MachinePeaks &peaks, std::ostream &os) {
+  os << "roofline with " << peaks.flops_per_second * 1e-9 << " GFlop/s and " << peaks.bytes_per_second * 1e-9
+     << " GB/s per rank, ridge at " << peaks.flops_per_second / peaks.bytes_per_second << " flop/byte\n";
+  os << std::left << std::setw(48) << "phase" << std::right << std::setw(12) << "flop/byte" << std::setw(12) << "GFlop/s" << std::setw(14) << "attainable"
+     << std::setw(10) << "vector" << std::setw(8) << "ipc" << std::setw(12) << "miss ratio" << std::setw(10) << "bound" << "\n";
+  for (const auto &p : points)
+    os << std::left << std::setw(48) << p.path << std::right << std::setw(12) << p.arithmetic_intensity << std::setw(12) << p.flops_per_second * 1e-9
+       << std::setw(14) << p.attainable_flops_per_second * 1e-9 << std::setw(10) << p.vector_ratio << std::setw(8) << p.instructions_per_cycle
+       << std::setw(12) << p.cache_miss_ratio << std::setw(10) << p.bound << "\n";
+  os << std::flush;
+}
+
+} // namespace macrocirculation
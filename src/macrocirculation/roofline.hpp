@@ -0,0 +1,59 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_ROOFLINE_HPP
+#define TUMORMODELS_ROOFLINE_HPP
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "phase_timers.hpp"
+
+namespace macrocirculation {
+
+/*! @brief The peak performance of the hardware of a single rank, e.g. of a core if every core runs a rank. */
+struct MachinePeaks {
+  double flops_per_second;
+  /*! @brief The bandwidth to the main memory. */
+  double bytes_per_second;
+  std::size_t cache_line_bytes{64};
+};
+
+/*! @brief A phase on the roofline of a machine, where all the values are averaged over the ranks. */
+struct RooflinePoint {
+  std::string path;
+  double seconds;
+  /*! @brief The flops of the raw events, whose names start with "flops". */
+  double flops;
+  /*! @brief The bytes from the main memory, estimated by a cache line per last level cache miss. */
+  double bytes;
+  double arithmetic_intensity;
+  double flops_per_second;
+  /*! @brief The minimum of the peak flops and of the flops the bandwidth allows for the arithmetic intensity. */
+  double attainable_flops_per_second;
+  /*! @brief The part of the flops from events with more than one flop per count, i.e. from vector instructions. */
+  double vector_ratio;
+  double instructions_per_cycle;
+  double cache_miss_ratio;
+  /*! @brief Either "memory", "compute" or "unknown", if no flops or cache misses were counted. */
+  std::string bound;
+};
+
+/*! @brief Places the phases with a nonzero time on the roofline, where the counts of the statistics are summed over num_ranks ranks. */
+std::vector<RooflinePoint> place_on_roofline(const std::vector<PhaseTimers::Statistics> &statistics, const MachinePeaks &peaks, int num_ranks);
+
+/*! @brief Places the phases on the roofline, where the counts of the statistics belong to the given events. */
+std::vector<RooflinePoint> place_on_roofline(const std::vector<PhaseTimers::Statistics> &statistics, const std::vector<HardwareCounters::Event> &events, const MachinePeaks &peaks, int num_ranks);
+
+/*! @brief Prints the points as a table in GFlop/s together with the ridge point of the machine. */
+void print_roofline(const std::vector<RooflinePoint> &points, const MachinePeaks &peaks, std::ostream &os);
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_ROOFLINE_HPP
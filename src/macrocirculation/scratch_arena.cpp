@@ -0,0 +1,45 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "scratch_arena.hpp"
+
+#include <algorithm>
+
+namespace macrocirculation {
+
+void *ScratchArena::allocate_bytes(std::size_t bytes) {
+  // every array starts at a multiple of the fundamental alignment
+  const std::size_t units = (bytes + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t);
+  d_requested += units;
+
+  if (d_used + units <= d_block_size) {
+    void *ptr = d_block.get() + d_used;
+    d_used += units;
+    return ptr;
+  }
+
+  d_overflow_blocks.emplace_back(new std::max_align_t[std::max<std::size_t>(units, 1)]);
+  d_num_heap_allocations += 1;
+  return d_overflow_blocks.back().get();
+}
+
+void ScratchArena::reset() {
+  d_high_water_mark = std::max(d_high_water_mark, d_requested);
+
+  // the next stage gets a single block, which is large enough for everything requested so far
+  if (!d_overflow_blocks.empty()) {
+    d_overflow_blocks.clear();
+    d_block.reset(new std::max_align_t[d_high_water_mark]);
+    d_block_size = d_high_water_mark;
+    d_num_heap_allocations += 1;
+  }
+
+  d_used = 0;
+  d_requested = 0;
+}
+
+} // namespace macrocirculation
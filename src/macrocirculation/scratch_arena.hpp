@@ -0,0 +1,78 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_SCRATCH_ARENA_HPP
+#define TUMORMODELS_SCRATCH_ARENA_HPP
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace macrocirculation {
+
+/*! @brief Bump allocator for the temporary arrays of a stage, which are all released together by reset.
+ *
+ *  The arrays are carved out of a single block. If the block is exhausted, the arena falls back to extra blocks on the heap,
+ *  and the next reset replaces all of them by one block with the largest size used so far.
+ *  Hence, after the first stages a time stepping loop does not allocate any memory.
+ *  An arena is not thread safe, such that every thread needs its own one.
+ */
+class ScratchArena {
+public:
+  ScratchArena() = default;
+
+  ScratchArena(const ScratchArena &) = delete;
+  ScratchArena &operator=(const ScratchArena &) = delete;
+
+  ScratchArena(ScratchArena &&) = default;
+  ScratchArena &operator=(ScratchArena &&) = default;
+
+  /*! @brief Returns uninitialized storage for n values, which stays valid until the next reset. */
+  template<typename T>
+  T *allocate(std::size_t n) {
+    static_assert(std::is_trivially_destructible<T>::value, "the arena does not call destructors");
+    static_assert(alignof(T) <= alignof(std::max_align_t), "the arena only supports the fundamental alignments");
+    return static_cast<T *>(allocate_bytes(n * sizeof(T)));
+  }
+
+  /*! @brief Releases all the arrays of the arena, which keeps its memory for the next stage. */
+  void reset();
+
+  /*! @brief Returns the bytes of the block, which can be used without any allocation. */
+  std::size_t capacity() const { return d_block_size * sizeof(std::max_align_t); }
+
+  /*! @brief Returns the number of blocks, which were allocated on the heap since the construction, e.g. to check that a loop does not allocate. */
+  std::size_t num_heap_allocations() const { return d_num_heap_allocations; }
+
+private:
+  using Block = std::unique_ptr<std::max_align_t[]>;
+
+  /*! @brief The main block, whose size is given in units of max_align_t. */
+  Block d_block;
+  std::size_t d_block_size{0};
+
+  /*! @brief The used part of the main block in units of max_align_t. */
+  std::size_t d_used{0};
+
+  /*! @brief Blocks for the arrays, which did not fit into the main block anymore. */
+  std::vector<Block> d_overflow_blocks;
+
+  /*! @brief The units of all the arrays since the last reset. */
+  std::size_t d_requested{0};
+
+  /*! @brief The maximum of d_requested over all the stages. */
+  std::size_t d_high_water_mark{0};
+
+  std::size_t d_num_heap_allocations{0};
+
+  void *allocate_bytes(std::size_t bytes);
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_SCRATCH_ARENA_HPP
@@ -0,0 +1,104 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "snapshot_history.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+#include "communication/mpi.hpp"
+
+namespace macrocirculation {
+
+SnapshotHistory::SnapshotHistory(MPI_Comm comm)
+    : d_comm(comm),
+      d_first(0),
+      d_size(0),
+      d_interval(1),
+      d_step(0),
+      d_precision(StoragePrecision::double_precision),
+      d_triggered(false),
+      d_num_flushes(0) {}
+
+void SnapshotHistory::configure(std::size_t capacity, std::size_t interval, StoragePrecision precision) {
+  if (interval == 0)
+    throw std::runtime_error("the interval of the snapshots has to be positive");
+
+  d_ring.clear();
+  d_ring.resize(capacity);
+  d_first = 0;
+  d_size = 0;
+  d_interval = interval;
+  d_step = 0;
+  d_precision = precision;
+  d_triggered = false;
+  d_num_flushes = 0;
+}
+
+void SnapshotHistory::set_write_function(WriteFunction write) { d_write = std::move(write); }
+
+void SnapshotHistory::set_predicate(Predicate predicate) { d_predicate = std::move(predicate); }
+
+void SnapshotHistory::step(double t, const std::vector<double> &u) {
+  if (!is_active())
+    return;
+
+  d_step += 1;
+  if (d_step < d_interval)
+    return;
+  d_step = 0;
+
+  record(t, u);
+
+  // a single reduction decides for all the ranks
+  if (d_predicate) {
+    int fired = d_predicate(t, u) ? 1 : 0;
+    CHECK_MPI_SUCCESS(MPI_Allreduce(MPI_IN_PLACE, &fired, 1, MPI_INT, MPI_LOR, d_comm));
+    d_triggered = d_triggered || fired != 0;
+  }
+
+  if (d_triggered)
+    flush();
+}
+
+void SnapshotHistory::record(double t, const std::vector<double> &u) {
+  // the slots keep their memory, hence a full ring copies without allocating
+  const std::size_t idx = (d_first + d_size) % d_ring.size();
+  auto &snapshot = d_ring[idx];
+  snapshot.t = t;
+  if (d_precision == StoragePrecision::single_precision)
+    snapshot.u_single.assign(u.begin(), u.end());
+  else
+    snapshot.u = u;
+
+  if (d_size < d_ring.size())
+    d_size += 1;
+  else
+    d_first = (d_first + 1) % d_ring.size();
+}
+
+void SnapshotHistory::flush() {
+  d_triggered = false;
+  if (!d_write)
+    throw std::runtime_error("the snapshot history has no write function");
+
+  for (std::size_t k = 0; k < d_size; k += 1) {
+    const auto &snapshot = d_ring[(d_first + k) % d_ring.size()];
+    if (d_precision == StoragePrecision::single_precision) {
+      d_expanded.assign(snapshot.u_single.begin(), snapshot.u_single.end());
+      d_write(snapshot.t, d_expanded);
+    } else {
+      d_write(snapshot.t, snapshot.u);
+    }
+  }
+
+  d_first = 0;
+  d_size = 0;
+  d_num_flushes += 1;
+}
+
+} // namespace macrocirculation
@@ -0,0 +1,104 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_SNAPSHOT_HISTORY_HPP
+#define TUMORMODELS_SNAPSHOT_HISTORY_HPP
+
+#include <functional>
+#include <mpi.h>
+#include <vector>
+
+#include "time_integrators.hpp"
+
+namespace macrocirculation {
+
+/*! @brief Keeps the most recent states of the solution in memory, such that the states before an event can be written afterwards.
+ *
+ *  Every n-th step the solution, which includes the dofs of the 0D models, is copied into a ring of preallocated snapshots,
+ *  which overwrites the oldest one. In single precision the snapshots only need half of the memory.
+ *  When a trigger fires, all the snapshots are handed to the write function from the oldest to the newest, and the ring is cleared.
+ *  The predicate is evaluated at every recorded snapshot and its decision is reduced over all the ranks,
+ *  hence all the ranks flush together and the write function may communicate, e.g. to write checkpoints.
+ */
+class SnapshotHistory {
+public:
+  /*! @brief Function type writing the given solution at the given time. */
+  using WriteFunction = std::function<void(double, const std::vector<double> &)>;
+
+  /*! @brief Function type deciding on a single rank, if the given recorded solution is an event. */
+  using Predicate = std::function<bool(double, const std::vector<double> &)>;
+
+  explicit SnapshotHistory(MPI_Comm comm);
+
+  /*! @brief Keeps the last capacity snapshots, which are recorded every interval steps. A capacity of 0 disables the history, which is the default. */
+  void configure(std::size_t capacity, std::size_t interval = 1, StoragePrecision precision = StoragePrecision::double_precision);
+
+  /*! @returns True, if the history records snapshots. */
+  bool is_active() const { return !d_ring.empty(); }
+
+  void set_write_function(WriteFunction write);
+
+  /*! @brief Sets the predicate, which triggers a flush at a recorded snapshot, if it is true on any rank. */
+  void set_predicate(Predicate predicate);
+
+  /*! @brief Triggers a flush at the next recorded snapshot, e.g. from an external signal. Has to be called on all the ranks. */
+  void trigger() { d_triggered = true; }
+
+  /*! @brief Counts a time step, which ended at time t with the solution u, and records it, if we reached the interval.
+   *         Flushes the history after recording, if a trigger fired.
+   */
+  void step(double t, const std::vector<double> &u);
+
+  /*! @brief Hands all the snapshots from the oldest to the newest to the write function and clears the ring. */
+  void flush();
+
+  /*! @brief The number of snapshots, which are currently kept. */
+  std::size_t size() const { return d_size; }
+
+  /*! @brief The number of flushes since the history was configured. */
+  std::size_t num_flushes() const { return d_num_flushes; }
+
+private:
+  struct Snapshot {
+    double t;
+    std::vector<double> u;
+    std::vector<float> u_single;
+  };
+
+  MPI_Comm d_comm;
+
+  std::vector<Snapshot> d_ring;
+
+  /*! @brief The index of the oldest snapshot. */
+  std::size_t d_first;
+
+  std::size_t d_size;
+
+  std::size_t d_interval;
+
+  std::size_t d_step;
+
+  StoragePrecision d_precision;
+
+  WriteFunction d_write;
+
+  Predicate d_predicate;
+
+  bool d_triggered;
+
+  std::size_t d_num_flushes;
+
+  /*! @brief The solution of a single precision snapshot, which is expanded for the write function. */
+  std::vector<double> d_expanded;
+
+  /*! @brief Copies the solution into the slot of the oldest snapshot, if the ring is full. */
+  void record(double t, const std::vector<double> &u);
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_SNAPSHOT_HISTORY_HPP
@@ -0,0 +1,107 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "spatial_index.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace macrocirculation {
+
+namespace {
+
+double coordinate(const Point &p, std::size_t axis) {
+  return axis == 0 ? p.x : (axis == 1 ? p.y : p.z);
+}
+
+} // namespace
+
+PointKDTree::PointKDTree(const std::vector<Point> &points, const std::vector<std::size_t> &ids) {
+  if (points.size() != ids.size())
+    throw std::runtime_error("PointKDTree: every point needs an id");
+
+  d_entries.reserve(points.size());
+  for (std::size_t k = 0; k < points.size(); k += 1)
+    d_entries.push_back({points[k], ids[k]});
+
+  build(0, d_entries.size(), 0);
+}
+
+void PointKDTree::build(std::size_t begin, std::size_t end, std::size_t axis) {
+  if (end - begin <= 1)
+    return;
+
+  const std::size_t mid = begin + (end - begin) / 2;
+  std::nth_element(d_entries.begin() + begin, d_entries.begin() + mid, d_entries.begin() + end, [axis](const Entry &a, const Entry &b) {
+    return coordinate(a.point, axis) < coordinate(b.point, axis);
+  });
+
+  build(begin, mid, (axis + 1) % 3);
+  build(mid + 1, end, (axis + 1) % 3);
+}
+
+void PointKDTree::find_within_radius(const Point &p, double radius, std::vector<std::size_t> &ids) const {
+  find_within_radius(0, d_entries.size(), 0, p, radius, ids);
+}
+
+void PointKDTree::find_within_radius(std::size_t begin, std::size_t end, std::size_t axis, const Point &p, double radius, std::vector<std::size_t> &ids) const {
+  if (begin >= end)
+    return;
+
+  const std::size_t mid = begin + (end - begin) / 2;
+  const auto &entry = d_entries[mid];
+  if (Point::distance(entry.point, p) <= radius)
+    ids.push_back(entry.id);
+
+  // the left subtree has coordinates <= the median and the right one >= the median
+  const double delta = coordinate(p, axis) - coordinate(entry.point, axis);
+  const std::size_t next_axis = (axis + 1) % 3;
+  if (delta <= radius)
+    find_within_radius(begin, mid, next_axis, p, radius, ids);
+  if (delta >= -radius)
+    find_within_radius(mid + 1, end, next_axis, p, radius, ids);
+}
+
+bool PointKDTree::find_nearest(const Point &p, std::size_t &id, double &distance) const {
+  if (d_entries.empty())
+    return false;
+
+  std::size_t best = 0;
+  double best_distance = std::numeric_limits<double>::max();
+  find_nearest(0, d_entries.size(), 0, p, best, best_distance);
+  id = d_entries[best].id;
+  distance = best_distance;
+  return true;
+}
+
+void PointKDTree::find_nearest(std::size_t begin, std::size_t end, std::size_t axis, const Point &p, std::size_t &best, double &best_distance) const {
+  if (begin >= end)
+    return;
+
+  const std::size_t mid = begin + (end - begin) / 2;
+  const double distance = Point::distance(d_entries[mid].point, p);
+  if (distance < best_distance) {
+    best = mid;
+    best_distance = distance;
+  }
+
+  // we descend into the side of the query point first, the other side can only contain closer points if the splitting plane is close
+  const double delta = coordinate(p, axis) - coordinate(d_entries[mid].point, axis);
+  const std::size_t next_axis = (axis + 1) % 3;
+  if (delta < 0) {
+    find_nearest(begin, mid, next_axis, p, best, best_distance);
+    if (-delta <= best_distance)
+      find_nearest(mid + 1, end, next_axis, p, best, best_distance);
+  } else {
+    find_nearest(mid + 1, end, next_axis, p, best, best_distance);
+    if (delta <= best_distance)
+      find_nearest(begin, mid, next_axis, p, best, best_distance);
+  }
+}
+
+} // namespace macrocirculation
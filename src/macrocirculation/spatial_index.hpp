@@ -0,0 +1,59 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_SPATIAL_INDEX_HPP
+#define TUMORMODELS_SPATIAL_INDEX_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "graph_storage.hpp"
+
+namespace macrocirculation {
+
+/*! @brief Static k-d tree over a set of points in 3D, which are tagged with ids.
+ *
+ *  The tree is stored implicitly in a single array, where the median of a range is the root of its subtree.
+ *  Hence the tree has no pointers and is built in O(n log n).
+ */
+class PointKDTree {
+public:
+  PointKDTree() = default;
+
+  /*! @brief Builds the tree for the given points, where the k-th point has the id ids[k]. Ids do not need to be unique. */
+  PointKDTree(const std::vector<Point> &points, const std::vector<std::size_t> &ids);
+
+  std::size_t size() const { return d_entries.size(); }
+
+  /*! @brief Appends the ids of all points with an euclidean distance of at most radius to p to ids. */
+  void find_within_radius(const Point &p, double radius, std::vector<std::size_t> &ids) const;
+
+  /*! @brief Searches the point closest to p.
+   *
+   * @return False, if the tree is empty. Otherwise, the id and the distance of the closest point are stored in id and distance.
+   */
+  bool find_nearest(const Point &p, std::size_t &id, double &distance) const;
+
+private:
+  struct Entry {
+    Point point;
+    std::size_t id;
+  };
+
+  /*! @brief Sorts the entries in [begin, end) into a subtree, which is split at the given axis. */
+  void build(std::size_t begin, std::size_t end, std::size_t axis);
+
+  void find_within_radius(std::size_t begin, std::size_t end, std::size_t axis, const Point &p, double radius, std::vector<std::size_t> &ids) const;
+
+  void find_nearest(std::size_t begin, std::size_t end, std::size_t axis, const Point &p, std::size_t &best, double &best_distance) const;
+
+  std::vector<Entry> d_entries;
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_SPATIAL_INDEX_HPP
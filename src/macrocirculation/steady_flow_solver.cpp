@@ -0,0 +1,363 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "steady_flow_solver.hpp"
+
+#include <Eigen/Sparse>
+#include <Eigen/SparseLU>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+#include "communication/mpi.hpp"
+#include "dof_map.hpp"
+#include "graph_storage.hpp"
+#include "vessel_formulas.hpp"
+
+namespace macrocirculation {
+
+namespace {
+
+/*! @brief The number of midpoint samples of an inflow function for its mean over a period. */
+constexpr std::size_t num_period_samples = 1000;
+
+constexpr std::size_t max_newton_iterations = 50;
+
+/*! @brief The maximum number of times a newton step is halved, if it increases the residual or leaves the range of positive areas. */
+constexpr std::size_t max_step_halvings = 30;
+
+/*! @brief The inverse of the Poiseuille resistance of the whole vessel at the reference area A0. */
+double get_conductance(const PhysicalData &param) {
+  return 1. / (linear::get_L(param) * linear::get_R(param) * param.length);
+}
+
+/*! @brief The ratio sqrt(A/A0) = 1 + p / G0 of a vessel at the pressure p. */
+double get_area_ratio(const PhysicalData &param, double p) {
+  return 1. + p / param.G0;
+}
+
+} // namespace
+
+SteadyFlowSolver::SteadyFlowSolver(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, double period)
+    : d_comm(comm),
+      d_graph(std::move(graph)),
+      d_period(period),
+      d_mean_inflows(d_graph->num_vertices(), 0),
+      d_p(d_graph->num_vertices(), 0),
+      d_Q(d_graph->num_edges(), 0),
+      d_num_iterations(0) {
+  if (d_period <= 0)
+    throw std::runtime_error("the period of the steady flow solver has to be positive");
+
+  for (auto e_id : d_graph->get_edge_ids())
+    if (!d_graph->edge(e_id).has_physical_data())
+      throw std::runtime_error("the steady flow solver needs the physical data of all the edges");
+
+  for (auto v_id : d_graph->get_vertex_ids()) {
+    const auto &vertex = d_graph->vertex(v_id);
+    if (vertex.is_linear_characteristic_inflow() || vertex.is_nonlinear_characteristic_inflow())
+      throw std::runtime_error("the steady flow solver does not support the characteristic inflow at vertex " + vertex.get_name());
+    if (!vertex.is_inflow_with_fixed_flow() && !vertex.is_inflow_with_fixed_pressure())
+      continue;
+
+    double mean = 0;
+    for (std::size_t k = 0; k < num_period_samples; k += 1)
+      mean += vertex.get_inflow_value((static_cast<double>(k) + 0.5) * d_period / num_period_samples);
+    d_mean_inflows[v_id] = mean / num_period_samples;
+
+    if (vertex.is_inflow_with_fixed_pressure())
+      d_p[v_id] = d_mean_inflows[v_id];
+  }
+
+  update_flows();
+}
+
+double SteadyFlowSolver::get_pressure(const Edge &edge, double s) const {
+  const auto &param = edge.get_physical_data();
+  // the friction is proportional to (A0/A)^2 = (1 + p / G0)^{-4}, hence (1 + p / G0)^5 is linear along the vessel
+  const double r_l = std::pow(get_area_ratio(param, d_p[edge.get_vertex_neighbors()[0]]), 5);
+  const double r_r = std::pow(get_area_ratio(param, d_p[edge.get_vertex_neighbors()[1]]), 5);
+  return param.G0 * (std::pow((1 - s) * r_l + s * r_r, 0.2) - 1.);
+}
+
+double SteadyFlowSolver::get_outflow(const Vertex &vertex) const {
+  if (!vertex.is_leaf())
+    throw std::runtime_error("the outflow is only defined at the leaves");
+  const auto &edge = d_graph->edge(vertex.get_edge_neighbors()[0]);
+  return edge.is_pointing_to(vertex.get_id()) ? d_Q[edge.get_id()] : -d_Q[edge.get_id()];
+}
+
+FlowData SteadyFlowSolver::get_outflow_data() const {
+  FlowData data{{}, 0};
+  for (auto v_id : d_graph->get_vertex_ids()) {
+    const auto &vertex = d_graph->vertex(v_id);
+    if (!vertex.is_leaf() || vertex.is_inflow_with_fixed_flow() || vertex.is_inflow_with_fixed_pressure())
+      continue;
+    const double Q = get_outflow(vertex);
+    data.flows[v_id] = Q;
+    data.total_flow += Q;
+  }
+  return data;
+}
+
+void SteadyFlowSolver::update_flows() {
+  for (auto e_id : d_graph->get_edge_ids()) {
+    const auto &edge = d_graph->edge(e_id);
+    const auto &param = edge.get_physical_data();
+    const double r_l = get_area_ratio(param, d_p[edge.get_vertex_neighbors()[0]]);
+    const double r_r = get_area_ratio(param, d_p[edge.get_vertex_neighbors()[1]]);
+    d_Q[e_id] = get_conductance(param) * param.G0 / 5. * (std::pow(r_l, 5) - std::pow(r_r, 5));
+  }
+}
+
+double SteadyFlowSolver::get_outflow_resistance(const Vertex &vertex) const {
+  const auto &param = d_graph->edge(vertex.get_edge_neighbors()[0]).get_physical_data();
+  if (vertex.is_windkessel_outflow())
+    return vertex.get_peripheral_vessel_data().resistance;
+
+  // the 0D models are coupled to the vessel by its characteristic resistance R1
+  double R = calculate_R1(param);
+  if (vertex.is_vessel_tree_outflow()) {
+    // every level splits the flow into furcation_number parallel vessels
+    const auto &data = vertex.get_vessel_tree_data();
+    double num_vessels = 1;
+    for (double R_k : data.resistances) {
+      R += R_k / num_vessels;
+      num_vessels *= static_cast<double>(data.furcation_number);
+    }
+  } else {
+    for (double R_k : vertex.get_rcl_data().resistances)
+      R += R_k;
+  }
+  return R;
+}
+
+void SteadyFlowSolver::calculate_outflow(const Vertex &vertex, double &Q_out, double &dQ_out_dp) const {
+  const double p = d_p[vertex.get_id()];
+  if (vertex.is_free_outflow()) {
+    // the incoming characteristic keeps the value at rest, i.e. Q / A - 4 c = -4 c0, where c = c0 (A / A0)^{1/4}
+    const auto &param = d_graph->edge(vertex.get_edge_neighbors()[0]).get_physical_data();
+    const double c0 = calculate_c0(param);
+    const double r = get_area_ratio(param, p);
+    Q_out = 4 * c0 * param.A0 * r * r * (std::sqrt(r) - 1.);
+    dQ_out_dp = 4 * c0 * param.A0 / param.G0 * (2.5 * r * std::sqrt(r) - 2. * r);
+  } else if (vertex.is_windkessel_outflow() || vertex.is_vessel_tree_outflow() || vertex.is_rcl_outflow()) {
+    double p_out = 0;
+    if (vertex.is_windkessel_outflow())
+      p_out = vertex.get_peripheral_vessel_data().p_out;
+    else if (vertex.is_vessel_tree_outflow())
+      p_out = vertex.get_vessel_tree_data().p_out;
+    else
+      p_out = vertex.get_rcl_data().p_out;
+    const double R = get_outflow_resistance(vertex);
+    Q_out = (p - p_out) / R;
+    dQ_out_dp = 1. / R;
+  } else {
+    Q_out = 0;
+    dQ_out_dp = 0;
+  }
+}
+
+double SteadyFlowSolver::calculate_residual(std::vector<double> &residual) const {
+  residual.assign(d_graph->num_vertices(), 0);
+
+  for (auto e_id : d_graph->get_edge_ids()) {
+    const auto &neighbors = d_graph->edge(e_id).get_vertex_neighbors();
+    residual[neighbors[0]] += d_Q[e_id];
+    residual[neighbors[1]] -= d_Q[e_id];
+  }
+
+  for (auto v_id : d_graph->get_vertex_ids()) {
+    const auto &vertex = d_graph->vertex(v_id);
+    if (vertex.is_unconnected()) {
+      residual[v_id] = d_p[v_id];
+    } else if (vertex.is_inflow_with_fixed_pressure()) {
+      residual[v_id] = d_p[v_id] - d_mean_inflows[v_id];
+    } else if (vertex.is_inflow_with_fixed_flow()) {
+      residual[v_id] -= d_mean_inflows[v_id];
+    } else if (vertex.is_leaf()) {
+      double Q_out, dQ_out_dp;
+      calculate_outflow(vertex, Q_out, dQ_out_dp);
+      residual[v_id] += Q_out;
+    }
+  }
+
+  double max_residual = 0;
+  for (double r : residual)
+    max_residual = std::max(max_residual, std::abs(r));
+  return max_residual;
+}
+
+void SteadyFlowSolver::solve() {
+  using SparseMatrix = Eigen::SparseMatrix<double>;
+
+  const auto num_vertices = static_cast<Eigen::Index>(d_graph->num_vertices());
+
+  std::vector<double> residual;
+  double max_residual = calculate_residual(residual);
+
+  std::vector<Eigen::Triplet<double>> triplets;
+  Eigen::SparseLU<SparseMatrix> lu;
+  Eigen::VectorXd rhs(num_vertices);
+
+  for (d_num_iterations = 0; d_num_iterations < max_newton_iterations; d_num_iterations += 1) {
+    // the jacobian of the mass balances, where the rows of fixed pressures and unconnected vertices are the identity
+    triplets.clear();
+    const auto is_identity_row = [](const Vertex &v) { return v.is_unconnected() || v.is_inflow_with_fixed_pressure(); };
+    for (auto e_id : d_graph->get_edge_ids()) {
+      const auto &edge = d_graph->edge(e_id);
+      const auto &param = edge.get_physical_data();
+      const auto l = static_cast<Eigen::Index>(edge.get_vertex_neighbors()[0]);
+      const auto r = static_cast<Eigen::Index>(edge.get_vertex_neighbors()[1]);
+      const double dQ_dp_l = get_conductance(param) * std::pow(get_area_ratio(param, d_p[l]), 4);
+      const double dQ_dp_r = -get_conductance(param) * std::pow(get_area_ratio(param, d_p[r]), 4);
+      if (!is_identity_row(d_graph->vertex(l))) {
+        triplets.emplace_back(l, l, dQ_dp_l);
+        triplets.emplace_back(l, r, dQ_dp_r);
+      }
+      if (!is_identity_row(d_graph->vertex(r))) {
+        triplets.emplace_back(r, l, -dQ_dp_l);
+        triplets.emplace_back(r, r, -dQ_dp_r);
+      }
+    }
+    for (auto v_id : d_graph->get_vertex_ids()) {
+      const auto &vertex = d_graph->vertex(v_id);
+      const auto row = static_cast<Eigen::Index>(v_id);
+      if (is_identity_row(vertex)) {
+        triplets.emplace_back(row, row, 1.);
+      } else if (vertex.is_leaf()) {
+        double Q_out, dQ_out_dp;
+        calculate_outflow(vertex, Q_out, dQ_out_dp);
+        triplets.emplace_back(row, row, dQ_out_dp);
+      }
+    }
+
+    SparseMatrix J(num_vertices, num_vertices);
+    J.setFromTriplets(triplets.begin(), triplets.end());
+    lu.compute(J);
+    if (lu.info() != Eigen::Success)
+      throw std::runtime_error("the jacobian of the steady flow solver could not be factorized");
+
+    for (Eigen::Index k = 0; k < num_vertices; k += 1)
+      rhs[k] = residual[static_cast<std::size_t>(k)];
+    const Eigen::VectorXd dp = lu.solve(rhs);
+
+    // damped newton step, which keeps the areas positive
+    const std::vector<double> p_prev = d_p;
+    double step = 1;
+    double new_residual = max_residual;
+    for (std::size_t halving = 0; halving <= max_step_halvings; halving += 1, step /= 2) {
+      for (std::size_t k = 0; k < d_p.size(); k += 1)
+        d_p[k] = p_prev[k] - step * dp[static_cast<Eigen::Index>(k)];
+
+      bool is_admissible = true;
+      for (auto e_id : d_graph->get_edge_ids()) {
+        const auto &edge = d_graph->edge(e_id);
+        for (auto v_id : edge.get_vertex_neighbors())
+          is_admissible = is_admissible && get_area_ratio(edge.get_physical_data(), d_p[v_id]) > 0;
+      }
+      if (!is_admissible)
+        continue;
+
+      update_flows();
+      new_residual = calculate_residual(residual);
+      if (new_residual < max_residual || halving == max_step_halvings)
+        break;
+    }
+
+    double max_change = 0;
+    double max_p = 0;
+    for (std::size_t k = 0; k < d_p.size(); k += 1) {
+      max_change = std::max(max_change, std::abs(d_p[k] - p_prev[k]));
+      max_p = std::max(max_p, std::abs(d_p[k]));
+    }
+    max_residual = new_residual;
+
+    if (max_change <= 1e-12 * (1. + max_p)) {
+      d_num_iterations += 1;
+      return;
+    }
+  }
+
+  throw std::runtime_error("the newton iterations of the steady flow solver did not converge");
+}
+
+void SteadyFlowSolver::interpolate(const DofMap &dof_map, std::vector<double> &u) const {
+  const auto rank = mpi::rank(d_comm);
+
+  std::vector<std::size_t> dof_indices;
+  for (auto e_id : d_graph->get_active_edge_ids(rank)) {
+    const auto &edge = d_graph->edge(e_id);
+    const auto &param = edge.get_physical_data();
+    const auto &local_dof_map = dof_map.get_local_dof_map(edge);
+    dof_indices.resize(local_dof_map.num_basis_functions());
+
+    const auto lengths = edge.get_micro_edge_lengths();
+    double s_left = 0;
+    for (std::size_t micro_edge_id = 0; micro_edge_id < local_dof_map.num_micro_edges(); micro_edge_id += 1) {
+      const double s_right = s_left + lengths[micro_edge_id] / param.length;
+
+      // the flow is constant
+      local_dof_map.dof_indices(micro_edge_id, 0, dof_indices);
+      for (auto idx : dof_indices)
+        u[idx] = 0;
+      u[dof_indices[0]] = d_Q[e_id];
+
+      // the area is interpolated linearly between the ends of the micro edge
+      const double A_l = nonlinear::get_A_from_p(get_pressure(edge, s_left), param.G0, param.A0);
+      const double A_r = nonlinear::get_A_from_p(get_pressure(edge, std::min(s_right, 1.)), param.G0, param.A0);
+      local_dof_map.dof_indices(micro_edge_id, 1, dof_indices);
+      for (auto idx : dof_indices)
+        u[idx] = 0;
+      u[dof_indices[0]] = 0.5 * (A_l + A_r);
+      if (dof_indices.size() > 1)
+        u[dof_indices[1]] = 0.5 * (A_r - A_l);
+
+      s_left = s_right;
+    }
+  }
+
+  // the pressures of the 0D models drop linearly with their resistances towards the outflow pressure
+  for (auto v_id : d_graph->get_active_vertex_ids(rank)) {
+    const auto &vertex = d_graph->vertex(v_id);
+    if (!vertex.is_windkessel_outflow() && !vertex.is_vessel_tree_outflow() && !vertex.is_rcl_outflow())
+      continue;
+
+    const double Q = get_outflow(vertex);
+    const std::size_t first_dof = dof_map.get_local_dof_map(vertex).first_dof();
+    const auto &param = d_graph->edge(vertex.get_edge_neighbors()[0]).get_physical_data();
+
+    if (vertex.is_windkessel_outflow()) {
+      const auto &data = vertex.get_peripheral_vessel_data();
+      u[first_dof] = data.p_out + (data.resistance - calculate_R1(param)) * Q;
+    } else if (vertex.is_vessel_tree_outflow()) {
+      const auto &data = vertex.get_vessel_tree_data();
+      const std::size_t n = data.resistances.size();
+      // the flow through a vessel of level k is Q / furcation_number^k
+      std::vector<double> level_flows(n, Q);
+      for (std::size_t k = 1; k < n; k += 1)
+        level_flows[k] = level_flows[k - 1] / static_cast<double>(data.furcation_number);
+      double p = data.p_out;
+      for (std::size_t k = n; k > 0; k -= 1) {
+        p += data.resistances[k - 1] * level_flows[k - 1];
+        u[first_dof + k - 1] = p;
+      }
+    } else {
+      const auto &data = vertex.get_rcl_data();
+      const std::size_t n = data.resistances.size();
+      double p = data.p_out;
+      for (std::size_t k = n; k > 0; k -= 1) {
+        p += data.resistances[k - 1] * Q;
+        u[first_dof + k - 1] = p;
+        u[first_dof + n + k - 1] = Q;
+      }
+    }
+  }
+}
+
+} // namespace macrocirculation
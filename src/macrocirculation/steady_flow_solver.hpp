@@ -0,0 +1,103 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_STEADY_FLOW_SOLVER_HPP
+#define TUMORMODELS_STEADY_FLOW_SOLVER_HPP
+
+#include <memory>
+#include <mpi.h>
+#include <vector>
+
+#include "rcr_estimator.hpp"
+
+namespace macrocirculation {
+
+// forward declarations
+class GraphStorage;
+class DofMap;
+class Edge;
+class Vertex;
+
+/*! @brief Calculates the time averaged pressures and flows of a network in a single sparse nonlinear solve,
+ *         e.g. as a fast estimate of the outflows for a calibration or as an initial condition close to the periodic state.
+ *
+ *  Every vessel is a resistance given by the steady 1D model without the convective term.
+ *  Its friction is the Poiseuille resistance L R per length of the linearized model, see linear::get_R, at the current area.
+ *  Since the area grows with the pressure, the flow Q = G0 / (5 L R length) ((1 + p_l / G0)^5 - (1 + p_r / G0)^5) through a vessel
+ *  is nonlinear in the pressures p_l and p_r at its ends.
+ *  The windkessel, vessel tree and rcl outflows are their total resistances towards their outflow pressure,
+ *  while the characteristic of a free outflow is kept, which is the resistance R1 towards zero for small pressures.
+ *  The inflows get the mean of their function over the given period.
+ *
+ *  The network is small compared to the 1D model, hence every rank solves all of it with newton's method without any communication.
+ */
+class SteadyFlowSolver {
+public:
+  SteadyFlowSolver(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, double period);
+
+  /*! @brief Solves for the steady pressures and flows, where the last solution is the initial guess.
+   *         Throws, if newton's method does not converge.
+   */
+  void solve();
+
+  /*! @brief The number of newton iterations of the last solve. */
+  std::size_t get_num_iterations() const { return d_num_iterations; }
+
+  /*! @brief The mean pressure at the given vertex. */
+  double get_pressure(std::size_t vertex_id) const { return d_p[vertex_id]; }
+
+  /*! @brief The mean pressure at the relative position s in [0,1] along the given edge. */
+  double get_pressure(const Edge &edge, double s) const;
+
+  /*! @brief The mean flow through the given edge in its direction. */
+  double get_flow(std::size_t edge_id) const { return d_Q[edge_id]; }
+
+  /*! @brief The mean flow leaving the network at the given leaf, which is negative at inflows. */
+  double get_outflow(const Vertex &vertex) const;
+
+  /*! @brief The mean flows leaving the network at all the outflows and their sum. */
+  FlowData get_outflow_data() const;
+
+  /*! @brief Sets the dofs of our rank to the steady state, i.e. the flow is constant and the area is interpolated linearly on every micro edge,
+   *         and the dofs of the 0D models get their steady pressures and flows.
+   */
+  void interpolate(const DofMap &dof_map, std::vector<double> &u) const;
+
+private:
+  MPI_Comm d_comm;
+
+  std::shared_ptr<GraphStorage> d_graph;
+
+  double d_period;
+
+  /*! @brief The mean values of the inflow functions, indexed by the vertex id. */
+  std::vector<double> d_mean_inflows;
+
+  /*! @brief The pressures indexed by the vertex id. */
+  std::vector<double> d_p;
+
+  /*! @brief The flows indexed by the edge id. */
+  std::vector<double> d_Q;
+
+  std::size_t d_num_iterations;
+
+  /*! @brief Calculates the flows of the edges from the pressures. */
+  void update_flows();
+
+  /*! @brief Calculates the mass balance at every vertex, or the deviation from the pressure at pressure inflows, and returns the largest absolute value. */
+  double calculate_residual(std::vector<double> &residual) const;
+
+  /*! @brief The resistance of a 0D outflow towards its outflow pressure. */
+  double get_outflow_resistance(const Vertex &vertex) const;
+
+  /*! @brief The outflow of a leaf and its derivative with respect to the pressure at the leaf. */
+  void calculate_outflow(const Vertex &vertex, double &Q_out, double &dQ_out_dp) const;
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_STEADY_FLOW_SOLVER_HPP
@@ -0,0 +1,133 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "synthetic_network.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "0d_boundary_conditions.hpp"
+#include "graph_storage.hpp"
+#include "vessel_formulas.hpp"
+
+namespace macrocirculation {
+
+namespace {
+
+/*! @brief The end of a vessel, from which its children start. */
+struct BranchPoint {
+  Vertex *vertex;
+  double radius;
+  double flow_fraction;
+  Point point;
+  double angle;
+};
+
+void validate(const SyntheticTreeParameters &parameters) {
+  if (parameters.depth == 0)
+    throw std::runtime_error("a synthetic tree needs at least one generation");
+  if (parameters.branching_factor == 0)
+    throw std::runtime_error("a synthetic tree needs a positive branching factor");
+  if (!(parameters.asymmetry >= 0 && parameters.asymmetry < 1))
+    throw std::runtime_error("the asymmetry of a synthetic tree has to lie in [0, 1)");
+  if (!(parameters.murray_exponent > 0 && parameters.root_radius > 0 && parameters.root_length > 0))
+    throw std::runtime_error("the murray exponent, root radius and root length of a synthetic tree have to be positive");
+  if (parameters.min_micro_edges == 0)
+    throw std::runtime_error("every vessel needs at least one micro edge");
+}
+
+void set_outlet(const SyntheticTreeParameters &parameters, Vertex &vertex, const Edge &edge, double flow_fraction) {
+  if (parameters.outlet == SyntheticTreeOutlet::vessel_tree) {
+    const auto tree = calculate_edge_tree_parameters(edge);
+    if (tree.R.empty())
+      throw std::runtime_error("the vessel " + std::to_string(edge.get_id()) + " is too small for a vessel tree outlet");
+    const double p_cap = 30 * (133.333) * 1e-2;
+    vertex.set_to_vessel_tree_outflow(p_cap, tree.R, tree.C, tree.radii, 2);
+    return;
+  }
+
+  // the windkessels in parallel have the total resistance and compliance,
+  // and the windkessel has to be larger than the characteristic resistance, which it contains
+  const double R1 = calculate_R1(edge.get_physical_data());
+  const double R = std::max(parameters.total_resistance / flow_fraction, 2 * R1);
+  vertex.set_to_windkessel_outflow(R, parameters.total_compliance * flow_fraction);
+}
+
+} // namespace
+
+std::size_t get_num_synthetic_tree_vessels(const SyntheticTreeParameters &parameters) {
+  std::size_t num_vessels = 0;
+  std::size_t generation_size = 1;
+  for (std::size_t generation = 0; generation < parameters.depth; generation += 1) {
+    num_vessels += generation_size;
+    generation_size *= parameters.branching_factor;
+  }
+  return num_vessels;
+}
+
+std::shared_ptr<GraphStorage> create_synthetic_arterial_tree(const SyntheticTreeParameters &parameters) {
+  validate(parameters);
+
+  auto graph = std::make_shared<GraphStorage>();
+
+  const std::size_t n = parameters.branching_factor;
+  const double length_per_radius = parameters.root_length / parameters.root_radius;
+
+  // the flow fractions of the children, which sum up to one
+  std::vector<double> weights(n, 1. / static_cast<double>(n));
+  if (n > 1)
+    for (std::size_t i = 0; i < n; i += 1)
+      weights[i] *= 1. + parameters.asymmetry * (static_cast<double>(n - 1) - 2. * static_cast<double>(i)) / static_cast<double>(n - 1);
+
+  auto &root = *graph->create_vertex();
+  root.set_name("in");
+
+  std::vector<BranchPoint> generation{{&root, parameters.root_radius, 1., Point(0, 0, 0), M_PI / 2}};
+  std::vector<BranchPoint> next_generation;
+  std::size_t num_outlets = 0;
+
+  for (std::size_t g = 0; g < parameters.depth; g += 1) {
+    const bool is_last_generation = g + 1 == parameters.depth;
+    const std::size_t num_children = g == 0 ? 1 : n;
+
+    next_generation.clear();
+    for (const auto &parent : generation) {
+      for (std::size_t i = 0; i < num_children; i += 1) {
+        const double weight = g == 0 ? 1. : weights[i];
+        const double radius = parent.radius * std::pow(weight, 1. / parameters.murray_exponent);
+        const double length = length_per_radius * radius;
+        const double angle = (g == 0 || n == 1) ? parent.angle : parent.angle + parameters.branching_angle * (static_cast<double>(i) / static_cast<double>(n - 1) - 0.5);
+        const Point end(parent.point.x + length * std::cos(angle), parent.point.y + length * std::sin(angle), 0);
+
+        auto &vertex = *graph->create_vertex();
+        const auto num_micro_edges = std::max(parameters.min_micro_edges, static_cast<std::size_t>(std::round(length * parameters.micro_edges_per_cm)));
+        auto &edge = *graph->connect(*parent.vertex, vertex, num_micro_edges);
+        edge.add_physical_data(PhysicalData::set_from_data(parameters.elastic_modulus, parameters.wall_thickness_ratio * radius, parameters.density, parameters.gamma, radius, length));
+        if (parameters.embed)
+          edge.add_embedding_data(EmbeddingData{{parent.point, end}});
+
+        const double flow_fraction = parent.flow_fraction * weight;
+        if (is_last_generation) {
+          vertex.set_name("out_" + std::to_string(num_outlets++));
+          set_outlet(parameters, vertex, edge, flow_fraction);
+        } else {
+          next_generation.push_back({&vertex, radius, flow_fraction, end, angle});
+        }
+      }
+    }
+    std::swap(generation, next_generation);
+  }
+
+  // the boundary conditions can only be set at leaves
+  root.set_to_inflow_with_fixed_flow(heart_beat_inflow(parameters.heart_amplitude));
+
+  return graph;
+}
+
+} // namespace macrocirculation
@@ -0,0 +1,99 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_SYNTHETIC_NETWORK_HPP
+#define TUMORMODELS_SYNTHETIC_NETWORK_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <memory>
+
+namespace macrocirculation {
+
+// forward declarations
+class GraphStorage;
+
+/*! @brief The outflow models at the leaves of a synthetic arterial tree. */
+enum class SyntheticTreeOutlet {
+  /*! @brief An RCR model, whose resistance and compliance are a share of the total ones. */
+  windkessel,
+  /*! @brief A chain of compartments for the smaller vessels, see calculate_edge_tree_parameters.
+   *         The chains are stiff, hence they should be integrated with ExplicitNonlinearFlowSolver::set_implicit_0d_models. */
+  vessel_tree
+};
+
+/*! @brief Describes a self similar arterial tree, where every vessel splits into branching_factor vessels.
+ *
+ *  The radii follow Murray's law r^k = sum_i r_i^k with k = murray_exponent.
+ *  For a vanishing asymmetry all the children have the same radius, otherwise the flow fractions of the children
+ *  decrease linearly from (1 + asymmetry) / n to (1 - asymmetry) / n.
+ *  The lengths scale with the radii, such that all the vessels have the same ratio of length to radius.
+ */
+struct SyntheticTreeParameters {
+  /*! @brief The number of generations, i.e. the tree has 1 + n + ... + n^(depth-1) vessels for the branching factor n. */
+  std::size_t depth = 5;
+
+  std::size_t branching_factor = 2;
+
+  double murray_exponent = 3.;
+
+  /*! @brief In [0, 1), the difference of the flow fractions of the children. */
+  double asymmetry = 0.;
+
+  /*! @brief The radius of the root vessel in cm. */
+  double root_radius = 1.2;
+
+  /*! @brief The length of the root vessel in cm. */
+  double root_length = 4.;
+
+  /*! @brief The wall thickness relative to the radius. */
+  double wall_thickness_ratio = 0.1;
+
+  /*! @brief The elastic modulus in the units of PhysicalData::set_from_data. */
+  double elastic_modulus = 400000.;
+
+  /*! @brief The blood density in kg cm^{-3}. */
+  double density = 1.028e-3;
+
+  /*! @brief The shape of the velocity profile. */
+  double gamma = 9;
+
+  /*! @brief The number of micro edges per cm, where every vessel has at least min_micro_edges. */
+  double micro_edges_per_cm = 4.;
+
+  std::size_t min_micro_edges = 1;
+
+  SyntheticTreeOutlet outlet = SyntheticTreeOutlet::windkessel;
+
+  /*! @brief The resistance of all the windkessels in parallel, which is split among them by their flow fractions. */
+  double total_resistance = 1.34;
+
+  /*! @brief The compliance of all the windkessels in parallel, which is split among them by their flow fractions. */
+  double total_compliance = 0.945;
+
+  /*! @brief The amplitude of the heart beat at the root. */
+  double heart_amplitude = 485.;
+
+  /*! @brief Embeds the vessels as straight lines into the xy-plane, such that the tree can be visualized and probed. */
+  bool embed = true;
+
+  /*! @brief The angle between the outermost children in the embedding. */
+  double branching_angle = M_PI / 2;
+};
+
+/*! @brief Builds a synthetic arterial tree in memory, with a heart beat at the root vertex "in" and outflow models
+ *         at the leaves named "out_0", "out_1", ... .
+ *         The boundary conditions still have to be finalized with GraphStorage::finalize_bcs before partitioning the graph.
+ */
+std::shared_ptr<GraphStorage> create_synthetic_arterial_tree(const SyntheticTreeParameters &parameters);
+
+/*! @brief The number of vessels of the tree created for the given parameters. */
+std::size_t get_num_synthetic_tree_vessels(const SyntheticTreeParameters &parameters);
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_SYNTHETIC_NETWORK_HPP
@@ -0,0 +1,178 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "task_graph.hpp"
+
+#include <stdexcept>
+#include <thread>
+
+#include "thread_pool.hpp"
+
+namespace macrocirculation {
+
+TaskGraph::TaskGraph()
+    : d_num_external(0),
+      d_finalized(false),
+      d_num_remaining(0),
+      d_num_external_remaining(0),
+      d_abort(false) {}
+
+TaskGraph::~TaskGraph() = default;
+
+std::size_t TaskGraph::add_task() {
+  d_is_external.push_back(false);
+  d_finalized = false;
+  return d_is_external.size() - 1;
+}
+
+std::size_t TaskGraph::add_external_task() {
+  d_is_external.push_back(true);
+  d_num_external += 1;
+  d_finalized = false;
+  return d_is_external.size() - 1;
+}
+
+void TaskGraph::add_dependency(std::size_t before, std::size_t after) {
+  if (before >= num_tasks() || after >= num_tasks())
+    throw std::runtime_error("the dependency refers to a task, which does not exist");
+  if (d_is_external[after])
+    throw std::runtime_error("an external task cannot depend on other tasks");
+  d_dependencies.emplace_back(before, after);
+  d_finalized = false;
+}
+
+void TaskGraph::finalize() {
+  const std::size_t n = num_tasks();
+
+  d_successor_offsets.assign(n + 1, 0);
+  d_num_predecessors.assign(n, 0);
+  for (const auto &[before, after] : d_dependencies) {
+    d_successor_offsets[before + 1] += 1;
+    d_num_predecessors[after] += 1;
+  }
+  for (std::size_t k = 0; k < n; k += 1)
+    d_successor_offsets[k + 1] += d_successor_offsets[k];
+
+  d_successors.resize(d_dependencies.size());
+  std::vector<std::size_t> position(d_successor_offsets.begin(), d_successor_offsets.end() - 1);
+  for (const auto &[before, after] : d_dependencies)
+    d_successors[position[before]++] = after;
+
+  d_initial_tasks.clear();
+  for (std::size_t k = 0; k < n; k += 1)
+    if (!d_is_external[k] && d_num_predecessors[k] == 0)
+      d_initial_tasks.push_back(k);
+
+  d_pending = std::make_unique<std::atomic<std::size_t>[]>(n);
+  d_deques.clear();
+  d_finalized = true;
+}
+
+void TaskGraph::run(ThreadPool *pool, const TaskFunction &run_task, const PollFunction &poll) {
+  if (!d_finalized)
+    finalize();
+
+  const std::size_t num_threads = pool ? pool->num_threads() : 1;
+  if (d_deques.size() != num_threads) {
+    d_deques.clear();
+    for (std::size_t k = 0; k < num_threads; k += 1) {
+      d_deques.push_back(std::make_unique<Deque>());
+      d_deques.back()->tasks.resize(num_tasks());
+    }
+  }
+
+  for (std::size_t k = 0; k < num_tasks(); k += 1)
+    d_pending[k].store(d_num_predecessors[k], std::memory_order_relaxed);
+  for (auto &deque : d_deques) {
+    deque->head = 0;
+    deque->size = 0;
+  }
+  for (std::size_t k = 0; k < d_initial_tasks.size(); k += 1)
+    push(k % num_threads, d_initial_tasks[k]);
+  d_num_external_remaining = d_num_external;
+  d_abort.store(false);
+  d_num_remaining.store(num_tasks());
+
+  if (num_tasks() == 0)
+    return;
+
+  // every thread of the pool gets exactly one index, on which it runs its worker loop
+  parallel_for(pool, num_threads, [&](std::size_t thread_id, std::size_t, std::size_t) { work(thread_id, run_task, poll); });
+}
+
+void TaskGraph::complete(std::size_t task) {
+  if (!d_is_external[task])
+    throw std::runtime_error("only external tasks can be completed from the outside");
+  d_num_external_remaining -= 1;
+  release(0, task);
+}
+
+void TaskGraph::push(std::size_t thread_id, std::size_t task) {
+  auto &deque = *d_deques[thread_id];
+  std::lock_guard<std::mutex> lock(deque.mutex);
+  deque.tasks[(deque.head + deque.size) % deque.tasks.size()] = task;
+  deque.size += 1;
+}
+
+bool TaskGraph::pop(std::size_t thread_id, std::size_t &task) {
+  // the newest task of our own deque, whose data is probably still in our cache
+  {
+    auto &deque = *d_deques[thread_id];
+    std::lock_guard<std::mutex> lock(deque.mutex);
+    if (deque.size > 0) {
+      deque.size -= 1;
+      task = deque.tasks[(deque.head + deque.size) % deque.tasks.size()];
+      return true;
+    }
+  }
+
+  // the oldest task of another deque
+  for (std::size_t k = 1; k < d_deques.size(); k += 1) {
+    auto &deque = *d_deques[(thread_id + k) % d_deques.size()];
+    std::lock_guard<std::mutex> lock(deque.mutex);
+    if (deque.size > 0) {
+      task = deque.tasks[deque.head];
+      deque.head = (deque.head + 1) % deque.tasks.size();
+      deque.size -= 1;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void TaskGraph::release(std::size_t thread_id, std::size_t task) {
+  for (std::size_t k = d_successor_offsets[task]; k < d_successor_offsets[task + 1]; k += 1) {
+    const std::size_t successor = d_successors[k];
+    if (d_pending[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+      push(thread_id, successor);
+  }
+  d_num_remaining.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void TaskGraph::work(std::size_t thread_id, const TaskFunction &run_task, const PollFunction &poll) {
+  try {
+    while (d_num_remaining.load(std::memory_order_acquire) > 0 && !d_abort.load(std::memory_order_relaxed)) {
+      // only the calling thread talks to MPI
+      if (thread_id == 0 && d_num_external_remaining > 0)
+        poll(*this);
+
+      std::size_t task = 0;
+      if (pop(thread_id, task)) {
+        run_task(thread_id, task);
+        release(thread_id, task);
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  } catch (...) {
+    d_abort.store(true);
+    throw;
+  }
+}
+
+} // namespace macrocirculation
@@ -0,0 +1,144 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_TASK_GRAPH_HPP
+#define TUMORMODELS_TASK_GRAPH_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace macrocirculation {
+
+// forward declarations
+class ThreadPool;
+
+/*! @brief A fixed set of tasks with dependencies, which are executed on the threads of a pool as soon as all their predecessors are done.
+ *
+ *  The graph is built once and then run many times, e.g. once per stage, without allocating memory.
+ *  Every thread owns a deque of ready tasks: it pushes the successors, which became ready, to its own deque and pops them in the reverse order,
+ *  such that a successor usually runs on the thread which produced its data. Idle threads steal the oldest tasks of the other threads.
+ *
+ *  External tasks are not executed by the workers, but completed by the poll function on the calling thread,
+ *  e.g. when the message of a neighboring rank has arrived. Hence all the MPI calls stay on a single thread.
+ */
+class TaskGraph {
+public:
+  /*! @brief Non-owning reference to a callable, as ThreadPool::ChunkFunction, such that running the graph does not allocate. */
+  template<typename... Args>
+  class FunctionRef {
+  public:
+    template<typename Callable, typename = std::enable_if_t<!std::is_same<std::decay_t<Callable>, FunctionRef>::value>>
+    // NOLINTNEXTLINE(google-explicit-constructor): lambdas are converted implicitly, as for std::function
+    FunctionRef(const Callable &callable)
+        : d_callable(&callable),
+          d_invoke([](const void *c, Args... args) { (*static_cast<const Callable *>(c))(std::forward<Args>(args)...); }) {}
+
+    void operator()(Args... args) const { d_invoke(d_callable, std::forward<Args>(args)...); }
+
+  private:
+    const void *d_callable;
+    void (*d_invoke)(const void *, Args...);
+  };
+
+  /*! @brief Executes a task: the 1st argument is the id of the thread, the 2nd argument the id of the task. */
+  using TaskFunction = FunctionRef<std::size_t, std::size_t>;
+
+  /*! @brief Checks for finished external tasks without blocking and passes each of them to TaskGraph::complete. */
+  using PollFunction = FunctionRef<TaskGraph &>;
+
+  TaskGraph();
+
+  TaskGraph(const TaskGraph &) = delete;
+  TaskGraph &operator=(const TaskGraph &) = delete;
+
+  ~TaskGraph();
+
+  /*! @brief Adds a task, which is executed by the task function, and returns its id. */
+  std::size_t add_task();
+
+  /*! @brief Adds a task, which is completed from the outside by the poll function, and returns its id. */
+  std::size_t add_external_task();
+
+  /*! @brief The task after can only start if the task before is done. */
+  void add_dependency(std::size_t before, std::size_t after);
+
+  /*! @brief Returns the number of tasks including the external ones. */
+  std::size_t num_tasks() const { return d_is_external.size(); }
+
+  /*! @brief Executes all the tasks on the pool, or on the calling thread if there is no pool, and returns if all the tasks are done.
+   *         The calling thread calls the poll function whenever it finishes a task or is idle, until all the external tasks are completed.
+   *         An exception thrown by a task or the poll function stops the workers and is rethrown on the calling thread.
+   */
+  void run(ThreadPool *pool, const TaskFunction &run_task, const PollFunction &poll);
+
+  /*! @brief Marks an external task as done, and may only be called from the poll function. */
+  void complete(std::size_t task);
+
+private:
+  /*! @brief A ring buffer of ready tasks, which is large enough for all the tasks. */
+  struct Deque {
+    std::mutex mutex;
+    std::vector<std::size_t> tasks;
+    std::size_t head{0};
+    std::size_t size{0};
+  };
+
+  std::vector<bool> d_is_external;
+
+  /*! @brief The dependencies as pairs (before, after), which are compressed into d_successors before the first run. */
+  std::vector<std::pair<std::size_t, std::size_t>> d_dependencies;
+
+  /*! @brief The successors of task k are d_successors[d_successor_offsets[k]] until d_successors[d_successor_offsets[k+1]]. */
+  std::vector<std::size_t> d_successor_offsets;
+  std::vector<std::size_t> d_successors;
+
+  /*! @brief The number of predecessors of every task. */
+  std::vector<std::size_t> d_num_predecessors;
+
+  /*! @brief The tasks without predecessors, which are distributed round robin among the threads at the start. */
+  std::vector<std::size_t> d_initial_tasks;
+
+  std::size_t d_num_external;
+
+  /*! @brief True, if the dependencies were compressed after the last change. */
+  bool d_finalized;
+
+  /*! @brief The number of predecessors of every task, which are not done in the current run. */
+  std::unique_ptr<std::atomic<std::size_t>[]> d_pending;
+
+  /*! @brief The number of tasks, which are not done in the current run. */
+  std::atomic<std::size_t> d_num_remaining;
+
+  /*! @brief The number of external tasks, which are not completed in the current run. */
+  std::size_t d_num_external_remaining;
+
+  /*! @brief Set if a task threw, such that the other threads stop. */
+  std::atomic<bool> d_abort;
+
+  std::vector<std::unique_ptr<Deque>> d_deques;
+
+  void finalize();
+
+  void push(std::size_t thread_id, std::size_t task);
+
+  /*! @brief Pops the newest task of our own deque or steals the oldest task of another one. Returns false if all deques are empty. */
+  bool pop(std::size_t thread_id, std::size_t &task);
+
+  /*! @brief Marks the task as done and pushes its successors, which became ready, to the deque of the thread. */
+  void release(std::size_t thread_id, std::size_t task);
+
+  void work(std::size_t thread_id, const TaskFunction &run_task, const PollFunction &poll);
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_TASK_GRAPH_HPP
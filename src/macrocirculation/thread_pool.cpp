@@ -0,0 +1,148 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "thread_pool.hpp"
+
+#include "numa.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace macrocirculation {
+
+ThreadPool::ThreadPool(std::size_t num_threads)
+    : d_num_threads(std::max<std::size_t>(num_threads, 1)),
+      d_stop(false),
+      d_generation(0),
+      d_num_busy(0),
+      d_task(nullptr),
+      d_n(0),
+      d_chunk_offsets(nullptr) {
+  // the calling thread is the thread with id 0
+  for (std::size_t thread_id = 1; thread_id < d_num_threads; thread_id += 1)
+    d_workers.emplace_back([this, thread_id]() { work(thread_id); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(d_mutex);
+    d_stop = true;
+  }
+  d_start_cv.notify_all();
+  for (auto &worker : d_workers)
+    worker.join();
+}
+
+void ThreadPool::parallel_for(std::size_t n, const ChunkFunction &fun) {
+  run(n, nullptr, fun);
+}
+
+void ThreadPool::parallel_for(const std::vector<std::size_t> &chunk_offsets, const ChunkFunction &fun) {
+  if (chunk_offsets.size() != d_num_threads + 1)
+    throw std::runtime_error("the chunk offsets do not fit to the number of threads");
+  run(chunk_offsets.back(), &chunk_offsets, fun);
+}
+
+void ThreadPool::pin_threads(const std::vector<int> &cores) {
+  if (cores.empty())
+    throw std::runtime_error("ThreadPool::pin_threads: no cores given");
+  // every thread gets exactly one index, hence it binds itself
+  parallel_for(d_num_threads, [&cores](std::size_t thread_id, std::size_t, std::size_t) {
+    pin_thread_to_core(cores[thread_id % cores.size()]);
+  });
+}
+
+void ThreadPool::run(std::size_t n, const std::vector<std::size_t> *chunk_offsets, const ChunkFunction &fun) {
+  if (n == 0)
+    return;
+
+  if (d_num_threads == 1) {
+    fun(0, 0, n);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(d_mutex);
+    d_task = &fun;
+    d_n = n;
+    d_chunk_offsets = chunk_offsets;
+    d_exception = nullptr;
+    d_num_busy = d_num_threads - 1;
+    d_generation += 1;
+  }
+  d_start_cv.notify_all();
+
+  run_chunk(0);
+
+  {
+    std::unique_lock<std::mutex> lock(d_mutex);
+    d_done_cv.wait(lock, [this]() { return d_num_busy == 0; });
+    d_task = nullptr;
+    d_chunk_offsets = nullptr;
+  }
+
+  if (d_exception)
+    std::rethrow_exception(d_exception);
+}
+
+void ThreadPool::work(std::size_t thread_id) {
+  std::size_t generation = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(d_mutex);
+      d_start_cv.wait(lock, [this, generation]() { return d_stop || d_generation != generation; });
+      if (d_stop)
+        return;
+      generation = d_generation;
+    }
+
+    run_chunk(thread_id);
+
+    {
+      std::lock_guard<std::mutex> lock(d_mutex);
+      d_num_busy -= 1;
+      if (d_num_busy == 0)
+        d_done_cv.notify_one();
+    }
+  }
+}
+
+void ThreadPool::run_chunk(std::size_t thread_id) {
+  const std::size_t begin = d_chunk_offsets ? (*d_chunk_offsets)[thread_id] : d_n * thread_id / d_num_threads;
+  const std::size_t end = d_chunk_offsets ? (*d_chunk_offsets)[thread_id + 1] : d_n * (thread_id + 1) / d_num_threads;
+
+  if (begin >= end)
+    return;
+
+  try {
+    (*d_task)(thread_id, begin, end);
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(d_mutex);
+    if (!d_exception)
+      d_exception = std::current_exception();
+  }
+}
+
+void parallel_for(ThreadPool *pool, std::size_t n, const ThreadPool::ChunkFunction &fun) {
+  if (pool == nullptr) {
+    if (n > 0)
+      fun(0, 0, n);
+    return;
+  }
+  pool->parallel_for(n, fun);
+}
+
+void parallel_for(ThreadPool *pool, const std::vector<std::size_t> &chunk_offsets, const ThreadPool::ChunkFunction &fun) {
+  if (pool == nullptr) {
+    if (!chunk_offsets.empty() && chunk_offsets.back() > 0)
+      fun(0, 0, chunk_offsets.back());
+    return;
+  }
+  pool->parallel_for(chunk_offsets, fun);
+}
+
+} // namespace macrocirculation
@@ -0,0 +1,121 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_THREAD_POOL_HPP
+#define TUMORMODELS_THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace macrocirculation {
+
+/*! @brief Small pool of persistent worker threads for splitting loops over the edges of a single rank. */
+class ThreadPool {
+public:
+  /*! @brief Function type of a chunk of a parallel loop:
+   *         - the 1st argument is the id of the thread, being in [0, num_threads),
+   *         - the 2nd and 3rd argument are the begin and the end of the index range to process.
+   *
+   *  In contrast to std::function it only refers to the callable without copying it,
+   *  such that passing a lambda with many captures does not allocate memory in every loop.
+   *  Hence, the callable has to outlive the chunk function, as for a temporary lambda passed to parallel_for.
+   */
+  class ChunkFunction {
+  public:
+    template<typename Callable, typename = std::enable_if_t<!std::is_same<std::decay_t<Callable>, ChunkFunction>::value>>
+    // NOLINTNEXTLINE(google-explicit-constructor): lambdas are converted implicitly, as for std::function
+    ChunkFunction(const Callable &callable)
+        : d_callable(&callable),
+          d_invoke([](const void *c, std::size_t thread_id, std::size_t begin, std::size_t end) {
+            (*static_cast<const Callable *>(c))(thread_id, begin, end);
+          }) {}
+
+    void operator()(std::size_t thread_id, std::size_t begin, std::size_t end) const { d_invoke(d_callable, thread_id, begin, end); }
+
+  private:
+    const void *d_callable;
+    void (*d_invoke)(const void *, std::size_t, std::size_t, std::size_t);
+  };
+
+  /*! @brief Creates a pool with the given number of threads, including the calling thread. */
+  explicit ThreadPool(std::size_t num_threads);
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  ~ThreadPool();
+
+  /*! @returns The number of threads, including the calling thread. */
+  std::size_t num_threads() const { return d_num_threads; }
+
+  /*! @brief Splits [0, n) into contiguous chunks, one per thread, and processes them concurrently.
+   *         The calling thread works on the first chunk and returns after all the chunks are done.
+   *         An exception thrown in one of the chunks is rethrown on the calling thread.
+   */
+  void parallel_for(std::size_t n, const ChunkFunction &fun);
+
+  /*! @brief Same as parallel_for, but the k-th thread processes [chunk_offsets[k], chunk_offsets[k+1]).
+   *         Hence chunk_offsets needs num_threads+1 ascending entries, see partition_edges_among_threads.
+   */
+  void parallel_for(const std::vector<std::size_t> &chunk_offsets, const ChunkFunction &fun);
+
+  /*! @brief Binds the k-th thread, including the calling thread as thread 0, to the core cores[k % cores.size()], see pin_thread_to_core.
+   *         Together with first_touch, the threads then stay close to the memory of their chunks.
+   */
+  void pin_threads(const std::vector<int> &cores);
+
+private:
+  std::size_t d_num_threads;
+
+  std::vector<std::thread> d_workers;
+
+  std::mutex d_mutex;
+
+  /*! @brief Wakes up the workers if a new loop is available. */
+  std::condition_variable d_start_cv;
+
+  /*! @brief Notifies the calling thread that all the workers are done. */
+  std::condition_variable d_done_cv;
+
+  bool d_stop;
+
+  /*! @brief Counts the parallel loops, such that the workers can detect new work. */
+  std::size_t d_generation;
+
+  /*! @brief The number of workers still processing the current loop. */
+  std::size_t d_num_busy;
+
+  const ChunkFunction *d_task;
+
+  std::size_t d_n;
+
+  /*! @brief The chunks of the current loop, or nullptr if [0, d_n) is split evenly. */
+  const std::vector<std::size_t> *d_chunk_offsets;
+
+  std::exception_ptr d_exception;
+
+  void work(std::size_t thread_id);
+
+  void run_chunk(std::size_t thread_id);
+
+  void run(std::size_t n, const std::vector<std::size_t> *chunk_offsets, const ChunkFunction &fun);
+};
+
+/*! @brief Runs the loop on the thread pool, or on the calling thread with the thread id 0 if there is no pool. */
+void parallel_for(ThreadPool *pool, std::size_t n, const ThreadPool::ChunkFunction &fun);
+
+/*! @brief Runs the loop over [0, chunk_offsets.back()) with the given chunks on the pool, or on the calling thread if there is no pool. */
+void parallel_for(ThreadPool *pool, const std::vector<std::size_t> &chunk_offsets, const ThreadPool::ChunkFunction &fun);
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_THREAD_POOL_HPP
@@ -6,12 +6,45 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "time_integrators.hpp"
-#include "right_hand_side_evaluator.hpp"
 
-#include "gmm_legacy_facade.hpp"
+#include "numa.hpp"
+#include "phase_timers.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
 
 namespace macrocirculation {
 
+namespace {
+
+/*! @brief Copies the dofs [begin, end) of a stage, which are rounded if the destination has single precision. */
+template<typename T>
+void copy_stage(const std::vector<double> &src, std::vector<T> &dst, std::size_t begin, std::size_t end) {
+  for (std::size_t j = begin; j < end; j += 1)
+    dst[j] = static_cast<T>(src[j]);
+}
+
+/*! @brief Calculates u = u_prev + sum_{j < num_stages} coeffs[j] * k[j] in double precision for the dofs [begin, end). */
+template<typename T>
+void accumulate_stages(const std::vector<double> &u_prev,
+                       const std::vector<std::vector<T>> &k,
+                       const std::vector<double> &coeffs,
+                       std::size_t num_stages,
+                       std::vector<double> &u,
+                       std::size_t begin,
+                       std::size_t end) {
+  for (std::size_t i = begin; i < end; i += 1) {
+    double value = u_prev[i];
+    for (std::size_t j = 0; j < num_stages; j += 1)
+      value += coeffs[j] * static_cast<double>(k[j][i]);
+    u[i] = value;
+  }
+}
+
+} // namespace
+
 ButcherScheme create_explicit_euler() {
   ButcherScheme bs;
   bs.c.push_back(0);
@@ -36,35 +69,327 @@ ButcherScheme create_ssp_method() {
   return bs;
 }
 
-bool check_consistency_rkm(const ButcherScheme &/*bs*/) {
-  throw std::runtime_error("not implemented yet.");
+ShuOsherScheme create_explicit_euler_shu_osher() {
+  ShuOsherScheme so;
+  so.alpha = {0};
+  so.beta = {1};
+  so.delta = {0};
+  so.gamma = {1};
+  so.c = {0};
+  return so;
+}
+
+ShuOsherScheme create_ssp_method_shu_osher() {
+  // the same method as create_ssp_method:
+  //   u^(1) = u + tau L(u),
+  //   u^(2) = 3/4 u + 1/4 u^(1) + 1/4 tau L(u^(1)),
+  //   u_now = 1/3 u + 2/3 u^(2) + 2/3 tau L(u^(2)).
+  ShuOsherScheme so;
+  so.alpha = {0, 3. / 4., 1. / 3.};
+  so.beta = {1, 1. / 4., 2. / 3.};
+  so.delta = {0, 0, 0};
+  so.gamma = {1, 1. / 4., 2. / 3.};
+  so.c = {0, 1, 0.5};
+  return so;
+}
+
+ShuOsherScheme create_ssp_5_3_method_shu_osher() {
+  // see R. J. Spiteri and S. J. Ruuth, A new class of optimal high-order strong-stability-preserving time discretization methods, 2002.
+  ShuOsherScheme so;
+  so.alpha = {0, 0, 0.355909775063327, 0.367933791638137, 0};
+  so.beta = {1, 1, 0.644090224936674, 0.632066208361863, 0.762406163401431};
+  so.delta = {0, 0, 0, 0, 0.237593836598569};
+  so.gamma = {0.377268915331368, 0.377268915331368, 0.242995220537396, 0.238458932846290, 0.287632146308408};
+  so.c = {0, 0.377268915331368, 0.754537830662736, 0.728985661612188, 0.699226135931670};
+  so.saved_stage = 2;
+  // the ssp coefficient is 2.65, but for DG with degree 2 we only observed stable time steps 1.5 times larger than for the 3 stage method
+  so.stable_time_step_factor = 1.4;
+  return so;
+}
+
+ShuOsherScheme create_ssp_10_4_method_shu_osher() {
+  // see D. I. Ketcheson, Highly efficient strong stability-preserving Runge-Kutta methods with low-storage implementations, 2008.
+  // The two register form
+  //   q1 = u + 5 euler steps of size tau/6, q2 = 1/25 u + 9/25 q1, q1 = 15 q2 - 5 q1,
+  //   q1 = q1 + 4 euler steps of size tau/6, u_now = q2 + 3/5 q1 + 1/10 tau L(q1),
+  // is rewritten, such that q2 is expressed through u and the saved stage u^(5).
+  ShuOsherScheme so;
+  so.alpha = {0, 0, 0, 0, 3. / 5., 0, 0, 0, 0, -1. / 2.};
+  so.beta = {1, 1, 1, 1, 2. / 5., 1, 1, 1, 1, 3. / 5.};
+  so.delta = {0, 0, 0, 0, 0, 0, 0, 0, 0, 9. / 10.};
+  so.gamma = {1. / 6., 1. / 6., 1. / 6., 1. / 6., 1. / 15., 1. / 6., 1. / 6., 1. / 6., 1. / 6., 1. / 10.};
+  so.c = {0, 1. / 6., 1. / 3., 1. / 2., 2. / 3., 1. / 3., 1. / 2., 2. / 3., 5. / 6., 1};
+  so.saved_stage = 5;
+  // the ssp coefficient is 6, but for DG with degree 2 we only observed stable time steps 3.5 times larger than for the 3 stage method
+  so.stable_time_step_factor = 3.2;
+  return so;
 }
 
-TimeIntegrator::TimeIntegrator(ButcherScheme bs, std::size_t num_dofs)
+bool check_consistency_rkm(const ButcherScheme &bs) {
+  const double tol = 1e-12;
+  const std::size_t num_stages = bs.b.size();
+
+  if (num_stages == 0 || bs.c.size() != num_stages || bs.a.size() != num_stages * (num_stages - 1) / 2)
+    return false;
+
+  double sum_b = 0;
+  for (auto b : bs.b)
+    sum_b += b;
+  if (std::abs(sum_b - 1) > tol)
+    return false;
+
+  for (std::size_t i = 0; i < num_stages; i += 1) {
+    double row_sum = 0;
+    for (std::size_t j = 0; j < i; j += 1)
+      row_sum += bs.a[i * (i - 1) / 2 + j];
+    if (std::abs(row_sum - bs.c[i]) > tol)
+      return false;
+  }
+
+  return true;
+}
+
+bool check_consistency_rkm(const ShuOsherScheme &so) {
+  const double tol = 1e-12;
+  const std::size_t num_stages = so.c.size();
+
+  if (num_stages == 0 || so.alpha.size() != num_stages || so.beta.size() != num_stages || so.delta.size() != num_stages || so.gamma.size() != num_stages)
+    return false;
+
+  // the time of the stages u^(0), ..., u^(num_stages)
+  std::vector<double> t_stage(num_stages + 1, 0);
+  for (std::size_t i = 0; i < num_stages; i += 1) {
+    // the saved stage has to be calculated before it is used
+    if (so.delta[i] != 0 && so.saved_stage > i)
+      return false;
+    if (std::abs(so.alpha[i] + so.beta[i] + so.delta[i] - 1) > tol)
+      return false;
+    if (std::abs(so.c[i] - t_stage[i]) > tol)
+      return false;
+    const double t_saved = so.delta[i] != 0 ? t_stage[so.saved_stage] : 0;
+    t_stage[i + 1] = so.beta[i] * t_stage[i] + so.delta[i] * t_saved + so.gamma[i];
+  }
+
+  // the last stage is the solution at the next time step
+  return std::abs(t_stage[num_stages] - 1) < tol;
+}
+
+TimeIntegrator::TimeIntegrator(ButcherScheme bs, std::size_t num_dofs, StoragePrecision precision)
     : d_bs(std::move(bs)),
-      d_k(std::vector<std::vector<double>>(d_bs.b.size(), std::vector<double>(num_dofs, 0))),
-      d_tmp(num_dofs, 0) {}
+      d_is_low_storage(false),
+      d_storage_precision(precision),
+      d_num_dofs(num_dofs),
+      d_coeffs(d_bs.b.size(), 0) {
+  allocate_stages();
+}
+
+TimeIntegrator::TimeIntegrator(ShuOsherScheme so, std::size_t num_dofs, StoragePrecision precision)
+    : d_so(std::move(so)),
+      d_is_low_storage(true),
+      d_storage_precision(precision),
+      d_num_dofs(num_dofs) {
+  if (!check_consistency_rkm(d_so))
+    throw std::runtime_error("inconsistent Shu-Osher scheme");
+  allocate_stages();
+}
+
+bool TimeIntegrator::has_saved_stage() const {
+  return std::any_of(d_so.delta.begin(), d_so.delta.end(), [](double d) { return d != 0; });
+}
+
+void TimeIntegrator::allocate_stages() {
+  const bool single = d_storage_precision == StoragePrecision::single_precision;
+
+  // the registers of the other precision are released
+  d_k.clear();
+  d_k_single.clear();
+  d_tmp.clear();
+  d_tmp.shrink_to_fit();
+  d_tmp_single.clear();
+  d_tmp_single.shrink_to_fit();
+
+  if (d_is_low_storage) {
+    d_k.assign(1, std::vector<double>(d_num_dofs, 0));
+    // only schemes with a saved stage need an extra register
+    if (has_saved_stage() && single)
+      d_tmp_single.assign(d_num_dofs, 0);
+    else if (has_saved_stage())
+      d_tmp.assign(d_num_dofs, 0);
+  } else {
+    // in single precision the right-hand side is evaluated into a single double vector, and rounded afterwards
+    d_k.assign(single ? 1 : d_bs.b.size(), std::vector<double>(d_num_dofs, 0));
+    if (single)
+      d_k_single.assign(d_bs.b.size(), std::vector<float>(d_num_dofs, 0));
+    d_tmp.assign(d_num_dofs, 0);
+  }
+
+  if (d_dof_chunk_offsets.empty())
+    return;
+  for (auto &k : d_k)
+    first_touch(d_thread_pool.get(), d_dof_chunk_offsets, k);
+  for (auto &k : d_k_single)
+    first_touch(d_thread_pool.get(), d_dof_chunk_offsets, k);
+  first_touch(d_thread_pool.get(), d_dof_chunk_offsets, d_tmp);
+  first_touch(d_thread_pool.get(), d_dof_chunk_offsets, d_tmp_single);
+}
+
+void TimeIntegrator::resize(std::size_t num_dofs) {
+  d_num_dofs = num_dofs;
+  d_dof_chunk_offsets.clear();
+  allocate_stages();
+}
+
+void TimeIntegrator::set_thread_pool(std::shared_ptr<ThreadPool> pool, std::vector<std::size_t> dof_chunk_offsets) {
+  if (pool != nullptr && (dof_chunk_offsets.size() != pool->num_threads() + 1 || dof_chunk_offsets.back() != d_num_dofs))
+    throw std::runtime_error("TimeIntegrator::set_thread_pool: the dof chunks do not fit to the threads and the dofs");
+  const bool was_threaded = !d_dof_chunk_offsets.empty();
+  d_thread_pool = std::move(pool);
+  d_dof_chunk_offsets = d_thread_pool != nullptr ? std::move(dof_chunk_offsets) : std::vector<std::size_t>();
+  // the stages only hold intermediate values of a step, hence they are simply allocated again
+  if (was_threaded || d_thread_pool != nullptr)
+    allocate_stages();
+}
+
+template<typename Function>
+void TimeIntegrator::for_each_chunk(std::size_t num_dofs, const Function &fun) const {
+  if (d_dof_chunk_offsets.empty() || d_dof_chunk_offsets.back() != num_dofs) {
+    fun(0, num_dofs);
+    return;
+  }
+  parallel_for(d_thread_pool.get(), d_dof_chunk_offsets, [&fun](std::size_t, std::size_t begin, std::size_t end) { fun(begin, end); });
+}
+
+void TimeIntegrator::set_storage_precision(StoragePrecision precision) {
+  d_storage_precision = precision;
+  allocate_stages();
+}
+
+StoragePrecision TimeIntegrator::get_storage_precision() const { return d_storage_precision; }
+
+MemoryReport TimeIntegrator::memory_report() const {
+  MemoryReport report;
+  for (const auto &k : d_k)
+    report.add("stages", k);
+  for (const auto &k : d_k_single)
+    report.add("stages", k);
+  report.add("stages", d_tmp);
+  report.add("stages", d_tmp_single);
+  return report;
+}
+
+double TimeIntegrator::get_stable_time_step_factor() const { return d_is_low_storage ? d_so.stable_time_step_factor : 1.; }
 
 void TimeIntegrator::apply(const std::vector<double> &u_prev,
                            const double t,
                            const double tau,
-                           RightHandSideEvaluator &rhs,
+                           ExplicitRightHandSide &rhs,
                            std::vector<double> &u_now) const {
+  SCOPED_PHASE_TIMER("time integrator");
+  if (d_is_low_storage) {
+    apply_shu_osher(u_prev, t, tau, rhs, u_now);
+    return;
+  }
+
+  const std::size_t num_stages = d_bs.b.size();
+
+  const bool single = d_storage_precision == StoragePrecision::single_precision;
+
   // evaluate ks
-  for (std::size_t i = 0; i < d_bs.b.size(); i += 1) {
+  for (std::size_t i = 0; i < num_stages; i += 1) {
     double t_s = t + tau * d_bs.c[i];
-    d_tmp = u_prev;
-    for (std::size_t j = 0; j < i; j += 1) {
-      const double coeff = tau * d_bs.a.at(i * (i - 1) / 2 + j);
-      gmm::add(d_tmp, gmm::scaled(d_k[j], coeff), d_tmp);
+    auto &k = single ? d_k[0] : d_k[i];
+    if (i == 0) {
+      // the first stage is always evaluated at u_prev, so we do not have to copy it
+      rhs.evaluate(t_s, u_prev, k, 0);
+    } else {
+      // accumulate all the previous stages in a single sweep
+      for (std::size_t j = 0; j < i; j += 1)
+        d_coeffs[j] = tau * d_bs.a.at(i * (i - 1) / 2 + j);
+      accumulate(u_prev, i, d_tmp);
+      rhs.evaluate(t_s, d_tmp, k, 0);
+    }
+    if (single) {
+      d_k_single[i].resize(k.size());
+      for_each_chunk(k.size(), [&](std::size_t begin, std::size_t end) { copy_stage(k, d_k_single[i], begin, end); });
     }
-    rhs.evaluate(t_s, d_tmp, d_k[i]);
   }
   // evaluate bs
-  u_now = u_prev;
-  for (std::size_t i = 0; i < d_bs.b.size(); i += 1) {
-    const double coeff = tau * d_bs.b.at(i);
-    gmm::add(u_now, gmm::scaled(d_k[i], coeff), u_now);
+  for (std::size_t i = 0; i < num_stages; i += 1)
+    d_coeffs[i] = tau * d_bs.b.at(i);
+  accumulate(u_prev, num_stages, u_now);
+}
+
+void TimeIntegrator::accumulate(const std::vector<double> &u_prev, std::size_t num_stages, std::vector<double> &u) const {
+  u.resize(u_prev.size());
+  for_each_chunk(u_prev.size(), [&](std::size_t begin, std::size_t end) {
+    if (d_storage_precision == StoragePrecision::single_precision)
+      accumulate_stages(u_prev, d_k_single, d_coeffs, num_stages, u, begin, end);
+    else
+      accumulate_stages(u_prev, d_k, d_coeffs, num_stages, u, begin, end);
+  });
+}
+
+void TimeIntegrator::apply_shu_osher(const std::vector<double> &u_prev,
+                                     const double t,
+                                     const double tau,
+                                     ExplicitRightHandSide &rhs,
+                                     std::vector<double> &u_now) const {
+  if (d_storage_precision == StoragePrecision::single_precision)
+    apply_shu_osher(u_prev, t, tau, rhs, u_now, d_tmp_single);
+  else
+    apply_shu_osher(u_prev, t, tau, rhs, u_now, d_tmp);
+}
+
+template<typename SavedStage>
+void TimeIntegrator::apply_shu_osher(const std::vector<double> &u_prev,
+                                     const double t,
+                                     const double tau,
+                                     ExplicitRightHandSide &rhs,
+                                     std::vector<double> &u_now,
+                                     SavedStage &u_saved) const {
+  auto &k = d_k[0];
+  const std::size_t num_stages = d_so.c.size();
+  const bool saves_stage = !u_saved.empty();
+
+  u_now.resize(u_prev.size());
+
+  for (std::size_t i = 0; i < num_stages; i += 1) {
+    const double t_s = t + tau * d_so.c[i];
+    const double alpha = d_so.alpha[i];
+    const double beta = d_so.beta[i];
+    const double delta = d_so.delta[i];
+    const double gamma = tau * d_so.gamma[i];
+
+    // every stage is a convex combination of previous stages and an explicit euler step of length gamma / beta
+    const double beta_euler = i == 0 ? alpha + beta : beta;
+    const double tau_euler = beta_euler > 0 ? gamma / beta_euler : 0.;
+
+    if (i == 0) {
+      // the first stage is evaluated at u_prev, which is also the last stage
+      rhs.evaluate(t_s, u_prev, k, tau_euler);
+      for_each_chunk(u_prev.size(), [&](std::size_t begin, std::size_t end) {
+        for (std::size_t j = begin; j < end; j += 1)
+          u_now[j] = (alpha + beta) * u_prev[j] + gamma * k[j];
+      });
+    } else if (delta != 0) {
+      rhs.evaluate(t_s, u_now, k, tau_euler);
+      for_each_chunk(u_prev.size(), [&](std::size_t begin, std::size_t end) {
+        for (std::size_t j = begin; j < end; j += 1)
+          u_now[j] = alpha * u_prev[j] + beta * u_now[j] + delta * static_cast<double>(u_saved[j]) + gamma * k[j];
+      });
+    } else {
+      rhs.evaluate(t_s, u_now, k, tau_euler);
+      for_each_chunk(u_prev.size(), [&](std::size_t begin, std::size_t end) {
+        for (std::size_t j = begin; j < end; j += 1)
+          u_now[j] = alpha * u_prev[j] + beta * u_now[j] + gamma * k[j];
+      });
+    }
+
+    // u_now contains the stage u^(i+1)
+    if (saves_stage && d_so.saved_stage == i + 1) {
+      u_saved.resize(u_now.size());
+      for_each_chunk(u_now.size(), [&](std::size_t begin, std::size_t end) { copy_stage(u_now, u_saved, begin, end); });
+    }
   }
 }
 
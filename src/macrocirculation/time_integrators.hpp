@@ -8,12 +8,29 @@
 #ifndef TUMORMODELS_TIME_INTEGRATORS_H
 #define TUMORMODELS_TIME_INTEGRATORS_H
 
+#include <cstddef>
+#include <memory>
 #include <vector>
 
+#include "memory_report.hpp"
+
 namespace macrocirculation {
 
 // forward declarations:
-class RightHandSideEvaluator;
+class ThreadPool;
+
+/*! @brief Interface for the right-hand sides L(t, u) of the semi-discrete equations du/dt = L(t, u), which the time integrators advance. */
+class ExplicitRightHandSide {
+public:
+  virtual ~ExplicitRightHandSide() = default;
+
+  /*! @brief Evaluates the right-hand side L(t, u_prev) into rhs.
+   *
+   * @param tau_euler If positive, the evaluation is part of an explicit euler step of this length,
+   *                  which allows the right-hand side to treat stiff parts implicitly.
+   */
+  virtual void evaluate(double t, const std::vector<double> &u_prev, std::vector<double> &rhs, double tau_euler) = 0;
+};
 
 struct ButcherScheme {
   /*! @brief The lower diagonal of the A-matrix of the Butcher scheme. */
@@ -24,27 +41,166 @@ struct ButcherScheme {
   std::vector<double> c;
 };
 
+/*! @brief A low-storage explicit scheme in Shu-Osher form, where every stage only depends on the last stage, the initial value
+ *         and optionally a single saved stage u^(s):
+ *              u^(0) = u_prev,
+ *              u^(i+1) = alpha_i u^(0) + beta_i u^(i) + delta_i u^(s) + gamma_i tau L(t + c_i tau, u^(i)),
+ *         and u_now is the last stage. Hence, besides the input and output vector only a single right-hand side
+ *         and, if any delta_i is non-zero, the saved stage have to be stored.
+ */
+struct ShuOsherScheme {
+  /*! @brief The weights of the initial value. */
+  std::vector<double> alpha;
+  /*! @brief The weights of the last stage. */
+  std::vector<double> beta;
+  /*! @brief The weights of the saved stage. */
+  std::vector<double> delta;
+  /*! @brief The weights of the right-hand side evaluated at the last stage. */
+  std::vector<double> gamma;
+  /*! @brief The relative times at which the right-hand sides are evaluated. */
+  std::vector<double> c;
+  /*! @brief The index s of the saved stage u^(s), which is only used if some delta_i is non-zero. */
+  std::size_t saved_stage = 0;
+  /*! @brief The factor by which the stable time step of our DG discretization exceeds the one of the 3rd order ssp method.
+   *         This is given by the linear stability region and not by the SSP coefficient,
+   *         since the DG discretization with degree > 0 is not stable for the explicit euler.
+   */
+  double stable_time_step_factor = 1;
+};
+
 /*! @brief Creates the butcher scheme for the explicit euler. */
 ButcherScheme create_explicit_euler();
 
 /*! @brief Creates the butcher scheme for the 3rd order ssp method. */
 ButcherScheme create_ssp_method();
 
-/*! @brief Checks the consistency of a butcher scheme. */
+/*! @brief Creates the explicit euler in Shu-Osher form. */
+ShuOsherScheme create_explicit_euler_shu_osher();
+
+/*! @brief Creates the 3rd order ssp method in the low-storage Shu-Osher form. */
+ShuOsherScheme create_ssp_method_shu_osher();
+
+/*! @brief Creates the 5-stage 3rd order ssp method of Spiteri and Ruuth with the SSP coefficient 2.65. */
+ShuOsherScheme create_ssp_5_3_method_shu_osher();
+
+/*! @brief Creates the 10-stage 4th order ssp method of Ketcheson with the SSP coefficient 6. */
+ShuOsherScheme create_ssp_10_4_method_shu_osher();
+
+/*! @brief Checks the consistency of a butcher scheme,
+ *         i.e. that the weights b add up to one, and that every c_i is the row sum of the A-matrix.
+ */
 bool check_consistency_rkm(const ButcherScheme &bs);
 
-/*! @brief Class for evaluating butcher schemes on gmm vectors. */
+/*! @brief Checks the consistency of a Shu-Osher scheme,
+ *         i.e. that the weights of the previous stages add up to one in every stage,
+ *         and that the stage times c are the times of the stages.
+ */
+bool check_consistency_rkm(const ShuOsherScheme &so);
+
+/*! @brief The precision in which the time integrators store their stages. */
+enum class StoragePrecision {
+  /*! @brief All the stages are stored in double precision. */
+  double_precision,
+  /*! @brief The stored stages are rounded to float, which halves their memory traffic, while all the arithmetic is done in double.
+   *         The right-hand side is still evaluated into a double vector and at stages in double precision.
+   */
+  single_precision
+};
+
+/*! @brief Class for evaluating butcher schemes or low-storage Shu-Osher schemes on vectors. */
 class TimeIntegrator {
 public:
-  TimeIntegrator(ButcherScheme bs, std::size_t num_dofs);
+  /*! @brief Creates an integrator for a butcher scheme.
+   *         Its stages are no explicit euler steps, hence implicit 0D models are integrated explicitly.
+   */
+  TimeIntegrator(ButcherScheme bs, std::size_t num_dofs, StoragePrecision precision = StoragePrecision::double_precision);
+
+  /*! @brief Creates an integrator for a low-storage scheme, which only stores a single right-hand side. */
+  TimeIntegrator(ShuOsherScheme so, std::size_t num_dofs, StoragePrecision precision = StoragePrecision::double_precision);
+
+  void apply(const std::vector<double> &u_prev, double t, double tau, ExplicitRightHandSide &rhs, std::vector<double> &u_now) const;
+
+  /*! @brief The factor by which the stable time step exceeds the one of the 3rd order ssp method. 1 for the butcher schemes. */
+  double get_stable_time_step_factor() const;
+
+  /*! @brief Resizes the stage storage for the given number of dofs, e.g. after the dof map was rebuilt.
+   *         The vector updates run on the calling thread, until set_thread_pool is called for the new dofs.
+   */
+  void resize(std::size_t num_dofs);
 
-  void apply(const std::vector<double> &u_prev, double t, double tau, RightHandSideEvaluator &rhs, std::vector<double> &u_now) const;
+  /*! @brief Splits the vector updates among the threads of the pool, where the k-th thread updates the dofs in [dof_chunk_offsets[k], dof_chunk_offsets[k+1]).
+   *
+   *  The stages are first touched by the threads of their chunks, such that they reside on their NUMA nodes.
+   *  Hence, the chunks should be the ones the threads write in the right-hand side, see RightHandSideEvaluator::get_dof_chunk_offsets.
+   *  Since every dof is updated by the same operations, the results do not change.
+   */
+  void set_thread_pool(std::shared_ptr<ThreadPool> pool, std::vector<std::size_t> dof_chunk_offsets);
+
+  /*! @brief Changes the precision of the stored stages, whose values are discarded.
+   *
+   *  In single precision the right-hand sides of all the stages of a butcher scheme, and the saved stage of a Shu-Osher scheme are stored as floats.
+   *  Hence, the low-storage schemes without a saved stage, like the 3rd order ssp method, do not change.
+   */
+  void set_storage_precision(StoragePrecision precision);
+
+  StoragePrecision get_storage_precision() const;
+
+  /*! @brief Returns the memory of the stages. */
+  MemoryReport memory_report() const;
 
 private:
   ButcherScheme d_bs;
 
+  ShuOsherScheme d_so;
+
+  /*! @brief True if the Shu-Osher scheme is used instead of the butcher scheme. */
+  bool d_is_low_storage;
+
+  StoragePrecision d_storage_precision;
+
+  std::size_t d_num_dofs;
+
+  std::shared_ptr<ThreadPool> d_thread_pool;
+
+  /*! @brief The dofs of the threads, or empty if the updates run on the calling thread. */
+  std::vector<std::size_t> d_dof_chunk_offsets;
+
+  /*! @brief Calls fun(begin, end) for the chunks of the dofs on the thread pool, or fun(0, num_dofs) if there is none. */
+  template<typename Function>
+  void for_each_chunk(std::size_t num_dofs, const Function &fun) const;
+
+  /*! @brief The right-hand sides of all the stages, or only the last one for the low-storage schemes.
+   *         In single precision this only holds the right-hand side of the current stage.
+   */
   mutable std::vector<std::vector<double>> d_k;
+
+  /*! @brief The right-hand sides of all the stages of a butcher scheme in single precision. */
+  mutable std::vector<std::vector<float>> d_k_single;
+
+  /*! @brief The temporary stage for the butcher schemes, or the saved stage for the Shu-Osher schemes in double precision. */
   mutable std::vector<double> d_tmp;
+
+  /*! @brief The saved stage of the Shu-Osher schemes in single precision. */
+  mutable std::vector<float> d_tmp_single;
+
+  /*! @brief The scaled coefficients of the stages for the current accumulation. */
+  mutable std::vector<double> d_coeffs;
+
+  /*! @brief Calculates u = u_prev + sum_{j < num_stages} d_coeffs[j] * d_k[j] in a single sweep over the dofs. */
+  void accumulate(const std::vector<double> &u_prev, std::size_t num_stages, std::vector<double> &u) const;
+
+  /*! @brief True if the Shu-Osher scheme stores a saved stage. */
+  bool has_saved_stage() const;
+
+  /*! @brief Allocates the stages for d_num_dofs in d_storage_precision. */
+  void allocate_stages();
+
+  /*! @brief Applies the low-storage scheme, which updates u_now in place after every stage. */
+  void apply_shu_osher(const std::vector<double> &u_prev, double t, double tau, ExplicitRightHandSide &rhs, std::vector<double> &u_now) const;
+
+  /*! @brief The stage loop of apply_shu_osher for a saved stage of the given precision. */
+  template<typename SavedStage>
+  void apply_shu_osher(const std::vector<double> &u_prev, double t, double tau, ExplicitRightHandSide &rhs, std::vector<double> &u_now, SavedStage &u_saved) const;
 };
 
 } // namespace macrocirculation
@@ -0,0 +1,76 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "time_step_levels.hpp"
+
+#include "graph_storage.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace macrocirculation {
+
+std::vector<std::size_t> calculate_time_step_levels(const GraphStorage &graph, std::size_t max_level, const std::vector<std::size_t> &edge_degrees) {
+  if (graph.num_edges() == 0)
+    return {};
+  if (graph.is_restricted() && max_level > 0)
+    throw std::runtime_error("calculate_time_step_levels: the levels have to be calculated on the whole graph, before it is restricted to a rank");
+
+  // the stable time step up to the factors, which all the edges share (cfl number, degree)
+  std::vector<double> tau_estimate(graph.num_edges(), std::numeric_limits<double>::infinity());
+  for (auto e_id : graph.get_edge_ids()) {
+    const auto &edge = graph.edge(e_id);
+    if (!edge.has_physical_data())
+      continue;
+    const auto &param = edge.get_physical_data();
+    const auto lengths = edge.get_micro_edge_lengths();
+    tau_estimate[e_id] = *std::min_element(lengths.begin(), lengths.end()) / param.get_c0();
+  }
+
+  // the degree factors are relative to the lowest degree, such that they are exactly one for a uniform degree
+  if (!edge_degrees.empty()) {
+    const auto min_degree = static_cast<double>(*std::min_element(edge_degrees.begin(), edge_degrees.end()));
+    for (auto e_id : graph.get_edge_ids())
+      tau_estimate[e_id] *= (2. * min_degree + 1.) / (2. * static_cast<double>(edge_degrees[e_id]) + 1.);
+  }
+
+  const double tau_min = *std::min_element(tau_estimate.begin(), tau_estimate.end());
+
+  std::vector<std::size_t> levels(graph.num_edges(), 0);
+  for (auto e_id : graph.get_edge_ids()) {
+    if (!std::isfinite(tau_estimate[e_id]))
+      continue;
+    const auto level = static_cast<std::size_t>(std::floor(std::log2(tau_estimate[e_id] / tau_min)));
+    levels[e_id] = std::min(level, max_level);
+  }
+
+  // neighboring edges differ by at most one level, which we enforce by lowering the coarser edges until nothing changes
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto v_id : graph.get_vertex_ids()) {
+      const auto &neighbors = graph.vertex(v_id).get_edge_neighbors();
+      if (neighbors.size() < 2)
+        continue;
+      std::size_t min_level = max_level;
+      for (auto e_id : neighbors)
+        min_level = std::min(min_level, levels[e_id]);
+      for (auto e_id : neighbors) {
+        if (levels[e_id] > min_level + 1) {
+          levels[e_id] = min_level + 1;
+          changed = true;
+        }
+      }
+    }
+  }
+
+  return levels;
+}
+
+} // namespace macrocirculation
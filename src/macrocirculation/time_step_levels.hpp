@@ -0,0 +1,38 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_TIME_STEP_LEVELS_HPP
+#define TUMORMODELS_TIME_STEP_LEVELS_HPP
+
+#include <cstddef>
+#include <vector>
+
+namespace macrocirculation {
+
+// forward declarations
+class GraphStorage;
+
+/*! @brief Assigns every macro edge a time step level l for local time stepping,
+ *         such that the edge can be integrated with the time step 2^l tau,
+ *         where tau is the stable time step of the stiffest edge.
+ *
+ *  The CFL limit of an edge is estimated at rest, i.e. from the ratio of the micro edge length and the wave speed c0.
+ *  The levels of edges meeting at a vertex differ by at most one, and are capped at max_level.
+ *  Since the graph is known on all ranks, all ranks calculate the same levels without any communication.
+ *  Hence the levels of a graph restricted to a rank have to be calculated before the restriction.
+ *
+ * @param graph        The graph with the physical data on all the edges.
+ * @param max_level    The largest allowed level.
+ * @param edge_degrees The degrees of the edges indexed by the edge id, whose CFL limit scales with 1/(2 degree + 1).
+ *                     If empty, all the edges are assumed to have the same degree.
+ * @return             The levels indexed by the edge id.
+ */
+std::vector<std::size_t> calculate_time_step_levels(const GraphStorage &graph, std::size_t max_level, const std::vector<std::size_t> &edge_degrees = {});
+
+} // namespace macrocirculation
+
+#endif
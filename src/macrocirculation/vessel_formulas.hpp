@@ -8,42 +8,61 @@
 #ifndef TUMORMODELS_VESSEL_FORMULAS_HPP
 #define TUMORMODELS_VESSEL_FORMULAS_HPP
 
+#include <algorithm>
+#include <array>
 #include <cmath>
 #include "gmm_legacy_facade.hpp"
+#include <stdexcept>
+#include <string>
+#include <type_traits>
 #include <utility>
+#include <vector>
+
+#include "dual_number.hpp"
 
 namespace macrocirculation {
 
 // forward definitions:
 struct VesselParameters;
 
+/*! @brief The scalar type of the given vessel parameters, which is double or a dual number carrying sensitivities. */
+template<typename PhysicalParameters>
+using scalar_of = std::decay_t<decltype(std::declval<const PhysicalParameters &>().G0)>;
+
 namespace nonlinear {
 template<typename PhysicalParameters = VesselParameters>
-double get_w1_from_QA(double Q, double A, PhysicalParameters &param);
+scalar_of<PhysicalParameters> get_w1_from_QA(scalar_of<PhysicalParameters> Q, scalar_of<PhysicalParameters> A, const PhysicalParameters &param);
 template<typename PhysicalParameters = VesselParameters>
-double get_w2_from_QA(double Q, double A, PhysicalParameters &param);
+scalar_of<PhysicalParameters> get_w2_from_QA(scalar_of<PhysicalParameters> Q, scalar_of<PhysicalParameters> A, const PhysicalParameters &param);
 } // namespace nonlinear
 
 double solve_for_W1(double W1, double W2, double Q_star, double A_0, double c_0);
 double solve_for_W2(double W1, double W2, double Q_star, double A_0, double c_0);
 double calculate_c0(double G0, double rho, double A0);
 
-/*! @brief Saves the material constants on a vessel. */
-struct VesselParameters {
-  VesselParameters() = default;
+/*! @brief Saves the material constants on a vessel, where the scalar type can be a dual number for forward sensitivities. */
+template<typename Scalar>
+struct BasicVesselParameters {
+  BasicVesselParameters() = default;
 
-  VesselParameters(double G0, double A0, double rho)
+  BasicVesselParameters(Scalar G0, Scalar A0, Scalar rho)
       : G0(G0), A0(A0), rho(rho) {}
 
-  double G0{};
-  double A0{};
-  double rho{};
+  Scalar G0{};
+  Scalar A0{};
+  Scalar rho{};
+};
+
+/*! @brief Saves the material constants on a vessel. */
+struct VesselParameters : public BasicVesselParameters<double> {
+  using BasicVesselParameters<double>::BasicVesselParameters;
 };
 
 /*! @brief Calculates c0. */
 template<typename PhysicalParameters = VesselParameters>
-inline double calculate_c0(const PhysicalParameters &param) {
-  return std::sqrt(param.G0 / (2 * param.rho));
+inline scalar_of<PhysicalParameters> calculate_c0(const PhysicalParameters &param) {
+  using std::sqrt;
+  return sqrt(param.G0 / (2 * param.rho));
 }
 
 /*! @brief Formulas especially for the nonlinear flow model. */
@@ -61,47 +80,119 @@ inline double get_A_from_p(double p, double G0, double A0) {
 
 /*! @brief Converts the vessel area A to the static pressure p. */
 template<typename PhysicalParameters = VesselParameters>
-inline double get_p_from_A(const PhysicalParameters &param, double A) {
-  return get_p_from_A(A, param.G0, param.A0);
+inline scalar_of<PhysicalParameters> get_p_from_A(const PhysicalParameters &param, scalar_of<PhysicalParameters> A) {
+  using std::sqrt;
+  return param.G0 * (sqrt(A / param.A0) - 1);
 }
 
 /*! @brief Converts the static pressure p to the vessel area A. */
 template<typename PhysicalParameters = VesselParameters>
-inline double get_A_from_p(const PhysicalParameters &param, double p) {
-  return get_A_from_p(p, param.G0, param.A0);
+inline scalar_of<PhysicalParameters> get_A_from_p(const PhysicalParameters &param, scalar_of<PhysicalParameters> p) {
+  using std::pow;
+  return param.A0 * pow(p / param.G0 + 1, 2);
 }
 
 /*! @brief Calculates the flow Q from the characteristics. */
 template<typename PhysicalParameters = VesselParameters>
-inline double get_Q_from_w1w2(double w1, double w2, const PhysicalParameters &param) {
-  const double c0 = calculate_c0(param);
-  return 0.5 * (w2 - w1) * std::pow((w1 + w2) / (8 * c0), 4) * param.A0;
+inline scalar_of<PhysicalParameters> get_Q_from_w1w2(scalar_of<PhysicalParameters> w1, scalar_of<PhysicalParameters> w2, const PhysicalParameters &param) {
+  using std::pow;
+  const auto c0 = calculate_c0(param);
+  return 0.5 * (w2 - w1) * pow((w1 + w2) / (8 * c0), 4) * param.A0;
 }
 
 /*! @brief Calculates the total pressure from the characteristics. */
 template<typename PhysicalParameters = VesselParameters>
-inline double get_p_from_w1w2(double w1, double w2, const PhysicalParameters &param) {
-  const double c0 = calculate_c0(param);
-  return 0.5 * param.rho * std::pow(0.5 * (w2 - w1), 2) + param.G0 * (std::pow((w1 + w2) / (8 * c0), 2) - 1);
+inline scalar_of<PhysicalParameters> get_p_from_w1w2(scalar_of<PhysicalParameters> w1, scalar_of<PhysicalParameters> w2, const PhysicalParameters &param) {
+  using std::pow;
+  const auto c0 = calculate_c0(param);
+  return 0.5 * param.rho * pow(0.5 * (w2 - w1), 2) + param.G0 * (pow((w1 + w2) / (8 * c0), 2) - 1);
 }
 
 /*! @brief Evaluates the back propagating wave from Q and A. */
-template<typename PhysicalParameters = VesselParameters>
-inline double get_w1_from_QA(const double Q, const double A, const PhysicalParameters &param) {
-  return -Q / A + 4 * std::sqrt(param.G0 / (2 * param.rho)) * std::pow(A / param.A0, 1. / 4.);
+template<typename PhysicalParameters>
+inline scalar_of<PhysicalParameters> get_w1_from_QA(const scalar_of<PhysicalParameters> Q, const scalar_of<PhysicalParameters> A, const PhysicalParameters &param) {
+  using std::pow;
+  using std::sqrt;
+  return -Q / A + 4 * sqrt(param.G0 / (2 * param.rho)) * pow(A / param.A0, 1. / 4.);
 }
 
 /*! @brief Evaluates the forward propagating wave from Q and A. */
-template<typename PhysicalParameters = VesselParameters>
-inline double get_w2_from_QA(double Q, double A, const PhysicalParameters &param) {
-  return +Q / A + 4 * std::sqrt(param.G0 / (2 * param.rho)) * std::pow(A / param.A0, 1. / 4.);
+template<typename PhysicalParameters>
+inline scalar_of<PhysicalParameters> get_w2_from_QA(scalar_of<PhysicalParameters> Q, scalar_of<PhysicalParameters> A, const PhysicalParameters &param) {
+  using std::pow;
+  using std::sqrt;
+  return +Q / A + 4 * sqrt(param.G0 / (2 * param.rho)) * pow(A / param.A0, 1. / 4.);
 }
 
 template<typename PhysicalParameters = VesselParameters>
-inline double get_p_from_QA(double Q, double A, const PhysicalParameters &param) {
-  return 0.5 * param.rho * std::pow(Q / A, 2) + param.G0 * (std::sqrt(A / param.A0) - 1);
+inline scalar_of<PhysicalParameters> get_p_from_QA(scalar_of<PhysicalParameters> Q, scalar_of<PhysicalParameters> A, const PhysicalParameters &param) {
+  using std::pow;
+  using std::sqrt;
+  return 0.5 * param.rho * pow(Q / A, 2) + param.G0 * (sqrt(A / param.A0) - 1);
+}
+
+/*! @brief Formulas for arrays of states on a single vessel, e.g. at all the micro vertices of an edge.
+ *         The powers are written as chains of square roots and products instead of std::pow, such that the loops vectorize,
+ *         which changes the results in the last bits compared to the scalar formulas above.
+ *         If the given relative tolerance is at least fast_tolerance, the fourth roots of A/A0 are evaluated in single precision.
+ */
+namespace batch {
+
+/*! @brief The smallest relative tolerance, for which the roots are evaluated in single precision, whose error is about 1e-7. */
+constexpr double fast_tolerance = 1e-6;
+
+namespace detail {
+
+/*! @brief Evaluates w = sgn Q/A + 4 c0 (A/A0)^{1/4}, which is w1 for sgn = -1 and w2 for sgn = +1. */
+template<typename PhysicalParameters>
+inline void get_w_from_QA(double sgn, std::size_t n, const double *Q, const double *A, const PhysicalParameters &param, double *w, double tolerance) {
+  const double four_c0 = 4 * calculate_c0(param);
+  const double inv_A0 = 1. / param.A0;
+  if (tolerance >= fast_tolerance) {
+    for (std::size_t k = 0; k < n; k += 1)
+      w[k] = sgn * Q[k] / A[k] + four_c0 * static_cast<double>(std::sqrt(std::sqrt(static_cast<float>(A[k] * inv_A0))));
+  } else {
+    for (std::size_t k = 0; k < n; k += 1)
+      w[k] = sgn * Q[k] / A[k] + four_c0 * std::sqrt(std::sqrt(A[k] * inv_A0));
+  }
+}
+
+} // namespace detail
+
+/*! @brief Evaluates the back propagating waves from n values of Q and A. */
+template<typename PhysicalParameters>
+inline void get_w1_from_QA(std::size_t n, const double *Q, const double *A, const PhysicalParameters &param, double *w1, double tolerance = 0) {
+  detail::get_w_from_QA(-1., n, Q, A, param, w1, tolerance);
+}
+
+/*! @brief Evaluates the forward propagating waves from n values of Q and A. */
+template<typename PhysicalParameters>
+inline void get_w2_from_QA(std::size_t n, const double *Q, const double *A, const PhysicalParameters &param, double *w2, double tolerance = 0) {
+  detail::get_w_from_QA(+1., n, Q, A, param, w2, tolerance);
+}
+
+/*! @brief Converts n vessel areas to static pressures. */
+template<typename PhysicalParameters>
+inline void get_p_from_A(std::size_t n, const double *A, const PhysicalParameters &param, double *p) {
+  const double inv_A0 = 1. / param.A0;
+  for (std::size_t k = 0; k < n; k += 1)
+    p[k] = param.G0 * (std::sqrt(A[k] * inv_A0) - 1);
+}
+
+/*! @brief Calculates the upwinded values from n pairs of characteristics, see the scalar solve_W12. */
+template<typename PhysicalParameters>
+inline void solve_W12(std::size_t n, const double *W1, const double *W2, const PhysicalParameters &param, double *Q_up, double *A_up) {
+  const double scale = 1. / 8. * std::sqrt(2. * param.rho / param.G0);
+  for (std::size_t k = 0; k < n; k += 1) {
+    const double in = scale * (W2[k] + W1[k]);
+    const double in_squared = in * in;
+    A_up[k] = param.A0 * (in_squared * in_squared);
+    Q_up[k] = A_up[k] / 2. * (W2[k] - W1[k]);
+  }
 }
 
+} // namespace batch
+
 namespace inflow {
 
 /*! @brief Assembles the inflow boundary condition.
@@ -155,20 +246,21 @@ namespace linear {
 
 /*! @brief Gets the inductivity of the linearized flow model. */
 template<typename PhysicalParameters>
-inline double get_L(const PhysicalParameters &param) {
+inline scalar_of<PhysicalParameters> get_L(const PhysicalParameters &param) {
   return param.rho / param.A0;
 }
 
 /*! @brief Gets the capacitance of the linearized flow model. */
 template<typename PhysicalParameters>
-inline double get_C(const PhysicalParameters &param) {
-  const double c0 = calculate_c0(param);
-  return param.A0 / (param.rho * std::pow(c0, 2));
+inline scalar_of<PhysicalParameters> get_C(const PhysicalParameters &param) {
+  using std::pow;
+  const auto c0 = calculate_c0(param);
+  return param.A0 / (param.rho * pow(c0, 2));
 }
 
 /*! @brief Gets the resistance of the linearized flow model. */
 template<typename PhysicalParameters>
-inline double get_R(const PhysicalParameters &param) {
+inline scalar_of<PhysicalParameters> get_R(const PhysicalParameters &param) {
   return 2 * (param.gamma + 2) * M_PI * param.viscosity / param.A0;
 }
 
@@ -181,10 +273,12 @@ inline double get_R(const PhysicalParameters &param) {
  * @param A0 The vessel area at p=0.
  * @return
  */
-inline double calculate_G0(double h0, double E, double A0) {
+template<typename Scalar>
+inline Scalar calculate_G0(Scalar h0, Scalar E, Scalar A0) {
+  using std::sqrt;
   // the poisson ratio:
   const double nu = 0.5;
-  return std::sqrt(M_PI) * h0 * E / ((1 - nu * nu) * std::sqrt(A0));
+  return std::sqrt(M_PI) * h0 * E / ((1 - nu * nu) * sqrt(A0));
 }
 
 /*! @brief Calculates c0. */
@@ -193,35 +287,49 @@ inline double calculate_c0(double G0, double rho, double /* A0 */) {
 }
 
 /*! @brief Calculates the derivative of Q w.r.t. w1, the back propagating characteristic. */
-inline double calculate_diff_Q_w1(double w1, double w2, double G0, double rho, double A0) {
-  const double c0 = calculate_c0(G0, rho, A0);
-  return -0.5 * std::pow((w1 + w2) / (8 * c0), 4) * A0 +
-         2 * A0 * (w2 - w1) * std::pow(w2 + w1, 3) / std::pow(8 * c0, 4);
+template<typename Scalar>
+inline Scalar calculate_diff_Q_w1(Scalar w1, Scalar w2, Scalar G0, Scalar rho, Scalar A0) {
+  using std::pow;
+  using std::sqrt;
+  const Scalar c0 = sqrt(G0 / (2 * rho));
+  return -0.5 * pow((w1 + w2) / (8 * c0), 4) * A0 +
+         2 * A0 * (w2 - w1) * pow(w2 + w1, 3) / pow(8 * c0, 4);
 }
 
 /*! @brief Calculates the derivative of Q w.r.t. w2, the forward propagating characteristic. */
-inline double calculate_diff_Q_w2(double w1, double w2, double G0, double rho, double A0) {
-  const double c0 = calculate_c0(G0, rho, A0);
-  return +0.5 * std::pow((w1 + w2) / (8 * c0), 4) * A0 +
-         2 * A0 * (w2 - w1) * std::pow(w2 + w1, 3) / std::pow(8 * c0, 4);
+template<typename Scalar>
+inline Scalar calculate_diff_Q_w2(Scalar w1, Scalar w2, Scalar G0, Scalar rho, Scalar A0) {
+  using std::pow;
+  using std::sqrt;
+  const Scalar c0 = sqrt(G0 / (2 * rho));
+  return +0.5 * pow((w1 + w2) / (8 * c0), 4) * A0 +
+         2 * A0 * (w2 - w1) * pow(w2 + w1, 3) / pow(8 * c0, 4);
 }
 
 /*! @brief Derivative of the total pressure with respect to the backward characteristic. */
-inline double calculate_diff_p_w1(double w1, double w2, double G0, double rho, double A0) {
-  const double c0 = calculate_c0(G0, rho, A0);
-  return -0.25 * rho * (w2 - w1) + 2 * G0 * (w1 + w2) / std::pow((8 * c0), 2);
+template<typename Scalar>
+inline Scalar calculate_diff_p_w1(Scalar w1, Scalar w2, Scalar G0, Scalar rho, Scalar /* A0 */) {
+  using std::pow;
+  using std::sqrt;
+  const Scalar c0 = sqrt(G0 / (2 * rho));
+  return -0.25 * rho * (w2 - w1) + 2 * G0 * (w1 + w2) / pow((8 * c0), 2);
 }
 
 /*! @brief Derivative of the total pressure with respect to the forward characteristic. */
-inline double calculate_diff_p_w2(double w1, double w2, double G0, double rho, double A0) {
-  const double c0 = calculate_c0(G0, rho, A0);
-  return +0.25 * rho * (w2 - w1) + 2 * G0 * (w1 + w2) / std::pow((8 * c0), 2);
+template<typename Scalar>
+inline Scalar calculate_diff_p_w2(Scalar w1, Scalar w2, Scalar G0, Scalar rho, Scalar /* A0 */) {
+  using std::pow;
+  using std::sqrt;
+  const Scalar c0 = sqrt(G0 / (2 * rho));
+  return +0.25 * rho * (w2 - w1) + 2 * G0 * (w1 + w2) / pow((8 * c0), 2);
 }
 
 /*! @brief Convertes the characteristic variables to flow Q and area A. */
-inline void convert_w1w2_to_QA(double w1, double w2, const VesselParameters &p, double &Q, double &A) {
-  const double c0 = calculate_c0(p.G0, p.rho, p.A0);
-  A = std::pow((w1 + w2) / (8 * c0), 4) * p.A0;
+template<typename PhysicalParameters>
+inline void convert_w1w2_to_QA(scalar_of<PhysicalParameters> w1, scalar_of<PhysicalParameters> w2, const PhysicalParameters &p, scalar_of<PhysicalParameters> &Q, scalar_of<PhysicalParameters> &A) {
+  using std::pow;
+  const auto c0 = calculate_c0(p);
+  A = pow((w1 + w2) / (8 * c0), 4) * p.A0;
   Q = 0.5 * (w2 - w1) * A;
 }
 
@@ -230,10 +338,13 @@ inline void convert_w1w2_to_QA(double w1, double w2, const VesselParameters &p,
  *           W2(Q_up, A_up) = W2
  *         for (Q_up, Q_up) at some inner vertex between to vessel segments.
  */
+template<typename Scalar>
 inline void
-solve_W12(double &Q_up, double &A_up, const double W1, const double W2, const double G0, const double rho, const double A0) {
-  const double in = 1. / 8. * std::sqrt(2. * rho / G0) * (W2 + W1);
-  A_up = A0 * std::pow(in, 4);
+solve_W12(Scalar &Q_up, Scalar &A_up, const Scalar W1, const Scalar W2, const Scalar G0, const Scalar rho, const Scalar A0) {
+  using std::pow;
+  using std::sqrt;
+  const Scalar in = 1. / 8. * sqrt(2. * rho / G0) * (W2 + W1);
+  A_up = A0 * pow(in, 4);
   Q_up = A_up / 2. * (W2 - W1);
 }
 
@@ -243,6 +354,8 @@ solve_W12(double &Q_up, double &A_up, const double W1, const double W2, const do
  * @param t Current time.
  * @return The current flow rate.
  */
+class tabulated_periodic_function;
+
 class heart_beat_inflow {
 public:
   explicit heart_beat_inflow(double amplitude = 4.85, double t_period = 1.0, double t_systole = 0.3)
@@ -251,7 +364,7 @@ public:
         d_t_systole(t_systole) {}
 
   double operator()(double t) const {
-    const double t_in_period = t - std::floor(t / d_t_period);
+    const double t_in_period = t - d_t_period * std::floor(t / d_t_period);
     if (t_in_period < d_t_systole) {
       return d_amplitude * std::sin(M_PI * t_in_period / d_t_systole);
     } else if (t_in_period <= d_t_period + 1e-14) {
@@ -261,12 +374,54 @@ public:
     }
   }
 
+  /*! @brief The length of a single heart beat. */
+  double get_period() const { return d_t_period; }
+
+  /*! @brief Samples a single heart beat at num_intervals + 1 equidistant points,
+   *         which are interpolated linearly without evaluating the sine or branching on the systole.
+   */
+  tabulated_periodic_function tabulate(std::size_t num_intervals) const;
+
 private:
   double d_amplitude;
   double d_t_period;
   double d_t_systole;
 };
 
+/*! @brief A periodic function given by its values on a uniform grid of a single period, which is interpolated linearly. */
+class tabulated_periodic_function {
+public:
+  template<typename Function>
+  tabulated_periodic_function(const Function &f, double t_period, std::size_t num_intervals)
+      : d_t_period(t_period),
+        d_inv_h(static_cast<double>(num_intervals) / t_period),
+        d_values(num_intervals + 1) {
+    if (num_intervals == 0)
+      throw std::runtime_error("tabulated_periodic_function needs at least one interval");
+    for (std::size_t k = 0; k <= num_intervals; k += 1)
+      d_values[k] = f(t_period * static_cast<double>(k) / static_cast<double>(num_intervals));
+  }
+
+  double operator()(double t) const {
+    const double s = (t - d_t_period * std::floor(t / d_t_period)) * d_inv_h;
+    // s can round up to the number of intervals at the end of the period
+    const std::size_t idx = std::min(static_cast<std::size_t>(s), d_values.size() - 2);
+    const double theta = s - static_cast<double>(idx);
+    return d_values[idx] * (1 - theta) + d_values[idx + 1] * theta;
+  }
+
+  double get_period() const { return d_t_period; }
+
+private:
+  double d_t_period;
+  double d_inv_h;
+  std::vector<double> d_values;
+};
+
+inline tabulated_periodic_function heart_beat_inflow::tabulate(std::size_t num_intervals) const {
+  return {*this, d_t_period, num_intervals};
+}
+
 class smoothed_constant_concentration {
 public:
   explicit smoothed_constant_concentration(double delta = 0.05)
@@ -292,13 +447,19 @@ inline double value_in_period(double t, double t_start, double t_end)
 class piecewise_linear_source_function {
 public:
   piecewise_linear_source_function(std::vector<double> t_list, std::vector<double> value_list, bool periodic=false)
-      : d_t_list(std::move(t_list)), d_value_list(std::move(value_list)), d_periodic(periodic) {
+      : d_t_list(std::move(t_list)), d_value_list(std::move(value_list)), d_periodic(periodic), d_last_idx(0) {
     if (!std::is_sorted(d_t_list.begin(), d_t_list.end()))
       throw std::runtime_error("piecewise_linear_source_function only accepts sorted time arrays");
     if (d_t_list.size() != d_value_list.size())
       throw std::runtime_error("both lists to piecewise_linear_source_function must have the same size");
+    if (d_t_list.size() < 2)
+      throw std::runtime_error("piecewise_linear_source_function needs at least two time value pairs");
   }
 
+  /*! @brief Evaluates the function at t.
+   *         The interval of the previous call serves as a hint, such that advancing monotonically in time needs no search.
+   *         Hence, a single instance must not be evaluated by several threads at once.
+   */
   double operator()(double t) const {
     if (d_periodic)
       t = value_in_period(t, d_t_list.front(), d_t_list.back());
@@ -307,30 +468,52 @@ public:
     const auto idx = get_lower_bound(t);
 
     // if we are the last element:
-    if (idx == d_t_list.size() - 1 && std::abs(d_t_list.back() - t) < 1e-12)
+    if (t >= d_t_list.back())
       return d_value_list.back();
 
-    const double t_next = d_t_list.at(idx + 1);
-    const double t_prev = d_t_list.at(idx);
+    const double t_next = d_t_list[idx + 1];
+    const double t_prev = d_t_list[idx];
     const double tau = t_next - t_prev;
     const double theta = (t - t_prev) / tau;
 
-    return d_value_list.at(idx) * (1 - theta) + d_value_list.at(idx + 1) * theta;
+    return d_value_list[idx] * (1 - theta) + d_value_list[idx + 1] * theta;
   }
 
+  /*! @brief The length of the time interval, which is repeated for periodic source functions. */
+  double get_period() const { return d_t_list.back() - d_t_list.front(); }
+
+  bool is_periodic() const { return d_periodic; }
+
 private:
+  /*! @brief Returns the index k of the interval with t_k <= t < t_{k+1}, where t may exceed the list by 1e-8. */
   size_t get_lower_bound(double t) const {
-    for (size_t k = 0; k < d_t_list.size()-1; k += 1)
-    {
-      if ( d_t_list[k]-1e-8 <= t && t <= d_t_list[k+1] + 1e-8 )
-        return k;
-    }
-    throw std::runtime_error(std::to_string(t) + " could not be found in list [" + std::to_string(d_t_list.front()) + ", " + std::to_string(d_t_list.back()) + "]");
+    if (t < d_t_list.front() - 1e-8 || t > d_t_list.back() + 1e-8)
+      throw std::runtime_error(std::to_string(t) + " could not be found in list [" + std::to_string(d_t_list.front()) + ", " + std::to_string(d_t_list.back()) + "]");
+
+    const auto contains = [this, t](size_t k) { return d_t_list[k] <= t && t < d_t_list[k + 1]; };
+
+    // the same or the next interval as in the previous call, or the first one after a periodic wrap-around
+    const size_t last = d_t_list.size() - 2;
+    if (contains(d_last_idx))
+      return d_last_idx;
+    if (d_last_idx < last && contains(d_last_idx + 1))
+      return ++d_last_idx;
+    if (contains(0))
+      return d_last_idx = 0;
+
+    // binary search, where the values outside of the list are clamped to the first or last interval
+    const auto it = std::upper_bound(d_t_list.begin(), d_t_list.end(), t);
+    const auto idx = static_cast<size_t>(std::max<std::ptrdiff_t>(it - d_t_list.begin() - 1, 0));
+    d_last_idx = std::min(idx, last);
+    return d_last_idx;
   }
 
   std::vector<double> d_t_list;
   std::vector<double> d_value_list;
   bool d_periodic;
+
+  /*! @brief The interval of the previous evaluation. */
+  mutable size_t d_last_idx;
 };
 
 /*! @brief Solves for the forward propagating characteristic W2, given the
@@ -533,10 +716,161 @@ inline void fill_vector(const std::vector<double> &w1,
   }
 }
 
+/*! @brief The maximum number of newton iterations at an nfurcation. */
+constexpr std::size_t nfurcation_max_iterations = 1000;
+
+namespace detail {
+
+/*! @brief Up to this number of vessels the newton iteration at an nfurcation works on fixed size arrays. */
+constexpr std::size_t nfurcation_max_fixed_size = 4;
+
+/*! @brief Temporary storage for the newton iteration at an nfurcation. */
+template<typename Vector>
+struct NFurcationWorkspace {
+  Vector w1;
+  Vector w2;
+  Vector x;
+  Vector f;
+  Vector delta_x;
+  /*! @brief The first row of the jacobian. */
+  Vector J_row;
+  /*! @brief The diagonal of the jacobian. */
+  Vector J_diag;
+};
+
+/*! @brief Newton iteration for the nfurcation equations on the given workspace.
+ *         The jacobian has an arrow structure (see nfurcation_equation_jacobian),
+ *         with a dense first row, a constant first column and a diagonal,
+ *         hence the linear systems are solved by elimination in O(n) without assembling a matrix.
+ *         If warm_start is true, the unknown characteristics are initialized from Q_up and A_up.
+ *         The stopping criterion only uses the values, hence for dual numbers the sensitivities
+ *         are differentiated through the iteration, which yields the sensitivities of the converged solution.
+ */
+template<typename Vector, typename PhysicalParameters, typename Values, typename Parameters, typename Flags, typename UpValues>
+inline std::size_t solve_at_nfurcation_newton(std::size_t num_vessels,
+                                              const Values &Q,
+                                              const Values &A,
+                                              const Parameters &p,
+                                              const Flags &in,
+                                              UpValues &Q_up,
+                                              UpValues &A_up,
+                                              bool warm_start,
+                                              double *residual,
+                                              NFurcationWorkspace<Vector> &ws) {
+  using Scalar = scalar_of<PhysicalParameters>;
+
+  const std::size_t max_iter = nfurcation_max_iterations;
+
+  auto &w1 = ws.w1;
+  auto &w2 = ws.w2;
+  auto &x = ws.x;
+  auto &f = ws.f;
+  auto &delta_x = ws.delta_x;
+  auto &J_row = ws.J_row;
+  auto &J_diag = ws.J_diag;
+
+  // calculate w1, w2 at all the bifurcations
+  for (size_t vessel_idx = 0; vessel_idx < num_vessels; vessel_idx += 1) {
+    w1[vessel_idx] = nonlinear::get_w1_from_QA(Q[vessel_idx], A[vessel_idx], p[vessel_idx]);
+    w2[vessel_idx] = nonlinear::get_w2_from_QA(Q[vessel_idx], A[vessel_idx], p[vessel_idx]);
+  }
+
+  // the unknowns are w1 for vessels pointing to the vertex and w2 otherwise
+  for (size_t vessel_idx = 0; vessel_idx < num_vessels; vessel_idx += 1)
+    x[vessel_idx] = in[vessel_idx] ? w1[vessel_idx] : w2[vessel_idx];
+
+  // start with the unknown characteristics of the previous solution
+  if (warm_start) {
+    for (size_t vessel_idx = 0; vessel_idx < num_vessels; vessel_idx += 1) {
+      if (in[vessel_idx])
+        x[vessel_idx] = w1[vessel_idx] = nonlinear::get_w1_from_QA(Q_up[vessel_idx], A_up[vessel_idx], p[vessel_idx]);
+      else
+        x[vessel_idx] = w2[vessel_idx] = nonlinear::get_w2_from_QA(Q_up[vessel_idx], A_up[vessel_idx], p[vessel_idx]);
+    }
+  }
+
+  std::size_t it = 0;
+  for (; it < max_iter; it += 1) {
+    // jacobian, line 0, Q derivative:
+    for (size_t vessel_idx = 0; vessel_idx < num_vessels; vessel_idx += 1) {
+      if (in[vessel_idx])
+        J_row[vessel_idx] = -calculate_diff_Q_w1(w1[vessel_idx], w2[vessel_idx], p[vessel_idx].G0, p[vessel_idx].rho, p[vessel_idx].A0);
+      else
+        J_row[vessel_idx] = +calculate_diff_Q_w2(w1[vessel_idx], w2[vessel_idx], p[vessel_idx].G0, p[vessel_idx].rho, p[vessel_idx].A0);
+    }
+
+    // jacobian, line 1-(n-1), pressure derivatives:
+    const Scalar J_col = in[0] ? +calculate_diff_p_w1(w1[0], w2[0], p[0].G0, p[0].rho, p[0].A0)
+                               : +calculate_diff_p_w2(w1[0], w2[0], p[0].G0, p[0].rho, p[0].A0);
+    for (size_t vessel_idx = 1; vessel_idx < num_vessels; vessel_idx += 1) {
+      if (in[vessel_idx])
+        J_diag[vessel_idx] = -calculate_diff_p_w1(w1[vessel_idx], w2[vessel_idx], p[vessel_idx].G0, p[vessel_idx].rho, p[vessel_idx].A0);
+      else
+        J_diag[vessel_idx] = -calculate_diff_p_w2(w1[vessel_idx], w2[vessel_idx], p[vessel_idx].G0, p[vessel_idx].rho, p[vessel_idx].A0);
+    }
+
+    // flow equation (all flows add up to zero):
+    Scalar eq_Q = 0;
+    for (size_t vessel_idx = 0; vessel_idx < num_vessels; vessel_idx += 1)
+      eq_Q += (in[vessel_idx] ? -1 : +1) * nonlinear::get_Q_from_w1w2(w1[vessel_idx], w2[vessel_idx], p[vessel_idx]);
+    f[0] = eq_Q;
+
+    // pressure equation (all pressures are equal):
+    const Scalar p_0 = nonlinear::get_p_from_w1w2(w1[0], w2[0], p[0]);
+    for (size_t vessel_idx = 1; vessel_idx < num_vessels; vessel_idx += 1)
+      f[vessel_idx] = p_0 - nonlinear::get_p_from_w1w2(w1[vessel_idx], w2[vessel_idx], p[vessel_idx]);
+
+    if (residual != nullptr) {
+      *residual = 0;
+      for (size_t vessel_idx = 0; vessel_idx < num_vessels; vessel_idx += 1)
+        *residual = std::max(*residual, std::abs(value_of(f[vessel_idx])));
+    }
+
+    // eliminate the pressure equations from the flow equation
+    Scalar rhs_0 = f[0];
+    Scalar diag_0 = J_row[0];
+    for (size_t vessel_idx = 1; vessel_idx < num_vessels; vessel_idx += 1) {
+      rhs_0 -= J_row[vessel_idx] * f[vessel_idx] / J_diag[vessel_idx];
+      diag_0 -= J_row[vessel_idx] * J_col / J_diag[vessel_idx];
+    }
+    delta_x[0] = rhs_0 / diag_0;
+    for (size_t vessel_idx = 1; vessel_idx < num_vessels; vessel_idx += 1)
+      delta_x[vessel_idx] = (f[vessel_idx] - J_col * delta_x[0]) / J_diag[vessel_idx];
+
+    double norm_delta_x = 0;
+    double norm_x = 0;
+    for (size_t vessel_idx = 0; vessel_idx < num_vessels; vessel_idx += 1) {
+      x[vessel_idx] -= delta_x[vessel_idx];
+      if (in[vessel_idx])
+        w1[vessel_idx] = x[vessel_idx];
+      else
+        w2[vessel_idx] = x[vessel_idx];
+      norm_delta_x += value_of(delta_x[vessel_idx]) * value_of(delta_x[vessel_idx]);
+      norm_x += value_of(x[vessel_idx]) * value_of(x[vessel_idx]);
+    }
+    norm_delta_x = std::sqrt(norm_delta_x);
+    norm_x = std::sqrt(norm_x);
+
+    if (norm_delta_x < 1e-14 || norm_delta_x < 1e-14 * norm_x) {
+      it += 1;
+      break;
+    }
+  }
+
+  // copy back into the input variables
+  for (size_t vessel_idx = 0; vessel_idx < num_vessels; vessel_idx += 1)
+    convert_w1w2_to_QA(w1[vessel_idx], w2[vessel_idx], p[vessel_idx], Q_up[vessel_idx], A_up[vessel_idx]);
+
+  return it;
+}
+
+} // namespace detail
+
 /*! @brief Solves the nfurcation equations at the intersection of n-vessels,
  *         and calculates the upwinded values for the respective vessels,
  *         taking into consideration the vessel orientation.
  *         Internally a Newton iteration is used to solve the system.
+ *         For up to 4 vessels no memory is allocated on the heap.
  *
  * @param w1   The back propagating characteristics for vessel 1 to n.
  * @param w2   The forward propagating characteristics for vessel 1 to n.
@@ -544,13 +878,22 @@ inline void fill_vector(const std::vector<double> &w1,
  * @param in   True if a vessel points towards the vertex, false if it points away.
  * @param Q_up The upwinded flow Q at vessel tips.
  * @param A_up The upwinded area A at vessel tips.
+ * @param warm_start If true, the given values of Q_up and A_up (e.g. from the last time step)
+ *                   are the initial guess of the newton iteration, otherwise the DG traces.
+ * @param residual   If not null, the maximum norm of the residual before the last newton update is stored here.
+ * @return The number of newton iterations, which is nfurcation_max_iterations if the iteration did not converge.
  */
-inline std::size_t solve_at_nfurcation(const std::vector<double> &Q,
-                                       const std::vector<double> &A,
-                                       const std::vector<VesselParameters> &p,
+template<typename PhysicalParameters>
+inline std::size_t solve_at_nfurcation(const std::vector<scalar_of<PhysicalParameters>> &Q,
+                                       const std::vector<scalar_of<PhysicalParameters>> &A,
+                                       const std::vector<PhysicalParameters> &p,
                                        const std::vector<bool> &in,
-                                       std::vector<double> &Q_up,
-                                       std::vector<double> &A_up) {
+                                       std::vector<scalar_of<PhysicalParameters>> &Q_up,
+                                       std::vector<scalar_of<PhysicalParameters>> &A_up,
+                                       bool warm_start = false,
+                                       double *residual = nullptr) {
+  using Scalar = scalar_of<PhysicalParameters>;
+
   const size_t num_vessels = Q.size();
 
   assert(num_vessels == A.size());
@@ -560,40 +903,61 @@ inline std::size_t solve_at_nfurcation(const std::vector<double> &Q,
   assert(num_vessels == A_up.size());
   assert(num_vessels > 1);
 
-  const std::size_t max_iter = 1000;
-
-  // calculate w1, w2 at all the bifurcations
-  std::vector<double> w1(num_vessels, 0);
-  std::vector<double> w2(num_vessels, 0);
-  for (size_t vessel_idx = 0; vessel_idx < num_vessels; vessel_idx += 1) {
-    w1[vessel_idx] = nonlinear::get_w1_from_QA(Q[vessel_idx], A[vessel_idx], p[vessel_idx]);
-    w2[vessel_idx] = nonlinear::get_w2_from_QA(Q[vessel_idx], A[vessel_idx], p[vessel_idx]);
+  // fixed size storage for the bifurcations and trifurcations, which are the most common cases
+  if (num_vessels <= detail::nfurcation_max_fixed_size) {
+    detail::NFurcationWorkspace<std::array<Scalar, detail::nfurcation_max_fixed_size>> ws{};
+    return detail::solve_at_nfurcation_newton<std::array<Scalar, detail::nfurcation_max_fixed_size>, PhysicalParameters>(num_vessels, Q, A, p, in, Q_up, A_up, warm_start, residual, ws);
   }
 
-  // solve for w1, w2 with a newton iteration
-  gmm::row_matrix<gmm::wsvector<double>> Jac(num_vessels, num_vessels);
-  std::vector<double> x(num_vessels, 0);
-  std::vector<double> f(num_vessels, 0);
-  std::vector<double> delta_x(num_vessels, 0);
+  const std::vector<Scalar> zero(num_vessels, 0.);
+  detail::NFurcationWorkspace<std::vector<Scalar>> ws{zero, zero, zero, zero, zero, zero, zero};
+  return detail::solve_at_nfurcation_newton<std::vector<Scalar>, PhysicalParameters>(num_vessels, Q, A, p, in, Q_up, A_up, warm_start, residual, ws);
+}
 
-  fill_vector(w1, w2, in, x);
-  std::size_t it = 0;
-  for (; it < max_iter; it += 1) {
-    nfurcation_equation_jacobian(w1, w2, p, in, Jac);
-    nfurcation_equation(w1, w2, p, in, f);
-    gmm::lu_solve(Jac, delta_x, f);
-    gmm::add(x, gmm::scaled(delta_x, -1), x);
-    extract_vector(w1, w2, in, x);
+/*! @brief Same as solve_at_nfurcation above for values given as arrays of num_vessels entries.
+ *         Instead of the heap, the newton iteration for more than 4 vessels uses the given scratch of
+ *         nfurcation_scratch_size(num_vessels) values, e.g. from a ScratchArena, such that no memory is allocated.
+ */
+template<typename PhysicalParameters, typename Flags>
+inline std::size_t solve_at_nfurcation(std::size_t num_vessels,
+                                       const scalar_of<PhysicalParameters> *Q,
+                                       const scalar_of<PhysicalParameters> *A,
+                                       const PhysicalParameters *p,
+                                       const Flags &in,
+                                       scalar_of<PhysicalParameters> *Q_up,
+                                       scalar_of<PhysicalParameters> *A_up,
+                                       bool warm_start,
+                                       double *residual,
+                                       scalar_of<PhysicalParameters> *scratch) {
+  using Scalar = scalar_of<PhysicalParameters>;
 
-    if (gmm::vect_norm2(delta_x) < 1e-14 || gmm::vect_norm2(delta_x) < 1e-14 * gmm::vect_norm2(x))
-      break;
+  assert(num_vessels > 1);
+
+  if (num_vessels <= detail::nfurcation_max_fixed_size) {
+    detail::NFurcationWorkspace<std::array<Scalar, detail::nfurcation_max_fixed_size>> ws{};
+    return detail::solve_at_nfurcation_newton<std::array<Scalar, detail::nfurcation_max_fixed_size>, PhysicalParameters>(num_vessels, Q, A, p, in, Q_up, A_up, warm_start, residual, ws);
   }
 
-  // copy back into the input variables
-  for (size_t vessel_idx = 0; vessel_idx < num_vessels; vessel_idx += 1)
-    convert_w1w2_to_QA(w1[vessel_idx], w2[vessel_idx], p[vessel_idx], Q_up[vessel_idx], A_up[vessel_idx]);
+  const std::size_t n = num_vessels;
+  detail::NFurcationWorkspace<Scalar *> ws{scratch, scratch + n, scratch + 2 * n, scratch + 3 * n, scratch + 4 * n, scratch + 5 * n, scratch + 6 * n};
+  return detail::solve_at_nfurcation_newton<Scalar *, PhysicalParameters>(num_vessels, Q, A, p, in, Q_up, A_up, warm_start, residual, ws);
+}
 
-  return it;
+/*! @brief The number of values of the scratch of solve_at_nfurcation with arrays. */
+constexpr std::size_t nfurcation_scratch_size(std::size_t num_vessels) {
+  return num_vessels <= detail::nfurcation_max_fixed_size ? 0 : 7 * num_vessels;
+}
+
+/*! @brief Solves the nfurcation equations for vessels without sensitivities, see the template above. */
+inline std::size_t solve_at_nfurcation(const std::vector<double> &Q,
+                                       const std::vector<double> &A,
+                                       const std::vector<VesselParameters> &p,
+                                       const std::vector<bool> &in,
+                                       std::vector<double> &Q_up,
+                                       std::vector<double> &A_up,
+                                       bool warm_start = false,
+                                       double *residual = nullptr) {
+  return solve_at_nfurcation<VesselParameters>(Q, A, p, in, Q_up, A_up, warm_start, residual);
 }
 
 /*! @brief Calculates the kinematic viscosity of blood plasma.
@@ -638,12 +1002,21 @@ inline double viscosity_bloodplasma(double r) {
 
 /*! @brief input resistance to the 0D models. */
 template<typename Data>
-inline double calculate_R1(const Data &param) {
-  const double c0 = std::pow(param.G0 / (2.0 * param.rho), 0.5);
-  const double R1 = param.rho * c0 / param.A0;
+inline scalar_of<Data> calculate_R1(const Data &param) {
+  using std::pow;
+  const auto c0 = pow(param.G0 / (2.0 * param.rho), 0.5);
+  const auto R1 = param.rho * c0 / param.A0;
   return R1;
 }
 
+/*! @brief The right-hand side of the pressure p_c of a windkessel model with compliance C,
+ *         which is filled by the flow Q_in and drained through the resistance R2 towards the venous pressure p_v.
+ */
+template<typename Scalar>
+inline Scalar windkessel_pressure_rhs(const Scalar &Q_in, const Scalar &p_c, const Scalar &p_v, const Scalar &R2, const Scalar &C) {
+  return 1. / C * (Q_in - (p_c - p_v) / R2);
+}
+
 
 } // namespace macrocirculation
 
@@ -0,0 +1,173 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "vessel_tip_coupling.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include "communication/mpi.hpp"
+#include "explicit_nonlinear_flow_solver.hpp"
+#include "graph_storage.hpp"
+
+namespace macrocirculation {
+
+namespace {
+
+double get_outflow_pressure(const Vertex &v) {
+  if (v.is_vessel_tree_outflow())
+    return v.get_vessel_tree_data().p_out;
+  if (v.is_rcl_outflow())
+    return v.get_rcl_data().p_out;
+  return v.get_peripheral_vessel_data().p_out;
+}
+
+} // namespace
+
+VesselTipCoupling::VesselTipCoupling(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, MPI_Comm intercomm, std::size_t exchange_interval)
+    : d_comm(comm),
+      d_graph(std::move(graph)),
+      d_intercomm(intercomm),
+      d_exchange_interval(exchange_interval),
+      d_num_updates(0),
+      d_send_request(MPI_REQUEST_NULL),
+      d_receive_request(MPI_REQUEST_NULL),
+      d_answer_pending(false) {
+  if (d_exchange_interval == 0)
+    throw std::runtime_error("the exchange interval of the vessel tip coupling has to be positive");
+
+  for (auto v_id : d_graph->get_vertex_ids()) {
+    const auto &v = d_graph->vertex(v_id);
+    if (v.is_leaf() && (v.is_windkessel_outflow() || v.is_vessel_tree_outflow() || v.is_rcl_outflow()))
+      d_outlet_vertex_ids.push_back(v_id);
+  }
+
+  const std::size_t n = num_outlets();
+  d_state.assign(1 + 2 * n, 0);
+  d_flows.assign(n, 0);
+  d_pressures.assign(n, 0);
+  d_answer.assign(1 + n, 0);
+  d_outflow_pressures.resize(n);
+  for (std::size_t k = 0; k < n; k += 1)
+    d_outflow_pressures[k] = get_outflow_pressure(d_graph->vertex(d_outlet_vertex_ids[k]));
+
+  // both answers are the initial outflow pressures, until the partner sends its own
+  d_answers.assign(2 * (1 + n), 0);
+  std::copy(d_outflow_pressures.begin(), d_outflow_pressures.end(), d_answers.begin() + 1);
+  std::copy(d_outflow_pressures.begin(), d_outflow_pressures.end(), d_answers.begin() + static_cast<std::ptrdiff_t>(n + 2));
+}
+
+VesselTipCoupling::~VesselTipCoupling() {
+  if (d_receive_request != MPI_REQUEST_NULL) {
+    MPI_Cancel(&d_receive_request);
+    MPI_Wait(&d_receive_request, MPI_STATUS_IGNORE);
+  }
+  if (d_send_request != MPI_REQUEST_NULL)
+    MPI_Wait(&d_send_request, MPI_STATUS_IGNORE);
+}
+
+void VesselTipCoupling::update(ExplicitNonlinearFlowSolver &solver, double t) {
+  // the initial outflow pressures belong to the start time
+  if (d_num_updates == 0)
+    d_answers[0] = d_answers[1 + num_outlets()] = t;
+
+  if (d_num_updates % d_exchange_interval == 0) {
+    // the buffer of the previous state is reused
+    CHECK_MPI_SUCCESS(MPI_Wait(&d_send_request, MPI_STATUS_IGNORE));
+    gather_outlet_values(solver, t);
+
+    if (d_intercomm != MPI_COMM_NULL) {
+      if (d_answer_pending)
+        receive_answer();
+
+      if (mpi::rank(d_comm) == 0) {
+        CHECK_MPI_SUCCESS(MPI_Isend(d_state.data(), static_cast<int>(d_state.size()), MPI_DOUBLE, 0, state_tag, d_intercomm, &d_send_request));
+        CHECK_MPI_SUCCESS(MPI_Irecv(d_answer.data(), static_cast<int>(d_answer.size()), MPI_DOUBLE, 0, state_tag, d_intercomm, &d_receive_request));
+      }
+      d_answer_pending = true;
+    }
+  }
+  d_num_updates += 1;
+
+  apply_outflow_pressures(solver, t);
+}
+
+void VesselTipCoupling::finish() {
+  if (d_intercomm == MPI_COMM_NULL)
+    return;
+
+  if (d_answer_pending)
+    receive_answer();
+
+  if (mpi::rank(d_comm) == 0) {
+    CHECK_MPI_SUCCESS(MPI_Wait(&d_send_request, MPI_STATUS_IGNORE));
+    CHECK_MPI_SUCCESS(MPI_Send(nullptr, 0, MPI_DOUBLE, 0, stop_tag, d_intercomm));
+  }
+}
+
+void VesselTipCoupling::gather_outlet_values(const ExplicitNonlinearFlowSolver &solver, double t) {
+  const std::size_t n = num_outlets();
+  const auto rank = mpi::rank(d_comm);
+
+  // every outlet is evaluated by the owner of its edge, hence the reduction is exact
+  std::fill(d_state.begin(), d_state.end(), 0.);
+  for (std::size_t k = 0; k < n; k += 1) {
+    const auto &v = d_graph->vertex(d_outlet_vertex_ids[k]);
+    const auto &edge = d_graph->edge(v.get_edge_neighbors()[0]);
+    if (edge.rank() != rank)
+      continue;
+    const double sigma = edge.is_pointing_to(v.get_id()) ? +1. : -1.;
+    double p, q;
+    solver.get_1d_pq_values_at_vertex(v, p, q);
+    d_state[1 + k] = sigma * q;
+    d_state[1 + n + k] = p;
+  }
+  CHECK_MPI_SUCCESS(MPI_Allreduce(MPI_IN_PLACE, d_state.data(), static_cast<int>(d_state.size()), MPI_DOUBLE, MPI_SUM, d_comm));
+  d_state[0] = t;
+
+  std::copy_n(d_state.begin() + 1, n, d_flows.begin());
+  std::copy_n(d_state.begin() + static_cast<std::ptrdiff_t>(1 + n), n, d_pressures.begin());
+}
+
+void VesselTipCoupling::receive_answer() {
+  if (mpi::rank(d_comm) == 0)
+    CHECK_MPI_SUCCESS(MPI_Wait(&d_receive_request, MPI_STATUS_IGNORE));
+  CHECK_MPI_SUCCESS(MPI_Bcast(d_answer.data(), static_cast<int>(d_answer.size()), MPI_DOUBLE, 0, d_comm));
+  d_answer_pending = false;
+
+  // the newest answer becomes the older one
+  const auto answer_size = static_cast<std::ptrdiff_t>(d_answer.size());
+  std::copy(d_answers.begin() + answer_size, d_answers.end(), d_answers.begin());
+  std::copy(d_answer.begin(), d_answer.end(), d_answers.begin() + answer_size);
+}
+
+void VesselTipCoupling::apply_outflow_pressures(ExplicitNonlinearFlowSolver &solver, double t) {
+  const std::size_t n = num_outlets();
+  const double *older = &d_answers[0];
+  const double *newer = &d_answers[1 + n];
+
+  // the weight of the newer answer
+  double w = 1;
+  if (older[0] < newer[0] && t < newer[0])
+    w = std::max(0., (t - older[0]) / (newer[0] - older[0]));
+
+  bool has_changed = false;
+  for (std::size_t k = 0; k < n; k += 1) {
+    const double p_out = (1 - w) * older[1 + k] + w * newer[1 + k];
+    if (p_out == d_outflow_pressures[k])
+      continue;
+    d_outflow_pressures[k] = p_out;
+    d_graph->vertex(d_outlet_vertex_ids[k]).update_vessel_tip_pressures(p_out);
+    has_changed = true;
+  }
+
+  if (has_changed)
+    solver.update_outflow_pressures();
+}
+
+} // namespace macrocirculation
@@ -0,0 +1,123 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner.
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TUMORMODELS_VESSEL_TIP_COUPLING_HPP
+#define TUMORMODELS_VESSEL_TIP_COUPLING_HPP
+
+#include <cstddef>
+#include <memory>
+#include <mpi.h>
+#include <vector>
+
+namespace macrocirculation {
+
+// forward declarations
+class GraphStorage;
+class ExplicitNonlinearFlowSolver;
+
+/*! @brief Couples the vessel tips of the 1D network to a tissue solver, which runs as a separate code on the remote group of an intercommunicator.
+ *
+ *  The outlets are all the leaves with a windkessel, vessel tree or rcl outflow, whose index is their position in the order of the vertex ids.
+ *  Every exchange_interval steps rank 0 of our communicator sends the message
+ *      [ t, q_0, ..., q_{n-1}, p_0, ..., p_{n-1} ]
+ *  with the tag state_tag to rank 0 of the remote group, where q are the flows out of the network and p the pressures at the outlets.
+ *  The partner answers every state with the outflow pressures of the outlets at a time of its choice,
+ *      [ t, p_out_0, ..., p_out_{n-1} ],
+ *  with the same tag. Both messages are nonblocking: the answer to an exchange is only awaited at the next exchange,
+ *  such that the solvers of both codes run concurrently. Between the exchanges, the outflow pressures of the 0D models
+ *  are interpolated linearly in time between the last two answers and held constant after the newest one.
+ *  The partner stops, when it receives an empty message with the tag stop_tag.
+ */
+class VesselTipCoupling {
+public:
+  static constexpr int state_tag = 0;
+  static constexpr int stop_tag = 1;
+
+  /*! @brief Creates the coupling, which is collective on comm.
+   *
+   * @param intercomm          The intercommunicator to the tissue solver, e.g. from MPI_Intercomm_create or MPI_Comm_connect.
+   *                           For MPI_COMM_NULL only the outlet values are gathered and the outflow pressures stay fixed.
+   * @param exchange_interval  The number of time steps between two exchanges.
+   */
+  VesselTipCoupling(MPI_Comm comm, std::shared_ptr<GraphStorage> graph, MPI_Comm intercomm, std::size_t exchange_interval = 1);
+
+  VesselTipCoupling(const VesselTipCoupling &) = delete;
+  VesselTipCoupling &operator=(const VesselTipCoupling &) = delete;
+
+  /*! @brief Cancels the pending answer of the partner, if finish was not called. */
+  ~VesselTipCoupling();
+
+  std::size_t num_outlets() const { return d_outlet_vertex_ids.size(); }
+
+  /*! @brief The vertex ids of the outlets, ordered by their outlet index. */
+  const std::vector<std::size_t> &get_outlet_vertex_ids() const { return d_outlet_vertex_ids; }
+
+  /*! @brief The flows out of the network at the outlets at the last exchange, which are known on all the ranks. */
+  const std::vector<double> &get_flows() const { return d_flows; }
+
+  /*! @brief The pressures at the outlets at the last exchange, which are known on all the ranks. */
+  const std::vector<double> &get_pressures() const { return d_pressures; }
+
+  /*! @brief The outflow pressures of the 0D models, which were applied at the last update. */
+  const std::vector<double> &get_outflow_pressures() const { return d_outflow_pressures; }
+
+  /*! @brief Has to be called collectively after every time step, where t is the time of the current solution.
+   *         Exchanges the outlet values every exchange_interval calls, and updates the outflow pressures of the 0D models to time t.
+   */
+  void update(ExplicitNonlinearFlowSolver &solver, double t);
+
+  /*! @brief Waits for the answer to the last exchange and tells the partner to stop. This is collective on comm. */
+  void finish();
+
+private:
+  MPI_Comm d_comm;
+
+  std::shared_ptr<GraphStorage> d_graph;
+
+  MPI_Comm d_intercomm;
+
+  std::size_t d_exchange_interval;
+
+  std::size_t d_num_updates;
+
+  std::vector<std::size_t> d_outlet_vertex_ids;
+
+  /*! @brief The message to the partner [ t, flows, pressures ], which stays alive until the nonblocking send is done. */
+  std::vector<double> d_state;
+
+  std::vector<double> d_flows;
+
+  std::vector<double> d_pressures;
+
+  /*! @brief The buffer for the nonblocking receive of the next answer [ t, outflow pressures ]. */
+  std::vector<double> d_answer;
+
+  /*! @brief The last two answers of the partner, where the older one comes first. */
+  std::vector<double> d_answers;
+
+  std::vector<double> d_outflow_pressures;
+
+  MPI_Request d_send_request;
+
+  MPI_Request d_receive_request;
+
+  /*! @brief True, if the answer to the last exchange is still awaited. */
+  bool d_answer_pending;
+
+  /*! @brief Evaluates the flows and pressures at our outlets and gathers them on all the ranks. */
+  void gather_outlet_values(const ExplicitNonlinearFlowSolver &solver, double t);
+
+  /*! @brief Waits for the pending answer and distributes it to all the ranks. */
+  void receive_answer();
+
+  /*! @brief Interpolates the outflow pressures at time t from the last two answers and passes them to the vertices and the solver. */
+  void apply_outflow_pressures(ExplicitNonlinearFlowSolver &solver, double t);
+};
+
+} // namespace macrocirculation
+
+#endif //TUMORMODELS_VESSEL_TIP_COUPLING_HPP
@@ -21,34 +21,30 @@ VesselTreeFlowIntegrator::VesselTreeFlowIntegrator(MPI_Comm comm, std::shared_pt
 }
 
 void VesselTreeFlowIntegrator::reset() {
-  for (const auto &v_id : d_graph->get_active_vertex_ids(mpi::rank(d_comm))) {
-    auto vertex = d_graph->get_vertex(v_id);
-    if (vertex->is_vessel_tree_outflow()) {
-      d_avg_data[v_id] = {0, 0, 0, 0};
-    }
+  d_outlet_vertex_ids.clear();
+  for (const auto &v_id : d_graph->get_vertex_ids()) {
+    auto &vertex = d_graph->vertex(v_id);
+    if (vertex.is_leaf() && vertex.is_vessel_tree_outflow())
+      d_outlet_vertex_ids.push_back(v_id);
   }
+  d_avg_data.assign(num_quantities * d_outlet_vertex_ids.size(), 0);
 }
 
 std::vector<VesselTreeFlowIntegratorResult> VesselTreeFlowIntegrator::calculate() {
+  std::vector<double> data(d_avg_data);
+  MPI_Allreduce(MPI_IN_PLACE, data.data(), static_cast<int>(data.size()), MPI_DOUBLE, MPI_SUM, d_comm);
+
   std::vector<VesselTreeFlowIntegratorResult> results;
-  for (const auto &v_id : d_graph->get_vertex_ids()) {
-    auto vertex = d_graph->get_vertex(v_id);
-    if (!vertex->is_leaf() || !vertex->is_vessel_tree_outflow())
-      continue;
-    auto edge = d_graph->get_edge(vertex->get_edge_neighbors().front());
-    bool owned = edge->rank() == mpi::rank(d_comm);
-    std::array<double, 3> data = {0, 0, 0};
-    if (owned) {
-      double time = d_avg_data.at(v_id).time;
-      data[0] = d_avg_data.at(v_id).flow / time;
-      data[1] = d_avg_data.at(v_id).pressure_1d / time;
-      data[2] = d_avg_data.at(v_id).pressure_3d / time;
-    }
-    MPI_Bcast(&data[0], data.size(), MPI_DOUBLE, edge->rank(), d_comm);
-    if(!edge->has_embedding_data())
+  for (std::size_t outlet = 0; outlet < d_outlet_vertex_ids.size(); outlet += 1) {
+    const auto v_id = d_outlet_vertex_ids[outlet];
+    auto &vertex = d_graph->vertex(v_id);
+    auto &edge = d_graph->edge(vertex.get_edge_neighbors().front());
+    const double *values = &data[num_quantities * outlet];
+    const double time = values[3];
+    if(!edge.has_embedding_data())
       throw std::runtime_error("VesselTreeFlowIntegrator::calculate: needs point coordinates");
-    auto p = edge->is_pointing_to(v_id) ? edge->get_embedding_data().points.back() : edge->get_embedding_data().points.front();
-    results.push_back({p, v_id, vertex->get_vessel_tree_data().resistances.size(), data[0], data[2]});
+    auto p = edge.is_pointing_to(v_id) ? edge.get_embedding_data().points.back() : edge.get_embedding_data().points.front();
+    results.push_back({p, v_id, vertex.get_vessel_tree_data().resistances.size(), values[0] / time, values[2] / time});
   }
   return results;
 }
@@ -71,16 +67,16 @@ void VesselTreeFlowIntegrator::write(const std::string &folder, const std::strin
   size_t index = 0;
 
   for (const auto &v_id : graph.get_vertex_ids()) {
-    auto vertex = graph.get_vertex(v_id);
-    if (!vertex->is_leaf() || !vertex->is_vessel_tree_outflow())
+    auto &vertex = graph.vertex(v_id);
+    if (!vertex.is_leaf() || !vertex.is_vessel_tree_outflow())
       continue;
 
     auto point = results[index].point;
 
     json vessel_obj = {
       {"vertex_id", v_id},
-      {"name", vertex->get_name()},
-      {"neighbor_edge_id", vertex->get_edge_neighbors()[0]},
+      {"name", vertex.get_name()},
+      {"neighbor_edge_id", vertex.get_edge_neighbors()[0]},
       {"point", {point.x, point.y, point.z}},
       {"average_flow", results[index].averaged_flow},
       // {"average_3d_pressure", results[index].averaged_3D_pressure},
@@ -52,14 +52,16 @@ private:
   std::shared_ptr<GraphStorage> d_graph;
   std::shared_ptr<DofMap> d_dof_map;
 
-  struct AvgVesselTipData {
-    double flow;
-    double pressure_1d;
-    double pressure_3d;
-    double time;
-  };
-
-  std::map<size_t, AvgVesselTipData> d_avg_data;
+  /*! @brief The vessel tree outflows, which numbers the outlets identically on all the ranks. */
+  std::vector<size_t> d_outlet_vertex_ids;
+
+  /*! @brief The number of accumulated quantities per outlet, i.e. the flow, the 1D and 3D pressure and the time. */
+  static constexpr std::size_t num_quantities = 4;
+
+  /*! @brief The time integrals of each outlet, of which only our ranks contribute nonzero values.
+   *         All of them are gathered with a single reduction in calculate.
+   */
+  std::vector<double> d_avg_data;
 };
 
 }
@@ -0,0 +1,254 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/right_hand_side_evaluator.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("VesselTreeCompartmentsFollowTheChainEquations", "[0DOutflows]") {
+  const size_t degree = 2;
+  const std::vector<double> R{1.5, 2.5, 4., 7.};
+  const std::vector<double> C{0.2, 0.3, 0.1, 0.4};
+  const std::vector<double> radii{0.2, 0.1, 0.05, 0.025};
+  const double n = 2;
+  const double p_out = 0.5;
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  auto &vertex = graph->vertex(2);
+  vertex.set_to_vessel_tree_outflow(p_out, R, C, radii, static_cast<std::size_t>(n));
+  graph->finalize_bcs();
+
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_SELF);
+
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_SELF, *graph, 2, degree, false);
+
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_SELF, graph, dof_map, degree);
+  auto &rhs_evaluator = solver.get_rhs_evaluator();
+
+  auto u = solver.get_solution();
+  const std::size_t first_dof = dof_map->get_local_dof_map(vertex).first_dof();
+  const std::vector<double> p{3., 2.25, 1.5, 1.};
+  std::copy(p.begin(), p.end(), u.begin() + static_cast<std::ptrdiff_t>(first_dof));
+
+  std::vector<double> rhs(u.size(), 0);
+  rhs_evaluator.evaluate(0, u, rhs);
+
+  // the compartments behind the first one do not depend on the flow of the vessel
+  std::vector<double> expected(R.size(), 0);
+  for (std::size_t k = 1; k < R.size(); k += 1) {
+    const double p_next = k + 1 < R.size() ? p[k + 1] : p_out;
+    expected[k] = ((p[k - 1] - p[k]) / (n * R[k - 1]) - (p[k] - p_next) / R[k]) / C[k];
+    REQUIRE(rhs[first_dof + k] == Approx(expected[k]).epsilon(1e-12));
+  }
+
+  SECTION("the implicit 0D models solve the linearized implicit euler step") {
+    const double tau = 0.05;
+    rhs_evaluator.set_implicit_0d_models(true);
+    std::vector<double> rhs_implicit(u.size(), 0);
+    rhs_evaluator.evaluate(0, u, rhs_implicit, tau);
+
+    // (I - tau J) rhs_implicit = rhs has to hold on all the rows, which do not contain the flow of the vessel
+    const auto x = [&](std::size_t k) { return rhs_implicit[first_dof + k]; };
+    for (std::size_t k = 1; k < R.size(); k += 1) {
+      double J_x = (x(k - 1) - x(k)) / (n * R[k - 1]) / C[k] - x(k) / R[k] / C[k];
+      if (k + 1 < R.size())
+        J_x += x(k + 1) / R[k] / C[k];
+      REQUIRE(x(k) - tau * J_x == Approx(rhs[first_dof + k]).epsilon(1e-12));
+    }
+  }
+
+  SECTION("the exponential 0D models integrate the linearized chain exactly") {
+    const double tau = 0.05;
+    rhs_evaluator.set_exponential_0d_models(true);
+    std::vector<double> rhs_exponential(u.size(), 0);
+    rhs_evaluator.evaluate(0, u, rhs_exponential, tau);
+
+    // the linearized chain, whose first compartment loses the flow 1/(2 R1) p_0 to the vessel
+    const auto &data = graph->edge(vertex.get_edge_neighbors()[0]).get_physical_data();
+    const double R1 = data.rho * data.get_c0() / data.A0;
+    const std::size_t N = R.size();
+    const auto jacobian_times = [&](const std::vector<double> &x) {
+      std::vector<double> J_x(N, 0);
+      for (std::size_t k = 0; k < N; k += 1) {
+        const double x_prev = k > 0 ? x[k - 1] : 0.;
+        const double x_next = k + 1 < N ? x[k + 1] : 0.;
+        const double G_prev = k > 0 ? 1. / (n * R[k - 1]) : 1. / (2 * R1);
+        J_x[k] = (G_prev * (x_prev - x[k]) - (x[k] - x_next) / R[k]) / C[k];
+      }
+      return J_x;
+    };
+
+    // the exact increment tau phi_1(tau J) f solves d' = J d + f with d(0) = 0, which we integrate with many rk4 steps
+    std::vector<double> f(N), d(N, 0);
+    for (std::size_t k = 0; k < N; k += 1)
+      f[k] = rhs[first_dof + k];
+    const auto d_dt = [&](const std::vector<double> &x) {
+      auto J_x = jacobian_times(x);
+      for (std::size_t k = 0; k < N; k += 1)
+        J_x[k] += f[k];
+      return J_x;
+    };
+    const std::size_t num_steps = 1000;
+    const double h = tau / num_steps;
+    for (std::size_t i = 0; i < num_steps; i += 1) {
+      const auto axpy = [&](const std::vector<double> &k, double a) {
+        std::vector<double> x(d);
+        for (std::size_t j = 0; j < N; j += 1)
+          x[j] += a * k[j];
+        return x;
+      };
+      const auto k1 = d_dt(d);
+      const auto k2 = d_dt(axpy(k1, h / 2));
+      const auto k3 = d_dt(axpy(k2, h / 2));
+      const auto k4 = d_dt(axpy(k3, h));
+      for (std::size_t j = 0; j < N; j += 1)
+        d[j] += h / 6 * (k1[j] + 2 * k2[j] + 2 * k3[j] + k4[j]);
+    }
+
+    for (std::size_t k = 0; k < N; k += 1)
+      REQUIRE(tau * rhs_exponential[first_dof + k] == Approx(d[k]).epsilon(1e-10));
+  }
+}
+
+TEST_CASE("RCLChainsFollowTheChainEquations", "[0DOutflows]") {
+  const size_t degree = 2;
+  const std::vector<double> R{1.5, 2.5, 4.};
+  const std::vector<double> C{0.2, 0.3, 0.1};
+  const std::vector<double> L{0.01, 0.02, 0.05};
+  const double p_out = 0.5;
+  const std::size_t N = R.size();
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  auto &vertex = graph->vertex(2);
+  vertex.set_to_vessel_rcl_outflow(p_out, R, C, L);
+  graph->finalize_bcs();
+
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_SELF);
+
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_SELF, *graph, 2, degree, false);
+  REQUIRE(dof_map->get_local_dof_map(vertex).num_local_dof() == 2 * N);
+
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_SELF, graph, dof_map, degree);
+  auto &rhs_evaluator = solver.get_rhs_evaluator();
+
+  // the pressures of the compartments are followed by the flows between them
+  auto u = solver.get_solution();
+  const std::size_t first_dof = dof_map->get_local_dof_map(vertex).first_dof();
+  const std::vector<double> p{3., 2.25, 1.5};
+  const std::vector<double> q{0.4, 0.3, 0.35};
+  std::copy(p.begin(), p.end(), u.begin() + static_cast<std::ptrdiff_t>(first_dof));
+  std::copy(q.begin(), q.end(), u.begin() + static_cast<std::ptrdiff_t>(first_dof + N));
+
+  std::vector<double> rhs(u.size(), 0);
+  rhs_evaluator.evaluate(0, u, rhs);
+
+  const auto f_p = [&](const std::vector<double> &f, std::size_t k) { return f[first_dof + k]; };
+  const auto f_q = [&](const std::vector<double> &f, std::size_t k) { return f[first_dof + N + k]; };
+
+  // only the first pressure depends on the flow of the vessel
+  for (std::size_t k = 0; k < N; k += 1) {
+    const double p_next = k + 1 < N ? p[k + 1] : p_out;
+    if (k > 0)
+      REQUIRE(f_p(rhs, k) == Approx((q[k - 1] - q[k]) / C[k]).epsilon(1e-12));
+    REQUIRE(f_q(rhs, k) == Approx((p[k] - p_next - R[k] * q[k]) / L[k]).epsilon(1e-12).margin(1e-12));
+  }
+
+  SECTION("the implicit 0D models solve the linearized implicit euler step") {
+    const double tau = 0.05;
+    rhs_evaluator.set_implicit_0d_models(true);
+    std::vector<double> rhs_implicit(u.size(), 0);
+    rhs_evaluator.evaluate(0, u, rhs_implicit, tau);
+
+    // (I - tau J) rhs_implicit = rhs has to hold on all the rows, which do not contain the flow of the vessel
+    for (std::size_t k = 0; k < N; k += 1) {
+      const double dp_next = k + 1 < N ? f_p(rhs_implicit, k + 1) : 0.;
+      const double J_q = (f_p(rhs_implicit, k) - dp_next - R[k] * f_q(rhs_implicit, k)) / L[k];
+      REQUIRE(f_q(rhs_implicit, k) - tau * J_q == Approx(f_q(rhs, k)).epsilon(1e-12).margin(1e-12));
+      if (k > 0) {
+        const double J_p = (f_q(rhs_implicit, k - 1) - f_q(rhs_implicit, k)) / C[k];
+        REQUIRE(f_p(rhs_implicit, k) - tau * J_p == Approx(f_p(rhs, k)).epsilon(1e-12).margin(1e-12));
+      }
+    }
+  }
+}
+
+TEST_CASE("UpdatedWindkesselParametersAgreeWithAFreshSetup", "[0DOutflows]") {
+  const size_t degree = 2;
+  const double R = 3.2;
+  const double C = 0.45;
+
+  const auto setup = [&](const std::shared_ptr<mc::GraphStorage> &graph) {
+    graph->finalize_bcs();
+    mc::naive_mesh_partitioner(*graph, MPI_COMM_SELF);
+    auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+    dof_map->create(MPI_COMM_SELF, *graph, 2, degree, false);
+    auto solver = std::make_unique<mc::ExplicitNonlinearFlowSolver>(MPI_COMM_SELF, graph, dof_map, degree);
+    solver->use_ssp_method();
+    return solver;
+  };
+
+  // the parameters are changed on the finalized vertex of a solver, which already advanced in time
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  auto solver = setup(graph);
+  for (std::size_t k = 0; k < 20; k += 1)
+    solver->solve(1e-4, static_cast<double>(k) * 1e-4);
+  const auto u = solver->get_solution();
+  graph->vertex(2).update_windkessel_parameters(R, C);
+  solver->update_0d_parameters();
+
+  auto graph_fresh = test_macrocirculation::util::create_3_vessel_network();
+  graph_fresh->vertex(2).set_to_windkessel_outflow(R, C);
+  auto solver_fresh = setup(graph_fresh);
+
+  auto graph_old = test_macrocirculation::util::create_3_vessel_network();
+  auto solver_old = setup(graph_old);
+
+  // the upwinding warm starts from the last evaluation, hence we compare the evaluations of fresh solvers on the same state
+  const auto evaluate = [&](mc::ExplicitNonlinearFlowSolver &s) {
+    std::vector<double> rhs(u.size(), 0);
+    s.get_rhs_evaluator().evaluate(0, u, rhs);
+    return rhs;
+  };
+  const auto rhs_fresh = evaluate(*solver_fresh);
+  const auto rhs_old = evaluate(*solver_old);
+
+  const auto rhs_updated = [&]() {
+    auto graph_updated = test_macrocirculation::util::create_3_vessel_network();
+    auto solver_updated = setup(graph_updated);
+    graph_updated->vertex(2).update_windkessel_parameters(R, C);
+    solver_updated->update_0d_parameters();
+    return evaluate(*solver_updated);
+  }();
+
+  REQUIRE(rhs_updated != rhs_old);
+  REQUIRE(rhs_updated == rhs_fresh);
+
+  // the updated solver continues with the new parameters
+  for (std::size_t k = 20; k < 40; k += 1)
+    solver->solve(1e-4, static_cast<double>(k) * 1e-4);
+  for (auto v : solver->get_solution())
+    REQUIRE(std::isfinite(v));
+
+  // the type of the boundary condition and the dofs cannot be changed
+  REQUIRE_THROWS(graph->vertex(0).update_windkessel_parameters(R, C));
+  REQUIRE_THROWS(graph->vertex(2).update_vessel_tree_parameters({R}, {C}));
+}
@@ -0,0 +1,79 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "macrocirculation/async_output.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("AsyncOutputWritesAllSnapshotsInOrder", "[AsyncOutput]") {
+  for (std::size_t num_buffers : {0, 1, 3}) {
+    std::vector<double> times;
+    std::vector<std::vector<double>> solutions;
+
+    {
+      mc::AsyncOutput output([&](double t, const std::vector<double> &u) {
+        // a slow disk fills the ring, such that push has to wait
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        times.push_back(t);
+        solutions.push_back(u);
+      },
+                             num_buffers);
+
+      std::vector<double> u(4);
+      for (std::size_t k = 0; k < 10; k += 1) {
+        u.assign(4, static_cast<double>(k));
+        output.push(0.1 * k, u);
+        // the snapshot is independent of later changes to u
+        u.assign(4, -1.);
+      }
+      output.finish();
+
+      REQUIRE(times.size() == 10);
+      if (num_buffers > 0)
+        REQUIRE(output.num_stalls() > 0);
+      else
+        REQUIRE(output.num_stalls() == 0);
+    }
+
+    for (std::size_t k = 0; k < 10; k += 1) {
+      REQUIRE(times[k] == Approx(0.1 * k));
+      REQUIRE(solutions[k] == std::vector<double>(4, static_cast<double>(k)));
+    }
+  }
+}
+
+TEST_CASE("AsyncOutputWritesTheRemainingSnapshotsOnDestruction", "[AsyncOutput]") {
+  std::size_t num_written = 0;
+  {
+    mc::AsyncOutput output([&](double, const std::vector<double> &) { num_written += 1; }, 8);
+    for (std::size_t k = 0; k < 5; k += 1)
+      output.push(k, std::vector<double>(100, 1.));
+  }
+  REQUIRE(num_written == 5);
+}
+
+TEST_CASE("AsyncOutputRethrowsTheExceptionsOfTheWriter", "[AsyncOutput]") {
+  mc::AsyncOutput output([](double t, const std::vector<double> &) {
+    if (t > 0.5)
+      throw std::runtime_error("disk full");
+  },
+                         2);
+
+  output.push(0., {1.});
+  output.push(1., {1.});
+  REQUIRE_THROWS_AS(output.finish(), std::runtime_error);
+
+  // the output continues after the exception was reported
+  output.push(0.25, {1.});
+  REQUIRE_NOTHROW(output.finish());
+}
@@ -195,3 +195,60 @@ TEST_CASE("TestTrifurcation", "[Trifurcation]") {
   REQUIRE(calculate_p_from_QA(Q_up[0], A_up[0], param_a) - calculate_p_from_QA(Q_up[2], A_up[2], param_c) == Approx(0.).margin(1e-10));
   REQUIRE(calculate_p_from_QA(Q_up[0], A_up[0], param_a) - calculate_p_from_QA(Q_up[3], A_up[3], param_d) == Approx(0.).margin(1e-10));
 }
+
+TEST_CASE("TestPentafurcation", "[Pentafurcation]") {
+  // more than 4 vessels use the dynamically sized newton solver
+  const std::vector<double> Q{1, 0.2, 0.3, 0.1, 0.25};
+  const std::vector<double> A{6.97, 3.2, 4.1, 2.3, 3.4};
+
+  const std::vector<mc::VesselParameters> param{
+    {592.4e2, 6.97, 1.028},
+    {592.4e2, 6.97 / 2, 1.028},
+    {592.4e2, 6.97 / 1.5, 1.028},
+    {592.4e2, 6.97 / 3, 1.028},
+    {592.4e2, 6.97 / 2, 1.028}};
+
+  std::vector<double> Q_up(5, 0);
+  std::vector<double> A_up(5, 0);
+
+  const auto num_iter = mc::solve_at_nfurcation(Q, A, param, {true, false, true, false, false}, Q_up, A_up);
+
+  INFO("needed " << num_iter << " iterations");
+
+  REQUIRE(Q_up[0] - Q_up[1] + Q_up[2] - Q_up[3] - Q_up[4] == Approx(0.).margin(1e-12));
+
+  for (std::size_t k = 1; k < 5; k += 1)
+    REQUIRE(calculate_p_from_QA(Q_up[0], A_up[0], param[0]) - calculate_p_from_QA(Q_up[k], A_up[k], param[k]) == Approx(0.).margin(1e-10));
+}
+
+TEST_CASE("TestWarmStartedBifurcation", "[WarmStartedBifurcation]") {
+  const std::vector<double> Q{1, 0.2, 0.3};
+  const std::vector<double> A{7.2, 3.2, 4.1};
+
+  mc::VesselParameters param_a{592.4e2, 6.97, 1.028};
+  mc::VesselParameters param_b{592.4e2, 3.1, 1.028};
+  mc::VesselParameters param_c{592.4e2, 4.0, 1.028};
+
+  std::vector<double> Q_up(3, 0);
+  std::vector<double> A_up(3, 0);
+
+  const auto num_iter_cold = mc::solve_at_nfurcation(Q, A, {param_a, param_b, param_c}, {true, false, false}, Q_up, A_up);
+
+  // slightly perturbed traces, as in the next time step
+  const std::vector<double> Q_next{1.001, 0.2, 0.301};
+  const std::vector<double> A_next{7.201, 3.2, 4.1};
+
+  std::vector<double> Q_up_cold(3, 0);
+  std::vector<double> A_up_cold(3, 0);
+  mc::solve_at_nfurcation(Q_next, A_next, {param_a, param_b, param_c}, {true, false, false}, Q_up_cold, A_up_cold);
+
+  const auto num_iter_warm = mc::solve_at_nfurcation(Q_next, A_next, {param_a, param_b, param_c}, {true, false, false}, Q_up, A_up, true);
+
+  INFO("cold start needed " << num_iter_cold << " iterations, warm start " << num_iter_warm);
+
+  REQUIRE(num_iter_warm <= num_iter_cold);
+  for (size_t k = 0; k < 3; k += 1) {
+    REQUIRE(Q_up[k] == Approx(Q_up_cold[k]).epsilon(1e-12));
+    REQUIRE(A_up[k] == Approx(A_up_cold[k]).epsilon(1e-12));
+  }
+}
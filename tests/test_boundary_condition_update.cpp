@@ -0,0 +1,124 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+namespace {
+
+constexpr std::size_t degree = 2;
+constexpr double tau = 1e-4;
+
+struct Setup {
+  std::shared_ptr<mc::GraphStorage> graph;
+  std::shared_ptr<mc::DofMap> dof_map;
+  std::unique_ptr<mc::ExplicitNonlinearFlowSolver> solver;
+};
+
+Setup create_setup() {
+  Setup setup;
+  setup.graph = test_macrocirculation::util::create_3_vessel_network();
+  setup.graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*setup.graph, MPI_COMM_WORLD);
+  setup.dof_map = std::make_shared<mc::DofMap>(setup.graph->num_vertices(), setup.graph->num_edges());
+  setup.dof_map->create(MPI_COMM_WORLD, *setup.graph, 2, degree, false);
+  setup.solver = std::make_unique<mc::ExplicitNonlinearFlowSolver>(MPI_COMM_WORLD, setup.graph, setup.dof_map, degree);
+  setup.solver->use_ssp_method();
+  return setup;
+}
+
+} // namespace
+
+TEST_CASE("UnchangedBoundaryConditionsKeepTheSolution", "[BoundaryConditionUpdate]") {
+  auto reference = create_setup();
+  auto updated = create_setup();
+
+  for (std::size_t step = 0; step < 40; step += 1) {
+    const double t = static_cast<double>(step) * tau;
+    if (step == 20)
+      updated.solver->update_boundary_conditions();
+    reference.solver->solve(tau, t);
+    updated.solver->solve(tau, t);
+  }
+
+  REQUIRE(updated.dof_map->num_dof() == reference.dof_map->num_dof());
+  REQUIRE(updated.solver->get_solution() == reference.solver->get_solution());
+}
+
+TEST_CASE("WindkesselIsReplacedByVesselTree", "[BoundaryConditionUpdate]") {
+  auto setup = create_setup();
+  auto &graph = *setup.graph;
+  auto &dof_map = *setup.dof_map;
+  auto &solver = *setup.solver;
+  const int rank = mc::mpi::rank(MPI_COMM_WORLD);
+
+  double t = 0;
+  for (std::size_t step = 0; step < 20; step += 1, t += tau)
+    solver.solve(tau, t);
+
+  const auto u_old = solver.get_solution();
+  const auto old_dof_map = dof_map;
+  const auto num_old_dof = dof_map.num_dof();
+
+  // the windkessel at vertex 2 becomes a tree with three compartments, while vertex 3 is untouched
+  auto &v2 = graph.vertex(2);
+  const auto &data = v2.get_peripheral_vessel_data();
+  const std::vector<double> R{0.5 * data.resistance, 0.3 * data.resistance, 0.2 * data.resistance};
+  const std::vector<double> C{0.3 * data.compliance, 0.3 * data.compliance, 0.4 * data.compliance};
+  const double p_out = data.p_out;
+  v2.unfinalize_bcs();
+  v2.set_to_vessel_tree_outflow(p_out, R, C, {NAN, NAN, NAN}, 1);
+  v2.finalize_bcs();
+  solver.update_boundary_conditions();
+
+  // the edges keep their dofs and values
+  for (auto e_id : graph.get_active_edge_ids(rank)) {
+    const auto &local_dof_map = dof_map.get_local_dof_map(graph.edge(e_id));
+    REQUIRE(local_dof_map.first_dof(0, 0) == old_dof_map.get_local_dof_map(graph.edge(e_id)).first_dof(0, 0));
+    for (std::size_t k = 0; k < local_dof_map.num_local_dof(); k += 1)
+      REQUIRE(solver.get_solution()[local_dof_map.first_dof(0, 0) + k] == u_old[local_dof_map.first_dof(0, 0) + k]);
+  }
+
+  // the new compartments start from the old pressure of the windkessel, and the other windkessel keeps its value
+  std::size_t num_new_dof = 0;
+  if (dof_map.has_local_dof_map(v2)) {
+    const double p_c = u_old[old_dof_map.get_local_dof_map(v2).first_dof()];
+    const auto &local_dof_map = dof_map.get_local_dof_map(v2);
+    REQUIRE(local_dof_map.num_local_dof() == 3);
+    for (std::size_t k = 0; k < 3; k += 1)
+      REQUIRE(solver.get_solution()[local_dof_map.dof_index(k)] == p_c);
+    num_new_dof += 2;
+  }
+  const auto &v3 = graph.vertex(3);
+  if (dof_map.has_local_dof_map(v3))
+    REQUIRE(solver.get_solution()[dof_map.get_local_dof_map(v3).first_dof()] == u_old[old_dof_map.get_local_dof_map(v3).first_dof()]);
+  REQUIRE(dof_map.num_dof() == num_old_dof + num_new_dof);
+  REQUIRE(solver.get_solution().size() == dof_map.num_dof());
+
+  // the solver continues with the tree
+  for (std::size_t step = 0; step < 20; step += 1, t += tau)
+    solver.solve(tau, t);
+  for (auto value : solver.get_solution())
+    REQUIRE(std::isfinite(value));
+  if (dof_map.has_local_dof_map(v2)) {
+    const auto &local_dof_map = dof_map.get_local_dof_map(v2);
+    REQUIRE(solver.get_solution()[local_dof_map.dof_index(2)] != solver.get_solution()[local_dof_map.dof_index(0)]);
+  }
+}
@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "macrocirculation/boundary_function_cache.hpp"
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/nonlinear_flow_upwind_evaluator.hpp"
+#include "macrocirculation/vessel_formulas.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("BoundaryFunctionCacheEvaluatesOncePerTime", "[BoundaryFunctionCache]") {
+  std::size_t num_calls = 0;
+  mc::BoundaryFunctionCache cache;
+  const auto f = cache.add([&num_calls](double t) { num_calls += 1; return 2 * t; });
+  const auto g = cache.add(mc::tabulated_periodic_function([](double t) { return 1 + 2 * t; }, 1., 4));
+
+  cache.update(0.5);
+  cache.update(0.5);
+  REQUIRE(num_calls == 1);
+  REQUIRE(cache.num_evaluations() == 1);
+  REQUIRE(cache.get(f) == 1.);
+  REQUIRE(cache.get(g) == 2.);
+
+  // replacing a function forces a new evaluation at the same time
+  cache.set_tabulation(f, mc::tabulated_periodic_function([](double) { return 4.; }, 1., 1));
+  cache.update(0.5);
+  REQUIRE(num_calls == 1);
+  REQUIRE(cache.get(f) == 4.);
+}
+
+TEST_CASE("UpwindEvaluatorEvaluatesTheInflowOncePerStage", "[BoundaryFunctionCache]") {
+  const std::size_t degree = 2;
+  const auto rank = mc::mpi::rank(MPI_COMM_WORLD);
+
+  std::size_t num_calls = 0;
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  const std::size_t inflow_id = 0;
+  graph->get_vertex(inflow_id)->set_to_inflow_with_fixed_flow([&num_calls](double t) { num_calls += 1; return 1 + t; });
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+
+  // a vessel at rest
+  std::vector<double> u(dof_map->num_dof(), 0.);
+  for (auto e_id : graph->get_active_edge_ids(rank)) {
+    const auto &edge = graph->edge(e_id);
+    const auto &local_dof_map = dof_map->get_local_dof_map(edge);
+    for (std::size_t micro_edge = 0; micro_edge < local_dof_map.num_micro_edges(); micro_edge += 1)
+      local_dof_map.dof_values(u, micro_edge, 1)[0] = edge.get_physical_data().A0;
+  }
+
+  mc::NonlinearFlowUpwindEvaluator evaluator(MPI_COMM_WORLD, graph, dof_map);
+  const auto &active_edges = graph->get_active_edge_ids(rank);
+  const std::size_t inflow_edge_id = graph->get_vertex(inflow_id)->get_edge_neighbors()[0];
+  const bool has_inflow = std::find(active_edges.begin(), active_edges.end(), inflow_edge_id) != active_edges.end();
+
+  // the repeated init for the same stage time does not evaluate the inflow again
+  evaluator.init(0.5, u);
+  evaluator.init(0.5, u);
+  evaluator.init(0.75, u);
+  REQUIRE(num_calls == (has_inflow ? 2 : 0));
+  REQUIRE(evaluator.get_inflow_cache().size() == (has_inflow ? 1 : 0));
+
+  double Q_l, A_l, Q_r, A_r;
+  if (has_inflow) {
+    evaluator.get_fluxes_at_macro_edge_boundaries(0.75, inflow_edge_id, Q_l, A_l, Q_r, A_r);
+    REQUIRE(Q_l == Approx(1.75));
+  }
+
+  // a registered tabulation replaces the function
+  evaluator.set_inflow_tabulation(inflow_id, mc::tabulated_periodic_function([](double) { return 3.; }, 1., 1));
+  evaluator.init(1., u);
+  REQUIRE(num_calls == (has_inflow ? 2 : 0));
+  if (has_inflow) {
+    evaluator.get_fluxes_at_macro_edge_boundaries(1., inflow_edge_id, Q_l, A_l, Q_r, A_r);
+    REQUIRE(Q_l == Approx(3.));
+  }
+}
@@ -0,0 +1,52 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <vector>
+
+#include "macrocirculation/case_scheduler.hpp"
+#include "macrocirculation/communication/mpi.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("CaseSchedulerRunsEveryCaseOnceAndGathersTheResults", "[CaseScheduler]") {
+  const std::size_t num_cases = 7;
+  const auto size = static_cast<std::size_t>(mc::mpi::size(MPI_COMM_WORLD));
+
+  for (std::size_t ranks_per_case : {1, 2}) {
+    mc::CaseScheduler scheduler(MPI_COMM_WORLD, ranks_per_case);
+    REQUIRE(scheduler.num_groups() == std::max<std::size_t>(1, size / ranks_per_case));
+    REQUIRE(scheduler.get_group() < scheduler.num_groups());
+
+    // the scheduler can be reused for several sweeps
+    for (std::size_t sweep = 0; sweep < 2; sweep += 1) {
+      std::vector<double> num_runs(num_cases, 0.);
+
+      const auto results = scheduler.run(num_cases, [&](std::size_t case_index, MPI_Comm case_comm) {
+        // all the ranks of a group take part in the case
+        double sum = case_index;
+        MPI_Allreduce(MPI_IN_PLACE, &sum, 1, MPI_DOUBLE, MPI_SUM, case_comm);
+        if (mc::mpi::rank(case_comm) == 0)
+          num_runs[case_index] += 1;
+        return std::vector<double>(case_index % 3, sum / mc::mpi::size(case_comm) + static_cast<double>(sweep));
+      });
+
+      MPI_Allreduce(MPI_IN_PLACE, num_runs.data(), static_cast<int>(num_cases), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+      for (std::size_t k = 0; k < num_cases; k += 1)
+        REQUIRE(num_runs[k] == 1);
+
+      if (mc::mpi::rank(MPI_COMM_WORLD) == 0) {
+        REQUIRE(results.size() == num_cases);
+        for (std::size_t k = 0; k < num_cases; k += 1)
+          REQUIRE(results[k] == std::vector<double>(k % 3, static_cast<double>(k + sweep)));
+      } else {
+        REQUIRE(results.empty());
+      }
+    }
+  }
+}
@@ -0,0 +1,89 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "macrocirculation/checkpoint.hpp"
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+namespace {
+
+constexpr std::size_t degree = 2;
+constexpr double tau = 1e-4;
+
+/*! @brief The 3 vessel network with a solver distributed on the given communicator. */
+struct Setup {
+  std::shared_ptr<mc::GraphStorage> graph;
+  std::shared_ptr<mc::DofMap> dof_map;
+  std::unique_ptr<mc::ExplicitNonlinearFlowSolver> solver;
+
+  explicit Setup(MPI_Comm comm)
+      : graph(test_macrocirculation::util::create_3_vessel_network()) {
+    graph->finalize_bcs();
+    mc::naive_mesh_partitioner(*graph, comm);
+    dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+    dof_map->create(comm, *graph, 2, degree, false);
+    solver = std::make_unique<mc::ExplicitNonlinearFlowSolver>(comm, graph, dof_map, degree);
+    solver->use_ssp_method();
+  }
+
+  void run(double &t, double t_end) {
+    while (t < t_end - 1e-12) {
+      solver->solve(tau, t);
+      t += tau;
+    }
+  }
+};
+
+} // namespace
+
+TEST_CASE("CheckpointRestartOnDifferentPartitioning", "[Checkpoint]") {
+  const std::string path = "checkpoint_test";
+
+  // run on all the ranks and write the checkpoint in the middle
+  Setup world(MPI_COMM_WORLD);
+  double t = 0;
+  world.run(t, 0.01);
+  world.solver->write_checkpoint(path, t);
+  world.run(t, 0.02);
+
+  // every rank restarts on its own with the whole network, which redistributes the checkpoint for more than one rank
+  Setup self(MPI_COMM_SELF);
+  double t_restart = self.solver->read_checkpoint(path);
+  REQUIRE(t_restart == Approx(0.01));
+  self.run(t_restart, 0.02);
+
+  for (auto e_id : world.graph->get_active_edge_ids(mc::mpi::rank(MPI_COMM_WORLD))) {
+    double A, Q, A_restart, Q_restart;
+    world.solver->evaluate_1d_AQ_values(*world.graph->get_edge(e_id), 0.5, A, Q);
+    self.solver->evaluate_1d_AQ_values(*self.graph->get_edge(e_id), 0.5, A_restart, Q_restart);
+    // only the initial guesses of the newton iterations differ
+    REQUIRE(A_restart == Approx(A).epsilon(1e-8));
+    REQUIRE(Q_restart == Approx(Q).epsilon(1e-8));
+  }
+
+  // a different dof layout is rejected
+  auto other_dof_map = std::make_shared<mc::DofMap>(self.graph->num_vertices(), self.graph->num_edges());
+  other_dof_map->create(MPI_COMM_SELF, *self.graph, 2, degree + 1, false);
+  std::vector<double> u(other_dof_map->num_dof());
+  REQUIRE_THROWS(mc::read_checkpoint(MPI_COMM_SELF, path, *self.graph, *other_dof_map, u));
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  std::remove(mc::checkpoint_file_path(path, mc::mpi::rank(MPI_COMM_WORLD)).c_str());
+}
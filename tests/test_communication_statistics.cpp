@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <memory>
+#include <vector>
+
+#include "macrocirculation/communication/buffer.hpp"
+#include "macrocirculation/communication/communication_statistics.hpp"
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/communicator.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/synthetic_network.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("BufferSystemCountsEmptyMessagesAndProbes", "[CommunicationStatistics]") {
+  const auto rank = static_cast<std::size_t>(mc::mpi::rank(MPI_COMM_WORLD));
+  const auto size = static_cast<std::size_t>(mc::mpi::size(MPI_COMM_WORLD));
+  const std::size_t num_exchanges = 4;
+
+  // every rank only sends data to its right neighbor, but the buffer system sends to all the ranks
+  mc::BufferSystem bs(MPI_COMM_WORLD, 43);
+  const std::size_t dst = (rank + 1) % size;
+  const std::size_t src = (rank + size - 1) % size;
+  for (std::size_t k = 0; k < num_exchanges; k += 1) {
+    bs.clear();
+    bs.get_send_buffer(dst) << 1. << 2.;
+    bs.start_communication();
+    bs.end_communication();
+    double a, b;
+    bs.get_receive_buffer(src) >> a >> b;
+  }
+
+  const auto &statistics = bs.get_statistics();
+  REQUIRE(statistics.num_ranks() == size);
+  for (std::size_t other = 0; other < size; other += 1) {
+    const auto &n = statistics.get(other);
+    const bool is_self = other == rank;
+    REQUIRE(n.messages_sent == (is_self ? 0 : num_exchanges));
+    REQUIRE(n.probes == (is_self ? 0 : num_exchanges));
+    REQUIRE(n.bytes_sent == (!is_self && other == dst ? num_exchanges * 2 * sizeof(double) : 0));
+    REQUIRE(n.empty_messages == (!is_self && other != dst ? num_exchanges : 0));
+    REQUIRE(n.wait_seconds >= 0);
+  }
+
+  const auto total = statistics.total();
+  REQUIRE(total.messages_sent == num_exchanges * (size - 1));
+  REQUIRE(total.empty_messages == num_exchanges * (size > 1 ? size - 2 : 0));
+
+  bs.reset_statistics();
+  REQUIRE(bs.get_statistics().total().messages_sent == 0);
+}
+
+TEST_CASE("CommunicatorOnlySendsToNeighbors", "[CommunicationStatistics]") {
+  const auto size = static_cast<std::size_t>(mc::mpi::size(MPI_COMM_WORLD));
+  const std::size_t num_updates = 5;
+  const std::size_t num_values_per_boundary = 2;
+
+  mc::SyntheticTreeParameters parameters;
+  parameters.depth = 4;
+  auto graph = mc::create_synthetic_arterial_tree(parameters);
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+
+  auto communicator = mc::Communicator::create_edge_boundary_value_communicator(MPI_COMM_WORLD, graph, num_values_per_boundary);
+  std::vector<double> u(2 * num_values_per_boundary * graph->num_edges(), 1.);
+  for (std::size_t k = 0; k < num_updates; k += 1)
+    communicator.update_ghost_layer(u);
+
+  // the persistent exchange never sends empty messages and needs no probes
+  const auto total = communicator.get_statistics().total();
+  REQUIRE(total.messages_sent == num_updates * communicator.num_send_neighbors());
+  REQUIRE(total.bytes_sent == num_updates * communicator.num_send_values() * sizeof(double));
+  REQUIRE(total.empty_messages == 0);
+  REQUIRE(total.probes == 0);
+
+  // the ghost layers are symmetric, hence a rank sends to every rank, from which it receives
+  const auto bytes = communicator.get_statistics().gather_neighbor_matrix(MPI_COMM_WORLD, mc::CommunicationStatistics::Quantity::bytes_sent);
+  if (mc::mpi::rank(MPI_COMM_WORLD) == 0) {
+    REQUIRE(bytes.size() == size * size);
+    for (std::size_t r = 0; r < size; r += 1) {
+      REQUIRE(bytes[r * size + r] == 0);
+      for (std::size_t s = 0; s < size; s += 1)
+        REQUIRE((bytes[r * size + s] > 0) == (bytes[s * size + r] > 0));
+    }
+  } else {
+    REQUIRE(bytes.empty());
+  }
+}
@@ -0,0 +1,181 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <cmath>
+#include <memory>
+
+#include "macrocirculation/coupled_explicit_implicit_1d_solver.hpp"
+#include "macrocirculation/coupled_network_scheduler.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/implicit_linear_flow_solver.hpp"
+#include "macrocirculation/vessel_formulas.hpp"
+
+namespace mc = macrocirculation;
+
+namespace {
+
+/*! @brief Creates a graph with a single vessel. */
+std::shared_ptr<mc::GraphStorage> create_line(double radius, double length, double x_start) {
+  auto graph = std::make_shared<mc::GraphStorage>();
+  auto v0 = graph->create_vertex();
+  auto v1 = graph->create_vertex();
+  auto edge = graph->connect(*v0, *v1, 10);
+  edge->add_embedding_data({{mc::Point(x_start, 0, 0), mc::Point(x_start + length, 0, 0)}});
+  edge->add_physical_data(mc::PhysicalData::set_from_data(400000.0, 0.067, 1.028e-3, 9, radius, length));
+  return graph;
+}
+
+std::shared_ptr<mc::DofMap> create_dof_map(const mc::GraphStorage &graph, std::size_t degree) {
+  auto dof_map = std::make_shared<mc::DofMap>(graph.num_vertices(), graph.num_edges());
+  dof_map->create(MPI_COMM_WORLD, graph, 2, degree, false);
+  return dof_map;
+}
+
+/*! @brief Returns p and q at the vertex on all the ranks. */
+template<typename Solver>
+void get_pq(const Solver &solver, const mc::GraphStorage &graph, const mc::Vertex &v, double &p, double &q) {
+  int rank = 0;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  const int edge_rank = graph.edge(v.get_edge_neighbors()[0]).rank();
+  if (edge_rank == rank)
+    solver.get_1d_pq_values_at_vertex(v, p, q);
+  MPI_Bcast(&p, 1, MPI_DOUBLE, edge_rank, MPI_COMM_WORLD);
+  MPI_Bcast(&q, 1, MPI_DOUBLE, edge_rank, MPI_COMM_WORLD);
+}
+
+} // namespace
+
+TEST_CASE("SchedulerSynchronizesAtTheLargestTimeStep", "[CoupledNetworkScheduler]") {
+  auto graph_1 = create_line(0.4, 10., 0.);
+  auto graph_2 = create_line(0.3, 2., 10.);
+  for (auto &graph : {graph_1, graph_2}) {
+    graph->get_vertex(0)->set_to_free_outflow();
+    graph->get_vertex(1)->set_to_free_outflow();
+    graph->finalize_bcs();
+    mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+  }
+
+  mc::ExplicitNonlinearFlowSolver solver_1(MPI_COMM_WORLD, graph_1, create_dof_map(*graph_1, 2), 2);
+  mc::ExplicitNonlinearFlowSolver solver_2(MPI_COMM_WORLD, graph_2, create_dof_map(*graph_2, 2), 2);
+
+  mc::CoupledNetworkScheduler scheduler(MPI_COMM_WORLD);
+  const auto n_1 = scheduler.add_network(graph_1, solver_1, 2.5e-5);
+  const auto n_2 = scheduler.add_network(graph_2, solver_2, 1e-4);
+  scheduler.setup(0);
+  REQUIRE(scheduler.get_synchronization_interval() == 1e-4);
+  REQUIRE(scheduler.num_steps(n_1) == 4);
+  REQUIRE(scheduler.num_steps(n_2) == 1);
+
+  mc::CoupledNetworkScheduler bad_scheduler(MPI_COMM_WORLD);
+  bad_scheduler.add_network(graph_1, solver_1, 3e-5);
+  bad_scheduler.add_network(graph_2, solver_2, 1e-4);
+  REQUIRE_THROWS(bad_scheduler.setup(0));
+}
+
+/*! @brief Checks that a large vessel and a small vessel with a fourth of the time step agree on the flow at their connection. */
+TEST_CASE("MultirateNonlinearNetworksAreContinuous", "[CoupledNetworkScheduler]") {
+  const double q_in = 1.;
+
+  auto graph_1 = create_line(0.4, 10., 0.);
+  auto graph_2 = create_line(0.3, 2., 10.);
+  auto &v0 = *graph_1->get_vertex(0);
+  auto &v1 = *graph_1->get_vertex(1);
+  auto &v2 = *graph_2->get_vertex(0);
+  auto &v3 = *graph_2->get_vertex(1);
+
+  const auto &param_1 = graph_1->edge(0).get_physical_data();
+  const auto &param_2 = graph_2->edge(0).get_physical_data();
+
+  v0.set_to_inflow_with_fixed_flow([=](double) { return q_in; });
+  mc::Vertex::connect(graph_1, v1, graph_2, v2);
+  v1.set_to_nonlinear_characteristic_inflow(param_2.G0, param_2.A0, param_2.rho, false, 0, 0);
+  v2.set_to_nonlinear_characteristic_inflow(param_1.G0, param_1.A0, param_1.rho, true, 0, 0);
+  v3.set_to_free_outflow();
+
+  for (auto &graph : {graph_1, graph_2}) {
+    graph->finalize_bcs();
+    mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+  }
+
+  mc::ExplicitNonlinearFlowSolver solver_1(MPI_COMM_WORLD, graph_1, create_dof_map(*graph_1, 2), 2);
+  mc::ExplicitNonlinearFlowSolver solver_2(MPI_COMM_WORLD, graph_2, create_dof_map(*graph_2, 2), 2);
+  solver_1.use_ssp_method();
+  solver_2.use_ssp_method();
+
+  mc::CoupledNetworkScheduler scheduler(MPI_COMM_WORLD);
+  scheduler.add_network(graph_1, solver_1, 1e-4);
+  scheduler.add_network(graph_2, solver_2, 2.5e-5);
+  scheduler.setup(0);
+
+  double t = 0;
+  for (std::size_t k = 0; k < 15000; k += 1) {
+    scheduler.solve(t);
+    t += scheduler.get_synchronization_interval();
+  }
+
+  double p_1, q_1, p_2, q_2;
+  get_pq(solver_1, *graph_1, v1, p_1, q_1);
+  get_pq(solver_2, *graph_2, v2, p_2, q_2);
+  REQUIRE(q_1 == Approx(q_in).epsilon(1e-3));
+  REQUIRE(q_2 == Approx(q_in).epsilon(1e-3));
+  REQUIRE(p_2 == Approx(p_1).epsilon(1e-2));
+}
+
+/*! @brief Checks an explicit aorta with an implicit periphery, which is moved to another rank if possible. */
+TEST_CASE("MultirateExplicitImplicitNetworksAreContinuous", "[CoupledNetworkScheduler]") {
+  const double q_in = 1.;
+
+  int size = 1;
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  auto graph_nl = create_line(0.4, 10., 0.);
+  auto graph_li = create_line(0.3, 2., 10.);
+  auto &v0 = *graph_nl->get_vertex(0);
+  auto &v1 = *graph_nl->get_vertex(1);
+  auto &v2 = *graph_li->get_vertex(0);
+  auto &v3 = *graph_li->get_vertex(1);
+
+  v0.set_to_inflow_with_fixed_flow([=](double) { return q_in; });
+  v3.set_to_free_outflow();
+  mc::Vertex::connect(graph_nl, v1, graph_li, v2);
+  mc::CoupledExplicitImplicit1DSolver::setup_coupling_bcs(graph_nl, graph_li);
+
+  graph_nl->finalize_bcs();
+  graph_li->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph_nl, MPI_COMM_WORLD);
+  mc::naive_mesh_partitioner(*graph_li, MPI_COMM_WORLD);
+  graph_li->assign_edge_to_rank(graph_li->edge(0), size - 1);
+
+  mc::ExplicitNonlinearFlowSolver solver_nl(MPI_COMM_WORLD, graph_nl, create_dof_map(*graph_nl, 2), 2);
+  solver_nl.use_ssp_method();
+  mc::ImplicitLinearFlowSolver solver_li(MPI_COMM_WORLD, graph_li, mc::ImplicitLinearFlowSolver::create_dof_map(MPI_COMM_WORLD, *graph_li, 2), 2);
+
+  mc::CoupledNetworkScheduler scheduler(MPI_COMM_WORLD);
+  scheduler.add_network(graph_nl, solver_nl, 1e-4);
+  scheduler.add_network(graph_li, solver_li, 1e-3);
+  scheduler.setup(0);
+
+  double t = 0;
+  for (std::size_t k = 0; k < 1500; k += 1) {
+    scheduler.solve(t);
+    t += scheduler.get_synchronization_interval();
+  }
+
+  double p_nl, q_nl, p_li, q_li;
+  get_pq(solver_nl, *graph_nl, v1, p_nl, q_nl);
+  get_pq(solver_li, *graph_li, v2, p_li, q_li);
+
+  // both sides upwind the coupling with their own model, hence the traces agree only up to the linearization
+  REQUIRE(q_nl == Approx(q_in).epsilon(1e-2));
+  REQUIRE(q_li == Approx(q_in).epsilon(1e-2));
+  REQUIRE(p_li == Approx(p_nl).epsilon(1e-2));
+}
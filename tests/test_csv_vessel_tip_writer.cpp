@@ -0,0 +1,124 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/csv_vessel_tip_writer.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+namespace {
+
+/*! @brief Returns the whitespace separated entries of every line of the file. */
+std::vector<std::vector<std::string>> read_rows(const std::string &filepath) {
+  std::vector<std::vector<std::string>> rows;
+  std::ifstream f(filepath);
+  std::string line;
+  while (std::getline(f, line)) {
+    std::stringstream ss(line);
+    std::vector<std::string> row;
+    std::string entry;
+    while (ss >> entry)
+      row.push_back(entry);
+    rows.push_back(row);
+  }
+  return rows;
+}
+
+} // namespace
+
+TEST_CASE("GatheredVesselTipOutputAgreesWithTheFilesPerVertex", "[CSVVesselTipWriter]") {
+  const std::size_t degree = 2;
+  const double tau = 1e-4;
+  const std::size_t num_writes = 5;
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, degree);
+  solver.use_ssp_method();
+
+  {
+    mc::CSVVesselTipWriter vertex_writer(MPI_COMM_WORLD, ".", "tips_per_vertex", graph, dof_map);
+    mc::CSVVesselTipWriter gathered_writer(MPI_COMM_WORLD, ".", "tips_gathered", graph, dof_map);
+    gathered_writer.set_gathered(true);
+
+    double t = 0;
+    for (std::size_t k = 0; k < num_writes; k += 1) {
+      for (std::size_t step = 0; step < 10; step += 1, t += tau)
+        solver.solve(tau, t);
+      vertex_writer.write(t, solver.get_solution());
+      gathered_writer.write(t, solver.get_solution());
+    }
+
+    REQUIRE_THROWS(gathered_writer.set_gathered(false));
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  if (mc::mpi::rank(MPI_COMM_WORLD) == 0) {
+    nlohmann::json vertex_meta;
+    nlohmann::json gathered_meta;
+    std::ifstream("tips_per_vertex.json") >> vertex_meta;
+    std::ifstream("tips_gathered.json") >> gathered_meta;
+    REQUIRE(gathered_meta["times"].size() == num_writes);
+    REQUIRE(gathered_meta["vertices"].size() == vertex_meta["vertices"].size());
+    REQUIRE(gathered_meta["vertices"].size() == 2);
+
+    const auto values = read_rows(gathered_meta["filepaths_gathered"]["filepath_p"].get<std::string>());
+    const auto p_out = read_rows(gathered_meta["filepaths_gathered"]["filepath_p_out"].get<std::string>());
+    REQUIRE(values.size() == num_writes);
+    REQUIRE(p_out.size() == num_writes);
+
+    std::size_t num_columns = 0;
+    for (std::size_t i = 0; i < gathered_meta["vertices"].size(); i += 1) {
+      const auto &vertex = vertex_meta["vertices"][i];
+      const auto &gathered_vertex = gathered_meta["vertices"][i];
+      REQUIRE(!gathered_vertex.contains("filepaths"));
+      REQUIRE(gathered_vertex["vertex_id"] == vertex["vertex_id"]);
+      REQUIRE(gathered_vertex["num_dofs"] == vertex["num_dofs"]);
+
+      // the columns of the vertices follow each other
+      const auto column = gathered_vertex["column"].get<std::size_t>();
+      const auto num_dofs = gathered_vertex["num_dofs"].get<std::size_t>();
+      REQUIRE(column == num_columns);
+      num_columns += num_dofs;
+
+      const auto vertex_values = read_rows(vertex["filepaths"]["filepath_p"].get<std::string>());
+      const auto vertex_p_out = read_rows(vertex["filepath_p_out"].get<std::string>());
+      REQUIRE(vertex_values.size() == num_writes);
+      for (std::size_t k = 0; k < num_writes; k += 1) {
+        REQUIRE(vertex_values[k] == std::vector<std::string>(values[k].begin() + column, values[k].begin() + column + num_dofs));
+        REQUIRE(vertex_p_out[k].front() == p_out[k][gathered_vertex["column_p_out"].get<std::size_t>()]);
+      }
+    }
+    for (const auto &row : values)
+      REQUIRE(row.size() == num_columns);
+
+    // no files per vertex are created in the gathered mode
+    REQUIRE(!std::ifstream(vertex_meta["vertices"][0]["filepaths"]["filepath_p"].get<std::string>().replace(0, std::string("tips_per_vertex").size(), "tips_gathered")).good());
+  }
+}
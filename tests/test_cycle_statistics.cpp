@@ -0,0 +1,100 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/cycle_statistics.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/vessel_formulas.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("CycleStatisticsOfAPeriodicSignal", "[CycleStatistics]") {
+  const auto rank = mc::mpi::rank(MPI_COMM_WORLD);
+  const std::size_t degree = 2;
+  const double period = 0.8;
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+
+  // the flow on edge e and micro edge m is (e+1) sin(2 pi t / T) + m, the area oscillates by 10 percent
+  const auto set_solution = [&](double t, std::vector<double> &u) {
+    const double s = std::sin(2 * M_PI * t / period);
+    for (auto e_id : graph->get_active_edge_ids(rank)) {
+      const auto &edge = *graph->get_edge(e_id);
+      const auto &local_dof_map = dof_map->get_local_dof_map(edge);
+      for (std::size_t m = 0; m < local_dof_map.num_micro_edges(); m += 1) {
+        auto q = local_dof_map.dof_values(u, m, mc::ExplicitNonlinearFlowSolver::Q_component);
+        auto a = local_dof_map.dof_values(u, m, mc::ExplicitNonlinearFlowSolver::A_component);
+        q[0] = (e_id + 1.) * s + m;
+        a[0] = edge.get_physical_data().A0 * (1 + 0.1 * s);
+        // the higher coefficients do not change the averages
+        q[1] = a[1] = 1.;
+      }
+    }
+  };
+
+  const std::string dataset = "cycle_statistics_test";
+  mc::CycleStatistics statistics(MPI_COMM_WORLD, ".", dataset, graph, dof_map, period);
+
+  std::vector<double> u(dof_map->num_dof(), 0.);
+  const double tau = 1e-3;
+  std::size_t num_completed = 0;
+  for (double t = 0.3; t < 3 * period + 0.3; t += tau) {
+    set_solution(t, u);
+    if (statistics.update(t, u))
+      num_completed += 1;
+  }
+
+  // the periods [T, 2T] and [2T, 3T] are complete, the beginning is ignored
+  REQUIRE(num_completed == 2);
+  REQUIRE(statistics.get_num_periods() == 2);
+
+  std::size_t k = 0;
+  for (auto e_id : graph->get_active_edge_ids(rank)) {
+    const auto &edge = *graph->get_edge(e_id);
+    const auto &param = edge.get_physical_data();
+    for (std::size_t m = 0; m < edge.num_micro_edges(); m += 1, k += 1) {
+      const auto &s = statistics.get_statistics()[k];
+      REQUIRE(s.q_max == Approx(e_id + 1. + m).epsilon(1e-5));
+      REQUIRE(s.q_min == Approx(-(e_id + 1.) + m).epsilon(1e-5));
+      REQUIRE(s.q_integral / period == Approx(m).margin(1e-6));
+      REQUIRE(s.t_q_max == Approx(2 * period + period / 4).margin(tau));
+      REQUIRE(s.p_max == Approx(mc::nonlinear::get_p_from_A(1.1 * param.A0, param.G0, param.A0)).epsilon(1e-5));
+      REQUIRE(s.p_min == Approx(mc::nonlinear::get_p_from_A(0.9 * param.A0, param.G0, param.A0)).epsilon(1e-5));
+    }
+  }
+  REQUIRE(k == statistics.get_statistics().size());
+
+  // every micro edge has a line per period after the header
+  std::ifstream f("./" + dataset + "_" + std::to_string(rank) + ".csv");
+  std::size_t num_lines = 0;
+  for (std::string line; std::getline(f, line);)
+    num_lines += 1;
+  REQUIRE(num_lines == 1 + 2 * k);
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  std::remove(("./" + dataset + "_" + std::to_string(rank) + ".csv").c_str());
+  if (rank == 0)
+    std::remove(("./" + dataset + ".json").c_str());
+}
@@ -0,0 +1,220 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/degree_adaptivity.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/fe_type.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+namespace {
+
+/*! @brief Runs the 3 vessel network until t_end with the given degrees of the edges and returns A and Q at the midpoints. */
+std::vector<double> run_with_degrees(const std::vector<std::size_t> &edge_degrees, double t_end, mc::QuadratureType quadrature = mc::QuadratureType::gauss) {
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, 2, false);
+
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, 2);
+  solver.use_ssp_method();
+  solver.set_edge_degrees(edge_degrees);
+  solver.set_quadrature_type(quadrature);
+  REQUIRE(mc::get_edge_degrees(MPI_COMM_WORLD, *graph, *dof_map) == edge_degrees);
+
+  const double tau = 2.5e-5;
+  double t = 0;
+  while (t < t_end - 1e-12) {
+    solver.solve(tau, t);
+    t += tau;
+  }
+
+  std::vector<double> values(2 * graph->num_edges(), 0);
+  for (auto e_id : graph->get_active_edge_ids(mc::mpi::rank(MPI_COMM_WORLD)))
+    solver.evaluate_1d_AQ_values(graph->edge(e_id), 0.5, values[2 * e_id], values[2 * e_id + 1]);
+  MPI_Allreduce(MPI_IN_PLACE, values.data(), static_cast<int>(values.size()), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  return values;
+}
+
+} // namespace
+
+TEST_CASE("LegendreBasisIsOrthogonalUpToTheHighestDegree", "[DegreeAdaptivity]") {
+  for (std::size_t degree = 0; degree <= mc::max_fe_degree; degree += 1) {
+    const auto qf = mc::create_gauss_for_degree(degree);
+    REQUIRE(qf.size() == mc::num_gauss_points(degree));
+
+    mc::FETypeNetwork fe(qf, degree);
+    fe.reinit(0.5);
+
+    for (std::size_t i = 0; i <= degree; i += 1) {
+      for (std::size_t j = 0; j <= degree; j += 1) {
+        double mass = 0;
+        for (std::size_t qp = 0; qp < fe.num_quad_points(); qp += 1)
+          mass += fe.get_phi()[i][qp] * fe.get_phi()[j][qp] * fe.get_JxW()[qp];
+        const double expected = i == j ? mc::legendre_weight(i) * 0.25 : 0.;
+        REQUIRE(mass == Approx(expected).margin(1e-13));
+
+        // testing with the mass scaled tables inverts the mass matrix
+        double identity = 0;
+        for (std::size_t qp = 0; qp < fe.num_quad_points(); qp += 1)
+          identity += fe.get_mass_scaled_phi_JxW()[i][qp] * fe.get_phi()[j][qp];
+        REQUIRE(identity == Approx(i == j ? 1. : 0.).margin(1e-12));
+      }
+      REQUIRE(fe.get_mass_scaled_phi_boundary()[1][i] == Approx(fe.get_inverse_mass()[i]));
+
+      // the derivatives are scaled with the length of the micro edge
+      const double x = fe.get_quadrature_formula().ref_points[0];
+      const double h = 1e-6;
+      const double dphi = (mc::evaluate_legendre(x + h)[i] - mc::evaluate_legendre(x - h)[i]) / (2 * h) * 2. / 0.5;
+      REQUIRE(fe.get_dphi()[i][0] == Approx(dphi).epsilon(1e-6));
+    }
+  }
+}
+
+TEST_CASE("GaussFormulasMatchTheDegree", "[DegreeAdaptivity]") {
+  // the midpoint rule for constants and the gauss3 rule for linear shape functions
+  REQUIRE(mc::num_gauss_points(0) == 1);
+  REQUIRE(mc::num_gauss_points(1) == 3);
+
+  const auto integrates_exactly = [](const mc::QuadratureFormula &qf, std::size_t max_degree) {
+    for (std::size_t p = 0; p <= max_degree; p += 1) {
+      double integral = 0;
+      for (std::size_t qp = 0; qp < qf.size(); qp += 1)
+        integral += qf.ref_weights[qp] * std::pow(qf.ref_points[qp], p);
+      REQUIRE(integral == Approx(p % 2 == 0 ? 2. / (p + 1.) : 0.).margin(1e-13));
+    }
+  };
+
+  for (std::size_t degree = 1; degree <= mc::max_fe_degree; degree += 1) {
+    integrates_exactly(mc::create_quadrature_for_degree(mc::QuadratureType::gauss, degree), 2 * degree + 3);
+    integrates_exactly(mc::create_quadrature_for_degree(mc::QuadratureType::gauss_over_integration, degree), 3 * degree + 3);
+    REQUIRE(mc::num_over_integration_points(degree) > mc::num_gauss_points(degree));
+  }
+}
+
+TEST_CASE("GaussLobattoFormulasContainTheEndpointsAndLumpTheMass", "[DegreeAdaptivity]") {
+  for (std::size_t degree = 0; degree <= mc::max_fe_degree; degree += 1) {
+    const auto qf = mc::create_quadrature_for_degree(mc::QuadratureType::gauss_lobatto, degree);
+    REQUIRE(qf.size() == mc::num_quadrature_points(mc::QuadratureType::gauss_lobatto, degree));
+    REQUIRE(qf.ref_points.front() == Approx(-1.));
+    REQUIRE(qf.ref_points.back() == Approx(+1.));
+
+    // the formula is exact up to the degree 2 n - 3
+    const std::size_t exact_degree = 2 * qf.size() - 3;
+    for (std::size_t p = 0; p <= exact_degree; p += 1) {
+      double integral = 0;
+      for (std::size_t qp = 0; qp < qf.size(); qp += 1)
+        integral += qf.ref_weights[qp] * std::pow(qf.ref_points[qp], p);
+      REQUIRE(integral == Approx(p % 2 == 0 ? 2. / (p + 1.) : 0.).margin(1e-13));
+    }
+
+    // only the mass of the highest legendre polynomial is lumped, i.e. 2 / degree instead of 2 / (2 degree + 1)
+    mc::FETypeNetwork fe(qf, degree, true);
+    fe.reinit(0.5);
+    for (std::size_t i = 0; i <= degree; i += 1) {
+      const double ref_mass = (i == degree && degree > 0) ? 2. / degree : mc::legendre_weight(i);
+      REQUIRE(fe.get_inverse_mass()[i] == Approx(1. / (ref_mass * 0.25)));
+      for (std::size_t j = 0; j <= degree; j += 1) {
+        double identity = 0;
+        for (std::size_t qp = 0; qp < fe.num_quad_points(); qp += 1)
+          identity += fe.get_mass_scaled_phi_JxW()[i][qp] * fe.get_phi()[j][qp];
+        REQUIRE(identity == Approx(i == j ? 1. : 0.).margin(1e-12));
+      }
+    }
+  }
+}
+
+TEST_CASE("GaussLobattoCollocationAgreesWithGauss", "[DegreeAdaptivity]") {
+  const double t_end = 0.2;
+  const auto gauss = run_with_degrees({3, 3, 3}, t_end);
+  const auto lobatto = run_with_degrees({3, 3, 3}, t_end, mc::QuadratureType::gauss_lobatto);
+  for (std::size_t k = 0; k < gauss.size(); k += 1)
+    REQUIRE(lobatto[k] == Approx(gauss[k]).epsilon(1e-3));
+}
+
+TEST_CASE("OverIntegrationAgreesWithGauss", "[DegreeAdaptivity]") {
+  const double t_end = 0.2;
+  const auto gauss = run_with_degrees({1, 2, 3}, t_end);
+  const auto over_integration = run_with_degrees({1, 2, 3}, t_end, mc::QuadratureType::gauss_over_integration);
+  for (std::size_t k = 0; k < gauss.size(); k += 1)
+    REQUIRE(over_integration[k] == Approx(gauss[k]).epsilon(1e-3));
+}
+
+TEST_CASE("SmoothnessIndicatorMeasuresTheHighestMode", "[DegreeAdaptivity]") {
+  // two micro edges with a single component and degree 2
+  mc::LocalEdgeDofMap local_dof_map(0, 1, 3, 2);
+  const std::vector<double> u{1, 0, 0.1, 1, 0.5, 0.01};
+
+  // the first micro edge has the larger share of the highest mode
+  const double share = 0.4 * 0.1 * 0.1 / (2 + 0.4 * 0.1 * 0.1);
+  REQUIRE(mc::smoothness_indicator(local_dof_map, u, 0) == Approx(std::log10(share)));
+
+  mc::LocalEdgeDofMap constant_dof_map(0, 1, 1, 2);
+  REQUIRE(std::isinf(mc::smoothness_indicator(constant_dof_map, u, 0)));
+}
+
+TEST_CASE("MixedDegreesAgreeWithTheUniformDegree", "[DegreeAdaptivity]") {
+  const double t_end = 0.2;
+  const auto uniform = run_with_degrees({2, 2, 2}, t_end);
+  const auto mixed = run_with_degrees({2, 5, 3}, t_end);
+  for (std::size_t k = 0; k < uniform.size(); k += 1)
+    REQUIRE(mixed[k] == Approx(uniform[k]).epsilon(1e-3));
+}
+
+TEST_CASE("AdaptEdgeDegreesKeepsTheSolution", "[DegreeAdaptivity]") {
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, 2, false);
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, 2);
+
+  // the constant state at rest is perfectly smooth, hence every edge gets one degree more until the maximum
+  mc::DegreeAdaptivitySettings settings;
+  settings.max_degree = 4;
+  REQUIRE(solver.adapt_edge_degrees(settings));
+  REQUIRE(mc::get_edge_degrees(MPI_COMM_WORLD, *graph, *dof_map) == std::vector<std::size_t>(graph->num_edges(), 3));
+  REQUIRE(solver.adapt_edge_degrees(settings));
+  REQUIRE(!solver.adapt_edge_degrees(settings));
+  REQUIRE(mc::get_edge_degrees(MPI_COMM_WORLD, *graph, *dof_map) == std::vector<std::size_t>(graph->num_edges(), 4));
+
+  for (auto e_id : graph->get_active_edge_ids(mc::mpi::rank(MPI_COMM_WORLD))) {
+    double A, Q;
+    solver.evaluate_1d_AQ_values(graph->edge(e_id), 0.3, A, Q);
+    REQUIRE(A == Approx(graph->edge(e_id).get_physical_data().A0));
+    REQUIRE(Q == 0);
+  }
+
+  // the solver runs with the new degrees
+  double t = 0;
+  const double tau = solver.calculate_stable_time_step(0.5);
+  for (std::size_t k = 0; k < 10; k += 1) {
+    solver.solve(tau, t);
+    t += tau;
+  }
+  for (auto e_id : graph->get_active_edge_ids(mc::mpi::rank(MPI_COMM_WORLD))) {
+    double A, Q;
+    solver.evaluate_1d_AQ_values(graph->edge(e_id), 0.5, A, Q);
+    REQUIRE(std::isfinite(A));
+    REQUIRE(std::isfinite(Q));
+  }
+}
@@ -0,0 +1,108 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/errornorm.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/rcr_estimator.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("OrderedSumIsCompensated", "[DeterministicReductions]") {
+  const auto rank = static_cast<std::size_t>(mc::mpi::rank(MPI_COMM_WORLD));
+  const auto size = static_cast<std::size_t>(mc::mpi::size(MPI_COMM_WORLD));
+
+  // the naive sum of these values in their order is 0, while the exact sum is 2
+  const std::vector<double> values{1., 1e100, 1., -1e100};
+  std::vector<double> contributions(2 * values.size(), 0.);
+  for (std::size_t k = 0; k < values.size(); k += 1) {
+    if (k % size == rank) {
+      contributions[2 * k] = values[k];
+      contributions[2 * k + 1] = static_cast<double>(k);
+    }
+  }
+
+  const auto sums = mc::mpi::ordered_sum(MPI_COMM_WORLD, contributions, 2);
+  REQUIRE(sums.size() == 2);
+  REQUIRE(sums[0] == 2.);
+  REQUIRE(sums[1] == 6.);
+}
+
+/*! @brief Checks that the solution, the error norms and the capacitance on all the ranks with threads and task scheduling
+ *         are bitwise equal to the ones of a single rank.
+ */
+TEST_CASE("ResultsDoNotDependOnTheNumberOfRanks", "[DeterministicReductions]") {
+  const std::size_t degree = 2;
+  const double tau = 1e-4;
+  const std::size_t num_steps = 100;
+
+  struct Run {
+    std::shared_ptr<mc::GraphStorage> graph;
+    std::shared_ptr<mc::DofMap> dof_map;
+    std::vector<double> u;
+    std::vector<mc::Errornorms> errors;
+    double capacitance;
+  };
+
+  auto run = [=](MPI_Comm comm, bool optimized) {
+    Run result;
+    result.graph = test_macrocirculation::util::create_3_vessel_network();
+    result.graph->finalize_bcs();
+    mc::naive_mesh_partitioner(*result.graph, comm);
+
+    result.dof_map = std::make_shared<mc::DofMap>(result.graph->num_vertices(), result.graph->num_edges());
+    result.dof_map->create(comm, *result.graph, 2, degree, false);
+
+    mc::ExplicitNonlinearFlowSolver solver(comm, result.graph, result.dof_map, degree);
+    solver.use_ssp_method();
+    if (optimized) {
+      solver.set_num_threads(2);
+      solver.set_task_scheduling(true);
+    }
+    for (std::size_t step = 0; step < num_steps; step += 1)
+      solver.solve(tau, static_cast<double>(step) * tau);
+    result.u = solver.get_solution();
+
+    const mc::ErrornormEvaluator evaluator(comm, *result.graph, *result.dof_map);
+    auto sine = [](const std::vector<double> &s, std::vector<double> &values) {
+      for (std::size_t k = 0; k < s.size(); k += 1)
+        values[k] = std::sin(s[k]);
+    };
+    result.errors = evaluator.evaluate(result.u, {{0, sine}, {1, sine}});
+    result.capacitance = mc::get_total_edge_capacitance(result.graph, comm);
+    return result;
+  };
+
+  const auto serial = run(MPI_COMM_SELF, false);
+  const auto parallel = run(MPI_COMM_WORLD, true);
+
+  for (auto e_id : parallel.graph->get_active_edge_ids(mc::mpi::rank(MPI_COMM_WORLD))) {
+    const auto &local_dof_map = parallel.dof_map->get_local_dof_map(parallel.graph->edge(e_id));
+    const auto &serial_local_dof_map = serial.dof_map->get_local_dof_map(serial.graph->edge(e_id));
+    for (std::size_t k = 0; k < local_dof_map.num_local_dof(); k += 1)
+      REQUIRE(parallel.u[local_dof_map.first_dof(0, 0) + k] == serial.u[serial_local_dof_map.first_dof(0, 0) + k]);
+  }
+
+  REQUIRE(parallel.errors.size() == serial.errors.size());
+  for (std::size_t k = 0; k < serial.errors.size(); k += 1) {
+    REQUIRE(parallel.errors[k].l1 == serial.errors[k].l1);
+    REQUIRE(parallel.errors[k].l2 == serial.errors[k].l2);
+    REQUIRE(parallel.errors[k].linf == serial.errors[k].linf);
+  }
+  REQUIRE(parallel.capacitance == serial.capacitance);
+}
@@ -0,0 +1,71 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <memory>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/graph_storage.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("GlobalDofNumberingIsDistributed", "[DofMap]") {
+  const size_t degree = 2;
+  const size_t start_dof_offset = 5;
+  const int rank = mc::mpi::rank(MPI_COMM_WORLD);
+  const int size = mc::mpi::size(MPI_COMM_WORLD);
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  for (auto e_id : graph->get_edge_ids())
+    graph->split_edge(graph->edge(e_id), 2);
+  graph->finalize_bcs();
+  for (auto e_id : graph->get_edge_ids())
+    graph->assign_edge_to_rank(graph->edge(e_id), static_cast<int>(e_id) % size);
+
+  mc::DofMap dof_map(*graph);
+  dof_map.create(MPI_COMM_WORLD, *graph, 2, degree, start_dof_offset, true);
+
+  REQUIRE(dof_map.first_global_dof() == start_dof_offset);
+
+  // the owned dofs of all ranks partition the global dofs
+  unsigned long long num_owned = dof_map.num_owned_dofs();
+  unsigned long long num_total = 0;
+  MPI_Allreduce(&num_owned, &num_total, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+  REQUIRE(num_total == dof_map.num_dof());
+
+  std::vector<unsigned long long> first_owned(size, 0);
+  first_owned[rank] = dof_map.first_owned_global_dof();
+  MPI_Allreduce(MPI_IN_PLACE, first_owned.data(), size, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+  REQUIRE(first_owned[0] == start_dof_offset);
+  for (int r = 1; r < size; r += 1)
+    REQUIRE(first_owned[r] >= first_owned[r - 1]);
+
+  // the owned edges lie inside of the owned range, which is contiguous
+  std::vector<unsigned long long> first_edge_dofs(graph->num_edges(), 0);
+  std::size_t expected_first_dof = dof_map.first_owned_global_dof();
+  for (auto e_id : graph->get_active_edge_ids(rank)) {
+    const auto &local_dof_map = dof_map.get_local_dof_map(graph->edge(e_id));
+    REQUIRE(local_dof_map.first_dof(0, 0) == expected_first_dof);
+    expected_first_dof += local_dof_map.num_local_dof();
+    first_edge_dofs[e_id] = local_dof_map.first_dof(0, 0);
+  }
+  REQUIRE(expected_first_dof <= dof_map.first_owned_global_dof() + dof_map.num_owned_dofs());
+
+  // the ghost edges agree with their owners
+  MPI_Allreduce(MPI_IN_PLACE, first_edge_dofs.data(), static_cast<int>(first_edge_dofs.size()), MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+  for (int other_rank = 0; other_rank < size; other_rank += 1) {
+    if (other_rank == rank)
+      continue;
+    for (auto e_id : graph->get_ghost_edge_ids(rank, other_rank))
+      REQUIRE(dof_map.get_local_dof_map(graph->edge(e_id)).first_dof(0, 0) == first_edge_dofs[e_id]);
+  }
+}
@@ -0,0 +1,69 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/embedded_graph_reader.hpp"
+#include "macrocirculation/graph_storage.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("EmbeddedGraphReaderAcceptsTheVesselsBeforeTheVertices", "[EmbeddedGraphReader]") {
+  const std::string filepath = "./embedded_graph_reader_test_" + std::to_string(mc::mpi::rank(MPI_COMM_WORLD)) + ".json";
+  {
+    std::ofstream f(filepath);
+    f << R"({
+      "name": "two vessels",
+      "vessels": [
+        { "id": 0, "name": "left", "vessel_length": 1.0, "radius": 0.1, "wall_thickness": 0.01, "elastic_modulus": 4e5, "gamma": 2,
+          "number_edges": 4, "left_vertex_id": 0, "right_vertex_id": 1,
+          "embedded_coordinates": [[0, 0, 0], [1, 0, 0]] },
+        { "id": 1, "vessel_length": 2.0, "radii": [0.1, 0.3], "wall_thickness": 0.01, "elastic_modulus": 4e5, "gamma": 2,
+          "abstract_coordinates": [0, 1, 2], "left_vertex_id": 1, "right_vertex_id": 2 }
+      ],
+      "vertices": [
+        { "id": 0, "name": "in" },
+        { "id": 1 },
+        { "id": 2, "name": "out", "peripheral_resistance": 2.0, "peripheral_compliance": 3.0 },
+        { "id": 3, "name": "isolated" }
+      ]
+    })";
+  }
+
+  mc::GraphStorage graph;
+  graph.create_vertex();
+  mc::EmbeddedGraphReader reader;
+  reader.append(filepath, graph);
+  std::remove(filepath.c_str());
+
+  // the vertices of the file are appended after the existing one
+  REQUIRE(graph.num_vertices() == 5);
+  REQUIRE(graph.num_edges() == 2);
+
+  const auto &left = *graph.find_edge_by_name("left");
+  REQUIRE(left.get_vertex_neighbors()[0] == 1);
+  REQUIRE(left.get_vertex_neighbors()[1] == 2);
+  REQUIRE(left.num_micro_edges() == 4);
+  REQUIRE(left.has_embedding_data());
+
+  const auto &right = *graph.get_edge(1);
+  REQUIRE(right.num_micro_edges() == 2);
+  REQUIRE(right.get_physical_data().A0 == Approx(M_PI * 0.2 * 0.2));
+
+  REQUIRE(graph.get_vertex(2)->get_name() == "bifurcation_0_1");
+  REQUIRE(graph.find_vertex_by_name("in")->get_id() == 1);
+  REQUIRE(graph.find_vertex_by_name("isolated")->get_id() == 4);
+
+  const auto &out = *graph.find_vertex_by_name("out");
+  REQUIRE(out.is_windkessel_outflow());
+  REQUIRE(out.get_peripheral_vessel_data().resistance == Approx(2.0));
+  REQUIRE(out.get_peripheral_vessel_data().compliance == Approx(3.0));
+}
@@ -0,0 +1,151 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <memory>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/ensemble_flow_solver.hpp"
+#include "macrocirculation/ensemble_sweep.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+namespace {
+
+/*! @brief The 3 vessel network, where the resistance of the first windkessel model is scaled by the given factor. */
+std::shared_ptr<mc::GraphStorage> create_network(double resistance_factor, MPI_Comm comm = MPI_COMM_SELF) {
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  auto &v = *graph->get_vertex(2);
+  v.set_to_windkessel_outflow(resistance_factor * v.get_peripheral_vessel_data().resistance, v.get_peripheral_vessel_data().compliance);
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, comm);
+  return graph;
+}
+
+/*! @brief Solves the 3 vessel network on the given communicator and returns the 0D values at the scaled windkessel. */
+mc::Values0DModel solve_network(MPI_Comm comm, double resistance_factor, double tau, double t_end) {
+  const std::size_t degree = 2;
+  auto graph = create_network(resistance_factor, comm);
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(comm, *graph, 2, degree, false);
+  mc::ExplicitNonlinearFlowSolver solver(comm, graph, dof_map, degree);
+  solver.use_ssp_method();
+  for (double t = 0; t < t_end - 1e-12; t += tau)
+    solver.solve(tau, t);
+  return solver.get_0D_values(*graph->get_vertex(2));
+}
+
+} // namespace
+
+TEST_CASE("EnsembleMembersMatchSingleRuns", "[EnsembleFlowSolver]") {
+  const std::size_t degree = 2;
+  const double tau = 1e-4;
+  const double t_end = 0.02;
+
+  mc::EnsembleFlowSolver ensemble(MPI_COMM_SELF, {create_network(1), create_network(2)}, degree);
+  ensemble.for_each_member([](auto &member) { member.use_ssp_method(); });
+  ensemble.set_num_threads(2);
+  REQUIRE(ensemble.num_members() == 2);
+
+  // the reference solution of the first member
+  auto graph = create_network(1);
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_SELF, *graph, 2, degree, false);
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_SELF, graph, dof_map, degree);
+  solver.use_ssp_method();
+
+  for (double t = 0; t < t_end - 1e-12; t += tau) {
+    ensemble.solve(tau, t);
+    solver.solve(tau, t);
+  }
+
+  // the members are solved independently, hence we get bitwise the same solution
+  REQUIRE(ensemble.get_member(0).get_solution() == solver.get_solution());
+
+  // the larger resistance of the second member changes its solution
+  REQUIRE(ensemble.get_member(1).get_solution() != solver.get_solution());
+}
+
+TEST_CASE("EnsembleRejectsDifferentTopologies", "[EnsembleFlowSolver]") {
+  auto graph = std::make_shared<mc::GraphStorage>();
+  graph->finalize_bcs();
+  REQUIRE_THROWS(mc::EnsembleFlowSolver(MPI_COMM_SELF, {create_network(1), graph}, 2));
+}
+
+TEST_CASE("IndependentRunsOnSubCommunicators", "[EnsembleFlowSolver]") {
+  const double tau = 1e-4;
+  const double t_end = 0.005;
+
+  // pack groups of two ranks into independent simulations with different parameters
+  const int rank = mc::mpi::rank(MPI_COMM_WORLD);
+  const int color = rank / 2;
+  MPI_Comm sub_comm;
+  MPI_Comm_split(MPI_COMM_WORLD, color, rank, &sub_comm);
+
+  const double resistance_factor = 1 + color;
+  const auto values = solve_network(sub_comm, resistance_factor, tau, t_end);
+  const auto reference = solve_network(MPI_COMM_SELF, resistance_factor, tau, t_end);
+
+  REQUIRE(values.p_c == Approx(reference.p_c).epsilon(1e-10));
+  REQUIRE(values.q == Approx(reference.q).epsilon(1e-10));
+
+  MPI_Comm_free(&sub_comm);
+}
+
+TEST_CASE("EnsembleSweepStacksTheOutletValues", "[EnsembleFlowSolver]") {
+  mc::EnsembleSweepSettings settings;
+  settings.tau = 1e-4;
+  settings.t_end = 0.01;
+  settings.output_interval = 20;
+  settings.batch_size = 2;
+
+  auto create_graph = [] { return test_macrocirculation::util::create_3_vessel_network(); };
+  const auto outlets = mc::get_windkessel_outlets(*create_graph());
+  REQUIRE(!outlets.empty());
+
+  std::vector<mc::EnsembleSample> samples(3);
+  samples[1].resistance_factors.assign(outlets.size(), 2.);
+  samples[2].elasticity_factor = 1.5;
+
+  const auto result = mc::run_ensemble_sweep(MPI_COMM_WORLD, create_graph, samples, settings);
+  REQUIRE(result.times.size() == 5);
+  REQUIRE(result.times.back() == Approx(settings.t_end));
+  REQUIRE(result.outlet_vertex_ids == outlets);
+  REQUIRE(result.flows.size() == 3 * 5 * outlets.size());
+
+  // the unscaled sample is the plain network
+  auto graph = create_graph();
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, settings.degree, false);
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, settings.degree);
+  solver.use_ssp_method();
+  double t = 0;
+  for (std::size_t step = 0; step < 100; step += 1, t += settings.tau)
+    solver.solve(settings.tau, t);
+
+  for (std::size_t o = 0; o < outlets.size(); o += 1) {
+    const auto values = solver.get_0D_values(*graph->get_vertex(outlets[o]));
+    REQUIRE(result.pressures[result.index(0, 4, o)] == values.p_c);
+    REQUIRE(result.flows[result.index(0, 4, o)] == values.q);
+    // the other samples change the outlet values
+    REQUIRE(result.pressures[result.index(1, 4, o)] != values.p_c);
+    REQUIRE(result.pressures[result.index(2, 4, o)] != values.p_c);
+  }
+
+  samples[1].compliance_factors.assign(outlets.size() + 1, 1.);
+  REQUIRE_THROWS(mc::run_ensemble_sweep(MPI_COMM_WORLD, create_graph, samples, settings));
+}
@@ -0,0 +1,77 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/errornorm.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("ErrornormEvaluatorAgreesWithTheAnalyticNorms", "[Errornorm]") {
+  const std::size_t degree = 2;
+  const auto rank = mc::mpi::rank(MPI_COMM_WORLD);
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+
+  // Q is the first legendre polynomial on every micro edge, while A is the constant one
+  std::vector<double> u_h(dof_map->num_dof(), 0.);
+  for (auto e_id : graph->get_active_edge_ids(rank)) {
+    const auto &local_dof_map = dof_map->get_local_dof_map(*graph->get_edge(e_id));
+    for (std::size_t micro_edge = 0; micro_edge < local_dof_map.num_micro_edges(); micro_edge += 1) {
+      u_h[local_dof_map.first_dof(micro_edge, 0) + 1] = 1.;
+      u_h[local_dof_map.first_dof(micro_edge, 1)] = 1.;
+    }
+  }
+
+  double total_length = 0;
+  for (auto e_id : graph->get_edge_ids())
+    total_length += graph->get_edge(e_id)->get_physical_data().length;
+
+  const auto zero = [](const std::vector<double> &p, std::vector<double> &out) {
+    for (std::size_t qp = 0; qp < p.size(); qp += 1)
+      out[qp] = 0;
+  };
+  const auto three = [](const std::vector<double> &p, std::vector<double> &out) {
+    for (std::size_t qp = 0; qp < p.size(); qp += 1)
+      out[qp] = 3;
+  };
+
+  const mc::ErrornormEvaluator evaluator(MPI_COMM_WORLD, *graph, *dof_map);
+  const auto errors = evaluator.evaluate(u_h, {{0, zero}, {1, three}, {1, zero}});
+  REQUIRE(errors.size() == 3);
+
+  // s^2 is integrated exactly on the reference micro edge [-1, 1], while |s| is only approximated by the quadrature
+  REQUIRE(errors[0].l2 == Approx(std::sqrt(total_length / 3)));
+  REQUIRE(errors[0].linf < 1.);
+  REQUIRE(errors[0].linf > 0.8);
+
+  REQUIRE(errors[1].l1 == Approx(2 * total_length));
+  REQUIRE(errors[1].l2 == Approx(2 * std::sqrt(total_length)));
+  REQUIRE(errors[1].linf == Approx(2));
+
+  REQUIRE(errors[2].l1 == Approx(total_length));
+  REQUIRE(errors[2].l2 == Approx(std::sqrt(total_length)));
+  REQUIRE(errors[2].linf == Approx(1));
+
+  // the single field function is evaluated with the same quadrature
+  REQUIRE(mc::errornorm(MPI_COMM_WORLD, *graph, *dof_map, 0, u_h, zero) == Approx(errors[0].l2));
+  REQUIRE(mc::errornorm(MPI_COMM_WORLD, *graph, *dof_map, 1, u_h, three) == Approx(errors[1].l2));
+}
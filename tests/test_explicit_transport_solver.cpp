@@ -0,0 +1,238 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/explicit_transport_solver.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/nonlinear_flow_upwind_evaluator.hpp"
+#include "macrocirculation/right_hand_side_evaluator.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("TransportReusesTheFlowFluxes", "[ExplicitTransportSolver]") {
+  const size_t degree = 2;
+  const double tau = 5e-5;
+  const std::size_t num_steps = 200;
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  for (auto e_id : graph->get_edge_ids())
+    graph->split_edge(graph->edge(e_id), 2);
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+
+  auto dof_map_flow = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map_flow->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+  auto dof_map_transport = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  mc::DofMap::create_for_transport(MPI_COMM_WORLD, {graph}, {dof_map_transport}, degree);
+
+  mc::ExplicitNonlinearFlowSolver flow_solver(MPI_COMM_WORLD, graph, dof_map_flow, degree);
+  flow_solver.use_ssp_method();
+  auto shared_evaluator = flow_solver.share_upwind_fluxes();
+
+  mc::ExplicitTransportSolver transport_solver(MPI_COMM_WORLD, graph, dof_map_flow, dof_map_transport);
+  mc::ExplicitTransportSolver shared_transport_solver(MPI_COMM_WORLD, graph, dof_map_flow, dof_map_transport, shared_evaluator);
+
+  mc::NonlinearFlowUpwindEvaluator evaluator(MPI_COMM_WORLD, graph, dof_map_flow, {{dof_map_transport, 0}});
+
+  double t = 0;
+  for (std::size_t it = 0; it < num_steps; it += 1) {
+    flow_solver.solve(tau, t);
+
+    // the fluxes of the first stage are retained for the previous solution only
+    REQUIRE(evaluator.init_from(*shared_evaluator, t, flow_solver.get_previous_solution(), {&transport_solver.get_solution()}));
+    REQUIRE(!evaluator.init_from(*shared_evaluator, t + tau, flow_solver.get_previous_solution(), {&transport_solver.get_solution()}));
+
+    transport_solver.solve(t, tau, flow_solver.get_previous_solution());
+    shared_transport_solver.solve(t, tau, flow_solver.get_previous_solution());
+    t += tau;
+  }
+
+  const auto &reference = transport_solver.get_solution();
+  const auto &values = shared_transport_solver.get_solution();
+  REQUIRE(values.size() == reference.size());
+  // the newton iterations at the vertices start from different initial guesses, so we only agree up to round off
+  for (std::size_t k = 0; k < values.size(); k += 1)
+    REQUIRE(values[k] == Approx(reference[k]).epsilon(1e-10).margin(1e-14));
+}
+
+TEST_CASE("TransportCoupledToTheFlowPassAgreesWithTheSeparateTransport", "[ExplicitTransportSolver]") {
+  const size_t degree = 2;
+  const double tau = 5e-5;
+  const std::size_t num_steps = 200;
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  for (auto e_id : graph->get_edge_ids())
+    graph->split_edge(graph->edge(e_id), 2);
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+
+  auto dof_map_flow = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map_flow->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+  auto dof_map_transport = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  mc::DofMap::create_for_transport(MPI_COMM_WORLD, {graph}, {dof_map_transport}, degree);
+
+  mc::ExplicitNonlinearFlowSolver flow_solver(MPI_COMM_WORLD, graph, dof_map_flow, degree);
+  flow_solver.use_ssp_method();
+  mc::ExplicitNonlinearFlowSolver coupled_flow_solver(MPI_COMM_WORLD, graph, dof_map_flow, degree);
+  coupled_flow_solver.use_ssp_method();
+  // the coupled pass assembles single edges, hence the flows only agree bitwise without the batches of short edges
+  flow_solver.get_rhs_evaluator().set_edge_batching(0);
+  coupled_flow_solver.get_rhs_evaluator().set_edge_batching(0);
+
+  mc::ExplicitTransportSolver transport_solver(MPI_COMM_WORLD, graph, dof_map_flow, dof_map_transport);
+  mc::ExplicitTransportSolver coupled_transport_solver(MPI_COMM_WORLD, graph, dof_map_flow, dof_map_transport);
+  coupled_transport_solver.couple_to(coupled_flow_solver);
+
+  // the coupled pass is restricted to a single explicit euler step per flow step
+  REQUIRE_THROWS(coupled_transport_solver.use_ssp_method());
+  REQUIRE_THROWS(coupled_transport_solver.set_sub_cycles(2));
+
+  double t = 0;
+  for (std::size_t it = 0; it < num_steps; it += 1) {
+    flow_solver.solve(tau, t);
+    coupled_flow_solver.solve(tau, t);
+    transport_solver.solve(t, tau, flow_solver.get_previous_solution());
+    coupled_transport_solver.solve(t, tau, coupled_flow_solver.get_previous_solution());
+    t += tau;
+  }
+
+  // the transport does not change the flow
+  REQUIRE(coupled_flow_solver.get_solution() == flow_solver.get_solution());
+
+  const auto &reference = transport_solver.get_solution();
+  const auto &values = coupled_transport_solver.get_solution();
+  REQUIRE(values.size() == reference.size());
+  double max_value = 0;
+  for (std::size_t k = 0; k < values.size(); k += 1) {
+    max_value = std::max(max_value, std::abs(reference[k]));
+    // the contributions at the macro edge boundaries are added in a different order
+    REQUIRE(values[k] == Approx(reference[k]).epsilon(1e-10).margin(1e-12));
+  }
+  MPI_Allreduce(MPI_IN_PLACE, &max_value, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  REQUIRE(max_value > 0);
+}
+
+TEST_CASE("SubCycledTransportAgreesWithTheFullTransport", "[ExplicitTransportSolver]") {
+  const size_t degree = 2;
+  const double tau = 5e-5;
+  const std::size_t num_steps = 400;
+  const std::size_t num_sub_cycles = 4;
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  for (auto e_id : graph->get_edge_ids())
+    graph->split_edge(graph->edge(e_id), 2);
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+
+  auto dof_map_flow = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map_flow->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+  auto dof_map_transport = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  mc::DofMap::create_for_transport(MPI_COMM_WORLD, {graph}, {dof_map_transport}, degree);
+
+  mc::ExplicitNonlinearFlowSolver flow_solver(MPI_COMM_WORLD, graph, dof_map_flow, degree);
+  flow_solver.use_ssp_method();
+
+  mc::ExplicitTransportSolver transport_solver(MPI_COMM_WORLD, graph, dof_map_flow, dof_map_transport);
+  transport_solver.use_ssp_method();
+  mc::ExplicitTransportSolver sub_cycled_transport_solver(MPI_COMM_WORLD, graph, dof_map_flow, dof_map_transport);
+  sub_cycled_transport_solver.use_ssp_method();
+  sub_cycled_transport_solver.set_sub_cycles(num_sub_cycles);
+
+  double t = 0;
+  for (std::size_t it = 0; it < num_steps; it += 1) {
+    flow_solver.solve(tau, t);
+    transport_solver.solve(t, tau, flow_solver.get_previous_solution());
+    sub_cycled_transport_solver.solve(t, tau, flow_solver.get_previous_solution());
+    t += tau;
+  }
+
+  const auto &reference = transport_solver.get_solution();
+  const auto &values = sub_cycled_transport_solver.get_solution();
+  double max_value = 0, max_error = 0;
+  for (std::size_t k = 0; k < values.size(); k += 1) {
+    max_value = std::max(max_value, std::abs(reference[k]));
+    max_error = std::max(max_error, std::abs(values[k] - reference[k]));
+  }
+  MPI_Allreduce(MPI_IN_PLACE, &max_value, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  MPI_Allreduce(MPI_IN_PLACE, &max_error, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  REQUIRE(max_value > 0);
+  REQUIRE(max_error < 1e-3 * max_value);
+}
+
+TEST_CASE("BatchedSpeciesAgreeWithSeparateTransports", "[ExplicitTransportSolver]") {
+  const size_t degree = 2;
+  const double tau = 5e-5;
+  const std::size_t num_steps = 200;
+  const std::vector<double> inflow_scales{1., 0.5, 2.};
+  const std::size_t num_species = inflow_scales.size();
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  for (auto e_id : graph->get_edge_ids())
+    graph->split_edge(graph->edge(e_id), 2);
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+
+  auto dof_map_flow = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map_flow->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+  auto dof_map_transport = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  mc::DofMap::create_for_transport(MPI_COMM_WORLD, {graph}, {dof_map_transport}, degree);
+  auto dof_map_species = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  mc::DofMap::create_for_transport(MPI_COMM_WORLD, {graph}, {dof_map_species}, degree, num_species);
+
+  mc::ExplicitNonlinearFlowSolver flow_solver(MPI_COMM_WORLD, graph, dof_map_flow, degree);
+  flow_solver.use_ssp_method();
+
+  mc::ExplicitTransportSolver batched_transport_solver(MPI_COMM_WORLD, graph, dof_map_flow, dof_map_species);
+  REQUIRE(batched_transport_solver.num_species() == num_species);
+
+  std::vector<std::unique_ptr<mc::ExplicitTransportSolver>> transport_solvers;
+  for (std::size_t species = 0; species < num_species; species += 1) {
+    const double scale = inflow_scales[species];
+    auto inflow = [scale](double t) { return scale * std::min(1., t / 0.05); };
+    batched_transport_solver.set_inflow(species, inflow);
+    transport_solvers.push_back(std::make_unique<mc::ExplicitTransportSolver>(MPI_COMM_WORLD, graph, dof_map_flow, dof_map_transport));
+    transport_solvers.back()->set_inflow(0, inflow);
+  }
+
+  double t = 0;
+  for (std::size_t it = 0; it < num_steps; it += 1) {
+    flow_solver.solve(tau, t);
+    batched_transport_solver.solve(t, tau, flow_solver.get_previous_solution());
+    for (auto &transport_solver : transport_solvers)
+      transport_solver->solve(t, tau, flow_solver.get_previous_solution());
+    t += tau;
+  }
+
+  const auto &values = batched_transport_solver.get_solution();
+  std::vector<std::size_t> dof_indices(degree + 1);
+  std::vector<std::size_t> species_dof_indices(degree + 1);
+  for (auto e_id : graph->get_active_edge_ids(mc::mpi::rank(MPI_COMM_WORLD))) {
+    const auto &local_dof_map = dof_map_transport->get_local_dof_map(graph->edge(e_id));
+    const auto &local_species_dof_map = dof_map_species->get_local_dof_map(graph->edge(e_id));
+    for (std::size_t species = 0; species < num_species; species += 1) {
+      const auto &reference = transport_solvers[species]->get_solution();
+      for (std::size_t micro_edge_id = 0; micro_edge_id < local_dof_map.num_micro_edges(); micro_edge_id += 1) {
+        local_dof_map.dof_indices(micro_edge_id, 0, dof_indices);
+        local_species_dof_map.dof_indices(micro_edge_id, species, species_dof_indices);
+        for (std::size_t i = 0; i < dof_indices.size(); i += 1)
+          REQUIRE(values[species_dof_indices[i]] == Approx(reference[dof_indices[i]]).epsilon(1e-12).margin(1e-14));
+      }
+    }
+  }
+}
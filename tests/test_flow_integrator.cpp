@@ -0,0 +1,68 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/rcr_estimator.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("FlowIntegratorReducesTheTipFlowsOfAllRanks", "[FlowIntegrator]") {
+  const std::size_t degree = 2;
+  const double tau = 1e-4;
+  const auto rank = mc::mpi::rank(MPI_COMM_WORLD);
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, degree);
+  solver.use_ssp_method();
+
+  mc::FlowIntegrator flow_integrator(MPI_COMM_WORLD, graph);
+
+  // the flows out of the windkessel tips, which are accumulated by their owners
+  const std::vector<std::size_t> tips{2, 3};
+  std::vector<double> expected(tips.size(), 0.);
+
+  double t = 0;
+  for (std::size_t k = 0; k < 100; k += 1, t += tau) {
+    solver.solve(tau, t);
+    flow_integrator.update_flow(solver, tau);
+    for (std::size_t i = 0; i < tips.size(); i += 1) {
+      const auto &v = *graph->get_vertex(tips[i]);
+      if (graph->get_edge(v.get_edge_neighbors()[0])->rank() == rank)
+        expected[i] += solver.get_flow_at_vessel_tip(v) * tau;
+    }
+  }
+  MPI_Allreduce(MPI_IN_PLACE, expected.data(), static_cast<int>(expected.size()), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+
+  const auto data = flow_integrator.get_windkessel_outflow_data();
+  REQUIRE(data.flows.size() == tips.size());
+  for (std::size_t i = 0; i < tips.size(); i += 1) {
+    REQUIRE(data.flows.at(tips[i]) != 0);
+    REQUIRE(data.flows.at(tips[i]) == Approx(expected[i]));
+  }
+  REQUIRE(data.total_flow == Approx(expected[0] + expected[1]));
+
+  REQUIRE(flow_integrator.get_free_outflow_data().flows.empty());
+
+  flow_integrator.reset();
+  REQUIRE(flow_integrator.get_windkessel_outflow_data().total_flow == 0);
+}
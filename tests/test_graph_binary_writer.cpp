@@ -0,0 +1,330 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/fe_type.hpp"
+#include "macrocirculation/graph_binary_writer.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/output_resolution.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("BinaryWriterRecordsTheBoundaryValuesOfTheMicroEdges", "[GraphBinaryWriter]") {
+  const std::size_t degree = 2;
+  const double tau = 1e-4;
+  const auto rank = mc::mpi::rank(MPI_COMM_WORLD);
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, degree);
+  solver.use_ssp_method();
+
+  mc::GraphBinaryWriter writer(MPI_COMM_WORLD, ".", "binary_writer_test", graph);
+  writer.add_setup_data(dof_map, solver.A_component, "a");
+  writer.add_setup_data(dof_map, solver.Q_component, "q");
+  writer.setup();
+
+  // the solutions of all the records, which we compare against
+  std::vector<double> times;
+  std::vector<std::vector<double>> solutions;
+  double t = 0;
+  for (std::size_t step = 0; step < 3; step += 1) {
+    for (std::size_t k = 0; k < 10; k += 1, t += tau)
+      solver.solve(tau, t);
+    writer.add_data("a", solver.get_solution());
+    writer.add_data("q", solver.get_solution());
+    writer.write(t);
+    times.push_back(t);
+    solutions.push_back(solver.get_solution());
+  }
+
+  // the index is written by rank 0
+  MPI_Barrier(MPI_COMM_WORLD);
+  nlohmann::json meta;
+  std::ifstream("./binary_writer_test.json") >> meta;
+  REQUIRE(meta["format"] == "binary");
+  REQUIRE(meta["ranks"].size() == static_cast<std::size_t>(mc::mpi::size(MPI_COMM_WORLD)));
+  REQUIRE(meta["vessels"].size() == graph->num_edges());
+
+  const std::size_t record_size = meta["ranks"][rank]["record_size"];
+  std::ifstream f("./" + meta["ranks"][rank]["filepath"].get<std::string>(), std::ios::binary);
+  std::vector<double> records(times.size() * record_size);
+  f.read(reinterpret_cast<char *>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(double)));
+  REQUIRE(f);
+  // the file contains exactly our records
+  REQUIRE(f.peek() == std::ifstream::traits_type::eof());
+
+  const mc::FETypeNetwork fe(mc::create_midpoint_rule(), degree);
+  for (const auto &vessel : meta["vessels"]) {
+    if (vessel["rank"] != rank)
+      continue;
+    const std::size_t edge_id = vessel["edge_id"];
+    const auto &local_dof_map = dof_map->get_local_dof_map(*graph->get_edge(edge_id));
+    REQUIRE(vessel["num_values"] == 2 * local_dof_map.num_micro_edges());
+
+    for (std::size_t step = 0; step < times.size(); step += 1) {
+      const double *record = &records[step * record_size];
+      REQUIRE(record[0] == times[step]);
+
+      for (const auto &component : {std::make_pair("a", solver.A_component), std::make_pair("q", solver.Q_component)}) {
+        const std::size_t offset = vessel["offsets"][component.first];
+        for (std::size_t micro_edge = 0; micro_edge < local_dof_map.num_micro_edges(); micro_edge += 1) {
+          const double *values = local_dof_map.dof_values(solutions[step], micro_edge, component.second);
+          const auto boundary_values = fe.evaluate_dof_at_boundary_points(std::vector<double>(values, values + degree + 1));
+          REQUIRE(record[offset + 2 * micro_edge] == Approx(boundary_values.left).epsilon(1e-14));
+          REQUIRE(record[offset + 2 * micro_edge + 1] == Approx(boundary_values.right).epsilon(1e-14));
+        }
+      }
+    }
+  }
+
+  f.close();
+  MPI_Barrier(MPI_COMM_WORLD);
+  std::remove(("./" + meta["ranks"][rank]["filepath"].get<std::string>()).c_str());
+  if (rank == 0)
+    std::remove("./binary_writer_test.json");
+}
+
+TEST_CASE("BinaryWriterSamplesTheVesselsAtTheOutputResolution", "[GraphBinaryWriter]") {
+  const std::size_t degree = 2;
+  const double tau = 1e-4;
+  const auto rank = mc::mpi::rank(MPI_COMM_WORLD);
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, degree);
+  solver.use_ssp_method();
+
+  mc::OutputResolution resolution;
+  resolution.points_per_vessel = 5;
+
+  mc::GraphBinaryWriter writer(MPI_COMM_WORLD, ".", "resampled_binary_writer_test", graph);
+  writer.add_setup_data(dof_map, solver.A_component, "a");
+  writer.set_output_resolution(resolution);
+  writer.setup();
+  REQUIRE_THROWS(writer.set_output_resolution(resolution));
+
+  double t = 0;
+  for (std::size_t k = 0; k < 10; k += 1, t += tau)
+    solver.solve(tau, t);
+  writer.add_data("a", solver.get_solution());
+  writer.write(t);
+  const auto &u = solver.get_solution();
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  nlohmann::json meta;
+  std::ifstream("./resampled_binary_writer_test.json") >> meta;
+  const auto records = mc::read_binary_records(".", "resampled_binary_writer_test", rank);
+  REQUIRE(records.size() == 1);
+  REQUIRE(records[0].size() == 1 + 5 * graph->get_active_edge_ids(rank).size());
+
+  for (const auto &vessel : meta["vessels"]) {
+    REQUIRE(vessel["num_values"] == 5);
+    const std::size_t edge_id = vessel["edge_id"];
+    const auto &edge = *graph->get_edge(edge_id);
+    const std::vector<double> coordinates = vessel["coordinates"];
+    REQUIRE(coordinates.front() == 0);
+    REQUIRE(coordinates.back() == Approx(edge.get_physical_data().length));
+    if (vessel["rank"] != rank)
+      continue;
+
+    // the values are the dg solution at the equidistant points
+    const auto &local_dof_map = dof_map->get_local_dof_map(edge);
+    const std::size_t offset = vessel["offsets"]["a"];
+    for (std::size_t k = 0; k < 5; k += 1) {
+      const double s = coordinates[k] / edge.get_physical_data().length * static_cast<double>(edge.num_micro_edges());
+      const auto micro_edge = std::min(static_cast<std::size_t>(s), edge.num_micro_edges() - 1);
+      const double *values = local_dof_map.dof_values(u, micro_edge, solver.A_component);
+      const double expected = mc::FETypeNetwork::evaluate_dof(std::vector<double>(values, values + degree + 1), 2 * (s - micro_edge) - 1);
+      REQUIRE(records[0][offset + k] == Approx(expected));
+    }
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  std::remove(("./" + meta["ranks"][rank]["filepath"].get<std::string>()).c_str());
+  if (rank == 0)
+    std::remove("./resampled_binary_writer_test.json");
+}
+
+TEST_CASE("BinaryWriterCollectsTheRecordsOfAllRanksInASharedFile", "[GraphBinaryWriter]") {
+  const std::size_t degree = 1;
+  const double tau = 1e-4;
+  const auto rank = mc::mpi::rank(MPI_COMM_WORLD);
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, degree);
+  solver.use_ssp_method();
+
+  std::vector<double> times;
+  std::vector<std::vector<double>> solutions;
+
+  // the collective writes are complete, once the writer closed the file
+  {
+    mc::GraphBinaryWriter writer(MPI_COMM_WORLD, ".", "shared_binary_writer_test", graph);
+    writer.add_setup_data(dof_map, solver.A_component, "a");
+    writer.add_setup_data(dof_map, solver.Q_component, "q");
+    writer.set_shared_file(true);
+    writer.setup();
+
+    double t = 0;
+    for (std::size_t step = 0; step < 3; step += 1) {
+      for (std::size_t k = 0; k < 10; k += 1, t += tau)
+        solver.solve(tau, t);
+      writer.add_data("a", solver.get_solution());
+      writer.add_data("q", solver.get_solution());
+      writer.write(t);
+      times.push_back(t);
+      solutions.push_back(solver.get_solution());
+    }
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  nlohmann::json meta;
+  std::ifstream("./shared_binary_writer_test.json") >> meta;
+  const std::size_t step_size = meta["step_size"];
+  const std::size_t record_size = meta["ranks"][rank]["record_size"];
+  const std::size_t record_offset = meta["ranks"][rank]["record_offset"];
+  REQUIRE(meta["ranks"][rank]["filepath"] == "shared_binary_writer_test.bin");
+  REQUIRE((record_size > 0) == !graph->get_active_edge_ids(rank).empty());
+
+  std::ifstream f("./shared_binary_writer_test.bin", std::ios::binary);
+  std::vector<double> steps(times.size() * step_size);
+  f.read(reinterpret_cast<char *>(steps.data()), static_cast<std::streamsize>(steps.size() * sizeof(double)));
+  REQUIRE(f);
+  REQUIRE(f.peek() == std::ifstream::traits_type::eof());
+
+  const mc::FETypeNetwork fe(mc::create_midpoint_rule(), degree);
+  for (const auto &vessel : meta["vessels"]) {
+    if (vessel["rank"] != rank)
+      continue;
+    const std::size_t edge_id = vessel["edge_id"];
+    const auto &local_dof_map = dof_map->get_local_dof_map(*graph->get_edge(edge_id));
+
+    for (std::size_t step = 0; step < times.size(); step += 1) {
+      const double *record = &steps[step * step_size + record_offset];
+      REQUIRE(record[0] == times[step]);
+
+      const std::size_t offset = vessel["offsets"]["q"];
+      for (std::size_t micro_edge = 0; micro_edge < local_dof_map.num_micro_edges(); micro_edge += 1) {
+        const double *values = local_dof_map.dof_values(solutions[step], micro_edge, solver.Q_component);
+        const auto boundary_values = fe.evaluate_dof_at_boundary_points(std::vector<double>(values, values + degree + 1));
+        REQUIRE(record[offset + 2 * micro_edge] == Approx(boundary_values.left).epsilon(1e-14));
+        REQUIRE(record[offset + 2 * micro_edge + 1] == Approx(boundary_values.right).epsilon(1e-14));
+      }
+    }
+  }
+
+  f.close();
+  MPI_Barrier(MPI_COMM_WORLD);
+  if (rank == 0) {
+    std::remove("./shared_binary_writer_test.bin");
+    std::remove("./shared_binary_writer_test.json");
+  }
+}
+
+TEST_CASE("BinaryWriterQuantizesTheLossyComponentsWithinTheirTolerance", "[GraphBinaryWriter]") {
+  const std::size_t degree = 2;
+  const double tau = 1e-4;
+  const double tolerance = 1e-6;
+  const auto rank = mc::mpi::rank(MPI_COMM_WORLD);
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, degree);
+  solver.use_ssp_method();
+
+  // the uncompressed records are our reference
+  mc::GraphBinaryWriter reference_writer(MPI_COMM_WORLD, ".", "reference_writer_test", graph);
+  reference_writer.add_setup_data(dof_map, solver.A_component, "a");
+  reference_writer.add_setup_data(dof_map, solver.Q_component, "q");
+  reference_writer.setup();
+
+  mc::GraphBinaryWriter writer(MPI_COMM_WORLD, ".", "quantized_writer_test", graph);
+  writer.add_setup_data(dof_map, solver.A_component, "a", tolerance);
+  writer.add_setup_data(dof_map, solver.Q_component, "q");
+  writer.setup();
+
+  double t = 0;
+  for (std::size_t step = 0; step < 4; step += 1) {
+    for (std::size_t k = 0; k < 10; k += 1, t += tau)
+      solver.solve(tau, t);
+    for (auto *w : {&reference_writer, &writer}) {
+      w->add_data("a", solver.get_solution());
+      w->add_data("q", solver.get_solution());
+      w->write(t);
+    }
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  nlohmann::json meta;
+  std::ifstream("./quantized_writer_test.json") >> meta;
+  REQUIRE(meta["encoding"] == "quantized_delta");
+  REQUIRE(meta["components"][0]["name"] == "a");
+  REQUIRE(meta["components"][0]["tolerance"] == tolerance);
+  nlohmann::json reference_meta;
+  std::ifstream("./reference_writer_test.json") >> reference_meta;
+  REQUIRE(reference_meta.count("encoding") == 0);
+
+  const auto reference = mc::read_binary_records(".", "reference_writer_test", rank);
+  const auto records = mc::read_binary_records(".", "quantized_writer_test", rank);
+  REQUIRE(records.size() == 4);
+  REQUIRE(reference.size() == records.size());
+
+  // the area occupies the first half of a record, the flow the second one
+  for (std::size_t step = 0; step < records.size(); step += 1) {
+    REQUIRE(records[step].size() == reference[step].size());
+    REQUIRE(records[step][0] == reference[step][0]);
+    const std::size_t num_values = (records[step].size() - 1) / 2;
+    for (std::size_t k = 1; k <= num_values; k += 1)
+      REQUIRE(std::abs(records[step][k] - reference[step][k]) <= tolerance * (1 + 1e-12));
+    for (std::size_t k = num_values + 1; k < records[step].size(); k += 1)
+      REQUIRE(records[step][k] == reference[step][k]);
+  }
+
+  // the small changes of the area between the records compress well
+  if (records.front().size() > 1) {
+    std::ifstream file("./" + meta["ranks"][rank]["filepath"].get<std::string>(), std::ios::binary | std::ios::ate);
+    REQUIRE(static_cast<std::size_t>(file.tellg()) < records.size() * records.front().size() * sizeof(double));
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  std::remove(("./" + meta["ranks"][rank]["filepath"].get<std::string>()).c_str());
+  std::remove(("./" + reference_meta["ranks"][rank]["filepath"].get<std::string>()).c_str());
+  if (rank == 0) {
+    std::remove("./quantized_writer_test.json");
+    std::remove("./reference_writer_test.json");
+  }
+}
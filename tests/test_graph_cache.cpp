@@ -0,0 +1,111 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/graph_cache.hpp"
+#include "macrocirculation/graph_storage.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("GraphCacheRestoresTheGraph", "[GraphCache]") {
+  const std::string filepath = "./graph_cache_test_" + std::to_string(mc::mpi::rank(MPI_COMM_WORLD)) + ".bin";
+
+  mc::GraphStorage graph;
+  auto &v0 = *graph.create_vertex();
+  auto &v1 = *graph.create_vertex();
+  auto &v2 = *graph.create_vertex();
+  auto &v3 = *graph.create_vertex();
+  auto &v4 = *graph.create_vertex();
+  v0.set_name("in");
+  v2.set_name("tree");
+  v3.set_name("rcl");
+  v4.set_name("windkessel");
+
+  const auto data = mc::PhysicalData::set_from_data(4e5, 0.1, 1.028e-3, 9, 0.5, 2.0);
+  auto &e0 = *graph.connect(v0, v1, 4);
+  e0.set_name("trunk");
+  e0.add_embedding_data({{mc::Point(0, 0, 0), mc::Point(0, 0.5, 0.25), mc::Point(0, 1, 0)}});
+  auto &e1 = *graph.connect(v1, v2, 2);
+  e1.add_discretization_data({{0.75, 1.25}});
+  graph.connect(v1, v3, 3);
+  auto &e3 = *graph.connect(v1, v4, 5);
+  for (auto e_id : graph.get_edge_ids())
+    graph.get_edge(e_id)->add_physical_data(data);
+  graph.assign_edge_to_rank(e3, 1);
+
+  v0.set_to_linear_characteristic_inflow(0.5, 0.25, true, 1.5, 2.5);
+  v2.set_to_vessel_tree_outflow(3.0, {1., 2.}, {3., 4.}, {5., 6.}, 2);
+  v3.set_to_vessel_rcl_outflow(4.0, {1.}, {2.}, {3.});
+  v4.set_to_windkessel_outflow(1.5, 0.5);
+  v4.update_vessel_tip_pressures(7.0);
+
+  mc::write_graph_cache(filepath, graph, 42, true);
+
+  // a cache of other sources is ignored
+  {
+    mc::GraphStorage cached_graph;
+    REQUIRE(!mc::read_graph_cache(filepath, 43, cached_graph));
+    REQUIRE(cached_graph.num_vertices() == 0);
+    REQUIRE(!mc::read_graph_cache(filepath + ".missing", 42, cached_graph));
+  }
+
+  mc::GraphStorage cached_graph;
+  REQUIRE(mc::read_graph_cache(filepath, 42, cached_graph));
+  std::remove(filepath.c_str());
+
+  REQUIRE(cached_graph.num_vertices() == 5);
+  REQUIRE(cached_graph.num_edges() == 4);
+  for (auto e_id : graph.get_edge_ids()) {
+    const auto &edge = *graph.get_edge(e_id);
+    const auto &cached_edge = *cached_graph.get_edge(e_id);
+    REQUIRE(cached_edge.get_name() == edge.get_name());
+    REQUIRE(cached_edge.get_vertex_neighbors() == edge.get_vertex_neighbors());
+    REQUIRE(cached_edge.num_micro_edges() == edge.num_micro_edges());
+    REQUIRE(cached_edge.rank() == edge.rank());
+    REQUIRE(cached_edge.get_physical_data().A0 == edge.get_physical_data().A0);
+    REQUIRE(cached_edge.get_physical_data().G0 == edge.get_physical_data().G0);
+    REQUIRE(cached_edge.get_physical_data().viscosity == edge.get_physical_data().viscosity);
+    REQUIRE(cached_edge.has_embedding_data() == edge.has_embedding_data());
+    REQUIRE(cached_edge.has_discretization_data() == edge.has_discretization_data());
+  }
+  REQUIRE(cached_graph.find_edge_by_name("trunk")->get_embedding_data().points[1].z == 0.25);
+  REQUIRE(cached_graph.get_edge(1)->get_discretization_data().lengths == std::vector<double>{0.75, 1.25});
+
+  REQUIRE(cached_graph.find_vertex_by_name("in")->get_linear_characteristic_data().q == 2.5);
+  REQUIRE(cached_graph.find_vertex_by_name("in")->get_linear_characteristic_data().points_towards_vertex);
+  REQUIRE(cached_graph.find_vertex_by_name("tree")->get_vessel_tree_data().radii == std::vector<double>{5., 6.});
+  REQUIRE(cached_graph.find_vertex_by_name("tree")->get_vessel_tree_data().furcation_number == 2);
+  REQUIRE(cached_graph.find_vertex_by_name("rcl")->get_rcl_data().inductances == std::vector<double>{3.});
+  REQUIRE(cached_graph.find_vertex_by_name("windkessel")->get_peripheral_vessel_data().compliance == 0.5);
+  REQUIRE(cached_graph.find_vertex_by_name("windkessel")->get_peripheral_vessel_data().p_out == 7.0);
+  REQUIRE(!cached_graph.get_vertex(1)->is_leaf());
+}
+
+TEST_CASE("GraphCacheRejectsInflowFunctions", "[GraphCache]") {
+  const std::string filepath = "./graph_cache_inflow_test_" + std::to_string(mc::mpi::rank(MPI_COMM_WORLD)) + ".bin";
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  REQUIRE_THROWS(mc::write_graph_cache(filepath, *graph, 0));
+  std::remove((filepath + ".tmp").c_str());
+}
+
+TEST_CASE("SourceFilesHashDependsOnTheContents", "[GraphCache]") {
+  const std::string filepath = "./graph_cache_source_test_" + std::to_string(mc::mpi::rank(MPI_COMM_WORLD)) + ".json";
+  std::ofstream(filepath) << "{\"vessels\": []}";
+  const auto hash = mc::source_files_hash({filepath});
+  REQUIRE(hash == mc::source_files_hash({filepath}));
+  std::ofstream(filepath) << "{\"vessels\": [ ]}";
+  REQUIRE(hash != mc::source_files_hash({filepath}));
+  std::remove(filepath.c_str());
+  REQUIRE_THROWS(mc::source_files_hash({filepath}));
+}
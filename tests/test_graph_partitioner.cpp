@@ -0,0 +1,218 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mpi.h>
+#include <set>
+#include <string>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+
+namespace mc = macrocirculation;
+
+namespace {
+
+/*! @brief Creates a binary tree with the given number of generations below a root vessel. */
+std::shared_ptr<mc::GraphStorage> create_binary_tree(std::size_t generations) {
+  auto graph = std::make_shared<mc::GraphStorage>();
+  auto root = graph->create_vertex();
+  auto first = graph->create_vertex();
+  graph->connect(*root, *first, 4);
+
+  std::vector<std::shared_ptr<mc::Vertex>> leaves{first};
+  for (std::size_t g = 0; g < generations; g += 1) {
+    std::vector<std::shared_ptr<mc::Vertex>> new_leaves;
+    for (auto &leaf : leaves) {
+      for (std::size_t k = 0; k < 2; k += 1) {
+        auto child = graph->create_vertex();
+        graph->connect(*leaf, *child, 4);
+        new_leaves.push_back(child);
+      }
+    }
+    leaves = new_leaves;
+  }
+  return graph;
+}
+
+/*! @brief Returns the number of vertices shared by edges of different parts. */
+std::size_t num_cut_vertices(const mc::GraphStorage &graph, const std::vector<int> &parts) {
+  std::size_t num_cuts = 0;
+  for (auto v_id : graph.get_vertex_ids()) {
+    std::set<int> vertex_parts;
+    for (auto e_id : graph.vertex(v_id).get_edge_neighbors())
+      vertex_parts.insert(parts[e_id]);
+    num_cuts += vertex_parts.size() > 1;
+  }
+  return num_cuts;
+}
+
+/*! @brief Checks that the edges of every part are connected. */
+void check_parts_are_connected(const mc::GraphStorage &graph, const std::vector<int> &parts, int num_parts) {
+  for (int part = 0; part < num_parts; part += 1) {
+    std::vector<std::size_t> part_edges;
+    for (auto e_id : graph.get_edge_ids())
+      if (parts[e_id] == part)
+        part_edges.push_back(e_id);
+    REQUIRE(!part_edges.empty());
+
+    std::set<std::size_t> reached{part_edges.front()};
+    std::vector<std::size_t> stack{part_edges.front()};
+    while (!stack.empty()) {
+      const auto e_id = stack.back();
+      stack.pop_back();
+      for (auto v_id : graph.edge(e_id).get_vertex_neighbors())
+        for (auto n_id : graph.vertex(v_id).get_edge_neighbors())
+          if (parts[n_id] == part && reached.insert(n_id).second)
+            stack.push_back(n_id);
+    }
+    REQUIRE(reached.size() == part_edges.size());
+  }
+}
+
+} // namespace
+
+TEST_CASE("TopologyAwarePartitionOfVesselLine", "[GraphPartitioner]") {
+  auto graph = std::make_shared<mc::GraphStorage>();
+  auto v = graph->create_vertex();
+  for (std::size_t k = 0; k < 30; k += 1) {
+    auto next = graph->create_vertex();
+    graph->connect(*v, *next, 2);
+    v = next;
+  }
+
+  const auto parts = mc::topology_aware_partition(*graph, [](const mc::Edge &e) { return static_cast<int>(e.num_micro_edges()); }, 3);
+
+  check_parts_are_connected(*graph, parts, 3);
+  REQUIRE(num_cut_vertices(*graph, parts) == 2);
+  for (int part = 0; part < 3; part += 1)
+    REQUIRE(std::count(parts.begin(), parts.end(), part) == 10);
+}
+
+TEST_CASE("TopologyAwarePartitionOfBinaryTree", "[GraphPartitioner]") {
+  auto graph = create_binary_tree(6);
+  const int num_parts = 4;
+
+  const auto parts = mc::topology_aware_partition(*graph, [](const mc::Edge &e) { return static_cast<int>(e.num_micro_edges()); }, num_parts);
+
+  check_parts_are_connected(*graph, parts, num_parts);
+
+  // every bisection cuts a subtree off at a single vertex
+  REQUIRE(num_cut_vertices(*graph, parts) == num_parts - 1);
+
+  const double average = static_cast<double>(graph->num_edges()) / num_parts;
+  for (int part = 0; part < num_parts; part += 1)
+    REQUIRE(std::abs(std::count(parts.begin(), parts.end(), part) - average) <= 0.2 * average);
+}
+
+TEST_CASE("LocalityEdgeOrderOfBinaryTree", "[GraphPartitioner]") {
+  auto graph = create_binary_tree(4);
+
+  const auto order = mc::locality_edge_order(*graph);
+
+  REQUIRE(order.size() == graph->num_edges());
+  std::vector<std::size_t> position(graph->num_edges());
+  for (std::size_t k = 0; k < order.size(); k += 1)
+    position[order[k]] = k;
+
+  // for every edge the vessels on one of its sides, i.e. the subtree away from the start of the traversal, form a contiguous range
+  for (auto e_id : graph->get_edge_ids()) {
+    bool has_contiguous_side = false;
+    for (auto v_id : graph->edge(e_id).get_vertex_neighbors()) {
+      std::set<std::size_t> side{e_id};
+      std::vector<std::size_t> stack{e_id};
+      while (!stack.empty()) {
+        const auto s_id = stack.back();
+        stack.pop_back();
+        for (auto w_id : graph->edge(s_id).get_vertex_neighbors()) {
+          if (s_id == e_id && w_id != v_id)
+            continue;
+          for (auto n_id : graph->vertex(w_id).get_edge_neighbors())
+            if (side.insert(n_id).second)
+              stack.push_back(n_id);
+        }
+      }
+      std::size_t first = order.size(), last = 0;
+      for (auto s_id : side) {
+        first = std::min(first, position[s_id]);
+        last = std::max(last, position[s_id]);
+      }
+      has_contiguous_side = has_contiguous_side || (last - first + 1 == side.size());
+    }
+    REQUIRE(has_contiguous_side);
+  }
+
+  // the rank dependent lists follow the order, while the ids stay the same
+  graph->set_edge_order(order);
+  REQUIRE(graph->get_active_edge_ids(0) == order);
+  REQUIRE(graph->get_edge_ids().front() == 0);
+
+  REQUIRE_THROWS(graph->set_edge_order({0, 1, 1}));
+}
+
+TEST_CASE("PartitionFilesAreReusedForTheSameMesh", "[GraphPartitioner]") {
+  const std::string filepath = "./graph_partitioner_test.partition";
+  const auto estimator = [](const mc::Edge &e) { return static_cast<int>(e.num_micro_edges()); };
+
+  auto graph = create_binary_tree(3);
+  const auto hash = mc::mesh_hash(*graph, {2});
+  REQUIRE(hash == mc::mesh_hash(*create_binary_tree(3), {2}));
+  REQUIRE(hash != mc::mesh_hash(*graph, {3}));
+  REQUIRE(hash != mc::mesh_hash(*create_binary_tree(2), {2}));
+
+  // nothing is assigned without a file
+  if (mc::mpi::rank(MPI_COMM_WORLD) == 0)
+    std::remove(filepath.c_str());
+  MPI_Barrier(MPI_COMM_WORLD);
+  REQUIRE(!mc::read_partition(MPI_COMM_WORLD, filepath, hash, *graph));
+
+  mc::topology_aware_mesh_partitioner(MPI_COMM_WORLD, *graph, estimator);
+  // the assignment does not change the hash
+  REQUIRE(mc::mesh_hash(*graph, {2}) == hash);
+  mc::write_partition(MPI_COMM_WORLD, filepath, *graph, hash);
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  auto reread_graph = create_binary_tree(3);
+  REQUIRE(mc::read_partition(MPI_COMM_WORLD, filepath, hash, *reread_graph));
+  for (auto e_id : graph->get_edge_ids())
+    REQUIRE(reread_graph->edge(e_id).rank() == graph->edge(e_id).rank());
+
+  // another mesh or other settings fall back to the partitioner
+  auto other_graph = create_binary_tree(2);
+  REQUIRE(!mc::read_partition(MPI_COMM_WORLD, filepath, mc::mesh_hash(*other_graph, {2}), *other_graph));
+  REQUIRE(!mc::read_partition(MPI_COMM_WORLD, filepath, mc::mesh_hash(*reread_graph, {3}), *reread_graph));
+
+  // a partition for another number of ranks is ignored
+  if (mc::mpi::size(MPI_COMM_WORLD) > 1) {
+    if (mc::mpi::rank(MPI_COMM_WORLD) == 0)
+      mc::write_partition(MPI_COMM_SELF, filepath, *graph, hash);
+    MPI_Barrier(MPI_COMM_WORLD);
+    REQUIRE(!mc::read_partition(MPI_COMM_WORLD, filepath, hash, *reread_graph));
+  }
+
+  // a truncated file is an error
+  MPI_Barrier(MPI_COMM_WORLD);
+  if (mc::mpi::rank(MPI_COMM_WORLD) == 0) {
+    mc::write_partition(MPI_COMM_WORLD, filepath, *graph, hash);
+    std::ifstream f(filepath, std::ios::binary);
+    std::string contents((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    std::ofstream(filepath, std::ios::binary | std::ios::trunc) << contents.substr(0, contents.size() - 4);
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+  REQUIRE_THROWS(mc::read_partition(MPI_COMM_WORLD, filepath, hash, *reread_graph));
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  if (mc::mpi::rank(MPI_COMM_WORLD) == 0)
+    std::remove(filepath.c_str());
+}
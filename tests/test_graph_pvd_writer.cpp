@@ -0,0 +1,105 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/graph_pvd_writer.hpp"
+#include "macrocirculation/graph_storage.hpp"
+
+namespace mc = macrocirculation;
+
+namespace {
+
+std::string read_file(const std::string &path) {
+  std::ifstream f(path, std::ios::in | std::ios::binary);
+  std::stringstream content;
+  content << f.rdbuf();
+  return content.str();
+}
+
+/*! @brief Reads the block of the appended data at the given offset. */
+template <typename T>
+std::vector<T> read_appended_block(const std::string &vtp, std::size_t offset) {
+  const auto start = vtp.find("<AppendedData encoding=\"raw\">\n_") + std::strlen("<AppendedData encoding=\"raw\">\n_") + offset;
+  std::uint64_t num_bytes;
+  std::memcpy(&num_bytes, &vtp[start], sizeof(num_bytes));
+  std::vector<T> values(num_bytes / sizeof(T));
+  std::memcpy(values.data(), &vtp[start + sizeof(num_bytes)], num_bytes);
+  return values;
+}
+
+} // namespace
+
+TEST_CASE("PVDWriterAppendsTheRawBinaryData", "[GraphPVDWriter]") {
+  const auto rank = mc::mpi::rank(MPI_COMM_WORLD);
+  const std::string dataset = "test_pvd_writer_raw";
+
+  mc::GraphPVDWriter writer(MPI_COMM_WORLD, ".", dataset);
+  writer.set_format(mc::GraphPVDWriter::Format::raw_appended);
+
+  const std::vector<mc::Point> points{{0, 0, 0}, {1, 0, 0}, {1, 0, 0}, {1, 2, rank + 0.5}};
+
+  for (std::size_t step = 0; step < 2; step += 1) {
+    writer.set_points(points);
+    writer.add_vertex_data("p", {1. + step, 2., 3., 4.});
+    writer.set_double_precision(step == 1);
+    writer.add_vertex_data("q", {-1., -2., -3., -4. - step});
+    writer.write(0.5 * step);
+  }
+
+  const auto vtp = read_file("./" + dataset + "_" + std::to_string(rank) + "_1.vtp");
+
+  // points (3*4 floats), connectivity (4 ints), offsets (2 ints) and the two fields follow each other
+  const std::size_t header = sizeof(std::uint64_t);
+  const std::size_t points_offset = 0;
+  const std::size_t connectivity_offset = points_offset + header + 12 * sizeof(float);
+  const std::size_t offsets_offset = connectivity_offset + header + 4 * sizeof(std::int32_t);
+  const std::size_t p_offset = offsets_offset + header + 2 * sizeof(std::int32_t);
+  const std::size_t q_offset = p_offset + header + 4 * sizeof(double);
+
+  REQUIRE(vtp.find("offset=\"" + std::to_string(q_offset) + "\"") != std::string::npos);
+  REQUIRE(vtp.find("<DataArray type=\"Float64\" Name=\"p\" format=\"appended\"") != std::string::npos);
+
+  const auto coordinates = read_appended_block<float>(vtp, points_offset);
+  REQUIRE(coordinates.size() == 12);
+  REQUIRE(coordinates[3] == Approx(1.));
+  REQUIRE(coordinates[10] == Approx(2.));
+  REQUIRE(coordinates[11] == Approx(rank + 0.5));
+
+  REQUIRE(read_appended_block<std::int32_t>(vtp, connectivity_offset) == std::vector<std::int32_t>{0, 1, 2, 3});
+  REQUIRE(read_appended_block<std::int32_t>(vtp, offsets_offset) == std::vector<std::int32_t>{2, 4});
+  REQUIRE(read_appended_block<double>(vtp, p_offset) == std::vector<double>{2., 2., 3., 4.});
+  REQUIRE(read_appended_block<double>(vtp, q_offset) == std::vector<double>{-1., -2., -3., -5.});
+
+  if (rank == 0) {
+    const auto pvtp = read_file("./" + dataset + "_1.pvtp");
+    REQUIRE(pvtp.find("<PDataArray type=\"Float64\" Name=\"q\" />") != std::string::npos);
+  }
+}
+
+TEST_CASE("PVDWriterEncodesTheBinaryDataInBase64", "[GraphPVDWriter]") {
+  const auto rank = mc::mpi::rank(MPI_COMM_WORLD);
+  const std::string dataset = "test_pvd_writer_base64";
+
+  mc::GraphPVDWriter writer(MPI_COMM_WORLD, ".", dataset);
+  writer.set_format(mc::GraphPVDWriter::Format::base64);
+  writer.set_points({{0, 0, 0}, {1, 0, 0}});
+  writer.write(0);
+
+  const auto vtp = read_file("./" + dataset + "_" + std::to_string(rank) + "_0.vtp");
+
+  // the offsets array contains its size of 4 bytes as UInt64 followed by the Int32 value 2
+  REQUIRE(vtp.find("<DataArray type=\"Int32\" Name=\"offsets\" format=\"binary\">\nBAAAAAAAAAACAAAA\n</DataArray>") != std::string::npos);
+}
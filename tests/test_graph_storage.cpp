@@ -0,0 +1,229 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/graph_storage.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("CreateInBulkAgreesWithConnect", "[GraphStorage]") {
+  const auto data = mc::PhysicalData::set_from_data(4e5, 0.01, 1.028e-3, 2, 0.1, 1.);
+
+  // a bifurcation with an isolated vertex, appended to an existing vertex
+  const std::vector<std::size_t> left{0, 1, 1};
+  const std::vector<std::size_t> right{1, 2, 3};
+  const std::vector<std::size_t> num_micro_edges{2, 1, 3};
+
+  mc::GraphStorage reference;
+  for (std::size_t k = 0; k < 6; k += 1)
+    reference.create_vertex();
+  for (std::size_t k = 0; k < left.size(); k += 1) {
+    auto edge = reference.connect(reference.vertex(1 + left[k]), reference.vertex(1 + right[k]), num_micro_edges[k]);
+    edge->add_physical_data(data);
+  }
+  reference.edge(2).add_embedding_data({{mc::Point(0, 0, 0), mc::Point(1, 0, 0)}});
+  reference.finalize_bcs();
+
+  mc::GraphStorage graph;
+  graph.create_vertex();
+  std::vector<mc::EdgeDescription> edges;
+  for (std::size_t k = 0; k < left.size(); k += 1)
+    edges.push_back({left[k], right[k], num_micro_edges[k], data, {}});
+  edges[2].embedding_data.points = {mc::Point(0, 0, 0), mc::Point(1, 0, 0)};
+  REQUIRE(graph.create_in_bulk(5, edges) == 0);
+
+  // the adjacency is available without finalizing the boundary conditions
+  REQUIRE(graph.is_finalized());
+  REQUIRE(graph.num_vertices() == reference.num_vertices());
+  REQUIRE(graph.num_edges() == reference.num_edges());
+
+  for (std::size_t v_id = 0; v_id < graph.num_vertices(); v_id += 1) {
+    REQUIRE(graph.vertex(v_id).get_edge_neighbors() == reference.vertex(v_id).get_edge_neighbors());
+    REQUIRE(graph.adjacent_edges(v_id).size() == reference.adjacent_edges(v_id).size());
+    REQUIRE(graph.find_vertex_by_name(graph.vertex(v_id).get_name()) != nullptr);
+  }
+
+  for (std::size_t e_id = 0; e_id < graph.num_edges(); e_id += 1) {
+    const auto &e = graph.edge(e_id);
+    const auto &e_ref = reference.edge(e_id);
+    REQUIRE(e.get_vertex_neighbors() == e_ref.get_vertex_neighbors());
+    REQUIRE(e.get_physical_data().A0 == e_ref.get_physical_data().A0);
+    REQUIRE(e.has_embedding_data() == e_ref.has_embedding_data());
+    REQUIRE(e.num_micro_edges() == e_ref.num_micro_edges());
+
+    // the micro primitives follow from their index and the global ids of the edge
+    REQUIRE(e.get_first_micro_edge_id() == e_ref.get_first_micro_edge_id());
+    REQUIRE(e.get_first_micro_vertex_id() == e_ref.get_first_micro_vertex_id());
+    const auto micro_vertices = e.micro_vertices();
+    REQUIRE(micro_vertices.size() == e.num_micro_vertices());
+    REQUIRE(e.left_micro_vertex().get_global_id() == micro_vertices.front().get_global_id());
+    REQUIRE(e.right_micro_vertex().get_global_id() == micro_vertices.back().get_global_id());
+    for (std::size_t k = 0; k < e.num_micro_edges(); k += 1) {
+      REQUIRE(e.micro_edges()[k].get_global_id() == e.get_first_micro_edge_id() + k);
+      REQUIRE(micro_vertices[k].get_right_edge().get_global_id() == e.micro_edges()[k].get_global_id());
+      REQUIRE(micro_vertices[k].get_right_vertex().get_local_id() == k + 1);
+      REQUIRE(micro_vertices[k + 1].get_left_vertex().get_global_id() == micro_vertices[k].get_global_id());
+    }
+  }
+
+  // the micro edges of all the edges have distinct global ids
+  REQUIRE(graph.edge(1).get_first_micro_edge_id() == graph.edge(0).get_first_micro_edge_id() + 2);
+  REQUIRE(graph.edge(1).get_first_micro_vertex_id() == graph.edge(0).get_first_micro_vertex_id() + 3);
+  std::size_t num_inner_vertices = 0;
+  for (const auto &v : graph.edge(2).inner_micro_vertices()) {
+    REQUIRE(v.get_local_id() == num_inner_vertices + 1);
+    num_inner_vertices += 1;
+  }
+  REQUIRE(num_inner_vertices == 2);
+
+  // the edges can still be modified as the ones created by connect
+  graph.set_micro_edge_lengths(graph.edge(0), {0.25, 0.25, 0.5});
+  REQUIRE(graph.edge(0).num_micro_edges() == 3);
+  REQUIRE(graph.edge(0).right_micro_vertex().get_left_edge().get_local_id() == 2);
+}
+
+TEST_CASE("SharedGraphDataAgreesWithThePrivateOne", "[GraphStorage]") {
+  auto reference = test_macrocirculation::util::create_3_vessel_network();
+  reference->finalize_bcs();
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  REQUIRE_THROWS(graph->share_on_node(MPI_COMM_WORLD));
+  graph->finalize_bcs();
+  graph->share_on_node(MPI_COMM_WORLD);
+
+  // the physical data and the adjacency are read from the node shared segment
+  REQUIRE(graph->is_finalized());
+  REQUIRE(graph->memory_report().get("edges") < reference->memory_report().get("edges"));
+  REQUIRE(graph->memory_report().get("adjacency") == 0);
+  for (auto e_id : graph->get_edge_ids()) {
+    REQUIRE(graph->edge(e_id).get_physical_data().A0 == reference->edge(e_id).get_physical_data().A0);
+    REQUIRE(graph->edge(e_id).get_physical_data().length == reference->edge(e_id).get_physical_data().length);
+  }
+  for (auto v_id : graph->get_vertex_ids()) {
+    const auto adjacent = graph->adjacent_edges(v_id);
+    const auto reference_adjacent = reference->adjacent_edges(v_id);
+    REQUIRE(adjacent.size() == reference_adjacent.size());
+    for (std::size_t k = 0; k < adjacent.size(); k += 1) {
+      REQUIRE(adjacent[k].edge_id == reference_adjacent[k].edge_id);
+      REQUIRE(adjacent[k].pointing_to == reference_adjacent[k].pointing_to);
+    }
+  }
+
+  // the edges keep the shared data alive, while new data and topology are private again
+  auto edge = graph->get_edge(1);
+  auto v = graph->create_vertex();
+  REQUIRE(!graph->is_finalized());
+  graph = nullptr;
+  REQUIRE(edge->get_physical_data().A0 == reference->edge(1).get_physical_data().A0);
+  edge->add_physical_data(reference->edge(0).get_physical_data());
+  REQUIRE(edge->get_physical_data().A0 == reference->edge(0).get_physical_data().A0);
+}
+
+namespace {
+
+/*! @brief Creates a line of num_edges edges, where every edge is assigned to the rank edges_per_rank * rank, ..., edges_per_rank * (rank + 1) - 1. */
+std::shared_ptr<mc::GraphStorage> create_distributed_line(std::size_t num_edges, std::size_t edges_per_rank) {
+  const auto data = mc::PhysicalData::set_from_data(4e5, 0.01, 1.028e-3, 2, 0.1, 1.);
+  auto graph = std::make_shared<mc::GraphStorage>();
+  std::vector<mc::EdgeDescription> edges;
+  for (std::size_t k = 0; k < num_edges; k += 1)
+    edges.push_back({k, k + 1, 4, data, {}});
+  graph->create_in_bulk(num_edges + 1, edges);
+  for (std::size_t e_id = 0; e_id < num_edges; e_id += 1) {
+    graph->edge(e_id).set_name("vessel_" + std::to_string(e_id));
+    graph->assign_edge_to_rank(graph->edge(e_id), static_cast<int>(e_id / edges_per_rank));
+  }
+  graph->finalize_bcs();
+  return graph;
+}
+
+} // namespace
+
+TEST_CASE("RestrictedGraphKeepsTheOwnedAndTheGhostPrimitives", "[GraphStorage]") {
+  auto reference = create_distributed_line(8, 2);
+  auto graph = create_distributed_line(8, 2);
+  REQUIRE(!graph->is_restricted());
+  graph->restrict_to_rank(1);
+  REQUIRE(graph->is_restricted());
+
+  // the owned edges 2, 3 and the ghost edges 1, 4 with their vertices are kept under their global ids
+  REQUIRE(graph->num_edges() == 8);
+  REQUIRE(graph->num_vertices() == 9);
+  REQUIRE(graph->get_edge_ids() == std::vector<std::size_t>{1, 2, 3, 4});
+  REQUIRE(graph->get_vertex_ids() == std::vector<std::size_t>{1, 2, 3, 4, 5});
+  REQUIRE_THROWS(graph->edge(0));
+  REQUIRE_THROWS(graph->vertex(7));
+  REQUIRE_THROWS(graph->find_edge_by_name("vessel_6"));
+  REQUIRE(graph->find_edge_by_name("vessel_4")->get_id() == 4);
+  REQUIRE(graph->edge(1).get_physical_data().A0 == reference->edge(1).get_physical_data().A0);
+  REQUIRE(graph->adjacent_edges(1).size() == 2);
+
+  // the lists of rank 1 do not change
+  REQUIRE(graph->get_active_edge_ids(1) == reference->get_active_edge_ids(1));
+  REQUIRE(graph->get_active_vertex_ids(1) == reference->get_active_vertex_ids(1));
+  for (int other_rank : {0, 2, 3}) {
+    REQUIRE(graph->get_ghost_edge_ids(1, other_rank) == reference->get_ghost_edge_ids(1, other_rank));
+    REQUIRE(graph->get_ghost_edge_ids(other_rank, 1) == reference->get_ghost_edge_ids(other_rank, 1));
+  }
+  REQUIRE_THROWS(graph->get_active_edge_ids(0));
+  REQUIRE_THROWS(graph->get_ghost_edge_ids(0, 2));
+  REQUIRE_THROWS(graph->assign_edge_to_rank(graph->edge(2), 0));
+
+  REQUIRE(graph->memory_report().get("edges") < reference->memory_report().get("edges"));
+  REQUIRE(graph->memory_report().get("vertices") < reference->memory_report().get("vertices"));
+}
+
+TEST_CASE("RestrictedGraphHasTheSameDofs", "[GraphStorage]") {
+  const int size = mc::mpi::size(MPI_COMM_WORLD);
+  const int rank = mc::mpi::rank(MPI_COMM_WORLD);
+  auto reference = create_distributed_line(3 * size, 3);
+  auto graph = create_distributed_line(3 * size, 3);
+  graph->restrict_to_rank(rank);
+
+  mc::DofMap reference_dof_map(*reference);
+  reference_dof_map.create(MPI_COMM_WORLD, *reference, 2, 2, true);
+  mc::DofMap dof_map(*graph);
+  dof_map.create(MPI_COMM_WORLD, *graph, 2, 2, true);
+
+  REQUIRE(dof_map.num_owned_dofs() == reference_dof_map.num_owned_dofs());
+  for (auto e_id : graph->get_edge_ids()) {
+    const auto &local_dof_map = dof_map.get_local_dof_map(graph->edge(e_id));
+    const auto &reference_local_dof_map = reference_dof_map.get_local_dof_map(reference->edge(e_id));
+    REQUIRE(local_dof_map.first_dof(0, 0) == reference_local_dof_map.first_dof(0, 0));
+    REQUIRE(local_dof_map.num_local_dof() == reference_local_dof_map.num_local_dof());
+  }
+}
+
+TEST_CASE("NeighborRanksShareAGhostLayer", "[GraphStorage]") {
+  // two lines on the ranks 0, ..., 3 and 4, ..., 6, whose ends are connected
+  auto graph_1 = create_distributed_line(8, 2);
+  auto graph_2 = create_distributed_line(6, 2);
+  for (auto e_id : graph_2->get_edge_ids())
+    graph_2->assign_edge_to_rank(graph_2->edge(e_id), graph_2->edge(e_id).rank() + 4);
+  mc::Vertex::connect(graph_1, graph_1->vertex(8), graph_2, graph_2->vertex(0));
+
+  for (const auto &graph : {graph_1, graph_2}) {
+    for (int rank = 0; rank < 7; rank += 1) {
+      // the ranks, which would be found by checking all the pairs of ranks
+      std::vector<int> neighbor_ranks;
+      for (int other_rank = 0; other_rank < 7; other_rank += 1)
+        if (other_rank != rank && (!graph->get_ghost_edge_ids(rank, other_rank).empty() || !graph->get_ghost_edge_ids(other_rank, rank).empty()))
+          neighbor_ranks.push_back(other_rank);
+      REQUIRE(graph->get_neighbor_ranks(rank) == neighbor_ranks);
+    }
+  }
+  REQUIRE(graph_1->get_neighbor_ranks(1) == std::vector<int>{0, 2});
+  REQUIRE(graph_1->get_neighbor_ranks(3) == std::vector<int>{2, 4});
+  REQUIRE(graph_2->get_neighbor_ranks(4) == std::vector<int>{3, 5});
+  REQUIRE(graph_1->get_neighbor_ranks(5).empty());
+}
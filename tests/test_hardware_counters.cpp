@@ -0,0 +1,115 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/hardware_counters.hpp"
+#include "macrocirculation/phase_timers.hpp"
+#include "macrocirculation/roofline.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("RawHardwareEventsAreParsed", "[HardwareCounters]") {
+  const auto events = mc::HardwareCounters::parse_raw_events("flops scalar=0x01c7,flops 256=0x10c7*4,");
+  REQUIRE(events.size() == 2);
+  REQUIRE(events[0].name == "flops scalar");
+  REQUIRE(events[0].config == 0x01c7);
+  REQUIRE(events[0].weight == 1.);
+  REQUIRE(events[1].name == "flops 256");
+  REQUIRE(events[1].config == 0x10c7);
+  REQUIRE(events[1].weight == 4.);
+
+  REQUIRE_THROWS(mc::HardwareCounters::parse_raw_events("0x01c7"));
+}
+
+TEST_CASE("HardwareCountersIncreaseOrAreUnavailable", "[HardwareCounters]") {
+  const auto before = mc::HardwareCounters::read();
+  double sum = 0;
+  for (std::size_t k = 0; k < 1000000; k += 1)
+    sum += std::sqrt(static_cast<double>(k));
+  const auto after = mc::HardwareCounters::read();
+  REQUIRE(sum > 0);
+
+  // events, which cannot be opened, e.g. in virtual machines, count zero
+  for (std::size_t k = 0; k < before.size(); k += 1)
+    REQUIRE(after[k] >= before[k]);
+  if (!mc::HardwareCounters::available()) {
+    for (auto count : after)
+      REQUIRE(count == 0);
+  }
+
+  REQUIRE(mc::HardwareCounters::index_of("unknown event") == mc::HardwareCounters::max_events);
+}
+
+TEST_CASE("PhasesArePlacedOnTheRoofline", "[HardwareCounters][Roofline]") {
+  const int size = mc::mpi::size(MPI_COMM_WORLD);
+
+  std::vector<mc::HardwareCounters::Event> events{
+    {"cycles", 0, 0, 1.},
+    {"instructions", 0, 1, 1.},
+    {"cache references", 0, 2, 1.},
+    {"cache misses", 0, 3, 1.},
+    {"flops scalar", 4, 0x01c7, 1.},
+    {"flops 256", 4, 0x10c7, 4.}};
+
+  // counts summed over all the ranks
+  const double n = size;
+  std::vector<mc::PhaseTimers::Statistics> statistics{
+    // 1e6 flops from 1e6 bytes: memory bound
+    {"rhs", 1, 1e-3, 1e-3, 1e-3, {n * 2e6, n * 4e6, n * 1e5, n * 15625, n * 6e5, n * 1e5}},
+    // 1e8 flops from 6.4e4 bytes: compute bound
+    {"rhs/cell assembly", 1, 1e-2, 1e-2, 1e-2, {n * 1e7, n * 1e7, n * 1e4, n * 1e3, 0, n * 2.5e7}},
+    // no flops were counted
+    {"rhs/upwinding", 1, 1e-4, 1e-4, 1e-4, {n * 1e3, n * 1e3, 0, 0, 0, 0}},
+    // never entered
+    {"output", 0, 0, 0, 0, {0, 0, 0, 0, 0, 0}}};
+
+  const mc::MachinePeaks peaks{1e10, 1e9};
+  const auto points = mc::place_on_roofline(statistics, events, peaks, size);
+  REQUIRE(points.size() == 3);
+
+  REQUIRE(points[0].path == "rhs");
+  REQUIRE(points[0].flops == Approx(1e6));
+  REQUIRE(points[0].bytes == Approx(1e6));
+  REQUIRE(points[0].arithmetic_intensity == Approx(1.));
+  REQUIRE(points[0].flops_per_second == Approx(1e9));
+  REQUIRE(points[0].attainable_flops_per_second == Approx(1e9));
+  REQUIRE(points[0].vector_ratio == Approx(0.4));
+  REQUIRE(points[0].instructions_per_cycle == Approx(2.));
+  REQUIRE(points[0].cache_miss_ratio == Approx(0.15625));
+  REQUIRE(points[0].bound == "memory");
+
+  REQUIRE(points[1].arithmetic_intensity == Approx(1e8 / 6.4e4));
+  REQUIRE(points[1].attainable_flops_per_second == Approx(1e10));
+  REQUIRE(points[1].vector_ratio == Approx(1.));
+  REQUIRE(points[1].bound == "compute");
+
+  REQUIRE(points[2].bound == "unknown");
+
+  std::stringstream table;
+  mc::print_roofline(points, peaks, table);
+  REQUIRE(table.str().find("rhs/cell assembly") != std::string::npos);
+}
+
+TEST_CASE("PhaseTimersReduceTheHardwareCounts", "[HardwareCounters][PhaseTimers]") {
+  mc::PhaseTimers::reset();
+  {
+    mc::ScopedPhaseTimer phase("counted");
+  }
+
+  // without MACROCIRCULATION_HARDWARE_COUNTERS the counts stay zero
+  for (const auto &s : mc::PhaseTimers::reduce(MPI_COMM_WORLD)) {
+    REQUIRE(s.counts.size() == mc::HardwareCounters::get_events().size());
+    for (auto count : s.counts)
+      REQUIRE(count >= 0);
+  }
+}
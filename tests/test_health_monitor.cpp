@@ -0,0 +1,159 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "macrocirculation/conservation_monitor.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/health_monitor.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("HealthMonitorLocalizesErrors", "[HealthMonitor]") {
+  const size_t degree = 2;
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_SELF);
+
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_SELF, *graph, 2, degree, false);
+
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_SELF, graph, dof_map, degree);
+  auto &u = solver.get_solution();
+
+  mc::HealthMonitor monitor(MPI_COMM_SELF, graph, dof_map);
+
+  // the initial solution is healthy
+  REQUIRE(monitor.find_error(u, mc::HealthCheckLevel::full).empty());
+
+  const auto &edge = *graph->get_edge(1);
+  const auto &local_dof_map = dof_map->get_local_dof_map(edge);
+  const std::size_t micro_edge_id = local_dof_map.num_micro_edges() / 2;
+
+  SECTION("NaN inside an edge") {
+    local_dof_map.dof_values(u, micro_edge_id, mc::ExplicitNonlinearFlowSolver::Q_component)[1] = NAN;
+
+    const auto error = monitor.find_error(u, mc::HealthCheckLevel::full);
+    INFO(error);
+    REQUIRE(error.find("non finite") != std::string::npos);
+    REQUIRE(error.find("edge 1 ") != std::string::npos);
+    REQUIRE(error.find("micro edge " + std::to_string(micro_edge_id)) != std::string::npos);
+
+    // the cheaper checks do not look into the interior of the edges
+    REQUIRE(monitor.find_error(u, mc::HealthCheckLevel::sampled).empty());
+
+    monitor.set_level(mc::HealthCheckLevel::full);
+    monitor.set_interval(2);
+    REQUIRE_NOTHROW(monitor.step(u));
+    REQUIRE_THROWS(monitor.step(u));
+  }
+
+  SECTION("negative area") {
+    local_dof_map.dof_values(u, micro_edge_id, mc::ExplicitNonlinearFlowSolver::A_component)[0] *= -1;
+
+    const auto error = monitor.find_error(u, mc::HealthCheckLevel::full);
+    INFO(error);
+    REQUIRE(error.find("non positive area") != std::string::npos);
+    REQUIRE(error.find("edge 1 ") != std::string::npos);
+  }
+}
+
+TEST_CASE("WaveSpeedMonitorReportsTheCflNumber", "[HealthMonitor]") {
+  const size_t degree = 2;
+  const double tau = 1e-4;
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, degree);
+  solver.use_ssp_method();
+
+  // the cfl number of the stable time step is one
+  const auto diagnostics = solver.calculate_wave_speed_diagnostics(tau);
+  REQUIRE(diagnostics.max_speed > 0);
+  REQUIRE(diagnostics.rank_max_speed <= diagnostics.max_speed);
+  REQUIRE(diagnostics.rank_cfl <= diagnostics.cfl);
+  REQUIRE(diagnostics.cfl == Approx(tau / solver.calculate_stable_time_step(1.)).epsilon(1e-12));
+
+  // the edges of level one take twice the time step
+  solver.set_time_step_levels(std::vector<std::size_t>(graph->num_edges(), 1));
+  REQUIRE(solver.calculate_wave_speed_diagnostics(tau).cfl == Approx(2 * diagnostics.cfl).epsilon(1e-12));
+  solver.set_time_step_levels({});
+
+  // the monitor only evaluates every third step
+  solver.set_wave_speed_monitor(3, 0.5);
+  REQUIRE(std::isnan(solver.get_wave_speed_diagnostics().cfl));
+  double t = 0;
+  for (std::size_t step = 0; step < 2; step += 1, t += tau)
+    solver.solve(tau, t);
+  REQUIRE(std::isnan(solver.get_wave_speed_diagnostics().cfl));
+  solver.solve(tau, t);
+  const auto monitored = solver.get_wave_speed_diagnostics();
+  const auto expected = solver.calculate_wave_speed_diagnostics(tau);
+  REQUIRE(monitored.cfl == expected.cfl);
+  REQUIRE(monitored.max_speed == expected.max_speed);
+  REQUIRE(monitored.rank_cfl == expected.rank_cfl);
+}
+
+TEST_CASE("ConservationMonitorBalancesTheVolume", "[HealthMonitor]") {
+  const size_t degree = 2;
+  const double tau = 1e-4;
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, degree);
+  solver.use_ssp_method();
+  auto &monitor = solver.get_conservation_monitor();
+
+  // the vessels are at rest with their reference area
+  double reference_volume = 0;
+  for (auto e_id : graph->get_edge_ids())
+    reference_volume += graph->edge(e_id).get_physical_data().A0 * graph->edge(e_id).get_physical_data().length;
+  const auto initial = monitor.calculate(solver.get_solution());
+  REQUIRE(!monitor.is_active());
+  REQUIRE(std::isnan(initial.volume_error));
+  REQUIRE(initial.volume_1d == Approx(reference_volume).epsilon(1e-12));
+  REQUIRE(initial.kinetic_energy == 0);
+  REQUIRE(initial.elastic_energy == 0);
+
+  monitor.reset(solver.get_solution());
+  double t = 0;
+  for (std::size_t step = 0; step < 1000; step += 1, t += tau)
+    solver.solve(tau, t);
+
+  // the heart pumps blood into the vessels, which widen and store it
+  const auto diagnostics = monitor.calculate(solver.get_solution());
+  INFO("volume " << diagnostics.volume_1d << " inflow " << diagnostics.boundary_inflow << " error " << diagnostics.volume_error);
+  REQUIRE(diagnostics.boundary_inflow > 0);
+  REQUIRE(diagnostics.volume_1d - initial.volume_1d == Approx(diagnostics.boundary_inflow).epsilon(1e-3));
+  REQUIRE(std::abs(diagnostics.volume_error) < 1e-3 * diagnostics.boundary_inflow);
+  REQUIRE(diagnostics.kinetic_energy > 0);
+  REQUIRE(diagnostics.elastic_energy > 0);
+  REQUIRE(diagnostics.volume_0d > 0);
+}
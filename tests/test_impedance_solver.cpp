@@ -0,0 +1,89 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <cmath>
+#include <complex>
+#include <memory>
+
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/impedance_solver.hpp"
+#include "macrocirculation/vessel_formulas.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("MeanHarmonicIsThePoiseuilleFlow", "[ImpedanceSolver]") {
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+
+  mc::ImpedanceSolver solver(graph, 1., 20);
+  solver.solve();
+
+  // the mean of the heart beat of the 3 vessel network over a period
+  const double mean_inflow = 485. * 0.3 * 2. / M_PI;
+  REQUIRE(solver.get_flow_harmonic(0, 0).real() == Approx(mean_inflow).epsilon(1e-4));
+  REQUIRE(solver.get_flow_harmonic(1, 0).real() + solver.get_flow_harmonic(2, 0).real() == Approx(solver.get_flow_harmonic(0, 0).real()).epsilon(1e-10));
+
+  // the windkessel models are resistances for the mean flow
+  const auto &data = graph->vertex(2).get_peripheral_vessel_data();
+  const auto &param = graph->edge(1).get_physical_data();
+  const double R_vessel = mc::linear::get_L(param) * mc::linear::get_R(param) * param.length;
+  const double Q = solver.get_flow_harmonic(1, 0).real();
+  REQUIRE(solver.get_pressure_harmonic(2, 0).real() == Approx(data.p_out + data.resistance * Q).epsilon(1e-10));
+  REQUIRE(solver.get_pressure_harmonic(1, 0).real() == Approx(data.p_out + (data.resistance + R_vessel) * Q).epsilon(1e-10));
+
+  // the flow is conserved along the vessel and the reconstructed signals are continuous at the vertices
+  const auto &edge = graph->edge(0);
+  for (double t : {0.1, 0.25, 0.7}) {
+    REQUIRE(solver.get_pressure(edge, 0., t) == Approx(solver.get_pressure(0, t)).epsilon(1e-10));
+    REQUIRE(solver.get_pressure(edge, 1., t) == Approx(solver.get_pressure(1, t)).epsilon(1e-8));
+    const double Q_out = solver.get_flow(graph->edge(1), 0., t) + solver.get_flow(graph->edge(2), 0., t);
+    REQUIRE(solver.get_flow(edge, 1., t) == Approx(Q_out).epsilon(1e-8));
+  }
+
+  // the inflow is reconstructed from its harmonics
+  REQUIRE(solver.get_flow(edge, 0., 0.15) == Approx(485.).epsilon(1e-2));
+  REQUIRE(std::abs(solver.get_flow(edge, 0., 0.6)) < 1e-2 * 485.);
+}
+
+TEST_CASE("InputImpedanceOfAMatchedVessel", "[ImpedanceSolver]") {
+  // a single vessel without friction, which is closed by its characteristic impedance
+  auto graph = std::make_shared<mc::GraphStorage>();
+  auto &v0 = *graph->create_vertex();
+  auto &v1 = *graph->create_vertex();
+  auto &edge = *graph->connect(v0, v1, 10);
+  auto param = mc::PhysicalData::set_from_data(400000.0, 0.163, 1.028e-3, 9, 1.2, 4.0);
+  param.viscosity = 0;
+  edge.add_physical_data(param);
+  v0.set_to_inflow_with_fixed_flow(mc::heart_beat_inflow(485.));
+  v1.set_to_free_outflow();
+  graph->finalize_bcs();
+
+  mc::ImpedanceSolver solver(graph, 1., 10);
+  for (double omega : {2 * M_PI, 20 * M_PI, 200 * M_PI}) {
+    const auto Z = solver.calculate_input_impedance(v0.get_id(), omega);
+    REQUIRE(Z.real() == Approx(mc::calculate_R1(param)).epsilon(1e-8));
+    REQUIRE(std::abs(Z.imag()) < 1e-8 * mc::calculate_R1(param));
+  }
+}
+
+TEST_CASE("InputImpedanceOfAWindkessel", "[ImpedanceSolver]") {
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+
+  mc::ImpedanceSolver solver(graph, 1., 10);
+
+  // the compliances short the resistances for high frequencies, such that the impedance approaches the characteristic impedance
+  const double Z_0 = std::abs(solver.calculate_input_impedance(0, 0.));
+  const double Z_high = std::abs(solver.calculate_input_impedance(0, 2 * M_PI * 100));
+  const double R1 = mc::calculate_R1(graph->edge(0).get_physical_data());
+  REQUIRE(Z_high < 0.2 * Z_0);
+  REQUIRE(Z_high == Approx(R1).epsilon(0.5));
+}
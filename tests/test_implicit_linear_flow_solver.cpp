@@ -0,0 +1,178 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <cmath>
+#include <memory>
+
+#include "macrocirculation/coupled_explicit_implicit_1d_solver.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/implicit_linear_flow_solver.hpp"
+#include "macrocirculation/rcr_estimator.hpp"
+#include "macrocirculation/vessel_formulas.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+namespace {
+
+mc::PhysicalData create_physical_data(double radius, double length) {
+  return mc::PhysicalData::set_from_data(400000.0, 0.067, 1.028e-3, 9, radius, length);
+}
+
+} // namespace
+
+/*! @brief Checks that a constant inflow converges to the stationary solution, whose pressure decreases linearly by the friction. */
+TEST_CASE("ImplicitLinearFlowReachesStationaryFlow", "[ImplicitLinearFlowSolver]") {
+  const std::size_t degree = 2;
+  const double q_in = 2.;
+
+  auto graph = std::make_shared<mc::GraphStorage>();
+  auto v0 = graph->create_vertex();
+  auto v1 = graph->create_vertex();
+  auto edge = graph->connect(*v0, *v1, 8);
+  edge->add_embedding_data({{mc::Point(0, 0, 0), mc::Point(1, 0, 0)}});
+  const auto param = create_physical_data(0.4, 10.);
+  edge->add_physical_data(param);
+
+  v0->set_to_inflow_with_fixed_flow([=](double) { return q_in; });
+  v1->set_to_free_outflow();
+  graph->finalize_bcs();
+
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+
+  auto dof_map = mc::ImplicitLinearFlowSolver::create_dof_map(MPI_COMM_WORLD, *graph, degree);
+  mc::ImplicitLinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, degree);
+
+  // the implicit euler method converges for time steps far above the cfl condition of the edge
+  const double tau = 1e-2;
+  double t = 0;
+  for (std::size_t k = 0; k < 2000; k += 1) {
+    solver.solve(tau, t);
+    t += tau;
+  }
+
+  // at the outflow p = Z q, and from there the pressure increases by L R q per length
+  const double Z = std::sqrt(mc::linear::get_L(param) / mc::linear::get_C(param));
+  const double drop = mc::linear::get_L(param) * mc::linear::get_R(param) * q_in;
+
+  // only the rank of the edge knows its dof map
+  int rank = 0;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  if (edge->rank() != rank)
+    return;
+
+  for (double s : {0., 0.3, 1.}) {
+    double p, q;
+    solver.evaluate_1d_pq_values(*edge, s, p, q);
+    REQUIRE(q == Approx(q_in).epsilon(1e-8));
+    REQUIRE(p == Approx(Z * q_in + drop * (1 - s) * param.length).epsilon(1e-8));
+  }
+}
+
+/*! @brief Checks that the windkessels of the 3 vessel network take up the inflow in the stationary state on every rank. */
+TEST_CASE("ImplicitLinearFlowConservesTheFlowAtTheBifurcation", "[ImplicitLinearFlowSolver]") {
+  const std::size_t degree = 2;
+  const double q_in = 5.;
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->find_vertex_by_name("in")->set_to_inflow_with_fixed_flow([=](double) { return q_in; });
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+
+  auto dof_map = mc::ImplicitLinearFlowSolver::create_dof_map(MPI_COMM_WORLD, *graph, degree);
+  mc::ImplicitLinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, degree);
+
+  mc::FlowIntegrator flow_integrator(MPI_COMM_WORLD, graph);
+
+  const double tau = 5e-2;
+  double t = 0;
+  for (std::size_t k = 0; k < 4000; k += 1) {
+    solver.solve(tau, t);
+    t += tau;
+  }
+
+  // the flows of the last second
+  for (std::size_t k = 0; k < 20; k += 1) {
+    solver.solve(tau, t);
+    t += tau;
+    flow_integrator.update_flow(solver, tau);
+  }
+
+  const auto data = flow_integrator.get_windkessel_outflow_data();
+  REQUIRE(data.flows.size() == 2);
+  REQUIRE(data.total_flow == Approx(q_in * 20 * tau).epsilon(1e-6));
+}
+
+/*! @brief Checks that the explicit model and the implicit model with larger steps agree on the flow at their coupling. */
+TEST_CASE("CoupledExplicitImplicitFlowIsContinuous", "[ImplicitLinearFlowSolver]") {
+  const double q_in = 1.;
+
+  // the nonlinear model
+  auto graph_nl = std::make_shared<mc::GraphStorage>();
+  auto v0 = graph_nl->create_vertex();
+  auto v1 = graph_nl->create_vertex();
+  auto edge_nl = graph_nl->connect(*v0, *v1, 10);
+  edge_nl->add_embedding_data({{mc::Point(0, 0, 0), mc::Point(1, 0, 0)}});
+  edge_nl->add_physical_data(create_physical_data(0.4, 10.));
+  v0->set_to_inflow_with_fixed_flow([=](double) { return q_in; });
+
+  // the linearized model of a smaller vessel
+  auto graph_li = std::make_shared<mc::GraphStorage>();
+  auto v2 = graph_li->create_vertex();
+  auto v3 = graph_li->create_vertex();
+  auto edge_li = graph_li->connect(*v2, *v3, 10);
+  edge_li->add_embedding_data({{mc::Point(1, 0, 0), mc::Point(2, 0, 0)}});
+  edge_li->add_physical_data(create_physical_data(0.3, 2.));
+  v3->set_to_free_outflow();
+
+  mc::Vertex::connect(graph_nl, *v1, graph_li, *v2);
+  mc::CoupledExplicitImplicit1DSolver::setup_coupling_bcs(graph_nl, graph_li);
+  REQUIRE(v1->is_linear_characteristic_inflow());
+  REQUIRE(v2->is_nonlinear_characteristic_inflow());
+
+  graph_nl->finalize_bcs();
+  graph_li->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph_nl, MPI_COMM_WORLD);
+  mc::naive_mesh_partitioner(*graph_li, MPI_COMM_WORLD);
+
+  mc::CoupledExplicitImplicit1DSolver solver(MPI_COMM_WORLD, graph_nl, graph_li, 2, 2);
+  solver.get_explicit_solver().use_ssp_method();
+
+  // the implicit model takes steps of 10 times the explicit one
+  const double tau = 1e-4;
+  const std::size_t num_explicit_steps = 10;
+  double t = 0;
+  for (std::size_t k = 0; k < 1500; k += 1) {
+    solver.solve(tau, num_explicit_steps, t);
+    t += num_explicit_steps * tau;
+  }
+
+  int rank = 0;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  double p_nl = 0, q_nl = 0, p_li = 0, q_li = 0;
+  if (edge_nl->rank() == rank)
+    solver.get_explicit_solver().get_1d_pq_values_at_vertex(*v1, p_nl, q_nl);
+  if (edge_li->rank() == rank)
+    solver.get_implicit_solver().get_1d_pq_values_at_vertex(*v2, p_li, q_li);
+  MPI_Bcast(&p_nl, 1, MPI_DOUBLE, edge_nl->rank(), MPI_COMM_WORLD);
+  MPI_Bcast(&q_nl, 1, MPI_DOUBLE, edge_nl->rank(), MPI_COMM_WORLD);
+  MPI_Bcast(&p_li, 1, MPI_DOUBLE, edge_li->rank(), MPI_COMM_WORLD);
+  MPI_Bcast(&q_li, 1, MPI_DOUBLE, edge_li->rank(), MPI_COMM_WORLD);
+
+  REQUIRE(std::isfinite(p_nl));
+  // both sides upwind the coupling with their own model, hence the traces agree only up to the linearization
+  REQUIRE(q_nl == Approx(q_in).epsilon(1e-2));
+  REQUIRE(q_li == Approx(q_in).epsilon(1e-2));
+  REQUIRE(p_li == Approx(p_nl).epsilon(1e-2));
+}
@@ -0,0 +1,216 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/derived_quantities.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/fe_type.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/interpolate_to_vertices.hpp"
+#include "macrocirculation/interpolation_plan.hpp"
+#include "macrocirculation/output_resolution.hpp"
+#include "macrocirculation/vessel_formulas.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("InterpolationPlanEvaluatesTheFlowFieldsAtTheMicroVertices", "[InterpolationPlan]") {
+  const std::size_t degree = 2;
+  const double tau = 1e-4;
+  const auto rank = mc::mpi::rank(MPI_COMM_WORLD);
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, degree);
+  solver.use_ssp_method();
+
+  const mc::InterpolationPlan plan(MPI_COMM_WORLD, *graph, *dof_map);
+
+  // the points are the same as for all the other vertex fields
+  std::vector<mc::Point> points;
+  std::vector<double> vessel_ids;
+  mc::fill_with_vessel_id(MPI_COMM_WORLD, *graph, points, vessel_ids);
+  REQUIRE(plan.size() == points.size());
+  for (std::size_t k = 0; k < points.size(); k += 1) {
+    REQUIRE(plan.get_points()[k].x == points[k].x);
+    REQUIRE(plan.get_points()[k].y == points[k].y);
+    REQUIRE(plan.get_points()[k].z == points[k].z);
+  }
+  std::vector<double> plan_vessel_ids;
+  plan.fill_with_vessel_id(plan_vessel_ids);
+  REQUIRE(plan_vessel_ids == vessel_ids);
+
+  mc::InterpolatedFlowFields fields;
+  std::vector<double> interpolated;
+  double t = 0;
+  for (std::size_t step = 0; step < 2; step += 1) {
+    for (std::size_t k = 0; k < 20; k += 1, t += tau)
+      solver.solve(tau, t);
+
+    const auto &u = solver.get_solution();
+    plan.evaluate(u, fields);
+    plan.interpolate(solver.A_component, u, interpolated);
+    REQUIRE(interpolated == fields.A);
+
+    std::size_t idx = 0;
+    for (auto e_id : graph->get_active_edge_ids(rank)) {
+      const auto &edge = *graph->get_edge(e_id);
+      const auto &param = edge.get_physical_data();
+      const auto &local_dof_map = dof_map->get_local_dof_map(edge);
+      for (std::size_t micro_edge = 0; micro_edge < edge.num_micro_edges(); micro_edge += 1) {
+        const double *q_dofs = local_dof_map.dof_values(u, micro_edge, solver.Q_component);
+        const double *a_dofs = local_dof_map.dof_values(u, micro_edge, solver.A_component);
+        const std::vector<double> q_local(q_dofs, q_dofs + degree + 1);
+        const std::vector<double> a_local(a_dofs, a_dofs + degree + 1);
+        for (double s : {-1., +1.}) {
+          const double Q = mc::FETypeNetwork::evaluate_dof(q_local, s);
+          const double A = mc::FETypeNetwork::evaluate_dof(a_local, s);
+          REQUIRE(fields.Q[idx] == Approx(Q));
+          REQUIRE(fields.A[idx] == Approx(A));
+          REQUIRE(fields.p_static[idx] == Approx(mc::nonlinear::get_p_from_A(A, param.G0, param.A0)));
+          REQUIRE(fields.p_total[idx] == Approx(mc::nonlinear::get_p_from_QA(Q, A, param)));
+          REQUIRE(fields.velocity[idx] == Approx(Q / A));
+          idx += 1;
+        }
+      }
+    }
+    REQUIRE(idx == plan.size());
+  }
+}
+
+TEST_CASE("ResampledInterpolationPlanEvaluatesTheSolutionAtEquidistantPoints", "[InterpolationPlan]") {
+  const std::size_t degree = 2;
+  const double tau = 1e-4;
+  const auto rank = mc::mpi::rank(MPI_COMM_WORLD);
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, degree);
+  solver.use_ssp_method();
+
+  // the vessels are 4, 2 and 3.4 cm long, hence the second one gets its points from the vessel resolution
+  mc::OutputResolution resolution;
+  resolution.points_per_cm = 2.5;
+  resolution.points_per_vessel = 8;
+  REQUIRE(resolution.num_points(*graph->get_edge(0)) == 11);
+  REQUIRE(resolution.num_points(*graph->get_edge(1)) == 8);
+  REQUIRE(resolution.num_points(*graph->get_edge(2)) == 10);
+  REQUIRE(mc::OutputResolution().num_points(*graph->get_edge(0)) == 2 * graph->get_edge(0)->num_micro_edges());
+
+  const mc::InterpolationPlan plan(MPI_COMM_WORLD, *graph, *dof_map, resolution);
+
+  double t = 0;
+  for (std::size_t k = 0; k < 20; k += 1, t += tau)
+    solver.solve(tau, t);
+  const auto &u = solver.get_solution();
+  mc::InterpolatedFlowFields fields;
+  plan.evaluate(u, fields);
+  std::vector<double> vessel_ids;
+  plan.fill_with_vessel_id(vessel_ids);
+
+  std::size_t idx = 0;
+  for (auto e_id : graph->get_active_edge_ids(rank)) {
+    const auto &edge = *graph->get_edge(e_id);
+    const auto &embedding = edge.get_embedding_data();
+    const auto &local_dof_map = dof_map->get_local_dof_map(edge);
+    const auto num_micro_edges = edge.num_micro_edges();
+    const auto num_points = resolution.num_points(edge);
+    for (std::size_t k = 0; k < num_points; k += 1, idx += 1) {
+      const double s = static_cast<double>(k) / static_cast<double>(num_points - 1);
+      const auto point = mc::convex_combination(embedding.points.front(), embedding.points.back(), s);
+      REQUIRE(plan.get_points()[idx].x == Approx(point.x).margin(1e-14));
+      REQUIRE(plan.get_points()[idx].y == Approx(point.y).margin(1e-14));
+      REQUIRE(plan.get_points()[idx].z == Approx(point.z).margin(1e-14));
+      REQUIRE(vessel_ids[idx] == e_id);
+
+      const auto micro_edge = std::min(static_cast<std::size_t>(s * num_micro_edges), num_micro_edges - 1);
+      const double xi = 2 * (s * num_micro_edges - micro_edge) - 1;
+      const double *q_dofs = local_dof_map.dof_values(u, micro_edge, solver.Q_component);
+      const double *a_dofs = local_dof_map.dof_values(u, micro_edge, solver.A_component);
+      REQUIRE(fields.Q[idx] == Approx(mc::FETypeNetwork::evaluate_dof(std::vector<double>(q_dofs, q_dofs + degree + 1), xi)));
+      REQUIRE(fields.A[idx] == Approx(mc::FETypeNetwork::evaluate_dof(std::vector<double>(a_dofs, a_dofs + degree + 1), xi)));
+    }
+  }
+  REQUIRE(idx == plan.size());
+}
+
+TEST_CASE("DerivedQuantitiesAreEvaluatedLazilyAndOnce", "[InterpolationPlan]") {
+  const std::size_t degree = 2;
+  const double tau = 1e-4;
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, degree);
+  solver.use_ssp_method();
+
+  auto plan = std::make_shared<const mc::InterpolationPlan>(MPI_COMM_WORLD, *graph, *dof_map);
+  mc::DerivedQuantities quantities(plan);
+  quantities.subscribe_list("p_total,c,p_total");
+  REQUIRE(quantities.get_subscriptions() == std::vector<std::string>{"p_total", "c"});
+  REQUIRE(!quantities.is_subscribed("Q"));
+  REQUIRE_THROWS(quantities.subscribe("unknown"));
+
+  double t = 0;
+  for (std::size_t k = 0; k < 20; k += 1, t += tau)
+    solver.solve(tau, t);
+  const auto &u = solver.get_solution();
+  mc::InterpolatedFlowFields fields;
+  plan->evaluate(u, fields);
+
+  // nothing is evaluated until a field is requested, and the dependencies are shared
+  quantities.update(u);
+  REQUIRE(quantities.num_evaluations() == 0);
+  REQUIRE(quantities.get("p_total") == fields.p_total);
+  REQUIRE(quantities.num_evaluations() == 3);
+  REQUIRE(quantities.get("Q") == fields.Q);
+  REQUIRE(quantities.get("p_total") == fields.p_total);
+  REQUIRE(quantities.num_evaluations() == 3);
+  REQUIRE(quantities.get("p_static") == fields.p_static);
+  REQUIRE(quantities.get("velocity") == fields.velocity);
+  REQUIRE(quantities.num_evaluations() == 5);
+  const auto &c = quantities.get("c");
+  REQUIRE(c.size() == plan->size());
+  for (auto value : c)
+    REQUIRE(value > 0);
+
+  // a new solution invalidates all the values
+  for (std::size_t k = 0; k < 20; k += 1, t += tau)
+    solver.solve(tau, t);
+  plan->evaluate(u, fields);
+  quantities.update(u);
+  REQUIRE(quantities.get("A") == fields.A);
+  REQUIRE(quantities.num_evaluations() == 7);
+
+  // user defined fields can depend on the others, but not on themselves
+  quantities.declare("A_squared", [](mc::DerivedQuantities &q, const std::vector<double> &, std::vector<double> &values) {
+    values = q.get("A");
+    for (auto &value : values)
+      value *= value;
+  });
+  REQUIRE(quantities.get("A_squared").size() == plan->size());
+  REQUIRE(quantities.num_evaluations() == 8);
+  quantities.declare("cycle", [](mc::DerivedQuantities &q, const std::vector<double> &, std::vector<double> &values) { values = q.get("cycle"); });
+  REQUIRE_THROWS(quantities.get("cycle"));
+}
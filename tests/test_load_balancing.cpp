@@ -0,0 +1,75 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <memory>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_storage.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+/*! @brief Runs the 3 vessel network with every vessel split into two parts, where all but the last edge start on rank 0.
+ *         Returns the A and Q values at the start of every edge on all ranks.
+ */
+std::vector<double> run_3_vessel_network(bool rebalance, bool &rebalanced) {
+  const double t_end = 0.1;
+  const size_t degree = 2;
+  const double tau = 5e-5;
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  for (auto e_id : graph->get_edge_ids())
+    graph->split_edge(graph->edge(e_id), 2);
+  graph->finalize_bcs();
+
+  // a deliberately bad partition
+  const int size = mc::mpi::size(MPI_COMM_WORLD);
+  for (auto e_id : graph->get_edge_ids())
+    graph->assign_edge_to_rank(graph->edge(e_id), e_id + 1 == graph->num_edges() ? size - 1 : 0);
+
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, degree);
+  solver.use_ssp_method();
+
+  if (rebalance)
+    solver.start_cost_measurement();
+
+  double t = 0;
+  for (std::size_t it = 0; t < t_end - 1e-12; it += 1) {
+    solver.solve(tau, t);
+    t += tau;
+    if (rebalance && it == 10)
+      rebalanced = solver.rebalance(0);
+  }
+
+  // every owner contributes its values
+  std::vector<double> values(2 * graph->num_edges(), 0);
+  for (auto e_id : graph->get_active_edge_ids(mc::mpi::rank(MPI_COMM_WORLD)))
+    solver.evaluate_1d_AQ_values(graph->edge(e_id), 0.5, values[2 * e_id], values[2 * e_id + 1]);
+  MPI_Allreduce(MPI_IN_PLACE, values.data(), static_cast<int>(values.size()), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  return values;
+}
+
+TEST_CASE("RebalanceMigratesTheSolution", "[LoadBalancing]") {
+  bool rebalanced = false;
+  const auto reference = run_3_vessel_network(false, rebalanced);
+  const auto values = run_3_vessel_network(true, rebalanced);
+
+  // on a single rank there is nothing to balance
+  REQUIRE(rebalanced == (mc::mpi::size(MPI_COMM_WORLD) > 1));
+
+  for (std::size_t k = 0; k < values.size(); k += 1)
+    REQUIRE(values[k] == Approx(reference[k]).epsilon(1e-10));
+}
@@ -0,0 +1,109 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/memory_report.hpp"
+#include "macrocirculation/nonlinear_flow_upwind_evaluator.hpp"
+#include "macrocirculation/right_hand_side_evaluator.hpp"
+#include "macrocirculation/synthetic_network.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("MemoryReportReducesTheUnionOfComponents", "[MemoryReport]") {
+  const auto rank = static_cast<std::size_t>(mc::mpi::rank(MPI_COMM_WORLD));
+  const auto size = static_cast<std::size_t>(mc::mpi::size(MPI_COMM_WORLD));
+
+  mc::MemoryReport inner;
+  inner.add("values", std::vector<double>(10));
+  inner.add("values", 20);
+
+  mc::MemoryReport report;
+  report.add("outer", inner);
+  // only the root knows this component
+  if (rank == 0)
+    report.add("root only", 100);
+
+  REQUIRE(report.get("outer/values") == 10 * sizeof(double) + 20);
+  REQUIRE(report.get("unknown") == 0);
+  REQUIRE(report.total() == 10 * sizeof(double) + 20 + (rank == 0 ? 100 : 0));
+
+  const auto statistics = report.reduce(MPI_COMM_WORLD);
+  REQUIRE(statistics.size() == 3);
+  REQUIRE(statistics[0].component == "outer/values");
+  REQUIRE(statistics[0].sum == Approx(size * (10 * sizeof(double) + 20)));
+  REQUIRE(statistics[1].component == "root only");
+  REQUIRE(statistics[1].max == Approx(100));
+  REQUIRE(statistics[1].min == Approx(size > 1 ? 0 : 100));
+  REQUIRE(statistics[2].component == "total");
+  REQUIRE(statistics[2].sum == Approx(size * (10 * sizeof(double) + 20) + 100));
+}
+
+TEST_CASE("EdgeArraysOnlyCoverTheLocalEdges", "[MemoryReport]") {
+  const auto size = mc::mpi::size(MPI_COMM_WORLD);
+  const std::size_t degree = 2;
+
+  mc::SyntheticTreeParameters parameters;
+  parameters.depth = 6;
+  auto graph = mc::create_synthetic_arterial_tree(parameters);
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, degree);
+  solver.use_ssp_method();
+  const double tau = 1e-5;
+  solver.solve(tau, 0);
+
+  auto &upwind_evaluator = solver.get_rhs_evaluator().get_flow_upwind_evaluator();
+  const auto &local_edges = upwind_evaluator.get_boundary_evaluator().get_local_edge_index();
+  const auto num_slots = local_edges.num_slots();
+
+  // our edges and the ghost layer are local, everything else shares the last slot
+  const auto rank = mc::mpi::rank(MPI_COMM_WORLD);
+  std::size_t num_ghost_edges = 0;
+  for (int other = 0; other < size; other += 1)
+    num_ghost_edges += other == rank ? 0 : graph->get_ghost_edge_ids(rank, other).size();
+  REQUIRE(local_edges.num_local_edges() == graph->get_active_edge_ids(rank).size() + num_ghost_edges);
+  for (auto e_id : graph->get_active_edge_ids(rank))
+    REQUIRE(local_edges.is_local(e_id));
+  if (size > 2)
+    REQUIRE(local_edges.num_local_edges() < graph->num_edges());
+
+  const auto report = solver.memory_report();
+  REQUIRE(report.get("rhs/upwinding/macro edge fluxes") == 4 * num_slots * sizeof(double));
+  REQUIRE(report.get("rhs/upwinding/boundary evaluator/boundary values") == 2 * 2 * num_slots * sizeof(double));
+  REQUIRE(report.get("rhs/edge coefficients") == num_slots * 3 * sizeof(double));
+  REQUIRE(report.get("solution") >= 2 * dof_map->num_dof() * sizeof(double));
+  REQUIRE(report.total() > 0);
+
+  // the graph is replicated, hence every rank pays for it
+  const auto graph_statistics = graph->memory_report().reduce(MPI_COMM_WORLD);
+  REQUIRE(graph_statistics.back().component == "total");
+  REQUIRE(graph_statistics.back().min > 0);
+
+  // the fluxes of all our edges can be found through the compact numbering
+  upwind_evaluator.init(tau, solver.get_solution());
+  for (auto e_id : graph->get_active_edge_ids(rank)) {
+    double Q_l, A_l, Q_r, A_r;
+    upwind_evaluator.get_fluxes_at_macro_edge_boundaries(tau, graph->edge(e_id), Q_l, A_l, Q_r, A_r);
+    REQUIRE(std::isfinite(Q_l));
+    REQUIRE(A_l > 0);
+    REQUIRE(A_r > 0);
+  }
+}
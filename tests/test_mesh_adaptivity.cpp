@@ -0,0 +1,224 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/mesh_adaptivity.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+namespace {
+
+/*! @brief Runs the 3 vessel network until t_end after changing its micro edges and returns A and Q at the given points of all the edges. */
+std::vector<double> run_with_micro_edges(const std::function<std::vector<double>(const mc::Edge &)> &create_lengths, double t_end, const std::vector<double> &points) {
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  for (auto e_id : graph->get_edge_ids())
+    graph->set_micro_edge_lengths(graph->edge(e_id), create_lengths(graph->edge(e_id)));
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, 2, false);
+
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, 2);
+  solver.use_ssp_method();
+
+  const double tau = 2.5e-5;
+  double t = 0;
+  while (t < t_end - 1e-12) {
+    solver.solve(tau, t);
+    t += tau;
+  }
+
+  std::vector<double> values(2 * graph->num_edges() * points.size(), 0);
+  for (auto e_id : graph->get_active_edge_ids(mc::mpi::rank(MPI_COMM_WORLD))) {
+    for (std::size_t k = 0; k < points.size(); k += 1) {
+      const std::size_t index = 2 * (e_id * points.size() + k);
+      solver.evaluate_1d_AQ_values(graph->edge(e_id), points[k], values[index], values[index + 1]);
+    }
+  }
+  MPI_Allreduce(MPI_IN_PLACE, values.data(), static_cast<int>(values.size()), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  return values;
+}
+
+/*! @brief Returns the integrals of Q and A over all the edges. */
+std::vector<double> integrate_solution(const mc::GraphStorage &graph, const mc::DofMap &dof_map, const std::vector<double> &u) {
+  std::vector<double> integrals(2, 0);
+  for (auto e_id : graph.get_active_edge_ids(mc::mpi::rank(MPI_COMM_WORLD))) {
+    const auto &local_dof_map = dof_map.get_local_dof_map(graph.edge(e_id));
+    const auto lengths = graph.edge(e_id).get_micro_edge_lengths();
+    for (std::size_t micro_edge_id = 0; micro_edge_id < lengths.size(); micro_edge_id += 1) {
+      for (std::size_t component = 0; component < 2; component += 1)
+        integrals[component] += lengths[micro_edge_id] * local_dof_map.dof_values(u, micro_edge_id, component)[0];
+    }
+  }
+  MPI_Allreduce(MPI_IN_PLACE, integrals.data(), 2, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  return integrals;
+}
+
+} // namespace
+
+TEST_CASE("AdaptMicroEdgeLengthsSplitsAndMerges", "[MeshAdaptivity]") {
+  mc::MeshAdaptivitySettings settings;
+  settings.refine_threshold = 1e-2;
+  settings.coarsen_threshold = 1e-4;
+
+  const std::vector<double> lengths{1, 1, 1, 1, 2};
+  const auto refined = mc::adapt_micro_edge_lengths(lengths, {0, 0.1, 1e-3, 1e-3, 0}, settings);
+  REQUIRE(refined == std::vector<double>{1, 0.5, 0.5, 1, 1, 2});
+
+  // the first two micro edges are merged, while the last one has no neighbor
+  const auto coarsened = mc::adapt_micro_edge_lengths(lengths, {0, 0, 1e-3, 0, 0}, settings);
+  REQUIRE(coarsened == std::vector<double>{2, 1, 3});
+
+  // the limits of the lengths are respected
+  settings.min_micro_edge_length = 0.6;
+  settings.max_micro_edge_length = 2.5;
+  REQUIRE(mc::adapt_micro_edge_lengths(lengths, {0, 0, 0.1, 0, 0}, settings) == std::vector<double>{2, 1, 1, 2});
+}
+
+TEST_CASE("JumpIndicatorsMeasureTheInnerJumps", "[MeshAdaptivity]") {
+  // three micro edges with a single component and degree 1
+  mc::LocalEdgeDofMap local_dof_map(0, 1, 2, 3);
+  const std::vector<double> u{1, 0.5, 2, 0, 2, -0.5};
+
+  // the jumps are 0.5 and 0.5, which are relative to the largest mean value 2
+  const auto indicators = mc::jump_indicators(local_dof_map, u);
+  REQUIRE(indicators.size() == 3);
+  REQUIRE(indicators[0] == Approx(0.25));
+  REQUIRE(indicators[1] == Approx(0.25));
+  REQUIRE(indicators[2] == Approx(0.25));
+
+  // a continuous solution has no jumps
+  const std::vector<double> continuous{1, 0.5, 2, 0.5, 3, 0.5};
+  for (auto indicator : mc::jump_indicators(local_dof_map, continuous))
+    REQUIRE(indicator == Approx(0).margin(1e-14));
+}
+
+TEST_CASE("NonUniformMicroEdgesAgreeWithTheUniformMesh", "[MeshAdaptivity]") {
+  const double t_end = 0.2;
+  const std::vector<double> points{0.1, 0.5, 0.9};
+
+  const auto uniform = run_with_micro_edges([](const mc::Edge &e) { return e.get_micro_edge_lengths(); }, t_end, points);
+
+  // the graded micro edges are finer at the start and coarser at the end of every edge
+  const auto graded = run_with_micro_edges([](const mc::Edge &e) {
+    const auto n = e.num_micro_edges();
+    const double length = e.get_physical_data().length;
+    std::vector<double> lengths;
+    double sum = 0;
+    for (std::size_t k = 0; k < n; k += 1) {
+      lengths.push_back(length * (2. * static_cast<double>(k) + 1.) / static_cast<double>(n * n));
+      sum += lengths.back();
+    }
+    lengths.back() += length - sum;
+    return lengths;
+  },
+                                           t_end, points);
+
+  for (std::size_t k = 0; k < uniform.size(); k += 1)
+    REQUIRE(graded[k] == Approx(uniform[k]).epsilon(1e-3));
+}
+
+TEST_CASE("AdaptMicroEdgesConservesTheSolution", "[MeshAdaptivity]") {
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, 2, false);
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, 2);
+  solver.use_ssp_method();
+
+  // the inflow creates a wave front at the start of the first vessel
+  double t = 0;
+  const double tau = 2.5e-5;
+  for (std::size_t k = 0; k < 400; k += 1) {
+    solver.solve(tau, t);
+    t += tau;
+  }
+
+  std::vector<std::size_t> old_num_micro_edges;
+  for (auto e_id : graph->get_edge_ids())
+    old_num_micro_edges.push_back(graph->edge(e_id).num_micro_edges());
+
+  // the points are not on the boundaries of the micro edges, where the solution jumps
+  const std::vector<double> points{0.0513, 0.3071, 0.7713};
+  auto evaluate = [&]() {
+    std::vector<double> values(2 * graph->num_edges() * points.size(), 0);
+    for (auto e_id : graph->get_active_edge_ids(mc::mpi::rank(MPI_COMM_WORLD))) {
+      for (std::size_t k = 0; k < points.size(); k += 1) {
+        const std::size_t index = 2 * (e_id * points.size() + k);
+        solver.evaluate_1d_AQ_values(graph->edge(e_id), points[k], values[index], values[index + 1]);
+      }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, values.data(), static_cast<int>(values.size()), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    return values;
+  };
+
+  const auto old_values = evaluate();
+  const auto old_integrals = integrate_solution(*graph, *dof_map, solver.get_solution());
+
+  // splitting every micro edge represents the old solution exactly
+  mc::MeshAdaptivitySettings refine_all;
+  refine_all.refine_threshold = -1;
+  REQUIRE(solver.adapt_micro_edges(refine_all));
+  for (auto e_id : graph->get_edge_ids())
+    REQUIRE(graph->edge(e_id).num_micro_edges() == 2 * old_num_micro_edges[e_id]);
+  const auto refined_values = evaluate();
+  for (std::size_t k = 0; k < old_values.size(); k += 1)
+    REQUIRE(refined_values[k] == Approx(old_values[k]).epsilon(1e-12).margin(1e-14));
+
+  // merging them again gives the old micro edges and solution back
+  mc::MeshAdaptivitySettings coarsen_all;
+  coarsen_all.refine_threshold = std::numeric_limits<double>::infinity();
+  coarsen_all.coarsen_threshold = std::numeric_limits<double>::infinity();
+  REQUIRE(solver.adapt_micro_edges(coarsen_all));
+  for (auto e_id : graph->get_edge_ids())
+    REQUIRE(graph->edge(e_id).num_micro_edges() == old_num_micro_edges[e_id]);
+  const auto coarsened_values = evaluate();
+  for (std::size_t k = 0; k < old_values.size(); k += 1)
+    REQUIRE(coarsened_values[k] == Approx(old_values[k]).epsilon(1e-12).margin(1e-14));
+
+  // the jump indicators only refine near the front of the first vessel, while the integrals are preserved
+  mc::MeshAdaptivitySettings settings;
+  settings.refine_threshold = 1e-4;
+  settings.coarsen_threshold = 0;
+  REQUIRE(solver.adapt_micro_edges(settings));
+  const auto lengths = graph->edge(0).get_micro_edge_lengths();
+  REQUIRE(lengths.size() > old_num_micro_edges[0]);
+  REQUIRE(lengths.size() < 2 * old_num_micro_edges[0]);
+  REQUIRE(lengths.front() > *std::min_element(lengths.begin(), lengths.end()));
+
+  const auto new_integrals = integrate_solution(*graph, *dof_map, solver.get_solution());
+  REQUIRE(new_integrals[0] == Approx(old_integrals[0]).epsilon(1e-12));
+  REQUIRE(new_integrals[1] == Approx(old_integrals[1]).epsilon(1e-12));
+
+  // the solver runs on the adapted micro edges
+  const double tau_adapted = solver.calculate_stable_time_step(0.5);
+  REQUIRE(tau_adapted > 0);
+  for (std::size_t k = 0; k < 100; k += 1) {
+    solver.solve(tau, t);
+    t += tau;
+  }
+  for (auto value : evaluate())
+    REQUIRE(std::isfinite(value));
+}
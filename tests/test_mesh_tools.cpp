@@ -0,0 +1,197 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/embedded_graph_reader.hpp"
+#include "macrocirculation/graph_cache.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/mesh_tools.hpp"
+#include "macrocirculation/vessel_formulas.hpp"
+
+namespace mc = macrocirculation;
+
+namespace {
+
+/*! @brief Two vessels, where the first one is bent and the second ends in a windkessel. */
+void create_network(mc::GraphStorage &graph, const std::string &prefix) {
+  const std::size_t first_vertex = graph.num_vertices();
+  std::vector<mc::EdgeDescription> edges;
+  edges.push_back({0, 1, 2, mc::PhysicalData::set_from_data(4e5, 0.01, 1.028e-3, 2, 0.1, 2.), {{mc::Point(0, 0, 0), mc::Point(1, 0, 0), mc::Point(1, 1, 0)}}});
+  edges.push_back({1, 2, 1, mc::PhysicalData::set_from_data(4e5, 0.02, 1.028e-3, 9, 0.05, 0.5), {}});
+  graph.create_in_bulk(3, edges);
+  for (std::size_t k = 0; k < 3; k += 1)
+    graph.vertex(first_vertex + k).set_name(prefix + std::to_string(k));
+  graph.edge(graph.num_edges() - 2).set_name(prefix + "bent");
+  graph.vertex(first_vertex + 2).set_to_windkessel_outflow(2., 3.);
+}
+
+/*! @brief A thick vessel into a bifurcation of a thick vessel and a thin one, which bifurcates again into two thin vessels ending in windkessels. */
+void create_branching_network(mc::GraphStorage &graph) {
+  const auto thick = mc::PhysicalData::set_from_data(4e5, 0.05, 1.028e-3, 9, 0.5, 4.);
+  const auto thin = mc::PhysicalData::set_from_data(4e5, 0.02, 1.028e-3, 9, 0.1, 2.);
+  std::vector<mc::EdgeDescription> edges;
+  edges.push_back({0, 1, 8, thick, {}});
+  edges.push_back({1, 2, 4, thin, {}});
+  edges.push_back({1, 3, 8, thick, {}});
+  edges.push_back({2, 4, 8, thin, {}});
+  edges.push_back({2, 5, 8, thin, {}});
+  graph.create_in_bulk(6, edges);
+  for (std::size_t k = 0; k < 6; k += 1)
+    graph.vertex(k).set_name("v" + std::to_string(k));
+  graph.vertex(0).set_to_inflow_with_fixed_flow(mc::heart_beat_inflow(485.));
+  graph.vertex(3).set_to_windkessel_outflow(2e2, 1e-2);
+  graph.vertex(4).set_to_windkessel_outflow(4e2, 2e-3);
+  graph.vertex(5).set_to_windkessel_outflow(6e2, 3e-3);
+  graph.vertex(5).update_vessel_tip_pressures(10.);
+}
+
+} // namespace
+
+TEST_CASE("RefineUniformlyResamplesTheEmbedding", "[MeshTools]") {
+  mc::GraphStorage graph;
+  create_network(graph, "a_");
+
+  REQUIRE(mc::refine_uniformly(graph, 0.3) == 2);
+  REQUIRE(mc::refine_uniformly(graph, 0.3) == 0);
+
+  const auto &bent = graph.edge(0);
+  REQUIRE(bent.num_micro_edges() == 7);
+  for (auto l : bent.get_micro_edge_lengths())
+    REQUIRE(l == Approx(2. / 7.));
+  REQUIRE(graph.edge(1).num_micro_edges() == 2);
+
+  // the points are equidistant along the bent embedding
+  const auto &points = bent.get_embedding_data().points;
+  REQUIRE(points.size() == 8);
+  REQUIRE(points.front().x == 0);
+  REQUIRE(points.back().y == Approx(1.));
+  REQUIRE(points[3].x == Approx(6. / 7.));
+  REQUIRE(points[4].x == Approx(1.));
+  REQUIRE(points[4].y == Approx(1. / 7.));
+  REQUIRE(!graph.edge(1).has_embedding_data());
+}
+
+TEST_CASE("MergedMeshIsWrittenAndReadBack", "[MeshTools]") {
+  const std::string filepath = "./mesh_tools_test_" + std::to_string(mc::mpi::rank(MPI_COMM_WORLD)) + ".json";
+
+  mc::GraphStorage graph;
+  create_network(graph, "a_");
+  create_network(graph, "b_");
+
+  // the windkessel of the first network becomes an interior vertex
+  const auto data = mc::PhysicalData::set_from_data(1.3e6, 0.005, 1.028e-3, 2, 0.06, 5.);
+  const auto &connection = mc::connect_by_name(graph, "a_2", "b_0", 120, data);
+  REQUIRE(connection.num_micro_edges() == 120);
+  REQUIRE(!graph.find_vertex_by_name("a_2")->is_windkessel_outflow());
+  REQUIRE_THROWS(mc::connect_by_name(graph, "a_2", "c_0", 1, data));
+
+  REQUIRE(mc::scale_windkessel_parameters(graph, "b_", 0.25, 2.) == 1);
+  REQUIRE(mc::scale_windkessel_parameters(graph, "a_", 0.25) == 0);
+
+  mc::write_mesh_json(filepath, graph);
+  mc::GraphStorage read_graph;
+  mc::EmbeddedGraphReader().append(filepath, read_graph);
+  std::remove(filepath.c_str());
+
+  REQUIRE(read_graph.num_vertices() == graph.num_vertices());
+  REQUIRE(read_graph.num_edges() == graph.num_edges());
+  for (auto e_id : graph.get_edge_ids()) {
+    const auto &edge = graph.edge(e_id);
+    const auto &read_edge = read_graph.edge(e_id);
+    REQUIRE(read_edge.get_name() == edge.get_name());
+    REQUIRE(read_edge.get_vertex_neighbors() == edge.get_vertex_neighbors());
+    REQUIRE(read_edge.num_micro_edges() == edge.num_micro_edges());
+    REQUIRE(read_edge.has_embedding_data() == edge.has_embedding_data());
+    const auto &read_data = read_edge.get_physical_data();
+    const auto &data = edge.get_physical_data();
+    REQUIRE(read_data.length == data.length);
+    REQUIRE(read_data.radius == data.radius);
+    REQUIRE(read_data.gamma == data.gamma);
+    REQUIRE(read_data.G0 == Approx(data.G0).epsilon(1e-14));
+  }
+
+  const auto &outflow = *read_graph.find_vertex_by_name("b_2");
+  REQUIRE(outflow.is_windkessel_outflow());
+  REQUIRE(outflow.get_peripheral_vessel_data().resistance == 0.5);
+  REQUIRE(outflow.get_peripheral_vessel_data().compliance == 6.);
+  REQUIRE(!read_graph.find_vertex_by_name("a_2")->is_windkessel_outflow());
+}
+
+TEST_CASE("ThinSubtreesAreLumpedInto0DModels", "[MeshTools]") {
+  mc::GraphStorage graph;
+  create_branching_network(graph);
+
+  mc::LumpingSettings settings;
+  settings.min_radius = 0.2;
+  mc::GraphStorage reduced;
+  const auto report = mc::lump_peripheral_subtrees(graph, settings, reduced);
+  REQUIRE_THROWS(mc::lump_peripheral_subtrees(graph, settings, reduced));
+
+  // the thin vessel at the bifurcation with the thick one is kept, since only a leaf can carry the 0D model
+  REQUIRE(report.num_lumped_vessels == 2);
+  REQUIRE(reduced.num_vertices() == 4);
+  REQUIRE(reduced.num_edges() == 3);
+  REQUIRE(report.max_cfl_rate_after < report.max_cfl_rate_before);
+  REQUIRE(reduced.find_vertex_by_name("v3")->get_peripheral_vessel_data().resistance == 2e2);
+  REQUIRE_THROWS(reduced.find_vertex_by_name("v4"));
+
+  // the windkessels in parallel behind their vessels
+  const auto &thin = graph.edge(3).get_physical_data();
+  const double R_vessel = mc::linear::get_L(thin) * mc::linear::get_R(thin) * thin.length;
+  const double R = 1. / (1. / (4e2 + R_vessel) + 1. / (6e2 + R_vessel));
+  const double C = 2e-3 + 3e-3 + 2 * mc::linear::get_C(thin) * thin.length;
+  REQUIRE(report.subtrees.size() == 1);
+  const auto &subtree = report.subtrees[0];
+  REQUIRE(subtree.vertex_name == "v2");
+  REQUIRE(subtree.num_lumped_vessels == 2);
+  REQUIRE(subtree.resistance == Approx(R).epsilon(1e-12));
+  REQUIRE(subtree.compliance == Approx(C).epsilon(1e-12));
+  REQUIRE(subtree.resistance_error < 1e-12);
+  REQUIRE(subtree.impedance_error < 0.5);
+
+  const auto &outflow = *reduced.find_vertex_by_name("v2");
+  REQUIRE(outflow.is_windkessel_outflow());
+  REQUIRE(outflow.get_peripheral_vessel_data().resistance == Approx(R).epsilon(1e-12));
+  REQUIRE(outflow.get_peripheral_vessel_data().compliance == Approx(C).epsilon(1e-12));
+  // the outflow pressures are averaged by the conductances of the branches, where v4 keeps the default outflow pressure
+  const double p_out = R * (5 * 1.333322 / (4e2 + R_vessel) + 10. / (6e2 + R_vessel));
+  REQUIRE(outflow.get_peripheral_vessel_data().p_out == Approx(p_out).epsilon(1e-12));
+
+  // the reduced network can be cached
+  const std::string filepath = "./lumped_test_" + std::to_string(mc::mpi::rank(MPI_COMM_WORLD)) + ".cache";
+  mc::write_graph_cache(filepath, reduced, 42);
+  mc::GraphStorage read_graph;
+  REQUIRE(mc::read_graph_cache(filepath, 42, read_graph));
+  std::remove(filepath.c_str());
+  REQUIRE(read_graph.num_edges() == 3);
+  REQUIRE(read_graph.find_vertex_by_name("v2")->is_windkessel_outflow());
+}
+
+TEST_CASE("LumpedSubtreesKeepTheirResistanceInAllModels", "[MeshTools]") {
+  for (auto model : {mc::LumpedOutflowModel::vessel_tree, mc::LumpedOutflowModel::rcl}) {
+    mc::GraphStorage graph;
+    create_branching_network(graph);
+
+    mc::LumpingSettings settings;
+    settings.max_wave_speed = mc::calculate_c0(graph.edge(3).get_physical_data()) * 0.99;
+    settings.model = model;
+    mc::GraphStorage reduced;
+    const auto report = mc::lump_peripheral_subtrees(graph, settings, reduced);
+
+    REQUIRE(report.subtrees.size() == 1);
+    REQUIRE(report.subtrees[0].resistance_error < 1e-12);
+    const auto &outflow = *reduced.find_vertex_by_name("v2");
+    REQUIRE(outflow.is_leaf());
+    REQUIRE((model == mc::LumpedOutflowModel::rcl ? outflow.is_rcl_outflow() : outflow.is_vessel_tree_outflow()));
+  }
+}
@@ -0,0 +1,144 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/metrics_exporter.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+namespace {
+
+std::unique_ptr<mc::ExplicitNonlinearFlowSolver> create_solver(std::size_t degree) {
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+
+  auto solver = std::make_unique<mc::ExplicitNonlinearFlowSolver>(MPI_COMM_WORLD, graph, dof_map, degree);
+  solver->use_ssp_method();
+  return solver;
+}
+
+/*! @brief Removes the file on rank 0 before any rank uses it. */
+void remove_file(const std::string &filepath) {
+  if (mc::mpi::rank(MPI_COMM_WORLD) == 0)
+    std::remove(filepath.c_str());
+  MPI_Barrier(MPI_COMM_WORLD);
+}
+
+} // namespace
+
+TEST_CASE("MetricsExporterAppendsJsonLines", "[MetricsExporter]") {
+  const double tau = 1e-4;
+  const std::string filepath = "metrics_exporter_test.jsonl";
+  remove_file(filepath);
+
+  auto solver = create_solver(2);
+
+  mc::MetricsExporter exporter(MPI_COMM_WORLD, filepath, mc::MetricsFormat::json_lines);
+  // every check exports, and the ranks check every fifth step
+  exporter.set_interval(0, 5);
+
+  double t = 0;
+  std::size_t num_exports = 0;
+  for (std::size_t step = 0; step < 23; step += 1) {
+    solver->solve(tau, t);
+    t += tau;
+    num_exports += exporter.step(*solver, t, tau);
+  }
+  REQUIRE(num_exports == 4);
+
+  const auto metrics = exporter.collect(*solver, t, tau);
+  std::size_t num_owned_dofs = solver->get_dof_map().num_owned_dofs();
+  MPI_Allreduce(MPI_IN_PLACE, &num_owned_dofs, 1, MPI_UNSIGNED_LONG, MPI_SUM, MPI_COMM_WORLD);
+  REQUIRE(metrics.num_steps == 23);
+  REQUIRE(metrics.num_dofs == num_owned_dofs);
+  REQUIRE(metrics.cfl == solver->calculate_wave_speed_diagnostics(tau).cfl);
+  REQUIRE(metrics.newton.num_solves > 0);
+  REQUIRE(metrics.solver_memory > 0);
+
+  if (mc::mpi::rank(MPI_COMM_WORLD) == 0) {
+    std::ifstream f(filepath);
+    std::string line;
+    std::vector<nlohmann::json> lines;
+    while (std::getline(f, line))
+      lines.push_back(nlohmann::json::parse(line));
+    REQUIRE(lines.size() == 4);
+    for (std::size_t k = 0; k < lines.size(); k += 1) {
+      REQUIRE(lines[k]["steps"].get<std::size_t>() == 5 * (k + 1));
+      REQUIRE(lines[k]["t"].get<double>() == Approx(5 * (k + 1) * tau));
+      REQUIRE(lines[k]["dofs"].get<std::size_t>() == num_owned_dofs);
+      REQUIRE(lines[k]["steps_per_second"].get<double>() > 0);
+      REQUIRE(lines[k]["simulated_time_per_second"].get<double>() > 0);
+      REQUIRE(lines[k]["cfl"].get<double>() > 0);
+      REQUIRE(lines[k]["newton"]["solves"].get<std::size_t>() > 0);
+      REQUIRE(lines[k]["phases"].is_array());
+    }
+    // the rate of the first export starts with the first step
+    REQUIRE(lines[0]["dofs_per_second"].get<double>() == Approx(lines[0]["steps_per_second"].get<double>() * num_owned_dofs));
+  }
+
+  remove_file(filepath);
+}
+
+TEST_CASE("MetricsExporterReplacesThePrometheusFile", "[MetricsExporter]") {
+  const double tau = 1e-4;
+  const std::string filepath = "metrics_exporter_test.prom";
+  remove_file(filepath);
+
+  auto solver = create_solver(2);
+
+  mc::MetricsExporter exporter(MPI_COMM_WORLD, filepath, mc::MetricsFormat::prometheus);
+
+  // the default interval of a minute is not reached by a few steps
+  double t = 0;
+  for (std::size_t step = 0; step < 100; step += 1) {
+    solver->solve(tau, t);
+    t += tau;
+    REQUIRE(!exporter.step(*solver, t, tau));
+  }
+
+  // two exports leave only the latest one
+  exporter.write(*solver, t, tau);
+  exporter.write(*solver, t, tau);
+
+  if (mc::mpi::rank(MPI_COMM_WORLD) == 0) {
+    std::ifstream f(filepath);
+    REQUIRE(f.good());
+    std::stringstream ss;
+    ss << f.rdbuf();
+    const auto text = ss.str();
+    REQUIRE(text.find("# TYPE macrocirculation_steps_total counter\nmacrocirculation_steps_total 100\n") != std::string::npos);
+    REQUIRE(text.find("macrocirculation_cfl ") != std::string::npos);
+    REQUIRE(text.find("macrocirculation_newton_solves_total ") != std::string::npos);
+    // there were no steps since the previous export
+    REQUIRE(text.find("macrocirculation_steps_per_second 0\n") != std::string::npos);
+    REQUIRE(text.find("nan") == std::string::npos);
+    REQUIRE(!std::ifstream(filepath + ".tmp").good());
+  }
+
+  remove_file(filepath);
+}
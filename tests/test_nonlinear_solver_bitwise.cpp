@@ -16,16 +16,28 @@
 #include "macrocirculation/graph_partitioner.hpp"
 #include "macrocirculation/graph_storage.hpp"
 #include "macrocirculation/interpolate_to_vertices.hpp"
+#include "macrocirculation/right_hand_side_evaluator.hpp"
 
 #include "create_3_vessel_network.hpp"
 
 namespace mc = macrocirculation;
 
-/*! @brief Checks if we get the same solution values for A and Q as always.
- *         This should prevent unintended changes to the solver due to refactorings.
- *         Of course the resulting values should not be taken too seriously and might change if bugs are found.
+/*! @brief The time stepping schemes which we compare with the stored values. */
+enum class TimeStepping {
+  fixed,
+  adaptive,
+  adaptive_ssp_10_4,
+  multirate,
+  implicit_0d,
+  batched,
+  single_precision,
+  task_graph
+};
+
+/*! @brief Runs the 3 vessel network and compares the midpoints with the stored values.
+ *         With num_parts > 1 every vessel is split into the given number of parts, which should not change the solution.
  */
-TEST_CASE("NonlinearSolverBitwise", "[NonlinearSolverBitwise]") {
+void run_and_compare_with_stored_values(std::size_t num_threads, TimeStepping time_stepping = TimeStepping::fixed, std::size_t num_parts = 1) {
   const double t_end = 1.2;
   const std::size_t max_iter = 160000000;
   const size_t degree = 2;
@@ -33,6 +45,20 @@ TEST_CASE("NonlinearSolverBitwise", "[NonlinearSolverBitwise]") {
 
   // create_for_node the ascending aorta
   auto graph = test_macrocirculation::util::create_3_vessel_network();
+
+  // the part and its local coordinate, where we find the midpoint of every vessel
+  std::vector<std::pair<std::size_t, double>> midpoints;
+  for (auto e_id : graph->get_edge_ids()) {
+    const std::size_t num_micro_edges = graph->edge(e_id).num_micro_edges();
+    const auto part_ids = graph->split_edge(graph->edge(e_id), num_parts);
+    for (std::size_t k = 0; k < num_parts; k += 1) {
+      const double first = static_cast<double>((k * num_micro_edges) / num_parts);
+      const double last = static_cast<double>(((k + 1) * num_micro_edges) / num_parts);
+      if (first <= 0.5 * num_micro_edges && 0.5 * num_micro_edges < last)
+        midpoints.emplace_back(part_ids[k], (0.5 * num_micro_edges - first) / (last - first));
+    }
+  }
+
   graph->finalize_bcs();
 
   // partition graph
@@ -45,15 +71,51 @@ TEST_CASE("NonlinearSolverBitwise", "[NonlinearSolverBitwise]") {
   // configure solver
   mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, degree);
   solver.use_ssp_method();
+  if (time_stepping == TimeStepping::adaptive_ssp_10_4)
+    solver.use_ssp_10_4_method();
+  if (time_stepping == TimeStepping::single_precision) {
+    // the 5 stage method has a saved stage, which is stored as float
+    solver.set_storage_precision(mc::StoragePrecision::single_precision);
+    solver.use_ssp_5_3_method();
+  }
+  solver.set_num_threads(num_threads);
+  solver.set_implicit_0d_models(time_stepping == TimeStepping::implicit_0d);
+  solver.set_task_scheduling(time_stepping == TimeStepping::task_graph);
 
   double t = 0;
-  for (std::size_t it = 0; it < max_iter; it += 1) {
-    solver.solve(tau, t);
+  if (time_stepping == TimeStepping::adaptive || time_stepping == TimeStepping::adaptive_ssp_10_4) {
+    // time steps from the cfl condition, which have to hit the output times exactly
+    const double tau_out = 0.1;
+    std::size_t num_steps = 0;
+    for (std::size_t k = 1; k * tau_out < t_end + 1e-12; k += 1) {
+      const double t_out = k * tau_out;
+      while (t < t_out) {
+        solver.solve_adaptive(1e-3, t, t_out, 0.9);
+        num_steps += 1;
+      }
+      REQUIRE(t == t_out);
+    }
+    // the fixed time step is conservative, and the larger ssp coefficient pays off even per right-hand side evaluation
+    const std::size_t num_stages = time_stepping == TimeStepping::adaptive ? 3 : 10;
+    REQUIRE(num_steps * num_stages < 3 * t_end / tau);
+  } else if (time_stepping == TimeStepping::multirate) {
+    // the first vessel takes the time step tau, while the other two are sub-cycled twice
+    solver.set_time_step_levels({1, 0, 0});
+    while (t < t_end - 1e-12)
+      t += solver.solve_multirate(tau / 2, t);
+  } else if (time_stepping == TimeStepping::batched) {
+    // a driver, which enters the solver only once for many steps
+    while (t < t_end - 1e-12)
+      t = solver.solve_n(100, tau, t);
+  } else {
+    for (std::size_t it = 0; it < max_iter; it += 1) {
+      solver.solve(tau, t);
 
-    t += tau;
+      t += tau;
 
-    if (t > t_end + 1e-12)
-      break;
+      if (t > t_end + 1e-12)
+        break;
+    }
   }
 
   // values of A we have calculated previously:
@@ -68,11 +130,116 @@ TEST_CASE("NonlinearSolverBitwise", "[NonlinearSolverBitwise]") {
     3.1718725628944367e+02,
     9.1211576554297366e+01};
 
-  for (auto e_id : graph->get_active_edge_ids(mc::mpi::rank(MPI_COMM_WORLD))) {
-    auto &edge = *graph->get_edge(e_id);
+  // with different time steps we only stay close to the stored values
+  // the task graph only changes the order of the independent vertices and edges
+  double tol = time_stepping == TimeStepping::fixed || time_stepping == TimeStepping::task_graph ? 1e-10 : 1e-3;
+  // the saved stage in float changes the values around the 6th digit
+  if (time_stepping == TimeStepping::single_precision)
+    tol = 1e-5;
+
+  for (std::size_t e_id = 0; e_id < midpoints.size(); e_id += 1) {
+    auto &edge = graph->edge(midpoints[e_id].first);
+    if (edge.rank() != mc::mpi::rank(MPI_COMM_WORLD))
+      continue;
     double A, Q;
-    solver.evaluate_1d_AQ_values(edge, 0.5, A, Q);
-    REQUIRE(A == Approx(edge_id_to_A[e_id]).epsilon(1e-10));
-    REQUIRE(Q == Approx(edge_id_to_Q[e_id]).epsilon(1e-10));
+    solver.evaluate_1d_AQ_values(edge, midpoints[e_id].second, A, Q);
+    REQUIRE(A == Approx(edge_id_to_A[e_id]).epsilon(tol));
+    REQUIRE(Q == Approx(edge_id_to_Q[e_id]).epsilon(tol));
   }
-}
\ No newline at end of file
+
+  // all the newton solves of the upwinding have to converge
+  const auto newton_statistics = solver.get_rhs_evaluator().get_flow_upwind_evaluator().get_newton_statistics(true);
+  INFO("newton statistics: " << newton_statistics);
+  REQUIRE(newton_statistics.num_solves > 0);
+  REQUIRE(newton_statistics.num_failures == 0);
+}
+
+/*! @brief Checks if we get the same solution values for A and Q as always.
+ *         This should prevent unintended changes to the solver due to refactorings.
+ *         Of course the resulting values should not be taken too seriously and might change if bugs are found.
+ */
+TEST_CASE("NonlinearSolverBitwise", "[NonlinearSolverBitwise]") {
+  run_and_compare_with_stored_values(1);
+}
+
+TEST_CASE("NonlinearSolverBitwiseThreaded", "[NonlinearSolverBitwise]") {
+  run_and_compare_with_stored_values(2);
+}
+
+TEST_CASE("NonlinearSolverAdaptive", "[NonlinearSolverAdaptive]") {
+  run_and_compare_with_stored_values(1, TimeStepping::adaptive);
+}
+
+TEST_CASE("NonlinearSolverAdaptiveSSP104", "[NonlinearSolverAdaptive]") {
+  run_and_compare_with_stored_values(1, TimeStepping::adaptive_ssp_10_4);
+}
+
+TEST_CASE("NonlinearSolverMultirate", "[NonlinearSolverMultirate]") {
+  run_and_compare_with_stored_values(1, TimeStepping::multirate);
+}
+
+TEST_CASE("NonlinearSolverImplicit0D", "[NonlinearSolverImplicit0D]") {
+  run_and_compare_with_stored_values(1, TimeStepping::implicit_0d);
+}
+
+TEST_CASE("NonlinearSolverSplitVessels", "[NonlinearSolverBitwise]") {
+  run_and_compare_with_stored_values(1, TimeStepping::fixed, 3);
+}
+
+TEST_CASE("NonlinearSolverBatched", "[NonlinearSolverBitwise]") {
+  run_and_compare_with_stored_values(1, TimeStepping::batched);
+}
+
+TEST_CASE("NonlinearSolverSinglePrecisionStorage", "[NonlinearSolverSinglePrecisionStorage]") {
+  run_and_compare_with_stored_values(1, TimeStepping::single_precision);
+}
+
+TEST_CASE("NonlinearSolverTaskGraph", "[NonlinearSolverBitwise]") {
+  run_and_compare_with_stored_values(1, TimeStepping::task_graph);
+}
+
+TEST_CASE("NonlinearSolverTaskGraphThreaded", "[NonlinearSolverBitwise]") {
+  run_and_compare_with_stored_values(3, TimeStepping::task_graph, 3);
+}
+
+TEST_CASE("NonlinearSolverEdgeBatchesAgreeWithSingleEdges", "[NonlinearSolverBitwise]") {
+  const size_t degree = 2;
+  const double tau = 5e-5;
+  const std::size_t num_steps = 2000;
+
+  // the vessels are split into short parts, which are batched
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  for (auto e_id : graph->get_edge_ids())
+    graph->split_edge(graph->edge(e_id), 3);
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, degree);
+  solver.use_ssp_method();
+  solver.set_num_threads(2);
+  mc::ExplicitNonlinearFlowSolver reference_solver(MPI_COMM_WORLD, graph, dof_map, degree);
+  reference_solver.use_ssp_method();
+  reference_solver.get_rhs_evaluator().set_edge_batching(0);
+  REQUIRE(reference_solver.get_rhs_evaluator().num_edge_batches() == 0);
+
+  std::size_t num_batches = solver.get_rhs_evaluator().num_edge_batches();
+  MPI_Allreduce(MPI_IN_PLACE, &num_batches, 1, MPI_UNSIGNED_LONG, MPI_SUM, MPI_COMM_WORLD);
+  REQUIRE(num_batches > 0);
+
+  double t = 0;
+  for (std::size_t it = 0; it < num_steps; it += 1) {
+    solver.solve(tau, t);
+    reference_solver.solve(tau, t);
+    t += tau;
+  }
+
+  // the batches scale the shape functions to the micro edges, which only changes the round-off
+  const auto &values = solver.get_solution();
+  const auto &reference = reference_solver.get_solution();
+  REQUIRE(values.size() == reference.size());
+  for (std::size_t k = 0; k < values.size(); k += 1)
+    REQUIRE(values[k] == Approx(reference[k]).epsilon(1e-10).margin(1e-10));
+}
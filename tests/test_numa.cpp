@@ -0,0 +1,67 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "macrocirculation/numa.hpp"
+#include "macrocirculation/thread_pool.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("CoreListsAreParsed", "[Numa]") {
+  REQUIRE(mc::parse_core_list("0-3,8,10-11") == std::vector<int>{0, 1, 2, 3, 8, 10, 11});
+  REQUIRE(mc::parse_core_list("") == std::vector<int>{});
+  REQUIRE_THROWS(mc::parse_core_list("3-1"));
+  REQUIRE_THROWS(mc::parse_core_list("0-a"));
+  REQUIRE_THROWS(mc::parse_core_list("x"));
+
+  // every rank of a node gets its own block of cores
+  const auto cores = mc::select_cores_of_rank(MPI_COMM_WORLD, {0, 1, 2}, 2);
+  REQUIRE(cores.size() == 2);
+  REQUIRE(cores[1] == (cores[0] + 1) % 3);
+}
+
+TEST_CASE("FirstTouchKeepsTheValues", "[Numa]") {
+  // large enough to span many pages
+  std::vector<double> values(100000);
+  for (std::size_t k = 0; k < values.size(); k += 1)
+    values[k] = static_cast<double>(k);
+  const auto expected = values;
+
+  mc::ThreadPool pool(3);
+  mc::first_touch(&pool, {0, 10, 50000, values.size()}, values);
+  REQUIRE(values == expected);
+  mc::first_touch(nullptr, {}, values);
+  REQUIRE(values == expected);
+  REQUIRE_THROWS(mc::first_touch(&pool, {0, 10, 50000, 60000}, values));
+}
+
+#ifdef __linux__
+TEST_CASE("ThreadsArePinnedToTheGivenCores", "[Numa]") {
+  // we only bind to a core, which we are allowed to run on
+  cpu_set_t allowed;
+  REQUIRE(sched_getaffinity(0, sizeof(cpu_set_t), &allowed) == 0);
+  int core = 0;
+  while (!CPU_ISSET(core, &allowed))
+    core += 1;
+
+  mc::ThreadPool pool(2);
+  pool.pin_threads({core});
+  std::vector<int> cpus(2, -1);
+  pool.parallel_for(2, [&](std::size_t thread_id, std::size_t, std::size_t) { cpus[thread_id] = sched_getcpu(); });
+  REQUIRE(cpus == std::vector<int>{core, core});
+
+  // the calling thread gets its mask back for the other tests
+  REQUIRE(sched_setaffinity(0, sizeof(cpu_set_t), &allowed) == 0);
+  REQUIRE_THROWS(pool.pin_threads({}));
+}
+#endif
@@ -0,0 +1,67 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <cmath>
+#include <memory>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/parareal_solver.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+/*! @brief Checks that the parareal iteration with one slice per rank reproduces the fine solver after num_slices iterations. */
+TEST_CASE("PararealReproducesTheFineSolver", "[PararealSolver]") {
+  const std::size_t degree = 2;
+  const double tau_fine = 5e-5;
+  const double tau_coarse = 1e-4;
+  const double slice_length = 0.05;
+
+  mc::PararealSolver parareal(MPI_COMM_WORLD, static_cast<std::size_t>(mc::mpi::size(MPI_COMM_WORLD)));
+  const MPI_Comm comm = parareal.get_slice_comm();
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, comm);
+
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(comm, *graph, 2, degree, false);
+
+  mc::ExplicitNonlinearFlowSolver fine(comm, graph, dof_map, degree);
+  mc::ExplicitNonlinearFlowSolver coarse(comm, graph, dof_map, degree);
+  mc::ExplicitNonlinearFlowSolver reference(comm, graph, dof_map, degree);
+  for (auto *solver : {&fine, &coarse, &reference})
+    solver->use_ssp_method();
+
+  parareal.set_fine_propagator(mc::PararealSolver::create_propagator(fine, tau_fine));
+  parareal.set_coarse_propagator(mc::PararealSolver::create_propagator(coarse, tau_coarse));
+
+  std::vector<double> u = reference.get_solution();
+  const auto num_iterations = parareal.solve(0, slice_length, u, 0, 100);
+  REQUIRE(num_iterations == parareal.num_slices());
+  REQUIRE(parareal.get_changes().size() == num_iterations);
+
+  // the reference integrates sequentially until the end of our slice
+  const auto num_steps = static_cast<std::size_t>((parareal.get_slice() + 1) * std::round(slice_length / tau_fine));
+  for (std::size_t step = 0; step < num_steps; step += 1)
+    reference.solve(tau_fine, static_cast<double>(step) * tau_fine);
+
+  for (auto e_id : graph->get_active_edge_ids(mc::mpi::rank(comm))) {
+    const auto &local_dof_map = dof_map->get_local_dof_map(graph->edge(e_id));
+    for (std::size_t k = 0; k < local_dof_map.num_local_dof(); k += 1) {
+      const auto dof = local_dof_map.first_dof(0, 0) + k;
+      REQUIRE(u[dof] == Approx(reference.get_solution()[dof]).epsilon(1e-8).margin(1e-10));
+    }
+  }
+}
@@ -0,0 +1,103 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <functional>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/periodic_state_monitor.hpp"
+#include "macrocirculation/vessel_formulas.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+namespace {
+
+/*! @brief Creates the 3 vessel network with the given inflow. */
+std::shared_ptr<mc::GraphStorage> create_network(std::function<double(double)> inflow) {
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->get_vertex(0)->set_to_inflow_with_fixed_flow(std::move(inflow));
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_SELF);
+  return graph;
+}
+
+/*! @brief Runs the flow on the given network until t_end and feeds the monitors after every step. */
+void run(const std::shared_ptr<mc::GraphStorage> &graph, double t_end, const std::vector<mc::PeriodicStateMonitor *> &monitors) {
+  const size_t degree = 1;
+  const double tau = 1e-4;
+
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_SELF, *graph, 2, degree, false);
+
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_SELF, graph, dof_map, degree);
+  solver.use_ssp_method();
+
+  double t = 0;
+  for (auto monitor : monitors)
+    monitor->update(solver, t);
+  while (t < t_end - 1e-12) {
+    solver.solve(tau, t);
+    t += tau;
+    for (auto monitor : monitors)
+      monitor->update(solver, t);
+  }
+}
+
+} // namespace
+
+TEST_CASE("PeriodicStateMonitorCountsPeriods", "[PeriodicStateMonitor]") {
+  // without any inflow the network slowly relaxes to the venous pressure of the windkessel models
+  auto graph = create_network([](double) { return 0.; });
+
+  mc::PeriodicStateMonitor monitor(MPI_COMM_SELF, graph, 0.01, 16);
+  monitor.set_tolerance(10);
+  mc::PeriodicStateMonitor strict_monitor(MPI_COMM_SELF, graph, 0.01, 16);
+  strict_monitor.set_tolerance(0);
+
+  run(graph, 0.035, {&monitor, &strict_monitor});
+
+  REQUIRE(monitor.get_num_periods() == 3);
+  REQUIRE(monitor.get_end_of_last_period() == Approx(0.03));
+  REQUIRE(monitor.get_difference() < 10);
+  REQUIRE(monitor.is_converged());
+
+  // the difference has to be strictly smaller than the tolerance
+  REQUIRE(strict_monitor.get_num_periods() == 3);
+  REQUIRE(strict_monitor.get_difference() == Approx(monitor.get_difference()));
+  REQUIRE(!strict_monitor.is_converged());
+}
+
+TEST_CASE("PeriodicStateMonitorComparesHeartBeats", "[PeriodicStateMonitor]") {
+  // a periodic pulse, which first has to fill the windkessel models
+  const mc::piecewise_linear_source_function inflow({0, 0.005, 0.01, 0.02}, {0, 100, 0, 0}, true);
+
+  auto graph = create_network(inflow);
+  mc::PeriodicStateMonitor monitor(MPI_COMM_SELF, graph, inflow.get_period(), 32);
+
+  // before the second period we cannot compare anything
+  run(graph, 0.039, {&monitor});
+  REQUIRE(monitor.get_num_periods() == 1);
+  REQUIRE(monitor.get_difference() == std::numeric_limits<double>::infinity());
+
+  // the first pulses travel through the empty network, hence they differ a lot
+  auto graph2 = create_network(inflow);
+  mc::PeriodicStateMonitor monitor2(MPI_COMM_SELF, graph2, inflow.get_period(), 32);
+  run(graph2, 0.041, {&monitor2});
+  REQUIRE(monitor2.get_num_periods() == 2);
+  REQUIRE(monitor2.get_difference() > 1e-2);
+  REQUIRE(!monitor2.is_converged());
+}
@@ -0,0 +1,63 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <memory>
+#include <vector>
+
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/parareal_solver.hpp"
+#include "macrocirculation/periodic_state_solver.hpp"
+#include "macrocirculation/vessel_formulas.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("AndersonAccelerationConvergesInFewerCycles", "[PeriodicStateSolver]") {
+  const std::size_t degree = 1;
+  const double period = 0.1;
+  const double tau = 1e-4;
+
+  // the number of cycles until the 0D models are periodic, where the windkessel models relax much slower than the period
+  const auto run = [&](std::size_t depth) {
+    auto graph = test_macrocirculation::util::create_3_vessel_network();
+    graph->vertex(0).set_to_inflow_with_fixed_flow(mc::heart_beat_inflow(485., period, 0.03));
+    graph->finalize_bcs();
+    // on two ranks the first rank owns no windkessel, hence it takes part in the iteration without accelerated dofs
+    mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+
+    auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+    dof_map->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+
+    mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, degree);
+    solver.use_ssp_method();
+
+    mc::PeriodicStateSolver periodic_state_solver(MPI_COMM_WORLD, graph, dof_map, period);
+    periodic_state_solver.set_propagator(mc::PararealSolver::create_propagator(solver, tau));
+    periodic_state_solver.set_depth(depth);
+
+    std::vector<double> u = solver.get_solution();
+    const double t = periodic_state_solver.solve(0., u, 1e-4, 40);
+    REQUIRE(t == Approx(period * static_cast<double>(periodic_state_solver.get_residuals().size())));
+    return periodic_state_solver;
+  };
+
+  const auto plain = run(0);
+  const auto accelerated = run(5);
+
+  // the plain cycles only reduce the residual by a constant factor close to one
+  REQUIRE(!plain.is_converged());
+  REQUIRE(plain.get_residuals().back() > 1e-3);
+
+  REQUIRE(accelerated.is_converged());
+  REQUIRE(accelerated.get_residuals().size() < 25);
+}
@@ -0,0 +1,78 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/phase_timers.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("PhaseTimersAreNestedAndReducedOverThreadsAndRanks", "[PhaseTimers]") {
+  const int rank = mc::mpi::rank(MPI_COMM_WORLD);
+  const int size = mc::mpi::size(MPI_COMM_WORLD);
+
+  mc::PhaseTimers::reset();
+
+  for (std::size_t step = 0; step < 3; step += 1) {
+    mc::ScopedPhaseTimer solve("solve");
+    {
+      mc::ScopedPhaseTimer rhs("rhs");
+      mc::ScopedPhaseTimer assembly("assembly");
+    }
+    // the last rank knows a phase, which the other ranks never enter
+    if (rank == size - 1) {
+      mc::ScopedPhaseTimer output("output");
+    }
+  }
+
+  // the threads record into their own trees, which are merged by the paths
+  std::vector<std::thread> threads;
+  for (std::size_t k = 0; k < 2; k += 1)
+    threads.emplace_back([] { mc::ScopedPhaseTimer worker("worker"); });
+  for (auto &thread : threads)
+    thread.join();
+
+  const auto statistics = mc::PhaseTimers::reduce(MPI_COMM_WORLD);
+
+  std::vector<std::string> paths;
+  for (const auto &s : statistics) {
+    paths.push_back(s.path);
+    REQUIRE(s.min >= 0);
+    REQUIRE(s.min <= s.avg);
+    REQUIRE(s.avg <= s.max);
+  }
+  REQUIRE(paths == std::vector<std::string>{"solve", "solve/output", "solve/rhs", "solve/rhs/assembly", "worker"});
+
+  REQUIRE(statistics[0].calls == 3);
+  REQUIRE(statistics[1].calls == 3);
+  REQUIRE(statistics[3].calls == 3);
+  REQUIRE(statistics[4].calls == 2);
+
+  // the parents include the times of their children
+  REQUIRE(statistics[0].max >= statistics[2].max);
+
+  // only the last rank recorded the output
+  if (size > 1)
+    REQUIRE(statistics[1].min == 0);
+
+  std::stringstream table;
+  mc::PhaseTimers::print(MPI_COMM_WORLD, table);
+  if (rank == 0)
+    REQUIRE(table.str().find("    assembly") != std::string::npos);
+
+  // the phases are kept after a reset, but their times are zero
+  mc::PhaseTimers::reset();
+  for (const auto &s : mc::PhaseTimers::reduce(MPI_COMM_WORLD)) {
+    REQUIRE(s.calls == 0);
+    REQUIRE(s.max == 0);
+  }
+}
@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <cstdio>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <set>
+#include <string>
+#include <thread>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/phase_timers.hpp"
+#include "macrocirculation/phase_trace.hpp"
+
+namespace mc = macrocirculation;
+
+namespace {
+
+const char *step_names[] = {"step 0", "step 1", "step 2", "step 3", "step 4", "step 5"};
+
+} // namespace
+
+TEST_CASE("PhaseTraceKeepsTheLatestPhasesOfEveryThread", "[PhaseTrace]") {
+  // nothing is recorded before the start
+  {
+    mc::ScopedPhaseTimer ignored("ignored");
+  }
+
+  mc::PhaseTrace::start(MPI_COMM_WORLD, 4);
+  REQUIRE(mc::PhaseTrace::is_recording());
+  for (auto name : step_names) {
+    mc::ScopedPhaseTimer step(name);
+  }
+  std::thread([] { mc::ScopedPhaseTimer worker("worker"); }).join();
+  mc::PhaseTrace::stop();
+
+  // nothing is recorded after the stop
+  {
+    mc::ScopedPhaseTimer ignored("ignored");
+  }
+
+  const auto events = mc::PhaseTrace::get_events();
+  std::vector<std::string> main_names;
+  std::size_t num_worker_events = 0;
+  for (const auto &thread_events : events) {
+    for (std::size_t k = 0; k < thread_events.size(); k += 1) {
+      REQUIRE(thread_events[k].start >= 0);
+      REQUIRE(thread_events[k].duration >= 0);
+      if (k > 0)
+        REQUIRE(thread_events[k].start >= thread_events[k - 1].start);
+      if (std::string(thread_events[k].name) == "worker")
+        num_worker_events += 1;
+      else
+        main_names.emplace_back(thread_events[k].name);
+    }
+  }
+
+  // the ring buffer of the main thread only kept the last 4 steps
+  REQUIRE(main_names == std::vector<std::string>{"step 2", "step 3", "step 4", "step 5"});
+  REQUIRE(num_worker_events == 1);
+  REQUIRE(mc::PhaseTrace::num_dropped_events() == 2);
+
+  // every rank is a process of the chrome trace
+  const std::string filepath = "phase_trace_test.json";
+  mc::PhaseTrace::write_chrome_json(MPI_COMM_WORLD, filepath);
+  if (mc::mpi::rank(MPI_COMM_WORLD) == 0) {
+    std::ifstream f(filepath);
+    nlohmann::json trace;
+    f >> trace;
+    std::set<int> pids;
+    std::size_t num_phases = 0;
+    for (const auto &event : trace["traceEvents"]) {
+      pids.insert(event["pid"].get<int>());
+      if (event["ph"] == "X")
+        num_phases += 1;
+    }
+    REQUIRE(pids.size() == static_cast<std::size_t>(mc::mpi::size(MPI_COMM_WORLD)));
+    REQUIRE(num_phases == 5 * static_cast<std::size_t>(mc::mpi::size(MPI_COMM_WORLD)));
+    std::remove(filepath.c_str());
+  }
+
+  // a new trace starts empty
+  mc::PhaseTrace::start(MPI_COMM_WORLD, 4);
+  mc::PhaseTrace::stop();
+  REQUIRE(mc::PhaseTrace::num_dropped_events() == 0);
+  for (const auto &thread_events : mc::PhaseTrace::get_events())
+    REQUIRE(thread_events.empty());
+}
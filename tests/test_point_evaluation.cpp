@@ -0,0 +1,88 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <memory>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/fe_type.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+namespace {
+
+/*! @brief Evaluates a component of the solution with the finite element on the given micro edge. */
+double evaluate_with_fe(const mc::LocalEdgeDofMap &local_dof_map, const std::vector<double> &u, std::size_t micro_edge, std::size_t component, double s_tilde) {
+  const double *values = local_dof_map.dof_values(u, micro_edge, component);
+  return mc::FETypeNetwork::evaluate_dof(std::vector<double>(values, values + local_dof_map.num_basis_functions()), s_tilde);
+}
+
+} // namespace
+
+TEST_CASE("TabulatedEvaluationsAgreeWithTheFiniteElement", "[ExplicitNonlinearFlowSolver]") {
+  const std::size_t degree = 2;
+  const double tau = 1e-4;
+  const auto rank = mc::mpi::rank(MPI_COMM_WORLD);
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, degree);
+  solver.use_ssp_method();
+
+  for (std::size_t k = 0; k < 50; k += 1)
+    solver.solve(tau, static_cast<double>(k) * tau);
+  const auto &u = solver.get_solution();
+
+  for (auto e_id : graph->get_active_edge_ids(rank)) {
+    const auto &edge = *graph->get_edge(e_id);
+    const auto &local_dof_map = dof_map->get_local_dof_map(edge);
+
+    // the centers of the micro edges 1 and 2 of every vessel
+    for (std::size_t micro_edge : {1, 2}) {
+      const double s = (static_cast<double>(micro_edge) + 0.5) / static_cast<double>(edge.num_micro_edges());
+      const auto evaluation = solver.create_point_evaluation(edge, s);
+      double A, Q, A_reused, Q_reused;
+      solver.evaluate_1d_AQ_values(edge, s, A, Q);
+      solver.evaluate_1d_AQ_values(evaluation, A_reused, Q_reused);
+      REQUIRE(A == A_reused);
+      REQUIRE(Q == Q_reused);
+      REQUIRE(A == Approx(evaluate_with_fe(local_dof_map, u, micro_edge, solver.A_component, 0.)));
+      REQUIRE(Q == Approx(evaluate_with_fe(local_dof_map, u, micro_edge, solver.Q_component, 0.)));
+    }
+  }
+
+  for (auto v_id : graph->get_active_vertex_ids(rank)) {
+    const auto &vertex = *graph->get_vertex(v_id);
+    if (!vertex.is_leaf())
+      continue;
+    const auto &edge = *graph->get_edge(vertex.get_edge_neighbors()[0]);
+    const auto &local_dof_map = dof_map->get_local_dof_map(edge);
+    const bool is_right = edge.is_pointing_to(v_id);
+    const std::size_t micro_edge = is_right ? edge.num_micro_edges() - 1 : 0;
+    const double s_tilde = is_right ? +1. : -1.;
+
+    const double Q_expected = evaluate_with_fe(local_dof_map, u, micro_edge, solver.Q_component, s_tilde);
+    const double A_expected = evaluate_with_fe(local_dof_map, u, micro_edge, solver.A_component, s_tilde);
+
+    double A, Q;
+    solver.get_1d_AQ_values_at_vertex(vertex, A, Q);
+    REQUIRE(A == Approx(A_expected));
+    REQUIRE(Q == Approx(Q_expected));
+    REQUIRE(solver.get_flow_at_vessel_tip(vertex) == Approx(is_right ? Q_expected : -Q_expected));
+  }
+}
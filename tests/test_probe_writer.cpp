@@ -0,0 +1,133 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <fstream>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/fe_type.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/probe_writer.hpp"
+#include "macrocirculation/vessel_formulas.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("ProbeWriterRecordsTheSolutionAtTheProbes", "[ProbeWriter]") {
+  const std::size_t degree = 2;
+  const double tau = 1e-4;
+  const auto rank = mc::mpi::rank(MPI_COMM_WORLD);
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->get_edge(0)->set_name("aorta");
+  graph->get_edge(1)->set_name("branch_1");
+  graph->get_edge(2)->set_name("branch_2");
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, degree);
+  solver.use_ssp_method();
+
+  // the expected edge, micro edge and reference coordinate of each probe
+  struct Expected {
+    std::size_t edge_id;
+    double s;
+    std::size_t micro_edge;
+    double xi;
+  };
+  const std::vector<Expected> expected{
+    {0, 0.25, 2, 0.},
+    {0, 1., 9, 1.},
+    {1, 0.5, 3, -1.},
+    {2, 0.25, 2, 0.}};
+
+  std::vector<double> times;
+  std::vector<std::vector<double>> solutions;
+  {
+    mc::ProbeWriter writer(MPI_COMM_WORLD, ".", "probe_writer_test", graph, dof_map);
+    writer.add_probe("aorta", 0.25);
+    writer.add_probe("aorta", 1., "aorta_end");
+    // the points are projected onto the embedding of the branches
+    writer.add_probe(mc::Point(0.5, 1.1, 0));
+    writer.add_probe(mc::Point(-0.25, 0.9, 0), "branch_2_quarter");
+    // a tiny buffer, such that some of the records are written before the writer is destroyed
+    writer.set_buffer_size(64);
+    writer.setup();
+
+    double t = 0;
+    for (std::size_t step = 0; step < 3; step += 1) {
+      for (std::size_t k = 0; k < 10; k += 1, t += tau)
+        solver.solve(tau, t);
+      writer.write(t, solver.get_solution());
+      times.push_back(t);
+      solutions.push_back(solver.get_solution());
+    }
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  using json = nlohmann::json;
+  std::ifstream meta_file("probe_writer_test.json");
+  const auto meta = json::parse(meta_file);
+
+  REQUIRE(meta["probes"].size() == expected.size());
+  REQUIRE(meta["probes"][1]["name"] == "aorta_end");
+  REQUIRE(meta["probes"][3]["name"] == "branch_2_quarter");
+  REQUIRE(meta["probes"][2]["edge_name"] == "branch_1");
+
+  // every rank checks the records of its own probes
+  const auto &rank_info = meta["ranks"][rank];
+  const std::size_t record_size = rank_info["record_size"];
+  std::vector<double> records(record_size * times.size());
+  if (record_size > 0) {
+    std::ifstream f(rank_info["filepath"].get<std::string>(), std::ios::binary);
+    f.read(reinterpret_cast<char *>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(double)));
+    REQUIRE(f);
+    REQUIRE(f.peek() == std::ifstream::traits_type::eof());
+  }
+
+  for (std::size_t probe_idx = 0; probe_idx < expected.size(); probe_idx += 1) {
+    const auto &probe = meta["probes"][probe_idx];
+    const auto &e = expected[probe_idx];
+    REQUIRE(probe["edge_id"] == e.edge_id);
+    REQUIRE(probe["s"].get<double>() == Approx(e.s));
+    REQUIRE(probe["micro_edge"] == e.micro_edge);
+
+    const auto &edge = *graph->get_edge(e.edge_id);
+    REQUIRE(probe["rank"] == edge.rank());
+    if (edge.rank() != rank)
+      continue;
+
+    const auto &local_dof_map = dof_map->get_local_dof_map(edge);
+    const auto &param = edge.get_physical_data();
+    for (std::size_t step = 0; step < times.size(); step += 1) {
+      const double *record = records.data() + step * record_size;
+      REQUIRE(record[0] == times[step]);
+
+      const double *q_dofs = local_dof_map.dof_values(solutions[step], e.micro_edge, solver.Q_component);
+      const double *a_dofs = local_dof_map.dof_values(solutions[step], e.micro_edge, solver.A_component);
+      const double q = mc::FETypeNetwork::evaluate_dof(std::vector<double>(q_dofs, q_dofs + degree + 1), e.xi);
+      const double a = mc::FETypeNetwork::evaluate_dof(std::vector<double>(a_dofs, a_dofs + degree + 1), e.xi);
+
+      const std::size_t offset = probe["offsets"]["p"];
+      REQUIRE(probe["offsets"]["q"] == offset + 1);
+      REQUIRE(probe["offsets"]["a"] == offset + 2);
+      REQUIRE(record[offset] == Approx(mc::nonlinear::get_p_from_A(a, param.G0, param.A0)));
+      REQUIRE(record[offset + 1] == Approx(q));
+      REQUIRE(record[offset + 2] == Approx(a));
+    }
+  }
+}
@@ -0,0 +1,144 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/scratch_arena.hpp"
+#include "macrocirculation/vessel_formulas.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+namespace {
+
+/*! @brief The number of allocations with the global operator new of this test, which are counted only if enabled. */
+std::atomic<bool> count_allocations{false};
+std::atomic<std::size_t> num_allocations{0};
+
+} // namespace
+
+// The test hook counts the allocations of all the threads of this executable.
+// All the forms of new and delete are replaced in pairs on top of malloc and free.
+// The deletes are not inlined, since gcc would otherwise match their free against its builtin operator new.
+void *operator new(std::size_t size) {
+  if (count_allocations.load(std::memory_order_relaxed))
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+  void *ptr = std::malloc(size > 0 ? size : 1);
+  if (ptr == nullptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+
+__attribute__((noinline)) void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+__attribute__((noinline)) void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+__attribute__((noinline)) void operator delete[](void *ptr) noexcept { std::free(ptr); }
+
+__attribute__((noinline)) void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+TEST_CASE("ScratchArenaReusesItsMemoryAfterReset", "[ScratchArena]") {
+  mc::ScratchArena arena;
+  REQUIRE(arena.capacity() == 0);
+
+  // the first stage does not fit, hence the arrays get blocks of their own
+  double *a = arena.allocate<double>(10);
+  auto *b = arena.allocate<std::size_t>(3);
+  char *c = arena.allocate<char>(1);
+  REQUIRE(arena.num_heap_allocations() == 3);
+  for (std::size_t k = 0; k < 10; k += 1)
+    a[k] = static_cast<double>(k);
+  b[2] = 7;
+  c[0] = 'x';
+  REQUIRE(a[9] == 9);
+
+  // the next stages get a single block, which is large enough for all of them
+  arena.reset();
+  REQUIRE(arena.num_heap_allocations() == 4);
+  REQUIRE(arena.capacity() >= 10 * sizeof(double) + 3 * sizeof(std::size_t) + 1);
+
+  for (std::size_t stage = 0; stage < 3; stage += 1) {
+    double *x = arena.allocate<double>(10);
+    auto *y = arena.allocate<std::size_t>(3);
+    char *z = arena.allocate<char>(1);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(x) % alignof(std::max_align_t) == 0);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(y) % alignof(std::max_align_t) == 0);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(y) >= reinterpret_cast<std::uintptr_t>(x + 10));
+    REQUIRE(reinterpret_cast<std::uintptr_t>(z) >= reinterpret_cast<std::uintptr_t>(y + 3));
+    arena.reset();
+  }
+  REQUIRE(arena.num_heap_allocations() == 4);
+}
+
+TEST_CASE("NFurcationWithScratchAgreesWithTheVectors", "[ScratchArena]") {
+  // five vessels need a workspace on the heap or in the scratch
+  const std::vector<mc::VesselParameters> p{{592.4e2, 6.97, 1.028}, {592.4e2, 3.1, 1.028}, {592.4e2, 4.0, 1.028}, {592.4e2, 2.0, 1.028}, {592.4e2, 1.5, 1.028}};
+  const std::vector<double> Q{15., 5., 4., 3., 2.};
+  std::vector<double> A;
+  for (const auto &param : p)
+    A.push_back(param.A0 * 1.02);
+  const std::vector<bool> in{true, false, false, false, false};
+
+  std::vector<double> Q_up(5, 0), A_up(5, 0);
+  const auto num_iter = mc::solve_at_nfurcation(Q, A, p, in, Q_up, A_up);
+
+  mc::ScratchArena arena;
+  double *scratch = arena.allocate<double>(mc::nfurcation_scratch_size(5));
+  std::vector<double> Q_up_scratch(5, 0), A_up_scratch(5, 0);
+  const auto num_iter_scratch = mc::solve_at_nfurcation(5, Q.data(), A.data(), p.data(), in, Q_up_scratch.data(), A_up_scratch.data(), false, nullptr, scratch);
+
+  REQUIRE(num_iter_scratch == num_iter);
+  REQUIRE(Q_up_scratch == Q_up);
+  REQUIRE(A_up_scratch == A_up);
+}
+
+TEST_CASE("TimeSteppingDoesNotAllocate", "[ScratchArena]") {
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, 2, false);
+
+  for (std::size_t num_threads : {1, 2}) {
+    mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, 2);
+    solver.use_ssp_method();
+    solver.set_num_threads(num_threads);
+
+    // the first steps size the arenas and the buffers
+    const double tau = 2.5e-5;
+    double t = 0;
+    for (std::size_t k = 0; k < 5; k += 1) {
+      solver.solve(tau, t);
+      t += tau;
+    }
+
+    num_allocations = 0;
+    count_allocations = true;
+    for (std::size_t k = 0; k < 20; k += 1) {
+      solver.solve(tau, t);
+      t += tau;
+    }
+    count_allocations = false;
+
+    REQUIRE(num_allocations == 0);
+  }
+}
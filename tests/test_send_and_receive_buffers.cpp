@@ -1,4 +1,5 @@
 #include "catch2/catch.hpp"
+#include <vector>
 
 #include "macrocirculation/communication/buffer.hpp"
 
@@ -21,3 +22,27 @@ TEST_CASE("TestSendAndRecevieBuffers", "[send_and_receive_buffer]") {
    rb >> c;
    REQUIRE(c == 42.3);
 }
+
+TEST_CASE("TestSendAndRecevieBuffersInBulk", "[send_and_receive_buffer]") {
+   const std::vector<double> values{1.5, -2.25, 3.125};
+
+   mc::SendBuffer sb;
+   sb << 7U;
+   sb.write(values.data(), values.size());
+   sb << 'x';
+   mc::ReceiveBuffer rb(sb.get_buffer());
+
+   unsigned int a;
+   rb >> a;
+   REQUIRE(a == 7U);
+
+   // the doubles start at an unaligned position
+   std::vector<double> received(values.size(), 0);
+   rb.read(received.data(), received.size());
+   REQUIRE(received == values);
+
+   char c;
+   rb >> c;
+   REQUIRE(c == 'x');
+   REQUIRE(rb.empty());
+}
@@ -0,0 +1,115 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <memory>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/snapshot_history.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("SnapshotHistoryKeepsTheRecentStates", "[SnapshotHistory]") {
+  mc::SnapshotHistory history(MPI_COMM_SELF);
+
+  std::vector<double> written_t;
+  std::vector<double> written_u;
+  history.set_write_function([&](double t, const std::vector<double> &u) {
+    written_t.push_back(t);
+    written_u.push_back(u[0]);
+  });
+
+  // an unconfigured history neither records nor flushes
+  history.trigger();
+  history.step(0., {0.});
+  REQUIRE(!history.is_active());
+  REQUIRE(history.size() == 0);
+  REQUIRE_THROWS(history.configure(3, 0));
+
+  SECTION("double precision") {
+    history.configure(3, 2);
+    for (std::size_t k = 1; k <= 10; k += 1)
+      history.step(static_cast<double>(k), {0.1 * static_cast<double>(k)});
+    REQUIRE(history.size() == 3);
+    REQUIRE(written_t.empty());
+
+    // the trigger fires at the next recorded step, which becomes the newest snapshot
+    history.trigger();
+    history.step(11., {1.1});
+    REQUIRE(written_t.empty());
+    history.step(12., {1.2});
+    REQUIRE(written_t == std::vector<double>{8., 10., 12.});
+    REQUIRE(written_u == std::vector<double>{0.1 * 8, 0.1 * 10, 1.2});
+    REQUIRE(history.size() == 0);
+    REQUIRE(history.num_flushes() == 1);
+  }
+
+  SECTION("single precision") {
+    history.configure(2, 1, mc::StoragePrecision::single_precision);
+    history.set_predicate([](double t, const std::vector<double> &) { return t == 3.; });
+    for (std::size_t k = 1; k <= 4; k += 1)
+      history.step(static_cast<double>(k), {0.1 * static_cast<double>(k)});
+    REQUIRE(written_t == std::vector<double>{2., 3.});
+    REQUIRE(written_u == std::vector<double>{static_cast<float>(0.2), static_cast<float>(0.1 * 3)});
+    REQUIRE(history.size() == 1);
+  }
+}
+
+TEST_CASE("SolverFlushesTheSnapshotsOnAllRanks", "[SnapshotHistory]") {
+  const std::size_t degree = 2;
+  const double tau = 1e-4;
+  const int rank = mc::mpi::rank(MPI_COMM_WORLD);
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+  auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+  dof_map->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+  mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, degree);
+  solver.use_ssp_method();
+
+  std::vector<double> written_t;
+  std::vector<std::vector<double>> written_u;
+  auto &history = solver.get_snapshot_history();
+  history.configure(4, 5);
+  history.set_write_function([&](double t, const std::vector<double> &u) {
+    written_t.push_back(t);
+    written_u.push_back(u);
+  });
+  // only the last rank sees the event
+  std::size_t num_checks = 0;
+  history.set_predicate([&](double, const std::vector<double> &) {
+    num_checks += 1;
+    return rank == mc::mpi::size(MPI_COMM_WORLD) - 1 && num_checks == 6;
+  });
+
+  std::vector<std::vector<double>> solutions;
+  double t = 0;
+  for (std::size_t step = 0; step < 40; step += 1, t += tau) {
+    solver.solve(tau, t);
+    solutions.push_back(solver.get_solution());
+  }
+
+  // the flush happened at step 30 and contains the steps 15, 20, 25 and 30 with the 0D dofs
+  REQUIRE(num_checks == 8);
+  REQUIRE(history.num_flushes() == 1);
+  REQUIRE(history.size() == 2);
+  REQUIRE(written_t.size() == 4);
+  for (std::size_t k = 0; k < 4; k += 1) {
+    const std::size_t step = 15 + 5 * k;
+    REQUIRE(written_t[k] == Approx(step * tau));
+    REQUIRE(written_u[k] == solutions[step - 1]);
+  }
+}
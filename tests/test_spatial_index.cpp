@@ -0,0 +1,80 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/spatial_index.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("PointKDTreeAgreesWithBruteForce", "[SpatialIndex]") {
+  std::mt19937 generator(42);
+  std::uniform_real_distribution<double> distribution(0, 1);
+
+  std::vector<mc::Point> points;
+  std::vector<std::size_t> ids;
+  for (std::size_t k = 0; k < 500; k += 1) {
+    points.emplace_back(distribution(generator), distribution(generator), distribution(generator));
+    ids.push_back(k);
+  }
+  const mc::PointKDTree tree(points, ids);
+  REQUIRE(tree.size() == points.size());
+
+  for (std::size_t q = 0; q < 50; q += 1) {
+    const mc::Point p(distribution(generator), distribution(generator), distribution(generator));
+    const double radius = 0.15;
+
+    std::vector<std::size_t> expected;
+    std::size_t nearest = 0;
+    double nearest_distance = std::numeric_limits<double>::max();
+    for (std::size_t k = 0; k < points.size(); k += 1) {
+      const double distance = mc::Point::distance(points[k], p);
+      if (distance <= radius)
+        expected.push_back(k);
+      if (distance < nearest_distance) {
+        nearest = k;
+        nearest_distance = distance;
+      }
+    }
+
+    std::vector<std::size_t> found;
+    tree.find_within_radius(p, radius, found);
+    std::sort(found.begin(), found.end());
+    REQUIRE(found == expected);
+
+    std::size_t id;
+    double distance;
+    REQUIRE(tree.find_nearest(p, id, distance));
+    REQUIRE(id == nearest);
+    REQUIRE(distance == Approx(nearest_distance));
+  }
+}
+
+TEST_CASE("FindEmbeddedVerticesAfterModification", "[SpatialIndex]") {
+  mc::GraphStorage graph;
+  auto v0 = graph.create_vertex();
+  auto v1 = graph.create_vertex();
+  auto v2 = graph.create_vertex();
+  auto e0 = graph.connect(*v0, *v1, 2);
+  e0->add_embedding_data({{mc::Point(0, 0, 0), mc::Point(0.5, 0, 0), mc::Point(1, 0, 0)}});
+
+  REQUIRE(graph.find_embedded_vertices(mc::Point(1, 0, 0)).front()->get_id() == v1->get_id());
+  REQUIRE(graph.find_embedded_vertices(mc::Point(2, 0, 0)).empty());
+  REQUIRE(graph.find_nearest_embedded_vertex(mc::Point(0.2, 0.1, 0))->get_id() == v0->get_id());
+  REQUIRE(graph.find_embedded_edges(mc::Point(0.5, 0.1, 0), 0.2) == std::vector<std::size_t>{e0->get_id()});
+
+  // the index has to notice the new edge
+  auto e1 = graph.connect(*v1, *v2, 2);
+  e1->add_embedding_data({{mc::Point(1, 0, 0), mc::Point(2, 0, 0)}});
+  REQUIRE(graph.find_embedded_vertices(mc::Point(2, 0, 0)).front()->get_id() == v2->get_id());
+  REQUIRE(graph.find_embedded_vertices(mc::Point(1, 0, 0), 1.).size() == 3);
+}
@@ -0,0 +1,137 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/steady_flow_solver.hpp"
+#include "macrocirculation/vessel_formulas.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+namespace {
+
+// the mean of the heart beat of the 3 vessel network over a period
+const double mean_inflow = 485. * 0.3 * 2. / M_PI;
+
+} // namespace
+
+TEST_CASE("SteadyFlowsBalanceTheMeanInflow", "[SteadyFlowSolver]") {
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+  mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+
+  mc::SteadyFlowSolver solver(MPI_COMM_WORLD, graph, 1.);
+  solver.solve();
+
+  REQUIRE(solver.get_num_iterations() < 20);
+
+  const auto outflows = solver.get_outflow_data();
+  REQUIRE(outflows.flows.size() == 2);
+  const double inflow = -solver.get_outflow(graph->vertex(0));
+  REQUIRE(inflow == Approx(mean_inflow).epsilon(1e-4));
+  REQUIRE(outflows.total_flow == Approx(inflow).epsilon(1e-10));
+  REQUIRE(solver.get_flow(0) == Approx(inflow).epsilon(1e-10));
+  REQUIRE(solver.get_flow(1) + solver.get_flow(2) == Approx(inflow).epsilon(1e-10));
+
+  // the windkessel models are resistances towards their outflow pressure
+  for (std::size_t v_id : {2, 3}) {
+    const auto &data = graph->vertex(v_id).get_peripheral_vessel_data();
+    REQUIRE(solver.get_pressure(v_id) == Approx(data.p_out + data.resistance * outflows.flows.at(v_id)).epsilon(1e-8));
+  }
+
+  // the pressure drops monotonically along the vessels
+  const auto &edge = graph->edge(0);
+  REQUIRE(solver.get_pressure(edge, 0.) == Approx(solver.get_pressure(0)).epsilon(1e-12));
+  REQUIRE(solver.get_pressure(edge, 1.) == Approx(solver.get_pressure(1)).epsilon(1e-12));
+  REQUIRE(solver.get_pressure(edge, 0.5) < solver.get_pressure(edge, 0.));
+  REQUIRE(solver.get_pressure(edge, 0.5) > solver.get_pressure(edge, 1.));
+
+  SECTION("the flow through a vessel is the poiseuille flow for small pressure differences") {
+    const auto &param = graph->edge(1).get_physical_data();
+    const double p_mean = 0.5 * (solver.get_pressure(1) + solver.get_pressure(2));
+    const double R = mc::linear::get_L(param) * mc::linear::get_R(param) * param.length * std::pow(1 + p_mean / param.G0, -4);
+    REQUIRE(solver.get_flow(1) == Approx((solver.get_pressure(1) - solver.get_pressure(2)) / R).epsilon(1e-4));
+  }
+
+  SECTION("free outflows keep their characteristic") {
+    auto &vertex = graph->vertex(3);
+    vertex.unfinalize_bcs();
+    vertex.set_to_free_outflow();
+    vertex.finalize_bcs();
+    solver.solve();
+
+    const auto &param = graph->edge(2).get_physical_data();
+    const double A = mc::nonlinear::get_A_from_p(solver.get_pressure(3), param.G0, param.A0);
+    const double c0 = mc::calculate_c0(param.G0, param.rho, param.A0);
+    const double c = c0 * std::pow(A / param.A0, 0.25);
+    const double Q = solver.get_outflow(graph->vertex(3));
+    REQUIRE(Q / A - 4 * c == Approx(-4 * c0).epsilon(1e-10));
+    REQUIRE(solver.get_outflow_data().total_flow == Approx(inflow).epsilon(1e-10));
+  }
+}
+
+TEST_CASE("SteadyFlowIsCloseToAFixedPointOfTheNonlinearSolver", "[SteadyFlowSolver]") {
+  const std::size_t degree = 2;
+
+  // the deviation of the flows from the steady state after a short time with the mean inflow
+  const auto run = [&](bool start_from_steady_flow) {
+    auto graph = test_macrocirculation::util::create_3_vessel_network();
+    graph->finalize_bcs();
+    mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+
+    mc::SteadyFlowSolver steady_flow_solver(MPI_COMM_WORLD, graph, 1.);
+    steady_flow_solver.solve();
+
+    auto &inflow_vertex = graph->vertex(0);
+    inflow_vertex.unfinalize_bcs();
+    inflow_vertex.set_to_inflow_with_fixed_flow([](double) { return mean_inflow; });
+    inflow_vertex.finalize_bcs();
+
+    auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+    dof_map->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+
+    mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, degree);
+    solver.use_ssp_method();
+    if (start_from_steady_flow)
+      solver.set_to_steady_flow(steady_flow_solver);
+
+    const double tau = 1e-5;
+    double t = 0;
+    for (std::size_t k = 0; k < 2000; k += 1) {
+      solver.solve(tau, t);
+      t += tau;
+    }
+
+    double max_deviation = 0;
+    for (auto e_id : graph->get_active_edge_ids(mc::mpi::rank(MPI_COMM_WORLD))) {
+      const auto &local_dof_map = dof_map->get_local_dof_map(graph->edge(e_id));
+      for (std::size_t micro_edge_id = 0; micro_edge_id < local_dof_map.num_micro_edges(); micro_edge_id += 1) {
+        const double Q = solver.get_solution()[local_dof_map.first_dof(micro_edge_id, mc::ExplicitNonlinearFlowSolver::Q_component)];
+        max_deviation = std::max(max_deviation, std::abs(Q - steady_flow_solver.get_flow(e_id)));
+      }
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &max_deviation, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    return max_deviation;
+  };
+
+  const double deviation_from_rest = run(false);
+  const double deviation_from_steady_flow = run(true);
+
+  REQUIRE(deviation_from_steady_flow < 0.05 * deviation_from_rest);
+  REQUIRE(deviation_from_steady_flow < 2e-3 * mean_inflow);
+}
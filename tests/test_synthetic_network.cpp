@@ -0,0 +1,107 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <cmath>
+#include <memory>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/synthetic_network.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("SyntheticTreeFollowsMurraysLaw", "[SyntheticNetwork]") {
+  mc::SyntheticTreeParameters parameters;
+  parameters.depth = 4;
+  parameters.branching_factor = 3;
+  parameters.asymmetry = 0.3;
+
+  auto graph = mc::create_synthetic_arterial_tree(parameters);
+
+  REQUIRE(graph->num_edges() == 1 + 3 + 9 + 27);
+  REQUIRE(graph->num_edges() == mc::get_num_synthetic_tree_vessels(parameters));
+  REQUIRE(graph->num_vertices() == graph->num_edges() + 1);
+  REQUIRE(graph->find_vertex_by_name("in")->is_inflow_with_fixed_flow());
+
+  double inverse_resistance = 0;
+  double compliance = 0;
+  std::size_t num_outlets = 0;
+  for (auto v_id : graph->get_vertex_ids()) {
+    const auto &vertex = *graph->get_vertex(v_id);
+    if (vertex.is_windkessel_outflow()) {
+      REQUIRE(vertex.get_name() == "out_" + std::to_string(num_outlets));
+      inverse_resistance += 1. / vertex.get_peripheral_vessel_data().resistance;
+      compliance += vertex.get_peripheral_vessel_data().compliance;
+      num_outlets += 1;
+      continue;
+    }
+    if (vertex.is_leaf())
+      continue;
+
+    // the first neighbor is the parent vessel, which ends at the vertex
+    const auto &neighbors = vertex.get_edge_neighbors();
+    REQUIRE(neighbors.size() == 4);
+    const double r_parent = graph->get_edge(neighbors[0])->get_physical_data().radius;
+    double sum = 0;
+    for (std::size_t k = 1; k < neighbors.size(); k += 1) {
+      const auto &child = *graph->get_edge(neighbors[k]);
+      REQUIRE(child.get_vertex_neighbors()[0] == v_id);
+      sum += std::pow(child.get_physical_data().radius, 3);
+      // the lengths scale with the radii
+      REQUIRE(child.get_physical_data().length / child.get_physical_data().radius == Approx(parameters.root_length / parameters.root_radius));
+    }
+    REQUIRE(sum == Approx(std::pow(r_parent, 3)).epsilon(1e-12));
+  }
+  REQUIRE(num_outlets == 27);
+
+  // the windkessels in parallel have the total resistance and compliance
+  REQUIRE(1. / inverse_resistance == Approx(parameters.total_resistance).epsilon(1e-12));
+  REQUIRE(compliance == Approx(parameters.total_compliance).epsilon(1e-12));
+}
+
+TEST_CASE("FlowSolverRunsOnSyntheticTrees", "[SyntheticNetwork]") {
+  const std::size_t degree = 2;
+  const double tau_max = 1e-4;
+  const double t_end = 2e-3;
+
+  for (auto outlet : {mc::SyntheticTreeOutlet::windkessel, mc::SyntheticTreeOutlet::vessel_tree}) {
+    mc::SyntheticTreeParameters parameters;
+    parameters.depth = 5;
+    parameters.outlet = outlet;
+
+    auto graph = mc::create_synthetic_arterial_tree(parameters);
+    graph->finalize_bcs();
+    mc::naive_mesh_partitioner(*graph, MPI_COMM_WORLD);
+
+    auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+    dof_map->create(MPI_COMM_WORLD, *graph, 2, degree, false);
+    mc::ExplicitNonlinearFlowSolver solver(MPI_COMM_WORLD, graph, dof_map, degree);
+    solver.use_ssp_method();
+    // the chains of compartments of the small vessels are too stiff for the explicit time step
+    solver.set_implicit_0d_models(outlet == mc::SyntheticTreeOutlet::vessel_tree);
+
+    // the smallest vessels restrict the time step
+    double t = 0;
+    while (t < t_end)
+      solver.solve_adaptive(tau_max, t, t_end, 0.5);
+
+    for (auto v : solver.get_solution())
+      REQUIRE(std::isfinite(v));
+
+    // the heart pumps blood into the root
+    if (graph->get_edge(0)->rank() == mc::mpi::rank(MPI_COMM_WORLD)) {
+      double p, q;
+      solver.get_1d_pq_values_at_vertex(*graph->find_vertex_by_name("in"), p, q);
+      REQUIRE(q > 0);
+    }
+  }
+}
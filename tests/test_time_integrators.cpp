@@ -0,0 +1,112 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "macrocirculation/thread_pool.hpp"
+#include "macrocirculation/time_integrators.hpp"
+
+namespace mc = macrocirculation;
+
+TEST_CASE("ButcherSchemesAreConsistent", "[TimeIntegrators]") {
+  REQUIRE(mc::check_consistency_rkm(mc::create_explicit_euler()));
+  REQUIRE(mc::check_consistency_rkm(mc::create_ssp_method()));
+
+  auto bs = mc::create_ssp_method();
+  bs.b[0] += 0.1;
+  REQUIRE(!mc::check_consistency_rkm(bs));
+}
+
+TEST_CASE("ShuOsherSchemesAreConsistent", "[TimeIntegrators]") {
+  REQUIRE(mc::check_consistency_rkm(mc::create_explicit_euler_shu_osher()));
+  REQUIRE(mc::check_consistency_rkm(mc::create_ssp_method_shu_osher()));
+  REQUIRE(mc::check_consistency_rkm(mc::create_ssp_5_3_method_shu_osher()));
+  REQUIRE(mc::check_consistency_rkm(mc::create_ssp_10_4_method_shu_osher()));
+
+  auto so = mc::create_ssp_10_4_method_shu_osher();
+  so.c[5] = 5. / 6.;
+  REQUIRE(!mc::check_consistency_rkm(so));
+}
+
+namespace {
+
+/*! @brief The right-hand side of du/dt = -u. */
+class DecayRightHandSide : public mc::ExplicitRightHandSide {
+public:
+  void evaluate(double, const std::vector<double> &u_prev, std::vector<double> &rhs, double) override {
+    rhs.resize(u_prev.size());
+    for (std::size_t k = 0; k < u_prev.size(); k += 1)
+      rhs[k] = -u_prev[k];
+  }
+};
+
+/*! @brief Integrates du/dt = -u with u(0) = (1, 2) until t = 1 and returns u. */
+std::vector<double> integrate_decay(mc::TimeIntegrator &integrator) {
+  DecayRightHandSide rhs;
+  std::vector<double> u_prev{1, 2}, u_now(2, 0);
+  const double tau = 1e-2;
+  for (std::size_t k = 0; k < 100; k += 1) {
+    integrator.apply(u_prev, k * tau, tau, rhs, u_now);
+    std::swap(u_prev, u_now);
+  }
+  return u_prev;
+}
+
+} // namespace
+
+TEST_CASE("SinglePrecisionStorageStaysCloseToDouble", "[TimeIntegrators]") {
+  mc::TimeIntegrator butcher(mc::create_ssp_method(), 2);
+  mc::TimeIntegrator butcher_single(mc::create_ssp_method(), 2, mc::StoragePrecision::single_precision);
+  mc::TimeIntegrator shu_osher(mc::create_ssp_10_4_method_shu_osher(), 2);
+  mc::TimeIntegrator shu_osher_single(mc::create_ssp_10_4_method_shu_osher(), 2);
+  shu_osher_single.set_storage_precision(mc::StoragePrecision::single_precision);
+  REQUIRE(shu_osher_single.get_storage_precision() == mc::StoragePrecision::single_precision);
+
+  const auto u_butcher = integrate_decay(butcher);
+  const auto u_butcher_single = integrate_decay(butcher_single);
+  const auto u_shu_osher = integrate_decay(shu_osher);
+  const auto u_shu_osher_single = integrate_decay(shu_osher_single);
+
+  for (std::size_t k = 0; k < 2; k += 1) {
+    const double exact = (k + 1) * std::exp(-1.);
+    REQUIRE(u_butcher[k] == Approx(exact).epsilon(1e-6));
+    REQUIRE(u_shu_osher[k] == Approx(exact).epsilon(1e-8));
+    // the rounding to float is only visible in the last digits
+    REQUIRE(u_butcher_single[k] != u_butcher[k]);
+    REQUIRE(u_butcher_single[k] == Approx(u_butcher[k]).epsilon(1e-6));
+    REQUIRE(u_shu_osher_single[k] == Approx(u_shu_osher[k]).epsilon(1e-6));
+  }
+
+  // the stored stages take half of the memory, while a single right-hand side is evaluated in double
+  REQUIRE(butcher.memory_report().total() == 4 * 2 * sizeof(double));
+  REQUIRE(butcher_single.memory_report().total() == 2 * 2 * sizeof(double) + 3 * 2 * sizeof(float));
+  REQUIRE(shu_osher.memory_report().total() == 2 * 2 * sizeof(double));
+  REQUIRE(shu_osher_single.memory_report().total() == 2 * sizeof(double) + 2 * sizeof(float));
+}
+
+TEST_CASE("ThreadedVectorUpdatesAgreeBitwise", "[TimeIntegrators]") {
+  // the second thread gets no dofs
+  auto pool = std::make_shared<mc::ThreadPool>(3);
+  const std::vector<std::size_t> chunks{0, 1, 1, 2};
+
+  auto check = [&](mc::TimeIntegrator serial, mc::TimeIntegrator threaded) {
+    threaded.set_thread_pool(pool, chunks);
+    REQUIRE(integrate_decay(threaded) == integrate_decay(serial));
+    REQUIRE(threaded.memory_report().total() == serial.memory_report().total());
+  };
+  check({mc::create_ssp_method(), 2}, {mc::create_ssp_method(), 2});
+  check({mc::create_ssp_method(), 2, mc::StoragePrecision::single_precision}, {mc::create_ssp_method(), 2, mc::StoragePrecision::single_precision});
+  check({mc::create_ssp_10_4_method_shu_osher(), 2}, {mc::create_ssp_10_4_method_shu_osher(), 2});
+  check({mc::create_ssp_5_3_method_shu_osher(), 2, mc::StoragePrecision::single_precision}, {mc::create_ssp_5_3_method_shu_osher(), 2, mc::StoragePrecision::single_precision});
+
+  mc::TimeIntegrator integrator(mc::create_ssp_method_shu_osher(), 2);
+  REQUIRE_THROWS(integrator.set_thread_pool(pool, {0, 1, 2}));
+  REQUIRE_THROWS(integrator.set_thread_pool(pool, {0, 1, 1, 3}));
+}
@@ -6,8 +6,12 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "catch2/catch.hpp"
+#include <algorithm>
+#include <cmath>
 #include <utility>
+#include <vector>
 
+#include "macrocirculation/dual_number.hpp"
 #include "macrocirculation/vessel_formulas.hpp"
 
 namespace mc = macrocirculation;
@@ -101,3 +105,136 @@ TEST_CASE("PeriodicPiecewiseLinearSourceFunctionsWorksCorrectly", "[VesselFormul
   REQUIRE(f(4.2) == Approx(1.7).epsilon(1e-12));
   REQUIRE(f(4.5) == Approx(2.).epsilon(1e-12));
 }
+
+TEST_CASE("PiecewiseLinearSourceFunctionsFindTheIntervalsInAnyOrder", "[VesselFormulas]") {
+  std::vector<double> t_list, value_list;
+  for (std::size_t k = 0; k <= 1000; k += 1) {
+    t_list.push_back(1e-3 * static_cast<double>(k));
+    value_list.push_back(std::sin(t_list.back()));
+  }
+  mc::piecewise_linear_source_function f(t_list, value_list, true);
+
+  // the linear interpolation of the sine coincides with the sine up to the interpolation error
+  const auto check = [&](double t) {
+    const double t_in_period = t - std::floor(t);
+    REQUIRE(f(t) == Approx(std::sin(t_in_period)).margin(2e-7));
+  };
+
+  // advancing in time over several periods, backwards and jumping around
+  for (double t = 0; t < 3; t += 3.7e-4)
+    check(t);
+  for (double t = 2; t > 0; t -= 5.3e-3)
+    check(t);
+  for (double t : {0.9995, 0.0005, 0.5, 0.25, 0.75, 0.999999})
+    check(t);
+
+  REQUIRE_THROWS(mc::piecewise_linear_source_function({0, 1}, {0, 1})(1.5));
+}
+
+TEST_CASE("TabulatedHeartBeatInterpolatesTheExactHeartBeat", "[VesselFormulas]") {
+  const mc::heart_beat_inflow heart(4.85, 0.8, 0.3);
+  const auto tabulated = heart.tabulate(8000);
+
+  REQUIRE(tabulated.get_period() == Approx(heart.get_period()));
+
+  // the interpolation error of the sine is tau^2/8 * max|f''|
+  const double h = 0.8 / 8000;
+  const double max_error = h * h / 8 * 4.85 * std::pow(M_PI / 0.3, 2);
+  for (double t = 0; t < 2.5; t += 1.3e-3)
+    REQUIRE(tabulated(t) == Approx(heart(t)).margin(max_error + 1e-12));
+
+  // the kink at the end of the systole is smoothed within a single interval only
+  REQUIRE(tabulated(0.8 + 0.3 + h) == Approx(0.).margin(1e-14));
+  REQUIRE(tabulated(1.6) == Approx(0.).margin(1e-14));
+}
+
+TEST_CASE("DualNumberSensitivitiesOfTheNFurcationAgreeWithFiniteDifferences", "[VesselFormulas]") {
+  using Dual = mc::Dual<2>;
+
+  // the elastic modulus of the second and the radius of the third vessel are our parameters
+  const double E = 400000.0;
+  const double r = 0.8;
+  const double h0 = 0.163;
+  const double rho = 1.028;
+
+  const auto solve = [&](auto E_b, auto r_c, bool in_a) {
+    using Scalar = decltype(E_b);
+    const Scalar A0_a = M_PI * 1.2 * 1.2;
+    const Scalar A0_b = M_PI * 0.9 * 0.9;
+    const Scalar A0_c = M_PI * r_c * r_c;
+    const std::vector<mc::BasicVesselParameters<Scalar>> p{
+      {mc::calculate_G0<Scalar>(h0, E, A0_a), A0_a, rho},
+      {mc::calculate_G0<Scalar>(h0, E_b, A0_b), A0_b, rho},
+      {mc::calculate_G0<Scalar>(h0, E, A0_c), A0_c, rho}};
+    const std::vector<Scalar> Q{10., 4., 5.};
+    const std::vector<Scalar> A{4.6, 2.4, 2.1};
+    std::vector<Scalar> Q_up(3, 0.), A_up(3, 0.);
+    mc::solve_at_nfurcation(Q, A, p, {in_a, !in_a, !in_a}, Q_up, A_up);
+    std::vector<Scalar> result = Q_up;
+    for (std::size_t k = 0; k < 3; k += 1)
+      result.push_back(mc::nonlinear::get_p_from_QA(Q_up[k], A_up[k], p[k]));
+    return result;
+  };
+
+  for (bool in_a : {true, false}) {
+    const auto dual = solve(Dual(E, 0), Dual(r, 1), in_a);
+    const auto value = solve(E, r, in_a);
+
+    // the values are calculated with the same operations
+    for (std::size_t k = 0; k < value.size(); k += 1)
+      REQUIRE(dual[k].value == value[k]);
+
+    // central differences
+    const double dE = 1e-3 * E;
+    const double dr = 1e-5 * r;
+    const auto E_plus = solve(E + dE, r, in_a);
+    const auto E_minus = solve(E - dE, r, in_a);
+    const auto r_plus = solve(E, r + dr, in_a);
+    const auto r_minus = solve(E, r - dr, in_a);
+    for (std::size_t k = 0; k < value.size(); k += 1) {
+      REQUIRE(dual[k].tangent[0] == Approx((E_plus[k] - E_minus[k]) / (2 * dE)).epsilon(1e-5).margin(1e-9));
+      REQUIRE(dual[k].tangent[1] == Approx((r_plus[k] - r_minus[k]) / (2 * dr)).epsilon(1e-5).margin(1e-6));
+    }
+  }
+
+  // the windkessel model and the input resistance with a sensitivity of R2 and C
+  const mc::BasicVesselParameters<Dual> param{mc::calculate_G0<Dual>(h0, E, M_PI * r * r), M_PI * r * r, rho};
+  const Dual R1 = mc::calculate_R1(param);
+  REQUIRE(R1.value == mc::calculate_R1(mc::VesselParameters(param.G0.value, param.A0.value, rho)));
+  const Dual f = mc::windkessel_pressure_rhs<Dual>(2., 10., 5., Dual(3., 0), Dual(0.5, 1));
+  REQUIRE(f.value == Approx(1. / 0.5 * (2. - 5. / 3.)));
+  REQUIRE(f.tangent[0] == Approx(1. / 0.5 * 5. / 9.));
+  REQUIRE(f.tangent[1] == Approx(-1. / (0.5 * 0.5) * (2. - 5. / 3.)));
+}
+
+TEST_CASE("BatchFormulasAgreeWithTheScalarFormulas", "[VesselFormulas]") {
+  const double A0 = M_PI * 1.2 * 1.2;
+  const mc::VesselParameters param(mc::calculate_G0(0.163, 400000.0, A0), A0, 1.028);
+
+  const std::size_t n = 37;
+  std::vector<double> Q(n), A(n);
+  for (std::size_t k = 0; k < n; k += 1) {
+    Q[k] = -20. + static_cast<double>(k);
+    A[k] = A0 * (0.6 + 0.02 * static_cast<double>(k));
+  }
+
+  std::vector<double> w1(n), w2(n), p(n), Q_up(n), A_up(n);
+  mc::nonlinear::batch::get_p_from_A(n, A.data(), param, p.data());
+  for (double tolerance : {0., mc::nonlinear::batch::fast_tolerance}) {
+    mc::nonlinear::batch::get_w1_from_QA(n, Q.data(), A.data(), param, w1.data(), tolerance);
+    mc::nonlinear::batch::get_w2_from_QA(n, Q.data(), A.data(), param, w2.data(), tolerance);
+    mc::nonlinear::batch::solve_W12(n, w1.data(), w2.data(), param, Q_up.data(), A_up.data());
+
+    // the fast mode only changes the roots, whose errors are below the tolerance
+    const double eps = std::max(tolerance, 1e-14);
+    for (std::size_t k = 0; k < n; k += 1) {
+      REQUIRE(w1[k] == Approx(mc::nonlinear::get_w1_from_QA(Q[k], A[k], param)).epsilon(eps));
+      REQUIRE(w2[k] == Approx(mc::nonlinear::get_w2_from_QA(Q[k], A[k], param)).epsilon(eps));
+      REQUIRE(p[k] == Approx(mc::nonlinear::get_p_from_A(param, A[k])).epsilon(1e-14).margin(1e-10));
+
+      // the characteristics of the state are recovered
+      REQUIRE(A_up[k] == Approx(A[k]).epsilon(10 * eps));
+      REQUIRE(Q_up[k] == Approx(Q[k]).epsilon(10 * eps).margin(1e-12 + 10 * eps * std::abs(w1[k]) * A[k]));
+    }
+  }
+}
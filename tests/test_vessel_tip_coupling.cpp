@@ -0,0 +1,130 @@
+////////////////////////////////////////////////////////////////////////////////
+//  Copyright (c) 2021 Andreas Wagner
+//
+//  Distributed under the Boost Software License, Version 1.0. (See accompanying
+//  file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+////////////////////////////////////////////////////////////////////////////////
+
+#include "catch2/catch.hpp"
+#include "mpi.h"
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "macrocirculation/communication/mpi.hpp"
+#include "macrocirculation/dof_map.hpp"
+#include "macrocirculation/explicit_nonlinear_flow_solver.hpp"
+#include "macrocirculation/graph_partitioner.hpp"
+#include "macrocirculation/graph_storage.hpp"
+#include "macrocirculation/vessel_tip_coupling.hpp"
+
+#include "create_3_vessel_network.hpp"
+
+namespace mc = macrocirculation;
+
+namespace {
+
+constexpr double tau = 1e-4;
+constexpr std::size_t exchange_interval = 2;
+
+/*! @brief The outflow pressure of the partner at outlet k, which is linear in time, such that its interpolation is exact. */
+double partner_pressure(std::size_t k, double t) { return 0.1 * static_cast<double>(k + 1) + t; }
+
+/*! @brief Answers every state with the outflow pressures at the time of the exchange after the next one, until it is stopped. */
+std::size_t run_partner(MPI_Comm intercomm, std::size_t num_outlets) {
+  std::size_t num_states = 0;
+  std::vector<double> state(1 + 2 * num_outlets);
+  std::vector<double> answer(1 + num_outlets);
+  while (true) {
+    MPI_Status status;
+    MPI_Probe(0, MPI_ANY_TAG, intercomm, &status);
+    if (status.MPI_TAG == mc::VesselTipCoupling::stop_tag) {
+      MPI_Recv(nullptr, 0, MPI_DOUBLE, 0, mc::VesselTipCoupling::stop_tag, intercomm, MPI_STATUS_IGNORE);
+      return num_states;
+    }
+    int count;
+    MPI_Get_count(&status, MPI_DOUBLE, &count);
+    REQUIRE(count == static_cast<int>(state.size()));
+    MPI_Recv(state.data(), count, MPI_DOUBLE, 0, mc::VesselTipCoupling::state_tag, intercomm, MPI_STATUS_IGNORE);
+    num_states += 1;
+
+    answer[0] = state[0] + 2 * exchange_interval * tau;
+    for (std::size_t k = 0; k < num_outlets; k += 1)
+      answer[1 + k] = partner_pressure(k, answer[0]);
+    MPI_Send(answer.data(), static_cast<int>(answer.size()), MPI_DOUBLE, 0, mc::VesselTipCoupling::state_tag, intercomm);
+  }
+}
+
+} // namespace
+
+/*! @brief Couples the network on all but the last rank to a partner on the last rank, which answers with outflow pressures linear in time. */
+TEST_CASE("VesselTipCouplingExchangesAndInterpolates", "[VesselTipCoupling]") {
+  const std::size_t degree = 2;
+  const std::size_t num_steps = 20;
+  const int size = mc::mpi::size(MPI_COMM_WORLD);
+  const int rank = mc::mpi::rank(MPI_COMM_WORLD);
+
+  // on a single rank, there is no partner and the outflow pressures stay fixed
+  const bool is_partner = size > 1 && rank == size - 1;
+  MPI_Comm comm = MPI_COMM_WORLD;
+  MPI_Comm intercomm = MPI_COMM_NULL;
+  if (size > 1) {
+    MPI_Comm_split(MPI_COMM_WORLD, is_partner ? 1 : 0, rank, &comm);
+    MPI_Intercomm_create(comm, 0, MPI_COMM_WORLD, is_partner ? 0 : size - 1, 0, &intercomm);
+  }
+
+  auto graph = test_macrocirculation::util::create_3_vessel_network();
+  graph->finalize_bcs();
+
+  if (is_partner) {
+    REQUIRE(run_partner(intercomm, 2) == num_steps / exchange_interval);
+  } else {
+    mc::naive_mesh_partitioner(*graph, comm);
+    auto dof_map = std::make_shared<mc::DofMap>(graph->num_vertices(), graph->num_edges());
+    dof_map->create(comm, *graph, 2, degree, false);
+    mc::ExplicitNonlinearFlowSolver solver(comm, graph, dof_map, degree);
+    solver.use_ssp_method();
+
+    mc::VesselTipCoupling coupling(comm, graph, intercomm, exchange_interval);
+    REQUIRE(coupling.get_outlet_vertex_ids() == std::vector<std::size_t>{2, 3});
+    const auto initial_outflow_pressures = coupling.get_outflow_pressures();
+
+    double t = 0;
+    for (std::size_t step = 0; step < num_steps; step += 1) {
+      coupling.update(solver, t);
+
+      if (step % exchange_interval == 0) {
+        for (std::size_t k = 0; k < coupling.num_outlets(); k += 1) {
+          const auto &v = graph->vertex(coupling.get_outlet_vertex_ids()[k]);
+          const auto &edge = graph->edge(v.get_edge_neighbors()[0]);
+          if (edge.rank() != mc::mpi::rank(comm))
+            continue;
+          double p, q;
+          solver.get_1d_pq_values_at_vertex(v, p, q);
+          REQUIRE(coupling.get_pressures()[k] == p);
+          REQUIRE(coupling.get_flows()[k] == (edge.is_pointing_to(v.get_id()) ? q : -q));
+        }
+      }
+
+      // from the second answer on, the outflow pressures are interpolated between two answers of the partner
+      for (std::size_t k = 0; k < coupling.num_outlets(); k += 1) {
+        const double p_out = graph->vertex(coupling.get_outlet_vertex_ids()[k]).get_peripheral_vessel_data().p_out;
+        REQUIRE(p_out == coupling.get_outflow_pressures()[k]);
+        if (intercomm == MPI_COMM_NULL)
+          REQUIRE(p_out == initial_outflow_pressures[k]);
+        else if (step >= 2 * exchange_interval)
+          REQUIRE(p_out == Approx(partner_pressure(k, t)).epsilon(1e-12));
+      }
+
+      solver.solve(tau, t);
+      t += tau;
+    }
+
+    coupling.finish();
+  }
+
+  if (size > 1) {
+    MPI_Comm_free(&intercomm);
+    MPI_Comm_free(&comm);
+  }
+}
@@ -2,6 +2,7 @@ import os
 import json
 import numpy as np
 import argparse
+import graph_data
 
 
 def reformat_data(d):
@@ -10,16 +11,11 @@ def reformat_data(d):
     return d
 
 
-def load_data_by_vessel(directory_name, v):
+def load_data_by_vessel(directory_name, metainfo, v):
     d_list = {}
-    if 'filepath_p' in v['filepaths']:
-        d_list['p'] = reformat_data(np.loadtxt(os.path.join(directory_name, v['filepaths']['filepath_p'])))
-    if 'filepath_c' in v['filepaths']:
-        d_list['c'] = reformat_data(np.loadtxt(os.path.join(directory_name, v['filepaths']['filepath_c'])))
-    if 'filepath_V' in v['filepaths']:
-        d_list['V'] = reformat_data(np.loadtxt(os.path.join(directory_name, v['filepaths']['filepath_V'])))
-    if 'filepath_p_out' in v:
-        d_list['p_out'] = reformat_data(np.loadtxt(os.path.join(directory_name, v['filepath_p_out'])))
+    for type in ['p', 'c', 'V', 'p_out']:
+        if graph_data.has_tip_values(metainfo, v, type):
+            d_list[type] = reformat_data(graph_data.load_tip_values(directory_name, metainfo, v, type))
     return d_list, v
 
 
@@ -39,7 +35,7 @@ if __name__ == '__main__':
         metainfo = json.loads(f.read())
 
 
-    t = np.array(metainfo['times'])
+    t = graph_data.load_tip_times(directory_name, metainfo)
 
     start_index = sum(t < args.t_start)
 
@@ -51,7 +47,7 @@ if __name__ == '__main__':
     data_list = []
 
     for vertex in metainfo['vertices']:
-        data, vertex = load_data_by_vessel(directory_name, vertex)
+        data, vertex = load_data_by_vessel(directory_name, metainfo, vertex)
         p = data['p'][start_index:stop_index, -1] * 1e3 # kg -> g conversion factor
         p_mean = p.mean()
         R = vertex['resistance'][-1] * 1e3 # kg -> g
@@ -0,0 +1,140 @@
+# Loads the vessel data written by the GraphCSVWriter or the GraphBinaryWriter and the probes of the ProbeWriter.
+#
+# The binary format consists of one file per rank with records of doubles, each starting with the time,
+# whose layout is described by the json index next to it.
+# With a shared file, the records of all the ranks owning edges follow each other for every time step.
+# Lossy components are quantized with twice their tolerance and stored as zigzag varints of the differences to the
+# previous record, which is announced by the encoding in the index and gives every record its own size.
+
+import os
+import json
+import numpy as np
+
+
+def load_meta(filepath):
+    with open(filepath) as f:
+        return json.loads(f.read())
+
+
+def is_binary(meta):
+    return meta.get('format') == 'binary'
+
+
+def has_component(meta, vessel_info, component):
+    if is_binary(meta):
+        return component in vessel_info['offsets']
+    return component in vessel_info['filepaths']
+
+
+def _decode_varints(data, pos, num_values):
+    '''Decodes num_values zigzag varints starting at pos and returns them together with the position after the last one.'''
+    ends = np.flatnonzero(data[pos:] < 0x80)[:num_values] + pos
+    if len(ends) < num_values:
+        raise ValueError('truncated record')
+    if num_values == 0:
+        return np.zeros(0, dtype=np.int64), pos
+    segment = data[pos:ends[-1] + 1]
+    starts = np.concatenate(([0], ends[:-1] + 1 - pos))
+    # the position of every byte within its varint
+    shifts = np.arange(len(segment)) - np.repeat(starts, np.diff(np.append(starts, len(segment))))
+    chunks = (segment & 0x7f).astype(np.uint64) << (7 * shifts).astype(np.uint64)
+    unsigned = np.add.reduceat(chunks, starts)
+    signed = (unsigned >> np.uint64(1)).astype(np.int64) ^ -(unsigned & np.uint64(1)).astype(np.int64)
+    return signed, ends[-1] + 1
+
+
+def _load_quantized_records(directory, meta, rank):
+    '''Decodes the records of a GraphBinaryWriter with lossy components, whose values are quantized and stored as differences to the previous record.'''
+    rank_info = meta['ranks'][rank]
+    order = '<' if meta['byte_order'] == 'little' else '>'
+    data = np.fromfile(os.path.join(directory, rank_info['filepath']), dtype=np.uint8)
+    record_size = rank_info['record_size']
+    tolerances = [component['tolerance'] for component in meta['components']]
+    num_values = (record_size - 1) // len(tolerances)
+    quantized = np.zeros(record_size, dtype=np.int64)
+    records = []
+    pos = 0
+    while pos + 16 <= len(data):
+        t = np.frombuffer(data[pos:pos + 8].tobytes(), dtype=order + 'f8')[0]
+        payload_size = int(np.frombuffer(data[pos + 8:pos + 16].tobytes(), dtype=order + 'u8')[0])
+        end = pos + 16 + payload_size
+        # a record, which is still being written, is ignored
+        if end > len(data):
+            break
+        record = np.empty(record_size)
+        record[0] = t
+        cursor = pos + 16
+        for k, tolerance in enumerate(tolerances):
+            idx = slice(1 + k * num_values, 1 + (k + 1) * num_values)
+            if tolerance > 0:
+                differences, cursor = _decode_varints(data[:end], cursor, num_values)
+                quantized[idx] += differences
+                record[idx] = 2 * tolerance * quantized[idx]
+            else:
+                record[idx] = np.frombuffer(data[cursor:cursor + 8 * num_values].tobytes(), dtype=order + 'f8')
+                cursor += 8 * num_values
+        records.append(record)
+        pos = end
+    return np.array(records).reshape((len(records), record_size))
+
+
+def _load_records(directory, meta, rank):
+    if meta.get('encoding') == 'quantized_delta':
+        return _load_quantized_records(directory, meta, rank)
+    rank_info = meta['ranks'][rank]
+    dtype = np.dtype('<f8' if meta['byte_order'] == 'little' else '>f8')
+    values = np.memmap(os.path.join(directory, rank_info['filepath']), dtype=dtype, mode='r')
+    step_size = meta.get('step_size', rank_info['record_size'])
+    offset = rank_info.get('record_offset', 0)
+    # a record, which is still being written, is ignored
+    num_records = len(values) // step_size
+    steps = values[:num_records * step_size].reshape((num_records, step_size))
+    return steps[:, offset:offset + rank_info['record_size']]
+
+
+def load_vessel_component(directory, meta, vessel_info, component):
+    '''Returns the boundary values of all the micro edges of the vessel as an array of shape (num_time_steps, num_values).'''
+    if is_binary(meta):
+        records = _load_records(directory, meta, vessel_info['rank'])
+        offset = vessel_info['offsets'][component]
+        return np.array(records[:, offset:offset + vessel_info['num_values']])
+    path = os.path.join(directory, vessel_info['filepaths'][component])
+    return np.loadtxt(path, delimiter=',', ndmin=2)
+
+
+def load_probe(directory, meta, probe_info, quantity):
+    '''Returns the values of p, q or a at the probe for all the time steps of the ProbeWriter.'''
+    records = _load_records(directory, meta, probe_info['rank'])
+    return np.array(records[:, probe_info['offsets'][quantity]])
+
+
+def load_times(directory, meta):
+    if is_binary(meta):
+        # ranks without edges have no records in a shared file
+        rank = next(r for r, rank_info in enumerate(meta['ranks']) if rank_info['record_size'] > 0)
+        return np.array(_load_records(directory, meta, rank)[:, 0])
+    return np.loadtxt(os.path.join(directory, meta['filepath_time']), delimiter=',', ndmin=1)
+
+
+def load_tip_values(directory, metainfo, vertex_info, type):
+    '''Returns the rows of the given type, e.g. p or p_out, of a vertex of the CSVVesselTipWriter, which may have gathered all the vertices into a single file.'''
+    if 'filepaths_gathered' in metainfo:
+        data = np.loadtxt(os.path.join(directory, metainfo['filepaths_gathered']['filepath_' + type]), ndmin=2)
+        if type == 'p_out':
+            return data[:, vertex_info['column_p_out']:vertex_info['column_p_out'] + 1]
+        return data[:, vertex_info['column']:vertex_info['column'] + vertex_info['num_dofs']]
+    path = vertex_info['filepath_p_out'] if type == 'p_out' else vertex_info['filepaths']['filepath_' + type]
+    return np.loadtxt(os.path.join(directory, path), ndmin=2)
+
+
+def has_tip_values(metainfo, vertex_info, type):
+    if 'filepaths_gathered' in metainfo:
+        return 'filepath_' + type in metainfo['filepaths_gathered'] and (type != 'p_out' or 'column_p_out' in vertex_info)
+    return 'filepath_p_out' in vertex_info if type == 'p_out' else 'filepath_' + type in vertex_info['filepaths']
+
+
+def load_tip_times(directory, metainfo):
+    '''Returns the time steps of the CSVVesselTipWriter, whose csv file is complete even if the meta file was not flushed.'''
+    if 'filepath_times' in metainfo:
+        return np.loadtxt(os.path.join(directory, metainfo['filepath_times']), delimiter=',', ndmin=1)
+    return np.array(metainfo['times'])
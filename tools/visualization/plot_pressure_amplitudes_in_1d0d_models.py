@@ -6,6 +6,7 @@ from matplotlib import pyplot as plt
 import argparse
 
 import plot_vessel_tips as pvt
+import graph_data
 
 
 def load_1d_averaged_pressure_data(filepath, t_start, t_stop):
@@ -67,7 +68,7 @@ def load_0d_averaged_pressure_data(filepath, t_start, t_stop):
     with open(filepath) as f:
         metainfo = json.loads(f.read())
 
-    t = np.array(metainfo['times'])
+    t = graph_data.load_tip_times(directory_name, metainfo)
 
     start_index = sum(t < t_start)
 
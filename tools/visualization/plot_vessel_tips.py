@@ -3,6 +3,7 @@ import json
 import numpy as np
 import argparse
 from matplotlib import pyplot as plt
+import graph_data
 
 
 def find_vessel_by_edge_id(metainfo, edge_id):
@@ -20,19 +21,14 @@ def reformat_data(d):
 
 def load_data_by_edge_id(directory_name, metainfo, edge_id):
     v = find_vessel_by_edge_id(metainfo, edge_id)
-    return load_data_by_vessel(directory_name, v)
+    return load_data_by_vessel(directory_name, metainfo, v)
 
 
-def load_data_by_vessel(directory_name, v):
+def load_data_by_vessel(directory_name, metainfo, v):
     d_list = {}
-    if 'filepath_p' in v['filepaths']:
-        d_list['p'] = reformat_data(np.loadtxt(os.path.join(directory_name, v['filepaths']['filepath_p'])))
-    if 'filepath_c' in v['filepaths']:
-        d_list['c'] = reformat_data(np.loadtxt(os.path.join(directory_name, v['filepaths']['filepath_c'])))
-    if 'filepath_V' in v['filepaths']:
-        d_list['V'] = reformat_data(np.loadtxt(os.path.join(directory_name, v['filepaths']['filepath_V'])))
-    if 'filepath_p_out' in v:
-        d_list['p_out'] = reformat_data(np.loadtxt(os.path.join(directory_name, v['filepath_p_out'])))
+    for type in ['p', 'c', 'V', 'p_out']:
+        if graph_data.has_tip_values(metainfo, v, type):
+            d_list[type] = reformat_data(graph_data.load_tip_values(directory_name, metainfo, v, type))
     return d_list, v
 
 
@@ -55,7 +51,7 @@ if __name__ == '__main__':
     with open(args.filepath) as f:
         metainfo = json.loads(f.read())
 
-    t = np.array(metainfo['times'])
+    t = graph_data.load_tip_times(directory_name, metainfo)
 
     start_index = sum(t < args.t_start)
 
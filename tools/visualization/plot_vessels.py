@@ -1,8 +1,8 @@
 import os
 import numpy as np
-import json
 from matplotlib import pyplot as plt
 import argparse
+import graph_data
 
 
 parser = argparse.ArgumentParser(description='Plots the vessel data.')
@@ -28,8 +28,7 @@ if args.use_shifted_vessel_numbers:
     args.vessels = [vid-1 for vid in args.vessels]
 
 
-with open(args.filepath) as f:
-    meta = json.loads(f.read())
+meta = graph_data.load_meta(args.filepath)
 
 
 def find_vessel(vessel_id):
@@ -42,13 +41,13 @@ def find_vessel(vessel_id):
 vessel_info = meta['vessels'][0]
 
 num_rows = 0
-if not args.no_a and 'a' in vessel_info['filepaths']:
+if not args.no_a and graph_data.has_component(meta, vessel_info, 'a'):
     num_rows += 1
 if not args.no_q:
     num_rows += 1
 if not args.no_p:
     num_rows += 1
-if not args.no_c and 'c' in vessel_info['filepaths']:
+if not args.no_c and graph_data.has_component(meta, vessel_info, 'c'):
     num_rows += 1
 
 
@@ -62,43 +61,37 @@ position = args.position
 for idx, vessel_id in enumerate(args.vessels):
     vessel_info = find_vessel(vessel_id)
 
-    path = os.path.join(directory, vessel_info['filepaths']['q'])
-    print('loading {}'.format(path))
-    q = np.loadtxt(path, delimiter=',')
+    print('loading q of vessel {}'.format(vessel_id))
+    q = graph_data.load_vessel_component(directory, meta, vessel_info, 'q')
     q = q[:]
     q = q[:, int((q.shape[1]-1)*position)]
     
     if args.positive_q and q.mean() < 0:
         q *= -1
 
-    if ('a' in vessel_info['filepaths']):
-        path = os.path.join(directory, vessel_info['filepaths']['a'])
-        print('loading {}'.format(path))
-        a = np.loadtxt(path, delimiter=',')
+    if graph_data.has_component(meta, vessel_info, 'a'):
+        print('loading a of vessel {}'.format(vessel_id))
+        a = graph_data.load_vessel_component(directory, meta, vessel_info, 'a')
         a = a[:]
         a = a[:, int((a.shape[1]-1) * position)]
     else:
         a = np.ones(q.shape) * vessel_info['A0']
 
-    if ('p' in vessel_info['filepaths']):
-        path = os.path.join(directory, vessel_info['filepaths']['p'])
-        print('loading {}'.format(path))
-        p = np.loadtxt(path, delimiter=',') / 1.333332
+    if graph_data.has_component(meta, vessel_info, 'p'):
+        print('loading p of vessel {}'.format(vessel_id))
+        p = graph_data.load_vessel_component(directory, meta, vessel_info, 'p') / 1.333332
         p = p[:]
         p = p[:, int((p.shape[1]-2) * position)]
     else:
         p = vessel_info['G0'] * (np.sqrt(a/vessel_info['A0']) - 1) / 1.33332
 
-    if ('c' in vessel_info['filepaths']):
-        path = os.path.join(directory, vessel_info['filepaths']['c'])
-        print('loading {}'.format(path))
-        c = np.loadtxt(path, delimiter=',')
+    if graph_data.has_component(meta, vessel_info, 'c'):
+        print('loading c of vessel {}'.format(vessel_id))
+        c = graph_data.load_vessel_component(directory, meta, vessel_info, 'c')
         c = c[:]
         c = c[:, int((c.shape[1]-1)*position)]
 
-    path = os.path.join(directory, meta['filepath_time'])
-    print('loading {}'.format(path))
-    t = np.loadtxt(path, delimiter=',')
+    t = graph_data.load_times(directory, meta)
 
     start_index = np.sum(t < args.t_start)
     end_index = np.sum(t < args.t_end)
@@ -110,7 +103,7 @@ for idx, vessel_id in enumerate(args.vessels):
         array_sizes.append(len(q))
     if not args.no_p:
         array_sizes.append(len(p))
-    if not args.no_c and 'c' in vessel_info['filepaths']:
+    if not args.no_c and graph_data.has_component(meta, vessel_info, 'c'):
         array_sizes.append(len(c))
 
     end_index = min(min(array_sizes), end_index)
@@ -122,11 +115,11 @@ for idx, vessel_id in enumerate(args.vessels):
         q = q[start_index:end_index]
     if not args.no_p:
         p = p[start_index:end_index]
-    if not args.no_c and 'c' in vessel_info['filepaths']:
+    if not args.no_c and graph_data.has_component(meta, vessel_info, 'c'):
         c = c[start_index:end_index]
 
     row_idx = 0
-    if not args.no_a and 'a' in vessel_info['filepaths']:
+    if not args.no_a and graph_data.has_component(meta, vessel_info, 'a'):
         ax = axes[row_idx, idx]
         label = None if args.no_legend else r'$A_{' + str(vessel_id) + '}$'
         ax.plot(t, a, label=label)
@@ -154,7 +147,7 @@ for idx, vessel_id in enumerate(args.vessels):
         if idx == 0:
             ax.set_ylabel('q $[cm^3/s]$')
         row_idx += 1
-    if not args.no_c and 'c' in vessel_info['filepaths']:
+    if not args.no_c and graph_data.has_component(meta, vessel_info, 'c'):
         ax = axes[row_idx, idx]
         print(c/a)
         label = None if args.no_legend else r'$\Gamma_{' + str(vessel_id) + r'}/A_{' + str(vessel_id) + r'}$'